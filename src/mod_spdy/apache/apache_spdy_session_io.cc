@@ -20,8 +20,10 @@
 
 #include "base/basictypes.h"
 #include "base/logging.h"
+#include "base/time/time.h"
 #include "mod_spdy/apache/pool_util.h"  // for AprStatusString
 #include "mod_spdy/common/protocol_util.h"  // for FrameData
+#include "mod_spdy/common/session_capture.h"
 #include "net/spdy/buffered_spdy_framer.h"
 #include "net/spdy/spdy_protocol.h"
 
@@ -41,7 +43,8 @@ ApacheSpdySessionIO::ApacheSpdySessionIO(conn_rec* connection)
       input_brigade_(apr_brigade_create(connection_->pool,
                                         connection_->bucket_alloc)),
       output_brigade_(apr_brigade_create(connection_->pool,
-                                         connection_->bucket_alloc)) {}
+                                         connection_->bucket_alloc)),
+      capture_(NULL) {}
 
 ApacheSpdySessionIO::~ApacheSpdySessionIO() {}
 
@@ -118,6 +121,10 @@ SpdySessionIO::ReadStatus ApacheSpdySessionIO::ProcessAvailableInput(
                    << AprStatusString(status);
       }
 
+      if (capture_ != NULL) {
+        capture_->RecordInput(base::TimeTicks::Now(), data, data_length);
+      }
+
       const size_t consumed = framer->ProcessInput(data, data_length);
       // If the SpdyFramer encountered an error (i.e. the client sent us
       // malformed data), then we can't recover.
@@ -27,11 +27,18 @@ class SpdyFrame;
 
 namespace mod_spdy {
 
+class SessionCaptureWriter;
+
 class ApacheSpdySessionIO : public SpdySessionIO {
  public:
   explicit ApacheSpdySessionIO(conn_rec* connection);
   ~ApacheSpdySessionIO();
 
+  // Record all input passed to the framer to the given capture log.  The
+  // session IO does _not_ take ownership of the writer.  This is optional,
+  // and if used, must be called before the session starts running.
+  void set_capture(SessionCaptureWriter* capture) { capture_ = capture; }
+
   // SpdySessionIO methods:
   virtual bool IsConnectionAborted();
   virtual ReadStatus ProcessAvailableInput(bool block,
@@ -42,6 +49,7 @@ class ApacheSpdySessionIO : public SpdySessionIO {
   conn_rec* const connection_;
   apr_bucket_brigade* const input_brigade_;
   apr_bucket_brigade* const output_brigade_;
+  SessionCaptureWriter* capture_;
 
   DISALLOW_COPY_AND_ASSIGN(ApacheSpdySessionIO);
 };
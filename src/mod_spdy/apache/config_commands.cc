@@ -14,12 +14,17 @@
 
 #include "mod_spdy/apache/config_commands.h"
 
+#include <string>
+
+#include "apr_file_info.h"
+#include "apr_file_io.h"
 #include "apr_strings.h"
 
 #include "base/strings/string_number_conversions.h"
 
 #include "mod_spdy/apache/config_util.h"
 #include "mod_spdy/apache/pool_util.h"
+#include "mod_spdy/common/server_push_manifest.h"
 #include "mod_spdy/common/spdy_server_config.h"
 #include "mod_spdy/common/protocol_util.h"
 
@@ -106,6 +111,68 @@ const char* SetUseSpdyForNonSslConnections(cmd_parms* cmd, void* dir,
   return NULL;
 }
 
+// Read and compile a server push manifest file (see ServerPushManifest for the
+// format).  Syntax errors in the file are reported as configuration errors.
+// The compiled manifest lives as long as the configuration pool.
+const char* SetServerPushManifest(cmd_parms* cmd, void* dir, const char* arg) {
+  const char* path = ap_server_root_relative(cmd->temp_pool, arg);
+  if (path == NULL) {
+    return apr_pstrcat(cmd->pool, cmd->cmd->name, ": invalid path ", arg,
+                       NULL);
+  }
+
+  std::string contents;
+  apr_file_t* file = NULL;
+  apr_status_t status = apr_file_open(&file, path, APR_READ, APR_OS_DEFAULT,
+                                      cmd->temp_pool);
+  if (status == APR_SUCCESS) {
+    apr_finfo_t finfo;
+    status = apr_file_info_get(&finfo, APR_FINFO_SIZE, file);
+    if (status == APR_SUCCESS && finfo.size > 0) {
+      contents.resize(static_cast<size_t>(finfo.size));
+      status = apr_file_read_full(file, &contents[0], contents.size(), NULL);
+    }
+    apr_file_close(file);
+  }
+  if (status != APR_SUCCESS) {
+    return apr_pstrcat(cmd->pool, cmd->cmd->name, ": cannot read ", path,
+                       NULL);
+  }
+
+  ServerPushManifest* manifest = new ServerPushManifest;
+  PoolRegisterDelete(cmd->pool, manifest);
+  std::string error;
+  if (!manifest->AddRulesFromString(contents, &error)) {
+    return apr_pstrcat(cmd->pool, cmd->cmd->name, ": ", path, ", ",
+                       error.c_str(), NULL);
+  }
+  GetServerConfig(cmd)->set_server_push_manifest(manifest);
+  return NULL;
+}
+
+// Set the directory for session capture logs, relative to the server root.
+const char* SetSessionCaptureDirectory(cmd_parms* cmd, void* dir,
+                                       const char* arg) {
+  const char* path = ap_server_root_relative(cmd->temp_pool, arg);
+  if (path == NULL) {
+    return apr_pstrcat(cmd->pool, cmd->cmd->name, ": invalid path ", arg,
+                       NULL);
+  }
+  GetServerConfig(cmd)->set_session_capture_directory(path);
+  return NULL;
+}
+
+// Set the path of the scoreboard file, relative to the server root.
+const char* SetScoreboardFile(cmd_parms* cmd, void* dir, const char* arg) {
+  const char* path = ap_server_root_relative(cmd->temp_pool, arg);
+  if (path == NULL) {
+    return apr_pstrcat(cmd->pool, cmd->cmd->name, ": invalid path ", arg,
+                       NULL);
+  }
+  GetServerConfig(cmd)->set_scoreboard_file(path);
+  return NULL;
+}
+
 // This template can be wrapped around any of the above functions to restrict
 // the directive to being used only at the top level (as opposed to within a
 // <VirtualHost> directive).
@@ -160,6 +227,50 @@ const command_rec kSpdyConfigCommands[] = {
       "SpdyServerPushDiscoveryEnabled",
       SetBoolean<&SpdyServerConfig::set_server_push_discovery_enabled>,
       "Enables auto-generation of X-Associated-Content headers based on HTTPS request patterns."),
+  SPDY_CONFIG_COMMAND(
+      "SpdyServerPushOutcomeTracking",
+      SetBoolean<&SpdyServerConfig::set_server_push_outcome_tracking>,
+      "Stop making, or demote, server pushes that clients usually cancel."),
+  SPDY_CONFIG_COMMAND(
+      "SpdyServerPushCacheSize",
+      GlobalOnly<SetNonNegativeInt<
+        &SpdyServerConfig::set_server_push_cache_size_kb> >,
+      "Size in kilobytes of the per-process cache of server push responses. 0 Disables. Defaults to 0."),
+  SPDY_CONFIG_COMMAND(
+      "SpdyCoalesceRequests",
+      SetBoolean<&SpdyServerConfig::set_coalesce_requests>,
+      "Send identical GET requests that are in flight at the same time through Apache only once, sharing the response if it is publicly cacheable."),
+  SPDY_CONFIG_COMMAND(
+      "SpdyMicroCacheSize",
+      SetNonNegativeInt<&SpdyServerConfig::set_micro_cache_size_kb>,
+      "Size in kilobytes of the per-process cache of small responses, answered without going through Apache. 0 Disables. Defaults to 0."),
+  SPDY_CONFIG_COMMAND(
+      "SpdyServerPushManifest", SetServerPushManifest,
+      "File listing resources to push along with each page (see spdy.conf)."),
+  SPDY_CONFIG_COMMAND(
+      "SpdyServerPushScanHtml",
+      SetBoolean<&SpdyServerConfig::set_server_push_scan_html>,
+      "Push same-origin stylesheets, scripts, and images referenced by HTML responses."),
+  SPDY_CONFIG_COMMAND(
+      "SpdyMaxStreamReceiveWindow",
+      SetPositiveInt<&SpdyServerConfig::set_max_stream_receive_window_kb>,
+      "Size in kilobytes to which each stream's upload window may grow for fast clients. Defaults to 64, which disables growth."),
+  SPDY_CONFIG_COMMAND(
+      "SpdyMaxSessionReceiveWindow",
+      SetPositiveInt<&SpdyServerConfig::set_max_session_receive_window_kb>,
+      "Size in kilobytes to which each SPDY/3.1 session's upload window may grow for fast clients. Defaults to 64, which disables growth."),
+  SPDY_CONFIG_COMMAND(
+      "SpdyReceiveWindowMemory",
+      GlobalOnly<SetPositiveInt<
+        &SpdyServerConfig::set_receive_window_memory_kb> >,
+      "Total kilobytes per child process by which upload windows may grow beyond their default size. Defaults to 16384."),
+  SPDY_CONFIG_COMMAND(
+      "SpdyAsyncLogging",
+      GlobalOnly<SetBoolean<&SpdyServerConfig::set_async_logging_enabled> >,
+      "Write mod_spdy log messages from a background thread, dropping them rather than blocking if they can't be written fast enough"),
+  SPDY_CONFIG_COMMAND(
+      "SpdyScoreboardFile", GlobalOnly<SetScoreboardFile>,
+      "File in which to keep per-process and per-session SPDY counters, for spdy_top to read"),
   // Debugging commands, which should not be used in production:
   SPDY_CONFIG_COMMAND(
       "SpdyDebugServerPushDiscoverySendDebugHeaders",
@@ -173,6 +284,25 @@ const command_rec kSpdyConfigCommands[] = {
       "SpdyDebugUseSpdyForNonSslConnections",
       SetUseSpdyForNonSslConnections,
       "Use SPDY even over non-SSL connections; DO NOT USE IN PRODUCTION"),
+  SPDY_CONFIG_COMMAND(
+      "SpdyDebugSessionCaptureDirectory", SetSessionCaptureDirectory,
+      "Directory in which to log the decrypted input of sampled SPDY sessions, for offline replay; the logs include cookies and other private data"),
+  SPDY_CONFIG_COMMAND(
+      "SpdyDebugSessionCapturePercent",
+      SetNonNegativeInt<&SpdyServerConfig::set_session_capture_percent>,
+      "Percentage of SPDY connections to capture (see SpdyDebugSessionCaptureDirectory). Defaults to 0."),
+  SPDY_CONFIG_COMMAND(
+      "SpdyDebugSessionCaptureMaxSize",
+      SetPositiveInt<&SpdyServerConfig::set_session_capture_max_kb>,
+      "Maximum size in kilobytes of each session capture log. Defaults to 1024."),
+  SPDY_CONFIG_COMMAND(
+      "SpdyDebugTracing",
+      GlobalOnly<SetBoolean<&SpdyServerConfig::set_tracing_enabled> >,
+      "Record recent session scheduling events, viewable with the spdy-trace handler"),
+  SPDY_CONFIG_COMMAND(
+      "SpdyDebugLockProfiling",
+      GlobalOnly<SetBoolean<&SpdyServerConfig::set_lock_profiling_enabled> >,
+      "Count contention on mod_spdy's internal locks, viewable with the spdy-lock-profile handler"),
   {NULL}
 };
 
@@ -124,6 +124,12 @@ apr_status_t HttpToSpdyFilter::Write(ap_filter_t* filter,
         // EOS bucket -- there should be no more data buckets in this stream.
         eos_bucket_received_ = true;
         RETURN_IF_STREAM_ABORT(filter);
+        // If the response body had no explicit length (see
+        // InsertRequestFilters in mod_spdy.cc), this is where it ends.
+        if (!converter_.ProcessEndOfInput()) {
+          VLOG(1) << "Response ended early on stream "
+                  << receiver_.stream_->stream_id();
+        }
         converter_.Flush();
       } else if (APR_BUCKET_IS_FLUSH(bucket)) {
         // FLUSH bucket -- call Send() immediately and flush the data buffer.
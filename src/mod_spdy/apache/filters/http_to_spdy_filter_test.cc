@@ -309,6 +309,52 @@ TEST_P(HttpToSpdyFilterTest, ChunkedResponse) {
   ExpectOutputQueueEmpty();
 }
 
+// Test a response whose body is delimited by the EOS, as Apache sends on our
+// slave connections when there's no Content-Length.
+TEST_P(HttpToSpdyFilterTest, CloseDelimitedResponse) {
+  // Set up our data structures that we're testing:
+  const net::SpdyStreamId stream_id = 3;
+  const net::SpdyStreamId associated_stream_id = 0;
+  const int32 initial_server_push_depth = 0;
+  const net::SpdyPriority priority = 0;
+  mod_spdy::SpdyStream stream(
+      spdy_version_, stream_id, associated_stream_id,
+      initial_server_push_depth, priority, net::kSpdyStreamInitialWindowSize,
+      &output_queue_, &shared_window_, &pusher_);
+  mod_spdy::SpdyServerConfig config;
+  mod_spdy::HttpToSpdyFilter http_to_spdy_filter(&config, &stream);
+
+  // Send the headers and some body data into the filter:
+  AddImmortalBucket("HTTP/1.1 200 OK\r\n"
+                    "Connection: close\r\n"
+                    "Content-Type: text/html\r\n"
+                    "\r\n"
+                    "Hello, ");
+  AddFlushBucket();
+  ASSERT_EQ(APR_SUCCESS, WriteBrigade(&http_to_spdy_filter));
+  EXPECT_TRUE(APR_BRIGADE_EMPTY(brigade_));
+
+  // Expect a SYN_REPLY (without the Connection header), and the data so far.
+  net::SpdyHeaderBlock expected_headers;
+  expected_headers[mod_spdy::http::kContentType] = "text/html";
+  expected_headers[status_header_name()] = "200";
+  expected_headers[version_header_name()] = "HTTP/1.1";
+  expected_headers[mod_spdy::http::kXModSpdy] =
+      MOD_SPDY_VERSION_STRING "-" LASTCHANGE_STRING;
+  ExpectSynReply(stream_id, expected_headers, false);
+  ExpectDataFrame(stream_id, "Hello, ", false);
+  ExpectOutputQueueEmpty();
+
+  // The rest of the body ends with the EOS bucket, so that's when we should
+  // get FLAG_FIN.
+  AddImmortalBucket("world!\n");
+  AddEosBucket();
+  ASSERT_EQ(APR_SUCCESS, WriteBrigade(&http_to_spdy_filter));
+  EXPECT_TRUE(APR_BRIGADE_EMPTY(brigade_));
+  ExpectDataFrame(stream_id, "world!\n", true);
+  ExpectOutputQueueEmpty();
+}
+
 TEST_P(HttpToSpdyFilterTest, RedirectResponse) {
   // Set up our data structures that we're testing:
   const net::SpdyStreamId stream_id = 5;
@@ -14,12 +14,18 @@
 
 #include "mod_spdy/apache/filters/server_push_filter.h"
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include "base/logging.h"
 #include "base/strings/string_number_conversions.h"  // for StringToUint
 #include "base/strings/string_piece.h"
+#include "base/strings/string_util.h"
+#include "mod_spdy/common/html_subresource_scanner.h"
 #include "mod_spdy/common/protocol_util.h"
+#include "mod_spdy/common/server_push_manifest.h"
+#include "mod_spdy/common/server_push_outcome_tracker.h"
 #include "mod_spdy/common/spdy_server_config.h"
 #include "mod_spdy/common/spdy_stream.h"
 
@@ -96,11 +102,42 @@ net::SpdyPriority ParseOptionalPriority(SpdyStream* spdy_stream,
   return (priority > lowest_priority ? lowest_priority : priority);
 }
 
+// Parse a Link header parameter of the form 'name' or 'name=value' (where the
+// value may be a token or a quoted string) from the front of *source, store
+// the lower-cased name and the value in *name and *value, and modify *source
+// to skip past it and any whitespace thereafter.  Return false on a parse
+// error.
+bool ParseLinkParam(base::StringPiece* source, std::string* name,
+                    std::string* value) {
+  const char kDelimiters[] = "=;, \t\r\n";
+  const size_t name_end = source->find_first_of(kDelimiters);
+  if (name_end == 0) {
+    return false;
+  }
+  *name = StringToLowerASCII(source->substr(0, name_end).as_string());
+  *source = source->substr(name_end);
+  AbsorbWhiteSpace(source);
+  value->clear();
+  if (!ParseSeparator('=', source)) {
+    return true;
+  }
+  if (!source->empty() && (*source)[0] == '"') {
+    return ParseQuotedString(source, value);
+  }
+  const size_t value_end = source->find_first_of(kDelimiters);
+  source->substr(0, value_end).CopyToString(value);
+  *source = source->substr(value_end);
+  AbsorbWhiteSpace(source);
+  return true;
+}
+
 }  // namespace
 
 ServerPushFilter::ServerPushFilter(SpdyStream* stream, request_rec* request,
-                                   const SpdyServerConfig* server_cfg)
-    : stream_(stream), request_(request), server_cfg_(server_cfg) {
+                                   const SpdyServerConfig* server_cfg,
+                                   const std::string& scheme)
+    : stream_(stream), request_(request), server_cfg_(server_cfg),
+      scheme_(scheme), outcome_tracker_(NULL) {
   DCHECK(stream_);
   DCHECK(request_);
 }
@@ -110,11 +147,7 @@ ServerPushFilter::~ServerPushFilter() {}
 apr_status_t ServerPushFilter::Write(ap_filter_t* filter,
                                      apr_bucket_brigade* input_brigade) {
   DCHECK_EQ(request_, filter->r);
-  // We only do server pushes for SPDY v3 and later.  Also, to avoid infinite
-  // push loops, we don't allow push streams to invoke further push streams
-  // beyond a specified depth.
-  if (stream_->spdy_version() >= spdy::SPDY_VERSION_3 &&
-      stream_->server_push_depth() < server_cfg_->max_server_push_depth()) {
+  if (PushAllowed()) {
     // Parse and start pushes for each X-Associated-Content header, if any.
     // (Note that APR tables allow multiple entries with the same key, just
     // like HTTP headers.)
@@ -131,6 +164,13 @@ apr_status_t ServerPushFilter::Write(ap_filter_t* filter,
     // function call will put the header in err_headers_out.
     apr_table_do(OnXAssociatedContent, this, request_->err_headers_out,
                  http::kXAssociatedContent, NULL);
+    // Next, push resources named by Link: rel=preload headers.  Unlike
+    // X-Associated-Content, we leave these headers in place, since they mean
+    // something to the client too.
+    apr_table_do(OnLink, this, request_->headers_out, http::kLink, NULL);
+    apr_table_do(OnLink, this, request_->err_headers_out, http::kLink, NULL);
+    // Finally, push whatever the server's push manifest lists for this page.
+    PushFromManifest();
   }
   // Even in cases where we forbid pushes from this stream, we still purge the
   // X-Associated-Content header (from both headers_out and err_headers_out).
@@ -143,6 +183,15 @@ apr_status_t ServerPushFilter::Write(ap_filter_t* filter,
   return ap_pass_brigade(filter->next, input_brigade);
 }
 
+bool ServerPushFilter::PushAllowed() const {
+  return (stream_->spdy_version() >= spdy::SPDY_VERSION_3 &&
+          stream_->server_push_depth() < server_cfg_->max_server_push_depth());
+}
+
+net::SpdyPriority ServerPushFilter::LowestPriority() const {
+  return LowestSpdyPriorityForVersion(stream_->spdy_version());
+}
+
 void ServerPushFilter::ParseXAssociatedContentHeader(base::StringPiece value) {
   AbsorbWhiteSpace(&value);
   bool first_url = true;
@@ -168,88 +217,229 @@ void ServerPushFilter::ParseXAssociatedContentHeader(base::StringPiece value) {
     // not there, use the lowest-importance priority by default.
     net::SpdyPriority priority = ParseOptionalPriority(stream_, &value);
 
-    // Try to parse the URL string.  If it does not form a valid URL, log an
-    // error and skip past this entry.
-    apr_uri_t parsed_url;
-    {
-      const apr_status_t status =
-          apr_uri_parse(request_->pool, url.c_str(), &parsed_url);
-      if (status != APR_SUCCESS) {
-        LOG(ERROR) << "Invalid URL in X-Associated-Content: '" << url << "'";
-        continue;
-      }
+    // Try to perform the push.  If it succeeds (or this entry is merely
+    // skipped), we'll continue with parsing.
+    if (!StartPush(url, priority, http::kXAssociatedContent)) {
+      return;
+    }
+  }
+}
+
+void ServerPushFilter::ParseLinkHeader(base::StringPiece value) {
+  AbsorbWhiteSpace(&value);
+  bool first_link = true;
+
+  while (!value.empty()) {
+    // Link values are separated by commas.
+    if (first_link) {
+      first_link = false;
+    } else if (!ParseSeparator(',', &value)) {
+      LOG(INFO) << "Parse error in Link header: missing comma";
+      return;
     }
 
-    // Populate the fake request headers for the pushed stream.
-    net::SpdyHeaderBlock request_headers;
-    // Start off by pulling in certain headers from the associated stream's
-    // request headers.
-    apr_table_do(
-        AddOneHeader,          // function to call on each key/value pair
-        &request_headers,      // void* to be passed as first arg to function
-        request_->headers_in,  // the apr_table_t to iterate over
-        // Varargs: zero or more char* keys to iterate over, followed by NULL
-        "accept", "accept-charset", "accept-datetime",
-        mod_spdy::http::kAcceptEncoding, "accept-language", "authorization",
-        "user-agent", NULL);
-    // Next, we populate special SPDY headers, using a combination of pushed
-    // URL and details from the associated request.
-    if (parsed_url.hostinfo != NULL) {
-      request_headers[spdy::kSpdy3Host] = parsed_url.hostinfo;
-    } else {
-      const char* host_header =
-          apr_table_get(request_->headers_in, http::kHost);
-      request_headers[spdy::kSpdy3Host] =
-          (host_header != NULL ? host_header :
-           request_->hostname != NULL ? request_->hostname : "");
+    // Each link value starts with a URL in angle brackets...
+    if (!ParseSeparator('<', &value)) {
+      LOG(INFO) << "Parse error in Link header: expected '<'";
+      return;
+    }
+    const size_t close = value.find('>');
+    if (close == base::StringPiece::npos) {
+      LOG(INFO) << "Parse error in Link header: expected '>'";
+      return;
     }
-    request_headers[spdy::kSpdy3Method] = "GET";
-    request_headers[spdy::kSpdy3Scheme] =
-        (parsed_url.scheme != NULL ? parsed_url.scheme : "https");
-    request_headers[spdy::kSpdy3Version] = request_->protocol;
-    // Construct the path that we are pushing from the parsed URL.
-    // TODO(mdsteele): It'd be nice to support relative URLs.
-    {
-      std::string* path = &request_headers[spdy::kSpdy3Path];
-      path->assign(parsed_url.path == NULL ? "/" : parsed_url.path);
-      if (parsed_url.query != NULL) {
-        path->push_back('?');
-        path->append(parsed_url.query);
+    const std::string url = value.substr(0, close).as_string();
+    value = value.substr(close + 1);
+    AbsorbWhiteSpace(&value);
+
+    // ...followed by zero or more semicolon-separated parameters.
+    bool preload = false;
+    bool nopush = false;
+    std::string as;
+    while (ParseSeparator(';', &value)) {
+      std::string name, param_value;
+      if (!ParseLinkParam(&value, &name, &param_value)) {
+        LOG(INFO) << "Parse error in Link header: bad parameter";
+        return;
       }
-      if (parsed_url.fragment != NULL) {
-        // It's a little weird to try to push a URL with a fragment in it, but
-        // if someone does so anyway, we may as well honor it.
-        path->push_back('#');
-        path->append(parsed_url.fragment);
+      if (name == "rel") {
+        // The rel parameter may list several space-separated relation types.
+        std::vector<std::string> rels;
+        Tokenize(param_value, " \t", &rels);
+        for (size_t i = 0; i < rels.size(); ++i) {
+          preload |= LowerCaseEqualsASCII(rels[i], "preload");
+        }
+      } else if (name == "nopush") {
+        nopush = true;
+      } else if (name == "as") {
+        as = StringToLowerASCII(param_value);
       }
     }
-    // Finally, we set the HTTP referrer to be the associated stream's URL.
-    request_headers[http::kReferer] = request_->unparsed_uri;
-
-    // Try to perform the push.  If it succeeds, we'll continue with parsing.
-    const SpdyServerPushInterface::PushStatus status =
-        stream_->StartServerPush(priority, request_headers);
-    switch (status) {
-      case SpdyServerPushInterface::PUSH_STARTED:
-        break;  // success
-      case SpdyServerPushInterface::INVALID_REQUEST_HEADERS:
-        // This shouldn't happen unless there's a bug in the above code.
-        LOG(DFATAL) << "ParseAssociatedContent: invalid request headers";
-        return;
-      case SpdyServerPushInterface::ASSOCIATED_STREAM_INACTIVE:
-      case SpdyServerPushInterface::CANNOT_PUSH_EVER_AGAIN:
-      case SpdyServerPushInterface::TOO_MANY_CONCURRENT_PUSHES:
-      case SpdyServerPushInterface::PUSH_INTERNAL_ERROR:
-        // In any of these cases, any remaining pushes specified by the header
-        // are unlikely to succeed, so just stop parsing and quit.
-        LOG(INFO) << "Push failed while processing X-Associated-Content "
-                  << "header (status=" << status << ").  Skipping remainder.";
-        return;
-      default:
-        LOG(DFATAL) << "Invalid push status value: " << status;
-        return;
+
+    // Only preload links are pushed, and the "nopush" parameter lets the
+    // application ask the client to preload a resource without our pushing it
+    // (e.g. because it knows the client already has the resource cached).
+    if (!preload || nopush) {
+      continue;
+    }
+    // Stylesheets and scripts usually block rendering, so push them ahead of
+    // everything else, as the ServerPushDiscoveryLearner does.
+    const net::SpdyPriority priority =
+        (as == "style" || as == "script" ? 1 :
+         LowestSpdyPriorityForVersion(stream_->spdy_version()));
+    if (!StartSameOriginPush(url, priority, http::kLink)) {
+      return;
+    }
+  }
+}
+
+void ServerPushFilter::PushFromManifest() {
+  const ServerPushManifest* manifest = server_cfg_->server_push_manifest();
+  // Don't push the page's resources along with an error page or a redirect.
+  if (manifest == NULL || request_->uri == NULL ||
+      request_->status != HTTP_OK) {
+    return;
+  }
+  const std::vector<ServerPushManifest::Push>* pushes =
+      manifest->Lookup(request_->uri);
+  if (pushes == NULL) {
+    return;
+  }
+  const net::SpdyPriority lowest_priority =
+      LowestSpdyPriorityForVersion(stream_->spdy_version());
+  for (size_t i = 0; i < pushes->size(); ++i) {
+    const ServerPushManifest::Push& push = (*pushes)[i];
+    if (!StartSameOriginPush(push.url,
+                             std::min(push.priority, lowest_priority),
+                             "SpdyServerPushManifest")) {
+      return;
+    }
+  }
+}
+
+bool ServerPushFilter::StartSameOriginPush(const std::string& url,
+                                           net::SpdyPriority priority,
+                                           const char* source) {
+  const char* host_header = apr_table_get(request_->headers_in, http::kHost);
+  std::string path;
+  if (!HtmlSubresourceScanner::ResolveSameOriginUrl(
+          url, scheme_,
+          host_header != NULL ? host_header :
+          request_->hostname != NULL ? request_->hostname : "",
+          request_->uri != NULL ? request_->uri : "/",
+          &path)) {
+    VLOG(1) << "Not pushing off-origin URL in " << source << ": '" << url
+            << "'";
+    return true;  // skip this one, but carry on with the rest
+  }
+  return StartPush(path, priority, source);
+}
+
+bool ServerPushFilter::StartPush(const std::string& url,
+                                 net::SpdyPriority priority,
+                                 const char* source) {
+  // Try to parse the URL string.  If it does not form a valid URL, log an
+  // error and skip past this entry.
+  apr_uri_t parsed_url;
+  {
+    const apr_status_t status =
+        apr_uri_parse(request_->pool, url.c_str(), &parsed_url);
+    if (status != APR_SUCCESS) {
+      LOG(ERROR) << "Invalid URL in " << source << ": '" << url << "'";
+      return true;
     }
   }
+
+  // Populate the fake request headers for the pushed stream.
+  net::SpdyHeaderBlock request_headers;
+  // Start off by pulling in certain headers from the associated stream's
+  // request headers.
+  apr_table_do(
+      AddOneHeader,          // function to call on each key/value pair
+      &request_headers,      // void* to be passed as first arg to function
+      request_->headers_in,  // the apr_table_t to iterate over
+      // Varargs: zero or more char* keys to iterate over, followed by NULL
+      "accept", "accept-charset", "accept-datetime",
+      mod_spdy::http::kAcceptEncoding, "accept-language", "authorization",
+      "user-agent", NULL);
+  // Next, we populate special SPDY headers, using a combination of pushed
+  // URL and details from the associated request.
+  if (parsed_url.hostinfo != NULL) {
+    request_headers[spdy::kSpdy3Host] = parsed_url.hostinfo;
+  } else {
+    const char* host_header =
+        apr_table_get(request_->headers_in, http::kHost);
+    request_headers[spdy::kSpdy3Host] =
+        (host_header != NULL ? host_header :
+         request_->hostname != NULL ? request_->hostname : "");
+  }
+  request_headers[spdy::kSpdy3Method] = "GET";
+  request_headers[spdy::kSpdy3Scheme] =
+      (parsed_url.scheme != NULL ? parsed_url.scheme : scheme_);
+  request_headers[spdy::kSpdy3Version] = request_->protocol;
+  // Construct the path that we are pushing from the parsed URL.
+  // TODO(mdsteele): It'd be nice to support relative URLs.
+  {
+    std::string* path = &request_headers[spdy::kSpdy3Path];
+    path->assign(parsed_url.path == NULL ? "/" : parsed_url.path);
+    if (parsed_url.query != NULL) {
+      path->push_back('?');
+      path->append(parsed_url.query);
+    }
+    if (parsed_url.fragment != NULL) {
+      // It's a little weird to try to push a URL with a fragment in it, but
+      // if someone does so anyway, we may as well honor it.
+      path->push_back('#');
+      path->append(parsed_url.fragment);
+    }
+  }
+  // Finally, we set the HTTP referrer to be the associated stream's URL.
+  request_headers[http::kReferer] = request_->unparsed_uri;
+
+  // The same resource may well be named by more than one push source; only
+  // push it once.
+  if (!pushed_urls_.insert(request_headers[spdy::kSpdy3Host] +
+                           request_headers[spdy::kSpdy3Path]).second) {
+    return true;
+  }
+
+  // If clients usually cancel this push, don't waste our time on it; if
+  // they often do, at least don't let it compete with more useful pushes.
+  // The session records outcomes under the :host of the associated stream,
+  // which is what our Host header came from.
+  const char* master_host = apr_table_get(request_->headers_in, http::kHost);
+  if (outcome_tracker_ != NULL &&
+      !outcome_tracker_->ShouldPush(
+          master_host != NULL ? master_host : "",
+          request_->unparsed_uri, request_headers[spdy::kSpdy3Path],
+          LowestSpdyPriorityForVersion(stream_->spdy_version()),
+          &priority)) {
+    return true;
+  }
+
+  // Try to perform the push.
+  const SpdyServerPushInterface::PushStatus status =
+      stream_->StartServerPush(priority, request_headers);
+  switch (status) {
+    case SpdyServerPushInterface::PUSH_STARTED:
+      return true;  // success
+    case SpdyServerPushInterface::INVALID_REQUEST_HEADERS:
+      // This shouldn't happen unless there's a bug in the above code.
+      LOG(DFATAL) << "StartPush: invalid request headers";
+      return false;
+    case SpdyServerPushInterface::ASSOCIATED_STREAM_INACTIVE:
+    case SpdyServerPushInterface::CANNOT_PUSH_EVER_AGAIN:
+    case SpdyServerPushInterface::TOO_MANY_CONCURRENT_PUSHES:
+    case SpdyServerPushInterface::PUSH_INTERNAL_ERROR:
+      // In any of these cases, any remaining pushes specified by the source
+      // are unlikely to succeed, so just stop parsing and quit.
+      LOG(INFO) << "Push failed while processing " << source
+                << " (status=" << status << ").  Skipping remainder.";
+      return false;
+    default:
+      LOG(DFATAL) << "Invalid push status value: " << status;
+      return false;
+  }
 }
 
 // static
@@ -260,4 +450,11 @@ int ServerPushFilter::OnXAssociatedContent(
   return 1;  // return zero to stop, or non-zero to continue iterating
 }
 
+// static
+int ServerPushFilter::OnLink(
+    void* server_push_filter, const char* key, const char* value) {
+  static_cast<ServerPushFilter*>(server_push_filter)->ParseLinkHeader(value);
+  return 1;  // return zero to stop, or non-zero to continue iterating
+}
+
 }  // namespace mod_spdy
@@ -15,6 +15,7 @@
 #ifndef MOD_SPDY_APACHE_FILTERS_SERVER_PUSH_FILTER_H_
 #define MOD_SPDY_APACHE_FILTERS_SERVER_PUSH_FILTER_H_
 
+#include <set>
 #include <string>
 
 #include "apr_buckets.h"
@@ -23,27 +24,58 @@
 #include "base/basictypes.h"
 #include "base/strings/string_piece.h"
 #include "mod_spdy/common/spdy_server_config.h"
+#include "net/spdy/spdy_protocol.h"
 
 
 namespace mod_spdy {
 
+class ServerPushOutcomeTracker;
 class SpdyStream;
 
 // An Apache filter for initiating SPDY server pushes based on the
 // X-Associated-Content response header, which may be set by e.g. mod_headers
-// or a CGI script.
+// or a CGI script; on Link response headers with rel=preload; and on the
+// server's push manifest (see the SpdyServerPushManifest directive).
 class ServerPushFilter {
  public:
-  // Does not take ownership of either argument.
+  // Does not take ownership of the stream, request or config.  The scheme
+  // ("http" or "https") is that of the connection, and is assumed for pushed
+  // URLs that don't name one.
   ServerPushFilter(SpdyStream* stream, request_rec* request,
-                   const SpdyServerConfig* server_cfg);
+                   const SpdyServerConfig* server_cfg,
+                   const std::string& scheme);
   ~ServerPushFilter();
 
+  // Consult the given tracker before starting each push, skipping pushes that
+  // clients usually cancel and demoting those they often cancel.  Does not
+  // take ownership of the tracker.  This is optional.
+  void set_outcome_tracker(const ServerPushOutcomeTracker* tracker) {
+    outcome_tracker_ = tracker;
+  }
+
   // Read data from the given brigade and write the result through the given
   // filter.  This filter doesn't touch the data; it only looks at the request
   // headers.
   apr_status_t Write(ap_filter_t* filter, apr_bucket_brigade* input_brigade);
 
+  // Return true if this request's stream may initiate server pushes at all.
+  // We only do server pushes for SPDY v3 and later, and to avoid infinite
+  // push loops, we don't allow push streams to invoke further push streams
+  // beyond the configured depth.
+  bool PushAllowed() const;
+
+  // Return the lowest push priority for this stream's SPDY version.
+  net::SpdyPriority LowestPriority() const;
+
+  // Initiate a server push of the given URL (named by the given source, for
+  // logging purposes), unless it has already been pushed for this request or
+  // the client is likely to cancel it.  Return false if no further pushes
+  // from this source should be attempted.  Other filters (such as the
+  // SubresourcePushFilter) may call this too, so that all of a request's
+  // pushes are deduplicated together.
+  bool StartPush(const std::string& url, net::SpdyPriority priority,
+                 const char* source);
+
  private:
   // Parse the value of an X-Associated-Content header, and initiate any
   // specified server pushes.  The expected format of the header value is a
@@ -61,9 +93,34 @@ class ServerPushFilter {
   // a ServerPushFilter; this will call ParseXAssociatedContentHeader on it.
   static int OnXAssociatedContent(void*, const char*, const char*);
 
+  // Parse the value of a Link header (RFC 5988), and initiate a server push
+  // for each link with rel=preload, unless the link also has the "nopush"
+  // parameter.  Links to stylesheets and scripts (as=style or as=script) are
+  // pushed at a high priority, and others at the lowest.  For example:
+  //
+  //   Link: </css/site.css>; rel=preload; as=style, </logo.png>; rel=preload
+  void ParseLinkHeader(base::StringPiece value);
+  // Utility function passed to apr_table_do.  The first argument must point to
+  // a ServerPushFilter; this will call ParseLinkHeader on it.
+  static int OnLink(void*, const char*, const char*);
+
+  // Initiate server pushes for any resources that the server's push manifest
+  // lists for this request's path.
+  void PushFromManifest();
+
+  // Like StartPush, but only for URLs on the same origin as this request;
+  // relative URLs are resolved against the request's path, and URLs on any
+  // other origin are skipped, so that Link headers and the push manifest
+  // can't make us push (or hand the client's credentials to) another host.
+  bool StartSameOriginPush(const std::string& url, net::SpdyPriority priority,
+                           const char* source);
+
   SpdyStream* const stream_;
   request_rec* const request_;
   const SpdyServerConfig* server_cfg_;
+  const std::string scheme_;
+  const ServerPushOutcomeTracker* outcome_tracker_;  // may be NULL
+  std::set<std::string> pushed_urls_;  // host + path of each push so far
 
   DISALLOW_COPY_AND_ASSIGN(ServerPushFilter);
 };
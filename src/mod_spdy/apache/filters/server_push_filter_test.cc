@@ -24,6 +24,7 @@
 #include "base/strings/string_piece.h"
 #include "mod_spdy/apache/pool_util.h"
 #include "mod_spdy/common/protocol_util.h"
+#include "mod_spdy/common/server_push_manifest.h"
 #include "mod_spdy/common/shared_flow_control_window.h"
 #include "mod_spdy/common/spdy_frame_priority_queue.h"
 #include "mod_spdy/common/spdy_server_config.h"
@@ -34,6 +35,7 @@
 #include "testing/gtest/include/gtest/gtest.h"
 
 using testing::_;
+using testing::AllOf;
 using testing::Contains;
 using testing::Eq;
 using testing::Pair;
@@ -127,7 +129,8 @@ TEST_P(ServerPushFilterTest, SimpleXAssociatedContent) {
       spdy_version_, stream_id, associated_stream_id,
       initial_server_push_depth, priority, net::kSpdyStreamInitialWindowSize,
       &output_queue_, &shared_window_, &pusher_);
-  mod_spdy::ServerPushFilter server_push_filter(&stream, request_, &server_cfg);
+  mod_spdy::ServerPushFilter server_push_filter(
+      &stream, request_, &server_cfg, "https");
 
   net::SpdyHeaderBlock headers1;
   headers1[mod_spdy::spdy::kSpdy3Host] = "www.example.com";
@@ -181,7 +184,8 @@ TEST_P(ServerPushFilterTest, MultipleXAssociatedContentHeaders) {
       spdy_version_, stream_id, associated_stream_id,
       initial_server_push_depth, priority, net::kSpdyStreamInitialWindowSize,
       &output_queue_, &shared_window_, &pusher_);
-  mod_spdy::ServerPushFilter server_push_filter(&stream, request_, &server_cfg);
+  mod_spdy::ServerPushFilter server_push_filter(
+      &stream, request_, &server_cfg, "https");
   const net::SpdyPriority lowest =
       mod_spdy::LowestSpdyPriorityForVersion(stream.spdy_version());
 
@@ -248,7 +252,8 @@ TEST_P(ServerPushFilterTest, CaseInsensitive) {
       spdy_version_, stream_id, associated_stream_id,
       initial_server_push_depth, priority, net::kSpdyStreamInitialWindowSize,
       &output_queue_, &shared_window_, &pusher_);
-  mod_spdy::ServerPushFilter server_push_filter(&stream, request_, &server_cfg);
+  mod_spdy::ServerPushFilter server_push_filter(
+      &stream, request_, &server_cfg, "https");
 
   EXPECT_CALL(pusher_, StartServerPush(Eq(stream_id), _, _, Contains(
       Pair(mod_spdy::spdy::kSpdy3Path, "/x1.png"))));
@@ -286,7 +291,8 @@ TEST_P(ServerPushFilterTest, CopyApplicableHeaders) {
       spdy_version_, stream_id, associated_stream_id,
       initial_server_push_depth, priority, net::kSpdyStreamInitialWindowSize,
       &output_queue_, &shared_window_, &pusher_);
-  mod_spdy::ServerPushFilter server_push_filter(&stream, request_, &server_cfg);
+  mod_spdy::ServerPushFilter server_push_filter(
+      &stream, request_, &server_cfg, "https");
 
   // Set some extra headers on the original request (which was evidentally a
   // POST).  The Accept-Language header should get copied over for the push,
@@ -320,7 +326,8 @@ TEST_P(ServerPushFilterTest, StopPushingAfterPushError) {
       spdy_version_, stream_id, associated_stream_id,
       initial_server_push_depth, priority, net::kSpdyStreamInitialWindowSize,
       &output_queue_, &shared_window_, &pusher_);
-  mod_spdy::ServerPushFilter server_push_filter(&stream, request_, &server_cfg);
+  mod_spdy::ServerPushFilter server_push_filter(
+      &stream, request_, &server_cfg, "https");
 
   // When the filter tries to push the first resource, we reply that pushes are
   // no longer possible on this connection.  The filter should not attempt any
@@ -351,7 +358,8 @@ TEST_P(ServerPushFilterTest, StopPushingAfterParseError) {
       spdy_version_, stream_id, associated_stream_id,
       initial_server_push_depth, priority, net::kSpdyStreamInitialWindowSize,
       &output_queue_, &shared_window_, &pusher_);
-  mod_spdy::ServerPushFilter server_push_filter(&stream, request_, &server_cfg);
+  mod_spdy::ServerPushFilter server_push_filter(
+      &stream, request_, &server_cfg, "https");
 
   // The filter should push the first resource, but then stop when it gets to
   // the parse error.
@@ -378,7 +386,8 @@ TEST_P(ServerPushFilterTest, SkipInvalidQuotedUrl) {
       spdy_version_, stream_id, associated_stream_id,
       initial_server_push_depth, priority, net::kSpdyStreamInitialWindowSize,
       &output_queue_, &shared_window_, &pusher_);
-  mod_spdy::ServerPushFilter server_push_filter(&stream, request_, &server_cfg);
+  mod_spdy::ServerPushFilter server_push_filter(
+      &stream, request_, &server_cfg, "https");
 
   // The filter should push the first and third resources, but skip the second
   // one because its quoted URL is invalid.
@@ -409,7 +418,8 @@ TEST_P(ServerPushFilterTest, MaxServerPushDepthLimit) {
       spdy_version_, stream_id, associated_stream_id,
       initial_server_push_depth, priority, net::kSpdyStreamInitialWindowSize,
       &output_queue_, &shared_window_, &pusher_);
-  mod_spdy::ServerPushFilter server_push_filter(&stream, request_, &server_cfg);
+  mod_spdy::ServerPushFilter server_push_filter(
+      &stream, request_, &server_cfg, "https");
 
   // We should not get any calls to StartServerPush, because we do not allow
   // server-pushed resources to push any more resources.
@@ -435,7 +445,7 @@ TEST_P(ServerPushFilterTest, MaxServerPushDepthLimit) {
       initial_server_push_depth_2, priority, net::kSpdyStreamInitialWindowSize,
       &output_queue_, &shared_window_, &pusher_);
   mod_spdy::ServerPushFilter server_push_filter_2(
-      &stream_2, request_, &server_cfg_2);
+      &stream_2, request_, &server_cfg_2, "https");
 
   // We should not get any calls to StartServerPush, because we do not allow
   // server-pushed resources to push any more resources.
@@ -451,6 +461,187 @@ TEST_P(ServerPushFilterTest, MaxServerPushDepthLimit) {
                             mod_spdy::http::kXAssociatedContent) == NULL);
 }
 
+// Test that Link headers with rel=preload start pushes, but other links, and
+// preload links marked nopush, don't.
+TEST_P(ServerPushFilterTest, LinkPreload) {
+  const net::SpdyStreamId stream_id = 3;
+  const net::SpdyStreamId associated_stream_id = 0;
+  const int32 initial_server_push_depth = 0;
+  const net::SpdyPriority priority = 1;
+  const mod_spdy::SpdyServerConfig server_cfg;
+  mod_spdy::SpdyStream stream(
+      spdy_version_, stream_id, associated_stream_id,
+      initial_server_push_depth, priority, net::kSpdyStreamInitialWindowSize,
+      &output_queue_, &shared_window_, &pusher_);
+  mod_spdy::ServerPushFilter server_push_filter(
+      &stream, request_, &server_cfg, "https");
+  const net::SpdyPriority lowest =
+      mod_spdy::LowestSpdyPriorityForVersion(stream.spdy_version());
+
+  EXPECT_CALL(pusher_, StartServerPush(
+      Eq(stream_id), Eq(initial_server_push_depth + 1), Eq(1u),
+      Contains(Pair(mod_spdy::spdy::kSpdy3Path, "/css/site.css"))));
+  EXPECT_CALL(pusher_, StartServerPush(
+      Eq(stream_id), Eq(initial_server_push_depth + 1), Eq(lowest),
+      Contains(Pair(mod_spdy::spdy::kSpdy3Path, "/logo.png"))));
+  EXPECT_CALL(pusher_, StartServerPush(
+      Eq(stream_id), Eq(initial_server_push_depth + 1), Eq(1u),
+      Contains(Pair(mod_spdy::spdy::kSpdy3Path, "/js/app.js"))));
+
+  apr_table_addn(request_->headers_out, mod_spdy::http::kLink,
+                 "</css/site.css>; rel=preload; as=style, "
+                 "</logo.png>;rel=\"prefetch preload\", "
+                 "</next.html>; rel=next");
+  apr_table_addn(request_->err_headers_out, mod_spdy::http::kLink,
+                 "</js/app.js>; as=\"script\"; rel=preload, "
+                 "</cached.js>; rel=preload; nopush, "
+                 "</css/site.css>; rel=preload; as=style");
+  WriteBrigade(&server_push_filter);
+  // The Link headers are left for the client.
+  EXPECT_TRUE(apr_table_get(request_->headers_out,
+                            mod_spdy::http::kLink) != NULL);
+  EXPECT_TRUE(apr_table_get(request_->err_headers_out,
+                            mod_spdy::http::kLink) != NULL);
+}
+
+// Test that Link headers only push resources on the request's own origin,
+// resolving relative URLs against the request's path.
+TEST_P(ServerPushFilterTest, LinkPreloadSameOriginOnly) {
+  const net::SpdyStreamId stream_id = 3;
+  const net::SpdyStreamId associated_stream_id = 0;
+  const int32 initial_server_push_depth = 0;
+  const net::SpdyPriority priority = 1;
+  const mod_spdy::SpdyServerConfig server_cfg;
+  mod_spdy::SpdyStream stream(
+      spdy_version_, stream_id, associated_stream_id,
+      initial_server_push_depth, priority, net::kSpdyStreamInitialWindowSize,
+      &output_queue_, &shared_window_, &pusher_);
+  mod_spdy::ServerPushFilter server_push_filter(
+      &stream, request_, &server_cfg, "https");
+  request_->uri = const_cast<char*>("/dir/page.html");
+
+  EXPECT_CALL(pusher_, StartServerPush(
+      Eq(stream_id), Eq(initial_server_push_depth + 1), Eq(1u),
+      Contains(Pair(mod_spdy::spdy::kSpdy3Path, "/dir/js/app.js"))));
+  EXPECT_CALL(pusher_, StartServerPush(
+      Eq(stream_id), Eq(initial_server_push_depth + 1), Eq(1u),
+      Contains(Pair(mod_spdy::spdy::kSpdy3Path, "/css/site.css"))));
+  EXPECT_CALL(pusher_, StartServerPush(
+      _, _, _, Contains(Pair(mod_spdy::spdy::kSpdy3Host, "cdn.example.com"))))
+      .Times(0);
+
+  apr_table_addn(request_->headers_out, mod_spdy::http::kLink,
+                 "<js/app.js>; rel=preload; as=script, "
+                 "<https://cdn.example.com/lib.js>; rel=preload; as=script, "
+                 "<//cdn.example.com/lib.css>; rel=preload; as=style, "
+                 "<https://www.example.com/css/site.css>; rel=preload; "
+                 "as=style");
+  WriteBrigade(&server_push_filter);
+}
+
+// Test that on a plaintext connection, absolute http: URLs on the same host
+// count as same-origin (and https: ones don't), and that pushes are made with
+// the connection's scheme.
+TEST_P(ServerPushFilterTest, LinkPreloadSameOriginPlaintext) {
+  const net::SpdyStreamId stream_id = 3;
+  const net::SpdyStreamId associated_stream_id = 0;
+  const int32 initial_server_push_depth = 0;
+  const net::SpdyPriority priority = 1;
+  const mod_spdy::SpdyServerConfig server_cfg;
+  mod_spdy::SpdyStream stream(
+      spdy_version_, stream_id, associated_stream_id,
+      initial_server_push_depth, priority, net::kSpdyStreamInitialWindowSize,
+      &output_queue_, &shared_window_, &pusher_);
+  mod_spdy::ServerPushFilter server_push_filter(
+      &stream, request_, &server_cfg, "http");
+  request_->uri = const_cast<char*>("/dir/page.html");
+
+  EXPECT_CALL(pusher_, StartServerPush(
+      Eq(stream_id), Eq(initial_server_push_depth + 1), Eq(1u),
+      AllOf(Contains(Pair(mod_spdy::spdy::kSpdy3Path, "/dir/js/app.js")),
+            Contains(Pair(mod_spdy::spdy::kSpdy3Scheme, "http")))));
+  EXPECT_CALL(pusher_, StartServerPush(
+      Eq(stream_id), Eq(initial_server_push_depth + 1), Eq(1u),
+      AllOf(Contains(Pair(mod_spdy::spdy::kSpdy3Path, "/css/site.css")),
+            Contains(Pair(mod_spdy::spdy::kSpdy3Scheme, "http")))));
+  EXPECT_CALL(pusher_, StartServerPush(
+      _, _, _, Contains(Pair(mod_spdy::spdy::kSpdy3Path, "/css/secure.css"))))
+      .Times(0);
+
+  apr_table_addn(request_->headers_out, mod_spdy::http::kLink,
+                 "<js/app.js>; rel=preload; as=script, "
+                 "<http://www.example.com/css/site.css>; rel=preload; "
+                 "as=style, "
+                 "<https://www.example.com/css/secure.css>; rel=preload; "
+                 "as=style");
+  WriteBrigade(&server_push_filter);
+}
+
+// Test that resources listed in the push manifest are pushed for successful
+// responses.
+TEST_P(ServerPushFilterTest, PushManifest) {
+  const net::SpdyStreamId stream_id = 3;
+  const net::SpdyStreamId associated_stream_id = 0;
+  const int32 initial_server_push_depth = 0;
+  const net::SpdyPriority priority = 1;
+  mod_spdy::ServerPushManifest manifest;
+  std::string error;
+  ASSERT_TRUE(manifest.AddRulesFromString(
+      "/index.html /css/site.css 2\n"
+      "/index.html /js/app.js\n"
+      "/index.html https://cdn.example.com/lib.js\n"
+      "/other/* /other.css\n", &error));
+  mod_spdy::SpdyServerConfig server_cfg;
+  server_cfg.set_server_push_manifest(&manifest);
+  mod_spdy::SpdyStream stream(
+      spdy_version_, stream_id, associated_stream_id,
+      initial_server_push_depth, priority, net::kSpdyStreamInitialWindowSize,
+      &output_queue_, &shared_window_, &pusher_);
+  mod_spdy::ServerPushFilter server_push_filter(
+      &stream, request_, &server_cfg, "https");
+  request_->uri = const_cast<char*>("/index.html");
+  request_->status = HTTP_OK;
+
+  testing::Sequence s1;
+  // Resources named both by the page and by the manifest are pushed once,
+  // and the manifest's off-origin resource isn't pushed at all.
+  EXPECT_CALL(pusher_, StartServerPush(
+      Eq(stream_id), Eq(initial_server_push_depth + 1), Eq(0u),
+      Contains(Pair(mod_spdy::spdy::kSpdy3Path, "/js/app.js"))))
+      .InSequence(s1);
+  EXPECT_CALL(pusher_, StartServerPush(
+      Eq(stream_id), Eq(initial_server_push_depth + 1), Eq(2u),
+      Contains(Pair(mod_spdy::spdy::kSpdy3Path, "/css/site.css"))))
+      .InSequence(s1);
+
+  apr_table_setn(request_->headers_out, mod_spdy::http::kXAssociatedContent,
+                 "\"/js/app.js\":0");
+  WriteBrigade(&server_push_filter);
+}
+
+// Test that the push manifest is not used for error responses.
+TEST_P(ServerPushFilterTest, NoManifestPushesForErrors) {
+  const net::SpdyStreamId stream_id = 3;
+  const net::SpdyStreamId associated_stream_id = 0;
+  const int32 initial_server_push_depth = 0;
+  const net::SpdyPriority priority = 1;
+  mod_spdy::ServerPushManifest manifest;
+  manifest.AddRule("/*", mod_spdy::ServerPushManifest::Push("/site.css", 1));
+  mod_spdy::SpdyServerConfig server_cfg;
+  server_cfg.set_server_push_manifest(&manifest);
+  mod_spdy::SpdyStream stream(
+      spdy_version_, stream_id, associated_stream_id,
+      initial_server_push_depth, priority, net::kSpdyStreamInitialWindowSize,
+      &output_queue_, &shared_window_, &pusher_);
+  mod_spdy::ServerPushFilter server_push_filter(
+      &stream, request_, &server_cfg, "https");
+  request_->uri = const_cast<char*>("/missing.html");
+  request_->status = HTTP_NOT_FOUND;
+
+  EXPECT_CALL(pusher_, StartServerPush(_,_,_,_)).Times(0);
+  WriteBrigade(&server_push_filter);
+}
+
 // Run server push tests only over SPDY v3.
 INSTANTIATE_TEST_CASE_P(Spdy3, ServerPushFilterTest, testing::Values(
     mod_spdy::spdy::SPDY_VERSION_3, mod_spdy::spdy::SPDY_VERSION_3_1));
@@ -469,7 +660,8 @@ TEST_P(ServerPushFilterSpdy2Test, NoPushesForSpdy2) {
       spdy_version_, stream_id, associated_stream_id,
       initial_server_push_depth, priority, net::kSpdyStreamInitialWindowSize,
       &output_queue_, &shared_window_, &pusher_);
-  mod_spdy::ServerPushFilter server_push_filter(&stream, request_, &server_cfg);
+  mod_spdy::ServerPushFilter server_push_filter(
+      &stream, request_, &server_cfg, "https");
 
   // We should not get any calls to StartServerPush when we're on SPDY/2.
 
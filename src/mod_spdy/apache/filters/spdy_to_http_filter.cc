@@ -14,9 +14,14 @@
 
 #include "mod_spdy/apache/filters/spdy_to_http_filter.h"
 
+#include <cstring>
 #include <map>
 #include <string>
 
+#include "apr_buckets.h"
+#include "apr_file_io.h"
+#include "apr_strings.h"
+
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/strings/string_piece.h"
@@ -33,18 +38,86 @@ namespace {
 // without seeing a linebreak, just give up and return what we have.
 const size_t kGetlineThreshold = 4096;
 
+// Once we have this much data buffered that Apache hasn't asked for yet,
+// write any further request body data to a temporary file instead of keeping
+// it in memory.
+const size_t kSpillToFileThreshold = 1024 * 1024;
+
+// A bucket type for request body data that is still in the SPDY DATA frame
+// it arrived in.  The bucket owns the frame, and (as with heap buckets)
+// copies and splits of the bucket share it, so the data never needs to be
+// copied, even when Apache sets the bucket aside.
+struct SpdyDataBucket {
+  apr_bucket_refcount refcount;  // must be first; see apr_bucket_shared_make
+  net::SpdyFrameIR* frame;
+  const char* data;  // points into the frame
+};
+
+void SpdyDataBucketDestroy(void* data) {
+  SpdyDataBucket* spdy_data = static_cast<SpdyDataBucket*>(data);
+  if (apr_bucket_shared_destroy(spdy_data)) {
+    delete spdy_data->frame;
+    apr_bucket_free(spdy_data);
+  }
+}
+
+apr_status_t SpdyDataBucketRead(apr_bucket* bucket, const char** str,
+                                apr_size_t* len, apr_read_type_e block) {
+  const SpdyDataBucket* spdy_data =
+      static_cast<const SpdyDataBucket*>(bucket->data);
+  *str = spdy_data->data + bucket->start;
+  *len = bucket->length;
+  return APR_SUCCESS;
+}
+
+const apr_bucket_type_t kSpdyDataBucketType = {
+  "SPDY_DATA", 5, apr_bucket_type_t::APR_BUCKET_DATA,
+  SpdyDataBucketDestroy,
+  SpdyDataBucketRead,
+  apr_bucket_setaside_noop,
+  apr_bucket_shared_split,
+  apr_bucket_shared_copy
+};
+
+// Create a bucket for the given data, taking ownership of the frame that
+// contains it.
+apr_bucket* SpdyDataBucketCreate(net::SpdyFrameIR* frame,
+                                 const base::StringPiece& data,
+                                 apr_bucket_alloc_t* list) {
+  apr_bucket* bucket =
+      static_cast<apr_bucket*>(apr_bucket_alloc(sizeof(*bucket), list));
+  APR_BUCKET_INIT(bucket);
+  bucket->free = apr_bucket_free;
+  bucket->list = list;
+  SpdyDataBucket* spdy_data = static_cast<SpdyDataBucket*>(
+      apr_bucket_alloc(sizeof(*spdy_data), list));
+  spdy_data->frame = frame;
+  spdy_data->data = data.data();
+  apr_bucket_shared_make(bucket, spdy_data, 0, data.size());
+  bucket->type = &kSpdyDataBucketType;
+  return bucket;
+}
+
 }  // namespace
 
 namespace mod_spdy {
 
 SpdyToHttpFilter::SpdyToHttpFilter(SpdyStream* stream)
     : stream_(stream),
-      visitor_(&data_buffer_),
+      visitor_(&text_, this),
       converter_(stream_->spdy_version(), &visitor_),
-      next_read_start_(0) {
+      pool_(NULL),
+      buffered_(NULL),
+      buffered_bytes_(0),
+      spill_file_(NULL),
+      spill_file_size_(0),
+      spill_file_failed_(false) {
   DCHECK(stream_ != NULL);
 }
 
+// Note that we leave buffered_ (and spill_file_) alone here; they belong to
+// the slave connection's pool, which may already have been destroyed, and
+// will otherwise clean them up (and delete any frames in buffered_) itself.
 SpdyToHttpFilter::~SpdyToHttpFilter() {}
 
 // Macro to check if the SPDY stream has been aborted; if so, mark the
@@ -83,11 +156,10 @@ apr_status_t SpdyToHttpFilter::Read(ap_filter_t *filter,
                  << "(it is followed by " << filter->next->frec->name << ")";
   }
 
-  // Clear any buffer data that was already returned on a previous invocation
-  // of this filter.
-  if (next_read_start_ > 0) {
-    data_buffer_.erase(0, next_read_start_);
-    next_read_start_ = 0;
+  // Set up our buffer the first time we're called.
+  if (buffered_ == NULL) {
+    pool_ = filter->c->pool;
+    buffered_ = apr_brigade_create(pool_, filter->c->bucket_alloc);
   }
 
   // We don't need to do anything for AP_MODE_INIT.  (We check this case before
@@ -99,7 +171,7 @@ apr_status_t SpdyToHttpFilter::Read(ap_filter_t *filter,
 
   // If there will never be any more data on this stream, return EOF.  (That's
   // what ap_core_input_filter() in core_filters.c does.)
-  if (end_of_stream_reached() && data_buffer_.empty()) {
+  if (end_of_stream_reached() && buffered_bytes_ == 0) {
     return APR_EOF;
   }
 
@@ -118,7 +190,7 @@ apr_status_t SpdyToHttpFilter::Read(ap_filter_t *filter,
   if (mode == AP_MODE_READBYTES || mode == AP_MODE_SPECULATIVE ||
       mode == AP_MODE_EXHAUSTIVE) {
     // Try to get as much data as we were asked for.
-    while (max_bytes > data_buffer_.size() || mode == AP_MODE_EXHAUSTIVE) {
+    while (max_bytes > buffered_bytes_ || mode == AP_MODE_EXHAUSTIVE) {
       const bool got_frame = GetNextFrame(block);
       RETURN_IF_STREAM_ABORT(filter, brigade);
       if (!got_frame) {
@@ -127,7 +199,7 @@ apr_status_t SpdyToHttpFilter::Read(ap_filter_t *filter,
     }
 
     // Return however much data we read, but no more than they asked for.
-    bytes_read = data_buffer_.size();
+    bytes_read = buffered_bytes_;
     if (mode != AP_MODE_EXHAUSTIVE && max_bytes < bytes_read) {
       bytes_read = max_bytes;
     }
@@ -138,15 +210,15 @@ apr_status_t SpdyToHttpFilter::Read(ap_filter_t *filter,
     size_t linebreak = std::string::npos;
     size_t start = 0;
     while (true) {
-      linebreak = data_buffer_.find('\n', start);
+      linebreak = FindLinebreak(start);
       // Stop if we find a linebreak, or if we've pulled too much data already.
       if (linebreak != std::string::npos ||
-          data_buffer_.size() >= kGetlineThreshold) {
+          buffered_bytes_ >= kGetlineThreshold) {
         break;
       }
       // Remember where we left off so we don't have to re-scan the whole
       // buffer on the next iteration.
-      start = data_buffer_.size();
+      start = buffered_bytes_;
       // We haven't seen a linebreak yet, so try to get more data.
       const bool got_frame = GetNextFrame(block);
       RETURN_IF_STREAM_ABORT(filter, brigade);
@@ -158,7 +230,7 @@ apr_status_t SpdyToHttpFilter::Read(ap_filter_t *filter,
     // If we found a linebreak, return data up to and including that linebreak.
     // Otherwise, just send whatever we were able to get.
     bytes_read = (linebreak == std::string::npos ?
-                  data_buffer_.size() : linebreak + 1);
+                  buffered_bytes_ : linebreak + 1);
   }
   // We don't support AP_MODE_EATCRLF.  Doing so would be tricky, and probably
   // totally pointless.  But if we ever decide to implement it, see
@@ -174,17 +246,21 @@ apr_status_t SpdyToHttpFilter::Read(ap_filter_t *filter,
   // Keep track of whether we were able to put any buckets into the brigade.
   bool success = false;
 
-  // If we managed to read any data, put it into the brigade.  We use a
-  // transient bucket (as opposed to a heap bucket) to avoid an extra string
-  // copy.
+  // If this is the last bit of data from this stream, we'll send an EOS
+  // bucket after it.
+  const bool send_eos =
+      end_of_stream_reached() && bytes_read == buffered_bytes_;
+
+  // If we managed to read any data, put it into the brigade.  For a
+  // speculative read, we give out copies of our buckets (which share their
+  // data with the originals), since we must return the same data again next
+  // time; otherwise, we can just hand over the buckets themselves.
   if (bytes_read > 0) {
-    APR_BRIGADE_INSERT_TAIL(brigade, apr_bucket_transient_create(
-        data_buffer_.data(), bytes_read, brigade->bucket_alloc));
+    TakeBufferedData(bytes_read, mode == AP_MODE_SPECULATIVE, brigade);
     success = true;
   }
 
-  // If this is the last bit of data from this stream, send an EOS bucket.
-  if (end_of_stream_reached() && bytes_read == data_buffer_.size()) {
+  if (send_eos) {
     APR_BRIGADE_INSERT_TAIL(brigade, apr_bucket_eos_create(
         brigade->bucket_alloc));
     success = true;
@@ -196,14 +272,6 @@ apr_status_t SpdyToHttpFilter::Read(ap_filter_t *filter,
     return APR_EAGAIN;
   }
 
-  // Unless this is a speculative read, we should skip past the bytes we read
-  // next time this filter is invoked.  We don't want to erase those bytes
-  // yet, though, so that we can return them to the previous filter in a
-  // transient bucket.
-  if (mode != AP_MODE_SPECULATIVE) {
-    next_read_start_ = bytes_read;
-  }
-
   return APR_SUCCESS;
 }
 
@@ -244,6 +312,19 @@ void SpdyToHttpFilter::DecodeFrameVisitor::VisitData(
   success_ = filter_->DecodeDataFrame(frame);
 }
 
+SpdyToHttpFilter::BodyDataBuilder::BodyDataBuilder(
+    std::string* str, SpdyToHttpFilter* filter)
+    : HttpStringBuilder(str), filter_(filter) {
+  DCHECK(filter_);
+}
+
+SpdyToHttpFilter::BodyDataBuilder::~BodyDataBuilder() {}
+
+void SpdyToHttpFilter::BodyDataBuilder::AppendBodyData(
+    const base::StringPiece& data) {
+  filter_->AppendBodyData(data);
+}
+
 void SpdyToHttpFilter::DecodeFrameVisitor::BadFrameType(
     const char* frame_type) {
   LOG(DFATAL) << "Master connection sent a " << frame_type
@@ -258,20 +339,23 @@ bool SpdyToHttpFilter::GetNextFrame(apr_read_type_e block) {
   }
 
   // Try to get the next SPDY frame from the stream.
-  scoped_ptr<net::SpdyFrameIR> frame;
   {
     net::SpdyFrameIR* frame_ptr = NULL;
     if (!stream_->GetInputFrame(block == APR_BLOCK_READ, &frame_ptr)) {
       DCHECK(frame_ptr == NULL);
       return false;
     }
-    frame.reset(frame_ptr);
+    frame_.reset(frame_ptr);
   }
-  DCHECK(frame.get() != NULL);
+  DCHECK(frame_.get() != NULL);
 
-  // Decode the frame into HTTP and append to the data buffer.
+  // Decode the frame into HTTP and append to the data buffer.  If the frame
+  // carries request body data, a bucket in buffered_ will take it over from
+  // frame_; otherwise, we're done with it now.
   DecodeFrameVisitor visitor(this);
-  frame->Visit(&visitor);
+  frame_->Visit(&visitor);
+  frame_.reset();
+  FlushText();
   return visitor.success();
 }
 
@@ -345,7 +429,7 @@ bool SpdyToHttpFilter::DecodeDataFrame(const net::SpdyDataIR& frame) {
       //   shouldn't send the WINDOW_UPDATE until we're about to return the
       //   data to the previous filter, so that we're aren't buffering an
       //   unbounded amount of data in this filter.  The trouble is that once
-      //   we convert the frames, everything goes into data_buffer_ and we
+      //   we convert the frames, everything goes into buffered_ and we
       //   forget which of it is leading/trailing headers and which of it is
       //   request data, so it'll take a little work to know when to send the
       //   WINDOW_UPDATE frames.  For now, just doing it here is good enough.
@@ -366,6 +450,154 @@ bool SpdyToHttpFilter::DecodeDataFrame(const net::SpdyDataIR& frame) {
   }
 }
 
+void SpdyToHttpFilter::FlushText() {
+  if (!text_.empty()) {
+    APR_BRIGADE_INSERT_TAIL(buffered_, apr_bucket_heap_create(
+        text_.data(), text_.size(), NULL, buffered_->bucket_alloc));
+    buffered_bytes_ += text_.size();
+    text_.clear();
+  }
+}
+
+void SpdyToHttpFilter::AppendBodyData(const base::StringPiece& data) {
+  // Any text (e.g. a chunk header) goes before the data.
+  FlushText();
+  if (data.empty()) {
+    return;
+  }
+  if (buffered_bytes_ >= kSpillToFileThreshold && SpillBodyData(data)) {
+    return;
+  }
+  // The SpdyToHttpConverter only gives us body data straight from a DATA
+  // frame, and only once per frame, so we can normally have the bucket take
+  // the frame over.
+  apr_bucket* bucket;
+  if (frame_.get() != NULL) {
+    bucket = SpdyDataBucketCreate(frame_.release(), data,
+                                  buffered_->bucket_alloc);
+  } else {
+    LOG(DFATAL) << "Body data on stream " << stream_->stream_id()
+                << " did not come from a DATA frame";
+    bucket = apr_bucket_heap_create(data.data(), data.size(), NULL,
+                                    buffered_->bucket_alloc);
+  }
+  APR_BRIGADE_INSERT_TAIL(buffered_, bucket);
+  buffered_bytes_ += data.size();
+}
+
+bool SpdyToHttpFilter::SpillBodyData(const base::StringPiece& data) {
+  if (spill_file_failed_) {
+    return false;
+  }
+
+  apr_status_t status = APR_SUCCESS;
+  if (spill_file_ == NULL) {
+    const char* temp_dir = NULL;
+    status = apr_temp_dir_get(&temp_dir, pool_);
+    if (status == APR_SUCCESS) {
+      // Passing zero flags gets us a file that is deleted when closed (which
+      // will happen when pool_ is cleaned up).
+      char* path = apr_pstrcat(pool_, temp_dir, "/mod_spdy_upload.XXXXXX",
+                               NULL);
+      status = apr_file_mktemp(&spill_file_, path, 0, pool_);
+    }
+    if (status != APR_SUCCESS) {
+      LOG(WARNING) << "Could not create a temporary file for the request body "
+                   << "on stream " << stream_->stream_id() << "; keeping it "
+                   << "in memory (status " << status << ")";
+      spill_file_ = NULL;
+      spill_file_failed_ = true;
+      return false;
+    }
+  }
+
+  // Reading from file buckets moves the file pointer, so seek back to the
+  // end of what we've written before writing more.
+  apr_off_t offset = spill_file_size_;
+  status = apr_file_seek(spill_file_, APR_SET, &offset);
+  if (status == APR_SUCCESS) {
+    status = apr_file_write_full(spill_file_, data.data(), data.size(), NULL);
+  }
+  if (status != APR_SUCCESS) {
+    LOG(WARNING) << "Could not write the request body on stream "
+                 << stream_->stream_id() << " to a temporary file; keeping "
+                 << "the rest in memory (status " << status << ")";
+    spill_file_failed_ = true;
+    return false;
+  }
+
+  // If the last bucket in the buffer covers the data we wrote just before
+  // this, extend it to cover this data too; otherwise, add a new bucket.
+  apr_bucket* last = APR_BRIGADE_LAST(buffered_);
+  if (!APR_BRIGADE_EMPTY(buffered_) && APR_BUCKET_IS_FILE(last) &&
+      static_cast<apr_bucket_file*>(last->data)->fd == spill_file_ &&
+      last->start + static_cast<apr_off_t>(last->length) ==
+      spill_file_size_) {
+    last->length += data.size();
+  } else {
+    APR_BRIGADE_INSERT_TAIL(buffered_, apr_bucket_file_create(
+        spill_file_, spill_file_size_, data.size(), pool_,
+        buffered_->bucket_alloc));
+  }
+  spill_file_size_ += data.size();
+  buffered_bytes_ += data.size();
+  return true;
+}
+
+size_t SpdyToHttpFilter::FindLinebreak(size_t start) {
+  size_t offset = 0;
+  for (apr_bucket* bucket = APR_BRIGADE_FIRST(buffered_);
+       bucket != APR_BRIGADE_SENTINEL(buffered_);
+       bucket = APR_BUCKET_NEXT(bucket)) {
+    // Skip buckets we've already scanned.
+    if (offset + bucket->length <= start) {
+      offset += bucket->length;
+      continue;
+    }
+    // Note that reading a file bucket will split off (at most) the first few
+    // kilobytes of it into a new bucket, which is all we scan here.
+    const char* data = NULL;
+    apr_size_t size = 0;
+    if (apr_bucket_read(bucket, &data, &size, APR_BLOCK_READ) !=
+        APR_SUCCESS) {
+      break;
+    }
+    const size_t skip = (start > offset ? start - offset : 0);
+    const void* linebreak = std::memchr(data + skip, '\n', size - skip);
+    if (linebreak != NULL) {
+      return offset + (static_cast<const char*>(linebreak) - data);
+    }
+    offset += size;
+  }
+  return std::string::npos;
+}
+
+void SpdyToHttpFilter::TakeBufferedData(size_t num_bytes, bool copy,
+                                        apr_bucket_brigade* brigade) {
+  DCHECK_LE(num_bytes, buffered_bytes_);
+  // Split the bucket that straddles num_bytes (if any), so that we can take
+  // whole buckets.
+  apr_bucket* end = NULL;
+  const apr_status_t status = apr_brigade_partition(buffered_, num_bytes, &end);
+  DCHECK_EQ(APR_SUCCESS, status);
+  apr_bucket* bucket = APR_BRIGADE_FIRST(buffered_);
+  while (bucket != end) {
+    apr_bucket* next = APR_BUCKET_NEXT(bucket);
+    if (copy) {
+      apr_bucket* bucket_copy = NULL;
+      apr_bucket_copy(bucket, &bucket_copy);
+      APR_BRIGADE_INSERT_TAIL(brigade, bucket_copy);
+    } else {
+      APR_BUCKET_REMOVE(bucket);
+      APR_BRIGADE_INSERT_TAIL(brigade, bucket);
+    }
+    bucket = next;
+  }
+  if (!copy) {
+    buffered_bytes_ -= num_bytes;
+  }
+}
+
 void SpdyToHttpFilter::AbortStream(net::SpdyRstStreamStatus status) {
   stream_->AbortWithRstStream(status);
 }
@@ -18,9 +18,12 @@
 #include <string>
 
 #include "apr_buckets.h"
+#include "apr_file_io.h"
 #include "util_filter.h"
 
 #include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_piece.h"
 #include "mod_spdy/common/http_string_builder.h"
 #include "mod_spdy/common/spdy_to_http_converter.h"
 #include "net/spdy/spdy_protocol.h"
@@ -34,6 +37,12 @@ class SpdyStream;
 // data to be processed by Apache.  This is intended to be the outermost filter
 // in the input chain of one of our slave connections, essentially taking the
 // place of the network socket.
+//
+// Decoded data is held in a brigade until Apache asks for it.  Request body
+// data is passed along in buckets that take over the DATA frame it arrived
+// in, rather than being copied, and once a lot of data has built up (e.g.
+// for an EXHAUSTIVE read of a large upload), further body data is written to
+// a temporary file instead of being kept in memory.
 class SpdyToHttpFilter {
  public:
   explicit SpdyToHttpFilter(SpdyStream* stream);
@@ -76,11 +85,28 @@ class SpdyToHttpFilter {
     DISALLOW_COPY_AND_ASSIGN(DecodeFrameVisitor);
   };
 
+  // An HttpStringBuilder that hands request body data to the filter (see
+  // AppendBodyData below) instead of appending it to the string.
+  friend class BodyDataBuilder;
+  class BodyDataBuilder : public HttpStringBuilder {
+   public:
+    BodyDataBuilder(std::string* str, SpdyToHttpFilter* filter);
+    virtual ~BodyDataBuilder();
+
+   protected:
+    virtual void AppendBodyData(const base::StringPiece& data);
+
+   private:
+    SpdyToHttpFilter* const filter_;
+
+    DISALLOW_COPY_AND_ASSIGN(BodyDataBuilder);
+  };
+
   // Return true if we've received a FLAG_FIN (i.e. EOS has been reached).
   bool end_of_stream_reached() const { return visitor_.is_complete(); }
 
   // Try to get the next SPDY frame on this stream, convert it into HTTP, and
-  // append the resulting data to data_buffer_.  If the block argument is
+  // append the resulting data to buffered_.  If the block argument is
   // APR_BLOCK_READ, this function will block until a frame comes in (or the
   // stream is closed).
   bool GetNextFrame(apr_read_type_e block);
@@ -91,14 +117,44 @@ class SpdyToHttpFilter {
   bool DecodeHeadersFrame(const net::SpdyHeadersIR& frame);
   bool DecodeDataFrame(const net::SpdyDataIR& frame);
 
+  // Move any HTTP text in text_ to the end of buffered_.
+  void FlushText();
+  // Append request body data (which must be the payload of the frame being
+  // decoded) to buffered_, following any text before it.
+  void AppendBodyData(const base::StringPiece& data);
+  // Write request body data to the end of our temporary file, and append a
+  // bucket for it to buffered_.  Returns false (having done nothing) if the
+  // temporary file can't be used.
+  bool SpillBodyData(const base::StringPiece& data);
+
+  // Return the offset within buffered_ of the first linebreak at or after
+  // offset start, or std::string::npos if there isn't one.
+  size_t FindLinebreak(size_t start);
+  // Move (or, if copy is true, copy) the first num_bytes of buffered_ onto the
+  // end of the given brigade.
+  void TakeBufferedData(size_t num_bytes, bool copy,
+                        apr_bucket_brigade* brigade);
+
   // Send a RST_STREAM frame and abort the stream.
   void AbortStream(net::SpdyRstStreamStatus status);
 
   SpdyStream* const stream_;
-  std::string data_buffer_;
-  HttpStringBuilder visitor_;
+  std::string text_;  // converted HTTP text not yet moved into buffered_
+  BodyDataBuilder visitor_;
   SpdyToHttpConverter converter_;
-  size_t next_read_start_;
+  // The frame we're decoding, until a bucket takes it over.
+  scoped_ptr<net::SpdyFrameIR> frame_;
+  // Converted data not yet returned to Apache, and its length.  The brigade
+  // is created (in the slave connection's pool) on the first call to Read.
+  apr_pool_t* pool_;
+  apr_bucket_brigade* buffered_;
+  size_t buffered_bytes_;
+  // Temporary file for request body data that didn't fit in memory, and how
+  // much we've written to it.  The file is created on demand, and is deleted
+  // when the pool is cleaned up.
+  apr_file_t* spill_file_;
+  apr_off_t spill_file_size_;
+  bool spill_file_failed_;  // true if we couldn't create or write the file
 
   DISALLOW_COPY_AND_ASSIGN(SpdyToHttpFilter);
 };
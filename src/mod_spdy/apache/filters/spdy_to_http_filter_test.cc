@@ -90,7 +90,10 @@ class SpdyToHttpFilterTest :
     scoped_ptr<net::SpdyDataIR> frame(
         new net::SpdyDataIR(stream_id_, payload));
     frame->set_fin(fin);
-    EXPECT_TRUE(shared_window_.OnReceiveInputData(payload.size()));
+    // As in SpdySession, only SPDY/3.1 and up have a shared input window.
+    if (spdy_version_ >= mod_spdy::spdy::SPDY_VERSION_3_1) {
+      EXPECT_TRUE(shared_window_.OnReceiveInputData(payload.size()));
+    }
     stream_.PostInputFrame(frame.release());
   }
 
@@ -100,19 +103,23 @@ class SpdyToHttpFilterTest :
                                      mode, block, readbytes);
   }
 
-  void ExpectTransientBucket(const std::string& expected) {
+  // Expect the brigade to begin with data buckets (of whatever type) that
+  // together contain the expected data, and remove them.
+  void ExpectDataBuckets(const std::string& expected) {
     ASSERT_FALSE(APR_BRIGADE_EMPTY(brigade_))
-        << "Expected TRANSIENT bucket, but brigade is empty.";
-    apr_bucket* bucket = APR_BRIGADE_FIRST(brigade_);
-    ASSERT_TRUE(APR_BUCKET_IS_TRANSIENT(bucket))
-        << "Expected TRANSIENT bucket, but found " << bucket->type->name
-        << " bucket.";
-    const char* data = NULL;
-    apr_size_t size = 0;
-    ASSERT_EQ(APR_SUCCESS, apr_bucket_read(
-        bucket, &data, &size, APR_NONBLOCK_READ));
-    EXPECT_EQ(expected, std::string(data, size));
-    apr_bucket_delete(bucket);
+        << "Expected data buckets, but brigade is empty.";
+    std::string actual;
+    while (!APR_BRIGADE_EMPTY(brigade_) &&
+           !APR_BUCKET_IS_METADATA(APR_BRIGADE_FIRST(brigade_))) {
+      apr_bucket* bucket = APR_BRIGADE_FIRST(brigade_);
+      const char* data = NULL;
+      apr_size_t size = 0;
+      ASSERT_EQ(APR_SUCCESS, apr_bucket_read(
+          bucket, &data, &size, APR_BLOCK_READ));
+      actual.append(data, size);
+      apr_bucket_delete(bucket);
+    }
+    EXPECT_EQ(expected, actual);
   }
 
   void ExpectEosBucket() {
@@ -208,38 +215,38 @@ TEST_P(SpdyToHttpFilterTest, SimpleGetRequest) {
   // Invoke the filter in blocking GETLINE mode.  We should get back just the
   // HTTP request line.
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_GETLINE, APR_BLOCK_READ, 0));
-  ExpectTransientBucket("GET /foo/bar/index.html HTTP/1.1\r\n");
+  ExpectDataBuckets("GET /foo/bar/index.html HTTP/1.1\r\n");
   ExpectEndOfBrigade();
 
   // Now do a SPECULATIVE read.  We should get back a few bytes.
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_SPECULATIVE, APR_NONBLOCK_READ, 8));
-  ExpectTransientBucket("host: ww");
+  ExpectDataBuckets("host: ww");
   ExpectEndOfBrigade();
 
   // Now do another GETLINE read.  We should get back the first header line,
   // including the data we just read speculatively.
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_GETLINE, APR_NONBLOCK_READ, 0));
-  ExpectTransientBucket("host: www.example.com\r\n");
+  ExpectDataBuckets("host: www.example.com\r\n");
   ExpectEndOfBrigade();
 
   // Do a READBYTES read.  We should get back a few bytes.
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_READBYTES, APR_NONBLOCK_READ, 12));
-  ExpectTransientBucket("referer: htt");
+  ExpectDataBuckets("referer: htt");
   ExpectEndOfBrigade();
 
   // Do another GETLINE read.  We should get back the rest of the header line,
   // *not* including the data we just read.
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_GETLINE, APR_NONBLOCK_READ, 0));
-  ExpectTransientBucket("ps://www.example.com/index.html\r\n");
+  ExpectDataBuckets("ps://www.example.com/index.html\r\n");
   ExpectEndOfBrigade();
 
   // Finally, do an EXHAUSTIVE read.  We should get back everything that
   // remains, terminating with an EOS bucket.
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_EXHAUSTIVE, APR_NONBLOCK_READ, 0));
-  ExpectTransientBucket("user-agent: ModSpdyUnitTest/1.0\r\n"
-                        "x-do-not-track: 1\r\n"
-                        "accept-encoding: gzip,deflate\r\n"
-                        "\r\n");
+  ExpectDataBuckets("user-agent: ModSpdyUnitTest/1.0\r\n"
+                    "x-do-not-track: 1\r\n"
+                    "accept-encoding: gzip,deflate\r\n"
+                    "\r\n");
   ExpectEosBucket();
   ExpectEndOfBrigade();
   ExpectNoMoreOutputFrames();
@@ -264,10 +271,10 @@ TEST_P(SpdyToHttpFilterTest, SimplePostRequest) {
   // Do a nonblocking READBYTES read.  We ask for lots of bytes, but since it's
   // nonblocking we should immediately get back what's available so far.
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_READBYTES, APR_NONBLOCK_READ, 4096));
-  ExpectTransientBucket("POST /erase/the/whole/database.cgi HTTP/1.1\r\n"
-                        "host: www.example.com\r\n"
-                        "referer: https://www.example.com/index.html\r\n"
-                        "user-agent: ModSpdyUnitTest/1.0\r\n");
+  ExpectDataBuckets("POST /erase/the/whole/database.cgi HTTP/1.1\r\n"
+                    "host: www.example.com\r\n"
+                    "referer: https://www.example.com/index.html\r\n"
+                    "user-agent: ModSpdyUnitTest/1.0\r\n");
   ExpectEndOfBrigade();
 
   // There's nothing more available yet, so a nonblocking read should fail.
@@ -283,37 +290,37 @@ TEST_P(SpdyToHttpFilterTest, SimplePostRequest) {
 
   // Now read in the data a bit at a time.
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_GETLINE, APR_NONBLOCK_READ, 0));
-  ExpectTransientBucket("transfer-encoding: chunked\r\n");
+  ExpectDataBuckets("transfer-encoding: chunked\r\n");
   ExpectEndOfBrigade();
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_GETLINE, APR_NONBLOCK_READ, 0));
-  ExpectTransientBucket("accept-encoding: gzip,deflate\r\n");
+  ExpectDataBuckets("accept-encoding: gzip,deflate\r\n");
   ExpectEndOfBrigade();
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_GETLINE, APR_NONBLOCK_READ, 0));
-  ExpectTransientBucket("\r\n");
+  ExpectDataBuckets("\r\n");
   ExpectEndOfBrigade();
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_GETLINE, APR_NONBLOCK_READ, 0));
-  ExpectTransientBucket("1B\r\n");
+  ExpectDataBuckets("1B\r\n");
   ExpectEndOfBrigade();
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_READBYTES, APR_NONBLOCK_READ, 24));
-  ExpectTransientBucket("Hello, world!\nPlease era");
+  ExpectDataBuckets("Hello, world!\nPlease era");
   ExpectEndOfBrigade();
   ExpectNoMoreOutputFrames();
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_SPECULATIVE, APR_NONBLOCK_READ, 15));
-  ExpectTransientBucket("se \r\n13\r\nthe wh");
+  ExpectDataBuckets("se \r\n13\r\nthe wh");
   ExpectEndOfBrigade();
   ExpectNoMoreOutputFrames();
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_READBYTES, APR_NONBLOCK_READ, 36));
-  ExpectTransientBucket("se \r\n13\r\nthe whole database \r\n15\r\nim");
+  ExpectDataBuckets("se \r\n13\r\nthe whole database \r\n15\r\nim");
   ExpectEndOfBrigade();
   ExpectNoMoreOutputFrames();
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_READBYTES, APR_NONBLOCK_READ, 21));
-  ExpectTransientBucket("mediately.\nThanks!\n\r\n");
+  ExpectDataBuckets("mediately.\nThanks!\n\r\n");
   ExpectEndOfBrigade();
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_GETLINE, APR_NONBLOCK_READ, 0));
-  ExpectTransientBucket("0\r\n");
+  ExpectDataBuckets("0\r\n");
   ExpectEndOfBrigade();
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_GETLINE, APR_NONBLOCK_READ, 0));
-  ExpectTransientBucket("\r\n");
+  ExpectDataBuckets("\r\n");
   ExpectEosBucket();
   ExpectEndOfBrigade();
   ExpectNoMoreOutputFrames();
@@ -348,23 +355,23 @@ TEST_P(SpdyToHttpFilterTest, PostRequestWithHeadersFrames) {
 
   // Read in all the data.
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_EXHAUSTIVE, APR_NONBLOCK_READ, 0));
-  ExpectTransientBucket("POST /erase/the/whole/database.cgi HTTP/1.1\r\n"
-                        "host: www.example.net\r\n"
-                        "referer: https://www.example.net/index.html\r\n"
-                        "user-agent: ModSpdyUnitTest/1.0\r\n"
-                        "transfer-encoding: chunked\r\n"
-                        "accept-encoding: gzip,deflate\r\n"
-                        "\r\n"
-                        "D\r\n"
-                        "Please erase \r\n"
-                        "B\r\n"
-                        "everything \r\n"
-                        "E\r\n"
-                        "immediately!!\n\r\n"
-                        "0\r\n"
-                        "x-awesome: quux\r\n"
-                        "x-super-cool: foo\r\n"
-                        "\r\n");
+  ExpectDataBuckets("POST /erase/the/whole/database.cgi HTTP/1.1\r\n"
+                    "host: www.example.net\r\n"
+                    "referer: https://www.example.net/index.html\r\n"
+                    "user-agent: ModSpdyUnitTest/1.0\r\n"
+                    "transfer-encoding: chunked\r\n"
+                    "accept-encoding: gzip,deflate\r\n"
+                    "\r\n"
+                    "D\r\n"
+                    "Please erase \r\n"
+                    "B\r\n"
+                    "everything \r\n"
+                    "E\r\n"
+                    "immediately!!\n\r\n"
+                    "0\r\n"
+                    "x-awesome: quux\r\n"
+                    "x-super-cool: foo\r\n"
+                    "\r\n");
   ExpectEosBucket();
   ExpectEndOfBrigade();
   ExpectNoMoreOutputFrames();
@@ -383,9 +390,9 @@ TEST_P(SpdyToHttpFilterTest, GetRequestWithHeadersRightAfterSynStream) {
 
   // Read in everything that's available so far.
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_EXHAUSTIVE, APR_NONBLOCK_READ, 0));
-  ExpectTransientBucket("GET /index.html HTTP/1.1\r\n"
-                        "host: www.example.org\r\n"
-                        "referer: https://www.example.org/foo/bar.html\r\n");
+  ExpectDataBuckets("GET /index.html HTTP/1.1\r\n"
+                    "host: www.example.org\r\n"
+                    "referer: https://www.example.org/foo/bar.html\r\n");
   ExpectEndOfBrigade();
 
   // Send a HEADERS frame with the rest of the headers.
@@ -396,9 +403,9 @@ TEST_P(SpdyToHttpFilterTest, GetRequestWithHeadersRightAfterSynStream) {
 
   // Read in the rest of the request.
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_EXHAUSTIVE, APR_NONBLOCK_READ, 0));
-  ExpectTransientBucket("accept-encoding: deflate, gzip\r\n"
-                        "user-agent: ModSpdyUnitTest/1.0\r\n"
-                        "\r\n");
+  ExpectDataBuckets("accept-encoding: deflate, gzip\r\n"
+                    "user-agent: ModSpdyUnitTest/1.0\r\n"
+                    "\r\n");
   ExpectEosBucket();
   ExpectEndOfBrigade();
   ExpectNoMoreOutputFrames();
@@ -431,21 +438,21 @@ TEST_P(SpdyToHttpFilterTest, PostRequestWithHeadersRightAfterSynStream) {
   // Read in all the data.  The first HEADERS frame should get put in before
   // the data, and the last HEADERS frame should get put in after the data.
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_EXHAUSTIVE, APR_NONBLOCK_READ, 0));
-  ExpectTransientBucket("POST /delete/everything.py HTTP/1.1\r\n"
-                        "host: www.example.org\r\n"
-                        "referer: https://www.example.org/index.html\r\n"
-                        "x-zzzz: 4Z\r\n"
-                        "user-agent: ModSpdyUnitTest/1.0\r\n"
-                        "transfer-encoding: chunked\r\n"
-                        "accept-encoding: gzip,deflate\r\n"
-                        "\r\n"
-                        "23\r\n"
-                        "Please erase everything immediately\r\n"
-                        "A\r\n"
-                        ", thanks!\n\r\n"
-                        "0\r\n"
-                        "x-qqq: 3Q\r\n"
-                        "\r\n");
+  ExpectDataBuckets("POST /delete/everything.py HTTP/1.1\r\n"
+                    "host: www.example.org\r\n"
+                    "referer: https://www.example.org/index.html\r\n"
+                    "x-zzzz: 4Z\r\n"
+                    "user-agent: ModSpdyUnitTest/1.0\r\n"
+                    "transfer-encoding: chunked\r\n"
+                    "accept-encoding: gzip,deflate\r\n"
+                    "\r\n"
+                    "23\r\n"
+                    "Please erase everything immediately\r\n"
+                    "A\r\n"
+                    ", thanks!\n\r\n"
+                    "0\r\n"
+                    "x-qqq: 3Q\r\n"
+                    "\r\n");
   ExpectEosBucket();
   ExpectEndOfBrigade();
   ExpectNoMoreOutputFrames();
@@ -470,20 +477,20 @@ TEST_P(SpdyToHttpFilterTest, PostRequestWithEmptyDataFrameInMiddle) {
 
   // Read in all the data.  The empty data frame should be ignored.
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_EXHAUSTIVE, APR_NONBLOCK_READ, 0));
-  ExpectTransientBucket("POST /do/some/stuff.py HTTP/1.1\r\n"
-                        "host: www.example.org\r\n"
-                        "referer: https://www.example.org/index.html\r\n"
-                        "transfer-encoding: chunked\r\n"
-                        "accept-encoding: gzip,deflate\r\n"
-                        "\r\n"
-                        "9\r\n"
-                        "Please do\r\n"
-                        "6\r\n"
-                        " some \r\n"
-                        "7\r\n"
-                        "stuff.\n\r\n"
-                        "0\r\n"
-                        "\r\n");
+  ExpectDataBuckets("POST /do/some/stuff.py HTTP/1.1\r\n"
+                    "host: www.example.org\r\n"
+                    "referer: https://www.example.org/index.html\r\n"
+                    "transfer-encoding: chunked\r\n"
+                    "accept-encoding: gzip,deflate\r\n"
+                    "\r\n"
+                    "9\r\n"
+                    "Please do\r\n"
+                    "6\r\n"
+                    " some \r\n"
+                    "7\r\n"
+                    "stuff.\n\r\n"
+                    "0\r\n"
+                    "\r\n");
   ExpectEosBucket();
   ExpectEndOfBrigade();
   ExpectNoMoreOutputFrames();
@@ -509,20 +516,20 @@ TEST_P(SpdyToHttpFilterTest, PostRequestWithEmptyDataFrameAtEnd) {
   // Read in all the data.  The empty data frame should be ignored (except for
   // its FLAG_FIN).
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_EXHAUSTIVE, APR_NONBLOCK_READ, 0));
-  ExpectTransientBucket("POST /do/some/stuff.py HTTP/1.1\r\n"
-                        "host: www.example.org\r\n"
-                        "referer: https://www.example.org/index.html\r\n"
-                        "transfer-encoding: chunked\r\n"
-                        "accept-encoding: gzip,deflate\r\n"
-                        "\r\n"
-                        "9\r\n"
-                        "Please do\r\n"
-                        "6\r\n"
-                        " some \r\n"
-                        "7\r\n"
-                        "stuff.\n\r\n"
-                        "0\r\n"
-                        "\r\n");
+  ExpectDataBuckets("POST /do/some/stuff.py HTTP/1.1\r\n"
+                    "host: www.example.org\r\n"
+                    "referer: https://www.example.org/index.html\r\n"
+                    "transfer-encoding: chunked\r\n"
+                    "accept-encoding: gzip,deflate\r\n"
+                    "\r\n"
+                    "9\r\n"
+                    "Please do\r\n"
+                    "6\r\n"
+                    " some \r\n"
+                    "7\r\n"
+                    "stuff.\n\r\n"
+                    "0\r\n"
+                    "\r\n");
   ExpectEosBucket();
   ExpectEndOfBrigade();
   ExpectNoMoreOutputFrames();
@@ -554,19 +561,73 @@ TEST_P(SpdyToHttpFilterTest, PostRequestWithContentLength) {
   // encoding should not be used (to support modules that don't work with
   // chunked requests).
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_EXHAUSTIVE, APR_NONBLOCK_READ, 0));
-  ExpectTransientBucket("POST /do/some/stuff.py HTTP/1.1\r\n"
-                        "host: www.example.org\r\n"
-                        "referer: https://www.example.org/index.html\r\n"
-                        "content-length: 22\r\n"
-                        "user-agent: ModSpdyUnitTest/1.0\r\n"
-                        "accept-encoding: gzip,deflate\r\n"
-                        "\r\n"
-                        "Please do some stuff.\n");
+  ExpectDataBuckets("POST /do/some/stuff.py HTTP/1.1\r\n"
+                    "host: www.example.org\r\n"
+                    "referer: https://www.example.org/index.html\r\n"
+                    "content-length: 22\r\n"
+                    "user-agent: ModSpdyUnitTest/1.0\r\n"
+                    "accept-encoding: gzip,deflate\r\n"
+                    "\r\n"
+                    "Please do some stuff.\n");
   ExpectEosBucket();
   ExpectEndOfBrigade();
   ExpectNoMoreOutputFrames();
 }
 
+TEST_P(SpdyToHttpFilterTest, LargeUploadSpillsToFile) {
+  // Send a SYN_STREAM frame from the client, including a content-length so
+  // that the body isn't chunked.
+  const size_t kFrameSize = 32768;
+  const int kNumFrames = 40;
+  net::SpdyNameValueBlock headers;
+  headers["content-length"] = "1310720";  // kFrameSize * kNumFrames
+  headers[host_header_name()] = "www.example.org";
+  headers[method_header_name()] = "POST";
+  headers[scheme_header_name()] = "https";
+  headers[path_header_name()] = "/upload";
+  headers[version_header_name()] = "HTTP/1.1";
+  PostSynStreamFrame(false, headers);
+
+  // Send the body one frame at a time, peeking at everything after each one
+  // (without consuming any of it), so that it all builds up in the filter.
+  const std::string payload(kFrameSize, 'x');
+  for (int i = 0; i < kNumFrames; ++i) {
+    PostDataFrame(i + 1 == kNumFrames, payload);
+    ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_SPECULATIVE, APR_NONBLOCK_READ,
+                                2 * kFrameSize * kNumFrames));
+    ASSERT_EQ(APR_SUCCESS, apr_brigade_cleanup(brigade_));
+  }
+
+  // Now read it all in.  Part of the body should be in a temporary file.
+  ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_EXHAUSTIVE, APR_NONBLOCK_READ, 0));
+  bool found_file_bucket = false;
+  for (apr_bucket* bucket = APR_BRIGADE_FIRST(brigade_);
+       bucket != APR_BRIGADE_SENTINEL(brigade_);
+       bucket = APR_BUCKET_NEXT(bucket)) {
+    if (APR_BUCKET_IS_FILE(bucket)) {
+      found_file_bucket = true;
+    }
+  }
+  EXPECT_TRUE(found_file_bucket);
+  std::string expected;
+  if (is_spdy2()) {
+    expected = "POST /upload HTTP/1.1\r\n"
+               "content-length: 1310720\r\n"
+               "host: www.example.org\r\n";
+  } else {
+    expected = "POST /upload HTTP/1.1\r\n"
+               "host: www.example.org\r\n"
+               "content-length: 1310720\r\n";
+  }
+  expected += "accept-encoding: gzip,deflate\r\n\r\n";
+  for (int i = 0; i < kNumFrames; ++i) {
+    expected += payload;
+  }
+  ExpectDataBuckets(expected);
+  ExpectEosBucket();
+  ExpectEndOfBrigade();
+}
+
 TEST_P(SpdyToHttpFilterTest, PostRequestWithContentLengthAndTrailingHeaders) {
   // Send a SYN_STREAM frame from the client, including a content-length.
   net::SpdyNameValueBlock headers;
@@ -601,21 +662,21 @@ TEST_P(SpdyToHttpFilterTest, PostRequestWithContentLengthAndTrailingHeaders) {
   // This is beacuse in SPDY v3 the host header is ":host", which sorts
   // earlier, and which we transform into the HTTP header "host".
   if (is_spdy2()) {
-    ExpectTransientBucket("POST /do/some/stuff.py HTTP/1.1\r\n"
-                          "content-length: 22\r\n"
-                          "host: www.example.org\r\n"
-                          "referer: https://www.example.org/index.html\r\n"
-                          "accept-encoding: gzip,deflate\r\n"
-                          "\r\n"
-                          "Please do some stuff.\n");
+    ExpectDataBuckets("POST /do/some/stuff.py HTTP/1.1\r\n"
+                      "content-length: 22\r\n"
+                      "host: www.example.org\r\n"
+                      "referer: https://www.example.org/index.html\r\n"
+                      "accept-encoding: gzip,deflate\r\n"
+                      "\r\n"
+                      "Please do some stuff.\n");
   } else {
-    ExpectTransientBucket("POST /do/some/stuff.py HTTP/1.1\r\n"
-                          "host: www.example.org\r\n"
-                          "content-length: 22\r\n"
-                          "referer: https://www.example.org/index.html\r\n"
-                          "accept-encoding: gzip,deflate\r\n"
-                          "\r\n"
-                          "Please do some stuff.\n");
+    ExpectDataBuckets("POST /do/some/stuff.py HTTP/1.1\r\n"
+                      "host: www.example.org\r\n"
+                      "content-length: 22\r\n"
+                      "referer: https://www.example.org/index.html\r\n"
+                      "accept-encoding: gzip,deflate\r\n"
+                      "\r\n"
+                      "Please do some stuff.\n");
   }
   ExpectEosBucket();
   ExpectEndOfBrigade();
@@ -636,10 +697,10 @@ TEST_P(SpdyToHttpFilterTest, ExtraSynStream) {
 
   // Read in all available data.
   ASSERT_EQ(APR_SUCCESS, Read(AP_MODE_EXHAUSTIVE, APR_NONBLOCK_READ, 0));
-  ExpectTransientBucket("POST /erase/the/whole/database.cgi HTTP/1.1\r\n"
-                        "host: www.example.com\r\n"
-                        "referer: https://www.example.com/index.html\r\n"
-                        "user-agent: ModSpdyUnitTest/1.0\r\n");
+  ExpectDataBuckets("POST /erase/the/whole/database.cgi HTTP/1.1\r\n"
+                    "host: www.example.com\r\n"
+                    "referer: https://www.example.com/index.html\r\n"
+                    "user-agent: ModSpdyUnitTest/1.0\r\n");
   ExpectEndOfBrigade();
 
   // Now send another SYN_STREAM for the same stream_id, which is illegal.
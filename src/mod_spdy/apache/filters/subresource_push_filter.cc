@@ -0,0 +1,159 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/apache/filters/subresource_push_filter.h"
+
+#include <string>
+#include <vector>
+
+#include "httpd.h"
+
+#include "base/logging.h"
+#include "base/strings/string_piece.h"
+#include "base/strings/string_util.h"
+#include "mod_spdy/apache/filters/server_push_filter.h"
+#include "mod_spdy/common/protocol_util.h"
+
+namespace mod_spdy {
+
+namespace {
+
+// The resources worth pushing are nearly always referenced from the top of
+// the page, so there's little point in scanning a huge document to the end.
+const size_t kMaxBytesToScan = 256 * 1024;
+
+// Don't flood the connection with pushes for a page that references
+// hundreds of images.
+const int kMaxPushesPerPage = 16;
+
+// Stylesheets and scripts block rendering, so push them at the same high
+// priority as Link: rel=preload; as=style does.
+const net::SpdyPriority kRenderBlockingPriority = 1;
+
+}  // namespace
+
+SubresourcePushFilter::SubresourcePushFilter(
+    ServerPushFilter* server_push_filter, request_rec* request,
+    const std::string& scheme)
+    : server_push_filter_(server_push_filter),
+      request_(request),
+      scheme_(scheme),
+      started_(false),
+      num_pushes_(0) {
+  DCHECK(server_push_filter_);
+  DCHECK(request_);
+  const char* host_header = apr_table_get(request_->headers_in, http::kHost);
+  host_ = (host_header != NULL ? host_header :
+           request_->hostname != NULL ? request_->hostname : "");
+}
+
+SubresourcePushFilter::~SubresourcePushFilter() {}
+
+apr_status_t SubresourcePushFilter::Write(ap_filter_t* filter,
+                                          apr_bucket_brigade* input_brigade) {
+  DCHECK_EQ(request_, filter->r);
+  // The handler has settled the response status and content type by the
+  // time the first brigade reaches us, so decide then whether to scan.
+  bool keep_scanning = true;
+  if (!started_) {
+    started_ = true;
+    keep_scanning = ShouldScan();
+  }
+  if (keep_scanning) {
+    keep_scanning = ScanBrigade(input_brigade);
+  }
+  if (!keep_scanning) {
+    ap_remove_output_filter(filter);
+  }
+  // Pass the data through unchanged.
+  return ap_pass_brigade(filter->next, input_brigade);
+}
+
+bool SubresourcePushFilter::ShouldScan() const {
+  if (!server_push_filter_->PushAllowed()) {
+    return false;
+  }
+  // Don't push the page's resources along with an error page or a redirect.
+  if (request_->status != HTTP_OK || request_->header_only) {
+    return false;
+  }
+  if (request_->content_type == NULL ||
+      !StartsWithASCII(request_->content_type, "text/html", false)) {
+    return false;
+  }
+  // If the handler compressed the body itself, there's nothing we can read.
+  // (We run before mod_deflate, so its compression is no obstacle.)
+  if (apr_table_get(request_->headers_out, http::kContentEncoding) != NULL ||
+      apr_table_get(request_->err_headers_out,
+                    http::kContentEncoding) != NULL) {
+    return false;
+  }
+  return true;
+}
+
+bool SubresourcePushFilter::ScanBrigade(apr_bucket_brigade* brigade) {
+  std::vector<HtmlSubresourceScanner::Subresource> found;
+  for (apr_bucket* bucket = APR_BRIGADE_FIRST(brigade);
+       bucket != APR_BRIGADE_SENTINEL(brigade);
+       bucket = APR_BUCKET_NEXT(bucket)) {
+    if (APR_BUCKET_IS_METADATA(bucket)) {
+      if (APR_BUCKET_IS_EOS(bucket)) {
+        return false;
+      }
+      continue;
+    }
+    // Scanning must never hold up the response, so if the data isn't ready
+    // yet (e.g. it's coming from a CGI pipe), just give up on this response;
+    // a missed push merely means the client fetches the resource itself.
+    const char* data = NULL;
+    apr_size_t data_length = 0;
+    if (apr_bucket_read(bucket, &data, &data_length, APR_NONBLOCK_READ) !=
+        APR_SUCCESS) {
+      return false;
+    }
+    found.clear();
+    scanner_.Scan(base::StringPiece(data, data_length), &found);
+    for (size_t i = 0; i < found.size(); ++i) {
+      if (!PushSubresource(found[i])) {
+        return false;
+      }
+    }
+    if (scanner_.bytes_scanned() >= kMaxBytesToScan) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SubresourcePushFilter::PushSubresource(
+    const HtmlSubresourceScanner::Subresource& resource) {
+  std::string path;
+  if (!HtmlSubresourceScanner::ResolveSameOriginUrl(
+          resource.url, scheme_, host_,
+          request_->uri != NULL ? request_->uri : "/",
+          &path)) {
+    return true;  // not ours to push; carry on
+  }
+  if (num_pushes_ >= kMaxPushesPerPage) {
+    return false;
+  }
+  ++num_pushes_;
+  const net::SpdyPriority priority =
+      (resource.type == HtmlSubresourceScanner::IMAGE ?
+       server_push_filter_->LowestPriority() : kRenderBlockingPriority);
+  return server_push_filter_->StartPush(path, priority,
+                                        "SpdyServerPushScanHtml");
+}
+
+}  // namespace mod_spdy
@@ -0,0 +1,73 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MOD_SPDY_APACHE_FILTERS_SUBRESOURCE_PUSH_FILTER_H_
+#define MOD_SPDY_APACHE_FILTERS_SUBRESOURCE_PUSH_FILTER_H_
+
+#include <string>
+
+#include "apr_buckets.h"
+#include "util_filter.h"
+
+#include "base/basictypes.h"
+#include "mod_spdy/common/html_subresource_scanner.h"
+
+namespace mod_spdy {
+
+class ServerPushFilter;
+
+// An Apache filter that scans an HTML response body as it streams past, and
+// initiates server pushes (through the request's ServerPushFilter) for the
+// same-origin stylesheets, scripts, and images that it references, so that
+// they are on their way before the client has parsed the page.  The response
+// data is passed through untouched.  See the SpdyServerPushScanHtml directive.
+class SubresourcePushFilter {
+ public:
+  // The scheme should be that of the request ("https" or "http"); references
+  // to other schemes are not pushed.  Does not take ownership of either
+  // pointer argument.
+  SubresourcePushFilter(ServerPushFilter* server_push_filter,
+                        request_rec* request, const std::string& scheme);
+  ~SubresourcePushFilter();
+
+  // Read data from the given brigade and write the result through the given
+  // filter.  This filter doesn't modify the data.
+  apr_status_t Write(ap_filter_t* filter, apr_bucket_brigade* input_brigade);
+
+ private:
+  // Return true if the response is one we should scan at all.
+  bool ShouldScan() const;
+
+  // Scan the data buckets of the brigade, pushing whatever we find.  Return
+  // false if we're done scanning this response.
+  bool ScanBrigade(apr_bucket_brigade* brigade);
+
+  // Push the given subresource, if it's same-origin.  Return false if no
+  // further pushes should be attempted.
+  bool PushSubresource(const HtmlSubresourceScanner::Subresource& resource);
+
+  ServerPushFilter* const server_push_filter_;
+  request_rec* const request_;
+  const std::string scheme_;
+  std::string host_;
+  HtmlSubresourceScanner scanner_;
+  bool started_;
+  int num_pushes_;
+
+  DISALLOW_COPY_AND_ASSIGN(SubresourcePushFilter);
+};
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_APACHE_FILTERS_SUBRESOURCE_PUSH_FILTER_H_
@@ -0,0 +1,193 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/apache/filters/subresource_push_filter.h"
+
+#include <string.h>  // for strlen
+
+#include <string>
+
+#include "httpd.h"
+#include "apr_buckets.h"
+#include "apr_tables.h"
+#include "util_filter.h"
+
+#include "base/strings/string_piece.h"
+#include "mod_spdy/apache/filters/server_push_filter.h"
+#include "mod_spdy/apache/pool_util.h"
+#include "mod_spdy/common/protocol_util.h"
+#include "mod_spdy/common/shared_flow_control_window.h"
+#include "mod_spdy/common/spdy_frame_priority_queue.h"
+#include "mod_spdy/common/spdy_server_config.h"
+#include "mod_spdy/common/spdy_stream.h"
+#include "net/spdy/spdy_protocol.h"
+#include "testing/gmock/include/gmock/gmock.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using testing::_;
+using testing::Contains;
+using testing::Eq;
+using testing::Pair;
+using testing::Return;
+
+namespace {
+
+const net::SpdyStreamId kStreamId = 3;
+
+class MockSpdyServerPushInterface : public mod_spdy::SpdyServerPushInterface {
+ public:
+    MOCK_METHOD4(StartServerPush,
+                 mod_spdy::SpdyServerPushInterface::PushStatus(
+                     net::SpdyStreamId associated_stream_id,
+                     int32 server_push_depth,
+                     net::SpdyPriority priority,
+                     const net::SpdyHeaderBlock& request_headers));
+};
+
+class SubresourcePushFilterTest : public testing::Test {
+ public:
+  SubresourcePushFilterTest()
+      : shared_window_(net::kSpdyStreamInitialWindowSize,
+                       net::kSpdyStreamInitialWindowSize),
+        stream_(mod_spdy::spdy::SPDY_VERSION_3_1, kStreamId, 0, 0, 1,
+                net::kSpdyStreamInitialWindowSize, &output_queue_,
+                &shared_window_, &pusher_),
+        connection_(static_cast<conn_rec*>(
+          apr_pcalloc(local_.pool(), sizeof(conn_rec)))),
+        request_(static_cast<request_rec*>(
+          apr_pcalloc(local_.pool(), sizeof(request_rec)))),
+        ap_filter_(static_cast<ap_filter_t*>(
+            apr_pcalloc(local_.pool(), sizeof(ap_filter_t)))),
+        bucket_alloc_(apr_bucket_alloc_create(local_.pool())),
+        brigade_(apr_brigade_create(local_.pool(), bucket_alloc_)),
+        server_push_filter_(&stream_, request_, &server_cfg_, "https") {
+    // Set up our Apache data structures.  To keep things simple, we set only
+    // the bare minimum of necessary fields, and rely on apr_pcalloc to zero
+    // all others.
+    connection_->pool = local_.pool();
+    request_->pool = local_.pool();
+    request_->connection = connection_;
+    request_->headers_in = apr_table_make(local_.pool(), 5);
+    request_->headers_out = apr_table_make(local_.pool(), 5);
+    request_->err_headers_out = apr_table_make(local_.pool(), 5);
+    request_->protocol = const_cast<char*>("HTTP/1.1");
+    request_->unparsed_uri = const_cast<char*>("/shop/index.html");
+    request_->uri = const_cast<char*>("/shop/index.html");
+    request_->status = HTTP_OK;
+    request_->content_type = "text/html; charset=utf-8";
+    ap_filter_->c = connection_;
+    ap_filter_->r = request_;
+  }
+
+  virtual void SetUp() {
+    ON_CALL(pusher_, StartServerPush(_, _, _, _)).WillByDefault(
+        Return(mod_spdy::SpdyServerPushInterface::PUSH_STARTED));
+    apr_table_setn(request_->headers_in, mod_spdy::http::kHost,
+                   "www.example.com");
+  }
+
+ protected:
+  void AddData(const char* data) {
+    APR_BRIGADE_INSERT_TAIL(brigade_, apr_bucket_transient_create(
+        data, strlen(data), bucket_alloc_));
+  }
+
+  void WriteBrigade(mod_spdy::SubresourcePushFilter* filter) {
+    EXPECT_EQ(APR_SUCCESS, filter->Write(ap_filter_, brigade_));
+  }
+
+  void ExpectPush(const char* path, net::SpdyPriority priority) {
+    EXPECT_CALL(pusher_, StartServerPush(
+        Eq(kStreamId), Eq(1), Eq(priority),
+        Contains(Pair(mod_spdy::spdy::kSpdy3Path, path))));
+  }
+
+  mod_spdy::SpdyFramePriorityQueue output_queue_;
+  mod_spdy::SharedFlowControlWindow shared_window_;
+  MockSpdyServerPushInterface pusher_;
+  mod_spdy::SpdyStream stream_;
+  mod_spdy::SpdyServerConfig server_cfg_;
+  mod_spdy::LocalPool local_;
+  conn_rec* const connection_;
+  request_rec* const request_;
+  ap_filter_t* const ap_filter_;
+  apr_bucket_alloc_t* const bucket_alloc_;
+  apr_bucket_brigade* const brigade_;
+  mod_spdy::ServerPushFilter server_push_filter_;
+};
+
+// Test that same-origin subresources are pushed as their references stream
+// past, even when a tag is split across brigades.
+TEST_F(SubresourcePushFilterTest, PushSameOriginSubresources) {
+  mod_spdy::SubresourcePushFilter filter(&server_push_filter_, request_,
+                                         "https");
+  ExpectPush("/css/site.css", 1);
+  ExpectPush("/shop/app.js", 1);
+  ExpectPush("/img/logo.png", 7);
+
+  AddData("<html><head><link rel=stylesheet href=\"/css/site.css\">"
+          "<link rel=stylesheet href=\"https://cdn.example.com/x.css\">"
+          "<script src=\"app");
+  WriteBrigade(&filter);
+  AddData(".js\"></script></head><body>"
+          "<img src=\"../img/logo.png\"><img src=\"data:image/gif;base64,R0\">"
+          "<img src=\"/css/site.css\"></body></html>");
+  WriteBrigade(&filter);
+}
+
+// Test that responses other than successful, uncompressed HTML are left
+// alone.
+TEST_F(SubresourcePushFilterTest, IgnoreOtherResponses) {
+  EXPECT_CALL(pusher_, StartServerPush(_, _, _, _)).Times(0);
+  {
+    request_->content_type = "text/plain";
+    mod_spdy::SubresourcePushFilter filter(&server_push_filter_, request_,
+                                           "https");
+    AddData("<img src=\"/a.png\">");
+    WriteBrigade(&filter);
+  }
+  {
+    request_->content_type = "text/html";
+    request_->status = HTTP_NOT_FOUND;
+    mod_spdy::SubresourcePushFilter filter(&server_push_filter_, request_,
+                                           "https");
+    AddData("<img src=\"/a.png\">");
+    WriteBrigade(&filter);
+  }
+  {
+    request_->status = HTTP_OK;
+    apr_table_setn(request_->headers_out, mod_spdy::http::kContentEncoding,
+                   "gzip");
+    mod_spdy::SubresourcePushFilter filter(&server_push_filter_, request_,
+                                           "https");
+    AddData("<img src=\"/a.png\">");
+    WriteBrigade(&filter);
+  }
+}
+
+// Test that we stop after a bounded number of pushes.
+TEST_F(SubresourcePushFilterTest, LimitPushes) {
+  mod_spdy::SubresourcePushFilter filter(&server_push_filter_, request_,
+                                         "https");
+  EXPECT_CALL(pusher_, StartServerPush(_, _, _, _)).Times(16);
+  std::string html;
+  for (int i = 0; i < 40; ++i) {
+    html += "<img src=\"/img/" + std::string(1, 'a' + i % 26) +
+        std::string(1, 'a' + i / 26) + ".png\">";
+  }
+  AddData(html.c_str());
+  WriteBrigade(&filter);
+}
+
+}  // namespace
@@ -28,7 +28,8 @@ IdPool* IdPool::g_instance = NULL;
 const uint16 IdPool::kOverFlowId;
 
 IdPool::IdPool()
-    : next_never_used_(0) /* So it gets incremented to 1 in ::Alloc */ {
+    : mutex_("IdPool::mutex_"),
+      next_never_used_(0) /* So it gets incremented to 1 in ::Alloc */ {
 }
 
 IdPool::~IdPool() {
@@ -46,7 +47,7 @@ void IdPool::DestroyInstance() {
 }
 
 uint16 IdPool::Alloc() {
-  base::AutoLock lock(mutex_);
+  ProfiledAutoLock lock(mutex_);
   if (!free_list_.empty()) {
     uint16 id = free_list_.back();
     free_list_.pop_back();
@@ -73,7 +74,7 @@ void IdPool::Free(uint16 id) {
     return;
   }
 
-  base::AutoLock lock(mutex_);
+  ProfiledAutoLock lock(mutex_);
   DCHECK(alloc_set_.find(id) != alloc_set_.end());
   alloc_set_.erase(id);
   free_list_.push_back(id);
@@ -20,7 +20,7 @@
 #include <set>
 
 #include "base/basictypes.h"
-#include "base/synchronization/lock.h"
+#include "mod_spdy/common/profiled_lock.h"
 
 namespace mod_spdy {
 
@@ -54,7 +54,7 @@ class IdPool {
 
   static IdPool* g_instance;
 
-  base::Lock mutex_;
+  ProfiledLock mutex_;
   std::vector<uint16> free_list_;  // IDs known to be free
   std::set<uint16> alloc_set_;  // IDs currently in use
   uint16 next_never_used_;  // Next ID we have never returned from Alloc,
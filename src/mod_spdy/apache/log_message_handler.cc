@@ -26,8 +26,11 @@
 #include "base/debug/debugger.h"
 #include "base/debug/stack_trace.h"
 #include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/stringprintf.h"
 #include "base/threading/thread_local.h"
 #include "mod_spdy/apache/pool_util.h"
+#include "mod_spdy/common/async_log_queue.h"
 #include "mod_spdy/common/spdy_stream.h"
 #include "mod_spdy/common/version.h"
 
@@ -49,11 +52,25 @@ base::ThreadLocalPointer<LogHandler>* gThreadLocalLogHandler = NULL;
 const int kMaxInt = std::numeric_limits<int>::max();
 int log_level_cutoff = kMaxInt;
 
+// How many messages each thread can have waiting to be written, and how many
+// messages per second each LOG() statement may produce, when logging
+// asynchronously.
+const size_t kAsyncLogMessagesPerThread = 1024;
+const int kAsyncLogMaxMessagesPerSite = 50;
+
+// Non-NULL if this process is logging asynchronously.
+mod_spdy::AsyncLogQueue* gAsyncLogQueue = NULL;
+
 class LogHandler {
  public:
   explicit LogHandler(LogHandler* parent) : parent_(parent) {}
   virtual ~LogHandler() {}
   virtual void Log(int log_level, const std::string& message) = 0;
+  // Return the server whose error log Log() would write to, after prepending
+  // to *message whatever Log() would add to it, so that the message can be
+  // written later by the asynchronous log queue.  The server_rec lives as
+  // long as the process, unlike the connection that may be logging.
+  virtual server_rec* PrepareForQueue(std::string* message) = 0;
   LogHandler* parent() const { return parent_; }
  private:
   LogHandler* parent_;
@@ -77,6 +94,50 @@ void LogWithHandler(LogHandler* handler, int log_level,
   }
 }
 
+// Queue a message to be logged with the given LogHandler (or with
+// ap_log_perror if the LogHandler is NULL) by the flusher thread.
+void QueueWithHandler(mod_spdy::AsyncLogQueue* queue, LogHandler* handler,
+                      const char* file, int line, int log_level,
+                      const std::string& message) {
+  if (handler != NULL) {
+    std::string prepared(message);
+    server_rec* server = handler->PrepareForQueue(&prepared);
+    queue->AddMessage(file, line, log_level, server, prepared);
+  } else {
+    queue->AddMessage(file, line, log_level, NULL, message);
+  }
+}
+
+// Writes queued messages to the Apache error log, from the flusher thread.
+class ApacheLogWriter : public mod_spdy::AsyncLogQueue::Writer {
+ public:
+  ApacheLogWriter() {}
+  virtual void Write(int log_level, void* target,
+                     const std::string& message) {
+    if (target == NULL) {
+      LogWithHandler(NULL, log_level, message);
+    } else {
+      ap_log_error(APLOG_MARK, log_level, APR_SUCCESS,
+                   static_cast<server_rec*>(target), "%s", message.c_str());
+    }
+  }
+  virtual void WriteNote(const std::string& note) {
+    ap_log_perror(APLOG_MARK, APLOG_WARNING, APR_SUCCESS, log_pool, "%s%s",
+                  kLogMessagePrefix, note.c_str());
+  }
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ApacheLogWriter);
+};
+
+apr_status_t StopAsyncLogging(void* writer) {
+  mod_spdy::AsyncLogQueue* queue = gAsyncLogQueue;
+  gAsyncLogQueue = NULL;
+  // Deleting the queue writes out any remaining messages.
+  delete queue;
+  delete static_cast<ApacheLogWriter*>(writer);
+  return APR_SUCCESS;
+}
+
 void PopLogHandler() {
   CHECK(gThreadLocalLogHandler);
   LogHandler* handler = gThreadLocalLogHandler->Get();
@@ -93,6 +154,9 @@ class ServerLogHandler : public LogHandler {
     ap_log_error(APLOG_MARK, log_level, APR_SUCCESS, server_,
                  "%s", message.c_str());
   }
+  virtual server_rec* PrepareForQueue(std::string* message) {
+    return server_;
+  }
  private:
   server_rec* const server_;
   DISALLOW_COPY_AND_ASSIGN(ServerLogHandler);
@@ -106,6 +170,12 @@ class ConnectionLogHandler : public LogHandler {
     ap_log_cerror(APLOG_MARK, log_level, APR_SUCCESS, connection_,
                   "%s", message.c_str());
   }
+  virtual server_rec* PrepareForQueue(std::string* message) {
+    // This is the prefix that ap_log_cerror adds.
+    message->insert(0, base::StringPrintf("[client %s] ",
+                                          connection_->remote_ip));
+    return connection_->base_server;
+  }
  private:
   conn_rec* const connection_;
   DISALLOW_COPY_AND_ASSIGN(ConnectionLogHandler);
@@ -121,6 +191,12 @@ class StreamLogHandler : public LogHandler {
                   "[stream %d] %s", static_cast<int>(stream_->stream_id()),
                   message.c_str());
   }
+  virtual server_rec* PrepareForQueue(std::string* message) {
+    message->insert(0, base::StringPrintf(
+        "[client %s] [stream %d] ", connection_->remote_ip,
+        static_cast<int>(stream_->stream_id())));
+    return connection_->base_server;
+  }
  private:
   conn_rec* const connection_;
   const mod_spdy::SpdyStream* const stream_;
@@ -168,7 +244,18 @@ bool LogMessageHandler(int severity, const char* file, int line,
   }
 
   if (this_log_level <= log_level_cutoff || log_level_cutoff == kMaxInt) {
-    LogWithHandler(gThreadLocalLogHandler->Get(), this_log_level, message);
+    mod_spdy::AsyncLogQueue* queue = gAsyncLogQueue;
+    if (queue != NULL && severity != logging::LOG_FATAL) {
+      QueueWithHandler(queue, gThreadLocalLogHandler->Get(), file, line,
+                       this_log_level, message);
+    } else {
+      // We're about to crash on a fatal message, so write it out right away,
+      // after whatever was already queued.
+      if (queue != NULL) {
+        queue->Flush();
+      }
+      LogWithHandler(gThreadLocalLogHandler->Get(), this_log_level, message);
+    }
   }
 
   if (severity == logging::LOG_FATAL) {
@@ -237,6 +324,20 @@ void InstallLogMessageHandler(apr_pool_t* pool) {
   logging::SetLogMessageHandler(&LogMessageHandler);
 }
 
+void StartAsyncLogging(apr_pool_t* pool) {
+  CHECK(gAsyncLogQueue == NULL);
+  scoped_ptr<ApacheLogWriter> writer(new ApacheLogWriter);
+  scoped_ptr<AsyncLogQueue> queue(new AsyncLogQueue(
+      writer.get(), kAsyncLogMessagesPerThread, kAsyncLogMaxMessagesPerSite));
+  if (!queue->Start()) {
+    // Carry on logging synchronously.
+    return;
+  }
+  gAsyncLogQueue = queue.release();
+  apr_pool_cleanup_register(pool, writer.release(), StopAsyncLogging,
+                            apr_pool_cleanup_null);
+}
+
 void SetLoggingLevel(int apache_log_level, int vlog_level) {
   switch (apache_log_level) {
     case APLOG_EMERG:
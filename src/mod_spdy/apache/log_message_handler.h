@@ -73,6 +73,13 @@ class ScopedStreamLogHandler {
 // apache error log.  Should be called once, at server startup.
 void InstallLogMessageHandler(apr_pool_t* pool);
 
+// From now until the pool is cleaned up, write LOG() messages to the apache
+// error log from a background thread (see AsyncLogQueue), so that threads
+// that log never wait on the error log.  Messages may be dropped or
+// rate-limited if they're logged faster than they can be written.  Should be
+// called at most once for each child process, at process startup.
+void StartAsyncLogging(apr_pool_t* pool);
+
 // Set the logging level for LOG() messages, based on the Apache log level and
 // the VLOG-level specified in the server config.  Note that the VLOG level
 // will be ignored unless the Apache log verbosity is at NOTICE or higher.
@@ -0,0 +1,296 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mod_spdy/common/async_log_queue.h"
+
+#include <string>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+#include "base/stl_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+
+// Note that nothing in this file may use LOG(), since this class is used to
+// implement it.
+
+namespace {
+
+// How long the flusher thread sleeps between writing out messages.
+const int kFlushIntervalMillis = 100;
+
+// Round up to a power of two, so that the ring buffer indices can wrap
+// around without disturbing the modulus.
+size_t RoundUpToPowerOfTwo(size_t n) {
+  size_t result = 1;
+  while (result < n) {
+    result <<= 1;
+  }
+  return result;
+}
+
+}  // namespace
+
+namespace mod_spdy {
+
+// The ring buffer of messages for one thread.  Only the owning thread adds
+// messages, and only the thread holding the queue's flush_lock_ removes them,
+// so the two ends need only atomic indices rather than a lock.  The indices
+// count messages ever added and removed, and wrap around harmlessly.
+class AsyncLogQueue::ThreadBuffer {
+ public:
+  ThreadBuffer(AsyncLogQueue* owner, size_t capacity)
+      : owner_(owner), entries_(RoundUpToPowerOfTwo(capacity)), added_(0),
+        removed_(0) {}
+
+  AsyncLogQueue* owner() const { return owner_; }
+
+  // Called only on the owning thread.  Return false if the buffer is full.
+  bool Add(int level, void* target, const std::string& message) {
+    const uint32 added =
+        static_cast<uint32>(base::subtle::NoBarrier_Load(&added_));
+    const uint32 removed =
+        static_cast<uint32>(base::subtle::Acquire_Load(&removed_));
+    if (added - removed >= entries_.size()) {
+      return false;
+    }
+    Entry* entry = &entries_[added & (entries_.size() - 1)];
+    entry->level = level;
+    entry->target = target;
+    // Reuses the string's storage from earlier messages where possible.
+    entry->message.assign(message);
+    base::subtle::Release_Store(&added_,
+                                static_cast<base::subtle::Atomic32>(added + 1));
+    return true;
+  }
+
+  // Called only with the queue's flush_lock_ held.
+  void WriteTo(Writer* writer) {
+    const uint32 added =
+        static_cast<uint32>(base::subtle::Acquire_Load(&added_));
+    uint32 removed =
+        static_cast<uint32>(base::subtle::NoBarrier_Load(&removed_));
+    while (removed != added) {
+      const Entry& entry = entries_[removed & (entries_.size() - 1)];
+      writer->Write(entry.level, entry.target, entry.message);
+      ++removed;
+      base::subtle::Release_Store(&removed_,
+                                  static_cast<base::subtle::Atomic32>(removed));
+    }
+  }
+
+ private:
+  struct Entry {
+    Entry() : level(0), target(NULL) {}
+    int level;
+    void* target;
+    std::string message;
+  };
+
+  AsyncLogQueue* const owner_;
+  std::vector<Entry> entries_;
+  base::subtle::Atomic32 added_;
+  base::subtle::Atomic32 removed_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadBuffer);
+};
+
+class AsyncLogQueue::FlusherThread : public base::PlatformThread::Delegate {
+ public:
+  explicit FlusherThread(AsyncLogQueue* queue) : queue_(queue) {}
+
+  bool Start() { return base::PlatformThread::Create(0, this, &thread_id_); }
+  void Join() { base::PlatformThread::Join(thread_id_); }
+
+  // base::PlatformThread::Delegate method:
+  virtual void ThreadMain() { queue_->RunFlusher(); }
+
+ private:
+  AsyncLogQueue* const queue_;
+  base::PlatformThreadHandle thread_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(FlusherThread);
+};
+
+const size_t AsyncLogQueue::kNumSites = 256;
+
+AsyncLogQueue::Writer::~Writer() {}
+
+AsyncLogQueue::AsyncLogQueue(Writer* writer, size_t messages_per_thread,
+                             int max_messages_per_site)
+    : writer_(writer),
+      messages_per_thread_(messages_per_thread),
+      max_messages_per_site_(max_messages_per_site),
+      sites_(kNumSites),
+      dropped_(0),
+      thread_buffer_slot_(&AsyncLogQueue::OnThreadExit),
+      stop_condvar_(&stop_lock_),
+      stopping_(false) {
+  for (size_t i = 0; i < sites_.size(); ++i) {
+    Site* site = &sites_[i];
+    site->file = 0;
+    site->line = 0;
+    site->second = -1;
+    site->count = 0;
+    site->suppressed = 0;
+  }
+}
+
+AsyncLogQueue::~AsyncLogQueue() {
+  if (flusher_.get() != NULL) {
+    {
+      base::AutoLock autolock(stop_lock_);
+      stopping_ = true;
+      stop_condvar_.Signal();
+    }
+    flusher_->Join();
+  }
+  Flush();
+  thread_buffer_slot_.Free();
+  STLDeleteElements(&buffers_);
+}
+
+bool AsyncLogQueue::Start() {
+  scoped_ptr<FlusherThread> flusher(new FlusherThread(this));
+  if (!flusher->Start()) {
+    return false;
+  }
+  flusher_.reset(flusher.release());
+  return true;
+}
+
+bool AsyncLogQueue::AddMessage(const char* file, int line, int level,
+                               void* target, const std::string& message) {
+  if (!CheckRateLimit(file, line)) {
+    return false;
+  }
+  if (!GetCurrentThreadBuffer()->Add(level, target, message)) {
+    base::subtle::NoBarrier_AtomicIncrement(&dropped_, 1);
+    return false;
+  }
+  return true;
+}
+
+void AsyncLogQueue::Flush() {
+  base::AutoLock autolock(flush_lock_);
+
+  std::vector<ThreadBuffer*> buffers;
+  {
+    base::AutoLock autolock(buffers_lock_);
+    buffers = buffers_;
+  }
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    buffers[i]->WriteTo(writer_);
+  }
+
+  const int dropped = base::subtle::NoBarrier_AtomicExchange(&dropped_, 0);
+  if (dropped > 0) {
+    writer_->WriteNote(base::StringPrintf(
+        "Dropped %d log messages because the log buffer was full", dropped));
+  }
+  for (size_t i = 0; i < sites_.size(); ++i) {
+    Site* site = &sites_[i];
+    const int suppressed =
+        base::subtle::NoBarrier_AtomicExchange(&site->suppressed, 0);
+    if (suppressed > 0) {
+      // If two log statements share the site, this only names the one that
+      // was suppressed last, but that's good enough to go on.
+      writer_->WriteNote(base::StringPrintf(
+          "Suppressed %d log messages from %s:%d (more than %d per second)",
+          suppressed, reinterpret_cast<const char*>(
+              base::subtle::NoBarrier_Load(&site->file)),
+          static_cast<int>(base::subtle::NoBarrier_Load(&site->line)),
+          max_messages_per_site_));
+    }
+  }
+}
+
+bool AsyncLogQueue::CheckRateLimit(const char* file, int line) {
+  if (max_messages_per_site_ <= 0) {
+    return true;
+  }
+  const size_t hash = (reinterpret_cast<uintptr_t>(file) >> 2) * 31 +
+      static_cast<size_t>(line);
+  Site* site = &sites_[hash % sites_.size()];
+  const base::subtle::Atomic32 second = static_cast<base::subtle::Atomic32>(
+      (base::TimeTicks::Now() - base::TimeTicks()).InSeconds());
+  if (base::subtle::NoBarrier_Load(&site->second) != second) {
+    // Start counting a new second.  Threads that race to do this may let a
+    // few extra messages through, which is harmless.
+    base::subtle::NoBarrier_Store(&site->count, 0);
+    base::subtle::NoBarrier_Store(&site->second, second);
+  }
+  if (base::subtle::NoBarrier_AtomicIncrement(&site->count, 1) <=
+      max_messages_per_site_) {
+    return true;
+  }
+  base::subtle::NoBarrier_Store(
+      &site->file, reinterpret_cast<base::subtle::AtomicWord>(file));
+  base::subtle::NoBarrier_Store(&site->line, line);
+  base::subtle::NoBarrier_AtomicIncrement(&site->suppressed, 1);
+  return false;
+}
+
+AsyncLogQueue::ThreadBuffer* AsyncLogQueue::GetCurrentThreadBuffer() {
+  ThreadBuffer* buffer = static_cast<ThreadBuffer*>(thread_buffer_slot_.Get());
+  if (buffer != NULL) {
+    return buffer;
+  }
+  {
+    base::AutoLock autolock(buffers_lock_);
+    if (free_buffers_.empty()) {
+      buffer = new ThreadBuffer(this, messages_per_thread_);
+      buffers_.push_back(buffer);
+    } else {
+      buffer = free_buffers_.back();
+      free_buffers_.pop_back();
+    }
+  }
+  thread_buffer_slot_.Set(buffer);
+  return buffer;
+}
+
+// static
+void AsyncLogQueue::OnThreadExit(void* buffer) {
+  if (buffer == NULL) {
+    return;
+  }
+  // The exiting thread's messages stay in the buffer until they're flushed,
+  // whether or not another thread has taken the buffer over by then.
+  ThreadBuffer* thread_buffer = static_cast<ThreadBuffer*>(buffer);
+  AsyncLogQueue* owner = thread_buffer->owner();
+  base::AutoLock autolock(owner->buffers_lock_);
+  owner->free_buffers_.push_back(thread_buffer);
+}
+
+void AsyncLogQueue::RunFlusher() {
+  const base::TimeDelta interval =
+      base::TimeDelta::FromMilliseconds(kFlushIntervalMillis);
+  while (true) {
+    {
+      base::AutoLock autolock(stop_lock_);
+      if (!stopping_) {
+        stop_condvar_.TimedWait(interval);
+      }
+      if (stopping_) {
+        return;
+      }
+    }
+    Flush();
+  }
+}
+
+}  // namespace mod_spdy
@@ -0,0 +1,145 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MOD_SPDY_COMMON_ASYNC_LOG_QUEUE_H_
+#define MOD_SPDY_COMMON_ASYNC_LOG_QUEUE_H_
+
+#include <string>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/thread_local_storage.h"
+
+namespace mod_spdy {
+
+// Hands log messages from the threads that log them to a background flusher
+// thread that writes them, so that logging never makes a connection or
+// stream thread wait on the log's locks or I/O.  Each logging thread appends
+// to its own fixed-size ring buffer, which only the flusher removes from, so
+// adding a message takes no locks; if a thread's buffer is full, the message
+// is dropped and counted instead.  Each log statement (identified by file and
+// line) is also limited to a fixed number of messages per second, so that an
+// error repeating in a tight loop can't crowd out everything else.  Counts of
+// dropped and suppressed messages are written along with the messages.
+//
+// Messages from any one thread are written in order; messages from different
+// threads are not ordered with respect to each other.  This class must not
+// itself log, since it is used to implement logging.  AddMessage() and
+// Flush() may be called from any thread.
+class AsyncLogQueue {
+ public:
+  // Writes messages out.  Only called on one thread at a time (normally, the
+  // flusher thread).
+  class Writer {
+   public:
+    Writer() {}
+    virtual ~Writer();
+
+    // Write a message, with the level and target passed to AddMessage().
+    virtual void Write(int level, void* target,
+                       const std::string& message) = 0;
+
+    // Write one of the queue's own reports of dropped or suppressed
+    // messages.
+    virtual void WriteNote(const std::string& note) = 0;
+
+   private:
+    DISALLOW_COPY_AND_ASSIGN(Writer);
+  };
+
+  // The queue does not take ownership of the writer, which must outlive it.
+  // Each thread can have up to messages_per_thread messages waiting to be
+  // written, and each log statement gets up to max_messages_per_site
+  // messages per second (or any number, if max_messages_per_site is zero).
+  AsyncLogQueue(Writer* writer, size_t messages_per_thread,
+                int max_messages_per_site);
+  // Stops the flusher thread (if it was started), and writes out any
+  // remaining messages.
+  ~AsyncLogQueue();
+
+  // Start the flusher thread.  Return false if the thread could not be
+  // started, in which case messages are only written by Flush().
+  bool Start();
+
+  // Queue a message to be written by the flusher thread.  The file and line
+  // identify the log statement, for rate limiting; the file must be a string
+  // literal (e.g. __FILE__).  The level and target are passed through to the
+  // writer.  Return false if the message was dropped or suppressed.
+  bool AddMessage(const char* file, int line, int level, void* target,
+                  const std::string& message);
+
+  // Write all queued messages now, on the calling thread, e.g. before
+  // crashing on a fatal error.
+  void Flush();
+
+ private:
+  class ThreadBuffer;
+  class FlusherThread;
+
+  // Messages-per-second counts for one or more log statements (a given
+  // statement always uses the same site, but sites may be shared).
+  struct Site {
+    base::subtle::AtomicWord file;  // const char*; last suppressed statement
+    base::subtle::Atomic32 line;
+    base::subtle::Atomic32 second;  // which second count is for
+    base::subtle::Atomic32 count;
+    base::subtle::Atomic32 suppressed;  // not yet reported
+  };
+
+  static const size_t kNumSites;
+
+  // Return false if the statement has used up its messages for this second.
+  bool CheckRateLimit(const char* file, int line);
+
+  ThreadBuffer* GetCurrentThreadBuffer();
+  static void OnThreadExit(void* buffer);
+
+  // Run the flusher thread until stopping_ is set.
+  void RunFlusher();
+
+  Writer* const writer_;
+  const size_t messages_per_thread_;
+  const int max_messages_per_site_;
+  std::vector<Site> sites_;
+  base::subtle::Atomic32 dropped_;  // not yet reported
+  base::ThreadLocalStorage::Slot thread_buffer_slot_;
+
+  // Protects the buffer lists; only taken by a thread the first time it logs
+  // (or when it exits), and by the flusher.
+  base::Lock buffers_lock_;
+  // All buffers ever created.  A thread that exits leaves its buffer on the
+  // free list for a new thread to take over, so memory use is bounded by the
+  // peak number of threads.
+  std::vector<ThreadBuffer*> buffers_;
+  std::vector<ThreadBuffer*> free_buffers_;
+
+  // Held while removing messages from the buffers, so that there's only ever
+  // one reader.  Logging threads never take this lock.
+  base::Lock flush_lock_;
+
+  // Used to wake the flusher thread when it's time to stop.
+  base::Lock stop_lock_;
+  base::ConditionVariable stop_condvar_;
+  bool stopping_;  // protected by stop_lock_
+  scoped_ptr<FlusherThread> flusher_;  // NULL unless Start() succeeded
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncLogQueue);
+};
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_ASYNC_LOG_QUEUE_H_
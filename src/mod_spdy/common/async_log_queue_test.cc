@@ -0,0 +1,192 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mod_spdy/common/async_log_queue.h"
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const char* const kFile = "foo.cc";
+
+// Records what it's asked to write.  Messages are recorded as
+// "<level>:<target>:<message>", where target is the int it points to.
+class RecordingWriter : public mod_spdy::AsyncLogQueue::Writer {
+ public:
+  RecordingWriter() {}
+  virtual ~RecordingWriter() {}
+
+  virtual void Write(int level, void* target, const std::string& message) {
+    base::AutoLock autolock(lock_);
+    messages_.push_back(base::IntToString(level) + ":" +
+                        base::IntToString(*static_cast<int*>(target)) + ":" +
+                        message);
+  }
+
+  virtual void WriteNote(const std::string& note) {
+    base::AutoLock autolock(lock_);
+    notes_.push_back(note);
+  }
+
+  std::vector<std::string> messages() {
+    base::AutoLock autolock(lock_);
+    return messages_;
+  }
+
+  std::vector<std::string> notes() {
+    base::AutoLock autolock(lock_);
+    return notes_;
+  }
+
+ private:
+  base::Lock lock_;
+  std::vector<std::string> messages_;
+  std::vector<std::string> notes_;
+
+  DISALLOW_COPY_AND_ASSIGN(RecordingWriter);
+};
+
+class LoggingThread : public base::PlatformThread::Delegate {
+ public:
+  LoggingThread(mod_spdy::AsyncLogQueue* queue, int* target)
+      : queue_(queue), target_(target) {}
+  virtual ~LoggingThread() {}
+
+  virtual void ThreadMain() {
+    queue_->AddMessage(kFile, 1, 4, target_, "from thread");
+  }
+
+  void RunAndJoin() {
+    base::PlatformThreadHandle handle;
+    ASSERT_TRUE(base::PlatformThread::Create(0, this, &handle));
+    base::PlatformThread::Join(handle);
+  }
+
+ private:
+  mod_spdy::AsyncLogQueue* const queue_;
+  int* const target_;
+
+  DISALLOW_COPY_AND_ASSIGN(LoggingThread);
+};
+
+TEST(AsyncLogQueueTest, WritesMessagesInOrder) {
+  RecordingWriter writer;
+  int target = 7;
+  mod_spdy::AsyncLogQueue queue(&writer, 16, 0);
+  EXPECT_TRUE(queue.AddMessage(kFile, 1, 3, &target, "one"));
+  EXPECT_TRUE(queue.AddMessage(kFile, 2, 4, &target, "two"));
+  EXPECT_TRUE(queue.AddMessage(kFile, 1, 3, &target, "three"));
+  // Without a flusher thread, nothing is written until we flush.
+  EXPECT_TRUE(writer.messages().empty());
+
+  queue.Flush();
+  ASSERT_EQ(3u, writer.messages().size());
+  EXPECT_EQ("3:7:one", writer.messages()[0]);
+  EXPECT_EQ("4:7:two", writer.messages()[1]);
+  EXPECT_EQ("3:7:three", writer.messages()[2]);
+  EXPECT_TRUE(writer.notes().empty());
+
+  // Messages are only written once.
+  queue.Flush();
+  EXPECT_EQ(3u, writer.messages().size());
+}
+
+TEST(AsyncLogQueueTest, DropsMessagesWhenBufferIsFull) {
+  RecordingWriter writer;
+  int target = 0;
+  mod_spdy::AsyncLogQueue queue(&writer, 4, 0);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(queue.AddMessage(kFile, i, 3, &target, "kept"));
+  }
+  EXPECT_FALSE(queue.AddMessage(kFile, 5, 3, &target, "dropped"));
+  EXPECT_FALSE(queue.AddMessage(kFile, 6, 3, &target, "dropped"));
+
+  queue.Flush();
+  EXPECT_EQ(4u, writer.messages().size());
+  ASSERT_EQ(1u, writer.notes().size());
+  EXPECT_EQ("Dropped 2 log messages because the log buffer was full",
+            writer.notes()[0]);
+
+  // Flushing made room again.
+  EXPECT_TRUE(queue.AddMessage(kFile, 7, 3, &target, "kept"));
+}
+
+TEST(AsyncLogQueueTest, RateLimitsEachLogStatement) {
+  RecordingWriter writer;
+  int target = 0;
+  mod_spdy::AsyncLogQueue queue(&writer, 16, 2);
+  EXPECT_TRUE(queue.AddMessage(kFile, 10, 3, &target, "a"));
+  EXPECT_TRUE(queue.AddMessage(kFile, 10, 3, &target, "b"));
+  EXPECT_TRUE(queue.AddMessage(kFile, 11, 3, &target, "c"));
+  // Unless the clock ticks over to the next second right here, the next two
+  // messages from line 10 are suppressed.
+  const bool third = queue.AddMessage(kFile, 10, 3, &target, "d");
+  const bool fourth = queue.AddMessage(kFile, 10, 3, &target, "e");
+  if (third || fourth) {
+    return;
+  }
+
+  queue.Flush();
+  EXPECT_EQ(3u, writer.messages().size());
+  ASSERT_EQ(1u, writer.notes().size());
+  EXPECT_EQ("Suppressed 2 log messages from foo.cc:10 (more than 2 per "
+            "second)", writer.notes()[0]);
+}
+
+TEST(AsyncLogQueueTest, WritesMessagesFromExitedThreads) {
+  RecordingWriter writer;
+  int target = 1;
+  mod_spdy::AsyncLogQueue queue(&writer, 16, 0);
+  LoggingThread thread1(&queue, &target);
+  thread1.RunAndJoin();
+  // The second thread may take over the first one's buffer.
+  LoggingThread thread2(&queue, &target);
+  thread2.RunAndJoin();
+
+  queue.Flush();
+  ASSERT_EQ(2u, writer.messages().size());
+  EXPECT_EQ("4:1:from thread", writer.messages()[0]);
+  EXPECT_EQ("4:1:from thread", writer.messages()[1]);
+}
+
+TEST(AsyncLogQueueTest, FlusherThreadWritesMessages) {
+  RecordingWriter writer;
+  int target = 2;
+  {
+    mod_spdy::AsyncLogQueue queue(&writer, 16, 0);
+    ASSERT_TRUE(queue.Start());
+    EXPECT_TRUE(queue.AddMessage(kFile, 1, 3, &target, "first"));
+    const base::TimeTicks deadline =
+        base::TimeTicks::Now() + base::TimeDelta::FromSeconds(10);
+    while (writer.messages().empty() && base::TimeTicks::Now() < deadline) {
+      base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(10));
+    }
+    ASSERT_EQ(1u, writer.messages().size());
+    EXPECT_EQ("3:2:first", writer.messages()[0]);
+
+    EXPECT_TRUE(queue.AddMessage(kFile, 1, 3, &target, "last"));
+  }
+  // Deleting the queue writes out whatever was left.
+  ASSERT_EQ(2u, writer.messages().size());
+  EXPECT_EQ("3:2:last", writer.messages()[1]);
+}
+
+}  // namespace
@@ -0,0 +1,422 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/html_subresource_scanner.h"
+
+#include <string.h>  // for memchr
+
+#include <algorithm>
+#include <map>
+
+#include "base/logging.h"
+#include "base/strings/string_util.h"
+
+namespace {
+
+// Tags longer than this are skipped rather than buffered; real <link>,
+// <script>, and <img> tags are far shorter.
+const size_t kMaxTagLength = 2048;
+
+const char kHtmlWhitespace[] = " \t\r\n\f";
+
+bool IsHtmlWhitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f';
+}
+
+bool IsAsciiLetter(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+char ToLowerAscii(char c) {
+  return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+base::StringPiece TrimHtmlWhitespace(base::StringPiece str) {
+  const size_t start = str.find_first_not_of(kHtmlWhitespace);
+  if (start == base::StringPiece::npos) {
+    return base::StringPiece();
+  }
+  const size_t end = str.find_last_not_of(kHtmlWhitespace);
+  return str.substr(start, end - start + 1);
+}
+
+bool EqualsIgnoreCase(base::StringPiece a, base::StringPiece b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (ToLowerAscii(a[i]) != ToLowerAscii(b[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Parse the attributes of a tag (everything after the tag name) into a map
+// from lowercased attribute name to value.  If an attribute is repeated, the
+// first value wins, as it does in browsers.
+void ParseAttributes(base::StringPiece attrs,
+                     std::map<std::string, std::string>* out) {
+  size_t pos = 0;
+  while (true) {
+    pos = attrs.find_first_not_of(" \t\r\n\f/", pos);
+    if (pos == base::StringPiece::npos) {
+      return;
+    }
+    const size_t name_end = attrs.find_first_of(" \t\r\n\f/=", pos);
+    const std::string name = StringToLowerASCII(
+        attrs.substr(pos, name_end - pos).as_string());
+    pos = attrs.find_first_not_of(kHtmlWhitespace, name_end);
+    std::string value;
+    if (pos != base::StringPiece::npos && attrs[pos] == '=') {
+      pos = attrs.find_first_not_of(kHtmlWhitespace, pos + 1);
+      if (pos == base::StringPiece::npos) {
+        pos = attrs.size();
+      } else if (attrs[pos] == '"' || attrs[pos] == '\'') {
+        const size_t close = attrs.find(attrs[pos], pos + 1);
+        value = attrs.substr(pos + 1, close - pos - 1).as_string();
+        pos = (close == base::StringPiece::npos ? attrs.size() : close + 1);
+      } else {
+        const size_t end = attrs.find_first_of(kHtmlWhitespace, pos);
+        value = attrs.substr(pos, end - pos).as_string();
+        pos = (end == base::StringPiece::npos ? attrs.size() : end);
+      }
+    }
+    out->insert(std::make_pair(name, value));
+  }
+}
+
+// Get the given attribute's value as a URL, trimmed and with the one entity
+// that commonly shows up in URLs decoded.  Return the empty string if the
+// attribute is absent.
+std::string GetUrlAttribute(const std::map<std::string, std::string>& attrs,
+                            const std::string& name) {
+  const std::map<std::string, std::string>::const_iterator iter =
+      attrs.find(name);
+  if (iter == attrs.end()) {
+    return std::string();
+  }
+  std::string url = TrimHtmlWhitespace(iter->second).as_string();
+  ReplaceSubstringsAfterOffset(&url, 0, "&amp;", "&");
+  return url;
+}
+
+// Return true if the rel attribute value names a stylesheet that the browser
+// will load right away (i.e. not an alternate stylesheet).
+bool IsStylesheetRel(const std::string& rel) {
+  std::vector<std::string> tokens;
+  Tokenize(StringToLowerASCII(rel), kHtmlWhitespace, &tokens);
+  bool stylesheet = false;
+  for (std::vector<std::string>::const_iterator iter = tokens.begin();
+       iter != tokens.end(); ++iter) {
+    if (*iter == "stylesheet") {
+      stylesheet = true;
+    } else if (*iter == "alternate") {
+      return false;
+    }
+  }
+  return stylesheet;
+}
+
+// Remove "." and ".." segments from an absolute path (RFC 3986 section
+// 5.2.4).  Any query string is left alone.
+std::string RemoveDotSegments(base::StringPiece url) {
+  const size_t query = url.find('?');
+  const base::StringPiece path = url.substr(0, query);
+  std::vector<base::StringPiece> segments;
+  size_t pos = 1;  // skip the leading slash
+  while (pos <= path.size()) {
+    size_t slash = path.find('/', pos);
+    if (slash == base::StringPiece::npos) {
+      slash = path.size();
+    }
+    const base::StringPiece segment = path.substr(pos, slash - pos);
+    const bool last = (slash == path.size());
+    if (segment == ".") {
+      if (last) {
+        segments.push_back(base::StringPiece());
+      }
+    } else if (segment == "..") {
+      if (!segments.empty()) {
+        segments.pop_back();
+      }
+      if (last) {
+        segments.push_back(base::StringPiece());
+      }
+    } else {
+      segments.push_back(segment);
+    }
+    pos = slash + 1;
+  }
+  std::string result;
+  for (std::vector<base::StringPiece>::const_iterator iter = segments.begin();
+       iter != segments.end(); ++iter) {
+    result.push_back('/');
+    iter->AppendToString(&result);
+  }
+  if (result.empty()) {
+    result = "/";
+  }
+  if (query != base::StringPiece::npos) {
+    url.substr(query).AppendToString(&result);
+  }
+  return result;
+}
+
+}  // namespace
+
+namespace mod_spdy {
+
+HtmlSubresourceScanner::HtmlSubresourceScanner()
+    : state_(TEXT),
+      tag_overflow_(false),
+      quote_('\0'),
+      trailing_dashes_(0),
+      end_tag_matched_(0),
+      bytes_scanned_(0) {}
+
+HtmlSubresourceScanner::~HtmlSubresourceScanner() {}
+
+void HtmlSubresourceScanner::Scan(base::StringPiece data,
+                                  std::vector<Subresource>* found) {
+  bytes_scanned_ += data.size();
+  while (!data.empty()) {
+    switch (state_) {
+      case TEXT:
+      case RAW_TEXT: {
+        // This is where nearly all of the document's bytes go, so skip
+        // straight to the next '<'.
+        const char* lt = static_cast<const char*>(
+            memchr(data.data(), '<', data.size()));
+        if (lt == NULL) {
+          return;
+        }
+        data.remove_prefix(lt - data.data() + 1);
+        if (state_ == TEXT) {
+          StartTag();
+        } else {
+          state_ = RAW_TEXT_END_TAG;
+          end_tag_matched_ = 0;
+        }
+        break;
+      }
+      case TAG: {
+        size_t i = 0;
+        for (; i < data.size(); ++i) {
+          const char c = data[i];
+          if (quote_ != '\0') {
+            if (c == quote_) {
+              quote_ = '\0';
+            }
+          } else if (c == '>') {
+            break;
+          } else if (tag_.empty() && !tag_overflow_ &&
+                     !(IsAsciiLetter(c) || c == '/' || c == '!' ||
+                       c == '?')) {
+            // Not a tag after all, just a stray '<' in the text.
+            break;
+          } else if (c == '"' || c == '\'') {
+            quote_ = c;
+          }
+          if (tag_.size() < kMaxTagLength) {
+            tag_.push_back(c);
+          } else {
+            tag_overflow_ = true;
+          }
+          if (tag_.size() == 3 && tag_ == "!--") {
+            break;
+          }
+        }
+        if (i == data.size()) {
+          return;
+        }
+        if (data[i] == '>') {
+          data.remove_prefix(i + 1);
+          state_ = TEXT;
+          if (!tag_overflow_) {
+            ProcessTag(found);
+          }
+        } else if (tag_ == "!--") {
+          data.remove_prefix(i + 1);
+          state_ = COMMENT;
+          trailing_dashes_ = 0;
+        } else {
+          // A stray '<'; rescan the character that gave it away, since it
+          // may be another '<'.
+          data.remove_prefix(i);
+          state_ = TEXT;
+        }
+        break;
+      }
+      case COMMENT: {
+        const char* gt = static_cast<const char*>(
+            memchr(data.data(), '>', data.size()));
+        const size_t end = (gt == NULL ? data.size() : gt - data.data());
+        int dashes = 0;
+        size_t j = end;
+        while (j > 0 && dashes < 2 && data[j - 1] == '-') {
+          ++dashes;
+          --j;
+        }
+        if (j == 0) {
+          dashes = std::min(2, dashes + trailing_dashes_);
+        }
+        if (gt == NULL) {
+          trailing_dashes_ = dashes;
+          return;
+        }
+        data.remove_prefix(end + 1);
+        trailing_dashes_ = 0;
+        if (dashes == 2) {
+          state_ = TEXT;
+        }
+        break;
+      }
+      case RAW_TEXT_END_TAG: {
+        const char c = data[0];
+        if (end_tag_matched_ < raw_text_end_tag_.size()) {
+          if (ToLowerAscii(c) == raw_text_end_tag_[end_tag_matched_]) {
+            ++end_tag_matched_;
+            data.remove_prefix(1);
+          } else {
+            // Not our end tag; rescan this character as raw text.
+            state_ = RAW_TEXT;
+          }
+        } else if (IsHtmlWhitespace(c) || c == '/' || c == '>') {
+          // That's the end of the element; whatever follows the tag name is
+          // of no interest, so finish the tag as an ordinary one.
+          raw_text_end_tag_.clear();
+          StartTag();
+          tag_overflow_ = true;
+        } else {
+          state_ = RAW_TEXT;
+        }
+        break;
+      }
+      default:
+        LOG(DFATAL) << "Invalid scanner state: " << state_;
+        state_ = TEXT;
+        break;
+    }
+  }
+}
+
+// static
+bool HtmlSubresourceScanner::ResolveSameOriginUrl(base::StringPiece url,
+                                                  base::StringPiece scheme,
+                                                  base::StringPiece host,
+                                                  base::StringPiece base_path,
+                                                  std::string* path) {
+  url = TrimHtmlWhitespace(url);
+  // A fragment never makes a difference to what we'd push.
+  url = url.substr(0, url.find('#'));
+  if (url.empty()) {
+    return false;
+  }
+
+  // Absolute URLs must have our scheme (and, below, our host).
+  const size_t colon = url.find(':');
+  if (colon != base::StringPiece::npos &&
+      colon < url.find_first_of("/?")) {
+    if (!EqualsIgnoreCase(url.substr(0, colon), scheme)) {
+      return false;
+    }
+    url.remove_prefix(colon + 1);
+    if (!url.starts_with("//")) {
+      return false;
+    }
+  }
+
+  std::string resolved;
+  if (url.starts_with("//")) {
+    url.remove_prefix(2);
+    const size_t authority_end = url.find_first_of("/?");
+    if (!EqualsIgnoreCase(url.substr(0, authority_end), host)) {
+      return false;
+    }
+    url.remove_prefix(authority_end == base::StringPiece::npos ?
+                      url.size() : authority_end);
+    if (!url.starts_with("/")) {
+      resolved = "/";
+    }
+    url.AppendToString(&resolved);
+  } else if (url[0] == '/') {
+    url.AppendToString(&resolved);
+  } else {
+    base_path = base_path.substr(0, base_path.find_first_of("?#"));
+    if (url[0] == '?') {
+      base_path.AppendToString(&resolved);
+    } else {
+      base_path.substr(0, base_path.rfind('/') + 1).AppendToString(&resolved);
+    }
+    url.AppendToString(&resolved);
+    if (resolved.empty() || resolved[0] != '/') {
+      resolved.insert(0, "/");
+    }
+  }
+  *path = RemoveDotSegments(resolved);
+  return true;
+}
+
+void HtmlSubresourceScanner::StartTag() {
+  state_ = TAG;
+  tag_.clear();
+  tag_overflow_ = false;
+  quote_ = '\0';
+}
+
+void HtmlSubresourceScanner::ProcessTag(std::vector<Subresource>* found) {
+  const base::StringPiece tag(tag_);
+  const size_t name_end = tag.find_first_of(" \t\r\n\f/", 1);
+  const std::string name =
+      StringToLowerASCII(tag.substr(0, name_end).as_string());
+  if (name != "link" && name != "script" && name != "img" &&
+      name != "style") {
+    return;
+  }
+
+  std::map<std::string, std::string> attrs;
+  if (name_end != base::StringPiece::npos) {
+    ParseAttributes(tag.substr(name_end), &attrs);
+  }
+
+  if (name == "link") {
+    const std::map<std::string, std::string>::const_iterator rel =
+        attrs.find("rel");
+    if (rel != attrs.end() && IsStylesheetRel(rel->second)) {
+      const std::string href = GetUrlAttribute(attrs, "href");
+      if (!href.empty()) {
+        found->push_back(Subresource(href, STYLESHEET));
+      }
+    }
+  } else if (name == "img") {
+    const std::string src = GetUrlAttribute(attrs, "src");
+    if (!src.empty()) {
+      found->push_back(Subresource(src, IMAGE));
+    }
+  } else {
+    if (name == "script") {
+      const std::string src = GetUrlAttribute(attrs, "src");
+      if (!src.empty()) {
+        found->push_back(Subresource(src, SCRIPT));
+      }
+    }
+    // The contents of <script> and <style> elements aren't HTML, so skip
+    // them until the matching end tag.
+    state_ = RAW_TEXT;
+    raw_text_end_tag_ = "/" + name;
+  }
+}
+
+}  // namespace mod_spdy
@@ -0,0 +1,103 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MOD_SPDY_COMMON_HTML_SUBRESOURCE_SCANNER_H_
+#define MOD_SPDY_COMMON_HTML_SUBRESOURCE_SCANNER_H_
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+
+namespace mod_spdy {
+
+// Finds the subresources referenced by an HTML document -- stylesheets
+// (<link rel=stylesheet href=...>), scripts (<script src=...>), and images
+// (<img src=...>) -- as the document streams past, so that they can be pushed
+// before the client has even seen the reference.  The scanner never buffers
+// the document: text between tags is skipped with memchr (which the C library
+// vectorizes), and only the inside of a tag is ever copied, up to a bounded
+// length.  Comments and the contents of <script> and <style> elements are
+// skipped.
+//
+// This is deliberately not a full HTML tokenizer; it aims to find the common
+// cases cheaply, and can afford to miss the odd resource, since a missed push
+// just means the client fetches the resource itself.  This class is not
+// thread-safe.
+class HtmlSubresourceScanner {
+ public:
+  enum Type {
+    STYLESHEET,
+    SCRIPT,
+    IMAGE
+  };
+
+  struct Subresource {
+    Subresource(const std::string& url, Type type) : url(url), type(type) {}
+
+    std::string url;  // as written in the document (with entities decoded)
+    Type type;
+  };
+
+  HtmlSubresourceScanner();
+  ~HtmlSubresourceScanner();
+
+  // Scan the next chunk of the document, appending any subresources whose
+  // references end within this chunk to *found.
+  void Scan(base::StringPiece data, std::vector<Subresource>* found);
+
+  // Total number of document bytes scanned so far.
+  size_t bytes_scanned() const { return bytes_scanned_; }
+
+  // Resolve a subresource URL, found in a document at base_path (an absolute
+  // path, possibly with a query string) on the given scheme and host, into an
+  // absolute path on the same origin.  Return false if the URL refers to a
+  // different origin, or isn't something we could push at all (e.g. a data:
+  // URL).
+  static bool ResolveSameOriginUrl(base::StringPiece url,
+                                   base::StringPiece scheme,
+                                   base::StringPiece host,
+                                   base::StringPiece base_path,
+                                   std::string* path);
+
+ private:
+  enum State {
+    TEXT,      // between tags
+    TAG,       // inside a tag (after the '<')
+    COMMENT,   // inside a <!-- comment -->
+    RAW_TEXT,  // inside the contents of a <script> or <style> element
+    RAW_TEXT_END_TAG  // possibly at the end tag of a RAW_TEXT element
+  };
+
+  // Start scanning a new tag (just after its '<').
+  void StartTag();
+  // Handle the complete tag in tag_.
+  void ProcessTag(std::vector<Subresource>* found);
+
+  State state_;
+  std::string tag_;  // contents of the current tag so far
+  bool tag_overflow_;  // current tag was too long to bother with
+  char quote_;  // quote character we're inside in the current tag, if any
+  int trailing_dashes_;  // consecutive '-' just before, when in COMMENT
+  std::string raw_text_end_tag_;  // "/script" or "/style", when in RAW_TEXT
+  size_t end_tag_matched_;  // chars of raw_text_end_tag_ seen so far
+  size_t bytes_scanned_;
+
+  DISALLOW_COPY_AND_ASSIGN(HtmlSubresourceScanner);
+};
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_HTML_SUBRESOURCE_SCANNER_H_
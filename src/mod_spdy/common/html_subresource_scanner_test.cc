@@ -0,0 +1,128 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/html_subresource_scanner.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/strings/string_piece.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+using mod_spdy::HtmlSubresourceScanner;
+
+const char kDocument[] =
+    "<!DOCTYPE html>\n"
+    "<html><head>\n"
+    "<LINK REL=\"stylesheet\" HREF=\"/css/site.css\">\n"
+    "<link rel='alternate stylesheet' href='/css/dark.css'>\n"
+    "<link rel=icon href=/favicon.ico>\n"
+    "<!-- <script src=\"/js/commented.js\"></script> -->\n"
+    "<script src=js/app.js?a=1&amp;b=2></script>\n"
+    "<script>if (a<b) { document.write('<img src=\"/img/no.png\">'); }"
+    "</script >\n"
+    "<style>body > p { color: red; }</style>\n"
+    "</head><body>\n"
+    "<p>1 < 2 and 3 > 2</p><img alt=\"a > b\" src=\"../img/logo.png\"/>\n"
+    "</body></html>\n";
+
+// Scan the document in chunks of the given size, returning the URLs found.
+std::vector<std::string> ScanInChunks(base::StringPiece document,
+                                      size_t chunk_size) {
+  HtmlSubresourceScanner scanner;
+  std::vector<HtmlSubresourceScanner::Subresource> found;
+  while (!document.empty()) {
+    const size_t size = std::min(chunk_size, document.size());
+    scanner.Scan(document.substr(0, size), &found);
+    document.remove_prefix(size);
+  }
+  std::vector<std::string> urls;
+  for (size_t i = 0; i < found.size(); ++i) {
+    urls.push_back(found[i].url);
+  }
+  return urls;
+}
+
+TEST(HtmlSubresourceScannerTest, FindSubresources) {
+  HtmlSubresourceScanner scanner;
+  std::vector<HtmlSubresourceScanner::Subresource> found;
+  scanner.Scan(kDocument, &found);
+  EXPECT_EQ(sizeof(kDocument) - 1, scanner.bytes_scanned());
+
+  ASSERT_EQ(3u, found.size());
+  EXPECT_EQ("/css/site.css", found[0].url);
+  EXPECT_EQ(HtmlSubresourceScanner::STYLESHEET, found[0].type);
+  EXPECT_EQ("js/app.js?a=1&b=2", found[1].url);
+  EXPECT_EQ(HtmlSubresourceScanner::SCRIPT, found[1].type);
+  EXPECT_EQ("../img/logo.png", found[2].url);
+  EXPECT_EQ(HtmlSubresourceScanner::IMAGE, found[2].type);
+}
+
+// Test that the result doesn't depend on where the chunk boundaries fall.
+TEST(HtmlSubresourceScannerTest, ChunkBoundaries) {
+  const std::vector<std::string> expected = ScanInChunks(kDocument, 100000);
+  ASSERT_EQ(3u, expected.size());
+  for (size_t chunk_size = 1; chunk_size < 40; ++chunk_size) {
+    EXPECT_EQ(expected, ScanInChunks(kDocument, chunk_size))
+        << "chunk size " << chunk_size;
+  }
+}
+
+TEST(HtmlSubresourceScannerTest, OverlongTag) {
+  std::string document = "<img alt=\"";
+  document.append(10000, 'x');
+  document.append("\" src=\"/a.png\"><img src=\"/b.png\">");
+  const std::vector<std::string> urls = ScanInChunks(document, 1000);
+  ASSERT_EQ(1u, urls.size());
+  EXPECT_EQ("/b.png", urls[0]);
+}
+
+TEST(HtmlSubresourceScannerTest, ResolveSameOriginUrl) {
+  std::string path;
+  const char kBase[] = "/dir/page.html?x=1";
+#define EXPECT_RESOLVES(expected, url)                                      \
+  EXPECT_TRUE(HtmlSubresourceScanner::ResolveSameOriginUrl(                 \
+      url, "https", "www.example.com", kBase, &path)) << url;               \
+  EXPECT_EQ(expected, path)
+#define EXPECT_NOT_RESOLVED(url)                                            \
+  EXPECT_FALSE(HtmlSubresourceScanner::ResolveSameOriginUrl(                \
+      url, "https", "www.example.com", kBase, &path)) << url
+
+  EXPECT_RESOLVES("/css/site.css", "/css/site.css");
+  EXPECT_RESOLVES("/dir/app.js", "app.js");
+  EXPECT_RESOLVES("/dir/js/app.js?v=2", " js/app.js?v=2#frag ");
+  EXPECT_RESOLVES("/img/logo.png", "../img/logo.png");
+  EXPECT_RESOLVES("/img/logo.png", "../../img/./logo.png");
+  EXPECT_RESOLVES("/dir/page.html?y=2", "?y=2");
+  EXPECT_RESOLVES("/a.css", "https://www.example.com/a.css");
+  EXPECT_RESOLVES("/a.css", "HTTPS://WWW.Example.COM/a.css");
+  EXPECT_RESOLVES("/a.css", "//www.example.com/a.css");
+  EXPECT_RESOLVES("/", "//www.example.com");
+
+  EXPECT_NOT_RESOLVED("");
+  EXPECT_NOT_RESOLVED("#top");
+  EXPECT_NOT_RESOLVED("http://www.example.com/a.css");
+  EXPECT_NOT_RESOLVED("https://cdn.example.com/a.css");
+  EXPECT_NOT_RESOLVED("//cdn.example.com/a.css");
+  EXPECT_NOT_RESOLVED("data:image/png;base64,AAAA");
+  EXPECT_NOT_RESOLVED("javascript:void(0)");
+
+#undef EXPECT_RESOLVES
+#undef EXPECT_NOT_RESOLVED
+}
+
+}  // namespace
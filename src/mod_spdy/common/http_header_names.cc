@@ -0,0 +1,206 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/http_header_names.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+
+namespace {
+
+// The well-known header names, in alphabetical order.
+const mod_spdy::KnownHttpHeaderName kKnownNames[] = {
+  {"accept", 6, false},
+  {"accept-charset", 14, false},
+  {"accept-encoding", 15, false},
+  {"accept-language", 15, false},
+  {"accept-ranges", 13, false},
+  {"access-control-allow-origin", 27, false},
+  {"age", 3, false},
+  {"allow", 5, false},
+  {"authorization", 13, false},
+  {"cache-control", 13, false},
+  {"connection", 10, true},
+  {"content-disposition", 19, false},
+  {"content-encoding", 16, false},
+  {"content-language", 16, false},
+  {"content-length", 14, false},
+  {"content-location", 16, false},
+  {"content-range", 13, false},
+  {"content-security-policy", 23, false},
+  {"content-type", 12, false},
+  {"cookie", 6, false},
+  {"date", 4, false},
+  {"etag", 4, false},
+  {"expect", 6, false},
+  {"expires", 7, false},
+  {"from", 4, false},
+  {"host", 4, false},
+  {"if-match", 8, false},
+  {"if-modified-since", 17, false},
+  {"if-none-match", 13, false},
+  {"if-range", 8, false},
+  {"if-unmodified-since", 19, false},
+  {"keep-alive", 10, true},
+  {"last-modified", 13, false},
+  {"link", 4, false},
+  {"location", 8, false},
+  {"max-forwards", 12, false},
+  {"pragma", 6, false},
+  {"proxy-authenticate", 18, false},
+  {"proxy-authorization", 19, false},
+  {"proxy-connection", 16, true},
+  {"range", 5, false},
+  {"referer", 7, false},
+  {"refresh", 7, false},
+  {"retry-after", 11, false},
+  {"server", 6, false},
+  {"set-cookie", 10, false},
+  {"strict-transport-security", 25, false},
+  {"te", 2, false},
+  {"trailer", 7, false},
+  {"transfer-encoding", 17, true},
+  {"upgrade", 7, false},
+  {"user-agent", 10, false},
+  {"vary", 4, false},
+  {"via", 3, false},
+  {"warning", 7, false},
+  {"www-authenticate", 16, false},
+  {"x-associated-content", 20, false},
+  {"x-content-type-options", 22, false},
+  {"x-frame-options", 15, false},
+  {"x-mod-spdy", 10, false},
+  {"x-powered-by", 12, false},
+  {"x-xss-protection", 16, false},
+};
+
+const size_t kMaxKnownNameLength = 27;  // access-control-allow-origin
+const uint8 kNoName = 255;
+
+// Maps each value of HashName() to the index in kKnownNames of the one name
+// with that hash, or to kNoName.  The multipliers in HashName() were found by
+// searching for ones for which no two of the names above collide; if you add a
+// name, the HttpHeaderNamesTest.AllNamesFound test will tell you if you need
+// to search again.
+const uint8 kNameSlots[256] = {
+  255, 255, 255, 255, 255,  13, 255, 255, 255, 255, 255, 255,
+    4,   7,  54,  29, 255, 255, 255, 255, 255,  35,  34, 255,
+  255,  37, 255, 255, 255, 255, 255, 255, 255, 255,  36,  53,
+  255, 255,  26, 255, 255,  21,   5, 255, 255,  23, 255, 255,
+   60, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255,   0, 255, 255, 255, 255,   2, 255, 255, 255, 255,
+  255,   6, 255, 255,  22,  59, 255,  56, 255, 255, 255, 255,
+  255,  31, 255,  42,  11, 255,  39, 255, 255, 255,  32, 255,
+  255,  14, 255,  24, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255,  20, 255,  19, 255, 255,
+  255,  30,  44, 255,  40, 255, 255, 255, 255, 255, 255, 255,
+   61, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,   1,
+  255, 255, 255, 255, 255, 255, 255,  28, 255,   9, 255, 255,
+  255, 255, 255, 255, 255, 255,  12, 255,  33, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255,  17,  50, 255,  15,
+  255, 255,  18, 255, 255, 255,  58, 255, 255, 255,  51, 255,
+   27, 255, 255,  38, 255,  52,  48,  55, 255, 255, 255, 255,
+   57,  43, 255,  25, 255, 255, 255, 255,  41, 255, 255, 255,
+  255,  46, 255, 255, 255, 255, 255, 255, 255, 255,  16,  10,
+    3, 255, 255,  45, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255,  47,  49, 255,
+  255,   8, 255, 255
+};
+
+inline unsigned int ToLowerASCII(unsigned char c) {
+  return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// Hash the length and the first, middle, and last characters of a non-empty
+// name, ignoring case.
+inline unsigned int HashName(const base::StringPiece& name) {
+  const size_t length = name.size();
+  const unsigned int hash =
+      (static_cast<unsigned int>(length) * 342u) ^
+      (ToLowerASCII(name[0]) * 576u) ^
+      (ToLowerASCII(name[length - 1]) * 669u) ^
+      (ToLowerASCII(name[length / 2]) * 280u);
+  return (hash ^ (hash >> 7)) & 255u;
+}
+
+}  // namespace
+
+namespace mod_spdy {
+
+const KnownHttpHeaderName* LookupHttpHeaderName(
+    const base::StringPiece& name) {
+  if (name.empty() || name.size() > kMaxKnownNameLength) {
+    return NULL;
+  }
+  const uint8 index = kNameSlots[HashName(name)];
+  if (index == kNoName) {
+    return NULL;
+  }
+  const KnownHttpHeaderName* known = &kKnownNames[index];
+  if (known->length != name.size()) {
+    return NULL;
+  }
+  for (size_t i = 0; i < known->length; ++i) {
+    if (ToLowerASCII(name[i]) != static_cast<unsigned char>(known->name[i])) {
+      return NULL;
+    }
+  }
+  return known;
+}
+
+void AppendLowerCaseASCII(const base::StringPiece& input, std::string* output) {
+  const size_t start = output->size();
+  output->resize(start + input.size());
+  const char* in = input.data();
+  const char* const end = in + input.size();
+  char* out = &(*output)[0] + start;
+
+#if defined(__SSE2__)
+  // Add 0x20 to each byte that is between 'A' and 'Z'.  The comparisons are
+  // signed, so bytes of 0x80 and above count as less than 'A'.
+  const __m128i before_a = _mm_set1_epi8('A' - 1);
+  const __m128i after_z = _mm_set1_epi8('Z' + 1);
+  const __m128i case_bit = _mm_set1_epi8('a' - 'A');
+  for (; end - in >= 16; in += 16, out += 16) {
+    const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(chars, before_a),
+                                        _mm_cmplt_epi8(chars, after_z));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                     _mm_add_epi8(chars, _mm_and_si128(upper, case_bit)));
+  }
+#endif
+
+  for (; in < end; ++in, ++out) {
+    *out = static_cast<char>(ToLowerASCII(*in));
+  }
+}
+
+void LowerCaseHttpHeaderName(const base::StringPiece& name,
+                             std::string* output) {
+  const KnownHttpHeaderName* known = LookupHttpHeaderName(name);
+  if (known != NULL) {
+    output->assign(known->name, known->length);
+  } else {
+    output->clear();
+    AppendLowerCaseASCII(name, output);
+  }
+}
+
+}  // namespace mod_spdy
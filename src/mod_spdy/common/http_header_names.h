@@ -0,0 +1,53 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MOD_SPDY_COMMON_HTTP_HEADER_NAMES_H_
+#define MOD_SPDY_COMMON_HTTP_HEADER_NAMES_H_
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+
+namespace mod_spdy {
+
+// A well-known HTTP header name, as found by LookupHttpHeaderName().
+struct KnownHttpHeaderName {
+  const char* name;  // lower-case, ready for use in a SPDY header block
+  size_t length;
+  // True for the hop-by-hop headers that are forbidden in SPDY responses
+  // (SPDY draft 3 section 3.2.2).
+  bool forbidden_in_spdy_response;
+};
+
+// Look up a header name (in any case) in a static table of well-known HTTP
+// header names, returning NULL if it isn't one.  The table uses a perfect
+// hash, so this costs one hash of three characters and one comparison, which
+// makes it much cheaper than lower-casing the name or comparing it against
+// several names in turn.
+const KnownHttpHeaderName* LookupHttpHeaderName(const base::StringPiece& name);
+
+// Append a copy of the input to the output, with ASCII letters lower-cased.
+// This examines the input a block at a time where the CPU supports it
+// (SSE2), for header names that aren't in the table.
+void AppendLowerCaseASCII(const base::StringPiece& input, std::string* output);
+
+// Set the output to the lower-case form of a header name, using the interned
+// name if it is well-known.
+void LowerCaseHttpHeaderName(const base::StringPiece& name,
+                             std::string* output);
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_HTTP_HEADER_NAMES_H_
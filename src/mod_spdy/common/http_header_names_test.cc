@@ -0,0 +1,127 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/http_header_names.h"
+
+#include <string>
+
+#include "base/strings/string_piece.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const char* const kNames[] = {
+  "accept", "accept-charset", "accept-encoding", "accept-language",
+  "accept-ranges", "access-control-allow-origin", "age", "allow",
+  "authorization", "cache-control", "connection", "content-disposition",
+  "content-encoding", "content-language", "content-length",
+  "content-location", "content-range", "content-security-policy",
+  "content-type", "cookie", "date", "etag", "expect", "expires", "from",
+  "host", "if-match", "if-modified-since", "if-none-match", "if-range",
+  "if-unmodified-since", "keep-alive", "last-modified", "link", "location",
+  "max-forwards", "pragma", "proxy-authenticate", "proxy-authorization",
+  "proxy-connection", "range", "referer", "refresh", "retry-after", "server",
+  "set-cookie", "strict-transport-security", "te", "trailer",
+  "transfer-encoding", "upgrade", "user-agent", "vary", "via", "warning",
+  "www-authenticate", "x-associated-content", "x-content-type-options",
+  "x-frame-options", "x-mod-spdy", "x-powered-by", "x-xss-protection",
+};
+
+// Lower-case one character at a time, for comparison.
+std::string SlowLowerCase(const base::StringPiece& input) {
+  std::string output;
+  for (size_t i = 0; i < input.size(); ++i) {
+    const char c = input[i];
+    output.push_back(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+  }
+  return output;
+}
+
+TEST(HttpHeaderNamesTest, AllNamesFound) {
+  for (size_t i = 0; i < arraysize(kNames); ++i) {
+    const std::string name(kNames[i]);
+    std::string upper;
+    for (size_t j = 0; j < name.size(); ++j) {
+      upper.push_back(j % 2 == 0 && name[j] >= 'a' && name[j] <= 'z' ?
+                      name[j] - 'a' + 'A' : name[j]);
+    }
+    const mod_spdy::KnownHttpHeaderName* known =
+        mod_spdy::LookupHttpHeaderName(upper);
+    ASSERT_TRUE(known != NULL) << name;
+    EXPECT_EQ(name, std::string(known->name, known->length));
+    EXPECT_EQ(known, mod_spdy::LookupHttpHeaderName(name));
+  }
+}
+
+TEST(HttpHeaderNamesTest, ForbiddenInSpdyResponse) {
+  int num_forbidden = 0;
+  for (size_t i = 0; i < arraysize(kNames); ++i) {
+    if (mod_spdy::LookupHttpHeaderName(kNames[i])->
+        forbidden_in_spdy_response) {
+      ++num_forbidden;
+    }
+  }
+  EXPECT_EQ(4, num_forbidden);
+  EXPECT_TRUE(mod_spdy::LookupHttpHeaderName("Connection")->
+              forbidden_in_spdy_response);
+  EXPECT_TRUE(mod_spdy::LookupHttpHeaderName("Keep-Alive")->
+              forbidden_in_spdy_response);
+  EXPECT_TRUE(mod_spdy::LookupHttpHeaderName("Proxy-Connection")->
+              forbidden_in_spdy_response);
+  EXPECT_TRUE(mod_spdy::LookupHttpHeaderName("Transfer-Encoding")->
+              forbidden_in_spdy_response);
+}
+
+TEST(HttpHeaderNamesTest, UnknownNames) {
+  EXPECT_TRUE(mod_spdy::LookupHttpHeaderName("") == NULL);
+  EXPECT_TRUE(mod_spdy::LookupHttpHeaderName("x") == NULL);
+  EXPECT_TRUE(mod_spdy::LookupHttpHeaderName("x-foo") == NULL);
+  EXPECT_TRUE(mod_spdy::LookupHttpHeaderName("connectiom") == NULL);
+  EXPECT_TRUE(mod_spdy::LookupHttpHeaderName("content-lengths") == NULL);
+  EXPECT_TRUE(mod_spdy::LookupHttpHeaderName("content_length") == NULL);
+  EXPECT_TRUE(mod_spdy::LookupHttpHeaderName(
+      "access-control-allow-originx") == NULL);
+  // Characters that only match a name if you set their 0x20 bit.
+  EXPECT_TRUE(mod_spdy::LookupHttpHeaderName("accept\rcharset") == NULL);
+  // An embedded NUL in an otherwise-matching name.
+  EXPECT_TRUE(mod_spdy::LookupHttpHeaderName(
+      base::StringPiece("dat\0", 4)) == NULL);
+}
+
+// Lower-case strings of every length up to a few blocks, at every alignment,
+// including bytes with the high bit set, and check against the simple loop.
+TEST(HttpHeaderNamesTest, AppendLowerCaseASCII) {
+  std::string source;
+  for (int i = 0; i < 256; ++i) {
+    source.push_back(static_cast<char>((i * 37 + 11) % 256));
+  }
+  for (size_t offset = 0; offset < 16; ++offset) {
+    for (size_t size = 0; size + offset <= 80; ++size) {
+      const base::StringPiece input(source.data() + offset, size);
+      std::string output("prefix");
+      mod_spdy::AppendLowerCaseASCII(input, &output);
+      EXPECT_EQ("prefix" + SlowLowerCase(input), output);
+    }
+  }
+}
+
+TEST(HttpHeaderNamesTest, LowerCaseHttpHeaderName) {
+  std::string output("junk");
+  mod_spdy::LowerCaseHttpHeaderName("Content-Type", &output);
+  EXPECT_EQ("content-type", output);
+  mod_spdy::LowerCaseHttpHeaderName("X-Some-Other-Header", &output);
+  EXPECT_EQ("x-some-other-header", output);
+}
+
+}  // namespace
@@ -0,0 +1,103 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/http_line_scanner.h"
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "base/strings/string_piece.h"
+
+namespace {
+
+// Scan one byte at a time for a CRLF starting in [start, end - 1), using
+// memchr to skip to each CR.  Returns end if there is none.
+const char* ScalarFindCrlf(const char* start, const char* end) {
+  const char* cr = start;
+  while (end - cr >= 2) {
+    cr = static_cast<const char*>(memchr(cr, '\r', end - cr - 1));
+    if (cr == NULL) {
+      return end;
+    }
+    if (cr[1] == '\n') {
+      return cr;
+    }
+    ++cr;
+  }
+  return end;
+}
+
+}  // namespace
+
+namespace mod_spdy {
+
+size_t FindCrlf(const base::StringPiece& data) {
+  const char* const begin = data.data();
+  const char* const end = begin + data.size();
+  const char* block = begin;
+
+  // Compare each block against CR, and the same block shifted by one byte
+  // against LF; a CRLF starts wherever both match.  The shifted load reads
+  // one byte past the block, so stop while there's still a byte to spare.
+#if defined(__AVX2__)
+  const __m256i cr = _mm256_set1_epi8('\r');
+  const __m256i lf = _mm256_set1_epi8('\n');
+  for (; end - block > 32; block += 32) {
+    const __m256i here = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(block));
+    const __m256i next = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(block + 1));
+    const unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(here, cr),
+                         _mm256_cmpeq_epi8(next, lf))));
+    if (mask != 0) {
+      return block - begin + __builtin_ctz(mask);
+    }
+  }
+#elif defined(__SSE2__)
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i lf = _mm_set1_epi8('\n');
+  for (; end - block > 16; block += 16) {
+    const __m128i here = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(block));
+    const __m128i next = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(block + 1));
+    const unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(here, cr), _mm_cmpeq_epi8(next, lf))));
+    if (mask != 0) {
+      return block - begin + __builtin_ctz(mask);
+    }
+  }
+#endif
+
+  // Finish off whatever is left (or everything, on other CPUs).
+  const char* const found = ScalarFindCrlf(block, end);
+  return found == end ? base::StringPiece::npos : found - begin;
+}
+
+size_t FindByte(const base::StringPiece& data, char c) {
+  if (data.empty()) {
+    return base::StringPiece::npos;
+  }
+  const char* const found =
+      static_cast<const char*>(memchr(data.data(), c, data.size()));
+  return found == NULL ? base::StringPiece::npos : found - data.data();
+}
+
+}  // namespace mod_spdy
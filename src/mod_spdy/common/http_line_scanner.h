@@ -0,0 +1,36 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MOD_SPDY_COMMON_HTTP_LINE_SCANNER_H_
+#define MOD_SPDY_COMMON_HTTP_LINE_SCANNER_H_
+
+#include "base/strings/string_piece.h"
+
+namespace mod_spdy {
+
+// Return the position of the first CRLF in the data, or
+// base::StringPiece::npos if there is none.  This is equivalent to
+// data.find("\r\n"), but where the CPU supports it (SSE2, or AVX2 if we were
+// compiled for it), it examines the data a whole block at a time, which makes
+// a real difference when scanning HTTP headers and chunk lines.
+size_t FindCrlf(const base::StringPiece& data);
+
+// Return the position of the first occurrence of the byte c in the data, or
+// base::StringPiece::npos if there is none.  Unlike StringPiece::find, this
+// uses memchr, which the C library already vectorizes.
+size_t FindByte(const base::StringPiece& data, char c);
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_HTTP_LINE_SCANNER_H_
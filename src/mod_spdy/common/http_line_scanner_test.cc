@@ -0,0 +1,64 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/http_line_scanner.h"
+
+#include <string>
+
+#include "base/strings/string_piece.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+TEST(HttpLineScannerTest, FindCrlf) {
+  EXPECT_EQ(base::StringPiece::npos, mod_spdy::FindCrlf(""));
+  EXPECT_EQ(base::StringPiece::npos, mod_spdy::FindCrlf("\r"));
+  EXPECT_EQ(base::StringPiece::npos, mod_spdy::FindCrlf("\n\r"));
+  EXPECT_EQ(0u, mod_spdy::FindCrlf("\r\n"));
+  EXPECT_EQ(1u, mod_spdy::FindCrlf("\r\r\n\r\n"));
+  EXPECT_EQ(10u, mod_spdy::FindCrlf("Foo: bar\r\r\r\nBaz: quux\r\n"));
+}
+
+// Put a CRLF (and some decoys) at every position around the block boundaries
+// of each vectorized implementation, and check that we always find the first
+// real CRLF, and never one that runs past the end of the data.
+TEST(HttpLineScannerTest, FindCrlfAtEveryPosition) {
+  for (size_t size = 0; size < 100; ++size) {
+    for (size_t pos = 0; pos <= size; ++pos) {
+      std::string text(size, 'x');
+      for (size_t i = 0; i < pos; i += 7) {
+        text[i] = (i % 2 == 0 ? '\r' : '\n');
+      }
+      if (pos + 1 < size) {
+        text[pos] = '\r';
+        text[pos + 1] = '\n';
+      } else if (pos < size) {
+        text[pos] = '\r';
+      }
+      const size_t expected = text.find("\r\n");
+      EXPECT_EQ(expected, mod_spdy::FindCrlf(text))
+          << "size=" << size << " pos=" << pos;
+      EXPECT_EQ(pos + 1 < size ? pos : base::StringPiece::npos, expected);
+    }
+  }
+}
+
+TEST(HttpLineScannerTest, FindByte) {
+  EXPECT_EQ(base::StringPiece::npos, mod_spdy::FindByte("", ':'));
+  EXPECT_EQ(base::StringPiece::npos, mod_spdy::FindByte("Foo", ':'));
+  EXPECT_EQ(3u, mod_spdy::FindByte("Foo: bar:baz", ':'));
+  EXPECT_EQ(0u, mod_spdy::FindByte(":status", ':'));
+}
+
+}  // namespace
@@ -20,6 +20,7 @@
 #include "base/strings/string_number_conversions.h"
 #include "base/strings/string_piece.h"
 #include "base/strings/string_util.h"
+#include "mod_spdy/common/http_line_scanner.h"
 #include "mod_spdy/common/http_response_visitor_interface.h"
 #include "mod_spdy/common/protocol_util.h"
 
@@ -31,6 +32,28 @@ size_t NposToEnd(const base::StringPiece& str, size_t pos) {
   return pos == base::StringPiece::npos ? str.size() : pos;
 }
 
+// Return true if the given Connection header value includes the "close"
+// token.  The value is a comma-separated list, e.g. "Upgrade, close".
+bool HasCloseToken(const base::StringPiece& value) {
+  size_t start = 0;
+  while (start < value.size()) {
+    const size_t end = NposToEnd(value, value.find(',', start));
+    base::StringPiece token = value.substr(start, end - start);
+    while (!token.empty() && (token[0] == ' ' || token[0] == '\t')) {
+      token.remove_prefix(1);
+    }
+    while (!token.empty() && (token[token.size() - 1] == ' ' ||
+                              token[token.size() - 1] == '\t')) {
+      token.remove_suffix(1);
+    }
+    if (LowerCaseEqualsASCII(token.begin(), token.end(), "close")) {
+      return true;
+    }
+    start = end + 1;
+  }
+  return false;
+}
+
 }  // namespace
 
 namespace mod_spdy {
@@ -39,6 +62,8 @@ HttpResponseParser::HttpResponseParser(HttpResponseVisitorInterface* visitor)
     : visitor_(visitor),
       state_(STATUS_LINE),
       body_type_(NO_BODY),
+      body_length_known_(false),
+      connection_close_(false),
       remaining_bytes_(0) {}
 
 HttpResponseParser::~HttpResponseParser() {}
@@ -104,28 +129,42 @@ bool HttpResponseParser::ProcessInput(const base::StringPiece& input_data) {
   return true;
 }
 
+bool HttpResponseParser::ProcessEndOfInput() {
+  if (state_ == BODY_DATA && body_type_ == CLOSE_DELIMITED_BODY) {
+    state_ = COMPLETE;
+    visitor_->OnData(base::StringPiece(), true);
+  }
+  return state_ == COMPLETE;
+}
+
 bool HttpResponseParser::ProcessStatusLine(base::StringPiece* data) {
   DCHECK(state_ == STATUS_LINE);
-  const size_t linebreak = data->find("\r\n");
+  size_t line_end, next_line;
 
   // If we haven't reached the end of the line yet, buffer the data and quit.
-  if (linebreak == base::StringPiece::npos) {
+  if (!FindLineBreak(*data, &line_end, &next_line)) {
     data->AppendToString(&buffer_);
     *data = base::StringPiece();
     return true;
   }
 
-  // Combine the data up to the linebreak with what we've buffered, and parse
-  // the status line out of it.
-  data->substr(0, linebreak).AppendToString(&buffer_);
-  if (!ParseStatusLine(buffer_)) {
-    return false;
+  // If the whole line is here, parse it in place; otherwise, combine the data
+  // up to the linebreak with what we've buffered, and parse that.
+  if (buffer_.empty()) {
+    if (!ParseStatusLine(data->substr(0, line_end))) {
+      return false;
+    }
+  } else {
+    data->substr(0, line_end).AppendToString(&buffer_);
+    if (!ParseStatusLine(buffer_)) {
+      return false;
+    }
+    buffer_.clear();
   }
-  buffer_.clear();
 
   // Chop off the linebreak and all data before it, and move on to parsing the
   // leading headers.
-  *data = data->substr(linebreak + 2);
+  *data = data->substr(next_line);
   state_ = LEADING_HEADERS;
   return true;
 }
@@ -156,10 +195,10 @@ bool HttpResponseParser::CheckStartOfHeaderLine(const base::StringPiece& data){
 
 bool HttpResponseParser::ProcessLeadingHeaders(base::StringPiece* data) {
   DCHECK(state_ == LEADING_HEADERS);
-  const size_t linebreak = data->find("\r\n");
+  size_t line_end, next_line;
 
   // If we haven't reached the end of the line yet, buffer the data and quit.
-  if (linebreak == base::StringPiece::npos) {
+  if (!FindLineBreak(*data, &line_end, &next_line)) {
     data->AppendToString(&buffer_);
     *data = base::StringPiece();
     return true;
@@ -170,12 +209,19 @@ bool HttpResponseParser::ProcessLeadingHeaders(base::StringPiece* data) {
   // signals the end of the leading headers.  Skip the linebreak, switch states
   // depending on what headers we saw (Is there body data?  Is it chunked?),
   // and return.
-  if (linebreak == 0 && buffer_.empty()) {
+  if (line_end == 0 && buffer_.empty()) {
+    // If nothing told us how long the body is, but the server is going to
+    // close the connection after this response, then the body runs until the
+    // end of the input (RFC 2616 section 4.4).
+    if (body_type_ == NO_BODY && !body_length_known_ && connection_close_) {
+      body_type_ = CLOSE_DELIMITED_BODY;
+    }
     switch (body_type_) {
       case CHUNKED_BODY:
         state_ = CHUNK_START;
         break;
       case UNCHUNKED_BODY:
+      case CLOSE_DELIMITED_BODY:
         state_ = BODY_DATA;
         break;
       case NO_BODY:
@@ -186,40 +232,60 @@ bool HttpResponseParser::ProcessLeadingHeaders(base::StringPiece* data) {
         return false;
     }
     visitor_->OnLeadingHeadersComplete(state_ == COMPLETE);
-    *data = data->substr(linebreak + 2);
+    *data = data->substr(next_line);
+    return true;
+  }
+
+  // In the common case, the whole header line is here, along with the start
+  // of the next line, which shows that the header doesn't continue onto it.
+  // Then we can parse the header in place, without copying it into the
+  // buffer, and stay in this state for the next line.
+  if (buffer_.empty() && next_line < data->size() &&
+      (*data)[next_line] != ' ' && (*data)[next_line] != '\t') {
+    if (!ParseLeadingHeader(data->substr(0, line_end))) {
+      return false;
+    }
+    *data = data->substr(next_line);
     return true;
   }
 
   // We've reached the end of the line, but we need to check the next line to
   // see if it's a continuation of this header.  Buffer up to the linebreak,
   // skip the linebreak itself, and set our state to check the next line.
-  data->substr(0, linebreak).AppendToString(&buffer_);
-  *data = data->substr(linebreak + 2);
+  data->substr(0, line_end).AppendToString(&buffer_);
+  *data = data->substr(next_line);
   state_ = LEADING_HEADERS_CHECK_NEXT_LINE;
   return true;
 }
 
 bool HttpResponseParser::ProcessChunkStart(base::StringPiece* data) {
   DCHECK(state_ == CHUNK_START);
-  const size_t linebreak = data->find("\r\n");
+  size_t line_end, next_line;
 
   // If we haven't reached the end of the line yet, buffer the data and quit.
-  if (linebreak == base::StringPiece::npos) {
+  if (!FindLineBreak(*data, &line_end, &next_line)) {
     data->AppendToString(&buffer_);
     *data = base::StringPiece();
     return true;
   }
 
-  // Combine the data up to the linebreak with what we've buffered, and parse
-  // the chunk length out of it.
-  data->substr(0, linebreak).AppendToString(&buffer_);
-  if (!ParseChunkStart(buffer_)) {
-    return false;
+  // If the whole line is here, parse it in place; otherwise, combine the data
+  // up to the linebreak with what we've buffered, and parse the chunk length
+  // out of that.
+  if (buffer_.empty()) {
+    if (!ParseChunkStart(data->substr(0, line_end))) {
+      return false;
+    }
+  } else {
+    data->substr(0, line_end).AppendToString(&buffer_);
+    if (!ParseChunkStart(buffer_)) {
+      return false;
+    }
+    buffer_.clear();
   }
-  buffer_.clear();
 
   // Skip the linebreak.
-  *data = data->substr(linebreak + 2);
+  *data = data->substr(next_line);
 
   // ParseChunkStart will put the size of the chunk into remaining_bytes_.  If
   // the chunk size is zero, that means we've reached the end of the body data.
@@ -240,6 +306,14 @@ bool HttpResponseParser::ProcessBodyData(base::StringPiece* data) {
   // much string copying we need to do for most responses.
   DCHECK(buffer_.empty());
 
+  // If the body is delimited by the end of the input, everything we get is
+  // body data; ProcessEndOfInput will finish the response.
+  if (body_type_ == CLOSE_DELIMITED_BODY) {
+    visitor_->OnData(*data, false);
+    *data = base::StringPiece();
+    return true;
+  }
+
   // If the available data is less that what remains of this chunk (if the data
   // is chunked) or of the whole body (if there was instead an explicit
   // content-length), then read in all the data we have and subtract from
@@ -270,16 +344,53 @@ bool HttpResponseParser::ProcessChunkEnding(base::StringPiece* data) {
   DCHECK(state_ == CHUNK_ENDING);
   // For whatever reason, HTTP requires each chunk to end with a CRLF.  So,
   // make sure it's there, and then skip it, before moving on to read the next
-  // chunk.
-  if (!data->starts_with("\r\n")) {
-    VLOG(1) << "Expected CRLF at end of chunk.";
-    return false;
+  // chunk.  The CR and LF may arrive in separate pieces of input, in which
+  // case we buffer the CR until the LF arrives.
+  if (!buffer_.empty()) {
+    DCHECK(buffer_ == "\r");
+    if ((*data)[0] != '\n') {
+      VLOG(1) << "Expected CRLF at end of chunk.";
+      return false;
+    }
+    buffer_.clear();
+    *data = data->substr(1);
+  } else if (*data == "\r") {
+    buffer_ = "\r";
+    *data = base::StringPiece();
+    return true;
+  } else {
+    if (!data->starts_with("\r\n")) {
+      VLOG(1) << "Expected CRLF at end of chunk.";
+      return false;
+    }
+    *data = data->substr(2);
   }
-  *data = data->substr(2);
   state_ = CHUNK_START;
   return true;
 }
 
+bool HttpResponseParser::FindLineBreak(const base::StringPiece& data,
+                                       size_t* line_end, size_t* next_line) {
+  DCHECK(!data.empty());
+  // If the last piece of input ended with a CR, and this one starts with an
+  // LF, then the line ended with the buffered data; drop the CR from the
+  // buffer, and report an empty remainder of the line.
+  if (!buffer_.empty() && buffer_[buffer_.size() - 1] == '\r' &&
+      data[0] == '\n') {
+    buffer_.resize(buffer_.size() - 1);
+    *line_end = 0;
+    *next_line = 1;
+    return true;
+  }
+  const size_t linebreak = FindCrlf(data);
+  if (linebreak == base::StringPiece::npos) {
+    return false;
+  }
+  *line_end = linebreak;
+  *next_line = linebreak + 2;
+  return true;
+}
+
 bool HttpResponseParser::ParseStatusLine(const base::StringPiece& text) {
   // An HTTP status line should look like:
   // <HTTP version> <single space> <status code> <single space> <status phrase>
@@ -300,9 +411,17 @@ bool HttpResponseParser::ParseStatusLine(const base::StringPiece& text) {
   const size_t start_of_phrase =
       NposToEnd(text, text.find_first_not_of(' ', second_space));
 
+  const base::StringPiece status_code =
+      text.substr(start_of_code, second_space - start_of_code);
+  // Informational (1xx), 204 (No Content), and 304 (Not Modified) responses
+  // never have a body (RFC 2616 section 4.4).
+  if (status_code.starts_with("1") || status_code == "204" ||
+      status_code == "304") {
+    body_length_known_ = true;
+  }
+
   visitor_->OnStatusLine(
-      text.substr(0, first_space),
-      text.substr(start_of_code, second_space - start_of_code),
+      text.substr(0, first_space), status_code,
       text.substr(start_of_phrase));
   return true;
 }
@@ -310,11 +429,11 @@ bool HttpResponseParser::ParseStatusLine(const base::StringPiece& text) {
 bool HttpResponseParser::ParseLeadingHeader(const base::StringPiece& text) {
   // Even for multiline headers, we strip out the CRLFs, so there shouldn't be
   // any left in the text that we're parsing.
-  DCHECK(text.find("\r\n") == base::StringPiece::npos);
+  DCHECK(FindCrlf(text) == base::StringPiece::npos);
 
   // Find the colon separating the key from the value, and skip any leading
   // whitespace between the colon and the value.
-  const size_t colon = text.find(':');
+  const size_t colon = FindByte(text, ':');
   if (colon == base::StringPiece::npos) {
     VLOG(1) << "Bad header line: " << text;
     return false;
@@ -330,6 +449,7 @@ bool HttpResponseParser::ParseLeadingHeader(const base::StringPiece& text) {
   if (LowerCaseEqualsASCII(key.begin(), key.end(), http::kTransferEncoding)) {
     if (value == http::kChunked) {
       body_type_ = CHUNKED_BODY;
+      body_length_known_ = true;
     }
   } else if (body_type_ != CHUNKED_BODY &&
              LowerCaseEqualsASCII(key.begin(), key.end(),
@@ -338,9 +458,16 @@ bool HttpResponseParser::ParseLeadingHeader(const base::StringPiece& text) {
     if (base::StringToUint64(value, &uint_value) && uint_value > 0u) {
       remaining_bytes_ = uint_value;
       body_type_ = UNCHUNKED_BODY;
+      body_length_known_ = true;
+    } else if (value == "0") {
+      body_length_known_ = true;
     } else {
       VLOG(1) << "Bad content-length: " << value;
     }
+  } else if (LowerCaseEqualsASCII(key.begin(), key.end(),
+                                  http::kConnection) &&
+             HasCloseToken(value)) {
+    connection_close_ = true;
   }
 
   visitor_->OnLeadingHeader(key, value);
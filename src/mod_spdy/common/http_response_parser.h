@@ -26,11 +26,13 @@ class HttpResponseVisitorInterface;
 
 // Parses incoming HTTP response data.  Data is fed in piece by piece with the
 // ProcessInput method, and appropriate methods are called on the visitor.
-// There is no need to indicate the end of the input, as this is inferred from
-// the Content-Length or Transfer-Encoding headers.  If the response uses
-// chunked encoding, the parser will de-chunk it.  Note that all data after the
-// end of the response body, including trailing headers, will be completely
-// ignored.
+// There is usually no need to indicate the end of the input, as this is
+// inferred from the Content-Length or Transfer-Encoding headers; the exception
+// is a response with "Connection: close" and neither of those headers, whose
+// body runs until the end of the input (see ProcessEndOfInput).  If the
+// response uses chunked encoding, the parser will de-chunk it.  Note that all
+// data after the end of the response body, including trailing headers, will be
+// completely ignored.
 class HttpResponseParser {
  public:
   explicit HttpResponseParser(HttpResponseVisitorInterface* visitor);
@@ -42,6 +44,11 @@ class HttpResponseParser {
     return ProcessInput(base::StringPiece(data, size));
   }
 
+  // Indicate that there is no more input.  If the response body was delimited
+  // by the end of the input, this completes the response.  Return true if the
+  // response is complete, false otherwise.
+  bool ProcessEndOfInput();
+
   // For unit testing only: Get the remaining number of bytes expected (in the
   // whole response, if we used Content-Length, or just in the current chunk,
   // if we used Transfer-Encoding: chunked).
@@ -61,7 +68,8 @@ class HttpResponseParser {
   enum BodyType {
     NO_BODY,
     UNCHUNKED_BODY,
-    CHUNKED_BODY
+    CHUNKED_BODY,
+    CLOSE_DELIMITED_BODY
   };
 
   bool ProcessStatusLine(base::StringPiece* data);
@@ -71,6 +79,14 @@ class HttpResponseParser {
   bool ProcessBodyData(base::StringPiece* data);
   bool ProcessChunkEnding(base::StringPiece* data);
 
+  // Find the end of the current line, allowing for a CR at the end of the
+  // buffered data and an LF at the start of this data.  Returns false if the
+  // line isn't complete yet.  Otherwise, sets *line_end to the position in
+  // data where the line ends, and *next_line to the position after the
+  // linebreak.
+  bool FindLineBreak(const base::StringPiece& data, size_t* line_end,
+                     size_t* next_line);
+
   bool ParseStatusLine(const base::StringPiece& text);
   bool ParseLeadingHeader(const base::StringPiece& text);
   bool ParseChunkStart(const base::StringPiece& text);
@@ -78,6 +94,8 @@ class HttpResponseParser {
   HttpResponseVisitorInterface* const visitor_;
   ParserState state_;
   BodyType body_type_;
+  bool body_length_known_;  // from the status, Content-Length, or chunking
+  bool connection_close_;  // we saw "Connection: close"
   uint64 remaining_bytes_;
   std::string buffer_;
 
@@ -0,0 +1,211 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/http_response_parser.h"
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+#include "base/strings/stringprintf.h"
+#include "mod_spdy/common/http_line_scanner.h"
+#include "mod_spdy/common/http_response_visitor_interface.h"
+#include "mod_spdy/common/testing/benchmark.h"
+
+namespace {
+
+// The size of the response body in each benchmark, and of each chunk in the
+// chunked-encoding benchmark (to match what mod_deflate typically emits).
+const size_t kBodySize = 16384;
+const size_t kChunkSize = 4096;
+
+class NullResponseVisitor : public mod_spdy::HttpResponseVisitorInterface {
+ public:
+  NullResponseVisitor() {}
+  virtual ~NullResponseVisitor() {}
+  virtual void OnStatusLine(const base::StringPiece& version,
+                            const base::StringPiece& status_code,
+                            const base::StringPiece& status_phrase) {}
+  virtual void OnLeadingHeader(const base::StringPiece& key,
+                               const base::StringPiece& value) {}
+  virtual void OnLeadingHeadersComplete(bool fin) {}
+  virtual void OnData(const base::StringPiece& data, bool fin) {}
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(NullResponseVisitor);
+};
+
+// A status line and headers like those of a typical Apache response.
+std::string LeadingHeaders() {
+  return "HTTP/1.1 200 OK\r\n"
+      "Date: Mon, 23 Jun 2014 17:26:41 GMT\r\n"
+      "Server: Apache/2.2.22 (Ubuntu)\r\n"
+      "Last-Modified: Fri, 20 Jun 2014 09:14:02 GMT\r\n"
+      "ETag: \"2a1c8e-4000-4fc3fd0b2e680\"\r\n"
+      "Accept-Ranges: bytes\r\n"
+      "Vary: Accept-Encoding\r\n"
+      "Cache-Control: max-age=3600, public\r\n"
+      "Keep-Alive: timeout=5, max=100\r\n"
+      "Connection: Keep-Alive\r\n"
+      "Content-Type: text/html; charset=UTF-8\r\n";
+}
+
+// The leading headers of a response from a busy application server behind a
+// CDN, with cookies, security policies, and tracing headers, as is now common
+// for dynamic pages.
+std::string HeaderHeavyResponse() {
+  return "HTTP/1.1 200 OK\r\n"
+      "Date: Mon, 23 Jun 2014 17:26:41 GMT\r\n"
+      "Server: Apache\r\n"
+      "Content-Type: text/html; charset=UTF-8\r\n"
+      "Cache-Control: private, no-cache, no-store, must-revalidate\r\n"
+      "Expires: Sat, 01 Jan 2000 00:00:00 GMT\r\n"
+      "Pragma: no-cache\r\n"
+      "Strict-Transport-Security: max-age=15552000; preload\r\n"
+      "Content-Security-Policy: default-src *; script-src https://*.example.com"
+      " https://*.examplecdn.net 'unsafe-inline' 'unsafe-eval'; style-src"
+      " https://*.examplecdn.net 'unsafe-inline'; connect-src https://*."
+      "example.com wss://*.example.com:*\r\n"
+      "X-Frame-Options: DENY\r\n"
+      "X-Content-Type-Options: nosniff\r\n"
+      "X-XSS-Protection: 0\r\n"
+      "Set-Cookie: sid=3a9f0c8e7b6d5a4f3e2d1c0b9a8f7e6d; expires=Tue, 23-Jun-2015"
+      " 17:26:41 GMT; path=/; domain=.example.com; secure; httponly\r\n"
+      "Set-Cookie: prefs=lang%3Den%26tz%3D-7%26theme%3Ddark%26layout%3Dwide;"
+      " expires=Tue, 23-Jun-2015 17:26:41 GMT; path=/; domain=.example.com\r\n"
+      "Set-Cookie: csrf=9d8c7b6a5f4e3d2c1b0a; path=/; secure\r\n"
+      "Vary: Accept-Encoding, Cookie\r\n"
+      "X-Request-Id: 4f3e2d1c-0b9a-8f7e-6d5c-4b3a2f1e0d9c\r\n"
+      "X-Backend: app-17.prod.example.com\r\n"
+      "X-Runtime: 0.041233\r\n"
+      "Via: 1.1 cache-sjc3126-SJC\r\n"
+      "X-Cache: MISS\r\n"
+      "Connection: Keep-Alive\r\n"
+      "Content-Length: 1234\r\n"
+      "\r\n" + std::string(1234, 'x');
+}
+
+// A revalidation response, which is all headers and no body.
+std::string NotModifiedResponse() {
+  return "HTTP/1.1 304 Not Modified\r\n"
+      "Date: Mon, 23 Jun 2014 17:26:41 GMT\r\n"
+      "Server: Apache/2.2.22 (Ubuntu)\r\n"
+      "Connection: Keep-Alive\r\n"
+      "Keep-Alive: timeout=5, max=100\r\n"
+      "ETag: \"2a1c8e-4000-4fc3fd0b2e680\"\r\n"
+      "Expires: Mon, 23 Jun 2014 18:26:41 GMT\r\n"
+      "Cache-Control: max-age=3600, public\r\n"
+      "Vary: Accept-Encoding\r\n"
+      "\r\n";
+}
+
+std::string ContentLengthResponse() {
+  return LeadingHeaders() +
+      base::StringPrintf("Content-Length: %d\r\n\r\n",
+                         static_cast<int>(kBodySize)) +
+      std::string(kBodySize, 'x');
+}
+
+std::string ChunkedResponse() {
+  std::string response = LeadingHeaders() +
+      "Transfer-Encoding: chunked\r\n\r\n";
+  for (size_t written = 0; written < kBodySize; written += kChunkSize) {
+    base::StringAppendF(&response, "%x\r\n", static_cast<int>(kChunkSize));
+    response.append(kChunkSize, 'x');
+    response.append("\r\n");
+  }
+  response.append("0\r\n\r\n");
+  return response;
+}
+
+// Parse the response once per iteration, feeding it to the parser in pieces
+// of (at most) the given size.
+void ParseResponse(mod_spdy::testing::BenchmarkState* state,
+                   const std::string& response, size_t piece_size) {
+  NullResponseVisitor visitor;
+  for (int64 i = 0; i < state->iterations(); ++i) {
+    mod_spdy::HttpResponseParser parser(&visitor);
+    for (size_t offset = 0; offset < response.size(); offset += piece_size) {
+      parser.ProcessInput(base::StringPiece(response).substr(offset,
+                                                             piece_size));
+    }
+  }
+  state->SetBytesProcessed(state->iterations() * response.size());
+  state->SetItemsProcessed(state->iterations());
+}
+
+MOD_SPDY_BENCHMARK(BM_HttpResponseParser_ContentLength) {
+  state->PauseTiming();
+  const std::string response = ContentLengthResponse();
+  state->ResumeTiming();
+  ParseResponse(state, response, response.size());
+}
+
+MOD_SPDY_BENCHMARK(BM_HttpResponseParser_Chunked) {
+  state->PauseTiming();
+  const std::string response = ChunkedResponse();
+  state->ResumeTiming();
+  ParseResponse(state, response, response.size());
+}
+
+MOD_SPDY_BENCHMARK(BM_HttpResponseParser_HeaderHeavy) {
+  state->PauseTiming();
+  const std::string response = HeaderHeavyResponse();
+  state->ResumeTiming();
+  ParseResponse(state, response, response.size());
+}
+
+MOD_SPDY_BENCHMARK(BM_HttpResponseParser_NotModified) {
+  state->PauseTiming();
+  const std::string response = NotModifiedResponse();
+  state->ResumeTiming();
+  ParseResponse(state, response, response.size());
+}
+
+// Apache hands us the response in whatever pieces its filters produce, so
+// also measure the cost of input split mid-line.
+MOD_SPDY_BENCHMARK(BM_HttpResponseParser_HeaderHeavySmallPieces) {
+  state->PauseTiming();
+  const std::string response = HeaderHeavyResponse();
+  state->ResumeTiming();
+  ParseResponse(state, response, 100);
+}
+
+MOD_SPDY_BENCHMARK(BM_HttpResponseParser_ChunkedSmallPieces) {
+  state->PauseTiming();
+  const std::string response = ChunkedResponse();
+  state->ResumeTiming();
+  ParseResponse(state, response, 100);
+}
+
+// Scan each line of a header block for its CRLF, as the parser does.
+MOD_SPDY_BENCHMARK(BM_FindCrlf) {
+  state->PauseTiming();
+  const std::string headers = HeaderHeavyResponse();
+  state->ResumeTiming();
+  int64 lines = 0;
+  for (int64 i = 0; i < state->iterations(); ++i) {
+    base::StringPiece data(headers);
+    size_t linebreak;
+    while ((linebreak = mod_spdy::FindCrlf(data)) !=
+           base::StringPiece::npos) {
+      ++lines;
+      data = data.substr(linebreak + 2);
+    }
+  }
+  state->SetBytesProcessed(state->iterations() * headers.size());
+  state->SetItemsProcessed(lines);
+}
+
+}  // namespace
@@ -14,6 +14,8 @@
 
 #include "mod_spdy/common/http_response_parser.h"
 
+#include <string>
+
 #include "base/strings/string_piece.h"
 #include "mod_spdy/common/http_response_visitor_interface.h"
 #include "testing/gmock/include/gmock/gmock.h"
@@ -155,6 +157,56 @@ TEST_F(HttpResponseParserTest, NoBodyData) {
       "\r\n"));
 }
 
+// Test that a response with "Connection: close" and neither a Content-Length
+// nor chunked encoding has a body that runs to the end of the input.
+TEST_F(HttpResponseParserTest, CloseDelimitedBody) {
+  InSequence seq;
+  EXPECT_CALL(visitor_, OnStatusLine(Eq("HTTP/1.1"), Eq("200"), Eq("OK")));
+  EXPECT_CALL(visitor_, OnLeadingHeader(Eq("Connection"),
+                                        Eq("Upgrade, Close")));
+  EXPECT_CALL(visitor_, OnLeadingHeadersComplete(Eq(false)));
+  EXPECT_CALL(visitor_, OnData(Eq("Hello,"), Eq(false)));
+  EXPECT_CALL(visitor_, OnData(Eq(" world!\n"), Eq(false)));
+  EXPECT_CALL(visitor_, OnData(Eq(""), Eq(true)));
+
+  ASSERT_TRUE(parser_.ProcessInput(
+      "HTTP/1.1 200 OK\r\n"
+      "Connection: Upgrade, Close\r\n"
+      "\r\n"
+      "Hello,"));
+  ASSERT_TRUE(parser_.ProcessInput(" world!\n"));
+  ASSERT_TRUE(parser_.ProcessEndOfInput());
+}
+
+// Test that "Connection: close" doesn't give a body to responses that can't
+// have one, or whose length we know.
+TEST_F(HttpResponseParserTest, ConnectionCloseWithoutBody) {
+  EXPECT_CALL(visitor_, OnStatusLine(Eq("HTTP/1.1"), Eq("304"),
+                                     Eq("Not Modified")));
+  EXPECT_CALL(visitor_, OnLeadingHeader(Eq("Connection"), Eq("close")));
+  EXPECT_CALL(visitor_, OnLeadingHeadersComplete(Eq(true)));
+
+  ASSERT_TRUE(parser_.ProcessInput(
+      "HTTP/1.1 304 Not Modified\r\n"
+      "Connection: close\r\n"
+      "\r\n"));
+  ASSERT_TRUE(parser_.ProcessEndOfInput());
+
+  MockHttpResponseVisitor visitor;
+  HttpResponseParser parser(&visitor);
+  EXPECT_CALL(visitor, OnStatusLine(Eq("HTTP/1.1"), Eq("200"), Eq("OK")));
+  EXPECT_CALL(visitor, OnLeadingHeader(Eq("Content-Length"), Eq("0")));
+  EXPECT_CALL(visitor, OnLeadingHeader(Eq("Connection"), Eq("close")));
+  EXPECT_CALL(visitor, OnLeadingHeadersComplete(Eq(true)));
+
+  ASSERT_TRUE(parser.ProcessInput(
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Length: 0\r\n"
+      "Connection: close\r\n"
+      "\r\n"));
+  ASSERT_TRUE(parser.ProcessEndOfInput());
+}
+
 TEST_F(HttpResponseParserTest, NoStatusPhrase) {
   InSequence seq;
   EXPECT_CALL(visitor_, OnStatusLine(Eq("HTTP/1.1"), Eq("123"), Eq("")));
@@ -220,6 +272,66 @@ TEST_F(HttpResponseParserTest, DividedUpIntoPieces) {
   ASSERT_TRUE(parser_.ProcessInput("0\r\n\r\n"));
 }
 
+// Test that we cope with each CRLF being split between two pieces of input.
+TEST_F(HttpResponseParserTest, LinebreaksDividedUpIntoPieces) {
+  InSequence seq;
+  EXPECT_CALL(visitor_, OnStatusLine(Eq("HTTP/1.1"), Eq("200"), Eq("OK")));
+  EXPECT_CALL(visitor_, OnLeadingHeader(
+      Eq("Transfer-Encoding"), Eq("chunked")));
+  EXPECT_CALL(visitor_, OnLeadingHeader(Eq("X-TwoLines"), Eq("foo bar")));
+  EXPECT_CALL(visitor_, OnLeadingHeadersComplete(Eq(false)));
+  EXPECT_CALL(visitor_, OnData(Eq("Hello"), Eq(false)));
+  EXPECT_CALL(visitor_, OnData(Eq(""), Eq(true)));
+
+  ASSERT_TRUE(parser_.ProcessInput("HTTP/1.1 200 OK\r"));
+  ASSERT_TRUE(parser_.ProcessInput("\nTransfer-Encoding: chunked\r"));
+  ASSERT_TRUE(parser_.ProcessInput("\nX-TwoLines: foo\r"));
+  ASSERT_TRUE(parser_.ProcessInput("\n bar\r"));
+  ASSERT_TRUE(parser_.ProcessInput("\n\r"));
+  ASSERT_TRUE(parser_.ProcessInput("\n5\r"));
+  ASSERT_TRUE(parser_.ProcessInput("\nHello\r"));
+  ASSERT_TRUE(parser_.ProcessInput("\n0\r"));
+  ASSERT_TRUE(parser_.ProcessInput("\n\r\n"));
+}
+
+// Test that we get the same results whether the response arrives all at once
+// (so that we parse lines in place) or a byte at a time (so that we buffer
+// every line).
+TEST_F(HttpResponseParserTest, OneByteAtATime) {
+  const std::string response =
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Type: text/plain\r\n"
+      "X-TwoLines: foo\r\n"
+      "\tbar\r\n"
+      "Content-Length: 5\r\n"
+      "\r\n"
+      "Hello";
+  for (int pass = 0; pass < 2; ++pass) {
+    MockHttpResponseVisitor visitor;
+    HttpResponseParser parser(&visitor);
+    InSequence seq;
+    EXPECT_CALL(visitor, OnStatusLine(Eq("HTTP/1.1"), Eq("200"), Eq("OK")));
+    EXPECT_CALL(visitor, OnLeadingHeader(Eq("Content-Type"),
+                                         Eq("text/plain")));
+    EXPECT_CALL(visitor, OnLeadingHeader(Eq("X-TwoLines"), Eq("foo\tbar")));
+    EXPECT_CALL(visitor, OnLeadingHeader(Eq("Content-Length"), Eq("5")));
+    EXPECT_CALL(visitor, OnLeadingHeadersComplete(Eq(false)));
+    if (pass == 0) {
+      EXPECT_CALL(visitor, OnData(Eq("Hello"), Eq(true)));
+      ASSERT_TRUE(parser.ProcessInput(response));
+    } else {
+      for (int i = 0; i < 4; ++i) {
+        EXPECT_CALL(visitor, OnData(Eq(response.substr(
+            response.size() - 5 + i, 1)), Eq(false)));
+      }
+      EXPECT_CALL(visitor, OnData(Eq("o"), Eq(true)));
+      for (size_t i = 0; i < response.size(); ++i) {
+        ASSERT_TRUE(parser.ProcessInput(response.data() + i, 1));
+      }
+    }
+  }
+}
+
 // Test that we gracefully handle bogus content-lengths.  We should effectively
 // ignore the header, assume that the response has no content, and ignore what
 // follows the headers.
@@ -70,7 +70,7 @@ void HttpStringBuilder::OnLeadingHeadersComplete() {
 void HttpStringBuilder::OnRawData(const base::StringPiece& data) {
   DCHECK(state_ == LEADING_HEADERS_COMPLETE || state_ == RAW_DATA);
   state_ = RAW_DATA;
-  data.AppendToString(string_);
+  AppendBodyData(data);
 }
 
 void HttpStringBuilder::OnDataChunk(const base::StringPiece& data) {
@@ -80,7 +80,7 @@ void HttpStringBuilder::OnDataChunk(const base::StringPiece& data) {
   // details.
   base::StringAppendF(string_, "%lX\r\n",
                       static_cast<unsigned long>(data.size()));
-  data.AppendToString(string_);
+  AppendBodyData(data);
   string_->append("\r\n");
 }
 
@@ -119,4 +119,8 @@ void HttpStringBuilder::OnComplete() {
   state_ = COMPLETE;
 }
 
+void HttpStringBuilder::AppendBodyData(const base::StringPiece& data) {
+  data.AppendToString(string_);
+}
+
 }  // namespace mod_spdy
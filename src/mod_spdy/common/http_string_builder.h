@@ -45,6 +45,13 @@ class HttpStringBuilder : public HttpRequestVisitorInterface {
   virtual void OnTrailingHeadersComplete();
   virtual void OnComplete();
 
+ protected:
+  // Append request body data (whether raw or chunked) to the output.  By
+  // default, this appends it to the string; subclasses may override this to
+  // put body data somewhere else, in which case they are responsible for
+  // keeping it in order with what has been appended to the string.
+  virtual void AppendBodyData(const base::StringPiece& data);
+
  private:
   enum State {
     REQUEST_LINE,
@@ -21,6 +21,7 @@
 #include "base/strings/string_piece.h"
 #include "mod_spdy/common/http_response_visitor_interface.h"
 #include "mod_spdy/common/protocol_util.h"
+#include "mod_spdy/common/spdy_version_traits.h"
 #include "net/spdy/spdy_protocol.h"
 
 namespace {
@@ -32,6 +33,20 @@ namespace {
 //      we should experiment later on to see what value here performs the best.
 const size_t kTargetDataFrameBytes = 4096;
 
+// Add the SPDY headers that carry the status line of a response.  The
+// converter picks the instantiation for its SPDY version when it is created.
+typedef void (*AddStatusHeadersFunc)(const base::StringPiece& version,
+                                     const base::StringPiece& status_code,
+                                     net::SpdyHeaderBlock* headers);
+
+template <class Traits>
+void AddStatusHeaders(const base::StringPiece& version,
+                      const base::StringPiece& status_code,
+                      net::SpdyHeaderBlock* headers) {
+  version.CopyToString(&(*headers)[Traits::VersionHeader()]);
+  status_code.CopyToString(&(*headers)[Traits::StatusHeader()]);
+}
+
 }  // namespace
 
 namespace mod_spdy {
@@ -56,7 +71,7 @@ class HttpToSpdyConverter::ConverterImpl : public HttpResponseVisitorInterface{
   void SendDataIfNecessary(bool flush, bool fin);
   void SendDataFrame(const char* data, size_t size, bool flag_fin);
 
-  const spdy::SpdyVersion spdy_version_;
+  const AddStatusHeadersFunc add_status_headers_;
   SpdyReceiver* const receiver_;
   net::SpdyHeaderBlock headers_;
   std::string data_buffer_;
@@ -80,13 +95,19 @@ bool HttpToSpdyConverter::ProcessInput(base::StringPiece input_data) {
   return parser_.ProcessInput(input_data);
 }
 
+bool HttpToSpdyConverter::ProcessEndOfInput() {
+  return parser_.ProcessEndOfInput();
+}
+
 void HttpToSpdyConverter::Flush() {
   impl_->Flush();
 }
 
 HttpToSpdyConverter::ConverterImpl::ConverterImpl(
     spdy::SpdyVersion spdy_version, SpdyReceiver* receiver)
-    : spdy_version_(spdy_version),
+    : add_status_headers_(spdy_version < spdy::SPDY_VERSION_3 ?
+                          &AddStatusHeaders<Spdy2Traits> :
+                          &AddStatusHeaders<Spdy3Traits>),
       receiver_(receiver),
       sent_flag_fin_(false) {
   DCHECK_NE(spdy::SPDY_VERSION_NONE, spdy_version);
@@ -105,21 +126,14 @@ void HttpToSpdyConverter::ConverterImpl::OnStatusLine(
     const base::StringPiece& status_code,
     const base::StringPiece& status_phrase) {
   DCHECK(headers_.empty());
-  const bool spdy2 = spdy_version_ < spdy::SPDY_VERSION_3;
-  headers_[spdy2 ? spdy::kSpdy2Version : spdy::kSpdy3Version] =
-      version.as_string();
-  headers_[spdy2 ? spdy::kSpdy2Status : spdy::kSpdy3Status] =
-      status_code.as_string();
+  add_status_headers_(version, status_code, &headers_);
 }
 
 void HttpToSpdyConverter::ConverterImpl::OnLeadingHeader(
     const base::StringPiece& key,
     const base::StringPiece& value) {
   // Filter out headers that are invalid in SPDY.
-  if (IsInvalidSpdyResponseHeader(key)) {
-    return;
-  }
-  MergeInHeader(key, value, &headers_);
+  MergeInResponseHeader(key, value, &headers_);
 }
 
 void HttpToSpdyConverter::ConverterImpl::OnLeadingHeadersComplete(bool fin) {
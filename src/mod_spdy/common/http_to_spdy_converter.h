@@ -62,6 +62,11 @@ class HttpToSpdyConverter {
     return ProcessInput(base::StringPiece(data, size));
   }
 
+  // Indicate that there is no more input, which completes the response if its
+  // body runs until the end of the input; return true if the response is
+  // complete, false otherwise.
+  bool ProcessEndOfInput();
+
   // Flush out any buffered data.
   void Flush();
 
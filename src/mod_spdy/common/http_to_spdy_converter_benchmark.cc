@@ -0,0 +1,111 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/http_to_spdy_converter.h"
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+#include "base/strings/stringprintf.h"
+#include "mod_spdy/common/protocol_util.h"
+#include "mod_spdy/common/testing/benchmark.h"
+#include "net/spdy/spdy_framer.h"
+
+namespace {
+
+const size_t kBodySize = 65536;
+const size_t kChunkSize = 4096;
+
+class CountingReceiver : public mod_spdy::HttpToSpdyConverter::SpdyReceiver {
+ public:
+  CountingReceiver() : num_frames_(0) {}
+  virtual ~CountingReceiver() {}
+
+  int64 num_frames() const { return num_frames_; }
+
+  virtual void ReceiveSynReply(net::SpdyHeaderBlock* headers,
+                               bool flag_fin) {
+    ++num_frames_;
+  }
+  virtual void ReceiveData(base::StringPiece data, bool flag_fin) {
+    ++num_frames_;
+  }
+
+ private:
+  int64 num_frames_;
+
+  DISALLOW_COPY_AND_ASSIGN(CountingReceiver);
+};
+
+std::string Response(bool chunked) {
+  std::string response =
+      "HTTP/1.1 200 OK\r\n"
+      "Date: Mon, 23 Jun 2014 17:26:41 GMT\r\n"
+      "Server: Apache/2.2.22 (Ubuntu)\r\n"
+      "Last-Modified: Fri, 20 Jun 2014 09:14:02 GMT\r\n"
+      "ETag: \"2a1c8e-10000-4fc3fd0b2e680\"\r\n"
+      "Accept-Ranges: bytes\r\n"
+      "Vary: Accept-Encoding\r\n"
+      "Cache-Control: max-age=3600, public\r\n"
+      "Set-Cookie: session=8f14e45fceea167a5a36dedd4bea2543; path=/\r\n"
+      "Set-Cookie: prefs=compact; path=/\r\n"
+      "Content-Type: image/png\r\n";
+  if (!chunked) {
+    base::StringAppendF(&response, "Content-Length: %d\r\n\r\n",
+                        static_cast<int>(kBodySize));
+    response.append(kBodySize, 'x');
+    return response;
+  }
+  response.append("Transfer-Encoding: chunked\r\n\r\n");
+  for (size_t written = 0; written < kBodySize; written += kChunkSize) {
+    base::StringAppendF(&response, "%x\r\n", static_cast<int>(kChunkSize));
+    response.append(kChunkSize, 'x');
+    response.append("\r\n");
+  }
+  response.append("0\r\n\r\n");
+  return response;
+}
+
+// Convert the response once per iteration, feeding it to the converter in
+// pieces of (at most) 8kB, as Apache's core output filter would.
+void ConvertResponse(mod_spdy::testing::BenchmarkState* state, bool chunked) {
+  state->PauseTiming();
+  const std::string response = Response(chunked);
+  const size_t kPieceSize = 8192;
+  CountingReceiver receiver;
+  state->ResumeTiming();
+  for (int64 i = 0; i < state->iterations(); ++i) {
+    mod_spdy::HttpToSpdyConverter converter(
+        mod_spdy::spdy::SPDY_VERSION_3_1, &receiver);
+    for (size_t offset = 0; offset < response.size(); offset += kPieceSize) {
+      converter.ProcessInput(base::StringPiece(response).substr(offset,
+                                                                kPieceSize));
+    }
+    converter.Flush();
+  }
+  state->SetBytesProcessed(state->iterations() * response.size());
+  state->SetItemsProcessed(receiver.num_frames());
+}
+
+// Items are SPDY frames produced.
+MOD_SPDY_BENCHMARK(BM_HttpToSpdyConverter_ContentLength) {
+  ConvertResponse(state, false);
+}
+
+MOD_SPDY_BENCHMARK(BM_HttpToSpdyConverter_Chunked) {
+  ConvertResponse(state, true);
+}
+
+}  // namespace
@@ -0,0 +1,171 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "base/logging.h"
+#include "base/strings/stringprintf.h"
+
+namespace {
+
+// Durations below this many microseconds each get a bucket of their own.
+const int64 kLinearLimit = 32;
+// Above that, each power of two is divided into this many buckets.
+const int kSubBucketBits = 4;
+const int kSubBuckets = 1 << kSubBucketBits;
+// The power of two of kLinearLimit.
+const int kFirstExponent = 5;
+// Durations of 2^kLastExponent microseconds (about 25 days) or more all share
+// the last bucket.
+const int kLastExponent = 41;
+const size_t kNumBuckets =
+    kLinearLimit + (kLastExponent - kFirstExponent) * kSubBuckets;
+
+// Return the position of the highest set bit of a positive number.
+int HighestBit(int64 value) {
+  DCHECK_GT(value, 0);
+  int bit = 0;
+  while (value >>= 1) {
+    ++bit;
+  }
+  return bit;
+}
+
+}  // namespace
+
+namespace mod_spdy {
+
+LatencyHistogram::LatencyHistogram()
+    : buckets_(kNumBuckets, 0),
+      count_(0),
+      sum_us_(0),
+      min_us_(0),
+      max_us_(0) {}
+
+LatencyHistogram::~LatencyHistogram() {}
+
+void LatencyHistogram::Add(base::TimeDelta duration) {
+  const int64 us = std::max<int64>(0, duration.InMicroseconds());
+  ++buckets_[BucketForMicroseconds(us)];
+  min_us_ = (count_ == 0 ? us : std::min(min_us_, us));
+  max_us_ = (count_ == 0 ? us : std::max(max_us_, us));
+  ++count_;
+  sum_us_ += us;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  if (other.count_ == 0) {
+    return;
+  }
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    buckets_[i] += other.buckets_[i];
+  }
+  min_us_ = (count_ == 0 ? other.min_us_ : std::min(min_us_, other.min_us_));
+  max_us_ = (count_ == 0 ? other.max_us_ : std::max(max_us_, other.max_us_));
+  count_ += other.count_;
+  sum_us_ += other.sum_us_;
+}
+
+base::TimeDelta LatencyHistogram::min() const {
+  return base::TimeDelta::FromMicroseconds(min_us_);
+}
+
+base::TimeDelta LatencyHistogram::max() const {
+  return base::TimeDelta::FromMicroseconds(max_us_);
+}
+
+base::TimeDelta LatencyHistogram::mean() const {
+  return base::TimeDelta::FromMicroseconds(
+      count_ == 0 ? 0 : sum_us_ / count_);
+}
+
+base::TimeDelta LatencyHistogram::Percentile(double percentile) const {
+  if (count_ == 0) {
+    return base::TimeDelta();
+  }
+  percentile = std::max(0.0, std::min(100.0, percentile));
+  const int64 rank = std::max<int64>(
+      1, static_cast<int64>(std::ceil(percentile / 100.0 * count_)));
+  int64 seen = 0;
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    seen += buckets_[i];
+    if (seen >= rank) {
+      // The last bucket has no real upper bound.
+      const int64 upper =
+          (i + 1 < kNumBuckets ? BucketUpperBound(i) - 1 : max_us_);
+      return base::TimeDelta::FromMicroseconds(
+          std::max(min_us_, std::min(max_us_, upper)));
+    }
+  }
+  NOTREACHED();
+  return max();
+}
+
+void LatencyHistogram::AppendJsonBuckets(std::string* out) const {
+  out->push_back('[');
+  bool first = true;
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    if (buckets_[i] == 0) {
+      continue;
+    }
+    base::StringAppendF(out, "%s[%lld, %lld, %lld]", (first ? "" : ", "),
+                        static_cast<long long>(BucketLowerBound(i)),
+                        static_cast<long long>(BucketUpperBound(i)),
+                        static_cast<long long>(buckets_[i]));
+    first = false;
+  }
+  out->push_back(']');
+}
+
+// static
+size_t LatencyHistogram::BucketForMicroseconds(int64 us) {
+  DCHECK_GE(us, 0);
+  if (us < kLinearLimit) {
+    return static_cast<size_t>(us);
+  }
+  const int exponent = HighestBit(us);
+  if (exponent >= kLastExponent) {
+    return kNumBuckets - 1;
+  }
+  const int64 sub_bucket =
+      (us >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+  return static_cast<size_t>(kLinearLimit +
+                             (exponent - kFirstExponent) * kSubBuckets +
+                             sub_bucket);
+}
+
+// static
+int64 LatencyHistogram::BucketLowerBound(size_t bucket) {
+  DCHECK_LT(bucket, kNumBuckets);
+  if (bucket < static_cast<size_t>(kLinearLimit)) {
+    return static_cast<int64>(bucket);
+  }
+  const size_t offset = bucket - kLinearLimit;
+  const int exponent = kFirstExponent + static_cast<int>(offset / kSubBuckets);
+  const int64 sub_bucket = static_cast<int64>(offset % kSubBuckets);
+  return (kSubBuckets + sub_bucket) << (exponent - kSubBucketBits);
+}
+
+// static
+int64 LatencyHistogram::BucketUpperBound(size_t bucket) {
+  // The last bucket is really unbounded, but this is only used for reporting.
+  return (bucket + 1 < kNumBuckets ? BucketLowerBound(bucket + 1) :
+          static_cast<int64>(1) << kLastExponent);
+}
+
+}  // namespace mod_spdy
@@ -0,0 +1,72 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MOD_SPDY_COMMON_LATENCY_HISTOGRAM_H_
+#define MOD_SPDY_COMMON_LATENCY_HISTOGRAM_H_
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/time/time.h"
+
+namespace mod_spdy {
+
+// Records a distribution of durations in logarithmically-sized buckets (16
+// per power of two), so that percentiles can be estimated to within about
+// 6% in constant space, no matter how many samples are recorded.  Durations
+// are kept at microsecond resolution.  This class is not thread-safe, but
+// histograms recorded on different threads can be combined with Merge().
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+  ~LatencyHistogram();
+
+  void Add(base::TimeDelta duration);
+  void Merge(const LatencyHistogram& other);
+
+  int64 count() const { return count_; }
+  // These return zero if the histogram is empty.
+  base::TimeDelta min() const;
+  base::TimeDelta max() const;
+  base::TimeDelta mean() const;
+
+  // Estimate the given percentile (from 0 to 100) of the recorded durations.
+  // The estimate is the upper bound of the bucket holding that rank, clamped
+  // to the smallest and largest durations actually recorded.  Returns zero if
+  // the histogram is empty.
+  base::TimeDelta Percentile(double percentile) const;
+
+  // Append the non-empty buckets to the string as a JSON array of
+  // [lower_bound_us, upper_bound_us, count] triples, in ascending order.
+  void AppendJsonBuckets(std::string* out) const;
+
+ private:
+  static size_t BucketForMicroseconds(int64 us);
+  static int64 BucketLowerBound(size_t bucket);
+  static int64 BucketUpperBound(size_t bucket);
+
+  std::vector<int64> buckets_;
+  int64 count_;
+  int64 sum_us_;
+  int64 min_us_;
+  int64 max_us_;
+
+  // Copy and assign are allowed, so that histograms can be kept in
+  // containers (e.g. one per priority).
+};
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_LATENCY_HISTOGRAM_H_
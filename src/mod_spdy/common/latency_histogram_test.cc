@@ -0,0 +1,123 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/latency_histogram.h"
+
+#include <string>
+
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+base::TimeDelta Micros(int64 us) {
+  return base::TimeDelta::FromMicroseconds(us);
+}
+
+TEST(LatencyHistogramTest, Empty) {
+  mod_spdy::LatencyHistogram histogram;
+  EXPECT_EQ(0, histogram.count());
+  EXPECT_EQ(0, histogram.min().InMicroseconds());
+  EXPECT_EQ(0, histogram.max().InMicroseconds());
+  EXPECT_EQ(0, histogram.mean().InMicroseconds());
+  EXPECT_EQ(0, histogram.Percentile(50).InMicroseconds());
+  std::string json;
+  histogram.AppendJsonBuckets(&json);
+  EXPECT_EQ("[]", json);
+}
+
+// Small durations each get a bucket of their own, so their percentiles are
+// exact.
+TEST(LatencyHistogramTest, SmallDurationsAreExact) {
+  mod_spdy::LatencyHistogram histogram;
+  for (int64 us = 1; us <= 20; ++us) {
+    histogram.Add(Micros(us));
+  }
+  EXPECT_EQ(20, histogram.count());
+  EXPECT_EQ(1, histogram.min().InMicroseconds());
+  EXPECT_EQ(20, histogram.max().InMicroseconds());
+  EXPECT_EQ(10, histogram.mean().InMicroseconds());
+  EXPECT_EQ(1, histogram.Percentile(0).InMicroseconds());
+  EXPECT_EQ(10, histogram.Percentile(50).InMicroseconds());
+  EXPECT_EQ(18, histogram.Percentile(90).InMicroseconds());
+  EXPECT_EQ(20, histogram.Percentile(100).InMicroseconds());
+}
+
+// Larger durations are estimated to within the width of their bucket, and
+// percentiles never go outside the range actually recorded.
+TEST(LatencyHistogramTest, LargeDurationsAreApproximate) {
+  mod_spdy::LatencyHistogram histogram;
+  for (int i = 0; i < 99; ++i) {
+    histogram.Add(Micros(1000));
+  }
+  histogram.Add(Micros(1000000));
+  const int64 p50 = histogram.Percentile(50).InMicroseconds();
+  EXPECT_LE(1000, p50);
+  EXPECT_GE(1000 * 1.0625, p50);
+  EXPECT_EQ(p50, histogram.Percentile(99).InMicroseconds());
+  EXPECT_EQ(1000000, histogram.Percentile(99.9).InMicroseconds());
+  EXPECT_EQ(1000000, histogram.max().InMicroseconds());
+
+  mod_spdy::LatencyHistogram single;
+  single.Add(Micros(123456));
+  EXPECT_EQ(123456, single.Percentile(50).InMicroseconds());
+}
+
+// Negative and enormous durations are clamped into the first and last
+// buckets, rather than being dropped.
+TEST(LatencyHistogramTest, OutOfRange) {
+  const int64 kHuge = static_cast<int64>(1) << 50;
+  mod_spdy::LatencyHistogram histogram;
+  histogram.Add(Micros(-5));
+  histogram.Add(Micros(kHuge));
+  EXPECT_EQ(2, histogram.count());
+  EXPECT_EQ(0, histogram.min().InMicroseconds());
+  EXPECT_EQ(0, histogram.Percentile(50).InMicroseconds());
+  EXPECT_EQ(kHuge, histogram.Percentile(100).InMicroseconds());
+}
+
+TEST(LatencyHistogramTest, Merge) {
+  mod_spdy::LatencyHistogram first;
+  first.Add(Micros(3));
+  first.Add(Micros(5));
+  mod_spdy::LatencyHistogram second;
+  second.Add(Micros(1));
+  second.Add(Micros(7));
+  mod_spdy::LatencyHistogram empty;
+
+  first.Merge(empty);
+  EXPECT_EQ(2, first.count());
+  empty.Merge(second);
+  EXPECT_EQ(1, empty.min().InMicroseconds());
+  first.Merge(second);
+  EXPECT_EQ(4, first.count());
+  EXPECT_EQ(1, first.min().InMicroseconds());
+  EXPECT_EQ(7, first.max().InMicroseconds());
+  EXPECT_EQ(4, first.mean().InMicroseconds());
+  EXPECT_EQ(3, first.Percentile(50).InMicroseconds());
+}
+
+TEST(LatencyHistogramTest, JsonBuckets) {
+  mod_spdy::LatencyHistogram histogram;
+  histogram.Add(Micros(3));
+  histogram.Add(Micros(3));
+  histogram.Add(Micros(32));
+  histogram.Add(Micros(33));
+  histogram.Add(Micros(100));
+  std::string json;
+  histogram.AppendJsonBuckets(&json);
+  EXPECT_EQ("[[3, 4, 2], [32, 34, 2], [100, 104, 1]]", json);
+}
+
+}  // namespace
@@ -0,0 +1,187 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/profiled_lock.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/logging.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+
+namespace {
+
+// How many acquisitions a ProfiledLock counts before reporting to the
+// LockProfiler, so that busy locks don't all contend on the profiler's lock.
+const int64 kFlushInterval = 64;
+
+typedef std::pair<std::string, mod_spdy::LockStats> Site;
+
+bool CompareSitesByWait(const Site& a, const Site& b) {
+  return a.second.total_wait > b.second.total_wait;
+}
+
+double Millis(base::TimeDelta delta) {
+  return delta.InMicroseconds() / 1000.0;
+}
+
+}  // namespace
+
+namespace mod_spdy {
+
+LockStats::LockStats() : acquisitions(0), contended(0) {}
+
+void LockStats::Merge(const LockStats& other) {
+  acquisitions += other.acquisitions;
+  contended += other.contended;
+  total_wait += other.total_wait;
+  max_wait = std::max(max_wait, other.max_wait);
+  total_hold += other.total_hold;
+  max_hold = std::max(max_hold, other.max_hold);
+}
+
+LockProfiler* LockProfiler::g_instance = NULL;
+
+void LockProfiler::CreateInstance() {
+  DCHECK(g_instance == NULL);
+  g_instance = new LockProfiler();
+}
+
+void LockProfiler::DestroyInstance() {
+  DCHECK(g_instance != NULL);
+  delete g_instance;
+  g_instance = NULL;
+}
+
+LockProfiler::LockProfiler() {}
+
+LockProfiler::~LockProfiler() {}
+
+void LockProfiler::Record(const char* name, const LockStats& stats) {
+  base::AutoLock autolock(lock_);
+  sites_[name].Merge(stats);
+}
+
+LockStats LockProfiler::GetStats(const std::string& name) {
+  base::AutoLock autolock(lock_);
+  std::map<std::string, LockStats>::const_iterator iter = sites_.find(name);
+  return iter == sites_.end() ? LockStats() : iter->second;
+}
+
+std::string LockProfiler::GetReport() {
+  std::vector<Site> sites;
+  {
+    base::AutoLock autolock(lock_);
+    sites.assign(sites_.begin(), sites_.end());
+  }
+  std::stable_sort(sites.begin(), sites.end(), CompareSitesByWait);
+
+  std::string out;
+  base::StringAppendF(&out, "%-40s %12s %12s %7s %10s %10s %10s %10s %9s\n",
+                      "Lock", "Acquired", "Contended", "Cont.%", "Wait ms",
+                      "Max wait", "Hold ms", "Max hold", "Mean hold");
+  for (size_t i = 0; i < sites.size(); ++i) {
+    const LockStats& stats = sites[i].second;
+    const double acquisitions = std::max<int64>(1, stats.acquisitions);
+    base::StringAppendF(
+        &out, "%-40s %12lld %12lld %6.2f%% %10.1f %8.1fms %10.1f %8.1fms "
+        "%7.2fus\n", sites[i].first.c_str(),
+        static_cast<long long>(stats.acquisitions),
+        static_cast<long long>(stats.contended),
+        100.0 * stats.contended / acquisitions, Millis(stats.total_wait),
+        Millis(stats.max_wait), Millis(stats.total_hold),
+        Millis(stats.max_hold),
+        stats.total_hold.InMicroseconds() / acquisitions);
+  }
+  return out;
+}
+
+void LockProfiler::Clear() {
+  base::AutoLock autolock(lock_);
+  sites_.clear();
+}
+
+ProfiledLock::ProfiledLock(const char* name)
+    : name_(name), profiling_(false) {}
+
+ProfiledLock::~ProfiledLock() {
+  if (pending_.acquisitions > 0) {
+    Flush();
+  }
+}
+
+void ProfiledLock::Acquire() {
+  if (LockProfiler::Instance() == NULL) {
+    lock_.Acquire();
+    return;
+  }
+  if (lock_.Try()) {
+    OnAcquired(false, base::TimeDelta());
+    return;
+  }
+  const base::TimeTicks start = base::TimeTicks::Now();
+  lock_.Acquire();
+  OnAcquired(true, base::TimeTicks::Now() - start);
+}
+
+void ProfiledLock::Release() {
+  OnReleasing();
+  lock_.Release();
+}
+
+void ProfiledLock::OnAcquired(bool contended, base::TimeDelta wait) {
+  profiling_ = true;
+  acquired_at_ = base::TimeTicks::Now();
+  ++pending_.acquisitions;
+  if (contended) {
+    ++pending_.contended;
+    pending_.total_wait += wait;
+    pending_.max_wait = std::max(pending_.max_wait, wait);
+  }
+}
+
+void ProfiledLock::OnReacquired() {
+  if (LockProfiler::Instance() != NULL) {
+    profiling_ = true;
+    acquired_at_ = base::TimeTicks::Now();
+  }
+}
+
+void ProfiledLock::OnReleasing() {
+  if (!profiling_) {
+    return;
+  }
+  profiling_ = false;
+  const base::TimeDelta hold = base::TimeTicks::Now() - acquired_at_;
+  pending_.total_hold += hold;
+  pending_.max_hold = std::max(pending_.max_hold, hold);
+  if (pending_.acquisitions >= kFlushInterval) {
+    Flush();
+  }
+}
+
+void ProfiledLock::Flush() {
+  LockProfiler* profiler = LockProfiler::Instance();
+  if (profiler != NULL) {
+    profiler->Record(name_, pending_);
+  }
+  pending_ = LockStats();
+}
+
+}  // namespace mod_spdy
@@ -0,0 +1,187 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MOD_SPDY_COMMON_PROFILED_LOCK_H_
+#define MOD_SPDY_COMMON_PROFILED_LOCK_H_
+
+#include <map>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+
+namespace mod_spdy {
+
+// Counts for a lock site: all the ProfiledLocks created with a given name.
+struct LockStats {
+  LockStats();
+
+  void Merge(const LockStats& other);
+
+  int64 acquisitions;
+  // Acquisitions that had to wait for another thread to release the lock.
+  int64 contended;
+  base::TimeDelta total_wait;
+  base::TimeDelta max_wait;
+  // Time spent holding the lock, not counting time spent waiting on a
+  // ProfiledConditionVariable (during which the lock is released).
+  base::TimeDelta total_hold;
+  base::TimeDelta max_hold;
+};
+
+// Collects the LockStats of all ProfiledLocks in the process.  Lock
+// profiling is off unless CreateInstance() has been called.  This class is
+// thread-safe.
+class LockProfiler {
+ public:
+  // Returns the one and only instance of the LockProfiler, or NULL if lock
+  // profiling is disabled.
+  static LockProfiler* Instance() { return g_instance; }
+
+  // Call this before threading starts to enable lock profiling.
+  static void CreateInstance();
+
+  // Disable lock profiling and delete the profiler.  This must not be called
+  // while any ProfiledLock exists; it's mainly for tests.
+  static void DestroyInstance();
+
+  // Add to the counts for the given lock site.
+  void Record(const char* name, const LockStats& stats);
+
+  // Get the counts for the given lock site.
+  LockStats GetStats(const std::string& name);
+
+  // Return a table of the counts for each lock site, most time spent
+  // waiting first.  ProfiledLocks report their counts in batches, so each
+  // existing lock may have up to a batch of acquisitions not yet included.
+  std::string GetReport();
+
+  // Discard all counts.
+  void Clear();
+
+ private:
+  LockProfiler();
+  ~LockProfiler();
+
+  static LockProfiler* g_instance;
+
+  base::Lock lock_;
+  std::map<std::string, LockStats> sites_;
+
+  DISALLOW_COPY_AND_ASSIGN(LockProfiler);
+};
+
+// A drop-in replacement for base::Lock that, when lock profiling is enabled,
+// records how often it is acquired, how often and for how long threads wait
+// to acquire it, and how long it is held, under the given site name (which
+// must be a string literal).  When profiling is disabled, the only overhead
+// is a check of a global pointer per acquisition.
+//
+// Use ProfiledAutoLock and ProfiledAutoUnlock in place of base::AutoLock and
+// base::AutoUnlock, and ProfiledConditionVariable in place of
+// base::ConditionVariable.
+class ProfiledLock {
+ public:
+  explicit ProfiledLock(const char* name);
+  ~ProfiledLock();
+
+  void Acquire();
+  void Release();
+  void AssertAcquired() const { lock_.AssertAcquired(); }
+
+ private:
+  friend class ProfiledConditionVariable;
+
+  // Accounting, called while holding lock_.  A ProfiledConditionVariable
+  // wait releases and reacquires the lock without counting an acquisition.
+  void OnAcquired(bool contended, base::TimeDelta wait);
+  void OnReacquired();
+  void OnReleasing();
+  void Flush();
+
+  base::Lock lock_;
+  const char* const name_;
+  // The below fields are protected by lock_.
+  bool profiling_;  // true if the current holder's acquisition is timed
+  base::TimeTicks acquired_at_;
+  LockStats pending_;  // counts not yet reported to the LockProfiler
+
+  DISALLOW_COPY_AND_ASSIGN(ProfiledLock);
+};
+
+class ProfiledAutoLock {
+ public:
+  explicit ProfiledAutoLock(ProfiledLock& lock) : lock_(lock) {
+    lock_.Acquire();
+  }
+  ~ProfiledAutoLock() {
+    lock_.AssertAcquired();
+    lock_.Release();
+  }
+
+ private:
+  ProfiledLock& lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProfiledAutoLock);
+};
+
+class ProfiledAutoUnlock {
+ public:
+  explicit ProfiledAutoUnlock(ProfiledLock& lock) : lock_(lock) {
+    lock_.AssertAcquired();
+    lock_.Release();
+  }
+  ~ProfiledAutoUnlock() {
+    lock_.Acquire();
+  }
+
+ private:
+  ProfiledLock& lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProfiledAutoUnlock);
+};
+
+// A base::ConditionVariable for use with a ProfiledLock, which doesn't count
+// time spent waiting as time spent holding the lock.
+class ProfiledConditionVariable {
+ public:
+  explicit ProfiledConditionVariable(ProfiledLock* lock)
+      : lock_(lock), condvar_(&lock->lock_) {}
+  ~ProfiledConditionVariable() {}
+
+  void Wait() {
+    lock_->OnReleasing();
+    condvar_.Wait();
+    lock_->OnReacquired();
+  }
+  void TimedWait(const base::TimeDelta& max_time) {
+    lock_->OnReleasing();
+    condvar_.TimedWait(max_time);
+    lock_->OnReacquired();
+  }
+  void Broadcast() { condvar_.Broadcast(); }
+  void Signal() { condvar_.Signal(); }
+
+ private:
+  ProfiledLock* const lock_;
+  base::ConditionVariable condvar_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProfiledConditionVariable);
+};
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_PROFILED_LOCK_H_
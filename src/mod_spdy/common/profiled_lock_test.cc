@@ -0,0 +1,139 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/profiled_lock.h"
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// Holds a lock for a while on another thread.
+class LockHolder : public base::PlatformThread::Delegate {
+ public:
+  LockHolder(mod_spdy::ProfiledLock* lock, base::TimeDelta hold_time)
+      : lock_(lock), hold_time_(hold_time) {}
+  virtual ~LockHolder() {}
+
+  virtual void ThreadMain() {
+    mod_spdy::ProfiledAutoLock autolock(*lock_);
+    base::PlatformThread::Sleep(hold_time_);
+  }
+
+ private:
+  mod_spdy::ProfiledLock* const lock_;
+  const base::TimeDelta hold_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(LockHolder);
+};
+
+class ProfiledLockTest : public testing::Test {
+ protected:
+  virtual void TearDown() {
+    if (mod_spdy::LockProfiler::Instance() != NULL) {
+      mod_spdy::LockProfiler::DestroyInstance();
+    }
+  }
+};
+
+TEST_F(ProfiledLockTest, DisabledByDefault) {
+  ASSERT_TRUE(mod_spdy::LockProfiler::Instance() == NULL);
+  mod_spdy::ProfiledLock lock("test");
+  {
+    mod_spdy::ProfiledAutoLock autolock(lock);
+    lock.AssertAcquired();
+    mod_spdy::ProfiledAutoUnlock autounlock(lock);
+  }
+  mod_spdy::LockProfiler::CreateInstance();
+  EXPECT_EQ(0, mod_spdy::LockProfiler::Instance()->GetStats("test")
+            .acquisitions);
+}
+
+TEST_F(ProfiledLockTest, CountsUncontendedAcquisitions) {
+  mod_spdy::LockProfiler::CreateInstance();
+  {
+    mod_spdy::ProfiledLock lock1("test");
+    mod_spdy::ProfiledLock lock2("test");
+    mod_spdy::ProfiledLock other("other");
+    for (int i = 0; i < 100; ++i) {
+      mod_spdy::ProfiledAutoLock autolock(lock1);
+    }
+    for (int i = 0; i < 50; ++i) {
+      mod_spdy::ProfiledAutoLock autolock(lock2);
+    }
+    mod_spdy::ProfiledAutoLock autolock(other);
+  }
+  // The locks report everything when they're destroyed.
+  const mod_spdy::LockStats stats =
+      mod_spdy::LockProfiler::Instance()->GetStats("test");
+  EXPECT_EQ(150, stats.acquisitions);
+  EXPECT_EQ(0, stats.contended);
+  EXPECT_EQ(0, stats.total_wait.InMicroseconds());
+  EXPECT_EQ(1, mod_spdy::LockProfiler::Instance()->GetStats("other")
+            .acquisitions);
+
+  const std::string report = mod_spdy::LockProfiler::Instance()->GetReport();
+  EXPECT_NE(std::string::npos, report.find("test"));
+  EXPECT_NE(std::string::npos, report.find("other"));
+
+  mod_spdy::LockProfiler::Instance()->Clear();
+  EXPECT_EQ(0, mod_spdy::LockProfiler::Instance()->GetStats("test")
+            .acquisitions);
+}
+
+TEST_F(ProfiledLockTest, CountsContention) {
+  mod_spdy::LockProfiler::CreateInstance();
+  {
+    mod_spdy::ProfiledLock lock("test");
+    LockHolder holder(&lock, base::TimeDelta::FromMilliseconds(100));
+    base::PlatformThreadHandle handle;
+    ASSERT_TRUE(base::PlatformThread::Create(0, &holder, &handle));
+    // Give the other thread time to grab the lock, then wait for it.
+    base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(30));
+    {
+      mod_spdy::ProfiledAutoLock autolock(lock);
+    }
+    base::PlatformThread::Join(handle);
+  }
+  const mod_spdy::LockStats stats =
+      mod_spdy::LockProfiler::Instance()->GetStats("test");
+  EXPECT_EQ(2, stats.acquisitions);
+  EXPECT_EQ(1, stats.contended);
+  EXPECT_LE(20, stats.total_wait.InMilliseconds());
+  EXPECT_EQ(stats.total_wait.InMicroseconds(),
+            stats.max_wait.InMicroseconds());
+  EXPECT_LE(80, stats.max_hold.InMilliseconds());
+}
+
+// Time spent waiting on a condition variable isn't time spent holding the
+// lock.
+TEST_F(ProfiledLockTest, ConditionVariableWaitIsNotHeld) {
+  mod_spdy::LockProfiler::CreateInstance();
+  {
+    mod_spdy::ProfiledLock lock("test");
+    mod_spdy::ProfiledConditionVariable condvar(&lock);
+    mod_spdy::ProfiledAutoLock autolock(lock);
+    condvar.TimedWait(base::TimeDelta::FromMilliseconds(100));
+  }
+  const mod_spdy::LockStats stats =
+      mod_spdy::LockProfiler::Instance()->GetStats("test");
+  EXPECT_EQ(1, stats.acquisitions);
+  EXPECT_GT(50, stats.total_hold.InMilliseconds());
+}
+
+}  // namespace
@@ -14,8 +14,11 @@
 
 #include "mod_spdy/common/protocol_util.h"
 
+#include <string>
+#include <utility>
+
 #include "base/strings/string_piece.h"
-#include "base/strings/string_util.h"
+#include "mod_spdy/common/http_header_names.h"
 #include "net/spdy/spdy_frame_builder.h"
 #include "net/spdy/spdy_framer.h"
 #include "net/spdy/spdy_protocol.h"
@@ -25,14 +28,30 @@ namespace mod_spdy {
 namespace http {
 
 extern const char* const kAcceptEncoding = "accept-encoding";
+extern const char* const kAge = "age";
+extern const char* const kAuthorization = "authorization";
+extern const char* const kCacheControl = "cache-control";
 extern const char* const kConnection = "connection";
+extern const char* const kContentEncoding = "content-encoding";
 extern const char* const kContentLength = "content-length";
 extern const char* const kContentType = "content-type";
+extern const char* const kDate = "date";
+extern const char* const kETag = "etag";
+extern const char* const kExpires = "expires";
 extern const char* const kHost = "host";
+extern const char* const kIfModifiedSince = "if-modified-since";
+extern const char* const kIfNoneMatch = "if-none-match";
+extern const char* const kIfRange = "if-range";
 extern const char* const kKeepAlive = "keep-alive";
+extern const char* const kLastModified = "last-modified";
+extern const char* const kLink = "link";
+extern const char* const kPragma = "pragma";
 extern const char* const kProxyConnection = "proxy-connection";
+extern const char* const kRange = "range";
 extern const char* const kReferer = "referer";
+extern const char* const kSetCookie = "set-cookie";
 extern const char* const kTransferEncoding = "transfer-encoding";
+extern const char* const kVary = "vary";
 extern const char* const kXAssociatedContent = "x-associated-content";
 extern const char* const kXModSpdy = "x-mod-spdy";
 
@@ -105,14 +124,10 @@ const char* SettingsIdToString(net::SpdySettingsIds id) {
 }
 
 bool IsInvalidSpdyResponseHeader(base::StringPiece key) {
-  // The following headers are forbidden in SPDY responses (SPDY draft 3
-  // section 3.2.2).
-  return (LowerCaseEqualsASCII(key.begin(), key.end(), http::kConnection) ||
-          LowerCaseEqualsASCII(key.begin(), key.end(), http::kKeepAlive) ||
-          LowerCaseEqualsASCII(key.begin(), key.end(),
-                               http::kProxyConnection) ||
-          LowerCaseEqualsASCII(key.begin(), key.end(),
-                               http::kTransferEncoding));
+  // All of the headers that are forbidden in SPDY responses are well-known,
+  // so one lookup in the header name table tells us.
+  const KnownHttpHeaderName* known = LookupHttpHeaderName(key);
+  return known != NULL && known->forbidden_in_spdy_response;
 }
 
 net::SpdyPriority LowestSpdyPriorityForVersion(
@@ -120,20 +135,46 @@ net::SpdyPriority LowestSpdyPriorityForVersion(
   return (spdy_version < spdy::SPDY_VERSION_3 ? 3u : 7u);
 }
 
+namespace {
+
+void MergeInLowerCaseHeader(const std::string& lower_key,
+                            base::StringPiece value,
+                            net::SpdyHeaderBlock* headers) {
+  // Find where the key is or would go with a single search of the map, and
+  // use that as the hint for inserting it if it's new.
+  net::SpdyHeaderBlock::iterator iter = headers->lower_bound(lower_key);
+  if (iter == headers->end() || iter->first != lower_key) {
+    headers->insert(iter, std::make_pair(lower_key, value.as_string()));
+  } else {
+    iter->second.push_back('\0');
+    value.AppendToString(&iter->second);
+  }
+}
+
+}  // namespace
+
 void MergeInHeader(base::StringPiece key, base::StringPiece value,
                    net::SpdyHeaderBlock* headers) {
   // The SPDY spec requires that header names be lowercase, so forcibly
   // lowercase the key here.
-  std::string lower_key(key.as_string());
-  StringToLowerASCII(&lower_key);
+  std::string lower_key;
+  LowerCaseHttpHeaderName(key, &lower_key);
+  MergeInLowerCaseHeader(lower_key, value, headers);
+}
 
-  net::SpdyHeaderBlock::iterator iter = headers->find(lower_key);
-  if (iter == headers->end()) {
-    (*headers)[lower_key] = value.as_string();
+bool MergeInResponseHeader(base::StringPiece key, base::StringPiece value,
+                           net::SpdyHeaderBlock* headers) {
+  std::string lower_key;
+  const KnownHttpHeaderName* known = LookupHttpHeaderName(key);
+  if (known == NULL) {
+    AppendLowerCaseASCII(key, &lower_key);
+  } else if (known->forbidden_in_spdy_response) {
+    return false;
   } else {
-    iter->second.push_back('\0');
-    value.AppendToString(&iter->second);
+    lower_key.assign(known->name, known->length);
   }
+  MergeInLowerCaseHeader(lower_key, value, headers);
+  return true;
 }
 
 }  // namespace mod_spdy
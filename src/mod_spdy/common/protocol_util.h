@@ -26,14 +26,30 @@ namespace http {
 // HTTP header names.  These values are all lower-case, so they can be used
 // directly in SPDY header blocks.
 extern const char* const kAcceptEncoding;
+extern const char* const kAge;
+extern const char* const kAuthorization;
+extern const char* const kCacheControl;
 extern const char* const kConnection;
+extern const char* const kContentEncoding;
 extern const char* const kContentLength;
 extern const char* const kContentType;
+extern const char* const kDate;
+extern const char* const kETag;
+extern const char* const kExpires;
 extern const char* const kHost;
+extern const char* const kIfModifiedSince;
+extern const char* const kIfNoneMatch;
+extern const char* const kIfRange;
 extern const char* const kKeepAlive;
+extern const char* const kLastModified;
+extern const char* const kLink;
+extern const char* const kPragma;
 extern const char* const kProxyConnection;
+extern const char* const kRange;
 extern const char* const kReferer;
+extern const char* const kSetCookie;
 extern const char* const kTransferEncoding;
+extern const char* const kVary;
 extern const char* const kXAssociatedContent;
 extern const char* const kXModSpdy;
 
@@ -100,6 +116,12 @@ net::SpdyPriority LowestSpdyPriorityForVersion(spdy::SpdyVersion spdy_version);
 void MergeInHeader(base::StringPiece key, base::StringPiece value,
                    net::SpdyHeaderBlock* headers);
 
+// Like MergeInHeader, but drop the header instead if it is forbidden in SPDY
+// responses, returning false.  This is cheaper than calling
+// IsInvalidSpdyResponseHeader and then MergeInHeader.
+bool MergeInResponseHeader(base::StringPiece key, base::StringPiece value,
+                           net::SpdyHeaderBlock* headers);
+
 }  // namespace mod_spdy
 
 #endif  // MOD_SPDY_COMMON_PROTOCOL_UTIL_H_
@@ -92,4 +92,21 @@ TEST(ProtocolUtilTest, MergeRepeatedHeader) {
   ASSERT_EQ(expected3, headers["x-foo"]);
 }
 
+TEST(ProtocolUtilTest, MergeInResponseHeader) {
+  net::SpdyHeaderBlock headers;
+
+  EXPECT_TRUE(mod_spdy::MergeInResponseHeader("Content-Type", "text/html",
+                                              &headers));
+  EXPECT_FALSE(mod_spdy::MergeInResponseHeader("Connection", "close",
+                                               &headers));
+  EXPECT_TRUE(mod_spdy::MergeInResponseHeader("X-Foo", "bar", &headers));
+  EXPECT_FALSE(mod_spdy::MergeInResponseHeader("transfer-encoding", "chunked",
+                                               &headers));
+  EXPECT_TRUE(mod_spdy::MergeInResponseHeader("x-foo", "baz", &headers));
+
+  ASSERT_EQ(2u, headers.size());
+  EXPECT_EQ("text/html", headers["content-type"]);
+  EXPECT_EQ(std::string("bar\0baz", 7), headers["x-foo"]);
+}
+
 }  // namespace
@@ -0,0 +1,518 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/push_response_cache.h"
+
+#include <algorithm>  // for std::min and std::max
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_piece.h"
+#include "base/strings/string_util.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "mod_spdy/common/protocol_util.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace {
+
+// RFC 2616 section 13.2.4 suggests 10% of the time since the resource was
+// last modified as a heuristic freshness lifetime; we additionally cap that
+// at one day, beyond which a cache is supposed to attach a warning.
+const int kHeuristicLifetimePercent = 10;
+const int64 kMaxHeuristicLifetimeSeconds = 24 * 60 * 60;
+
+typedef std::vector<std::pair<std::string, std::string> > VaryValues;
+
+// Get the value of a header, or return false if the header is absent.
+bool GetHeader(const net::SpdyHeaderBlock& headers, const char* name,
+               std::string* value) {
+  const net::SpdyHeaderBlock::const_iterator iter = headers.find(name);
+  if (iter == headers.end()) {
+    return false;
+  }
+  *value = iter->second;
+  return true;
+}
+
+// Split a header value into its lower-cased, whitespace-trimmed list elements.
+// Duplicate headers are merged with NUL separators (see MergeInHeader), so we
+// split on NUL as well as on commas.
+void SplitHeaderList(const std::string& value,
+                     std::vector<std::string>* elements) {
+  std::vector<std::string> pieces;
+  Tokenize(value, std::string(",\0", 2), &pieces);
+  for (std::vector<std::string>::const_iterator iter = pieces.begin();
+       iter != pieces.end(); ++iter) {
+    std::string element;
+    TrimWhitespaceASCII(*iter, TRIM_ALL, &element);
+    if (!element.empty()) {
+      StringToLowerASCII(&element);
+      elements->push_back(element);
+    }
+  }
+}
+
+bool ParseHttpDate(const std::string& value, base::Time* time) {
+  return !value.empty() && base::Time::FromString(value.c_str(), time);
+}
+
+// Collect the request header values named by the response's Vary header.
+// Return false if the response varies on something we can't key on.
+bool GetVaryValues(const net::SpdyHeaderBlock& request_headers,
+                   const net::SpdyHeaderBlock& response_headers,
+                   VaryValues* vary_values) {
+  std::string vary;
+  if (!GetHeader(response_headers, mod_spdy::http::kVary, &vary)) {
+    return true;
+  }
+  std::vector<std::string> names;
+  SplitHeaderList(vary, &names);
+  for (std::vector<std::string>::const_iterator iter = names.begin();
+       iter != names.end(); ++iter) {
+    if (*iter == "*") {
+      return false;
+    }
+    std::string value;
+    GetHeader(request_headers, iter->c_str(), &value);
+    vary_values->push_back(std::make_pair(*iter, value));
+  }
+  return true;
+}
+
+// Determine whether the response may be stored, and if so, for how long it
+// stays fresh.
+bool GetFreshnessLifetime(const net::SpdyHeaderBlock& response_headers,
+                          base::TimeDelta* lifetime) {
+  std::string status;
+  if (!GetHeader(response_headers, mod_spdy::spdy::kSpdy3Status, &status) ||
+      !(status == "200" || StartsWithASCII(status, "200 ", true))) {
+    return false;
+  }
+
+  // Never share responses that set cookies.
+  if (response_headers.count(mod_spdy::http::kSetCookie) > 0) {
+    return false;
+  }
+
+  // We only cache responses that carry a validator, so that what we serve is
+  // always tied to a specific version of the resource.
+  std::string etag, last_modified_string;
+  const bool has_etag = GetHeader(response_headers, mod_spdy::http::kETag,
+                                  &etag);
+  const bool has_last_modified = GetHeader(
+      response_headers, mod_spdy::http::kLastModified, &last_modified_string);
+  if (!has_etag && !has_last_modified) {
+    return false;
+  }
+
+  // Explicit freshness from Cache-Control takes precedence (s-maxage over
+  // max-age, since we are a shared cache).
+  std::string cache_control;
+  if (GetHeader(response_headers, mod_spdy::http::kCacheControl,
+                &cache_control)) {
+    std::vector<std::string> directives;
+    SplitHeaderList(cache_control, &directives);
+    int64 max_age = -1;
+    int64 s_maxage = -1;
+    for (std::vector<std::string>::const_iterator iter = directives.begin();
+         iter != directives.end(); ++iter) {
+      const std::string& directive = *iter;
+      if (directive == "no-store" || directive == "no-cache" ||
+          directive == "private" ||
+          StartsWithASCII(directive, "no-cache=", true) ||
+          StartsWithASCII(directive, "private=", true)) {
+        return false;
+      } else if (StartsWithASCII(directive, "max-age=", true)) {
+        if (!base::StringToInt64(directive.substr(8), &max_age)) {
+          return false;
+        }
+      } else if (StartsWithASCII(directive, "s-maxage=", true)) {
+        if (!base::StringToInt64(directive.substr(9), &s_maxage)) {
+          return false;
+        }
+      }
+    }
+    if (s_maxage >= 0 || max_age >= 0) {
+      *lifetime = base::TimeDelta::FromSeconds(
+          s_maxage >= 0 ? s_maxage : max_age);
+      return *lifetime > base::TimeDelta();
+    }
+  }
+
+  // Next, try Expires, relative to the Date header.  An unparseable Expires
+  // header means "already expired" (RFC 2616 section 14.21).
+  std::string date_string;
+  base::Time date;
+  const bool has_date =
+      GetHeader(response_headers, mod_spdy::http::kDate, &date_string) &&
+      ParseHttpDate(date_string, &date);
+  std::string expires_string;
+  if (GetHeader(response_headers, mod_spdy::http::kExpires, &expires_string)) {
+    base::Time expires;
+    if (!has_date || !ParseHttpDate(expires_string, &expires)) {
+      return false;
+    }
+    *lifetime = expires - date;
+    return *lifetime > base::TimeDelta();
+  }
+
+  // Finally, fall back to a heuristic based on Last-Modified.
+  base::Time last_modified;
+  if (!has_date || !has_last_modified ||
+      !ParseHttpDate(last_modified_string, &last_modified) ||
+      last_modified >= date) {
+    return false;
+  }
+  *lifetime = std::min(
+      (date - last_modified) * kHeuristicLifetimePercent / 100,
+      base::TimeDelta::FromSeconds(kMaxHeuristicLifetimeSeconds));
+  return *lifetime > base::TimeDelta();
+}
+
+// Like GetFreshnessLifetime, but take into account how long the response
+// had already spent in other caches (per its Age header, if any) before it got
+// to us.  On success, set *remaining_lifetime to how much longer it stays
+// fresh, and *initial_age to the age it had when we received it.
+bool GetRemainingFreshness(const net::SpdyHeaderBlock& response_headers,
+                           base::TimeDelta* remaining_lifetime,
+                           base::TimeDelta* initial_age) {
+  base::TimeDelta lifetime;
+  if (!GetFreshnessLifetime(response_headers, &lifetime)) {
+    return false;
+  }
+  // An Age header that isn't a non-negative integer is invalid, and we
+  // ignore it (RFC 7234 section 5.1).
+  int64 age_seconds = 0;
+  std::string age_string;
+  if (GetHeader(response_headers, mod_spdy::http::kAge, &age_string) &&
+      (!base::StringToInt64(age_string, &age_seconds) || age_seconds < 0)) {
+    age_seconds = 0;
+  }
+  *initial_age = base::TimeDelta::FromSeconds(age_seconds);
+  *remaining_lifetime = lifetime - *initial_age;
+  return *remaining_lifetime > base::TimeDelta();
+}
+
+size_t HeaderBlockSize(const net::SpdyHeaderBlock& headers) {
+  size_t size = 0;
+  for (net::SpdyHeaderBlock::const_iterator iter = headers.begin();
+       iter != headers.end(); ++iter) {
+    size += iter->first.size() + iter->second.size();
+  }
+  return size;
+}
+
+}  // namespace
+
+namespace mod_spdy {
+
+bool PushResponseCache::GetCacheKey(
+    const net::SpdyHeaderBlock& request_headers, std::string* key) {
+  std::string scheme, host, path, method;
+  if (!GetHeader(request_headers, spdy::kSpdy3Scheme, &scheme) ||
+      !GetHeader(request_headers, spdy::kSpdy3Host, &host) ||
+      !GetHeader(request_headers, spdy::kSpdy3Path, &path)) {
+    return false;
+  }
+  // Pushes are always GETs, but be defensive.
+  if (GetHeader(request_headers, spdy::kSpdy3Method, &method) &&
+      method != "GET") {
+    return false;
+  }
+  // Responses to authenticated requests are private to that user.
+  if (request_headers.count(http::kAuthorization) > 0) {
+    return false;
+  }
+  *key = scheme + "://" + host + path;
+  return true;
+}
+
+bool PushResponseCache::CanShareResponse(
+    const net::SpdyHeaderBlock& request_headers,
+    const net::SpdyHeaderBlock& response_headers,
+    const net::SpdyHeaderBlock& other_request_headers) {
+  std::string url, other_url;
+  VaryValues vary_values;
+  base::TimeDelta freshness_lifetime, initial_age;
+  if (!GetCacheKey(request_headers, &url) ||
+      !GetCacheKey(other_request_headers, &other_url) || url != other_url ||
+      !GetVaryValues(request_headers, response_headers, &vary_values) ||
+      !GetRemainingFreshness(response_headers, &freshness_lifetime,
+                             &initial_age)) {
+    return false;
+  }
+  for (VaryValues::const_iterator vary = vary_values.begin();
+       vary != vary_values.end(); ++vary) {
+    std::string value;
+    GetHeader(other_request_headers, vary->first.c_str(), &value);
+    if (value != vary->second) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool PushResponseCache::IsNotModified(
+    const net::SpdyHeaderBlock& request_headers,
+    const net::SpdyHeaderBlock& response_headers) {
+  // If-None-Match takes precedence over If-Modified-Since (RFC 2616 section
+  // 14.26).  Entity tags are case-sensitive, and we use the weak comparison
+  // function, since this is a GET (RFC 2616 section 13.3.3).
+  std::string if_none_match;
+  if (GetHeader(request_headers, http::kIfNoneMatch, &if_none_match)) {
+    std::string etag;
+    if (!GetHeader(response_headers, http::kETag, &etag)) {
+      return false;
+    }
+    if (StartsWithASCII(etag, "W/", true)) {
+      etag.erase(0, 2);
+    }
+    std::vector<std::string> pieces;
+    Tokenize(if_none_match, std::string(",\0", 2), &pieces);
+    for (std::vector<std::string>::const_iterator iter = pieces.begin();
+         iter != pieces.end(); ++iter) {
+      std::string tag;
+      TrimWhitespaceASCII(*iter, TRIM_ALL, &tag);
+      if (StartsWithASCII(tag, "W/", true)) {
+        tag.erase(0, 2);
+      }
+      if (tag == "*" || tag == etag) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::string if_modified_since_string, last_modified_string;
+  base::Time if_modified_since, last_modified;
+  return (GetHeader(request_headers, http::kIfModifiedSince,
+                    &if_modified_since_string) &&
+          GetHeader(response_headers, http::kLastModified,
+                    &last_modified_string) &&
+          ParseHttpDate(if_modified_since_string, &if_modified_since) &&
+          ParseHttpDate(last_modified_string, &last_modified) &&
+          !(last_modified > if_modified_since));
+}
+
+struct PushResponseCache::Entry {
+  std::string url;
+  VaryValues vary_values;
+  Response response;
+  base::TimeTicks response_time;
+  base::TimeDelta initial_age;  // from the response's own Age header
+  base::TimeDelta freshness_lifetime;  // from response_time, less initial_age
+  size_t size;
+  LruList::iterator lru_position;
+  EntryMap::iterator map_position;
+};
+
+PushResponseCache::PushResponseCache(size_t max_total_bytes,
+                                     size_t max_entry_bytes)
+    : max_total_bytes_(max_total_bytes),
+      max_entry_bytes_(std::min(max_entry_bytes, max_total_bytes)),
+      total_bytes_(0) {}
+
+PushResponseCache::~PushResponseCache() {
+  base::AutoLock autolock(lock_);
+  while (!lru_.empty()) {
+    RemoveEntry(lru_.back());
+  }
+}
+
+bool PushResponseCache::Lookup(const net::SpdyHeaderBlock& request_headers,
+                               base::TimeTicks now, Response* response) {
+  std::string url;
+  if (!GetCacheKey(request_headers, &url)) {
+    return false;
+  }
+
+  base::AutoLock autolock(lock_);
+  std::pair<EntryMap::iterator, EntryMap::iterator> range =
+      entries_.equal_range(url);
+  for (EntryMap::iterator iter = range.first; iter != range.second; ++iter) {
+    Entry* entry = iter->second;
+
+    // Check that this variant matches the request.
+    bool matches = true;
+    for (VaryValues::const_iterator vary = entry->vary_values.begin();
+         vary != entry->vary_values.end(); ++vary) {
+      std::string value;
+      GetHeader(request_headers, vary->first.c_str(), &value);
+      if (value != vary->second) {
+        matches = false;
+        break;
+      }
+    }
+    if (!matches) {
+      continue;
+    }
+
+    // If the matching entry has gone stale, drop it; the push will go through
+    // Apache, and the fresh response will replace it.
+    const base::TimeDelta resident_time = now - entry->response_time;
+    if (resident_time >= entry->freshness_lifetime) {
+      VLOG(3) << "Push cache entry for " << url << " is stale";
+      RemoveEntry(entry);
+      return false;
+    }
+
+    lru_.splice(lru_.begin(), lru_, entry->lru_position);
+    *response = entry->response;
+    const base::TimeDelta age = entry->initial_age + resident_time;
+    response->headers[http::kAge] =
+        base::Int64ToString(std::max<int64>(0, age.InSeconds()));
+    return true;
+  }
+  return false;
+}
+
+PushResponseCache::Recorder* PushResponseCache::NewRecorder(
+    const net::SpdyHeaderBlock& request_headers) {
+  std::string url;
+  if (!GetCacheKey(request_headers, &url)) {
+    return NULL;
+  }
+  return new Recorder(this, request_headers);
+}
+
+bool PushResponseCache::Insert(const net::SpdyHeaderBlock& request_headers,
+                               const Response& response,
+                               base::TimeTicks now) {
+  std::string url;
+  VaryValues vary_values;
+  base::TimeDelta freshness_lifetime, initial_age;
+  if (!GetCacheKey(request_headers, &url) ||
+      !GetVaryValues(request_headers, response.headers, &vary_values) ||
+      !GetRemainingFreshness(response.headers, &freshness_lifetime,
+                             &initial_age)) {
+    return false;
+  }
+
+  const size_t size =
+      url.size() + HeaderBlockSize(response.headers) + response.body.size();
+  if (size > max_entry_bytes_) {
+    return false;
+  }
+
+  scoped_ptr<Entry> entry(new Entry);
+  entry->url = url;
+  entry->vary_values.swap(vary_values);
+  entry->response = response;
+  entry->response_time = now;
+  entry->initial_age = initial_age;
+  entry->freshness_lifetime = freshness_lifetime;
+  entry->size = size;
+
+  base::AutoLock autolock(lock_);
+
+  // Replace any existing entry for the same variant.
+  std::pair<EntryMap::iterator, EntryMap::iterator> range =
+      entries_.equal_range(url);
+  for (EntryMap::iterator iter = range.first; iter != range.second; ++iter) {
+    if (iter->second->vary_values == entry->vary_values) {
+      RemoveEntry(iter->second);
+      break;
+    }
+  }
+
+  // Make room for the new entry.
+  while (!lru_.empty() && total_bytes_ + size > max_total_bytes_) {
+    RemoveEntry(lru_.back());
+  }
+
+  Entry* raw_entry = entry.release();
+  raw_entry->lru_position = lru_.insert(lru_.begin(), raw_entry);
+  raw_entry->map_position = entries_.insert(std::make_pair(url, raw_entry));
+  total_bytes_ += size;
+  VLOG(3) << "Stored push cache entry for " << url << " (" << size
+          << " bytes, fresh for " << freshness_lifetime.InSeconds() << "s)";
+  return true;
+}
+
+size_t PushResponseCache::num_entries() const {
+  base::AutoLock autolock(lock_);
+  return lru_.size();
+}
+
+size_t PushResponseCache::total_bytes() const {
+  base::AutoLock autolock(lock_);
+  return total_bytes_;
+}
+
+void PushResponseCache::RemoveEntry(Entry* entry) {
+  lock_.AssertAcquired();
+  DCHECK_GE(total_bytes_, entry->size);
+  total_bytes_ -= entry->size;
+  lru_.erase(entry->lru_position);
+  entries_.erase(entry->map_position);
+  delete entry;
+}
+
+PushResponseCache::Recorder::Recorder(
+    PushResponseCache* cache, const net::SpdyHeaderBlock& request_headers)
+    : cache_(cache),
+      request_headers_(request_headers),
+      received_headers_(false),
+      done_(false) {
+  DCHECK(cache_);
+}
+
+PushResponseCache::Recorder::~Recorder() {}
+
+void PushResponseCache::Recorder::OnHeaders(
+    const net::SpdyHeaderBlock& headers, bool flag_fin) {
+  if (done_) {
+    return;
+  }
+  // We don't bother caching responses with trailing headers.
+  if (received_headers_) {
+    done_ = true;
+    return;
+  }
+  received_headers_ = true;
+  response_.headers = headers;
+  if (flag_fin) {
+    Finish();
+  }
+}
+
+void PushResponseCache::Recorder::OnData(base::StringPiece data,
+                                         bool flag_fin) {
+  if (done_) {
+    return;
+  }
+  if (!received_headers_ ||
+      response_.body.size() + data.size() > cache_->max_entry_bytes()) {
+    done_ = true;
+    response_.body.clear();
+    return;
+  }
+  data.AppendToString(&response_.body);
+  if (flag_fin) {
+    Finish();
+  }
+}
+
+void PushResponseCache::Recorder::Finish() {
+  DCHECK(!done_);
+  done_ = true;
+  cache_->Insert(request_headers_, response_, base::TimeTicks::Now());
+}
+
+}  // namespace mod_spdy
@@ -0,0 +1,158 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MOD_SPDY_COMMON_PUSH_RESPONSE_CACHE_H_
+#define MOD_SPDY_COMMON_PUSH_RESPONSE_CACHE_H_
+
+#include <list>
+#include <map>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace mod_spdy {
+
+// A size-bounded, in-memory cache of complete responses (headers plus body)
+// to server push requests.  Entries are keyed on the pushed URL plus the
+// values of any request headers named by the response's Vary header.  Only
+// 200 responses that carry a validator (ETag or Last-Modified) and that have a
+// positive freshness lifetime -- either explicit (Cache-Control max-age or
+// Expires) or heuristic (based on Last-Modified), less any Age the response
+// arrived with -- are stored, and an entry is only served while it is still
+// fresh; once stale, it is dropped, and the next push of that URL goes through
+// Apache again and refreshes the entry.
+// Least-recently-used entries are evicted when the cache is full.
+//
+// Besides server pushes, the same kind of cache serves as the per-vhost
+// micro-cache of small responses to client GET requests (see
+// SpdySession::set_micro_cache).
+//
+// This should be created during per-process initialization.  This class is
+// thread-safe.
+class PushResponseCache {
+ public:
+  // A complete response, as it would be sent to the client on a stream.
+  struct Response {
+    net::SpdyHeaderBlock headers;
+    std::string body;
+  };
+
+  // Collects the headers and data sent on a single stream, and inserts the
+  // response into the cache once the final frame has been sent.  This class
+  // is not thread-safe; it is meant to be used by the stream thread.
+  class Recorder {
+   public:
+    // The Recorder does not take ownership of the cache.
+    Recorder(PushResponseCache* cache,
+             const net::SpdyHeaderBlock& request_headers);
+    ~Recorder();
+
+    // Record the response headers or a chunk of response body, respectively.
+    // When flag_fin is true, the response is complete and will be offered to
+    // the cache.
+    void OnHeaders(const net::SpdyHeaderBlock& headers, bool flag_fin);
+    void OnData(base::StringPiece data, bool flag_fin);
+
+   private:
+    void Finish();
+
+    PushResponseCache* const cache_;
+    const net::SpdyHeaderBlock request_headers_;
+    Response response_;
+    bool received_headers_;
+    bool done_;  // response finished, or found to be uncacheable
+
+    DISALLOW_COPY_AND_ASSIGN(Recorder);
+  };
+
+  // Create a cache that holds at most max_total_bytes of responses, none of
+  // which may individually be larger than max_entry_bytes.
+  PushResponseCache(size_t max_total_bytes, size_t max_entry_bytes);
+  ~PushResponseCache();
+
+  size_t max_total_bytes() const { return max_total_bytes_; }
+  size_t max_entry_bytes() const { return max_entry_bytes_; }
+
+  // Look up a fresh response for the given request headers.  On a hit,
+  // copy the response (with its Age header updated) into *response and return
+  // true; otherwise return false.  Stale entries found along the way are
+  // removed.
+  bool Lookup(const net::SpdyHeaderBlock& request_headers,
+              base::TimeTicks now, Response* response);
+
+  // Return a new Recorder for a request with the given headers, or NULL if
+  // such a request can never be served from the cache (e.g. because it
+  // carries credentials).  The caller takes ownership of the Recorder.
+  Recorder* NewRecorder(const net::SpdyHeaderBlock& request_headers);
+
+  // Store a complete response to the given push request, replacing any
+  // existing entry for the same URL and Vary values.  Return true if the
+  // response was cacheable and has been stored, false otherwise.
+  bool Insert(const net::SpdyHeaderBlock& request_headers,
+              const Response& response, base::TimeTicks now);
+
+  // Get the key (the full URL) under which responses to the given request
+  // would be cached, or return false if the request must never be answered
+  // with a shared response (e.g. because it carries credentials).
+  static bool GetCacheKey(const net::SpdyHeaderBlock& request_headers,
+                          std::string* key);
+
+  // Determine whether the given response to request_headers may be shared
+  // (ignoring size limits), and if so, whether it would also be the right
+  // response to other_request_headers; that is, whether the other request is
+  // for the same URL and agrees on every header named by the response's Vary
+  // header.  Passing the same request twice just checks cacheability.
+  static bool CanShareResponse(
+      const net::SpdyHeaderBlock& request_headers,
+      const net::SpdyHeaderBlock& response_headers,
+      const net::SpdyHeaderBlock& other_request_headers);
+
+  // Determine whether a cached response with the given headers satisfies the
+  // request's If-None-Match header (or, failing that, its If-Modified-Since
+  // header), so that the client may simply be told that its own copy is
+  // still good.
+  static bool IsNotModified(const net::SpdyHeaderBlock& request_headers,
+                            const net::SpdyHeaderBlock& response_headers);
+
+  // Get the current number of entries and total size of the cache.  These are
+  // mostly useful for debugging and testing.
+  size_t num_entries() const;
+  size_t total_bytes() const;
+
+ private:
+  struct Entry;
+  typedef std::list<Entry*> LruList;
+  typedef std::multimap<std::string, Entry*> EntryMap;
+
+  // Remove and delete the entry.  Caller must be holding lock_.
+  void RemoveEntry(Entry* entry);
+
+  const size_t max_total_bytes_;
+  const size_t max_entry_bytes_;
+
+  mutable base::Lock lock_;
+  LruList lru_;  // most recently used at the front
+  EntryMap entries_;  // keyed by URL; one entry per Vary variant
+  size_t total_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(PushResponseCache);
+};
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_PUSH_RESPONSE_CACHE_H_
@@ -0,0 +1,310 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/push_response_cache.h"
+
+#include <string>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/time/time.h"
+#include "mod_spdy/common/protocol_util.h"
+#include "net/spdy/spdy_protocol.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+using mod_spdy::PushResponseCache;
+
+void MakeRequestHeaders(const std::string& path,
+                        net::SpdyHeaderBlock* headers) {
+  (*headers)[mod_spdy::spdy::kSpdy3Host] = "www.example.com";
+  (*headers)[mod_spdy::spdy::kSpdy3Method] = "GET";
+  (*headers)[mod_spdy::spdy::kSpdy3Path] = path;
+  (*headers)[mod_spdy::spdy::kSpdy3Scheme] = "https";
+  (*headers)[mod_spdy::spdy::kSpdy3Version] = "HTTP/1.1";
+}
+
+void MakeResponse(const std::string& body, PushResponseCache::Response* resp) {
+  resp->headers[mod_spdy::spdy::kSpdy3Status] = "200";
+  resp->headers[mod_spdy::spdy::kSpdy3Version] = "HTTP/1.1";
+  resp->headers[mod_spdy::http::kContentType] = "text/css";
+  resp->headers[mod_spdy::http::kETag] = "\"abc123\"";
+  resp->headers[mod_spdy::http::kCacheControl] = "public, max-age=60";
+  resp->body = body;
+}
+
+class PushResponseCacheTest : public testing::Test {
+ public:
+  PushResponseCacheTest()
+      : cache_(10000, 1000),
+        now_(base::TimeTicks::Now()) {}
+
+ protected:
+  PushResponseCache cache_;
+  base::TimeTicks now_;
+};
+
+// Test that a cacheable response is served back until it goes stale.
+TEST_F(PushResponseCacheTest, HitUntilStale) {
+  net::SpdyHeaderBlock request;
+  MakeRequestHeaders("/style.css", &request);
+  PushResponseCache::Response response;
+  MakeResponse("body { color: red }", &response);
+
+  PushResponseCache::Response result;
+  EXPECT_FALSE(cache_.Lookup(request, now_, &result));
+  ASSERT_TRUE(cache_.Insert(request, response, now_));
+  EXPECT_EQ(1u, cache_.num_entries());
+
+  ASSERT_TRUE(cache_.Lookup(
+      request, now_ + base::TimeDelta::FromSeconds(10), &result));
+  EXPECT_EQ("body { color: red }", result.body);
+  EXPECT_EQ("text/css", result.headers[mod_spdy::http::kContentType]);
+  EXPECT_EQ("10", result.headers[mod_spdy::http::kAge]);
+
+  // Once the entry goes stale, it is dropped.
+  EXPECT_FALSE(cache_.Lookup(
+      request, now_ + base::TimeDelta::FromSeconds(60), &result));
+  EXPECT_EQ(0u, cache_.num_entries());
+  EXPECT_EQ(0u, cache_.total_bytes());
+}
+
+// Test that the age a response already had when we received it counts
+// against its freshness lifetime, and is included in the Age we report.
+TEST_F(PushResponseCacheTest, ReceivedAge) {
+  net::SpdyHeaderBlock request;
+  MakeRequestHeaders("/style.css", &request);
+  PushResponseCache::Response response;
+  MakeResponse("body { color: red }", &response);
+  response.headers[mod_spdy::http::kAge] = "50";
+
+  PushResponseCache::Response result;
+  ASSERT_TRUE(cache_.Insert(request, response, now_));
+  ASSERT_TRUE(cache_.Lookup(
+      request, now_ + base::TimeDelta::FromSeconds(5), &result));
+  EXPECT_EQ("55", result.headers[mod_spdy::http::kAge]);
+  EXPECT_FALSE(cache_.Lookup(
+      request, now_ + base::TimeDelta::FromSeconds(10), &result));
+  EXPECT_EQ(0u, cache_.num_entries());
+
+  // A response that has already used up its lifetime is not stored.
+  response.headers[mod_spdy::http::kAge] = "60";
+  EXPECT_FALSE(cache_.Insert(request, response, now_));
+
+  // An invalid Age header is ignored.
+  response.headers[mod_spdy::http::kAge] = "-5";
+  ASSERT_TRUE(cache_.Insert(request, response, now_));
+  ASSERT_TRUE(cache_.Lookup(request, now_, &result));
+  EXPECT_EQ("0", result.headers[mod_spdy::http::kAge]);
+}
+
+// Test that responses which must not be shared are not stored.
+TEST_F(PushResponseCacheTest, UncacheableResponses) {
+  net::SpdyHeaderBlock request;
+  MakeRequestHeaders("/a.js", &request);
+
+  PushResponseCache::Response no_store;
+  MakeResponse("x", &no_store);
+  no_store.headers[mod_spdy::http::kCacheControl] = "max-age=60, no-store";
+  EXPECT_FALSE(cache_.Insert(request, no_store, now_));
+
+  PushResponseCache::Response not_ok;
+  MakeResponse("x", &not_ok);
+  not_ok.headers[mod_spdy::spdy::kSpdy3Status] = "404";
+  EXPECT_FALSE(cache_.Insert(request, not_ok, now_));
+
+  PushResponseCache::Response no_validator;
+  MakeResponse("x", &no_validator);
+  no_validator.headers.erase(mod_spdy::http::kETag);
+  EXPECT_FALSE(cache_.Insert(request, no_validator, now_));
+
+  PushResponseCache::Response sets_cookie;
+  MakeResponse("x", &sets_cookie);
+  sets_cookie.headers[mod_spdy::http::kSetCookie] = "a=b";
+  EXPECT_FALSE(cache_.Insert(request, sets_cookie, now_));
+
+  PushResponseCache::Response vary_star;
+  MakeResponse("x", &vary_star);
+  vary_star.headers[mod_spdy::http::kVary] = "*";
+  EXPECT_FALSE(cache_.Insert(request, vary_star, now_));
+
+  PushResponseCache::Response too_big;
+  MakeResponse(std::string(2000, 'x'), &too_big);
+  EXPECT_FALSE(cache_.Insert(request, too_big, now_));
+
+  // Requests carrying credentials are never cached.
+  net::SpdyHeaderBlock authorized;
+  MakeRequestHeaders("/a.js", &authorized);
+  authorized[mod_spdy::http::kAuthorization] = "Basic Zm9vOmJhcg==";
+  PushResponseCache::Response ok;
+  MakeResponse("x", &ok);
+  EXPECT_FALSE(cache_.Insert(authorized, ok, now_));
+  EXPECT_TRUE(cache_.NewRecorder(authorized) == NULL);
+
+  EXPECT_EQ(0u, cache_.num_entries());
+}
+
+// Test freshness computed from Expires and from Last-Modified.
+TEST_F(PushResponseCacheTest, FreshnessWithoutMaxAge) {
+  net::SpdyHeaderBlock request;
+  MakeRequestHeaders("/expires.css", &request);
+  PushResponseCache::Response expires;
+  MakeResponse("x", &expires);
+  expires.headers.erase(mod_spdy::http::kCacheControl);
+  expires.headers[mod_spdy::http::kDate] = "Mon, 06 Jan 2014 10:00:00 GMT";
+  expires.headers[mod_spdy::http::kExpires] = "Mon, 06 Jan 2014 10:05:00 GMT";
+  ASSERT_TRUE(cache_.Insert(request, expires, now_));
+  PushResponseCache::Response result;
+  EXPECT_TRUE(cache_.Lookup(
+      request, now_ + base::TimeDelta::FromSeconds(299), &result));
+  EXPECT_FALSE(cache_.Lookup(
+      request, now_ + base::TimeDelta::FromSeconds(300), &result));
+
+  // With only Last-Modified, the entry is fresh for 10% of its age.
+  MakeRequestHeaders("/heuristic.css", &request);
+  PushResponseCache::Response heuristic;
+  MakeResponse("x", &heuristic);
+  heuristic.headers.erase(mod_spdy::http::kCacheControl);
+  heuristic.headers.erase(mod_spdy::http::kETag);
+  heuristic.headers[mod_spdy::http::kDate] = "Mon, 06 Jan 2014 10:00:00 GMT";
+  heuristic.headers[mod_spdy::http::kLastModified] =
+      "Mon, 06 Jan 2014 09:00:00 GMT";
+  ASSERT_TRUE(cache_.Insert(request, heuristic, now_));
+  EXPECT_TRUE(cache_.Lookup(
+      request, now_ + base::TimeDelta::FromSeconds(359), &result));
+  EXPECT_FALSE(cache_.Lookup(
+      request, now_ + base::TimeDelta::FromSeconds(360), &result));
+}
+
+// Test that entries are keyed on the request headers named by Vary.
+TEST_F(PushResponseCacheTest, Vary) {
+  net::SpdyHeaderBlock gzip_request;
+  MakeRequestHeaders("/app.js", &gzip_request);
+  gzip_request[mod_spdy::http::kAcceptEncoding] = "gzip";
+  net::SpdyHeaderBlock plain_request;
+  MakeRequestHeaders("/app.js", &plain_request);
+
+  PushResponseCache::Response gzip_response;
+  MakeResponse("gzipped", &gzip_response);
+  gzip_response.headers[mod_spdy::http::kVary] = "Accept-Encoding";
+  ASSERT_TRUE(cache_.Insert(gzip_request, gzip_response, now_));
+
+  PushResponseCache::Response result;
+  EXPECT_FALSE(cache_.Lookup(plain_request, now_, &result));
+  ASSERT_TRUE(cache_.Lookup(gzip_request, now_, &result));
+  EXPECT_EQ("gzipped", result.body);
+
+  PushResponseCache::Response plain_response;
+  MakeResponse("plain", &plain_response);
+  plain_response.headers[mod_spdy::http::kVary] = "Accept-Encoding";
+  ASSERT_TRUE(cache_.Insert(plain_request, plain_response, now_));
+  EXPECT_EQ(2u, cache_.num_entries());
+  ASSERT_TRUE(cache_.Lookup(plain_request, now_, &result));
+  EXPECT_EQ("plain", result.body);
+  ASSERT_TRUE(cache_.Lookup(gzip_request, now_, &result));
+  EXPECT_EQ("gzipped", result.body);
+
+  // Inserting the same variant again replaces the old entry.
+  MakeResponse("gzipped2", &gzip_response);
+  gzip_response.headers[mod_spdy::http::kVary] = "Accept-Encoding";
+  ASSERT_TRUE(cache_.Insert(gzip_request, gzip_response, now_));
+  EXPECT_EQ(2u, cache_.num_entries());
+  ASSERT_TRUE(cache_.Lookup(gzip_request, now_, &result));
+  EXPECT_EQ("gzipped2", result.body);
+}
+
+// Test that the least recently used entries are evicted when the cache fills.
+TEST_F(PushResponseCacheTest, LruEviction) {
+  PushResponseCache::Response response;
+  MakeResponse(std::string(800, 'x'), &response);
+  for (int i = 0; i < 11; ++i) {
+    net::SpdyHeaderBlock request;
+    MakeRequestHeaders("/" + std::string(1, 'a' + i), &request);
+    ASSERT_TRUE(cache_.Insert(request, response, now_));
+    // Keep touching "/a", so that it never becomes the eviction candidate.
+    net::SpdyHeaderBlock first;
+    MakeRequestHeaders("/a", &first);
+    PushResponseCache::Response result;
+    EXPECT_TRUE(cache_.Lookup(first, now_, &result));
+  }
+  EXPECT_LE(cache_.total_bytes(), 10000u);
+  EXPECT_LT(cache_.num_entries(), 11u);
+
+  PushResponseCache::Response result;
+  net::SpdyHeaderBlock request;
+  MakeRequestHeaders("/a", &request);
+  EXPECT_TRUE(cache_.Lookup(request, now_, &result));
+  MakeRequestHeaders("/b", &request);
+  EXPECT_FALSE(cache_.Lookup(request, now_, &result));
+  MakeRequestHeaders("/k", &request);
+  EXPECT_TRUE(cache_.Lookup(request, now_, &result));
+}
+
+// Test that a Recorder stores a response only once it is complete.
+TEST_F(PushResponseCacheTest, Recorder) {
+  net::SpdyHeaderBlock request;
+  MakeRequestHeaders("/recorded.css", &request);
+  PushResponseCache::Response response;
+  MakeResponse("", &response);
+
+  scoped_ptr<PushResponseCache::Recorder> recorder(
+      cache_.NewRecorder(request));
+  ASSERT_TRUE(recorder.get() != NULL);
+  recorder->OnHeaders(response.headers, false);
+  recorder->OnData("foo", false);
+  EXPECT_EQ(0u, cache_.num_entries());
+  recorder->OnData("bar", true);
+  EXPECT_EQ(1u, cache_.num_entries());
+
+  PushResponseCache::Response result;
+  ASSERT_TRUE(cache_.Lookup(request, base::TimeTicks::Now(), &result));
+  EXPECT_EQ("foobar", result.body);
+
+  // A response that outgrows the maximum entry size is never stored.
+  MakeRequestHeaders("/huge.css", &request);
+  recorder.reset(cache_.NewRecorder(request));
+  recorder->OnHeaders(response.headers, false);
+  recorder->OnData(std::string(600, 'x'), false);
+  recorder->OnData(std::string(600, 'x'), true);
+  EXPECT_EQ(1u, cache_.num_entries());
+}
+
+// Test matching conditional requests against a cached response's validators.
+TEST_F(PushResponseCacheTest, NotModified) {
+  PushResponseCache::Response response;
+  MakeResponse("body { color: red }", &response);
+  response.headers[mod_spdy::http::kLastModified] =
+      "Tue, 01 Apr 2014 12:00:00 GMT";
+  net::SpdyHeaderBlock request;
+  MakeRequestHeaders("/style.css", &request);
+  EXPECT_FALSE(PushResponseCache::IsNotModified(request, response.headers));
+
+  request[mod_spdy::http::kIfNoneMatch] = "\"xyz\", W/\"abc123\"";
+  EXPECT_TRUE(PushResponseCache::IsNotModified(request, response.headers));
+  request[mod_spdy::http::kIfNoneMatch] = "\"ABC123\"";
+  EXPECT_FALSE(PushResponseCache::IsNotModified(request, response.headers));
+  request[mod_spdy::http::kIfNoneMatch] = "*";
+  EXPECT_TRUE(PushResponseCache::IsNotModified(request, response.headers));
+
+  // If-Modified-Since only counts in the absence of If-None-Match.
+  request[mod_spdy::http::kIfNoneMatch] = "\"xyz\"";
+  request[mod_spdy::http::kIfModifiedSince] = "Tue, 01 Apr 2014 12:00:00 GMT";
+  EXPECT_FALSE(PushResponseCache::IsNotModified(request, response.headers));
+  request.erase(mod_spdy::http::kIfNoneMatch);
+  EXPECT_TRUE(PushResponseCache::IsNotModified(request, response.headers));
+  request[mod_spdy::http::kIfModifiedSince] = "Mon, 31 Mar 2014 12:00:00 GMT";
+  EXPECT_FALSE(PushResponseCache::IsNotModified(request, response.headers));
+}
+
+}  // namespace
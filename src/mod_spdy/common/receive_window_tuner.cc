@@ -0,0 +1,151 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/receive_window_tuner.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace mod_spdy {
+
+ReceiveWindowBudget* ReceiveWindowBudget::g_instance = NULL;
+
+ReceiveWindowBudget::ReceiveWindowBudget(int64 limit_bytes)
+    : limit_bytes_(limit_bytes),
+      lock_("ReceiveWindowBudget::lock_"),
+      reserved_bytes_(0) {
+  DCHECK_GE(limit_bytes_, 0);
+}
+
+ReceiveWindowBudget::~ReceiveWindowBudget() {
+  DCHECK_EQ(0, reserved_bytes_);
+}
+
+void ReceiveWindowBudget::CreateInstance(int64 limit_bytes) {
+  DCHECK(g_instance == NULL);
+  g_instance = new ReceiveWindowBudget(limit_bytes);
+}
+
+void ReceiveWindowBudget::DestroyInstance() {
+  DCHECK(g_instance != NULL);
+  ReceiveWindowBudget* instance = g_instance;
+  g_instance = NULL;
+  delete instance;
+}
+
+bool ReceiveWindowBudget::TryReserve(int32 bytes) {
+  DCHECK_GT(bytes, 0);
+  ProfiledAutoLock autolock(lock_);
+  if (reserved_bytes_ + bytes > limit_bytes_) {
+    return false;
+  }
+  reserved_bytes_ += bytes;
+  return true;
+}
+
+void ReceiveWindowBudget::Release(int32 bytes) {
+  DCHECK_GE(bytes, 0);
+  ProfiledAutoLock autolock(lock_);
+  reserved_bytes_ -= bytes;
+  DCHECK_GE(reserved_bytes_, 0);
+}
+
+bool ReceiveWindowBudget::under_pressure() const {
+  ProfiledAutoLock autolock(lock_);
+  return reserved_bytes_ > limit_bytes_ / 4 * 3;
+}
+
+int64 ReceiveWindowBudget::reserved_bytes() const {
+  ProfiledAutoLock autolock(lock_);
+  return reserved_bytes_;
+}
+
+ReceiveWindowTuner::ReceiveWindowTuner(int32 initial_window_size,
+                                       int32 max_window_size,
+                                       ReceiveWindowBudget* budget)
+    : initial_window_size_(initial_window_size),
+      max_window_size_(std::max(initial_window_size, max_window_size)),
+      budget_(budget),
+      window_size_(initial_window_size),
+      epoch_bytes_consumed_(0) {
+  DCHECK_GT(initial_window_size_, 0);
+}
+
+ReceiveWindowTuner::~ReceiveWindowTuner() {
+  if (budget_ != NULL) {
+    budget_->Release(window_size_ - initial_window_size_);
+  }
+}
+
+int32 ReceiveWindowTuner::ComputeWindowUpdate(int32 consumed,
+                                              base::TimeDelta rtt,
+                                              base::TimeTicks now) {
+  DCHECK_GT(consumed, 0);
+  DCHECK_LE(consumed, window_size_);
+  if (budget_ == NULL) {
+    return consumed;
+  }
+
+  // If memory is short, give back some of what we've grown by withholding
+  // part of this update.  Withhold at most half of it, so that the client can
+  // still make progress.
+  if (budget_->under_pressure()) {
+    const int32 shrink =
+        std::min(window_size_ - initial_window_size_, consumed / 2);
+    epoch_start_ = now;
+    epoch_bytes_consumed_ = 0;
+    if (shrink <= 0) {
+      return consumed;
+    }
+    window_size_ -= shrink;
+    budget_->Release(shrink);
+    return consumed - shrink;
+  }
+
+  // We can't tell how fast the client could go without knowing the round
+  // trip time, so just (re)start measuring.
+  if (rtt <= base::TimeDelta() || epoch_start_.is_null()) {
+    epoch_start_ = now;
+    epoch_bytes_consumed_ = 0;
+    return consumed;
+  }
+
+  epoch_bytes_consumed_ += consumed;
+  const base::TimeDelta elapsed = now - epoch_start_;
+  if (elapsed < rtt) {
+    return consumed;
+  }
+
+  // Scale what we consumed during this interval to one round trip's worth.
+  // If that's more than half the window, the window is probably what's
+  // limiting the client, so aim for twice that.
+  const int64 consumed_per_rtt = epoch_bytes_consumed_ *
+      rtt.InMicroseconds() / elapsed.InMicroseconds();
+  epoch_start_ = now;
+  epoch_bytes_consumed_ = 0;
+  if (2 * consumed_per_rtt <= static_cast<int64>(window_size_)) {
+    return consumed;
+  }
+  const int64 target = std::min(2 * consumed_per_rtt,
+                                static_cast<int64>(max_window_size_));
+  const int32 growth = static_cast<int32>(target - window_size_);
+  if (growth <= 0 || !budget_->TryReserve(growth)) {
+    return consumed;
+  }
+  window_size_ += growth;
+  return consumed + growth;
+}
+
+}  // namespace mod_spdy
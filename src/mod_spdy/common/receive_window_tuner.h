@@ -0,0 +1,120 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MOD_SPDY_COMMON_RECEIVE_WINDOW_TUNER_H_
+#define MOD_SPDY_COMMON_RECEIVE_WINDOW_TUNER_H_
+
+#include "base/basictypes.h"
+#include "base/time/time.h"
+#include "mod_spdy/common/profiled_lock.h"
+
+namespace mod_spdy {
+
+// Limits how much memory, across all the sessions in a process, may be
+// promised to clients by growing their input flow control windows beyond the
+// initial size.  Each byte of window we grant is a byte the client may send us
+// before we have anywhere to put it, so without a limit a few fast uploads
+// could make us buffer arbitrarily much data.  This class is thread-safe.
+//
+// Window tuning is off unless CreateInstance() has been called.
+class ReceiveWindowBudget {
+ public:
+  explicit ReceiveWindowBudget(int64 limit_bytes);
+  ~ReceiveWindowBudget();
+
+  // Return the process-wide budget, or NULL if there isn't one.
+  static ReceiveWindowBudget* Instance() { return g_instance; }
+
+  // Create the process-wide budget.  This must be called before any sessions
+  // start, and at most once (unless DestroyInstance() is called in between).
+  static void CreateInstance(int64 limit_bytes);
+
+  // Destroy the process-wide budget.  Only for use in tests; in the server,
+  // the instance lives as long as the process does.
+  static void DestroyInstance();
+
+  // Reserve the given number of bytes of window growth.  Returns true on
+  // success, or false (reserving nothing) if that would exceed the limit.
+  bool TryReserve(int32 bytes);
+
+  // Return bytes previously reserved with TryReserve().
+  void Release(int32 bytes);
+
+  // Return true if more than three quarters of the budget is reserved, in
+  // which case windows that have grown should shrink back toward their
+  // initial size.
+  bool under_pressure() const;
+
+  int64 limit_bytes() const { return limit_bytes_; }
+  int64 reserved_bytes() const;
+
+ private:
+  static ReceiveWindowBudget* g_instance;
+
+  const int64 limit_bytes_;
+  mutable ProfiledLock lock_;  // protects reserved_bytes_
+  int64 reserved_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReceiveWindowBudget);
+};
+
+// Decides how big one input flow control window (for a stream, or for the
+// whole session) should be, much as TCP receive buffer auto-tuning does.
+// Once per round trip, it compares how much input the stream consumed with
+// the window size; if the client sent more than half a window's worth, the
+// window is likely what limits the upload rate, so it grows the window to
+// twice the amount consumed (up to the maximum, and as far as the budget
+// allows).  When the budget is under pressure, it shrinks grown windows back
+// toward the initial size instead.
+//
+// SPDY has no way to take back a window that has been granted, so the window
+// grows by sending WINDOW_UPDATE deltas larger than the amount of data
+// consumed, and shrinks by sending smaller ones.  This class is not
+// thread-safe; its owner must serialize calls.
+class ReceiveWindowTuner {
+ public:
+  // The tuner does not take ownership of the budget, which may be NULL to
+  // disable tuning (the window then stays at its initial size).
+  ReceiveWindowTuner(int32 initial_window_size, int32 max_window_size,
+                     ReceiveWindowBudget* budget);
+  // Returns any growth still reserved to the budget.
+  ~ReceiveWindowTuner();
+
+  // Return the current target window size: the amount of data the client may
+  // send us that we haven't yet consumed, plus what it has left to send.
+  int32 window_size() const { return window_size_; }
+
+  // Called when the owner is about to send a WINDOW_UPDATE for `consumed`
+  // bytes of input data (which must be positive).  The `rtt` is the round
+  // trip time most recently measured for the connection, or zero if unknown
+  // (in which case the window won't grow).  Returns the delta to put in the
+  // WINDOW_UPDATE, which is always positive, and adjusts window_size()
+  // accordingly.
+  int32 ComputeWindowUpdate(int32 consumed, base::TimeDelta rtt,
+                            base::TimeTicks now);
+
+ private:
+  const int32 initial_window_size_;
+  const int32 max_window_size_;
+  ReceiveWindowBudget* const budget_;
+  int32 window_size_;
+  base::TimeTicks epoch_start_;  // start of the current measurement interval
+  int64 epoch_bytes_consumed_;   // bytes consumed since epoch_start_
+
+  DISALLOW_COPY_AND_ASSIGN(ReceiveWindowTuner);
+};
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_RECEIVE_WINDOW_TUNER_H_
@@ -0,0 +1,127 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/receive_window_tuner.h"
+
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const int32 kInitialWindow = 65536;
+const int32 kMaxWindow = 1048576;
+
+base::TimeDelta Millis(int64 ms) {
+  return base::TimeDelta::FromMilliseconds(ms);
+}
+
+TEST(ReceiveWindowTunerTest, NoBudgetMeansNoTuning) {
+  mod_spdy::ReceiveWindowTuner tuner(kInitialWindow, kMaxWindow, NULL);
+  const base::TimeTicks start = base::TimeTicks::Now();
+  EXPECT_EQ(8192, tuner.ComputeWindowUpdate(8192, Millis(100), start));
+  EXPECT_EQ(60000, tuner.ComputeWindowUpdate(
+      60000, Millis(100), start + Millis(100)));
+  EXPECT_EQ(kInitialWindow, tuner.window_size());
+}
+
+TEST(ReceiveWindowTunerTest, GrowsWhenWindowLimitsClient) {
+  mod_spdy::ReceiveWindowBudget budget(10 * kMaxWindow);
+  {
+    mod_spdy::ReceiveWindowTuner tuner(kInitialWindow, kMaxWindow, &budget);
+    const base::TimeTicks start = base::TimeTicks::Now();
+    // The first update just starts the measurement.
+    EXPECT_EQ(8192, tuner.ComputeWindowUpdate(8192, Millis(100), start));
+    // Nearly a whole window consumed in one round trip: grow to twice that.
+    EXPECT_EQ(60000 + 120000 - kInitialWindow, tuner.ComputeWindowUpdate(
+        60000, Millis(100), start + Millis(100)));
+    EXPECT_EQ(120000, tuner.window_size());
+    EXPECT_EQ(120000 - kInitialWindow, budget.reserved_bytes());
+    // The same rate over two round trips is only half a window per round
+    // trip, which is fine.
+    EXPECT_EQ(60000, tuner.ComputeWindowUpdate(
+        60000, Millis(100), start + Millis(300)));
+    EXPECT_EQ(120000, tuner.window_size());
+  }
+  // Growth is returned to the budget when the stream goes away.
+  EXPECT_EQ(0, budget.reserved_bytes());
+}
+
+TEST(ReceiveWindowTunerTest, NoGrowthWithoutRoundTripTime) {
+  mod_spdy::ReceiveWindowBudget budget(10 * kMaxWindow);
+  mod_spdy::ReceiveWindowTuner tuner(kInitialWindow, kMaxWindow, &budget);
+  const base::TimeTicks start = base::TimeTicks::Now();
+  EXPECT_EQ(8192, tuner.ComputeWindowUpdate(8192, base::TimeDelta(), start));
+  EXPECT_EQ(60000, tuner.ComputeWindowUpdate(
+      60000, base::TimeDelta(), start + Millis(100)));
+  EXPECT_EQ(kInitialWindow, tuner.window_size());
+}
+
+TEST(ReceiveWindowTunerTest, GrowthLimitedByMaxAndBudget) {
+  mod_spdy::ReceiveWindowBudget budget(90000);
+  mod_spdy::ReceiveWindowTuner tuner1(kInitialWindow, 100000, &budget);
+  mod_spdy::ReceiveWindowTuner tuner2(kInitialWindow, kMaxWindow, &budget);
+  const base::TimeTicks start = base::TimeTicks::Now();
+  tuner1.ComputeWindowUpdate(8192, Millis(10), start);
+  tuner2.ComputeWindowUpdate(8192, Millis(10), start);
+
+  // Capped at tuner1's maximum.
+  EXPECT_EQ(65536 + 100000 - kInitialWindow, tuner1.ComputeWindowUpdate(
+      65536, Millis(10), start + Millis(10)));
+  EXPECT_EQ(100000, tuner1.window_size());
+
+  // Not enough budget left for tuner2 to double.
+  EXPECT_EQ(65536, tuner2.ComputeWindowUpdate(
+      65536, Millis(10), start + Millis(10)));
+  EXPECT_EQ(kInitialWindow, tuner2.window_size());
+  EXPECT_EQ(100000 - kInitialWindow, budget.reserved_bytes());
+}
+
+TEST(ReceiveWindowTunerTest, ShrinksUnderPressure) {
+  mod_spdy::ReceiveWindowBudget budget(70000);
+  mod_spdy::ReceiveWindowTuner tuner(kInitialWindow, kMaxWindow, &budget);
+  const base::TimeTicks start = base::TimeTicks::Now();
+  tuner.ComputeWindowUpdate(8192, Millis(100), start);
+  EXPECT_EQ(60000 + 120000 - kInitialWindow, tuner.ComputeWindowUpdate(
+      60000, Millis(100), start + Millis(100)));
+  EXPECT_TRUE(budget.under_pressure());
+
+  // A window that hasn't grown never shrinks below its initial size.
+  mod_spdy::ReceiveWindowTuner other(kInitialWindow, kMaxWindow, &budget);
+  EXPECT_EQ(30000, other.ComputeWindowUpdate(30000, Millis(100), start));
+  EXPECT_EQ(kInitialWindow, other.window_size());
+
+  // Withhold up to half of each update until the budget recovers.
+  EXPECT_EQ(10000, tuner.ComputeWindowUpdate(
+      20000, Millis(100), start + Millis(110)));
+  EXPECT_EQ(110000, tuner.window_size());
+  EXPECT_EQ(110000 - kInitialWindow, budget.reserved_bytes());
+  EXPECT_FALSE(budget.under_pressure());
+  EXPECT_EQ(30000, tuner.ComputeWindowUpdate(
+      30000, Millis(100), start + Millis(120)));
+  EXPECT_EQ(110000, tuner.window_size());
+}
+
+TEST(ReceiveWindowBudgetTest, ReserveAndRelease) {
+  mod_spdy::ReceiveWindowBudget budget(1000);
+  EXPECT_TRUE(budget.TryReserve(600));
+  EXPECT_FALSE(budget.under_pressure());
+  EXPECT_FALSE(budget.TryReserve(500));
+  EXPECT_TRUE(budget.TryReserve(400));
+  EXPECT_TRUE(budget.under_pressure());
+  EXPECT_EQ(1000, budget.reserved_bytes());
+  budget.Release(1000);
+  EXPECT_EQ(0, budget.reserved_bytes());
+}
+
+}  // namespace
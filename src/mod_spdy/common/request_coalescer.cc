@@ -0,0 +1,303 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mod_spdy/common/request_coalescer.h"
+
+#include <set>
+#include <string>
+#include <utility>
+
+#include "base/logging.h"
+#include "base/strings/string_piece.h"
+#include "mod_spdy/common/profiled_lock.h"
+#include "mod_spdy/common/protocol_util.h"
+#include "mod_spdy/common/push_response_cache.h"
+#include "net/instaweb/util/public/function.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace {
+
+// A request for part of a resource can't share a response with a request for
+// the whole thing, so we leave range requests alone entirely.
+bool IsRangeRequest(const net::SpdyHeaderBlock& request_headers) {
+  return (request_headers.count(mod_spdy::http::kRange) > 0 ||
+          request_headers.count(mod_spdy::http::kIfRange) > 0);
+}
+
+size_t HeaderBlockSize(const net::SpdyHeaderBlock& headers) {
+  size_t size = 0;
+  for (net::SpdyHeaderBlock::const_iterator iter = headers.begin();
+       iter != headers.end(); ++iter) {
+    size += iter->first.size() + iter->second.size();
+  }
+  return size;
+}
+
+}  // namespace
+
+namespace mod_spdy {
+
+struct RequestCoalescer::Entry {
+  enum State { IN_FLIGHT, COMPLETE, FAILED };
+
+  std::string url;
+  net::SpdyHeaderBlock request_headers;  // the leader's request
+  State state;
+  // The response headers are filled in as soon as the leader sends them, and
+  // the body once the response is complete.  Once the state is COMPLETE, the
+  // response no longer changes, so followers may read it without the lock.
+  bool has_response_headers;
+  Response response;
+  int refcount;  // the leader's Recorder (until it finishes) and followers
+  // Followers whose callbacks should be run when the entry finishes.
+  std::set<Follower*> waiting_followers;
+};
+
+RequestCoalescer::RequestCoalescer(size_t max_response_bytes)
+    : max_response_bytes_(max_response_bytes),
+      lock_("RequestCoalescer::lock_") {}
+
+RequestCoalescer::~RequestCoalescer() {
+  // All Recorders and Followers must have been deleted by now, and each entry
+  // leaves the map once its Recorder is done with it.
+  DCHECK(entries_.empty());
+}
+
+RequestCoalescer::Follower* RequestCoalescer::Join(
+    const net::SpdyHeaderBlock& request_headers, Recorder** recorder) {
+  *recorder = NULL;
+  std::string url;
+  if (!PushResponseCache::GetCacheKey(request_headers, &url) ||
+      IsRangeRequest(request_headers)) {
+    return NULL;
+  }
+
+  ProfiledAutoLock autolock(lock_);
+  const EntryMap::const_iterator iter = entries_.find(url);
+  if (iter != entries_.end()) {
+    Entry* entry = iter->second;
+    DCHECK_EQ(Entry::IN_FLIGHT, entry->state);
+    // If the leader's response headers are already in, we can tell right away
+    // whether the response will be any use to this request; if it won't,
+    // send this request through Apache in parallel, as normal.
+    if (entry->has_response_headers &&
+        !PushResponseCache::CanShareResponse(entry->request_headers,
+                                             entry->response.headers,
+                                             request_headers)) {
+      return NULL;
+    }
+    ++entry->refcount;
+    VLOG(3) << "Coalescing request for " << url
+            << " with the one already in flight";
+    return new Follower(this, entry, request_headers);
+  }
+
+  Entry* entry = new Entry;
+  entry->url = url;
+  entry->request_headers = request_headers;
+  entry->state = Entry::IN_FLIGHT;
+  entry->has_response_headers = false;
+  entry->refcount = 1;
+  entries_.insert(std::make_pair(url, entry));
+  *recorder = new Recorder(this, entry);
+  return NULL;
+}
+
+size_t RequestCoalescer::num_leaders() const {
+  ProfiledAutoLock autolock(lock_);
+  return entries_.size();
+}
+
+void RequestCoalescer::FinishEntry(Entry* entry, bool complete,
+                                   CallbackList* callbacks) {
+  lock_.AssertAcquired();
+  DCHECK_EQ(Entry::IN_FLIGHT, entry->state);
+  entry->state = complete ? Entry::COMPLETE : Entry::FAILED;
+  if (!complete) {
+    entry->response.headers.clear();
+    entry->response.body.clear();
+  }
+  const EntryMap::iterator iter = entries_.find(entry->url);
+  DCHECK(iter != entries_.end());
+  DCHECK_EQ(entry, iter->second);
+  entries_.erase(iter);
+  for (std::set<Follower*>::const_iterator follower_iter =
+           entry->waiting_followers.begin();
+       follower_iter != entry->waiting_followers.end(); ++follower_iter) {
+    Follower* follower = *follower_iter;
+    DCHECK(follower->callback_ != NULL);
+    callbacks->push_back(follower->callback_);
+    follower->callback_ = NULL;
+  }
+  entry->waiting_followers.clear();
+}
+
+void RequestCoalescer::ReleaseEntry(Entry* entry) {
+  lock_.AssertAcquired();
+  DCHECK_GT(entry->refcount, 0);
+  if (--entry->refcount == 0) {
+    DCHECK_NE(Entry::IN_FLIGHT, entry->state);
+    delete entry;
+  }
+}
+
+RequestCoalescer::Recorder::Recorder(RequestCoalescer* coalescer,
+                                     Entry* entry)
+    : coalescer_(coalescer),
+      entry_(entry),
+      received_headers_(false) {
+  DCHECK(coalescer_);
+  DCHECK(entry_);
+}
+
+RequestCoalescer::Recorder::~Recorder() {
+  // If the leader never finished its response (e.g. because its stream was
+  // aborted), its followers will have to make their own requests.
+  if (entry_ != NULL) {
+    Finish(false);
+  }
+}
+
+void RequestCoalescer::Recorder::OnHeaders(
+    const net::SpdyHeaderBlock& headers, bool flag_fin) {
+  if (entry_ == NULL) {
+    return;
+  }
+  // We don't bother sharing responses with trailing headers.
+  if (received_headers_) {
+    Finish(false);
+    return;
+  }
+  received_headers_ = true;
+  // Give up early on responses that can't be shared, so that the followers
+  // needn't wait for the whole thing.
+  if (!PushResponseCache::CanShareResponse(entry_->request_headers, headers,
+                                           entry_->request_headers) ||
+      HeaderBlockSize(headers) > coalescer_->max_response_bytes_) {
+    Finish(false);
+    return;
+  }
+  {
+    ProfiledAutoLock autolock(coalescer_->lock_);
+    entry_->response.headers = headers;
+    entry_->has_response_headers = true;
+  }
+  if (flag_fin) {
+    Finish(true);
+  }
+}
+
+void RequestCoalescer::Recorder::OnData(base::StringPiece data,
+                                        bool flag_fin) {
+  if (entry_ == NULL) {
+    return;
+  }
+  // Since entry_->response.headers is only written by this thread, we can
+  // read it without the lock.
+  if (!received_headers_ ||
+      HeaderBlockSize(entry_->response.headers) + body_.size() + data.size() >
+      coalescer_->max_response_bytes_) {
+    Finish(false);
+    return;
+  }
+  data.AppendToString(&body_);
+  if (flag_fin) {
+    Finish(true);
+  }
+}
+
+void RequestCoalescer::Recorder::Finish(bool complete) {
+  DCHECK(entry_ != NULL);
+  CallbackList callbacks;
+  {
+    ProfiledAutoLock autolock(coalescer_->lock_);
+    if (complete) {
+      entry_->response.body.swap(body_);
+    }
+    VLOG(3) << (complete ? "Sharing" : "Not sharing") << " response for "
+            << entry_->url;
+    coalescer_->FinishEntry(entry_, complete, &callbacks);
+    coalescer_->ReleaseEntry(entry_);
+  }
+  entry_ = NULL;
+  body_.clear();
+  // Run the callbacks without holding the lock, since they may well delete
+  // their followers.
+  for (CallbackList::const_iterator iter = callbacks.begin();
+       iter != callbacks.end(); ++iter) {
+    (*iter)->CallRun();
+  }
+}
+
+RequestCoalescer::Follower::Follower(
+    RequestCoalescer* coalescer, Entry* entry,
+    const net::SpdyHeaderBlock& request_headers)
+    : coalescer_(coalescer),
+      entry_(entry),
+      request_headers_(request_headers),
+      callback_(NULL) {
+  DCHECK(coalescer_);
+  DCHECK(entry_);
+}
+
+RequestCoalescer::Follower::~Follower() {
+  net_instaweb::Function* callback = NULL;
+  {
+    ProfiledAutoLock autolock(coalescer_->lock_);
+    if (callback_ != NULL) {
+      entry_->waiting_followers.erase(this);
+      callback = callback_;
+      callback_ = NULL;
+    }
+    coalescer_->ReleaseEntry(entry_);
+  }
+  if (callback != NULL) {
+    callback->CallCancel();
+  }
+}
+
+bool RequestCoalescer::Follower::NotifyWhenDone(
+    net_instaweb::Function* callback) {
+  DCHECK(callback != NULL);
+  ProfiledAutoLock autolock(coalescer_->lock_);
+  DCHECK(callback_ == NULL);
+  if (entry_->state != Entry::IN_FLIGHT) {
+    return false;
+  }
+  callback_ = callback;
+  entry_->waiting_followers.insert(this);
+  return true;
+}
+
+RequestCoalescer::Follower::Status RequestCoalescer::Follower::status()
+    const {
+  ProfiledAutoLock autolock(coalescer_->lock_);
+  switch (entry_->state) {
+    case Entry::IN_FLIGHT:
+      return PENDING;
+    case Entry::COMPLETE:
+      return (PushResponseCache::CanShareResponse(
+                  entry_->request_headers, entry_->response.headers,
+                  request_headers_) ? READY : UNAVAILABLE);
+    default:
+      return UNAVAILABLE;
+  }
+}
+
+const RequestCoalescer::Response& RequestCoalescer::Follower::response()
+    const {
+  DCHECK_EQ(Entry::COMPLETE, entry_->state);
+  return entry_->response;
+}
+
+}  // namespace mod_spdy
@@ -0,0 +1,176 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MOD_SPDY_COMMON_REQUEST_COALESCER_H_
+#define MOD_SPDY_COMMON_REQUEST_COALESCER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+#include "mod_spdy/common/profiled_lock.h"
+#include "mod_spdy/common/push_response_cache.h"
+#include "net/instaweb/util/public/function.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace mod_spdy {
+
+// Collapses identical, concurrent GET requests -- whether on one session or
+// on several -- into a single request through Apache.  The first request for
+// a URL becomes the leader, and its response is recorded as it is sent; any
+// duplicates that arrive while it is still in flight become followers, which
+// are notified once the leader's response is done and then send a copy of it.
+// Followers don't tie up a thread while they wait.  A follower only
+// uses the leader's response if that response could have been stored in a
+// shared cache (see PushResponseCache::CanShareResponse), and if the follower
+// agrees with the leader on every request header named by the response's
+// Vary header; otherwise (or if the response turns out to be too large, or
+// the leader fails), the follower is told to make its own request after all.
+//
+// This should be created during per-process initialization.  This class is
+// thread-safe.
+class RequestCoalescer {
+ private:
+  struct Entry;  // one in-flight request, shared by its leader and followers
+
+ public:
+  typedef PushResponseCache::Response Response;
+
+  // Collects the response headers and data sent on the leader's stream, and
+  // hands the response to the followers once it is complete.  If the
+  // Recorder is deleted before that, the followers are told that there will
+  // be no response to share.  Either way, the followers' callbacks (see
+  // Follower::NotifyWhenDone) are run on the leader's stream thread.  This
+  // class is not thread-safe; it is meant to be used by the leader's stream
+  // thread.
+  class Recorder {
+   public:
+    ~Recorder();
+
+    // Record the response headers or a chunk of response body, respectively.
+    // When flag_fin is true, the response is complete.
+    void OnHeaders(const net::SpdyHeaderBlock& headers, bool flag_fin);
+    void OnData(base::StringPiece data, bool flag_fin);
+
+   private:
+    friend class RequestCoalescer;
+
+    Recorder(RequestCoalescer* coalescer, Entry* entry);
+    // Finish recording, publishing the body if complete is true, and release
+    // the entry.
+    void Finish(bool complete);
+
+    RequestCoalescer* const coalescer_;
+    Entry* entry_;  // NULL once we've finished
+    bool received_headers_;
+    std::string body_;
+
+    DISALLOW_COPY_AND_ASSIGN(Recorder);
+  };
+
+  // A request waiting on the leader's response.  This class is not
+  // thread-safe; it is meant to be used by whichever thread currently owns
+  // the follower's stream.
+  class Follower {
+   public:
+    enum Status {
+      PENDING,      // the leader's response is not yet complete
+      READY,        // the leader's response is available from response()
+      UNAVAILABLE   // there won't be a response this request can use
+    };
+
+    // If the callback passed to NotifyWhenDone() hasn't been run yet, it is
+    // cancelled.
+    ~Follower();
+
+    // If the leader's response is still pending, arrange for the callback to
+    // be run once it is done (that is, once status() no longer returns
+    // PENDING), and return true; the Follower takes ownership of the
+    // callback, and will cancel it if deleted first.  The callback is run
+    // on the leader's stream thread, and must not block.  If the leader's
+    // response is already done, return false, and leave the callback to the
+    // caller.  This may be called at most once.
+    bool NotifyWhenDone(net_instaweb::Function* callback);
+
+    // Report whether the leader's response is complete and can be used for
+    // this request.  This never blocks.
+    Status status() const;
+
+    // Get the leader's response.  Requires that status() has returned READY;
+    // the response stays valid until the Follower is deleted.
+    const Response& response() const;
+
+   private:
+    friend class RequestCoalescer;
+
+    Follower(RequestCoalescer* coalescer, Entry* entry,
+             const net::SpdyHeaderBlock& request_headers);
+
+    RequestCoalescer* const coalescer_;
+    Entry* const entry_;
+    const net::SpdyHeaderBlock request_headers_;
+    // Run once the leader is done; protected by the coalescer's lock_.
+    net_instaweb::Function* callback_;
+
+    DISALLOW_COPY_AND_ASSIGN(Follower);
+  };
+
+  // Create a coalescer that shares responses of at most max_response_bytes
+  // (headers plus body).
+  explicit RequestCoalescer(size_t max_response_bytes);
+  ~RequestCoalescer();
+
+  size_t max_response_bytes() const { return max_response_bytes_; }
+
+  // Register a new request with the given headers, which must not have a
+  // body.  If an identical request is already in flight, return a new
+  // Follower for it.  Otherwise, return NULL; in that case, if responses to
+  // this request might be shared, this request becomes the leader for its
+  // URL, and *recorder is set to a new Recorder for its response (else
+  // *recorder is set to NULL).  The caller takes ownership of whichever
+  // object is returned.
+  Follower* Join(const net::SpdyHeaderBlock& request_headers,
+                 Recorder** recorder);
+
+  // Get the number of requests currently in flight as leaders.  This is
+  // mostly useful for debugging and testing.
+  size_t num_leaders() const;
+
+ private:
+  friend class Follower;
+  friend class Recorder;
+  typedef std::map<std::string, Entry*> EntryMap;
+  typedef std::vector<net_instaweb::Function*> CallbackList;
+
+  // Mark the entry as finished and take it out of entries_, so that no more
+  // followers can join it.  The callbacks of the followers waiting on it are
+  // moved to *callbacks; the caller must run them after releasing lock_.
+  // Caller must be holding lock_.
+  void FinishEntry(Entry* entry, bool complete, CallbackList* callbacks);
+  // Drop a reference to the entry, deleting it once the last one is gone.
+  // Caller must be holding lock_.
+  void ReleaseEntry(Entry* entry);
+
+  const size_t max_response_bytes_;
+
+  mutable ProfiledLock lock_;
+  EntryMap entries_;  // in-flight leaders, keyed by URL
+
+  DISALLOW_COPY_AND_ASSIGN(RequestCoalescer);
+};
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_REQUEST_COALESCER_H_
@@ -0,0 +1,279 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mod_spdy/common/request_coalescer.h"
+
+#include <string>
+
+#include "base/memory/scoped_ptr.h"
+#include "mod_spdy/common/protocol_util.h"
+#include "net/instaweb/util/public/function.h"
+#include "net/spdy/spdy_protocol.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+using mod_spdy::RequestCoalescer;
+
+void MakeRequestHeaders(const std::string& path,
+                        net::SpdyHeaderBlock* headers) {
+  (*headers)[mod_spdy::spdy::kSpdy3Host] = "www.example.com";
+  (*headers)[mod_spdy::spdy::kSpdy3Method] = "GET";
+  (*headers)[mod_spdy::spdy::kSpdy3Path] = path;
+  (*headers)[mod_spdy::spdy::kSpdy3Scheme] = "https";
+  (*headers)[mod_spdy::spdy::kSpdy3Version] = "HTTP/1.1";
+}
+
+void MakeResponseHeaders(net::SpdyHeaderBlock* headers) {
+  (*headers)[mod_spdy::spdy::kSpdy3Status] = "200";
+  (*headers)[mod_spdy::spdy::kSpdy3Version] = "HTTP/1.1";
+  (*headers)[mod_spdy::http::kContentType] = "text/css";
+  (*headers)[mod_spdy::http::kETag] = "\"abc123\"";
+  (*headers)[mod_spdy::http::kCacheControl] = "public, max-age=60";
+}
+
+// Counts how many times it is run or cancelled.
+class CountingFunction : public net_instaweb::Function {
+ public:
+  CountingFunction(int* num_runs, int* num_cancels)
+      : num_runs_(num_runs), num_cancels_(num_cancels) {}
+  virtual ~CountingFunction() {}
+
+ protected:
+  virtual void Run() { ++*num_runs_; }
+  virtual void Cancel() { ++*num_cancels_; }
+
+ private:
+  int* const num_runs_;
+  int* const num_cancels_;
+
+  DISALLOW_COPY_AND_ASSIGN(CountingFunction);
+};
+
+class RequestCoalescerTest : public testing::Test {
+ public:
+  RequestCoalescerTest() : coalescer_(1000) {}
+
+ protected:
+  // Register a request, expecting it to become the leader.
+  RequestCoalescer::Recorder* Lead(const net::SpdyHeaderBlock& request) {
+    RequestCoalescer::Recorder* recorder = NULL;
+    scoped_ptr<RequestCoalescer::Follower> follower(
+        coalescer_.Join(request, &recorder));
+    EXPECT_TRUE(follower.get() == NULL);
+    EXPECT_TRUE(recorder != NULL);
+    return recorder;
+  }
+
+  // Register a request, expecting it to become a follower.
+  RequestCoalescer::Follower* Follow(const net::SpdyHeaderBlock& request) {
+    RequestCoalescer::Recorder* recorder = NULL;
+    RequestCoalescer::Follower* follower = coalescer_.Join(request, &recorder);
+    EXPECT_TRUE(follower != NULL);
+    EXPECT_TRUE(recorder == NULL);
+    return follower;
+  }
+
+  RequestCoalescer coalescer_;
+};
+
+// Test that a duplicate request gets a copy of the leader's response, and
+// that a request arriving after the leader has finished leads anew.
+TEST_F(RequestCoalescerTest, ShareResponse) {
+  net::SpdyHeaderBlock request;
+  MakeRequestHeaders("/style.css", &request);
+  scoped_ptr<RequestCoalescer::Recorder> recorder(Lead(request));
+  EXPECT_EQ(1u, coalescer_.num_leaders());
+  scoped_ptr<RequestCoalescer::Follower> follower(Follow(request));
+  EXPECT_EQ(RequestCoalescer::Follower::PENDING, follower->status());
+
+  net::SpdyHeaderBlock response_headers;
+  MakeResponseHeaders(&response_headers);
+  recorder->OnHeaders(response_headers, false);
+  recorder->OnData("body { ", false);
+  EXPECT_EQ(RequestCoalescer::Follower::PENDING, follower->status());
+  recorder->OnData("color: red }", true);
+  EXPECT_EQ(0u, coalescer_.num_leaders());
+
+  ASSERT_EQ(RequestCoalescer::Follower::READY, follower->status());
+  EXPECT_EQ("body { color: red }", follower->response().body);
+  EXPECT_EQ("text/css",
+            follower->response().headers.find(
+                mod_spdy::http::kContentType)->second);
+
+  // The follower keeps the response alive even once the leader is gone.
+  recorder.reset();
+  EXPECT_EQ("body { color: red }", follower->response().body);
+
+  scoped_ptr<RequestCoalescer::Recorder> recorder2(Lead(request));
+  EXPECT_EQ(1u, coalescer_.num_leaders());
+}
+
+
+// Test that followers' callbacks are run when the leader finishes, and
+// cancelled if the follower goes away first.
+TEST_F(RequestCoalescerTest, NotifyWhenDone) {
+  net::SpdyHeaderBlock request;
+  MakeRequestHeaders("/style.css", &request);
+  scoped_ptr<RequestCoalescer::Recorder> recorder(Lead(request));
+  scoped_ptr<RequestCoalescer::Follower> follower1(Follow(request));
+  scoped_ptr<RequestCoalescer::Follower> follower2(Follow(request));
+  scoped_ptr<RequestCoalescer::Follower> follower3(Follow(request));
+
+  int num_runs = 0, num_cancels = 0;
+  EXPECT_TRUE(follower1->NotifyWhenDone(
+      new CountingFunction(&num_runs, &num_cancels)));
+  EXPECT_TRUE(follower2->NotifyWhenDone(
+      new CountingFunction(&num_runs, &num_cancels)));
+  follower2.reset();
+  EXPECT_EQ(0, num_runs);
+  EXPECT_EQ(1, num_cancels);
+
+  net::SpdyHeaderBlock response_headers;
+  MakeResponseHeaders(&response_headers);
+  recorder->OnHeaders(response_headers, false);
+  EXPECT_EQ(0, num_runs);
+  recorder->OnData("body { color: red }", true);
+  EXPECT_EQ(1, num_runs);
+  EXPECT_EQ(1, num_cancels);
+  EXPECT_EQ(RequestCoalescer::Follower::READY, follower1->status());
+
+  // Once the leader is done, the callback is left to the caller.
+  CountingFunction late_callback(&num_runs, &num_cancels);
+  EXPECT_FALSE(follower3->NotifyWhenDone(&late_callback));
+  EXPECT_EQ(RequestCoalescer::Follower::READY, follower3->status());
+  follower3.reset();
+  EXPECT_EQ(1, num_runs);
+  EXPECT_EQ(1, num_cancels);
+}
+
+// Test that followers' callbacks are run if the leader gives up.
+TEST_F(RequestCoalescerTest, NotifyWhenLeaderFails) {
+  net::SpdyHeaderBlock request;
+  MakeRequestHeaders("/style.css", &request);
+  scoped_ptr<RequestCoalescer::Recorder> recorder(Lead(request));
+  scoped_ptr<RequestCoalescer::Follower> follower(Follow(request));
+  int num_runs = 0, num_cancels = 0;
+  EXPECT_TRUE(follower->NotifyWhenDone(
+      new CountingFunction(&num_runs, &num_cancels)));
+  recorder.reset();
+  EXPECT_EQ(1, num_runs);
+  EXPECT_EQ(0, num_cancels);
+  EXPECT_EQ(RequestCoalescer::Follower::UNAVAILABLE, follower->status());
+}
+
+// Test which requests may be coalesced at all.
+TEST_F(RequestCoalescerTest, UncoalescibleRequests) {
+  net::SpdyHeaderBlock request;
+  MakeRequestHeaders("/style.css", &request);
+  RequestCoalescer::Recorder* recorder = NULL;
+
+  net::SpdyHeaderBlock post(request);
+  post[mod_spdy::spdy::kSpdy3Method] = "POST";
+  EXPECT_TRUE(coalescer_.Join(post, &recorder) == NULL);
+  EXPECT_TRUE(recorder == NULL);
+
+  net::SpdyHeaderBlock authorized(request);
+  authorized[mod_spdy::http::kAuthorization] = "Basic Zm9vOmJhcg==";
+  EXPECT_TRUE(coalescer_.Join(authorized, &recorder) == NULL);
+  EXPECT_TRUE(recorder == NULL);
+
+  scoped_ptr<RequestCoalescer::Recorder> leader(Lead(request));
+  net::SpdyHeaderBlock range(request);
+  range[mod_spdy::http::kRange] = "bytes=0-99";
+  EXPECT_TRUE(coalescer_.Join(range, &recorder) == NULL);
+  EXPECT_TRUE(recorder == NULL);
+
+  // A request for a different URL leads on its own.
+  net::SpdyHeaderBlock other;
+  MakeRequestHeaders("/script.js", &other);
+  scoped_ptr<RequestCoalescer::Recorder> other_leader(Lead(other));
+  EXPECT_EQ(2u, coalescer_.num_leaders());
+}
+
+// Test that followers fall back to making their own requests when the
+// leader's response can't be shared.
+TEST_F(RequestCoalescerTest, UnshareableResponses) {
+  net::SpdyHeaderBlock request;
+  MakeRequestHeaders("/style.css", &request);
+
+  // Uncacheable response: the followers find out as soon as the headers are
+  // sent.
+  {
+    scoped_ptr<RequestCoalescer::Recorder> recorder(Lead(request));
+    scoped_ptr<RequestCoalescer::Follower> follower(Follow(request));
+    net::SpdyHeaderBlock response_headers;
+    MakeResponseHeaders(&response_headers);
+    response_headers[mod_spdy::http::kCacheControl] = "private";
+    recorder->OnHeaders(response_headers, false);
+    EXPECT_EQ(0u, coalescer_.num_leaders());
+    EXPECT_EQ(RequestCoalescer::Follower::UNAVAILABLE, follower->status());
+  }
+
+  // Response too large.
+  {
+    scoped_ptr<RequestCoalescer::Recorder> recorder(Lead(request));
+    scoped_ptr<RequestCoalescer::Follower> follower(Follow(request));
+    net::SpdyHeaderBlock response_headers;
+    MakeResponseHeaders(&response_headers);
+    recorder->OnHeaders(response_headers, false);
+    recorder->OnData(std::string(1000, 'x'), true);
+    EXPECT_EQ(RequestCoalescer::Follower::UNAVAILABLE, follower->status());
+  }
+
+  // The leader goes away without finishing its response.
+  {
+    scoped_ptr<RequestCoalescer::Recorder> recorder(Lead(request));
+    scoped_ptr<RequestCoalescer::Follower> follower(Follow(request));
+    net::SpdyHeaderBlock response_headers;
+    MakeResponseHeaders(&response_headers);
+    recorder->OnHeaders(response_headers, false);
+    recorder->OnData("body {", false);
+    recorder.reset();
+    EXPECT_EQ(RequestCoalescer::Follower::UNAVAILABLE, follower->status());
+  }
+  EXPECT_EQ(0u, coalescer_.num_leaders());
+}
+
+// Test that only followers agreeing with the leader on the headers named by
+// Vary get its response.
+TEST_F(RequestCoalescerTest, Vary) {
+  net::SpdyHeaderBlock gzip_request;
+  MakeRequestHeaders("/style.css", &gzip_request);
+  gzip_request[mod_spdy::http::kAcceptEncoding] = "gzip";
+  net::SpdyHeaderBlock plain_request;
+  MakeRequestHeaders("/style.css", &plain_request);
+
+  scoped_ptr<RequestCoalescer::Recorder> recorder(Lead(gzip_request));
+  // Before the response headers are in, anyone may follow...
+  scoped_ptr<RequestCoalescer::Follower> gzip_follower(Follow(gzip_request));
+  scoped_ptr<RequestCoalescer::Follower> plain_follower(Follow(plain_request));
+
+  net::SpdyHeaderBlock response_headers;
+  MakeResponseHeaders(&response_headers);
+  response_headers[mod_spdy::http::kVary] = "Accept-Encoding";
+  recorder->OnHeaders(response_headers, false);
+
+  // ...but afterwards, requests that couldn't use the response don't.
+  RequestCoalescer::Recorder* plain_recorder = NULL;
+  EXPECT_TRUE(coalescer_.Join(plain_request, &plain_recorder) == NULL);
+  EXPECT_TRUE(plain_recorder == NULL);
+  scoped_ptr<RequestCoalescer::Follower> gzip_follower2(Follow(gzip_request));
+
+  recorder->OnData("compressed", true);
+  EXPECT_EQ(RequestCoalescer::Follower::READY, gzip_follower->status());
+  EXPECT_EQ(RequestCoalescer::Follower::READY, gzip_follower2->status());
+  EXPECT_EQ(RequestCoalescer::Follower::UNAVAILABLE, plain_follower->status());
+}
+
+}  // namespace
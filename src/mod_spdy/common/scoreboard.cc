@@ -0,0 +1,370 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mod_spdy/common/scoreboard.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+#include "base/logging.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+
+namespace {
+
+const uint32 kMagic = 0x53504442;  // "SPDB"
+// Bump this whenever the layout of the file changes.
+const uint32 kVersion = 1;
+const size_t kCacheLineSize = 64;
+
+// The start of the file.  Everything is in native byte order and word size,
+// so the file can only be read by tools built for the same platform as the
+// server; the header lets them check.
+struct Header {
+  uint32 magic;
+  uint32 version;
+  uint32 word_size;
+  uint32 num_counters;
+  uint32 num_processes;
+  uint32 num_sessions;
+};
+
+size_t RoundUpToCacheLine(size_t size) {
+  return (size + kCacheLineSize - 1) / kCacheLineSize * kCacheLineSize;
+}
+
+const size_t kHeaderSize = RoundUpToCacheLine(sizeof(Header));
+
+// Return true if the process is known to have exited.
+bool ProcessIsGone(int pid) {
+  return kill(pid, 0) != 0 && errno == ESRCH;
+}
+
+const char* const kCounterNames[] = {
+  "sessions",
+  "sessions_total",
+  "streams",
+  "streams_total",
+  "bytes_received",
+  "bytes_sent",
+  "output_queue",
+  "threads",
+  "threads_busy",
+  "tasks_queued",
+  "pushes_started",
+  "pushes_cancelled",
+  "stream_window_stalls",
+  "session_window_stalls",
+  "header_bytes_raw",
+  "header_bytes_sent",
+  "header_compression_micros",
+};
+
+}  // namespace
+
+namespace mod_spdy {
+
+COMPILE_ASSERT(arraysize(kCounterNames) == Scoreboard::NUM_COUNTERS,
+               counter_names_must_match_counters);
+
+// The layout of a slot in the file.
+struct Scoreboard::SharedSlot {
+  base::subtle::Atomic32 pid;  // zero if the slot is free
+  base::subtle::Atomic32 generation;
+  base::subtle::AtomicWord start_time;
+  base::subtle::AtomicWord counters[NUM_COUNTERS];
+};
+
+// static
+size_t Scoreboard::SlotSize() {
+  return RoundUpToCacheLine(sizeof(SharedSlot));
+}
+
+const int Scoreboard::kNoSession = -1;
+
+Scoreboard* Scoreboard::g_instance = NULL;
+
+Scoreboard::Slot::Slot()
+    : index(0), pid(0), generation(0), start_time(0) {
+  for (int i = 0; i < NUM_COUNTERS; ++i) {
+    counters[i] = 0;
+  }
+}
+
+// static
+Scoreboard* Scoreboard::Create(const std::string& path, int num_processes,
+                               int num_sessions, std::string* error) {
+  DCHECK_GT(num_processes, 0);
+  DCHECK_GE(num_sessions, 0);
+  const size_t size =
+      kHeaderSize + (num_processes + num_sessions) * SlotSize();
+  const int fd = HANDLE_EINTR(open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC,
+                                   0644));
+  if (fd < 0) {
+    *error = base::StringPrintf("Couldn't create %s: %s", path.c_str(),
+                                strerror(errno));
+    return NULL;
+  }
+  // Extending the file fills it with zeros, which leaves all the slots free.
+  if (HANDLE_EINTR(ftruncate(fd, size)) != 0) {
+    *error = base::StringPrintf("Couldn't resize %s: %s", path.c_str(),
+                                strerror(errno));
+    close(fd);
+    return NULL;
+  }
+  void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    *error = base::StringPrintf("Couldn't map %s: %s", path.c_str(),
+                                strerror(errno));
+    return NULL;
+  }
+  Header* header = static_cast<Header*>(memory);
+  header->version = kVersion;
+  header->word_size = sizeof(base::subtle::AtomicWord);
+  header->num_counters = NUM_COUNTERS;
+  header->num_processes = num_processes;
+  header->num_sessions = num_sessions;
+  // Readers check the magic number last.
+  base::subtle::MemoryBarrier();
+  header->magic = kMagic;
+  return new Scoreboard(static_cast<char*>(memory), size, num_processes,
+                        num_sessions);
+}
+
+// static
+Scoreboard* Scoreboard::Open(const std::string& path, std::string* error) {
+  const int fd = HANDLE_EINTR(open(path.c_str(), O_RDONLY));
+  if (fd < 0) {
+    *error = base::StringPrintf("Couldn't open %s: %s", path.c_str(),
+                                strerror(errno));
+    return NULL;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    *error = base::StringPrintf("Couldn't stat %s: %s", path.c_str(),
+                                strerror(errno));
+    close(fd);
+    return NULL;
+  }
+  const size_t size = info.st_size;
+  if (size < kHeaderSize) {
+    *error = path + " is not a mod_spdy scoreboard";
+    close(fd);
+    return NULL;
+  }
+  void* memory = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    *error = base::StringPrintf("Couldn't map %s: %s", path.c_str(),
+                                strerror(errno));
+    return NULL;
+  }
+  const Header* header = static_cast<const Header*>(memory);
+  if (header->magic != kMagic) {
+    *error = path + " is not a mod_spdy scoreboard";
+  } else if (header->version != kVersion ||
+             header->word_size != sizeof(base::subtle::AtomicWord) ||
+             header->num_counters != NUM_COUNTERS) {
+    *error = path + " was written by an incompatible version of mod_spdy";
+  } else if (kHeaderSize + (static_cast<size_t>(header->num_processes) +
+                            header->num_sessions) * SlotSize() > size) {
+    *error = path + " is truncated";
+  } else {
+    return new Scoreboard(static_cast<char*>(memory), size,
+                          header->num_processes, header->num_sessions);
+  }
+  munmap(memory, size);
+  return NULL;
+}
+
+// static
+bool Scoreboard::CreateInstance(const std::string& path, int num_processes,
+                                int num_sessions, std::string* error) {
+  DCHECK(g_instance == NULL);
+  g_instance = Create(path, num_processes, num_sessions, error);
+  return g_instance != NULL;
+}
+
+// static
+void Scoreboard::DestroyInstance() {
+  DCHECK(g_instance != NULL);
+  Scoreboard* instance = g_instance;
+  g_instance = NULL;
+  delete instance;
+}
+
+Scoreboard::Scoreboard(char* memory, size_t size, int num_processes,
+                       int num_sessions)
+    : memory_(memory),
+      size_(size),
+      num_processes_(num_processes),
+      num_sessions_(num_sessions),
+      process_slot_(NULL),
+      pid_(0),
+      next_session_slot_(0) {}
+
+Scoreboard::~Scoreboard() {
+  munmap(memory_, size_);
+}
+
+bool Scoreboard::AttachProcess() {
+  DCHECK(process_slot_ == NULL);
+  pid_ = getpid();
+  const int index = ClaimSlot(0, num_processes_, 0);
+  if (index < 0) {
+    return false;
+  }
+  process_slot_ = GetSlot(index);
+  return true;
+}
+
+void Scoreboard::DetachProcess() {
+  if (process_slot_ != NULL) {
+    base::subtle::Release_Store(&process_slot_->pid, 0);
+    process_slot_ = NULL;
+  }
+}
+
+int Scoreboard::ClaimSessionSlot() {
+  if (process_slot_ == NULL || num_sessions_ == 0) {
+    return kNoSession;
+  }
+  const int start = static_cast<uint32>(base::subtle::NoBarrier_AtomicIncrement(
+      &next_session_slot_, 1)) % num_sessions_;
+  const int index = ClaimSlot(num_processes_, num_sessions_, start);
+  return index < 0 ? kNoSession : index - num_processes_;
+}
+
+void Scoreboard::ReleaseSessionSlot(int session) {
+  if (session == kNoSession) {
+    return;
+  }
+  DCHECK_GE(session, 0);
+  DCHECK_LT(session, num_sessions_);
+  base::subtle::Release_Store(&GetSlot(num_processes_ + session)->pid, 0);
+}
+
+void Scoreboard::Add(int session, Counter counter, int64 delta) {
+  DCHECK_GE(counter, 0);
+  DCHECK_LT(counter, NUM_COUNTERS);
+  if (process_slot_ == NULL) {
+    return;
+  }
+  base::subtle::NoBarrier_AtomicIncrement(
+      &process_slot_->counters[counter],
+      static_cast<base::subtle::AtomicWord>(delta));
+  if (session != kNoSession) {
+    DCHECK_GE(session, 0);
+    DCHECK_LT(session, num_sessions_);
+    base::subtle::NoBarrier_AtomicIncrement(
+        &GetSlot(num_processes_ + session)->counters[counter],
+        static_cast<base::subtle::AtomicWord>(delta));
+  }
+}
+
+void Scoreboard::Set(Counter counter, int64 value) {
+  DCHECK_GE(counter, 0);
+  DCHECK_LT(counter, NUM_COUNTERS);
+  if (process_slot_ != NULL) {
+    base::subtle::NoBarrier_Store(&process_slot_->counters[counter],
+                                  static_cast<base::subtle::AtomicWord>(value));
+  }
+}
+
+void Scoreboard::GetProcessSlots(std::vector<Slot>* slots) const {
+  GetSlots(0, num_processes_, slots);
+}
+
+void Scoreboard::GetSessionSlots(std::vector<Slot>* slots) const {
+  GetSlots(num_processes_, num_sessions_, slots);
+}
+
+// static
+const char* Scoreboard::GetCounterName(Counter counter) {
+  DCHECK_GE(counter, 0);
+  DCHECK_LT(counter, NUM_COUNTERS);
+  return kCounterNames[counter];
+}
+
+Scoreboard::SharedSlot* Scoreboard::GetSlot(int index) const {
+  DCHECK_GE(index, 0);
+  DCHECK_LT(index, num_processes_ + num_sessions_);
+  return reinterpret_cast<SharedSlot*>(memory_ + kHeaderSize +
+                                       index * SlotSize());
+}
+
+int Scoreboard::ClaimSlot(int first, int count, int start) {
+  DCHECK_NE(0, pid_);
+  // Prefer free slots; only if there are none, take over one from a process
+  // that has died.
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int i = 0; i < count; ++i) {
+      const int index = first + (start + i) % count;
+      SharedSlot* slot = GetSlot(index);
+      const base::subtle::Atomic32 owner =
+          base::subtle::NoBarrier_Load(&slot->pid);
+      if (pass == 0 ? owner != 0 : (owner == 0 || !ProcessIsGone(owner))) {
+        continue;
+      }
+      if (base::subtle::Acquire_CompareAndSwap(&slot->pid, owner, pid_) !=
+          owner) {
+        continue;  // someone else got there first
+      }
+      for (int j = 0; j < NUM_COUNTERS; ++j) {
+        base::subtle::NoBarrier_Store(&slot->counters[j], 0);
+      }
+      base::subtle::NoBarrier_Store(
+          &slot->start_time, static_cast<base::subtle::AtomicWord>(
+              base::Time::Now().ToTimeT()));
+      base::subtle::Barrier_AtomicIncrement(&slot->generation, 1);
+      return index;
+    }
+  }
+  return -1;
+}
+
+void Scoreboard::GetSlots(int first, int count,
+                          std::vector<Slot>* slots) const {
+  slots->clear();
+  for (int i = 0; i < count; ++i) {
+    const SharedSlot* slot = GetSlot(first + i);
+    const int pid = base::subtle::Acquire_Load(&slot->pid);
+    if (pid == 0) {
+      continue;
+    }
+    slots->push_back(Slot());
+    Slot* copy = &slots->back();
+    copy->index = i;
+    copy->pid = pid;
+    copy->generation = base::subtle::NoBarrier_Load(&slot->generation);
+    copy->start_time = base::subtle::NoBarrier_Load(&slot->start_time);
+    for (int j = 0; j < NUM_COUNTERS; ++j) {
+      copy->counters[j] = base::subtle::NoBarrier_Load(&slot->counters[j]);
+    }
+  }
+}
+
+}  // namespace mod_spdy
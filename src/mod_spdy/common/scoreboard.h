@@ -0,0 +1,183 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MOD_SPDY_COMMON_SCOREBOARD_H_
+#define MOD_SPDY_COMMON_SCOREBOARD_H_
+
+#include <string>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+
+namespace mod_spdy {
+
+// A set of counters kept in a memory-mapped file, shared by all the child
+// processes of the server, so that tools (like spdy_top) can watch what
+// mod_spdy is doing across the whole server just by reading the file.  Each
+// child process claims a slot for its own counters, and each SPDY session
+// claims a slot for the counters that concern it alone; the process counters
+// also include the counts of that process's sessions.  Counters are updated
+// with unsynchronized atomic operations, and each slot takes up whole cache
+// lines, so processes don't contend with each other.
+//
+// The scoreboard is off unless CreateInstance() has been called, in which
+// case each child process must call AttachProcess() to start counting.  Use
+// the AddIfEnabled()/SetIfEnabled() methods to update the counters; when the
+// scoreboard is off, they cost only a check of a global pointer.
+class Scoreboard {
+ public:
+  enum Counter {
+    SESSIONS_ACTIVE,
+    SESSIONS_TOTAL,
+    STREAMS_ACTIVE,
+    STREAMS_TOTAL,
+    BYTES_RECEIVED,  // DATA payload bytes received from clients
+    BYTES_SENT,      // bytes of frames sent to clients
+    OUTPUT_QUEUE_DEPTH,  // frames waiting to be sent, as last seen
+    THREADS,         // thread pool workers (per process only)
+    THREADS_BUSY,    // thread pool workers running a task (per process only)
+    TASKS_QUEUED,    // tasks waiting for a worker (per process only)
+    PUSHES_STARTED,
+    PUSHES_CANCELLED,  // by the client, having been started
+    STREAM_WINDOW_STALLS,   // waits for a stream flow control window
+    SESSION_WINDOW_STALLS,  // waits for the session flow control window
+    HEADER_BYTES_RAW,   // header names and values sent, before compression
+    HEADER_BYTES_SENT,  // bytes of frames sent that carry a header block
+    HEADER_COMPRESSION_MICROS,  // time spent serializing those frames
+    NUM_COUNTERS
+  };
+
+  // The value of a session slot index meaning "no session slot".
+  static const int kNoSession;
+
+  // A copy of the contents of a claimed slot.
+  struct Slot {
+    Slot();
+
+    int index;
+    int pid;
+    // Changes each time the slot is claimed, so a reader can tell that a slot
+    // now belongs to a different process or session.
+    int generation;
+    int64 start_time;  // when the slot was claimed, in seconds since the epoch
+    int64 counters[NUM_COUNTERS];
+  };
+
+  // Create (or overwrite) the scoreboard file, with room for the given
+  // numbers of processes and sessions, and map it for writing.  Returns NULL
+  // and sets *error on failure.
+  static Scoreboard* Create(const std::string& path, int num_processes,
+                            int num_sessions, std::string* error);
+
+  // Map an existing scoreboard file for reading only.  Returns NULL and sets
+  // *error on failure.
+  static Scoreboard* Open(const std::string& path, std::string* error);
+
+  // Returns the one and only writable instance of the Scoreboard, or NULL if
+  // the scoreboard is disabled.
+  static Scoreboard* Instance() { return g_instance; }
+
+  // Create the scoreboard file and make it the instance.  Call this in the
+  // parent process, before forking the children.  Returns false and sets
+  // *error on failure.
+  static bool CreateInstance(const std::string& path, int num_processes,
+                             int num_sessions, std::string* error);
+
+  // Disable the scoreboard and unmap it.  This is mainly for tests.
+  static void DestroyInstance();
+
+  ~Scoreboard();
+
+  // Claim a process slot for the calling process.  A slot left behind by a
+  // process that died without releasing it may be taken over.  Returns false
+  // if all the slots are in use, in which case this process won't be counted.
+  bool AttachProcess();
+
+  // Release the calling process's slot.
+  void DetachProcess();
+
+  // Claim a slot for a new session of the calling process, and return its
+  // index, or kNoSession if all slots are in use (or the process isn't
+  // attached).  The session's counts still go to its process in that case.
+  int ClaimSessionSlot();
+
+  // Release a slot returned by ClaimSessionSlot() (which may be kNoSession).
+  void ReleaseSessionSlot(int session);
+
+  // Add to a counter of the calling process, and of the given session (which
+  // may be kNoSession).
+  void Add(int session, Counter counter, int64 delta);
+
+  // Set a counter of the calling process.
+  void Set(Counter counter, int64 value);
+
+  // Call Add()/Set() on the instance, if there is one.
+  static void AddIfEnabled(int session, Counter counter, int64 delta) {
+    Scoreboard* scoreboard = g_instance;
+    if (scoreboard != NULL) {
+      scoreboard->Add(session, counter, delta);
+    }
+  }
+  static void SetIfEnabled(Counter counter, int64 value) {
+    Scoreboard* scoreboard = g_instance;
+    if (scoreboard != NULL) {
+      scoreboard->Set(counter, value);
+    }
+  }
+
+  // Get copies of the claimed process and session slots.
+  void GetProcessSlots(std::vector<Slot>* slots) const;
+  void GetSessionSlots(std::vector<Slot>* slots) const;
+
+  int num_process_slots() const { return num_processes_; }
+  int num_session_slots() const { return num_sessions_; }
+
+  // Return a short, human-readable name for the counter.
+  static const char* GetCounterName(Counter counter);
+
+ private:
+  struct SharedSlot;
+
+  Scoreboard(char* memory, size_t size, int num_processes, int num_sessions);
+
+  // The size of a SharedSlot, padded to a whole number of cache lines.
+  static size_t SlotSize();
+
+  // The process slots come first, followed by the session slots.
+  SharedSlot* GetSlot(int index) const;
+  // Claim one of the count slots starting at index first for the calling
+  // process, trying them in order from index start; return the claimed
+  // slot's index, or -1 if they're all in use.
+  int ClaimSlot(int first, int count, int start);
+  void GetSlots(int first, int count, std::vector<Slot>* slots) const;
+
+  static Scoreboard* g_instance;
+
+  char* const memory_;
+  const size_t size_;
+  const int num_processes_;
+  const int num_sessions_;
+  // The slot claimed by this process, or NULL.
+  SharedSlot* process_slot_;
+  int pid_;
+  // Where to start looking for a free session slot, so that sessions don't
+  // all contend for the first few.
+  base::subtle::Atomic32 next_session_slot_;
+
+  DISALLOW_COPY_AND_ASSIGN(Scoreboard);
+};
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_SCOREBOARD_H_
@@ -0,0 +1,206 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mod_spdy/common/scoreboard.h"
+
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+using mod_spdy::Scoreboard;
+
+class ScoreboardTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    char path[] = "/tmp/scoreboard_test.XXXXXX";
+    const int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    path_ = path;
+  }
+
+  virtual void TearDown() {
+    unlink(path_.c_str());
+  }
+
+  Scoreboard* Create(int num_processes, int num_sessions) {
+    std::string error;
+    Scoreboard* scoreboard =
+        Scoreboard::Create(path_, num_processes, num_sessions, &error);
+    EXPECT_TRUE(scoreboard != NULL) << error;
+    return scoreboard;
+  }
+
+  Scoreboard* Open() {
+    std::string error;
+    Scoreboard* scoreboard = Scoreboard::Open(path_, &error);
+    EXPECT_TRUE(scoreboard != NULL) << error;
+    return scoreboard;
+  }
+
+  std::string path_;
+};
+
+TEST_F(ScoreboardTest, ProcessCounters) {
+  scoped_ptr<Scoreboard> writer(Create(4, 8));
+  scoped_ptr<Scoreboard> reader(Open());
+  EXPECT_EQ(4, reader->num_process_slots());
+  EXPECT_EQ(8, reader->num_session_slots());
+
+  std::vector<Scoreboard::Slot> slots;
+  reader->GetProcessSlots(&slots);
+  EXPECT_TRUE(slots.empty());
+
+  // Counting before attaching does nothing.
+  writer->Add(Scoreboard::kNoSession, Scoreboard::STREAMS_TOTAL, 5);
+  ASSERT_TRUE(writer->AttachProcess());
+  writer->Add(Scoreboard::kNoSession, Scoreboard::STREAMS_TOTAL, 3);
+  writer->Add(Scoreboard::kNoSession, Scoreboard::STREAMS_TOTAL, 4);
+  writer->Set(Scoreboard::THREADS, 10);
+  writer->Set(Scoreboard::THREADS, 6);
+
+  reader->GetProcessSlots(&slots);
+  ASSERT_EQ(1u, slots.size());
+  EXPECT_EQ(getpid(), slots[0].pid);
+  EXPECT_EQ(7, slots[0].counters[Scoreboard::STREAMS_TOTAL]);
+  EXPECT_EQ(6, slots[0].counters[Scoreboard::THREADS]);
+  EXPECT_EQ(0, slots[0].counters[Scoreboard::BYTES_SENT]);
+  EXPECT_GT(slots[0].start_time, 0);
+
+  writer->DetachProcess();
+  reader->GetProcessSlots(&slots);
+  EXPECT_TRUE(slots.empty());
+}
+
+TEST_F(ScoreboardTest, SessionCounters) {
+  scoped_ptr<Scoreboard> writer(Create(2, 2));
+  scoped_ptr<Scoreboard> reader(Open());
+  // Sessions can't be counted until the process is attached.
+  EXPECT_EQ(Scoreboard::kNoSession, writer->ClaimSessionSlot());
+  ASSERT_TRUE(writer->AttachProcess());
+
+  const int session1 = writer->ClaimSessionSlot();
+  const int session2 = writer->ClaimSessionSlot();
+  ASSERT_NE(Scoreboard::kNoSession, session1);
+  ASSERT_NE(Scoreboard::kNoSession, session2);
+  EXPECT_NE(session1, session2);
+  // There are only two session slots.
+  EXPECT_EQ(Scoreboard::kNoSession, writer->ClaimSessionSlot());
+
+  writer->Add(session1, Scoreboard::BYTES_SENT, 100);
+  writer->Add(session2, Scoreboard::BYTES_SENT, 20);
+  writer->Add(Scoreboard::kNoSession, Scoreboard::BYTES_SENT, 3);
+
+  std::vector<Scoreboard::Slot> slots;
+  reader->GetProcessSlots(&slots);
+  ASSERT_EQ(1u, slots.size());
+  EXPECT_EQ(123, slots[0].counters[Scoreboard::BYTES_SENT]);
+  reader->GetSessionSlots(&slots);
+  ASSERT_EQ(2u, slots.size());
+  for (size_t i = 0; i < slots.size(); ++i) {
+    EXPECT_EQ(slots[i].index == session1 ? 100 : 20,
+              slots[i].counters[Scoreboard::BYTES_SENT]);
+  }
+
+  // A released slot can be claimed again, and starts over from zero.
+  writer->ReleaseSessionSlot(session1);
+  writer->ReleaseSessionSlot(Scoreboard::kNoSession);
+  reader->GetSessionSlots(&slots);
+  ASSERT_EQ(1u, slots.size());
+  EXPECT_EQ(session2, slots[0].index);
+  const int generation = slots[0].generation;
+
+  const int session3 = writer->ClaimSessionSlot();
+  EXPECT_EQ(session1, session3);
+  reader->GetSessionSlots(&slots);
+  ASSERT_EQ(2u, slots.size());
+  for (size_t i = 0; i < slots.size(); ++i) {
+    if (slots[i].index == session3) {
+      EXPECT_EQ(0, slots[i].counters[Scoreboard::BYTES_SENT]);
+    } else {
+      EXPECT_EQ(generation, slots[i].generation);
+    }
+  }
+}
+
+// Run AttachProcess() on the scoreboard in a child process, and return
+// whether it succeeded.
+bool AttachInChildProcess(Scoreboard* scoreboard) {
+  const pid_t child = fork();
+  if (child == 0) {
+    _exit(scoreboard->AttachProcess() ? 0 : 1);
+  }
+  int status = 0;
+  return (child > 0 && waitpid(child, &status, 0) == child &&
+          WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+TEST_F(ScoreboardTest, ProcessSlotsFull) {
+  scoped_ptr<Scoreboard> writer(Create(1, 0));
+  ASSERT_TRUE(writer->AttachProcess());
+  // The only slot belongs to a live process (this one).
+  EXPECT_FALSE(AttachInChildProcess(writer.get()));
+  writer->DetachProcess();
+  EXPECT_TRUE(AttachInChildProcess(writer.get()));
+}
+
+TEST_F(ScoreboardTest, ReclaimSlotOfDeadProcess) {
+  scoped_ptr<Scoreboard> writer(Create(1, 1));
+  const pid_t child = fork();
+  ASSERT_GE(child, 0);
+  if (child == 0) {
+    // Claim the only slots, and exit without releasing them.
+    const bool ok = writer->AttachProcess() &&
+        writer->ClaimSessionSlot() != Scoreboard::kNoSession;
+    _exit(ok ? 0 : 1);
+  }
+  int status = 0;
+  ASSERT_EQ(child, waitpid(child, &status, 0));
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+
+  scoped_ptr<Scoreboard> reader(Open());
+  std::vector<Scoreboard::Slot> slots;
+  reader->GetProcessSlots(&slots);
+  ASSERT_EQ(1u, slots.size());
+  EXPECT_EQ(child, slots[0].pid);
+
+  ASSERT_TRUE(writer->AttachProcess());
+  EXPECT_NE(Scoreboard::kNoSession, writer->ClaimSessionSlot());
+  reader->GetProcessSlots(&slots);
+  ASSERT_EQ(1u, slots.size());
+  EXPECT_EQ(getpid(), slots[0].pid);
+}
+
+TEST_F(ScoreboardTest, OpenRejectsOtherFiles) {
+  FILE* file = fopen(path_.c_str(), "w");
+  ASSERT_TRUE(file != NULL);
+  fputs("this is not a scoreboard, but it is long enough to have a header\n",
+        file);
+  fclose(file);
+  std::string error;
+  EXPECT_TRUE(Scoreboard::Open(path_, &error) == NULL);
+  EXPECT_FALSE(error.empty());
+}
+
+}  // namespace
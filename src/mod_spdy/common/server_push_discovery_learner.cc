@@ -35,11 +35,12 @@ int32_t GetPriorityFromExtension(const std::string& url) {
 
 }  // namespace
 
-ServerPushDiscoveryLearner::ServerPushDiscoveryLearner() {}
+ServerPushDiscoveryLearner::ServerPushDiscoveryLearner()
+    : lock_("ServerPushDiscoveryLearner::lock_") {}
 
 std::vector<ServerPushDiscoveryLearner::Push>
 ServerPushDiscoveryLearner::GetPushes(const std::string& master_url) {
-  base::AutoLock lock(lock_);
+  ProfiledAutoLock lock(lock_);
   UrlData& url_data = url_data_[master_url];
   std::vector<Push> pushes;
 
@@ -76,7 +77,7 @@ ServerPushDiscoveryLearner::GetPushes(const std::string& master_url) {
 }
 
 void ServerPushDiscoveryLearner::AddFirstHit(const std::string& master_url) {
-  base::AutoLock lock(lock_);
+  ProfiledAutoLock lock(lock_);
   UrlData& url_data = url_data_[master_url];
   ++url_data.first_hit_count;
 }
@@ -84,7 +85,7 @@ void ServerPushDiscoveryLearner::AddFirstHit(const std::string& master_url) {
 void ServerPushDiscoveryLearner::AddAdjacentHit(const std::string& master_url,
                                                 const std::string& adjacent_url,
                                                 int64_t time_from_init) {
-  base::AutoLock lock(lock_);
+  ProfiledAutoLock lock(lock_);
   std::map<std::string, AdjacentData>& master_url_adjacents =
       url_data_[master_url].adjacents;
 
@@ -20,7 +20,7 @@
 #include <vector>
 
 #include "base/basictypes.h"
-#include "base/synchronization/lock.h"
+#include "mod_spdy/common/profiled_lock.h"
 #include "net/spdy/spdy_protocol.h"
 
 namespace mod_spdy {
@@ -80,7 +80,7 @@ class ServerPushDiscoveryLearner {
                                                        const AdjacentData& b);
 
   std::map<std::string, UrlData> url_data_;
-  base::Lock lock_;
+  ProfiledLock lock_;
 };
 
 }  // namespace mod_spdy
@@ -0,0 +1,95 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/server_push_discovery_learner.h"
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/strings/stringprintf.h"
+#include "mod_spdy/common/testing/benchmark.h"
+
+namespace {
+
+const int kNumPages = 16;
+const int kResourcesPerPage = 24;
+
+std::string PageUrl(int page) {
+  return base::StringPrintf("https://www.example.com/page%d.html", page);
+}
+
+std::string ResourceUrl(int page, int resource) {
+  static const char* const kExtensions[] = { ".css", ".js", ".png", ".jpg" };
+  return base::StringPrintf("https://www.example.com/static/%d/r%d%s", page,
+                            resource, kExtensions[resource % 4]);
+}
+
+// Record one page view: the page itself, then each of its resources.
+void AddPageView(mod_spdy::ServerPushDiscoveryLearner* learner,
+                 const std::vector<std::string>& resources,
+                 const std::string& page) {
+  learner->AddFirstHit(page);
+  for (size_t i = 0; i < resources.size(); ++i) {
+    learner->AddAdjacentHit(page, resources[i], 1000 * (i + 1));
+  }
+}
+
+// Each iteration records a page view with all of its resources.
+MOD_SPDY_BENCHMARK(BM_ServerPushDiscoveryLearner_AddHits) {
+  state->PauseTiming();
+  std::vector<std::string> pages;
+  std::vector<std::vector<std::string> > resources(kNumPages);
+  for (int i = 0; i < kNumPages; ++i) {
+    pages.push_back(PageUrl(i));
+    for (int j = 0; j < kResourcesPerPage; ++j) {
+      resources[i].push_back(ResourceUrl(i, j));
+    }
+  }
+  mod_spdy::ServerPushDiscoveryLearner learner;
+  state->ResumeTiming();
+
+  for (int64 i = 0; i < state->iterations(); ++i) {
+    const int page = static_cast<int>(i % kNumPages);
+    AddPageView(&learner, resources[page], pages[page]);
+  }
+  state->SetItemsProcessed(state->iterations() * (kResourcesPerPage + 1));
+}
+
+// Each iteration looks up the pushes for a page that the learner has seen
+// many times.
+MOD_SPDY_BENCHMARK(BM_ServerPushDiscoveryLearner_GetPushes) {
+  state->PauseTiming();
+  std::vector<std::string> pages;
+  mod_spdy::ServerPushDiscoveryLearner learner;
+  for (int i = 0; i < kNumPages; ++i) {
+    pages.push_back(PageUrl(i));
+    std::vector<std::string> resources;
+    for (int j = 0; j < kResourcesPerPage; ++j) {
+      resources.push_back(ResourceUrl(i, j));
+    }
+    for (int view = 0; view < 10; ++view) {
+      AddPageView(&learner, resources, pages[i]);
+    }
+  }
+  state->ResumeTiming();
+
+  int64 num_pushes = 0;
+  for (int64 i = 0; i < state->iterations(); ++i) {
+    num_pushes += learner.GetPushes(pages[i % kNumPages]).size();
+  }
+  state->SetItemsProcessed(num_pushes);
+}
+
+}  // namespace
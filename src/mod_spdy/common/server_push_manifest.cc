@@ -0,0 +1,157 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/server_push_manifest.h"
+
+#include "base/logging.h"
+#include "base/stl_util.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+
+namespace {
+
+// Manifest priorities are SPDY/3 priorities, where 7 is the lowest.
+const unsigned kLowestManifestPriority = 7;
+
+const char kWhitespace[] = " \t\r";
+
+// Split the line into whitespace-separated fields, ignoring a trailing
+// comment.
+void SplitFields(base::StringPiece line,
+                 std::vector<base::StringPiece>* fields) {
+  while (true) {
+    const size_t start = line.find_first_not_of(kWhitespace);
+    if (start == base::StringPiece::npos || line[start] == '#') {
+      return;
+    }
+    line = line.substr(start);
+    const size_t end = line.find_first_of(kWhitespace);
+    fields->push_back(line.substr(0, end));
+    if (end == base::StringPiece::npos) {
+      return;
+    }
+    line = line.substr(end);
+  }
+}
+
+}  // namespace
+
+namespace mod_spdy {
+
+// A node of the pattern trie.  The node reached by following the characters
+// of a pattern holds that pattern's pushes: exact_pushes for an exact path,
+// or prefix_pushes for a prefix pattern (one ending in '*').
+struct ServerPushManifest::Node {
+  Node() {}
+  ~Node() { STLDeleteValues(&children); }
+
+  std::map<char, Node*> children;
+  std::vector<Push> exact_pushes;
+  std::vector<Push> prefix_pushes;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Node);
+};
+
+ServerPushManifest::ServerPushManifest()
+    : root_(new Node), num_rules_(0) {}
+
+ServerPushManifest::~ServerPushManifest() {
+  delete root_;
+}
+
+bool ServerPushManifest::AddRulesFromString(base::StringPiece text,
+                                            std::string* error) {
+  int line_number = 0;
+  while (!text.empty()) {
+    ++line_number;
+    const size_t newline = text.find('\n');
+    const base::StringPiece line = text.substr(0, newline);
+    text = (newline == base::StringPiece::npos ? base::StringPiece() :
+            text.substr(newline + 1));
+
+    std::vector<base::StringPiece> fields;
+    SplitFields(line, &fields);
+    if (fields.empty()) {
+      continue;  // blank line or comment
+    }
+    if (fields.size() < 2 || fields.size() > 3) {
+      *error = base::StringPrintf(
+          "line %d: expected a page pattern, a resource URL, and an optional "
+          "priority", line_number);
+      return false;
+    }
+    if (fields[0].empty() || fields[0][0] != '/') {
+      *error = base::StringPrintf(
+          "line %d: page pattern must start with '/'", line_number);
+      return false;
+    }
+    unsigned priority = kLowestManifestPriority;
+    if (fields.size() == 3 &&
+        (!base::StringToUint(fields[2], &priority) ||
+         priority > kLowestManifestPriority)) {
+      *error = base::StringPrintf(
+          "line %d: priority must be between 0 and %u", line_number,
+          kLowestManifestPriority);
+      return false;
+    }
+    AddRule(fields[0], Push(fields[1].as_string(), priority));
+  }
+  return true;
+}
+
+void ServerPushManifest::AddRule(base::StringPiece pattern, const Push& push) {
+  const bool is_prefix = pattern.ends_with("*");
+  if (is_prefix) {
+    pattern.remove_suffix(1);
+  }
+  Node* node = root_;
+  for (size_t i = 0; i < pattern.size(); ++i) {
+    Node*& child = node->children[pattern[i]];
+    if (child == NULL) {
+      child = new Node;
+    }
+    node = child;
+  }
+  (is_prefix ? node->prefix_pushes : node->exact_pushes).push_back(push);
+  ++num_rules_;
+}
+
+const std::vector<ServerPushManifest::Push>* ServerPushManifest::Lookup(
+    base::StringPiece path) const {
+  path = path.substr(0, path.find_first_of("?#"));
+  // Walk down the trie, remembering the deepest prefix rule along the way.
+  const std::vector<Push>* best_prefix = NULL;
+  const Node* node = root_;
+  for (size_t i = 0; ; ++i) {
+    if (!node->prefix_pushes.empty()) {
+      best_prefix = &node->prefix_pushes;
+    }
+    if (i == path.size()) {
+      break;
+    }
+    const std::map<char, Node*>::const_iterator iter =
+        node->children.find(path[i]);
+    if (iter == node->children.end()) {
+      return best_prefix;
+    }
+    node = iter->second;
+  }
+  if (!node->exact_pushes.empty()) {
+    return &node->exact_pushes;
+  }
+  return best_prefix;
+}
+
+}  // namespace mod_spdy
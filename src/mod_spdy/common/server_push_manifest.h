@@ -0,0 +1,88 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MOD_SPDY_COMMON_SERVER_PUSH_MANIFEST_H_
+#define MOD_SPDY_COMMON_SERVER_PUSH_MANIFEST_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace mod_spdy {
+
+// A static list of resources to push along with each page, as configured by
+// the server administrator.  The manifest text has one rule per line:
+//
+//   <page-pattern> <resource-url> [<priority>]
+//
+// The page pattern is either an exact path (e.g. "/index.html") or a path
+// prefix followed by an asterisk (e.g. "/products/*").  The resource URL is
+// anything that may appear in an X-Associated-Content header, and the optional
+// priority is a SPDY/3 priority from 0 (highest) to 7 (lowest, the default).
+// Blank lines and lines starting with '#' are ignored.  A page may have many
+// rules; their resources are pushed in the order the rules appear.
+//
+// The patterns are compiled into a trie, so that looking up the pushes for a
+// request takes time proportional to the length of its path.  An exact match
+// takes precedence over any prefix match, and a longer prefix takes
+// precedence over a shorter one.
+//
+// This class is not thread-safe for modification, but once built (during
+// configuration), it may be used for lookups by any number of threads.
+class ServerPushManifest {
+ public:
+  struct Push {
+    Push(const std::string& url, net::SpdyPriority priority)
+        : url(url), priority(priority) {}
+
+    std::string url;
+    net::SpdyPriority priority;
+  };
+
+  ServerPushManifest();
+  ~ServerPushManifest();
+
+  // Parse the manifest text and add its rules.  On a syntax error, return
+  // false and set *error to a description of the problem (including the line
+  // number); in that case, rules from earlier lines will already have been
+  // added.
+  bool AddRulesFromString(base::StringPiece text, std::string* error);
+
+  // Add a single rule.  See above for the form of the pattern.
+  void AddRule(base::StringPiece pattern, const Push& push);
+
+  // Get the resources to push for a request with the given path (any query
+  // string or fragment is ignored), or NULL if there are none.  The returned
+  // vector is owned by the manifest.
+  const std::vector<Push>* Lookup(base::StringPiece path) const;
+
+  // Return true if the manifest has no rules at all.
+  bool empty() const { return num_rules_ == 0; }
+
+ private:
+  struct Node;
+
+  Node* const root_;
+  size_t num_rules_;
+
+  DISALLOW_COPY_AND_ASSIGN(ServerPushManifest);
+};
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_SERVER_PUSH_MANIFEST_H_
@@ -0,0 +1,111 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/server_push_manifest.h"
+
+#include <string>
+#include <vector>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+using mod_spdy::ServerPushManifest;
+
+const char kManifest[] =
+    "# Pushes for the front page.\n"
+    "/index.html   /css/site.css     1\n"
+    "/index.html   /js/app.js        2  # trailing comment\n"
+    "\n"
+    "/products/*   /css/products.css\n"
+    "/products/a/* /img/a.png        5\n"
+    "/products/    /css/list.css     3\n"
+    "/*            https://cdn.example.com/common.js 6\n";
+
+TEST(ServerPushManifestTest, Lookup) {
+  ServerPushManifest manifest;
+  EXPECT_TRUE(manifest.empty());
+  std::string error;
+  ASSERT_TRUE(manifest.AddRulesFromString(kManifest, &error)) << error;
+  EXPECT_FALSE(manifest.empty());
+
+  const std::vector<ServerPushManifest::Push>* pushes =
+      manifest.Lookup("/index.html?utm_source=foo");
+  ASSERT_TRUE(pushes != NULL);
+  ASSERT_EQ(2u, pushes->size());
+  EXPECT_EQ("/css/site.css", (*pushes)[0].url);
+  EXPECT_EQ(1u, (*pushes)[0].priority);
+  EXPECT_EQ("/js/app.js", (*pushes)[1].url);
+  EXPECT_EQ(2u, (*pushes)[1].priority);
+
+  // The longest matching prefix wins.
+  pushes = manifest.Lookup("/products/b/item.html");
+  ASSERT_TRUE(pushes != NULL);
+  ASSERT_EQ(1u, pushes->size());
+  EXPECT_EQ("/css/products.css", (*pushes)[0].url);
+  EXPECT_EQ(7u, (*pushes)[0].priority);
+
+  pushes = manifest.Lookup("/products/a/item.html");
+  ASSERT_TRUE(pushes != NULL);
+  ASSERT_EQ(1u, pushes->size());
+  EXPECT_EQ("/img/a.png", (*pushes)[0].url);
+
+  // An exact match beats any prefix match.
+  pushes = manifest.Lookup("/products/");
+  ASSERT_TRUE(pushes != NULL);
+  ASSERT_EQ(1u, pushes->size());
+  EXPECT_EQ("/css/list.css", (*pushes)[0].url);
+
+  // Everything else falls back to the catch-all rule.
+  pushes = manifest.Lookup("/about.html");
+  ASSERT_TRUE(pushes != NULL);
+  ASSERT_EQ(1u, pushes->size());
+  EXPECT_EQ("https://cdn.example.com/common.js", (*pushes)[0].url);
+  pushes = manifest.Lookup("/index.htm");
+  ASSERT_TRUE(pushes != NULL);
+  EXPECT_EQ("https://cdn.example.com/common.js", (*pushes)[0].url);
+}
+
+TEST(ServerPushManifestTest, NoMatch) {
+  ServerPushManifest manifest;
+  std::string error;
+  ASSERT_TRUE(manifest.AddRulesFromString("/a/* /x.css\n/b /y.css", &error));
+  EXPECT_TRUE(manifest.Lookup("/") == NULL);
+  EXPECT_TRUE(manifest.Lookup("/a") == NULL);
+  EXPECT_TRUE(manifest.Lookup("/bb") == NULL);
+  EXPECT_TRUE(manifest.Lookup("/a/") != NULL);
+  EXPECT_TRUE(manifest.Lookup("/b") != NULL);
+}
+
+TEST(ServerPushManifestTest, SyntaxErrors) {
+  std::string error;
+  {
+    ServerPushManifest manifest;
+    EXPECT_FALSE(manifest.AddRulesFromString("/a /x.css\n/b\n", &error));
+    EXPECT_EQ(0u, error.find("line 2:")) << error;
+  }
+  {
+    ServerPushManifest manifest;
+    EXPECT_FALSE(manifest.AddRulesFromString("a.html /x.css\n", &error));
+    EXPECT_EQ(0u, error.find("line 1:")) << error;
+  }
+  {
+    ServerPushManifest manifest;
+    EXPECT_FALSE(manifest.AddRulesFromString("/a /x.css 8\n", &error));
+    EXPECT_FALSE(manifest.AddRulesFromString("/a /x.css high\n", &error));
+    EXPECT_FALSE(manifest.AddRulesFromString("/a /x.css 1 2\n", &error));
+  }
+}
+
+}  // namespace
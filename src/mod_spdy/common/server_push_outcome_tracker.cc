@@ -0,0 +1,199 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/server_push_outcome_tracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "base/logging.h"
+#include "base/strings/string_util.h"
+
+namespace {
+
+// Outcomes lose half their weight every this many seconds.
+const double kHalfLifeSeconds = 600.0;
+
+// Don't pass judgement on a pair until we have (the decayed equivalent of) at
+// least this many outcomes for it.
+const double kMinOutcomes = 8.0;
+
+// If at least this fraction of pushes for a pair get cancelled, the push is
+// suppressed; if at least the lower fraction get cancelled, it is sent at the
+// lowest priority.
+const double kSuppressCancelFraction = 0.75;
+const double kDeprioritizeCancelFraction = 0.4;
+
+// Upper bound on the number of pairs we keep history for, so that a site with
+// endless distinct URLs can't make us use unbounded memory.
+const size_t kMaxTrackedPairs = 10000;
+
+void DecayStats(base::TimeDelta elapsed,
+                mod_spdy::ServerPushOutcomeTracker::Stats* stats) {
+  if (elapsed <= base::TimeDelta()) {
+    return;
+  }
+  const double factor = std::pow(0.5, elapsed.InSecondsF() / kHalfLifeSeconds);
+  stats->completed *= factor;
+  stats->cancelled *= factor;
+  stats->bytes_completed *= factor;
+  stats->bytes_wasted *= factor;
+}
+
+}  // namespace
+
+namespace mod_spdy {
+
+ServerPushOutcomeTracker::Stats::Stats()
+    : completed(0.0), cancelled(0.0), bytes_completed(0.0),
+      bytes_wasted(0.0) {}
+
+ServerPushOutcomeTracker::Entry::Entry() {}
+
+ServerPushOutcomeTracker::ServerPushOutcomeTracker() {}
+
+ServerPushOutcomeTracker::~ServerPushOutcomeTracker() {}
+
+void ServerPushOutcomeTracker::RecordCompleted(const std::string& host,
+                                               const std::string& master_url,
+                                               const std::string& pushed_url,
+                                               uint64 bytes_sent,
+                                               base::TimeTicks now) {
+  base::AutoLock autolock(lock_);
+  Entry* entry = GetEntryForUpdate(host, master_url, pushed_url, now);
+  if (entry == NULL) {
+    return;
+  }
+  entry->stats.completed += 1.0;
+  entry->stats.bytes_completed += static_cast<double>(bytes_sent);
+}
+
+void ServerPushOutcomeTracker::RecordCancelled(const std::string& host,
+                                               const std::string& master_url,
+                                               const std::string& pushed_url,
+                                               uint64 bytes_sent,
+                                               bool was_completed,
+                                               base::TimeTicks now) {
+  base::AutoLock autolock(lock_);
+  Entry* entry = GetEntryForUpdate(host, master_url, pushed_url, now);
+  if (entry == NULL) {
+    return;
+  }
+  if (was_completed) {
+    // The completion may have decayed a little since it was recorded, so
+    // take care not to go negative.
+    entry->stats.completed = std::max(0.0, entry->stats.completed - 1.0);
+    entry->stats.bytes_completed = std::max(
+        0.0, entry->stats.bytes_completed - static_cast<double>(bytes_sent));
+  }
+  entry->stats.cancelled += 1.0;
+  entry->stats.bytes_wasted += static_cast<double>(bytes_sent);
+  VLOG(3) << "Push of " << pushed_url << " for " << host << master_url
+          << " cancelled after " << bytes_sent << " bytes ("
+          << entry->stats.cancelled << " cancelled vs. "
+          << entry->stats.completed << " completed)";
+}
+
+ServerPushOutcomeTracker::Decision ServerPushOutcomeTracker::Evaluate(
+    const std::string& host, const std::string& master_url,
+    const std::string& pushed_url, base::TimeTicks now) const {
+  Stats stats;
+  if (!GetStats(host, master_url, pushed_url, now, &stats)) {
+    return PUSH;
+  }
+  const double total = stats.completed + stats.cancelled;
+  if (total < kMinOutcomes) {
+    return PUSH;
+  }
+  const double cancel_fraction = stats.cancelled / total;
+  if (cancel_fraction >= kSuppressCancelFraction) {
+    return SUPPRESS;
+  } else if (cancel_fraction >= kDeprioritizeCancelFraction) {
+    return DEPRIORITIZE;
+  }
+  return PUSH;
+}
+
+bool ServerPushOutcomeTracker::ShouldPush(const std::string& host,
+                                          const std::string& master_url,
+                                          const std::string& pushed_url,
+                                          net::SpdyPriority lowest_priority,
+                                          net::SpdyPriority* priority) const {
+  switch (Evaluate(host, master_url, pushed_url, base::TimeTicks::Now())) {
+    case SUPPRESS:
+      VLOG(2) << "Suppressing push of " << pushed_url << " for " << host
+              << master_url
+              << "; clients usually cancel it";
+      return false;
+    case DEPRIORITIZE:
+      // Remember that in SPDY, numerically larger priorities are lower.
+      *priority = std::max(*priority, lowest_priority);
+      return true;
+    default:
+      return true;
+  }
+}
+
+bool ServerPushOutcomeTracker::GetStats(const std::string& host,
+                                        const std::string& master_url,
+                                        const std::string& pushed_url,
+                                        base::TimeTicks now,
+                                        Stats* stats) const {
+  base::AutoLock autolock(lock_);
+  const EntryMap::const_iterator iter =
+      entries_.find(MakeKey(host, master_url, pushed_url));
+  if (iter == entries_.end()) {
+    return false;
+  }
+  *stats = iter->second.stats;
+  DecayStats(now - iter->second.last_update, stats);
+  return true;
+}
+
+// static
+std::string ServerPushOutcomeTracker::NormalizeUrl(const std::string& url) {
+  return url.substr(0, url.find_first_of("?#"));
+}
+
+// static
+ServerPushOutcomeTracker::Key ServerPushOutcomeTracker::MakeKey(
+    const std::string& host, const std::string& master_url,
+    const std::string& pushed_url) {
+  // Host names are case-insensitive.  Master URLs are paths, so they always
+  // start with a slash, and the host can't run into them ambiguously.
+  return std::make_pair(StringToLowerASCII(host) + NormalizeUrl(master_url),
+                        NormalizeUrl(pushed_url));
+}
+
+ServerPushOutcomeTracker::Entry* ServerPushOutcomeTracker::GetEntryForUpdate(
+    const std::string& host, const std::string& master_url,
+    const std::string& pushed_url, base::TimeTicks now) {
+  lock_.AssertAcquired();
+  const Key key = MakeKey(host, master_url, pushed_url);
+  EntryMap::iterator iter = entries_.find(key);
+  if (iter == entries_.end()) {
+    if (entries_.size() >= kMaxTrackedPairs) {
+      return NULL;
+    }
+    iter = entries_.insert(std::make_pair(key, Entry())).first;
+    iter->second.last_update = now;
+    return &iter->second;
+  }
+  Entry* entry = &iter->second;
+  DecayStats(now - entry->last_update, &entry->stats);
+  entry->last_update = std::max(entry->last_update, now);
+  return entry;
+}
+
+}  // namespace mod_spdy
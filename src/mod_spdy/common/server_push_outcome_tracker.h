@@ -0,0 +1,142 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MOD_SPDY_COMMON_SERVER_PUSH_OUTCOME_TRACKER_H_
+#define MOD_SPDY_COMMON_SERVER_PUSH_OUTCOME_TRACKER_H_
+
+#include <map>
+#include <string>
+#include <utility>
+
+#include "base/basictypes.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace mod_spdy {
+
+// Records what happened to server pushes -- whether the client let each one
+// complete or cancelled it with RST_STREAM -- keyed on the host and the
+// (master URL, pushed URL) pair, and uses that history to decide whether a
+// given push is worth doing.  Pushes that clients mostly cancel (e.g. because
+// the browser already has the resource cached) are first demoted to the
+// lowest priority, and then suppressed altogether.
+//
+// Outcomes decay exponentially over time, so a suppressed push is retried
+// once its history has faded, and a pair whose behaviour changes (e.g. after
+// the resource is modified) is re-evaluated.  URLs are paths, and are
+// compared with any query string or fragment removed; the host (that of the
+// master request) keeps the history of different virtual hosts apart.
+//
+// This should be created during per-process initialization.  This class is
+// thread-safe.
+class ServerPushOutcomeTracker {
+ public:
+  enum Decision {
+    PUSH,          // no reason to change the push
+    DEPRIORITIZE,  // push, but at the lowest priority
+    SUPPRESS       // don't push
+  };
+
+  // Decayed outcome totals for one (master, pushed) pair.
+  struct Stats {
+    Stats();
+
+    double completed;
+    double cancelled;
+    double bytes_completed;  // bytes sent on completed pushes
+    double bytes_wasted;  // bytes sent on pushes before they were cancelled
+  };
+
+  ServerPushOutcomeTracker();
+  ~ServerPushOutcomeTracker();
+
+  // Record that a push of pushed_url associated with master_url (on the given
+  // host) ran to completion, having sent bytes_sent bytes of response body.
+  void RecordCompleted(const std::string& host,
+                       const std::string& master_url,
+                       const std::string& pushed_url,
+                       uint64 bytes_sent, base::TimeTicks now);
+
+  // Record that the client cancelled (or refused) a push after bytes_sent
+  // bytes of response body had been sent.  If the push had already been
+  // recorded as completed (because the server finished sending it before the
+  // client's RST_STREAM arrived), pass true for was_completed, and that
+  // completion will be counted as a cancellation instead.
+  void RecordCancelled(const std::string& host,
+                       const std::string& master_url,
+                       const std::string& pushed_url,
+                       uint64 bytes_sent, bool was_completed,
+                       base::TimeTicks now);
+
+  // Decide what to do about a prospective push.  This does not modify the
+  // tracker, so it is safe to consult it at more than one point on the way to
+  // starting a single push.
+  Decision Evaluate(const std::string& host,
+                    const std::string& master_url,
+                    const std::string& pushed_url,
+                    base::TimeTicks now) const;
+
+  // Convenience wrapper around Evaluate: return false if the push should be
+  // suppressed; otherwise return true, lowering *priority to lowest_priority
+  // if the push should be deprioritized.
+  bool ShouldPush(const std::string& host,
+                  const std::string& master_url,
+                  const std::string& pushed_url,
+                  net::SpdyPriority lowest_priority,
+                  net::SpdyPriority* priority) const;
+
+  // Get the decayed outcome totals for the pair, as of now.  Returns false if
+  // nothing is known about the pair.  This is mostly useful for debugging and
+  // testing.
+  bool GetStats(const std::string& host,
+                const std::string& master_url,
+                const std::string& pushed_url,
+                base::TimeTicks now, Stats* stats) const;
+
+  // Strip the query string and fragment (if any) from a URL path, yielding
+  // the key this class uses for it.
+  static std::string NormalizeUrl(const std::string& url);
+
+ private:
+  struct Entry {
+    Entry();
+
+    Stats stats;
+    base::TimeTicks last_update;
+  };
+  // The (host and master path, pushed path) pair identifying an entry.
+  typedef std::pair<std::string, std::string> Key;
+  typedef std::map<Key, Entry> EntryMap;
+
+  static Key MakeKey(const std::string& host, const std::string& master_url,
+                     const std::string& pushed_url);
+
+  // Find (or, if there is room, create) the entry for the pair, and decay its
+  // stats to the given time.  Returns NULL if the pair is untracked and the
+  // tracker is full.  Caller must be holding lock_.
+  Entry* GetEntryForUpdate(const std::string& host,
+                           const std::string& master_url,
+                           const std::string& pushed_url,
+                           base::TimeTicks now);
+
+  mutable base::Lock lock_;
+  EntryMap entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(ServerPushOutcomeTracker);
+};
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_SERVER_PUSH_OUTCOME_TRACKER_H_
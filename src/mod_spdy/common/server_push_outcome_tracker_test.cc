@@ -0,0 +1,142 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/server_push_outcome_tracker.h"
+
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+using mod_spdy::ServerPushOutcomeTracker;
+
+const char kHost[] = "www.example.com";
+
+class ServerPushOutcomeTrackerTest : public testing::Test {
+ public:
+  ServerPushOutcomeTrackerTest() : now_(base::TimeTicks::Now()) {}
+
+ protected:
+  void Record(int completed, int cancelled) {
+    for (int i = 0; i < completed; ++i) {
+      tracker_.RecordCompleted(kHost, "/index.html", "/style.css", 1000,
+                               now_);
+    }
+    for (int i = 0; i < cancelled; ++i) {
+      tracker_.RecordCancelled(kHost, "/index.html", "/style.css", 100, false,
+                               now_);
+    }
+  }
+
+  ServerPushOutcomeTracker::Decision Evaluate() const {
+    return tracker_.Evaluate(kHost, "/index.html", "/style.css", now_);
+  }
+
+  ServerPushOutcomeTracker tracker_;
+  base::TimeTicks now_;
+};
+
+// Test that we don't judge a push until we have enough outcomes for it.
+TEST_F(ServerPushOutcomeTrackerTest, NeedEnoughOutcomes) {
+  EXPECT_EQ(ServerPushOutcomeTracker::PUSH, Evaluate());
+  Record(0, 7);
+  EXPECT_EQ(ServerPushOutcomeTracker::PUSH, Evaluate());
+  Record(0, 1);
+  EXPECT_EQ(ServerPushOutcomeTracker::SUPPRESS, Evaluate());
+}
+
+// Test the thresholds for deprioritizing and suppressing a push.
+TEST_F(ServerPushOutcomeTrackerTest, Thresholds) {
+  Record(7, 3);
+  EXPECT_EQ(ServerPushOutcomeTracker::PUSH, Evaluate());
+  Record(0, 2);
+  EXPECT_EQ(ServerPushOutcomeTracker::DEPRIORITIZE, Evaluate());
+
+  net::SpdyPriority priority = 2;
+  EXPECT_TRUE(tracker_.ShouldPush(kHost, "/index.html", "/style.css", 7,
+                                  &priority));
+  EXPECT_EQ(7u, priority);
+
+  Record(0, 20);
+  EXPECT_EQ(ServerPushOutcomeTracker::SUPPRESS, Evaluate());
+  EXPECT_FALSE(tracker_.ShouldPush(kHost, "/index.html", "/style.css", 7,
+                                   &priority));
+
+  // Other pairs are unaffected.
+  EXPECT_EQ(ServerPushOutcomeTracker::PUSH,
+            tracker_.Evaluate(kHost, "/index.html", "/app.js", now_));
+  EXPECT_EQ(ServerPushOutcomeTracker::PUSH,
+            tracker_.Evaluate(kHost, "/other.html", "/style.css", now_));
+}
+
+// Test that a cancellation arriving after the push completed replaces the
+// completion, and that bytes are accounted for.
+TEST_F(ServerPushOutcomeTrackerTest, LateCancel) {
+  tracker_.RecordCompleted(kHost, "/index.html", "/style.css", 1000, now_);
+  tracker_.RecordCancelled(kHost, "/index.html", "/style.css", 1000, true,
+                           now_);
+
+  ServerPushOutcomeTracker::Stats stats;
+  ASSERT_TRUE(tracker_.GetStats(kHost, "/index.html", "/style.css", now_,
+                                &stats));
+  EXPECT_DOUBLE_EQ(0.0, stats.completed);
+  EXPECT_DOUBLE_EQ(1.0, stats.cancelled);
+  EXPECT_DOUBLE_EQ(0.0, stats.bytes_completed);
+  EXPECT_DOUBLE_EQ(1000.0, stats.bytes_wasted);
+  EXPECT_FALSE(tracker_.GetStats(kHost, "/index.html", "/app.js", now_,
+                                 &stats));
+}
+
+// Test that outcomes fade over time, so that a suppressed push gets retried.
+TEST_F(ServerPushOutcomeTrackerTest, Decay) {
+  Record(0, 16);
+  EXPECT_EQ(ServerPushOutcomeTracker::SUPPRESS, Evaluate());
+
+  // Outcomes halve every ten minutes, so the 16 cancellations drop below the
+  // minimum needed for judgement shortly after that.
+  now_ += base::TimeDelta::FromMinutes(9);
+  EXPECT_EQ(ServerPushOutcomeTracker::SUPPRESS, Evaluate());
+  now_ += base::TimeDelta::FromMinutes(2);
+  EXPECT_EQ(ServerPushOutcomeTracker::PUSH, Evaluate());
+
+  // Fresh completions now outweigh the old cancellations.
+  Record(20, 0);
+  EXPECT_EQ(ServerPushOutcomeTracker::PUSH, Evaluate());
+}
+
+// Test that the same paths on different hosts are tracked separately, and
+// that host names are compared case-insensitively.
+TEST_F(ServerPushOutcomeTrackerTest, SeparateHosts) {
+  Record(0, 10);
+  EXPECT_EQ(ServerPushOutcomeTracker::SUPPRESS, Evaluate());
+  EXPECT_EQ(ServerPushOutcomeTracker::SUPPRESS,
+            tracker_.Evaluate("WWW.Example.COM", "/index.html", "/style.css",
+                              now_));
+  EXPECT_EQ(ServerPushOutcomeTracker::PUSH,
+            tracker_.Evaluate("www.example.org", "/index.html", "/style.css",
+                              now_));
+}
+
+// Test that URLs are compared without their query strings.
+TEST_F(ServerPushOutcomeTrackerTest, IgnoreQuery) {
+  for (int i = 0; i < 10; ++i) {
+    tracker_.RecordCancelled(kHost, "/index.html?page=2", "/style.css?v=3", 0,
+                             false, now_);
+  }
+  EXPECT_EQ(ServerPushOutcomeTracker::SUPPRESS, Evaluate());
+  EXPECT_EQ("/a", ServerPushOutcomeTracker::NormalizeUrl("/a?b#c"));
+  EXPECT_EQ("/a", ServerPushOutcomeTracker::NormalizeUrl("/a#c"));
+}
+
+}  // namespace
@@ -0,0 +1,304 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/server_push_pacer.h"
+
+#include "base/logging.h"
+#include "mod_spdy/common/shared_flow_control_window.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace {
+
+// The parts of a frame that matter for pacing.
+struct FrameInfo {
+  enum Kind { DATA, HEADERS, RST_STREAM, OTHER };
+
+  FrameInfo()
+      : kind(OTHER), stream_id(0), associated_stream_id(0), fin(false),
+        data_length(0) {}
+
+  Kind kind;
+  net::SpdyStreamId stream_id;
+  net::SpdyStreamId associated_stream_id;  // for SYN_STREAM frames only
+  bool fin;
+  size_t data_length;
+};
+
+class FrameInfoVisitor : public net::SpdyFrameVisitor {
+ public:
+  explicit FrameInfoVisitor(FrameInfo* info) : info_(info) {}
+  virtual ~FrameInfoVisitor() {}
+
+  virtual void VisitSynStream(const net::SpdySynStreamIR& frame) {
+    SetHeaders(frame.stream_id(), frame.fin());
+    info_->associated_stream_id = frame.associated_to_stream_id();
+  }
+  virtual void VisitSynReply(const net::SpdySynReplyIR& frame) {
+    SetHeaders(frame.stream_id(), frame.fin());
+  }
+  virtual void VisitRstStream(const net::SpdyRstStreamIR& frame) {
+    info_->kind = FrameInfo::RST_STREAM;
+    info_->stream_id = frame.stream_id();
+  }
+  virtual void VisitSettings(const net::SpdySettingsIR& frame) {}
+  virtual void VisitPing(const net::SpdyPingIR& frame) {}
+  virtual void VisitGoAway(const net::SpdyGoAwayIR& frame) {}
+  virtual void VisitHeaders(const net::SpdyHeadersIR& frame) {
+    SetHeaders(frame.stream_id(), frame.fin());
+  }
+  virtual void VisitWindowUpdate(const net::SpdyWindowUpdateIR& frame) {}
+  virtual void VisitCredential(const net::SpdyCredentialIR& frame) {}
+  virtual void VisitBlocked(const net::SpdyBlockedIR& frame) {}
+  virtual void VisitPushPromise(const net::SpdyPushPromiseIR& frame) {}
+  virtual void VisitData(const net::SpdyDataIR& frame) {
+    info_->kind = FrameInfo::DATA;
+    info_->stream_id = frame.stream_id();
+    info_->fin = frame.fin();
+    info_->data_length = frame.data().size();
+  }
+
+ private:
+  void SetHeaders(net::SpdyStreamId stream_id, bool fin) {
+    info_->kind = FrameInfo::HEADERS;
+    info_->stream_id = stream_id;
+    info_->fin = fin;
+  }
+
+  FrameInfo* const info_;
+
+  DISALLOW_COPY_AND_ASSIGN(FrameInfoVisitor);
+};
+
+FrameInfo GetFrameInfo(const net::SpdyFrameIR& frame) {
+  FrameInfo info;
+  FrameInfoVisitor visitor(&info);
+  frame.Visit(&visitor);
+  return info;
+}
+
+// Server push stream IDs are even; client stream IDs are odd (SPDY draft 3
+// section 2.3.2).  Stream ID zero is used for frames that don't belong to any
+// stream.
+bool IsPushStream(net::SpdyStreamId stream_id) {
+  return stream_id != 0u && stream_id % 2u == 0u;
+}
+
+}  // namespace
+
+namespace mod_spdy {
+
+ServerPushPacer::DocumentState::DocumentState()
+    : headers_written(false), body_bytes_written(0), push_bytes_written(0) {}
+
+ServerPushPacer::ServerPushPacer(size_t max_lead_bytes,
+                                 base::TimeDelta max_deferral,
+                                 SharedFlowControlWindow* shared_window)
+    : max_lead_bytes_(max_lead_bytes),
+      max_deferral_(max_deferral),
+      shared_window_(shared_window),
+      push_data_bytes_written_(0),
+      document_data_bytes_written_(0) {}
+
+ServerPushPacer::~ServerPushPacer() {
+  while (!deferred_frames_.empty()) {
+    DropDeferredFrames(deferred_frames_.begin()->first);
+  }
+}
+
+void ServerPushPacer::OnDocumentStreamOpened(net::SpdyStreamId stream_id) {
+  DCHECK(!IsPushStream(stream_id));
+  documents_[stream_id] = DocumentState();
+}
+
+void ServerPushPacer::OnStreamReset(net::SpdyStreamId stream_id) {
+  if (IsPushStream(stream_id)) {
+    DropDeferredFrames(stream_id);
+    push_documents_.erase(stream_id);
+  } else {
+    // The client doesn't want the document anymore, so there's no point in
+    // holding its pushes back any longer.
+    documents_.erase(stream_id);
+  }
+}
+
+bool ServerPushPacer::OfferFrame(net::SpdyFrameIR* frame,
+                                 base::TimeTicks now) {
+  const FrameInfo info = GetFrameInfo(*frame);
+  if (!IsPushStream(info.stream_id)) {
+    return true;
+  }
+  // A RST_STREAM supersedes anything we were still holding for the stream.
+  if (info.kind == FrameInfo::RST_STREAM) {
+    DropDeferredFrames(info.stream_id);
+    return true;
+  }
+  // Frames for a stream must go out in order, so once we've held back one of
+  // a push's frames, we must hold back the rest too.
+  if (deferred_frames_.count(info.stream_id) == 0u &&
+      (info.kind != FrameInfo::DATA ||
+       PushMayWriteData(info.stream_id, now))) {
+    return true;
+  }
+  DeferredFrame deferred;
+  deferred.frame = frame;
+  deferred.is_data = (info.kind == FrameInfo::DATA);
+  deferred.returned_quota = 0;
+  // The stream thread took session window quota for this frame, which the
+  // document (or other pushes) may need in the meantime; we'll take it back
+  // when the frame is ready to go.
+  if (deferred.is_data && shared_window_ != NULL && info.data_length > 0u) {
+    DCHECK_LE(info.data_length, static_cast<size_t>(kint32max));
+    const int32 quota = info.data_length;
+    if (shared_window_->IncreaseOutputWindowSize(quota)) {
+      deferred.returned_quota = quota;
+    }
+  }
+  deferred_frames_[info.stream_id].push_back(deferred);
+  return false;
+}
+
+net::SpdyFrameIR* ServerPushPacer::PopReadyFrame(base::TimeTicks now) {
+  // Only the earliest deferred frame of each stream can be ready; the later
+  // ones must wait for it.
+  for (DeferredFrameMap::iterator iter = deferred_frames_.begin();
+       iter != deferred_frames_.end(); ++iter) {
+    FrameQueue* frames = &iter->second;
+    DCHECK(!frames->empty());
+    const DeferredFrame& next = frames->front();
+    if (next.is_data && !PushMayWriteData(iter->first, now)) {
+      continue;
+    }
+    if (next.returned_quota > 0 &&
+        !shared_window_->TryRequestOutputQuota(next.returned_quota)) {
+      continue;
+    }
+    net::SpdyFrameIR* frame = next.frame;
+    frames->pop_front();
+    if (frames->empty()) {
+      deferred_frames_.erase(iter);
+    }
+    return frame;
+  }
+  return NULL;
+}
+
+void ServerPushPacer::OnFrameWritten(const net::SpdyFrameIR& frame) {
+  const FrameInfo info = GetFrameInfo(frame);
+  if (info.stream_id == 0u) {
+    return;
+  }
+
+  if (IsPushStream(info.stream_id)) {
+    if (info.kind == FrameInfo::HEADERS && info.associated_stream_id != 0u) {
+      // This is the push's initial SYN_STREAM, which tells us which document
+      // it belongs to.  Pushes of documents that have already finished (or
+      // that we never heard about) needn't be paced.
+      if (documents_.count(info.associated_stream_id) != 0u) {
+        push_documents_[info.stream_id] = info.associated_stream_id;
+      }
+    } else if (info.kind == FrameInfo::DATA) {
+      push_data_bytes_written_ += info.data_length;
+      DocumentState* document = GetDocumentOfPush(info.stream_id);
+      if (document != NULL) {
+        document->push_bytes_written += info.data_length;
+      }
+    }
+    if (info.fin || info.kind == FrameInfo::RST_STREAM) {
+      push_documents_.erase(info.stream_id);
+    }
+    return;
+  }
+
+  if (info.kind == FrameInfo::DATA) {
+    document_data_bytes_written_ += info.data_length;
+  }
+  const DocumentMap::iterator document = documents_.find(info.stream_id);
+  if (document == documents_.end()) {
+    return;
+  }
+  if (info.fin || info.kind == FrameInfo::RST_STREAM) {
+    documents_.erase(document);
+    return;
+  }
+  if (info.kind == FrameInfo::HEADERS) {
+    document->second.headers_written = true;
+  } else if (info.kind == FrameInfo::DATA && info.data_length > 0u) {
+    document->second.body_bytes_written += info.data_length;
+    document->second.stalled_since = base::TimeTicks();
+  }
+}
+
+void ServerPushPacer::ReleaseAll() {
+  documents_.clear();
+  push_documents_.clear();
+}
+
+bool ServerPushPacer::IsPacingFrames() const {
+  for (DeferredFrameMap::const_iterator iter = deferred_frames_.begin();
+       iter != deferred_frames_.end(); ++iter) {
+    const PushMap::const_iterator push = push_documents_.find(iter->first);
+    if (push != push_documents_.end() &&
+        documents_.count(push->second) != 0u) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ServerPushPacer::PushMayWriteData(net::SpdyStreamId stream_id,
+                                       base::TimeTicks now) {
+  DocumentState* document = GetDocumentOfPush(stream_id);
+  if (document == NULL) {
+    return true;
+  }
+  if (document->headers_written && document->body_bytes_written > 0u &&
+      document->push_bytes_written <
+      document->body_bytes_written + max_lead_bytes_) {
+    return true;
+  }
+  if (document->stalled_since.is_null()) {
+    document->stalled_since = now;
+    return false;
+  }
+  if (now - document->stalled_since < max_deferral_) {
+    return false;
+  }
+  // The document has stalled for too long; stop making its pushes wait.
+  documents_.erase(push_documents_[stream_id]);
+  return true;
+}
+
+ServerPushPacer::DocumentState* ServerPushPacer::GetDocumentOfPush(
+    net::SpdyStreamId stream_id) {
+  const PushMap::const_iterator push = push_documents_.find(stream_id);
+  if (push == push_documents_.end()) {
+    return NULL;
+  }
+  const DocumentMap::iterator document = documents_.find(push->second);
+  return document == documents_.end() ? NULL : &document->second;
+}
+
+void ServerPushPacer::DropDeferredFrames(net::SpdyStreamId stream_id) {
+  const DeferredFrameMap::iterator iter = deferred_frames_.find(stream_id);
+  if (iter == deferred_frames_.end()) {
+    return;
+  }
+  for (FrameQueue::iterator frame = iter->second.begin();
+       frame != iter->second.end(); ++frame) {
+    delete frame->frame;
+  }
+  deferred_frames_.erase(iter);
+}
+
+}  // namespace mod_spdy
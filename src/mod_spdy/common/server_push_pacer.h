@@ -0,0 +1,154 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MOD_SPDY_COMMON_SERVER_PUSH_PACER_H_
+#define MOD_SPDY_COMMON_SERVER_PUSH_PACER_H_
+
+#include <deque>
+#include <map>
+
+#include "base/basictypes.h"
+#include "base/time/time.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace mod_spdy {
+
+class SharedFlowControlWindow;
+
+// Decides, as a SpdySession writes frames to the client, when the DATA frames
+// of server pushes may go out, so that pushed bytes never delay the document
+// that the pushes are associated with.  A push's DATA is held back until the
+// associated stream has sent its response headers and the first bytes of its
+// body, and thereafter may run at most max_lead_bytes ahead of that body,
+// until the associated stream finishes.  Frames that the pacer holds back are
+// released, in order, as the associated stream makes progress.  In case the
+// associated stream stalls (e.g. a slow CGI), a held-back push is released
+// anyway once that stream has made no progress for max_deferral.
+//
+// By the time a push's DATA frame reaches the pacer, its stream thread has
+// already taken quota for it from the SPDY/3.1 session flow control window.
+// So that held-back pushes can't starve the document of that window (and so
+// stall it until max_deferral runs out), the pacer gives the quota of each
+// DATA frame it holds back to the window, and takes it again, without
+// blocking, before releasing the frame.
+//
+// The pacer also keeps count of how many bytes of DATA have been written for
+// pushed streams versus for the client's own streams.
+//
+// This class is not thread-safe; it is meant to be used only by a session's
+// connection thread.
+class ServerPushPacer {
+ public:
+  // The shared_window should be the session's SPDY/3.1 flow control window,
+  // or NULL for earlier SPDY versions; the pacer does not take ownership.
+  ServerPushPacer(size_t max_lead_bytes, base::TimeDelta max_deferral,
+                  SharedFlowControlWindow* shared_window);
+  ~ServerPushPacer();
+
+  // Inform the pacer that the client has opened the given stream.  Pushes
+  // associated with streams that the pacer doesn't know about are not paced.
+  void OnDocumentStreamOpened(net::SpdyStreamId stream_id);
+
+  // Inform the pacer that the client has reset the given stream.  Any frames
+  // being held back for that stream are discarded.
+  void OnStreamReset(net::SpdyStreamId stream_id);
+
+  // Offer a frame that is about to be written.  If the frame may be written
+  // right away, returns true, and the caller remains responsible for the
+  // frame.  Otherwise, returns false and takes ownership of the frame, which
+  // will later be handed back by PopReadyFrame().
+  bool OfferFrame(net::SpdyFrameIR* frame, base::TimeTicks now);
+
+  // If any held-back frame may now be written (and, for DATA, the session flow
+  // control window has room for it again), remove it from the pacer and
+  // return it (the caller takes ownership); otherwise return NULL.  Frames for
+  // any given stream are returned in the order they were offered.
+  net::SpdyFrameIR* PopReadyFrame(base::TimeTicks now);
+
+  // Inform the pacer that a frame has been written to the client.  This must
+  // be called for every frame written, so that the pacer can track the
+  // progress of each stream.
+  void OnFrameWritten(const net::SpdyFrameIR& frame);
+
+  // Stop pacing the pushes for all current streams, so that every held-back
+  // frame is ready to be written.  The session calls this once it has no
+  // active streams left, since then nothing remains to wait for.
+  void ReleaseAll();
+
+  // Return true if the pacer is holding back any frames.
+  bool HasDeferredFrames() const { return !deferred_frames_.empty(); }
+
+  // Return true if the pacer is holding back any frames on behalf of their
+  // documents, as opposed to only waiting for the client to open up the
+  // session flow control window again.
+  bool IsPacingFrames() const;
+
+  // How many bytes of DATA payload have been written for pushed streams, and
+  // for client-initiated streams?
+  uint64 push_data_bytes_written() const { return push_data_bytes_written_; }
+  uint64 document_data_bytes_written() const {
+    return document_data_bytes_written_;
+  }
+
+ private:
+  struct DocumentState {
+    DocumentState();
+
+    bool headers_written;
+    uint64 body_bytes_written;
+    uint64 push_bytes_written;  // DATA written for this document's pushes
+    // When we first held back a push for this document since it last made
+    // progress, or null if we haven't.
+    base::TimeTicks stalled_since;
+  };
+  typedef std::map<net::SpdyStreamId, DocumentState> DocumentMap;
+  typedef std::map<net::SpdyStreamId, net::SpdyStreamId> PushMap;
+  struct DeferredFrame {
+    net::SpdyFrameIR* frame;  // owned by the pacer
+    bool is_data;
+    // Session window quota given back while holding the frame, which must be
+    // taken again before the frame is written.
+    int32 returned_quota;
+  };
+  typedef std::deque<DeferredFrame> FrameQueue;
+  typedef std::map<net::SpdyStreamId, FrameQueue> DeferredFrameMap;
+
+  // Return true if the given push stream may write DATA now.  This may stop
+  // pacing the push's document, if the document has stalled for too long.
+  bool PushMayWriteData(net::SpdyStreamId stream_id, base::TimeTicks now);
+
+  // Return the state of the document that the given push stream is
+  // associated with, or NULL if the push isn't being paced.
+  DocumentState* GetDocumentOfPush(net::SpdyStreamId stream_id);
+
+  // Discard all frames being held back for the given stream.
+  void DropDeferredFrames(net::SpdyStreamId stream_id);
+
+  const size_t max_lead_bytes_;
+  const base::TimeDelta max_deferral_;
+  SharedFlowControlWindow* const shared_window_;  // NULL before SPDY/3.1
+  DocumentMap documents_;  // unfinished client streams
+  PushMap push_documents_;  // unfinished push streams -> associated streams
+  // Held-back frames of each push stream, in the order they were offered;
+  // streams with none held back have no entry.
+  DeferredFrameMap deferred_frames_;
+  uint64 push_data_bytes_written_;
+  uint64 document_data_bytes_written_;
+
+  DISALLOW_COPY_AND_ASSIGN(ServerPushPacer);
+};
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_SERVER_PUSH_PACER_H_
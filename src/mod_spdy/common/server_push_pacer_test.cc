@@ -0,0 +1,233 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/server_push_pacer.h"
+
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_piece.h"
+#include "base/time/time.h"
+#include "mod_spdy/common/shared_flow_control_window.h"
+#include "mod_spdy/common/testing/spdy_frame_matchers.h"
+#include "net/spdy/spdy_protocol.h"
+#include "testing/gmock/include/gmock/gmock.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using mod_spdy::testing::IsDataFrame;
+
+namespace {
+
+const net::SpdyStreamId kDocumentId = 1;
+const net::SpdyStreamId kPushId = 2;
+const size_t kMaxLeadBytes = 10;
+
+class ServerPushPacerTest : public testing::Test {
+ public:
+  ServerPushPacerTest()
+      : shared_window_(net::kSpdyStreamInitialWindowSize,
+                       net::kSpdyStreamInitialWindowSize),
+        pacer_(kMaxLeadBytes, base::TimeDelta::FromMilliseconds(100),
+               &shared_window_),
+        now_(base::TimeTicks::Now()) {}
+
+ protected:
+  // Offer the frame to the pacer, and if it may be written now, "write" it.
+  // Return true if the frame was written.
+  bool Send(net::SpdyFrameIR* raw_frame) {
+    if (!pacer_.OfferFrame(raw_frame, now_)) {
+      return false;  // the pacer took ownership
+    }
+    scoped_ptr<net::SpdyFrameIR> frame(raw_frame);
+    pacer_.OnFrameWritten(*frame);
+    return true;
+  }
+
+  bool SendData(net::SpdyStreamId stream_id, base::StringPiece data,
+                bool fin) {
+    net::SpdyDataIR* frame = new net::SpdyDataIR(stream_id, data);
+    frame->set_fin(fin);
+    return Send(frame);
+  }
+
+  void StartPush(net::SpdyStreamId stream_id) {
+    net::SpdySynStreamIR* frame = new net::SpdySynStreamIR(stream_id);
+    frame->set_associated_to_stream_id(kDocumentId);
+    EXPECT_TRUE(Send(frame));
+  }
+
+  // Expect the pacer to release a deferred DATA frame, and "write" it.
+  void ExpectReadyData(net::SpdyStreamId stream_id, bool fin,
+                       base::StringPiece payload) {
+    scoped_ptr<net::SpdyFrameIR> frame(pacer_.PopReadyFrame(now_));
+    ASSERT_TRUE(frame != NULL);
+    EXPECT_THAT(*frame, IsDataFrame(stream_id, fin, payload));
+    pacer_.OnFrameWritten(*frame);
+  }
+
+  void ExpectNoReadyFrame() {
+    EXPECT_TRUE(pacer_.PopReadyFrame(now_) == NULL);
+  }
+
+  mod_spdy::SharedFlowControlWindow shared_window_;
+  mod_spdy::ServerPushPacer pacer_;
+  base::TimeTicks now_;
+};
+
+// Test that a push's DATA waits for the document's headers and first body
+// bytes, and that the push's frames stay in order meanwhile.
+TEST_F(ServerPushPacerTest, DeferUntilDocumentBodyStarts) {
+  pacer_.OnDocumentStreamOpened(kDocumentId);
+  StartPush(kPushId);
+  EXPECT_TRUE(Send(new net::SpdyHeadersIR(kPushId)));
+  EXPECT_FALSE(SendData(kPushId, "push", false));
+  // Once one frame is held back, later frames for that stream must wait too.
+  net::SpdyHeadersIR* trailers = new net::SpdyHeadersIR(kPushId);
+  trailers->set_fin(true);
+  EXPECT_FALSE(Send(trailers));
+  EXPECT_TRUE(pacer_.HasDeferredFrames());
+  ExpectNoReadyFrame();
+
+  // Headers alone aren't enough.
+  EXPECT_TRUE(Send(new net::SpdySynReplyIR(kDocumentId)));
+  ExpectNoReadyFrame();
+
+  EXPECT_TRUE(SendData(kDocumentId, "html", false));
+  ExpectReadyData(kPushId, false, "push");
+  scoped_ptr<net::SpdyFrameIR> frame(pacer_.PopReadyFrame(now_));
+  ASSERT_TRUE(frame != NULL);
+  pacer_.OnFrameWritten(*frame);
+  EXPECT_FALSE(pacer_.HasDeferredFrames());
+}
+
+// Test that pushes may only run a bounded distance ahead of the document,
+// until the document finishes.
+TEST_F(ServerPushPacerTest, LimitPushLead) {
+  pacer_.OnDocumentStreamOpened(kDocumentId);
+  StartPush(kPushId);
+  StartPush(kPushId + 2);
+  EXPECT_TRUE(Send(new net::SpdySynReplyIR(kDocumentId)));
+  EXPECT_TRUE(SendData(kDocumentId, "abc", false));
+
+  // The pushes may write until they're 10 bytes ahead of the document.
+  EXPECT_TRUE(SendData(kPushId, "0123456789", false));
+  EXPECT_TRUE(SendData(kPushId + 2, "abc", false));
+  EXPECT_FALSE(SendData(kPushId, "cd", false));
+  EXPECT_FALSE(SendData(kPushId + 2, "ef", true));
+  ExpectNoReadyFrame();
+
+  EXPECT_TRUE(SendData(kDocumentId, "de", false));
+  ExpectReadyData(kPushId, false, "cd");
+  ExpectNoReadyFrame();
+
+  // Once the document has finished, the pushes go at full speed.
+  EXPECT_TRUE(SendData(kDocumentId, "", true));
+  ExpectReadyData(kPushId + 2, true, "ef");
+  EXPECT_TRUE(SendData(kPushId, "0123456789abcdef", true));
+  EXPECT_FALSE(pacer_.HasDeferredFrames());
+}
+
+// Test that a document that stops making progress can't hold its pushes back
+// indefinitely.
+TEST_F(ServerPushPacerTest, ReleaseStalledPushes) {
+  pacer_.OnDocumentStreamOpened(kDocumentId);
+  StartPush(kPushId);
+  EXPECT_FALSE(SendData(kPushId, "push", true));
+  now_ += base::TimeDelta::FromMilliseconds(99);
+  ExpectNoReadyFrame();
+  now_ += base::TimeDelta::FromMilliseconds(1);
+  ExpectReadyData(kPushId, true, "push");
+}
+
+// Test that pushes are no longer paced once the session has nothing left to
+// wait for.
+TEST_F(ServerPushPacerTest, ReleaseAll) {
+  pacer_.OnDocumentStreamOpened(kDocumentId);
+  StartPush(kPushId);
+  EXPECT_FALSE(SendData(kPushId, "push", true));
+  ExpectNoReadyFrame();
+  pacer_.ReleaseAll();
+  ExpectReadyData(kPushId, true, "push");
+}
+
+// Test that held-back push DATA doesn't keep its session window quota from
+// the document, and waits for room in the window before being released.
+TEST_F(ServerPushPacerTest, ReturnSessionWindowWhileDeferred) {
+  pacer_.OnDocumentStreamOpened(kDocumentId);
+  StartPush(kPushId);
+  // The push's stream thread takes quota for its DATA...
+  ASSERT_TRUE(shared_window_.TryRequestOutputQuota(4));
+  const int32 window = shared_window_.current_output_window_size();
+  EXPECT_FALSE(SendData(kPushId, "push", true));
+  // ...which the pacer gives back while it holds the frame.
+  EXPECT_EQ(window + 4, shared_window_.current_output_window_size());
+
+  // The document uses all but three bytes of the window, and finishes; the
+  // push is no longer paced, but there isn't room in the window for it.
+  EXPECT_TRUE(Send(new net::SpdySynReplyIR(kDocumentId)));
+  ASSERT_TRUE(shared_window_.TryRequestOutputQuota(window + 1));
+  EXPECT_TRUE(SendData(kDocumentId, "html", true));
+  ExpectNoReadyFrame();
+  EXPECT_TRUE(pacer_.HasDeferredFrames());
+  EXPECT_FALSE(pacer_.IsPacingFrames());
+
+  ASSERT_TRUE(shared_window_.IncreaseOutputWindowSize(1));
+  ExpectReadyData(kPushId, true, "push");
+  EXPECT_EQ(0, shared_window_.current_output_window_size());
+}
+
+// Test that resetting a stream discards its deferred frames, and that
+// resetting the document releases its pushes.
+TEST_F(ServerPushPacerTest, ResetStreams) {
+  pacer_.OnDocumentStreamOpened(kDocumentId);
+  StartPush(kPushId);
+  StartPush(kPushId + 2);
+  EXPECT_FALSE(SendData(kPushId, "foo", true));
+  EXPECT_FALSE(SendData(kPushId + 2, "bar", true));
+
+  pacer_.OnStreamReset(kPushId);
+  ExpectNoReadyFrame();
+  EXPECT_TRUE(pacer_.HasDeferredFrames());
+
+  pacer_.OnStreamReset(kDocumentId);
+  ExpectReadyData(kPushId + 2, true, "bar");
+  EXPECT_FALSE(pacer_.HasDeferredFrames());
+}
+
+// Test that pushes of documents the pacer doesn't know about (or that have
+// already finished) aren't held back.
+TEST_F(ServerPushPacerTest, UnpacedPushes) {
+  StartPush(kPushId);
+  EXPECT_TRUE(SendData(kPushId, "foo", true));
+
+  pacer_.OnDocumentStreamOpened(kDocumentId);
+  EXPECT_TRUE(Send(new net::SpdySynReplyIR(kDocumentId)));
+  EXPECT_TRUE(SendData(kDocumentId, "html", true));
+  StartPush(kPushId + 2);
+  EXPECT_TRUE(SendData(kPushId + 2, "bar", true));
+}
+
+// Test counting of push versus document bytes.
+TEST_F(ServerPushPacerTest, CountBytes) {
+  pacer_.OnDocumentStreamOpened(kDocumentId);
+  pacer_.OnDocumentStreamOpened(kDocumentId + 2);
+  StartPush(kPushId);
+  EXPECT_TRUE(Send(new net::SpdySynReplyIR(kDocumentId)));
+  EXPECT_TRUE(SendData(kDocumentId, "html", true));
+  EXPECT_TRUE(SendData(kDocumentId + 2, "more html", true));
+  EXPECT_TRUE(SendData(kPushId, "push", true));
+  EXPECT_TRUE(Send(new net::SpdyPingIR(1)));
+  EXPECT_EQ(13u, pacer_.document_data_bytes_written());
+  EXPECT_EQ(4u, pacer_.push_data_bytes_written());
+}
+
+}  // namespace
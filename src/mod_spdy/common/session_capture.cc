@@ -0,0 +1,190 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/session_capture.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+
+#include "base/logging.h"
+#include "base/strings/string_piece.h"
+#include "base/time/time.h"
+#include "mod_spdy/common/protocol_util.h"
+
+namespace {
+
+const char kMagic[] = "SPDYCAP1";
+const size_t kMagicSize = sizeof(kMagic) - 1;
+
+// A varint never needs more than ten bytes to hold 64 bits.
+const size_t kMaxVarintBytes = 10;
+
+uint8 VersionToByte(mod_spdy::spdy::SpdyVersion version) {
+  switch (version) {
+    case mod_spdy::spdy::SPDY_VERSION_2:
+      return 2;
+    case mod_spdy::spdy::SPDY_VERSION_3:
+      return 3;
+    case mod_spdy::spdy::SPDY_VERSION_3_1:
+      return 31;
+    default:
+      LOG(DFATAL) << "Invalid SpdyVersion value: " << version;
+      return 0;
+  }
+}
+
+bool ByteToVersion(uint8 byte, mod_spdy::spdy::SpdyVersion* version) {
+  switch (byte) {
+    case 2:
+      *version = mod_spdy::spdy::SPDY_VERSION_2;
+      return true;
+    case 3:
+      *version = mod_spdy::spdy::SPDY_VERSION_3;
+      return true;
+    case 31:
+      *version = mod_spdy::spdy::SPDY_VERSION_3_1;
+      return true;
+    default:
+      return false;
+  }
+}
+
+void AppendVarint(uint64 value, std::string* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+}  // namespace
+
+namespace mod_spdy {
+
+SessionCaptureWriter::SessionCaptureWriter(FILE* file,
+                                           spdy::SpdyVersion spdy_version,
+                                           size_t max_bytes)
+    : file_(file),
+      max_bytes_(max_bytes),
+      bytes_written_(0),
+      full_(false) {
+  DCHECK(file_ != NULL);
+  std::string header(kMagic, kMagicSize);
+  header.push_back(static_cast<char>(VersionToByte(spdy_version)));
+  AppendVarint(static_cast<uint64>(base::Time::Now().ToJavaTime()), &header);
+  Write(header);
+}
+
+SessionCaptureWriter::~SessionCaptureWriter() {
+  if (fclose(file_) != 0) {
+    PLOG(WARNING) << "Failed to close session capture log";
+  }
+}
+
+void SessionCaptureWriter::RecordInput(base::TimeTicks now,
+                                       const char* data, size_t size) {
+  if (full_ || size == 0) {
+    return;
+  }
+  const int64 delta_us =
+      (last_time_.is_null() ? 0 : (now - last_time_).InMicroseconds());
+  std::string record;
+  AppendVarint(static_cast<uint64>(std::max<int64>(0, delta_us)), &record);
+  AppendVarint(size, &record);
+  if (bytes_written_ + record.size() + size > max_bytes_) {
+    VLOG(1) << "Session capture log is full after " << bytes_written_
+            << " bytes";
+    full_ = true;
+    return;
+  }
+  record.append(data, size);
+  if (Write(record)) {
+    last_time_ = now;
+  }
+}
+
+bool SessionCaptureWriter::Write(const std::string& bytes) {
+  if (fwrite(bytes.data(), 1, bytes.size(), file_) != bytes.size()) {
+    PLOG(WARNING) << "Failed to write session capture log";
+    full_ = true;
+    return false;
+  }
+  bytes_written_ += bytes.size();
+  return true;
+}
+
+SessionCaptureReader::SessionCaptureReader()
+    : spdy_version_(spdy::SPDY_VERSION_NONE), truncated_(false) {}
+
+SessionCaptureReader::~SessionCaptureReader() {}
+
+bool SessionCaptureReader::Init(base::StringPiece log) {
+  remaining_ = log;
+  offset_ = base::TimeDelta();
+  truncated_ = false;
+  if (!remaining_.starts_with(base::StringPiece(kMagic, kMagicSize))) {
+    return false;
+  }
+  remaining_.remove_prefix(kMagicSize);
+  if (remaining_.empty() ||
+      !ByteToVersion(static_cast<uint8>(remaining_[0]), &spdy_version_)) {
+    return false;
+  }
+  remaining_.remove_prefix(1);
+  uint64 start_ms = 0;
+  if (!ReadVarint(&start_ms)) {
+    return false;
+  }
+  start_time_ = base::Time::FromJavaTime(static_cast<int64>(start_ms));
+  return true;
+}
+
+bool SessionCaptureReader::NextChunk(base::TimeDelta* offset,
+                                     base::StringPiece* data) {
+  if (remaining_.empty()) {
+    return false;
+  }
+  uint64 delta_us = 0;
+  uint64 size = 0;
+  if (!ReadVarint(&delta_us) || !ReadVarint(&size) ||
+      size > remaining_.size()) {
+    truncated_ = true;
+    remaining_.clear();
+    return false;
+  }
+  offset_ += base::TimeDelta::FromMicroseconds(static_cast<int64>(delta_us));
+  *offset = offset_;
+  *data = remaining_.substr(0, static_cast<size_t>(size));
+  remaining_.remove_prefix(static_cast<size_t>(size));
+  return true;
+}
+
+bool SessionCaptureReader::ReadVarint(uint64* value) {
+  uint64 result = 0;
+  const size_t limit = std::min<size_t>(kMaxVarintBytes, remaining_.size());
+  for (size_t i = 0; i < limit; ++i) {
+    const uint8 byte = static_cast<uint8>(remaining_[i]);
+    result |= static_cast<uint64>(byte & 0x7f) << (7 * i);
+    if ((byte & 0x80) == 0) {
+      remaining_.remove_prefix(i + 1);
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace mod_spdy
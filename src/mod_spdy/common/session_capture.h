@@ -0,0 +1,111 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MOD_SPDY_COMMON_SESSION_CAPTURE_H_
+#define MOD_SPDY_COMMON_SESSION_CAPTURE_H_
+
+#include <stdio.h>
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+#include "base/time/time.h"
+#include "mod_spdy/common/protocol_util.h"
+
+namespace mod_spdy {
+
+// A session capture log records the (decrypted) bytes a client sent on a SPDY
+// connection, exactly as they were fed to the session's framer, along with
+// when each chunk arrived, so that the session can later be replayed offline
+// against a SpdySession.  The format is:
+//
+//   header:  the 8 bytes "SPDYCAP1"
+//            1 byte:  the SPDY version (2, 3, or 31 for SPDY/3.1)
+//            varint:  wall-clock start time, in milliseconds since the epoch
+//   records: varint:  microseconds since the previous record (zero for the
+//                     first record)
+//            varint:  length of the chunk
+//            the bytes of the chunk
+//
+// where each varint is an unsigned LEB128 number (seven bits per byte, least
+// significant first, with the high bit set on all but the last byte).  A log
+// that was cut short (e.g. by a size limit or a crash) simply ends early.
+
+// Writes a session capture log.  This must only be used from the session's
+// connection thread.
+class SessionCaptureWriter {
+ public:
+  // The writer takes ownership of the file (which must be open for writing),
+  // and closes it when the writer is destroyed.  Once the log would exceed
+  // max_bytes, further input is dropped.
+  SessionCaptureWriter(FILE* file, spdy::SpdyVersion spdy_version,
+                       size_t max_bytes);
+  ~SessionCaptureWriter();
+
+  // Record a chunk of input received at the given time.
+  void RecordInput(base::TimeTicks now, const char* data, size_t size);
+
+  // True if input has been dropped because the log reached its size limit
+  // (or because writing to the file failed).
+  bool is_full() const { return full_; }
+  size_t bytes_written() const { return bytes_written_; }
+
+ private:
+  bool Write(const std::string& bytes);
+
+  FILE* const file_;
+  const size_t max_bytes_;
+  size_t bytes_written_;
+  base::TimeTicks last_time_;
+  bool full_;
+
+  DISALLOW_COPY_AND_ASSIGN(SessionCaptureWriter);
+};
+
+// Reads a session capture log from memory.
+class SessionCaptureReader {
+ public:
+  SessionCaptureReader();
+  ~SessionCaptureReader();
+
+  // Start reading the given log; the reader does not copy the data, so it
+  // must outlive the reader.  Return false if it isn't a session capture log.
+  bool Init(base::StringPiece log);
+
+  spdy::SpdyVersion spdy_version() const { return spdy_version_; }
+  base::Time start_time() const { return start_time_; }
+
+  // Get the next chunk of input, and when it arrived relative to the first
+  // chunk.  Return false at the end of the log.
+  bool NextChunk(base::TimeDelta* offset, base::StringPiece* data);
+
+  // True if the log ended partway through a record, rather than cleanly.
+  bool truncated() const { return truncated_; }
+
+ private:
+  bool ReadVarint(uint64* value);
+
+  base::StringPiece remaining_;
+  spdy::SpdyVersion spdy_version_;
+  base::Time start_time_;
+  base::TimeDelta offset_;
+  bool truncated_;
+
+  DISALLOW_COPY_AND_ASSIGN(SessionCaptureReader);
+};
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_SESSION_CAPTURE_H_
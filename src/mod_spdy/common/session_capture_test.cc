@@ -0,0 +1,148 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/session_capture.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "base/strings/string_piece.h"
+#include "base/time/time.h"
+#include "mod_spdy/common/protocol_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// Read back everything written to the file so far.
+std::string ReadAll(FILE* file) {
+  fflush(file);
+  rewind(file);
+  std::string contents;
+  char buffer[256];
+  size_t size;
+  while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    contents.append(buffer, size);
+  }
+  return contents;
+}
+
+class SessionCaptureTest : public testing::Test {
+ protected:
+  // Write a log with the given size limit, recording the given chunks 2
+  // milliseconds apart (plus one large gap before the last), and return its
+  // contents.
+  std::string WriteLog(size_t max_bytes,
+                       const char* const* chunks, size_t num_chunks,
+                       bool* full) {
+    FILE* file = tmpfile();
+    EXPECT_TRUE(file != NULL);
+    // Keep our own handle open after the writer closes its copy.
+    FILE* reader = fdopen(dup(fileno(file)), "rb");
+    {
+      mod_spdy::SessionCaptureWriter writer(
+          file, mod_spdy::spdy::SPDY_VERSION_3_1, max_bytes);
+      base::TimeTicks now = base::TimeTicks::Now();
+      for (size_t i = 0; i < num_chunks; ++i) {
+        now += base::TimeDelta::FromMilliseconds(
+            i + 1 == num_chunks ? 300000 : 2);
+        writer.RecordInput(now, chunks[i], strlen(chunks[i]));
+      }
+      *full = writer.is_full();
+    }
+    const std::string contents = ReadAll(reader);
+    fclose(reader);
+    return contents;
+  }
+};
+
+TEST_F(SessionCaptureTest, RoundTrip) {
+  const char* const chunks[] = {"foo", "", "barbaz", "quux"};
+  bool full = true;
+  const std::string log = WriteLog(1000, chunks, arraysize(chunks), &full);
+  EXPECT_FALSE(full);
+
+  mod_spdy::SessionCaptureReader reader;
+  ASSERT_TRUE(reader.Init(log));
+  EXPECT_EQ(mod_spdy::spdy::SPDY_VERSION_3_1, reader.spdy_version());
+  EXPECT_LT((base::Time::Now() - reader.start_time()).InMinutes(), 10);
+
+  base::TimeDelta offset;
+  base::StringPiece data;
+  ASSERT_TRUE(reader.NextChunk(&offset, &data));
+  EXPECT_EQ(0, offset.InMilliseconds());
+  EXPECT_EQ("foo", data.as_string());
+  // The empty chunk isn't recorded, so the next chunk is 4ms after the first.
+  ASSERT_TRUE(reader.NextChunk(&offset, &data));
+  EXPECT_EQ(4, offset.InMilliseconds());
+  EXPECT_EQ("barbaz", data.as_string());
+  ASSERT_TRUE(reader.NextChunk(&offset, &data));
+  EXPECT_EQ(300004, offset.InMilliseconds());
+  EXPECT_EQ("quux", data.as_string());
+  EXPECT_FALSE(reader.NextChunk(&offset, &data));
+  EXPECT_FALSE(reader.truncated());
+}
+
+// Once the next chunk would push the log over its limit, the writer stops
+// recording, rather than leaving a gap in the middle of the log.
+TEST_F(SessionCaptureTest, SizeLimit) {
+  const char* const chunks[] = {"foo", "barbazquux", "x"};
+  bool full = false;
+  // The header is 8 + 1 + 6 bytes (for a present-day start time), and the
+  // first record is 5 bytes.
+  const std::string log = WriteLog(25, chunks, arraysize(chunks), &full);
+  EXPECT_TRUE(full);
+
+  mod_spdy::SessionCaptureReader reader;
+  ASSERT_TRUE(reader.Init(log));
+  base::TimeDelta offset;
+  base::StringPiece data;
+  ASSERT_TRUE(reader.NextChunk(&offset, &data));
+  EXPECT_EQ("foo", data.as_string());
+  EXPECT_FALSE(reader.NextChunk(&offset, &data));
+  EXPECT_FALSE(reader.truncated());
+}
+
+TEST_F(SessionCaptureTest, TruncatedLog) {
+  const char* const chunks[] = {"foo", "barbaz"};
+  bool full = true;
+  std::string log = WriteLog(1000, chunks, arraysize(chunks), &full);
+  log.resize(log.size() - 2);
+
+  mod_spdy::SessionCaptureReader reader;
+  ASSERT_TRUE(reader.Init(log));
+  base::TimeDelta offset;
+  base::StringPiece data;
+  ASSERT_TRUE(reader.NextChunk(&offset, &data));
+  EXPECT_EQ("foo", data.as_string());
+  EXPECT_FALSE(reader.NextChunk(&offset, &data));
+  EXPECT_TRUE(reader.truncated());
+}
+
+TEST_F(SessionCaptureTest, NotACaptureLog) {
+  mod_spdy::SessionCaptureReader reader;
+  EXPECT_FALSE(reader.Init(""));
+  EXPECT_FALSE(reader.Init("SPDYCAP"));
+  EXPECT_FALSE(reader.Init("GET / HTTP/1.1\r\n"));
+  // Unknown SPDY version:
+  EXPECT_FALSE(reader.Init(base::StringPiece("SPDYCAP1\x04\x01", 10)));
+  // Missing start time:
+  EXPECT_FALSE(reader.Init(base::StringPiece("SPDYCAP1\x03", 9)));
+  EXPECT_TRUE(reader.Init(base::StringPiece("SPDYCAP1\x03\x01", 10)));
+  EXPECT_EQ(mod_spdy::spdy::SPDY_VERSION_3, reader.spdy_version());
+}
+
+}  // namespace
@@ -15,8 +15,8 @@
 #include "mod_spdy/common/shared_flow_control_window.h"
 
 #include "base/logging.h"
-#include "base/synchronization/condition_variable.h"
-#include "base/synchronization/lock.h"
+#include "mod_spdy/common/receive_window_tuner.h"
+#include "mod_spdy/common/scoreboard.h"
 #include "mod_spdy/common/spdy_frame_priority_queue.h"
 #include "net/spdy/spdy_protocol.h"
 
@@ -24,7 +24,9 @@ namespace mod_spdy {
 
 SharedFlowControlWindow::SharedFlowControlWindow(
     int32 initial_input_window_size, int32 initial_output_window_size)
-    : condvar_(&lock_),
+    : scoreboard_session_(Scoreboard::kNoSession),
+      lock_("SharedFlowControlWindow::lock_"),
+      condvar_(&lock_),
       aborted_(false),
       init_input_window_size_(initial_input_window_size),
       input_window_size_(initial_input_window_size),
@@ -34,33 +36,38 @@ SharedFlowControlWindow::SharedFlowControlWindow(
 SharedFlowControlWindow::~SharedFlowControlWindow() {}
 
 void SharedFlowControlWindow::Abort() {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   aborted_ = true;
   condvar_.Broadcast();
 }
 
 bool SharedFlowControlWindow::is_aborted() const {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   return aborted_;
 }
 
 int32 SharedFlowControlWindow::current_input_window_size() const {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   return input_window_size_;
 }
 
 int32 SharedFlowControlWindow::current_output_window_size() const {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   return output_window_size_;
 }
 
+int32 SharedFlowControlWindow::current_input_window_target() const {
+  ProfiledAutoLock autolock(lock_);
+  return InputWindowTarget();
+}
+
 int32 SharedFlowControlWindow::input_bytes_consumed() const {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   return input_bytes_consumed_;
 }
 
 bool SharedFlowControlWindow::OnReceiveInputData(size_t length) {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   if (aborted_) {
     return true;
   }
@@ -73,7 +80,7 @@ bool SharedFlowControlWindow::OnReceiveInputData(size_t length) {
 }
 
 int32 SharedFlowControlWindow::OnInputDataConsumed(size_t length) {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   if (aborted_) {
     return 0;
   }
@@ -87,22 +94,28 @@ int32 SharedFlowControlWindow::OnInputDataConsumed(size_t length) {
     const int64 new_input_bytes_consumed =
         static_cast<int64>(input_bytes_consumed_) + static_cast<int64>(length);
     CHECK_LE(new_input_bytes_consumed,
-             static_cast<int64>(init_input_window_size_));
+             static_cast<int64>(InputWindowTarget()));
     CHECK_LE(new_input_bytes_consumed + static_cast<int64>(input_window_size_),
-             static_cast<int64>(init_input_window_size_));
+             static_cast<int64>(InputWindowTarget()));
     input_bytes_consumed_ = new_input_bytes_consumed;
   }
 
   // Only send a WINDOW_UPDATE when we've consumed 1/16 of the maximum shared
   // window size, so that we don't send lots of small WINDOW_UDPATE frames.
-  if (input_bytes_consumed_ < init_input_window_size_ / 16) {
+  if (input_bytes_consumed_ < InputWindowTarget() / 16) {
     return 0;
-  } else {
-    input_window_size_ += input_bytes_consumed_;
-    const int32 consumed = input_bytes_consumed_;
-    input_bytes_consumed_ = 0;
-    return consumed;
   }
+
+  // If we're tuning the window, the update may be bigger or smaller than
+  // what we've consumed, so as to grow or shrink the window.
+  const int32 update = (input_window_tuner_ == NULL ? input_bytes_consumed_ :
+                        input_window_tuner_->ComputeWindowUpdate(
+                            input_bytes_consumed_, round_trip_time_,
+                            base::TimeTicks::Now()));
+  input_window_size_ += update;
+  input_bytes_consumed_ = 0;
+  DCHECK_LE(input_window_size_, InputWindowTarget());
+  return update;
 }
 
 void SharedFlowControlWindow::OnInputDataConsumedSendUpdateIfNeeded(
@@ -115,11 +128,15 @@ void SharedFlowControlWindow::OnInputDataConsumedSendUpdateIfNeeded(
 }
 
 int32 SharedFlowControlWindow::RequestOutputQuota(int32 amount_requested) {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   DCHECK_GT(amount_requested, 0);
 
-  while (!aborted_ && output_window_size_ <= 0) {
-    condvar_.Wait();
+  if (!aborted_ && output_window_size_ <= 0) {
+    Scoreboard::AddIfEnabled(scoreboard_session_,
+                             Scoreboard::SESSION_WINDOW_STALLS, 1);
+    while (!aborted_ && output_window_size_ <= 0) {
+      condvar_.Wait();
+    }
   }
 
   if (aborted_) {
@@ -134,8 +151,36 @@ int32 SharedFlowControlWindow::RequestOutputQuota(int32 amount_requested) {
   return amount_to_give;
 }
 
+void SharedFlowControlWindow::EnableInputWindowTuning(
+    int32 max_window_size, ReceiveWindowBudget* budget) {
+  ProfiledAutoLock autolock(lock_);
+  DCHECK(input_window_tuner_ == NULL);
+  input_window_tuner_.reset(new ReceiveWindowTuner(
+      init_input_window_size_, max_window_size, budget));
+}
+
+base::TimeDelta SharedFlowControlWindow::round_trip_time() const {
+  ProfiledAutoLock autolock(lock_);
+  return round_trip_time_;
+}
+
+void SharedFlowControlWindow::set_round_trip_time(base::TimeDelta rtt) {
+  ProfiledAutoLock autolock(lock_);
+  round_trip_time_ = rtt;
+}
+
+bool SharedFlowControlWindow::TryRequestOutputQuota(int32 amount_requested) {
+  ProfiledAutoLock autolock(lock_);
+  DCHECK_GT(amount_requested, 0);
+  if (aborted_ || output_window_size_ < amount_requested) {
+    return false;
+  }
+  output_window_size_ -= amount_requested;
+  return true;
+}
+
 bool SharedFlowControlWindow::IncreaseOutputWindowSize(int32 delta) {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   DCHECK_GE(delta, 0);
   if (aborted_) {
     return true;
@@ -158,4 +203,10 @@ bool SharedFlowControlWindow::IncreaseOutputWindowSize(int32 delta) {
   return true;
 }
 
+int32 SharedFlowControlWindow::InputWindowTarget() const {
+  lock_.AssertAcquired();
+  return (input_window_tuner_ == NULL ? init_input_window_size_ :
+          input_window_tuner_->window_size());
+}
+
 }  // namespace mod_spdy
@@ -17,11 +17,14 @@
 
 #include "base/basictypes.h"
 #include "base/compiler_specific.h"
-#include "base/synchronization/condition_variable.h"
-#include "base/synchronization/lock.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/time/time.h"
+#include "mod_spdy/common/profiled_lock.h"
 
 namespace mod_spdy {
 
+class ReceiveWindowBudget;
+class ReceiveWindowTuner;
 class SpdyFramePriorityQueue;
 
 // SPDY/3.1 introduces an additional session-wide flow control window shared by
@@ -47,6 +50,10 @@ class SharedFlowControlWindow {
   // useful for testing/debugging.
   int32 current_input_window_size() const;
   int32 current_output_window_size() const;
+  // Get the size the input window will have once the client has been told
+  // about all the data we've consumed; with input window tuning, this may
+  // differ from the initial size.
+  int32 current_input_window_target() const;
   // How many input bytes have been consumed that _haven't_ yet been
   // acknowledged by a WINDOW_UPDATE (signaled by OnInputDataConsumed)?  This
   // is primarily useful for testing/debugging.
@@ -81,6 +88,14 @@ class SharedFlowControlWindow {
   // aborted, returns zero.  The `amount_requested` must be strictly positive.
   int32 RequestOutputQuota(int32 amount_requested) WARN_UNUSED_RESULT;
 
+  // Like RequestOutputQuota, but never blocks, and never consumes a partial
+  // amount: if the window currently holds at least `amount_requested` bytes,
+  // consume exactly that many and return true; otherwise, leave the window
+  // alone and return false.  This is for the connection thread, which must
+  // not wait for a WINDOW_UPDATE that only it can process.  If the
+  // SharedFlowControlWindow is aborted, returns false.
+  bool TryRequestOutputQuota(int32 amount_requested) WARN_UNUSED_RESULT;
+
   // This should be called by the connection thread to adjust the window size,
   // due to receiving a WINDOW_UPDATE frame from the client.  The delta
   // argument must be non-negative (WINDOW_UPDATE is never negative).  Return
@@ -90,14 +105,39 @@ class SharedFlowControlWindow {
   // aborted, returns true with no effect.
   bool IncreaseOutputWindowSize(int32 delta) WARN_UNUSED_RESULT;
 
+  // Allow the input window to grow beyond its initial size, up to
+  // max_window_size, when the client uploads faster than the initial window
+  // allows (see ReceiveWindowTuner).  Growth is reserved from the given
+  // budget, which must outlive this object.  This must be called before any
+  // stream threads start running.
+  void EnableInputWindowTuning(int32 max_window_size,
+                               ReceiveWindowBudget* budget);
+
+  // Get/set the round trip time most recently measured for the connection,
+  // or zero if it hasn't been measured.  Input window tuning (for the session
+  // and for each stream) depends on this.
+  base::TimeDelta round_trip_time() const;
+  void set_round_trip_time(base::TimeDelta rtt);
+
+  // Set the Scoreboard session slot to which waits for output quota should
+  // be counted.  This must be called before any stream threads start running.
+  void set_scoreboard_session(int session) { scoreboard_session_ = session; }
+
  private:
-  mutable base::Lock lock_;  // protects the below fields
-  base::ConditionVariable condvar_;
+  // Return the size the input window should have once the client has been
+  // told about all the data we've consumed.  Requires lock_ to be held.
+  int32 InputWindowTarget() const;
+
+  int scoreboard_session_;  // set before use, so needs no lock
+  mutable ProfiledLock lock_;  // protects the below fields
+  ProfiledConditionVariable condvar_;
   bool aborted_;
   const int32 init_input_window_size_;
   int32 input_window_size_;
   int32 input_bytes_consumed_;
   int32 output_window_size_;
+  scoped_ptr<ReceiveWindowTuner> input_window_tuner_;  // NULL if not tuning
+  base::TimeDelta round_trip_time_;
 
   DISALLOW_COPY_AND_ASSIGN(SharedFlowControlWindow);
 };
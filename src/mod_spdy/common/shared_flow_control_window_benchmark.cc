@@ -0,0 +1,136 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/shared_flow_control_window.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/stl_util.h"
+#include "base/threading/platform_thread.h"
+#include "mod_spdy/common/testing/benchmark.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace {
+
+const int32 kFrameSize = 4096;
+const int kNumStreamThreads = 4;
+
+// Requests output quota a frame at a time, as a stream thread sending a
+// response would.
+class StreamThread : public base::PlatformThread::Delegate {
+ public:
+  StreamThread(mod_spdy::SharedFlowControlWindow* window, int64 num_frames)
+      : window_(window), num_frames_(num_frames) {}
+  virtual ~StreamThread() {}
+
+  virtual void ThreadMain() {
+    for (int64 i = 0; i < num_frames_; ++i) {
+      int32 remaining = kFrameSize;
+      while (remaining > 0) {
+        const int32 quota = window_->RequestOutputQuota(remaining);
+        if (quota <= 0) {
+          return;  // aborted
+        }
+        remaining -= quota;
+      }
+    }
+  }
+
+ private:
+  mod_spdy::SharedFlowControlWindow* const window_;
+  const int64 num_frames_;
+
+  DISALLOW_COPY_AND_ASSIGN(StreamThread);
+};
+
+// Each iteration takes one frame's worth of output quota and returns it, as
+// the client's WINDOW_UPDATE would, with no contention.
+MOD_SPDY_BENCHMARK(BM_SharedFlowControlWindow_OutputQuota) {
+  mod_spdy::SharedFlowControlWindow window(
+      net::kSpdyStreamInitialWindowSize, net::kSpdyStreamInitialWindowSize);
+  for (int64 i = 0; i < state->iterations(); ++i) {
+    const int32 quota = window.RequestOutputQuota(kFrameSize);
+    if (!window.IncreaseOutputWindowSize(quota)) {
+      break;
+    }
+  }
+  state->SetBytesProcessed(state->iterations() * kFrameSize);
+}
+
+// Each iteration accounts for one frame of input data being received and
+// consumed.
+MOD_SPDY_BENCHMARK(BM_SharedFlowControlWindow_InputAccounting) {
+  mod_spdy::SharedFlowControlWindow window(
+      net::kSpdyStreamInitialWindowSize, net::kSpdyStreamInitialWindowSize);
+  int64 updates = 0;
+  for (int64 i = 0; i < state->iterations(); ++i) {
+    if (!window.OnReceiveInputData(kFrameSize)) {
+      break;
+    }
+    if (window.OnInputDataConsumed(kFrameSize) > 0) {
+      ++updates;
+    }
+  }
+  state->SetBytesProcessed(state->iterations() * kFrameSize);
+  state->SetItemsProcessed(updates);
+}
+
+// Several stream threads compete for output quota, while this thread plays
+// the connection thread, topping the window up as the client would.  Each
+// iteration is one frame's worth of quota.
+MOD_SPDY_BENCHMARK(BM_SharedFlowControlWindow_Contended) {
+  state->PauseTiming();
+  mod_spdy::SharedFlowControlWindow window(
+      net::kSpdyStreamInitialWindowSize, net::kSpdyStreamInitialWindowSize);
+  const int64 frames_per_thread =
+      std::max<int64>(1, state->iterations() / kNumStreamThreads);
+  const int64 total_bytes =
+      frames_per_thread * kNumStreamThreads * kFrameSize;
+  std::vector<StreamThread*> threads;
+  std::vector<base::PlatformThreadHandle> handles(kNumStreamThreads);
+  for (int i = 0; i < kNumStreamThreads; ++i) {
+    threads.push_back(new StreamThread(&window, frames_per_thread));
+  }
+  state->ResumeTiming();
+
+  for (int i = 0; i < kNumStreamThreads; ++i) {
+    base::PlatformThread::Create(0, threads[i], &handles[i]);
+  }
+  // Grant a WINDOW_UPDATE whenever half the window has been used, until the
+  // threads have been granted everything they need.
+  const int32 update_size = net::kSpdyStreamInitialWindowSize / 2;
+  int64 granted = net::kSpdyStreamInitialWindowSize;
+  while (granted < total_bytes) {
+    if (window.current_output_window_size() <= update_size) {
+      if (!window.IncreaseOutputWindowSize(update_size)) {
+        break;
+      }
+      granted += update_size;
+    } else {
+      base::PlatformThread::YieldCurrentThread();
+    }
+  }
+  for (int i = 0; i < kNumStreamThreads; ++i) {
+    base::PlatformThread::Join(handles[i]);
+  }
+
+  state->PauseTiming();
+  STLDeleteElements(&threads);
+  state->ResumeTiming();
+  state->SetBytesProcessed(total_bytes);
+}
+
+}  // namespace
@@ -15,6 +15,8 @@
 #include "mod_spdy/common/shared_flow_control_window.h"
 
 #include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+#include "mod_spdy/common/receive_window_tuner.h"
 #include "mod_spdy/common/spdy_frame_priority_queue.h"
 #include "mod_spdy/common/testing/async_task_runner.h"
 #include "mod_spdy/common/testing/notification.h"
@@ -111,6 +113,30 @@ TEST(SharedFlowControlWindowTest, ConsumeInputSendUpdate) {
   ASSERT_FALSE(queue.Pop(&raw_frame));
 }
 
+// Test that with input window tuning enabled, but no round trip time measured
+// yet, the input window behaves as before, and that budget reserved by the
+// window is returned when the window goes away.
+TEST(SharedFlowControlWindowTest, ConsumeInputWithTuning) {
+  mod_spdy::ReceiveWindowBudget budget(1000000);
+  {
+    mod_spdy::SharedFlowControlWindow shared_window(1000, 1000);
+    shared_window.EnableInputWindowTuning(100000, &budget);
+    EXPECT_EQ(base::TimeDelta(), shared_window.round_trip_time());
+
+    EXPECT_TRUE(shared_window.OnReceiveInputData(1000));
+    EXPECT_EQ(1000, shared_window.OnInputDataConsumed(1000));
+    EXPECT_EQ(1000, shared_window.current_input_window_size());
+    EXPECT_EQ(1000, shared_window.current_input_window_target());
+
+    shared_window.set_round_trip_time(base::TimeDelta::FromMilliseconds(50));
+    EXPECT_EQ(base::TimeDelta::FromMilliseconds(50),
+              shared_window.round_trip_time());
+    EXPECT_TRUE(shared_window.OnReceiveInputData(1000));
+    EXPECT_FALSE(shared_window.OnReceiveInputData(1));
+  }
+  EXPECT_EQ(0, budget.reserved_bytes());
+}
+
 // Test basic usage of RequestOutputQuota and IncreaseOutputWindowSize.
 TEST(SharedFlowControlWindowTest, OutputBasic) {
   mod_spdy::SharedFlowControlWindow shared_window(1000, 1000);
@@ -140,6 +166,27 @@ TEST(SharedFlowControlWindowTest, OutputBasic) {
   EXPECT_EQ(0, shared_window.RequestOutputQuota(9999));
 }
 
+// Test that TryRequestOutputQuota consumes quota only when it can have all of
+// what it asks for.
+TEST(SharedFlowControlWindowTest, TryOutput) {
+  mod_spdy::SharedFlowControlWindow shared_window(1000, 1000);
+  EXPECT_TRUE(shared_window.TryRequestOutputQuota(800));
+  EXPECT_EQ(200, shared_window.current_output_window_size());
+
+  EXPECT_FALSE(shared_window.TryRequestOutputQuota(201));
+  EXPECT_EQ(200, shared_window.current_output_window_size());
+
+  EXPECT_TRUE(shared_window.TryRequestOutputQuota(200));
+  EXPECT_EQ(0, shared_window.current_output_window_size());
+
+  // An empty window makes it fail rather than block.
+  EXPECT_FALSE(shared_window.TryRequestOutputQuota(1));
+
+  EXPECT_TRUE(shared_window.IncreaseOutputWindowSize(500));
+  shared_window.Abort();
+  EXPECT_FALSE(shared_window.TryRequestOutputQuota(100));
+}
+
 // When run, a RequestOutputQuotaTask requests quota from the given
 // SharedFlowControlWindow.
 class RequestOutputQuotaTask : public mod_spdy::testing::AsyncTaskRunner::Task {
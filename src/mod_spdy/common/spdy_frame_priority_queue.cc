@@ -19,15 +19,14 @@
 
 #include "base/logging.h"
 #include "base/stl_util.h"
-#include "base/synchronization/condition_variable.h"
-#include "base/synchronization/lock.h"
 #include "base/time/time.h"
+#include "mod_spdy/common/trace_log.h"
 #include "net/spdy/spdy_protocol.h"
 
 namespace mod_spdy {
 
 SpdyFramePriorityQueue::SpdyFramePriorityQueue()
-    : condvar_(&lock_) {}
+    : lock_("SpdyFramePriorityQueue::lock_"), condvar_(&lock_), size_(0) {}
 
 SpdyFramePriorityQueue::~SpdyFramePriorityQueue() {
   for (QueueMap::iterator iter = queue_map_.begin();
@@ -39,14 +38,19 @@ SpdyFramePriorityQueue::~SpdyFramePriorityQueue() {
 }
 
 bool SpdyFramePriorityQueue::IsEmpty() const {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   return queue_map_.empty();
 }
 
+size_t SpdyFramePriorityQueue::size() const {
+  ProfiledAutoLock autolock(lock_);
+  return size_;
+}
+
 const int SpdyFramePriorityQueue::kTopPriority = -1;
 
 void SpdyFramePriorityQueue::Insert(int priority, net::SpdyFrameIR* frame) {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   DCHECK(frame);
 
   // Get the frame list for the given priority; if it doesn't currently exist,
@@ -64,31 +68,36 @@ void SpdyFramePriorityQueue::Insert(int priority, net::SpdyFrameIR* frame) {
   // Add the frame to the end of the list, and wake up at most one thread
   // sleeping on a BlockingPop.
   list->push_back(frame);
+  ++size_;
+  MOD_SPDY_TRACE_INSTANT1("frame_queue", "Insert", "priority", priority);
   condvar_.Signal();
 }
 
 bool SpdyFramePriorityQueue::Pop(net::SpdyFrameIR** frame) {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   return InternalPop(frame);
 }
 
 bool SpdyFramePriorityQueue::BlockingPop(const base::TimeDelta& max_time,
                                          net::SpdyFrameIR** frame) {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   DCHECK(frame);
 
   const base::TimeDelta zero = base::TimeDelta();
   base::TimeDelta time_remaining = max_time;
-  while (time_remaining > zero && queue_map_.empty()) {
-    // TODO(mdsteele): It appears from looking at the Chromium source code that
-    // HighResNow() is "expensive" on Windows (how expensive, I am not sure);
-    // however, the other options for getting a "now" time either don't
-    // guarantee monotonicity (so time might go backwards) or might be too
-    // low-resolution for our purposes, so I think we'd better stick with this
-    // for now.  But is there a better way to do what we're doing here?
-    const base::TimeTicks start = base::TimeTicks::HighResNow();
-    condvar_.TimedWait(time_remaining);
-    time_remaining -= base::TimeTicks::HighResNow() - start;
+  if (time_remaining > zero && queue_map_.empty()) {
+    MOD_SPDY_TRACE_EVENT0("frame_queue", "BlockingPop");
+    while (time_remaining > zero && queue_map_.empty()) {
+      // TODO(mdsteele): It appears from looking at the Chromium source code
+      // that HighResNow() is "expensive" on Windows (how expensive, I am not
+      // sure); however, the other options for getting a "now" time either don't
+      // guarantee monotonicity (so time might go backwards) or might be too
+      // low-resolution for our purposes, so I think we'd better stick with this
+      // for now.  But is there a better way to do what we're doing here?
+      const base::TimeTicks start = base::TimeTicks::HighResNow();
+      condvar_.TimedWait(time_remaining);
+      time_remaining -= base::TimeTicks::HighResNow() - start;
+    }
   }
 
   return InternalPop(frame);
@@ -108,6 +117,7 @@ bool SpdyFramePriorityQueue::InternalPop(net::SpdyFrameIR** frame) {
   DCHECK(!list->empty());
   *frame = list->front();
   list->pop_front();
+  --size_;
   // If the list is now empty, we have to delete it from the map to maintain
   // the invariant.
   if (list->empty()) {
@@ -19,8 +19,7 @@
 #include <map>
 
 #include "base/basictypes.h"
-#include "base/synchronization/condition_variable.h"
-#include "base/synchronization/lock.h"
+#include "mod_spdy/common/profiled_lock.h"
 
 namespace base { class TimeDelta; }
 
@@ -44,6 +43,10 @@ class SpdyFramePriorityQueue {
   // returns.)
   bool IsEmpty() const;
 
+  // Return the number of frames currently in the queue.  (The same caveat
+  // applies as for IsEmpty().)
+  size_t size() const;
+
   // A priority value that is more important than any priority normally used
   // for sending SPDY frames.
   static const int kTopPriority;
@@ -72,8 +75,8 @@ class SpdyFramePriorityQueue {
   // Same as Pop(), but requires lock_ to be held.
   bool InternalPop(net::SpdyFrameIR** frame);
 
-  mutable base::Lock lock_;
-  base::ConditionVariable condvar_;
+  mutable ProfiledLock lock_;
+  ProfiledConditionVariable condvar_;
   // We use a map of lists to store frames, to guarantee that frames of the
   // same priority are stored in FIFO order.  A simpler implementation would be
   // to just use a multimap, which in practice is nearly always implemented
@@ -86,6 +89,8 @@ class SpdyFramePriorityQueue {
   typedef std::list<net::SpdyFrameIR*> FrameList;
   typedef std::map<int, FrameList*> QueueMap;
   QueueMap queue_map_;
+  // The total number of frames in all the lists.
+  size_t size_;
 
   DISALLOW_COPY_AND_ASSIGN(SpdyFramePriorityQueue);
 };
@@ -0,0 +1,109 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/spdy_frame_priority_queue.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/stl_util.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+#include "mod_spdy/common/testing/benchmark.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace {
+
+// How many stream threads insert frames concurrently in the contended
+// benchmark.
+const int kNumProducers = 4;
+
+// Inserts frames into the queue, as a stream thread would.
+class Producer : public base::PlatformThread::Delegate {
+ public:
+  Producer(mod_spdy::SpdyFramePriorityQueue* queue, int priority,
+           int64 num_frames)
+      : queue_(queue), priority_(priority), num_frames_(num_frames) {}
+  virtual ~Producer() {}
+
+  virtual void ThreadMain() {
+    for (int64 i = 0; i < num_frames_; ++i) {
+      queue_->Insert(priority_, new net::SpdyPingIR(i));
+    }
+  }
+
+ private:
+  mod_spdy::SpdyFramePriorityQueue* const queue_;
+  const int priority_;
+  const int64 num_frames_;
+
+  DISALLOW_COPY_AND_ASSIGN(Producer);
+};
+
+// Each iteration inserts eight frames at mixed priorities and pops them all,
+// with no other threads involved.
+MOD_SPDY_BENCHMARK(BM_SpdyFramePriorityQueue_InsertPop) {
+  mod_spdy::SpdyFramePriorityQueue queue;
+  for (int64 i = 0; i < state->iterations(); ++i) {
+    for (int j = 0; j < 8; ++j) {
+      queue.Insert(j % 4, new net::SpdyPingIR(j));
+    }
+    net::SpdyFrameIR* frame = NULL;
+    while (queue.Pop(&frame)) {
+      delete frame;
+    }
+  }
+  state->SetItemsProcessed(state->iterations() * 8);
+}
+
+// Several stream threads insert frames while the connection thread pops
+// them, as happens when many streams are responding at once.  Each iteration
+// is one frame passing through the queue.
+MOD_SPDY_BENCHMARK(BM_SpdyFramePriorityQueue_Contended) {
+  state->PauseTiming();
+  mod_spdy::SpdyFramePriorityQueue queue;
+  const int64 frames_per_producer =
+      std::max<int64>(1, state->iterations() / kNumProducers);
+  const int64 total_frames = frames_per_producer * kNumProducers;
+  std::vector<Producer*> producers;
+  std::vector<base::PlatformThreadHandle> handles(kNumProducers);
+  for (int i = 0; i < kNumProducers; ++i) {
+    producers.push_back(new Producer(&queue, i, frames_per_producer));
+  }
+  state->ResumeTiming();
+
+  for (int i = 0; i < kNumProducers; ++i) {
+    base::PlatformThread::Create(0, producers[i], &handles[i]);
+  }
+  const base::TimeDelta max_wait = base::TimeDelta::FromMilliseconds(10);
+  for (int64 popped = 0; popped < total_frames; ) {
+    net::SpdyFrameIR* frame = NULL;
+    if (queue.BlockingPop(max_wait, &frame)) {
+      delete frame;
+      ++popped;
+    }
+  }
+  for (int i = 0; i < kNumProducers; ++i) {
+    base::PlatformThread::Join(handles[i]);
+  }
+
+  state->PauseTiming();
+  STLDeleteElements(&producers);
+  state->ResumeTiming();
+  state->SetItemsProcessed(total_frames);
+}
+
+}  // namespace
@@ -36,6 +36,7 @@ void ExpectPop(net::SpdyPingId expected,
 
 void ExpectEmpty(mod_spdy::SpdyFramePriorityQueue* queue) {
   EXPECT_TRUE(queue->IsEmpty());
+  EXPECT_EQ(0u, queue->size());
   net::SpdyFrameIR* frame = NULL;
   EXPECT_FALSE(queue->Pop(&frame));
   EXPECT_TRUE(frame == NULL);
@@ -52,6 +53,7 @@ TEST(SpdyFramePriorityQueueTest, InsertSpdy2) {
   queue.Insert(3, new net::SpdyPingIR(4));
   queue.Insert(0, new net::SpdyPingIR(1));
   queue.Insert(3, new net::SpdyPingIR(3));
+  EXPECT_EQ(3u, queue.size());
 
   ExpectPop(1, &queue);
   ExpectPop(4, &queue);
@@ -59,6 +61,7 @@ TEST(SpdyFramePriorityQueueTest, InsertSpdy2) {
   queue.Insert(2, new net::SpdyPingIR(2));
   queue.Insert(1, new net::SpdyPingIR(6));
   queue.Insert(1, new net::SpdyPingIR(5));
+  EXPECT_EQ(4u, queue.size());
 
   ExpectPop(6, &queue);
   ExpectPop(5, &queue);
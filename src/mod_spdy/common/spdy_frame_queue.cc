@@ -16,69 +16,166 @@
 
 #include <list>
 
+#include "base/atomicops.h"
 #include "base/logging.h"
 #include "base/stl_util.h"
-#include "base/synchronization/condition_variable.h"
-#include "base/synchronization/lock.h"
 #include "net/spdy/spdy_protocol.h"
 
 namespace mod_spdy {
 
 SpdyFrameQueue::SpdyFrameQueue()
-    : condvar_(&lock_), is_aborted_(false) {}
+    : added_(0),
+      removed_(0),
+      is_aborted_(0),
+      consumer_waiting_(0),
+      overflowed_(0),
+      lock_("SpdyFrameQueue::lock_"),
+      condvar_(&lock_) {}
 
 SpdyFrameQueue::~SpdyFrameQueue() {
-  STLDeleteContainerPointers(queue_.begin(), queue_.end());
+  DeleteQueuedFrames();
 }
 
 bool SpdyFrameQueue::is_aborted() const {
-  base::AutoLock autolock(lock_);
-  return is_aborted_;
+  return base::subtle::Acquire_Load(&is_aborted_) != 0;
 }
 
 void SpdyFrameQueue::Abort() {
-  base::AutoLock autolock(lock_);
-  is_aborted_ = true;
-  STLDeleteContainerPointers(queue_.begin(), queue_.end());
-  queue_.clear();
+  base::subtle::Release_Store(&is_aborted_, 1);
+  // If an Insert() on another thread misses the flag, the next Pop() or the
+  // destructor will delete its frame.
+  DeleteQueuedFrames();
+  ProfiledAutoLock autolock(lock_);
   condvar_.Broadcast();
 }
 
 void SpdyFrameQueue::Insert(net::SpdyFrameIR* frame) {
-  base::AutoLock autolock(lock_);
   DCHECK(frame);
-
-  if (is_aborted_) {
-    DCHECK(queue_.empty());
+  if (is_aborted()) {
     delete frame;
+    return;
+  }
+
+  const uint32 added =
+      static_cast<uint32>(base::subtle::NoBarrier_Load(&added_));
+  const uint32 removed =
+      static_cast<uint32>(base::subtle::Acquire_Load(&removed_));
+  if (base::subtle::NoBarrier_Load(&overflowed_) == 0 &&
+      added - removed < kRingCapacity) {
+    base::subtle::NoBarrier_Store(
+        &ring_[added & (kRingCapacity - 1)],
+        reinterpret_cast<base::subtle::AtomicWord>(frame));
+    base::subtle::Release_Store(
+        &added_, static_cast<base::subtle::Atomic32>(added + 1));
   } else {
-    if (queue_.empty()) {
-      condvar_.Signal();
-    }
-    queue_.push_front(frame);
+    // The ring is full (or was recently), so the consumer has fallen well
+    // behind; it's fine to take the lock.
+    ProfiledAutoLock autolock(lock_);
+    overflow_.push_back(frame);
+    base::subtle::NoBarrier_Store(&overflowed_, 1);
+  }
+
+  // Wake the consumer, but only if it is waiting.  The barrier pairs with the
+  // one in Pop(), so that either we see that the consumer is waiting, or it
+  // sees our frame before it waits.  Clearing the flag means that we signal
+  // once per wait, rather than for every frame inserted before the consumer
+  // gets to run.
+  base::subtle::MemoryBarrier();
+  if (base::subtle::NoBarrier_Load(&consumer_waiting_) != 0 &&
+      base::subtle::NoBarrier_AtomicExchange(&consumer_waiting_, 0) != 0) {
+    ProfiledAutoLock autolock(lock_);
+    condvar_.Signal();
   }
 }
 
 bool SpdyFrameQueue::Pop(bool block, net::SpdyFrameIR** frame) {
-  base::AutoLock autolock(lock_);
   DCHECK(frame);
+  while (true) {
+    if (is_aborted()) {
+      // Delete any frame from an Insert() that raced with the Abort().
+      DeleteQueuedFrames();
+      return false;
+    }
+    if (TryPop(frame)) {
+      return true;
+    }
+    if (!block) {
+      return false;
+    }
 
-  if (block) {
     // Block until the queue is nonempty or we abort.
-    while (queue_.empty() && !is_aborted_) {
+    ProfiledAutoLock autolock(lock_);
+    base::subtle::NoBarrier_Store(&consumer_waiting_, 1);
+    base::subtle::MemoryBarrier();
+    if (RingIsEmpty() && overflow_.empty() && !is_aborted()) {
       condvar_.Wait();
     }
+    base::subtle::NoBarrier_Store(&consumer_waiting_, 0);
   }
+}
 
-  // If we've aborted, the queue should now be empty.
-  DCHECK(!is_aborted_ || queue_.empty());
-  if (queue_.empty()) {
+bool SpdyFrameQueue::TryPop(net::SpdyFrameIR** frame) {
+  if (TryPopFromRing(frame)) {
+    return true;
+  }
+  // The producer only uses overflow_ while the ring is full, and stops using
+  // it only once we've emptied it, so if the ring is empty the next frame (if
+  // any) is at the front of overflow_.
+  if (base::subtle::NoBarrier_Load(&overflowed_) == 0) {
     return false;
   }
-
-  *frame = queue_.back();
-  queue_.pop_back();
+  ProfiledAutoLock autolock(lock_);
+  if (!RingIsEmpty() || overflow_.empty()) {
+    // Either the producer switched back to the ring since we looked, or
+    // another thread took the frame.
+    return TryPopFromRing(frame);
+  }
+  *frame = overflow_.front();
+  overflow_.pop_front();
+  if (overflow_.empty()) {
+    base::subtle::NoBarrier_Store(&overflowed_, 0);
+  }
   return true;
 }
 
+bool SpdyFrameQueue::TryPopFromRing(net::SpdyFrameIR** frame) {
+  while (true) {
+    const uint32 removed =
+        static_cast<uint32>(base::subtle::Acquire_Load(&removed_));
+    const uint32 added =
+        static_cast<uint32>(base::subtle::Acquire_Load(&added_));
+    if (removed == added) {
+      return false;
+    }
+    // The producer won't reuse this slot until removed_ moves past it, so if
+    // our compare-and-swap succeeds, what we read was the frame it put there.
+    // (The release ordering keeps the read before the slot is handed back.)
+    const base::subtle::AtomicWord candidate =
+        base::subtle::NoBarrier_Load(&ring_[removed & (kRingCapacity - 1)]);
+    if (base::subtle::Release_CompareAndSwap(
+            &removed_, static_cast<base::subtle::Atomic32>(removed),
+            static_cast<base::subtle::Atomic32>(removed + 1)) ==
+        static_cast<base::subtle::Atomic32>(removed)) {
+      *frame = reinterpret_cast<net::SpdyFrameIR*>(candidate);
+      return true;
+    }
+  }
+}
+
+void SpdyFrameQueue::DeleteQueuedFrames() {
+  net::SpdyFrameIR* frame = NULL;
+  while (TryPopFromRing(&frame)) {
+    delete frame;
+  }
+  ProfiledAutoLock autolock(lock_);
+  STLDeleteContainerPointers(overflow_.begin(), overflow_.end());
+  overflow_.clear();
+  base::subtle::NoBarrier_Store(&overflowed_, 0);
+}
+
+bool SpdyFrameQueue::RingIsEmpty() const {
+  return (base::subtle::Acquire_Load(&added_) ==
+          base::subtle::Acquire_Load(&removed_));
+}
+
 }  // namespace mod_spdy
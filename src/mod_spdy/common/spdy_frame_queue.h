@@ -17,17 +17,20 @@
 
 #include <list>
 
+#include "base/atomicops.h"
 #include "base/basictypes.h"
-#include "base/synchronization/condition_variable.h"
-#include "base/synchronization/lock.h"
+#include "mod_spdy/common/profiled_lock.h"
 
 namespace net { class SpdyFrameIR; }
 
 namespace mod_spdy {
 
-// A simple FIFO queue of SPDY frames, intended for sending input frames from
-// the SPDY connection thread to a SPDY stream thread.  This class is
-// thread-safe -- all methods may be called concurrently by multiple threads.
+// A FIFO queue of SPDY frames, for sending input frames from the SPDY
+// connection thread to a SPDY stream thread.  Only one thread at a time may
+// call Insert() (the producer), but the other methods may be called
+// concurrently by any thread.  Insert() and Pop() don't take a lock unless
+// the queue has overflowed its ring buffer or the consumer is blocked waiting
+// for a frame.
 class SpdyFrameQueue {
  public:
   // Create an initially-empty queue.
@@ -38,9 +41,10 @@ class SpdyFrameQueue {
   bool is_aborted() const;
 
   // Abort the queue.  All frames held by the queue will be deleted; future
-  // frames passed to Insert() will be immediately deleted; future calls to
-  // Pop() will fail immediately; and current blocking calls to Pop will
-  // immediately unblock and fail.
+  // frames passed to Insert() will be deleted (immediately, or by the next
+  // Pop() if the Insert() races with the Abort()); future calls to Pop() will
+  // fail immediately; and current blocking calls to Pop will immediately
+  // unblock and fail.
   void Abort();
 
   // Insert a frame into the queue.  The queue takes ownership of the frame,
@@ -55,13 +59,40 @@ class SpdyFrameQueue {
   bool Pop(bool block, net::SpdyFrameIR** frame);
 
  private:
-  // This is a pretty naive implementation of a thread-safe queue, but it's
-  // good enough for our purposes.  We could use an apr_queue_t instead of
-  // rolling our own class, but it lacks the ownership semantics that we want.
-  mutable base::Lock lock_;
-  base::ConditionVariable condvar_;
-  std::list<net::SpdyFrameIR*> queue_;
-  bool is_aborted_;
+  // Enough for a full 64kB stream window of 4kB DATA frames, several times
+  // over.  Must be a power of two.
+  static const uint32 kRingCapacity = 64;
+
+  // Remove a frame without blocking, from the ring or else from overflow_.
+  bool TryPop(net::SpdyFrameIR** frame);
+  bool TryPopFromRing(net::SpdyFrameIR** frame);
+  // Delete every frame still in the queue.
+  void DeleteQueuedFrames();
+  // Return true if there are no frames in the ring.  Requires the lock if
+  // used to decide whether to wait.
+  bool RingIsEmpty() const;
+
+  // Frames are normally passed in ring_, whose indices count frames ever
+  // added and removed and wrap around harmlessly.  Only the producer advances
+  // added_; consumers (including Abort()) claim a frame by advancing removed_
+  // with a compare-and-swap, so that an abort on one thread can't race with
+  // a pop on another.
+  base::subtle::AtomicWord ring_[kRingCapacity];
+  base::subtle::Atomic32 added_;
+  base::subtle::Atomic32 removed_;
+  base::subtle::Atomic32 is_aborted_;
+  // Nonzero while a consumer is (about to be) waiting on condvar_, so that
+  // Insert() knows to signal it.
+  base::subtle::Atomic32 consumer_waiting_;
+  // Nonzero while overflow_ is nonempty.  While it is set, the producer adds
+  // frames to overflow_ rather than the ring, so that frames stay in order.
+  base::subtle::Atomic32 overflowed_;
+
+  // The lock protects overflow_, and is used with condvar_ to park a
+  // consumer that is waiting for a frame.
+  mutable ProfiledLock lock_;
+  ProfiledConditionVariable condvar_;
+  std::list<net::SpdyFrameIR*> overflow_;
 
   DISALLOW_COPY_AND_ASSIGN(SpdyFrameQueue);
 };
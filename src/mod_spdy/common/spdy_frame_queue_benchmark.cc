@@ -0,0 +1,95 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/spdy_frame_queue.h"
+
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+#include "base/threading/platform_thread.h"
+#include "mod_spdy/common/testing/benchmark.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace {
+
+// The most frames the producer lets be outstanding, like a 64kB stream window
+// of 4kB DATA frames.
+const int64 kWindowFrames = 16;
+
+// Inserts frames into the queue, as the connection thread would, never
+// getting more than a window ahead of the consumer.
+class Producer : public base::PlatformThread::Delegate {
+ public:
+  Producer(mod_spdy::SpdyFrameQueue* queue, int64 num_frames,
+           const base::subtle::Atomic32* num_popped)
+      : queue_(queue), num_frames_(num_frames), num_popped_(num_popped) {}
+  virtual ~Producer() {}
+
+  virtual void ThreadMain() {
+    for (int64 i = 0; i < num_frames_; ++i) {
+      while (i - base::subtle::Acquire_Load(num_popped_) >= kWindowFrames) {
+        base::PlatformThread::YieldCurrentThread();
+      }
+      queue_->Insert(new net::SpdyPingIR(i));
+    }
+  }
+
+ private:
+  mod_spdy::SpdyFrameQueue* const queue_;
+  const int64 num_frames_;
+  const base::subtle::Atomic32* const num_popped_;
+
+  DISALLOW_COPY_AND_ASSIGN(Producer);
+};
+
+// Each iteration inserts four frames and pops them, with no other threads
+// involved.  This is the cost a frame pays when the stream thread keeps up.
+MOD_SPDY_BENCHMARK(BM_SpdyFrameQueue_InsertPop) {
+  mod_spdy::SpdyFrameQueue queue;
+  for (int64 i = 0; i < state->iterations(); ++i) {
+    for (int j = 0; j < 4; ++j) {
+      queue.Insert(new net::SpdyPingIR(j));
+    }
+    net::SpdyFrameIR* frame = NULL;
+    while (queue.Pop(false, &frame)) {
+      delete frame;
+    }
+  }
+  state->SetItemsProcessed(state->iterations() * 4);
+}
+
+// The connection thread inserts frames while the stream thread does blocking
+// pops, as during an upload.  Each iteration is one frame passing through the
+// queue.
+MOD_SPDY_BENCHMARK(BM_SpdyFrameQueue_CrossThread) {
+  state->PauseTiming();
+  mod_spdy::SpdyFrameQueue queue;
+  base::subtle::Atomic32 num_popped = 0;
+  Producer producer(&queue, state->iterations(), &num_popped);
+  base::PlatformThreadHandle handle;
+  state->ResumeTiming();
+
+  base::PlatformThread::Create(0, &producer, &handle);
+  for (int64 i = 0; i < state->iterations(); ++i) {
+    net::SpdyFrameIR* frame = NULL;
+    if (queue.Pop(true, &frame)) {
+      delete frame;
+    }
+    base::subtle::Release_Store(&num_popped,
+                                static_cast<base::subtle::Atomic32>(i + 1));
+  }
+  base::PlatformThread::Join(handle);
+  state->SetItemsProcessed(state->iterations());
+}
+
+}  // namespace
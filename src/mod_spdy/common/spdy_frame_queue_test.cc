@@ -80,6 +80,32 @@ TEST(SpdyFrameQueueTest, AbortEmptiesQueue) {
   ASSERT_TRUE(queue.is_aborted());
 }
 
+// Insert more frames than fit in the queue's ring buffer, with some pops in
+// between, and check that they still come out in order.
+TEST(SpdyFrameQueueTest, OverflowKeepsOrder) {
+  mod_spdy::SpdyFrameQueue queue;
+  net::SpdyStreamId next_insert = 1, next_pop = 1;
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 150; ++i) {
+      queue.Insert(new net::SpdyPingIR(next_insert++));
+    }
+    for (int i = 0; i < 100; ++i) {
+      ExpectPop(false, next_pop++, &queue);
+    }
+  }
+  while (next_pop < next_insert) {
+    ExpectPop(false, next_pop++, &queue);
+  }
+  ExpectEmpty(&queue);
+
+  // Overflowed frames are deleted by an abort, too.
+  for (int i = 0; i < 150; ++i) {
+    queue.Insert(new net::SpdyPingIR(next_insert++));
+  }
+  queue.Abort();
+  ExpectEmpty(&queue);
+}
+
 class BlockingPopTask : public mod_spdy::testing::AsyncTaskRunner::Task {
  public:
   explicit BlockingPopTask(mod_spdy::SpdyFrameQueue* queue) : queue_(queue) {}
@@ -109,4 +135,34 @@ TEST(SpdyFrameQueueTest, BlockingPop) {
   ExpectEmpty(&queue);
 }
 
+class InsertManyTask : public mod_spdy::testing::AsyncTaskRunner::Task {
+ public:
+  InsertManyTask(mod_spdy::SpdyFrameQueue* queue, int num_frames)
+      : queue_(queue), num_frames_(num_frames) {}
+  virtual void Run() {
+    for (int i = 1; i <= num_frames_; ++i) {
+      queue_->Insert(new net::SpdyPingIR(i));
+    }
+  }
+ private:
+  mod_spdy::SpdyFrameQueue* const queue_;
+  const int num_frames_;
+  DISALLOW_COPY_AND_ASSIGN(InsertManyTask);
+};
+
+// Have one thread insert frames as fast as it can while another pops them,
+// so that the consumer sometimes waits and the ring sometimes overflows.
+TEST(SpdyFrameQueueTest, ProducerAndConsumerThreads) {
+  const int kNumFrames = 100000;
+  mod_spdy::SpdyFrameQueue queue;
+  mod_spdy::testing::AsyncTaskRunner runner(
+      new InsertManyTask(&queue, kNumFrames));
+  ASSERT_TRUE(runner.Start());
+  for (int i = 1; i <= kNumFrames; ++i) {
+    ExpectPop(true, i, &queue);
+  }
+  runner.notification()->ExpectSetWithinMillis(1000);
+  ExpectEmpty(&queue);
+}
+
 }  // namespace
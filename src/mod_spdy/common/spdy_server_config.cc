@@ -26,9 +26,25 @@ const int kDefaultMaxServerPushDepth = 1;
 const bool kDefaultSendVersionHeader = true;
 const bool kDefaultServerPushDiscoveryEnabled = false;
 const bool kDefaultServerPushDiscoverySendDebugHeaders = false;
+const bool kDefaultServerPushOutcomeTracking = false;
+const int kDefaultServerPushCacheSizeKb = 0;
+const bool kDefaultCoalesceRequests = false;
+const int kDefaultMicroCacheSizeKb = 0;
+const mod_spdy::ServerPushManifest* const kDefaultServerPushManifest = NULL;
+const bool kDefaultServerPushScanHtml = false;
 const mod_spdy::spdy::SpdyVersion kDefaultUseSpdyVersionWithoutSsl =
     mod_spdy::spdy::SPDY_VERSION_NONE;
+const int kDefaultMaxStreamReceiveWindowKb = 64;
+const int kDefaultMaxSessionReceiveWindowKb = 64;
+const int kDefaultReceiveWindowMemoryKb = 16384;
+const char* const kDefaultSessionCaptureDirectory = "";
+const int kDefaultSessionCapturePercent = 0;
+const int kDefaultSessionCaptureMaxKb = 1024;
+const bool kDefaultTracingEnabled = false;
+const bool kDefaultLockProfilingEnabled = false;
 const int kDefaultVlogLevel = 0;
+const bool kDefaultAsyncLoggingEnabled = false;
+const char* const kDefaultScoreboardFile = "";
 
 }  // namespace
 
@@ -44,8 +60,24 @@ SpdyServerConfig::SpdyServerConfig()
       server_push_discovery_enabled_(kDefaultServerPushDiscoveryEnabled),
       server_push_discovery_send_debug_headers_(
           kDefaultServerPushDiscoverySendDebugHeaders),
+      server_push_outcome_tracking_(kDefaultServerPushOutcomeTracking),
+      server_push_cache_size_kb_(kDefaultServerPushCacheSizeKb),
+      coalesce_requests_(kDefaultCoalesceRequests),
+      micro_cache_size_kb_(kDefaultMicroCacheSizeKb),
+      server_push_manifest_(kDefaultServerPushManifest),
+      server_push_scan_html_(kDefaultServerPushScanHtml),
       use_spdy_version_without_ssl_(kDefaultUseSpdyVersionWithoutSsl),
-      vlog_level_(kDefaultVlogLevel) {}
+      max_stream_receive_window_kb_(kDefaultMaxStreamReceiveWindowKb),
+      max_session_receive_window_kb_(kDefaultMaxSessionReceiveWindowKb),
+      receive_window_memory_kb_(kDefaultReceiveWindowMemoryKb),
+      session_capture_directory_(kDefaultSessionCaptureDirectory),
+      session_capture_percent_(kDefaultSessionCapturePercent),
+      session_capture_max_kb_(kDefaultSessionCaptureMaxKb),
+      tracing_enabled_(kDefaultTracingEnabled),
+      lock_profiling_enabled_(kDefaultLockProfilingEnabled),
+      vlog_level_(kDefaultVlogLevel),
+      async_logging_enabled_(kDefaultAsyncLoggingEnabled),
+      scoreboard_file_(kDefaultScoreboardFile) {}
 
 SpdyServerConfig::~SpdyServerConfig() {}
 
@@ -67,9 +99,38 @@ void SpdyServerConfig::MergeFrom(const SpdyServerConfig& a,
   server_push_discovery_send_debug_headers_.MergeFrom(
       a.server_push_discovery_send_debug_headers_,
       b.server_push_discovery_send_debug_headers_);
+  server_push_outcome_tracking_.MergeFrom(a.server_push_outcome_tracking_,
+                                          b.server_push_outcome_tracking_);
+  server_push_cache_size_kb_.MergeFrom(a.server_push_cache_size_kb_,
+                                       b.server_push_cache_size_kb_);
+  coalesce_requests_.MergeFrom(a.coalesce_requests_, b.coalesce_requests_);
+  micro_cache_size_kb_.MergeFrom(a.micro_cache_size_kb_,
+                                 b.micro_cache_size_kb_);
+  server_push_manifest_.MergeFrom(a.server_push_manifest_,
+                                  b.server_push_manifest_);
+  server_push_scan_html_.MergeFrom(a.server_push_scan_html_,
+                                   b.server_push_scan_html_);
   use_spdy_version_without_ssl_.MergeFrom(
       a.use_spdy_version_without_ssl_, b.use_spdy_version_without_ssl_);
+  max_stream_receive_window_kb_.MergeFrom(a.max_stream_receive_window_kb_,
+                                          b.max_stream_receive_window_kb_);
+  max_session_receive_window_kb_.MergeFrom(a.max_session_receive_window_kb_,
+                                           b.max_session_receive_window_kb_);
+  receive_window_memory_kb_.MergeFrom(a.receive_window_memory_kb_,
+                                      b.receive_window_memory_kb_);
+  session_capture_directory_.MergeFrom(a.session_capture_directory_,
+                                       b.session_capture_directory_);
+  session_capture_percent_.MergeFrom(a.session_capture_percent_,
+                                     b.session_capture_percent_);
+  session_capture_max_kb_.MergeFrom(a.session_capture_max_kb_,
+                                    b.session_capture_max_kb_);
+  tracing_enabled_.MergeFrom(a.tracing_enabled_, b.tracing_enabled_);
+  lock_profiling_enabled_.MergeFrom(a.lock_profiling_enabled_,
+                                    b.lock_profiling_enabled_);
   vlog_level_.MergeFrom(a.vlog_level_, b.vlog_level_);
+  async_logging_enabled_.MergeFrom(a.async_logging_enabled_,
+                                   b.async_logging_enabled_);
+  scoreboard_file_.MergeFrom(a.scoreboard_file_, b.scoreboard_file_);
 }
 
 }  // namespace mod_spdy
@@ -15,11 +15,15 @@
 #ifndef MOD_SPDY_COMMON_SPDY_SERVER_CONFIG_H_
 #define MOD_SPDY_COMMON_SPDY_SERVER_CONFIG_H_
 
+#include <string>
+
 #include "base/basictypes.h"
 #include "mod_spdy/common/protocol_util.h"
 
 namespace mod_spdy {
 
+class ServerPushManifest;
+
 // Stores server configuration settings for our module.
 class SpdyServerConfig {
  public:
@@ -65,6 +69,36 @@ class SpdyServerConfig {
     return server_push_discovery_send_debug_headers_.get();
   }
 
+  // Return if we should track which server pushes clients cancel, and stop
+  // making (or demote) pushes that they usually throw away.
+  bool server_push_outcome_tracking() const {
+    return server_push_outcome_tracking_.get();
+  }
+
+  // Return the size, in kilobytes, of the per-process cache of server push
+  // responses, or zero if server push responses should not be cached.
+  int server_push_cache_size_kb() const {
+    return server_push_cache_size_kb_.get();
+  }
+
+  // Return if identical GET requests that are in flight at the same time
+  // should share a single response (see RequestCoalescer).
+  bool coalesce_requests() const { return coalesce_requests_.get(); }
+
+  // Return the size, in kilobytes, of the per-process micro-cache of small
+  // responses for this server, or zero if responses should not be cached.
+  int micro_cache_size_kb() const { return micro_cache_size_kb_.get(); }
+
+  // Return the compiled push manifest for this server, or NULL if there is
+  // none.  The manifest is owned by the configuration pool.
+  const ServerPushManifest* server_push_manifest() const {
+    return server_push_manifest_.get();
+  }
+
+  // Return if we should scan HTML responses for stylesheets, scripts, and
+  // images to push.
+  bool server_push_scan_html() const { return server_push_scan_html_.get(); }
+
   // If nonzero, assume (unencrypted) SPDY/x for non-SSL connections, where x
   // is the version number returned here.  This will most likely break normal
   // browsers, but is useful for testing.
@@ -72,9 +106,63 @@ class SpdyServerConfig {
     return use_spdy_version_without_ssl_.get();
   }
 
+  // Return the largest size, in kilobytes, to which each stream's input flow
+  // control window may grow when the client is uploading faster than the
+  // default window allows.  At or below the default size (64), the window
+  // never grows.
+  int max_stream_receive_window_kb() const {
+    return max_stream_receive_window_kb_.get();
+  }
+
+  // Likewise, for the session-wide input window (SPDY/3.1 and up).
+  int max_session_receive_window_kb() const {
+    return max_session_receive_window_kb_.get();
+  }
+
+  // Return the total size, in kilobytes, by which input windows in one child
+  // process may grow beyond their default size (see ReceiveWindowBudget).
+  int receive_window_memory_kb() const {
+    return receive_window_memory_kb_.get();
+  }
+
+  // Return the directory in which to write session capture logs (see
+  // SessionCaptureWriter), or the empty string if sessions should not be
+  // captured.
+  const std::string& session_capture_directory() const {
+    return session_capture_directory_.get();
+  }
+
+  // Return the percentage of SPDY connections to capture (if a capture
+  // directory is set); 100 or more means every connection.
+  int session_capture_percent() const {
+    return session_capture_percent_.get();
+  }
+
+  // Return the maximum size, in kilobytes, of each session capture log.
+  int session_capture_max_kb() const { return session_capture_max_kb_.get(); }
+
+  // Return true if we should record a trace of session scheduling events
+  // (see TraceLog), and serve it from the spdy-trace handler.
+  bool tracing_enabled() const { return tracing_enabled_.get(); }
+
+  // Return true if we should count contention on mod_spdy's internal locks
+  // (see LockProfiler), and serve the counts from the spdy-lock-profile
+  // handler.
+  bool lock_profiling_enabled() const {
+    return lock_profiling_enabled_.get();
+  }
+
   // Return the maximum VLOG level we should use.
   int vlog_level() const { return vlog_level_.get(); }
 
+  // Return true if we should write log messages from a background thread,
+  // rather than from the thread that logged them.
+  bool async_logging_enabled() const { return async_logging_enabled_.get(); }
+
+  // Return the path of the file in which to keep the shared counters read by
+  // spdy_top (see Scoreboard), or the empty string if there should be none.
+  const std::string& scoreboard_file() const { return scoreboard_file_.get(); }
+
   // Setters.  Call only during the configuration phase.
   void set_spdy_enabled(bool b) { spdy_enabled_.set(b); }
   void set_max_streams_per_connection(int n) {
@@ -90,10 +178,44 @@ class SpdyServerConfig {
   void set_server_push_discovery_send_debug_headers(bool b) {
     return server_push_discovery_send_debug_headers_.set(b);
   }
+  void set_server_push_outcome_tracking(bool b) {
+    server_push_outcome_tracking_.set(b);
+  }
+  void set_server_push_cache_size_kb(int n) {
+    server_push_cache_size_kb_.set(n);
+  }
+  void set_coalesce_requests(bool b) { coalesce_requests_.set(b); }
+  void set_micro_cache_size_kb(int n) { micro_cache_size_kb_.set(n); }
+  void set_server_push_manifest(const ServerPushManifest* manifest) {
+    server_push_manifest_.set(manifest);
+  }
+  void set_server_push_scan_html(bool b) { server_push_scan_html_.set(b); }
   void set_use_spdy_version_without_ssl(spdy::SpdyVersion v) {
     use_spdy_version_without_ssl_.set(v);
   }
+  void set_max_stream_receive_window_kb(int n) {
+    max_stream_receive_window_kb_.set(n);
+  }
+  void set_max_session_receive_window_kb(int n) {
+    max_session_receive_window_kb_.set(n);
+  }
+  void set_receive_window_memory_kb(int n) {
+    receive_window_memory_kb_.set(n);
+  }
+  void set_session_capture_directory(const std::string& dir) {
+    session_capture_directory_.set(dir);
+  }
+  void set_session_capture_percent(int n) {
+    session_capture_percent_.set(n);
+  }
+  void set_session_capture_max_kb(int n) { session_capture_max_kb_.set(n); }
+  void set_tracing_enabled(bool b) { tracing_enabled_.set(b); }
+  void set_lock_profiling_enabled(bool b) { lock_profiling_enabled_.set(b); }
   void set_vlog_level(int n) { vlog_level_.set(n); }
+  void set_async_logging_enabled(bool b) { async_logging_enabled_.set(b); }
+  void set_scoreboard_file(const std::string& path) {
+    scoreboard_file_.set(path);
+  }
 
   // Set this config object to the merge of a and b.  Call only during the
   // configuration phase.
@@ -126,8 +248,24 @@ class SpdyServerConfig {
   Option<bool> send_version_header_;
   Option<bool> server_push_discovery_enabled_;
   Option<bool> server_push_discovery_send_debug_headers_;
+  Option<bool> server_push_outcome_tracking_;
+  Option<int> server_push_cache_size_kb_;
+  Option<bool> coalesce_requests_;
+  Option<int> micro_cache_size_kb_;
+  Option<const ServerPushManifest*> server_push_manifest_;
+  Option<bool> server_push_scan_html_;
   Option<spdy::SpdyVersion> use_spdy_version_without_ssl_;
+  Option<int> max_stream_receive_window_kb_;
+  Option<int> max_session_receive_window_kb_;
+  Option<int> receive_window_memory_kb_;
+  Option<std::string> session_capture_directory_;
+  Option<int> session_capture_percent_;
+  Option<int> session_capture_max_kb_;
+  Option<bool> tracing_enabled_;
+  Option<bool> lock_profiling_enabled_;
   Option<int> vlog_level_;
+  Option<bool> async_logging_enabled_;
+  Option<std::string> scoreboard_file_;
   // Note: Add more config options here as needed; be sure to also update the
   //   MergeFrom method in spdy_server_config.cc.
 
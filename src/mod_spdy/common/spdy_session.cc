@@ -17,13 +17,20 @@
 #include "base/basictypes.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
-#include "base/synchronization/lock.h"
 #include "base/time/time.h"
 #include "mod_spdy/common/protocol_util.h"
+#include "mod_spdy/common/push_response_cache.h"
+#include "mod_spdy/common/receive_window_tuner.h"
+#include "mod_spdy/common/request_coalescer.h"
+#include "mod_spdy/common/scoreboard.h"
+#include "mod_spdy/common/server_push_outcome_tracker.h"
 #include "mod_spdy/common/spdy_server_config.h"
 #include "mod_spdy/common/spdy_session_io.h"
 #include "mod_spdy/common/spdy_stream.h"
 #include "mod_spdy/common/spdy_stream_task_factory.h"
+#include "mod_spdy/common/trace_log.h"
+#include "mod_spdy/common/window_update_aggregator.h"
+#include "net/instaweb/util/public/function.h"
 #include "net/spdy/spdy_protocol.h"
 
 namespace {
@@ -37,10 +44,260 @@ const net::SpdyStreamId kMaxServerPushStreamId = 0x7FFFFFFEu;
 // push streams at a time.
 const uint32 kInitMaxConcurrentPushes = 100u;
 
+// When serving a server push from the PushResponseCache, or a coalesced
+// request from the response to its leader, we split the body into DATA frames
+// of (at most) this size, to match what the HttpToSpdyConverter would have
+// produced.
+const size_t kCachedPushDataFrameBytes = 4096;
+
+// How many finished server pushes to remember per session, in case the client
+// cancels one after we've already sent all of it.  The client would only do
+// that within a round trip or so of the push starting, so this needn't be
+// large.
+const size_t kMaxFinishedPushesRemembered = 32;
+
+// Server pushes may send at most this many bytes of DATA ahead of the body of
+// the document they're associated with, until that document has been sent in
+// full.  This leaves the pushes room to get going without letting them take
+// over the connection (or the shared flow control window) from the document.
+const size_t kMaxPushLeadBytes = 16384;
+
+// If a document makes no progress for this long, stop holding back its
+// pushes, since the connection would otherwise sit idle.
+const int kMaxPushDeferralMillis = 500;
+
+// When tuning input windows, measure the round trip time with a PING at most
+// this often, once the client starts uploading.
+const int kRoundTripProbeIntervalSeconds = 15;
+
+// Convert a configured maximum input window size to bytes.  Sizes no bigger
+// than the initial window mean the window should not grow, and yield zero.
+int32 MaxInputWindowSize(int kilobytes) {
+  const int64 bytes = static_cast<int64>(kilobytes) * 1024;
+  if (bytes <= static_cast<int64>(net::kSpdyStreamInitialWindowSize)) {
+    return 0;
+  }
+  return static_cast<int32>(
+      std::min(bytes, static_cast<int64>(net::kSpdyMaximumWindowSize)));
+}
+
+// A DATA frame that owns its payload string, so that input DATA gathered
+// from the framer can be handed to a stream without copying it again.
+class OwnedPayloadDataIR : public net::SpdyDataIR {
+ public:
+  // Takes the contents of *payload, leaving it empty.
+  OwnedPayloadDataIR(net::SpdyStreamId stream_id, std::string* payload)
+      : net::SpdyDataIR(stream_id) {
+    payload_.swap(*payload);
+    SetDataShallow(payload_);
+  }
+  virtual ~OwnedPayloadDataIR() {}
+
+ private:
+  std::string payload_;
+
+  DISALLOW_COPY_AND_ASSIGN(OwnedPayloadDataIR);
+};
+
+// Finds the header block (if any) carried by a frame.
+class HeaderBlockVisitor : public net::SpdyFrameVisitor {
+ public:
+  HeaderBlockVisitor() : block_(NULL) {}
+  virtual ~HeaderBlockVisitor() {}
+
+  const net::SpdyNameValueBlock* block() const { return block_; }
+
+  virtual void VisitSynStream(const net::SpdySynStreamIR& frame) {
+    block_ = &frame.name_value_block();
+  }
+  virtual void VisitSynReply(const net::SpdySynReplyIR& frame) {
+    block_ = &frame.name_value_block();
+  }
+  virtual void VisitRstStream(const net::SpdyRstStreamIR& frame) {}
+  virtual void VisitSettings(const net::SpdySettingsIR& frame) {}
+  virtual void VisitPing(const net::SpdyPingIR& frame) {}
+  virtual void VisitGoAway(const net::SpdyGoAwayIR& frame) {}
+  virtual void VisitHeaders(const net::SpdyHeadersIR& frame) {
+    block_ = &frame.name_value_block();
+  }
+  virtual void VisitWindowUpdate(const net::SpdyWindowUpdateIR& frame) {}
+  virtual void VisitCredential(const net::SpdyCredentialIR& frame) {}
+  virtual void VisitBlocked(const net::SpdyBlockedIR& frame) {}
+  virtual void VisitPushPromise(const net::SpdyPushPromiseIR& frame) {}
+  virtual void VisitData(const net::SpdyDataIR& frame) {}
+
+ private:
+  const net::SpdyNameValueBlock* block_;
+
+  DISALLOW_COPY_AND_ASSIGN(HeaderBlockVisitor);
+};
+
+// Return the total size of the names and values in a header block.
+size_t HeaderBlockBytes(const net::SpdyNameValueBlock& block) {
+  size_t bytes = 0;
+  for (net::SpdyNameValueBlock::const_iterator iter = block.begin();
+       iter != block.end(); ++iter) {
+    bytes += iter->first.size() + iter->second.size();
+  }
+  return bytes;
+}
+
+// Determine whether a client request may be answered from the micro-cache.
+// Requests for part of a resource, and requests that carry their own caching
+// instructions (as browsers send when the user reloads a page), always go
+// through Apache.
+bool MayUseMicroCache(const net::SpdyHeaderBlock& request_headers) {
+  const net::SpdyHeaderBlock::const_iterator method =
+      request_headers.find(mod_spdy::spdy::kSpdy3Method);
+  return (method != request_headers.end() && method->second == "GET" &&
+          request_headers.count(mod_spdy::http::kRange) == 0 &&
+          request_headers.count(mod_spdy::http::kIfRange) == 0 &&
+          request_headers.count(mod_spdy::http::kCacheControl) == 0 &&
+          request_headers.count(mod_spdy::http::kPragma) == 0);
+}
+
+// Turn a cached response into a 304 response, which carries only the headers
+// that describe the cached entity (RFC 2616 section 10.3.5), and no body.
+void MakeNotModifiedResponse(mod_spdy::PushResponseCache::Response* response) {
+  const char* const kKeptHeaders[] = {
+    mod_spdy::spdy::kSpdy3Version,
+    mod_spdy::http::kAge,
+    mod_spdy::http::kCacheControl,
+    mod_spdy::http::kDate,
+    mod_spdy::http::kETag,
+    mod_spdy::http::kExpires,
+    mod_spdy::http::kLastModified,
+    mod_spdy::http::kVary,
+  };
+  net::SpdyHeaderBlock headers;
+  headers[mod_spdy::spdy::kSpdy3Status] = "304";
+  for (size_t i = 0; i < arraysize(kKeptHeaders); ++i) {
+    const net::SpdyHeaderBlock::const_iterator iter =
+        response->headers.find(kKeptHeaders[i]);
+    if (iter != response->headers.end()) {
+      headers.insert(*iter);
+    }
+  }
+  response->headers.swap(headers);
+  response->body.clear();
+}
+
+// Send a complete response on the stream, splitting the body up as the
+// HttpToSpdyConverter would have.
+void SendCompleteResponse(
+    mod_spdy::SpdyStream* stream,
+    const mod_spdy::PushResponseCache::Response& response) {
+  const std::string& body = response.body;
+  if (stream->is_server_push()) {
+    stream->SendOutputHeaders(response.headers, body.empty());
+  } else {
+    stream->SendOutputSynReply(response.headers, body.empty());
+  }
+  size_t offset = 0;
+  while (offset < body.size() && !stream->is_aborted()) {
+    const size_t length =
+        std::min(kCachedPushDataFrameBytes, body.size() - offset);
+    stream->SendOutputDataFrame(
+        base::StringPiece(body.data() + offset, length),
+        offset + length == body.size());
+    offset += length;
+  }
+}
+
+// A stream task that sends a response from the PushResponseCache, rather than
+// running a request through the stream task factory.
+class CachedPushTask : public net_instaweb::Function {
+ public:
+  // The task takes ownership of the response, but not of the stream.
+  CachedPushTask(mod_spdy::SpdyStream* stream,
+                 mod_spdy::PushResponseCache::Response* response)
+      : stream_(stream), response_(response) {}
+  virtual ~CachedPushTask() {}
+
+ protected:
+  // net_instaweb::Function methods:
+  virtual void Run() {
+    SendCompleteResponse(stream_, *response_);
+  }
+  virtual void Cancel() {}
+
+ private:
+  mod_spdy::SpdyStream* const stream_;
+  const scoped_ptr<mod_spdy::PushResponseCache::Response> response_;
+
+  DISALLOW_COPY_AND_ASSIGN(CachedPushTask);
+};
+
+// A stream task for a request that has been coalesced with an identical one
+// already in flight.  The session only queues it once that request's response
+// is done, so it never waits; it sends a copy of the response, or if that
+// can't be used, runs the request through the stream task factory after all.
+class CoalescedRequestTask : public net_instaweb::Function {
+ public:
+  // The task takes ownership of the follower, but not of the stream or the
+  // task factory.
+  CoalescedRequestTask(mod_spdy::SpdyStream* stream,
+                       mod_spdy::RequestCoalescer::Follower* follower,
+                       mod_spdy::SpdyStreamTaskFactory* task_factory)
+      : stream_(stream), follower_(follower), task_factory_(task_factory) {}
+  virtual ~CoalescedRequestTask() {}
+
+ protected:
+  // net_instaweb::Function methods:
+  virtual void Run() {
+    typedef mod_spdy::RequestCoalescer::Follower Follower;
+    if (stream_->is_aborted()) {
+      return;
+    }
+    const Follower::Status status = follower_->status();
+    DCHECK_NE(Follower::PENDING, status);
+    if (status == Follower::READY) {
+      VLOG(3) << "Sending coalesced response on stream "
+              << stream_->stream_id();
+      SendCompleteResponse(stream_, follower_->response());
+      return;
+    }
+    // The task factory is safe to call from stream threads, since server
+    // pushes create stream tasks from them too.
+    VLOG(3) << "Coalesced response unavailable; running stream "
+            << stream_->stream_id() << " normally";
+    follower_.reset();
+    net_instaweb::Function* task = task_factory_->NewStreamTask(stream_);
+    CHECK(task);
+    task->CallRun();
+  }
+  virtual void Cancel() {}
+
+ private:
+  mod_spdy::SpdyStream* const stream_;
+  scoped_ptr<mod_spdy::RequestCoalescer::Follower> follower_;
+  mod_spdy::SpdyStreamTaskFactory* const task_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(CoalescedRequestTask);
+};
+
 }  // namespace
 
 namespace mod_spdy {
 
+class SpdySession::CoalescedTaskStarter : public net_instaweb::Function {
+ public:
+  CoalescedTaskStarter(SpdySession* spdy_session, net::SpdyStreamId stream_id)
+      : spdy_session_(spdy_session), stream_id_(stream_id) {}
+  virtual ~CoalescedTaskStarter() {}
+
+ protected:
+  // net_instaweb::Function methods:
+  virtual void Run() { spdy_session_->StartParkedTask(stream_id_); }
+  virtual void Cancel() { spdy_session_->OnTaskStarterDone(); }
+
+ private:
+  SpdySession* const spdy_session_;
+  const net::SpdyStreamId stream_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(CoalescedTaskStarter);
+};
+
 SpdySession::SpdySession(spdy::SpdyVersion spdy_version,
                          const SpdyServerConfig* config,
                          SpdySessionIO* session_io,
@@ -57,12 +314,53 @@ SpdySession::SpdySession(spdy::SpdyVersion spdy_version,
       last_client_stream_id_(0u),
       initial_window_size_(net::kSpdyStreamInitialWindowSize),
       max_concurrent_pushes_(kInitMaxConcurrentPushes),
+      push_response_cache_(NULL),
+      micro_cache_(NULL),
+      request_coalescer_(NULL),
+      push_outcome_tracker_(NULL),
+      scoreboard_session_(Scoreboard::kNoSession),
+      reported_queue_depth_(0),
+      push_pacer_(kMaxPushLeadBytes,
+                  base::TimeDelta::FromMilliseconds(kMaxPushDeferralMillis),
+                  spdy_version >= spdy::SPDY_VERSION_3_1 ?
+                  &shared_window_ : NULL),
+      max_stream_input_window_size_(0),
+      round_trip_probes_enabled_(false),
+      last_probe_ping_id_(0u),
+      probe_ping_outstanding_(false),
+      header_blocks_sent_(0),
+      header_bytes_raw_(0),
+      header_bytes_sent_(0),
+      stream_map_lock_("SpdySession::stream_map_lock_"),
       last_server_push_stream_id_(0u),
       received_goaway_(false),
+      num_task_starters_(0),
+      task_starters_condvar_(&stream_map_lock_),
       shared_window_(net::kSpdyStreamInitialWindowSize,
-                     net::kSpdyStreamInitialWindowSize) {
+                     net::kSpdyStreamInitialWindowSize),
+      window_updates_(&output_queue_) {
   DCHECK_NE(spdy::SPDY_VERSION_NONE, spdy_version);
   framer_.set_visitor(this);
+
+  // Let input windows grow for fast uploads, if so configured (and if
+  // ChildInit has set up a budget for them).  Flow control only exists for
+  // SPDY v3 and up, and the shared window for SPDY/3.1 and up.
+  ReceiveWindowBudget* budget = ReceiveWindowBudget::Instance();
+  if (budget != NULL && spdy_version_ >= spdy::SPDY_VERSION_3) {
+    max_stream_input_window_size_ =
+        MaxInputWindowSize(config_->max_stream_receive_window_kb());
+    const int32 max_session_input_window_size =
+        MaxInputWindowSize(config_->max_session_receive_window_kb());
+    if (max_session_input_window_size > 0 &&
+        spdy_version_ >= spdy::SPDY_VERSION_3_1) {
+      shared_window_.EnableInputWindowTuning(max_session_input_window_size,
+                                             budget);
+      round_trip_probes_enabled_ = true;
+    }
+    if (max_stream_input_window_size_ > 0) {
+      round_trip_probes_enabled_ = true;
+    }
+  }
 }
 
 SpdySession::~SpdySession() {}
@@ -78,6 +376,18 @@ int32 SpdySession::current_shared_output_window_size() const {
 }
 
 void SpdySession::Run() {
+  if (TraceLog::Instance() != NULL) {
+    TraceLog::Instance()->SetCurrentThreadName("SpdySession");
+  }
+  MOD_SPDY_TRACE_EVENT0("session", "SpdySession::Run");
+
+  if (Scoreboard::Instance() != NULL) {
+    scoreboard_session_ = Scoreboard::Instance()->ClaimSessionSlot();
+    shared_window_.set_scoreboard_session(scoreboard_session_);
+  }
+  Scoreboard::AddIfEnabled(scoreboard_session_, Scoreboard::SESSIONS_ACTIVE, 1);
+  Scoreboard::AddIfEnabled(scoreboard_session_, Scoreboard::SESSIONS_TOTAL, 1);
+
   // Send a SETTINGS frame when the connection first opens, to inform the
   // client of our MAX_CONCURRENT_STREAMS limit.
   SendSettingsFrame();
@@ -113,8 +423,12 @@ void SpdySession::Run() {
       // Determine whether we should block until more input data is available.
       // For now, our policy is to block only if there is no pending output and
       // there are no currently-active streams (which might produce new
-      // output).
-      const bool should_block = StreamMapIsEmpty() && output_queue_.IsEmpty();
+      // output), the push pacer isn't holding any frames back (except for
+      // want of session window, which only input can bring), and no
+      // WINDOW_UPDATEs are waiting to be sent.
+      const bool should_block = StreamMapIsEmpty() && output_queue_.IsEmpty() &&
+          !push_pacer_.IsPacingFrames() &&
+          !window_updates_.HasPendingUpdates();
 
       // If there's no current output, and we can't create new streams (so
       // there will be no future output), then we should just shut down the
@@ -130,8 +444,15 @@ void SpdySession::Run() {
       // OnStreamFrameData methods to report decoded frames.  If no input data
       // is currently available and should_block is true, this will block until
       // input becomes available (or the connection is closed).
-      const SpdySessionIO::ReadStatus status =
-          session_io_->ProcessAvailableInput(should_block, &framer_);
+      SpdySessionIO::ReadStatus status;
+      {
+        MOD_SPDY_TRACE_EVENT1("session", "ProcessAvailableInput", "block",
+                              should_block);
+        status = session_io_->ProcessAvailableInput(should_block, &framer_);
+      }
+      // Pass along the DATA that the framer just handed us, now that we have
+      // all of it for this read.
+      PostAllPendingInputData();
       if (status == SpdySessionIO::READ_SUCCESS) {
         // We successfully did some I/O, so reset the output block timeout.
         output_block_time = kInitOutputBlockTime;
@@ -167,21 +488,38 @@ void SpdySession::Run() {
 
     // Step 2: Send output to the client.
     if (!session_stopped_) {
+      // Send the WINDOW_UPDATEs that stream threads have asked for since the
+      // last time around together, ahead of this batch of output.  (Updates
+      // that the client is waiting on have already been sent.)
+      window_updates_.Flush();
+      UpdateScoreboardQueueDepth(output_queue_.size());
+
       // If there are no active streams, then no new output can be getting
       // created right now, so we shouldn't block on output waiting for more.
       const bool no_active_streams = StreamMapIsEmpty();
 
+      // If no streams remain and nothing more is queued, then any server push
+      // frames that the pacer is holding back have nothing left to wait for.
+      if (no_active_streams && output_queue_.IsEmpty()) {
+        push_pacer_.ReleaseAll();
+      }
+      bool sent_output = SendReadyPushFrames();
+
       // Send any pending output, one frame at a time.  If there are any active
       // streams, we're willing to block briefly to wait for more frames to
       // send, if only to prevent this loop from busy-waiting too heavily --
       // not a great solution, but better than nothing for now.
       net::SpdyFrameIR* frame = NULL;
-      if (no_active_streams ? output_queue_.Pop(&frame) :
-          output_queue_.BlockingPop(output_block_time, &frame)) {
+      if (!session_stopped_ &&
+          (no_active_streams ? output_queue_.Pop(&frame) :
+           output_queue_.BlockingPop(output_block_time, &frame))) {
         do {
-          SendFrame(frame);
+          SendOrDeferFrame(frame);
         } while (!session_stopped_ && output_queue_.Pop(&frame));
+        sent_output = true;
+      }
 
+      if (sent_output) {
         // We successfully did some I/O, so reset the output block timeout.
         output_block_time = kInitOutputBlockTime;
       } else {
@@ -206,6 +544,25 @@ void SpdySession::Run() {
     // nonempty (obviously we would abstract that away in SpdySessionIO),
     // but there's not even a nice way to do that (that I know of).
   }
+
+  VLOG(1) << "Session sent " << push_pacer_.document_data_bytes_written()
+          << " bytes of document data and "
+          << push_pacer_.push_data_bytes_written() << " bytes of push data";
+  VLOG(1) << "Session compressed " << header_blocks_sent_
+          << " header blocks from " << header_bytes_raw_ << " to "
+          << header_bytes_sent_ << " bytes in "
+          << header_compression_time_.InMicroseconds() << " us";
+
+  // By now, StopSession() has waited for all the stream tasks to finish, so
+  // nothing else will count against our session slot.
+  UpdateScoreboardQueueDepth(0);
+  Scoreboard::AddIfEnabled(scoreboard_session_, Scoreboard::SESSIONS_ACTIVE,
+                           -1);
+  if (Scoreboard::Instance() != NULL) {
+    Scoreboard::Instance()->ReleaseSessionSlot(scoreboard_session_);
+  }
+  scoreboard_session_ = Scoreboard::kNoSession;
+  shared_window_.set_scoreboard_session(scoreboard_session_);
 }
 
 SpdyServerPushInterface::PushStatus SpdySession::StartServerPush(
@@ -232,9 +589,22 @@ SpdyServerPushInterface::PushStatus SpdySession::StartServerPush(
   const std::string& path_header = path_iter->second;
   const std::string& scheme_header = scheme_iter->second;
 
+  // If we have a fresh copy of the response in the push cache, we can send it
+  // straight from there, without running a request through Apache.
+  scoped_ptr<PushResponseCache::Response> cached_response;
+  if (push_response_cache_ != NULL) {
+    cached_response.reset(new PushResponseCache::Response);
+    if (!push_response_cache_->Lookup(request_headers, base::TimeTicks::Now(),
+                                      cached_response.get())) {
+      cached_response.reset();
+    }
+  }
+  const bool from_cache = cached_response.get() != NULL;
+
   StreamTaskWrapper* task_wrapper = NULL;
+  bool parked = false;  // true if the task is waiting on a coalesced request
   {
-    base::AutoLock autolock(stream_map_lock_);
+    ProfiledAutoLock autolock(stream_map_lock_);
 
     // If we've received a GOAWAY frame the client, we shouldn't create any new
     // streams on this session (SPDY draft 3 section 2.6.6).
@@ -275,10 +645,45 @@ SpdyServerPushInterface::PushStatus SpdySession::StartServerPush(
       return SpdyServerPushInterface::PUSH_INTERNAL_ERROR;
     }
 
+    // If the response isn't cached, but the same resource is already being
+    // fetched (for a push or for a client, on this session or another), share
+    // that response.
+    RequestCoalescer::Follower* follower = NULL;
+    RequestCoalescer::Recorder* coalescing_recorder = NULL;
+    if (request_coalescer_ != NULL && !from_cache) {
+      follower = request_coalescer_->Join(request_headers,
+                                          &coalescing_recorder);
+    }
+
     // Create task and add it to the stream map.
     task_wrapper = new StreamTaskWrapper(
-        this, stream_id, associated_stream_id, server_push_depth, priority);
+        this, stream_id, associated_stream_id, server_push_depth, priority,
+        cached_response.release(), follower);
     stream_map_.AddStreamTask(task_wrapper);
+    parked = (follower != NULL && ParkCoalescedTask(task_wrapper, follower));
+    if (coalescing_recorder != NULL) {
+      task_wrapper->stream()->set_coalescing_recorder(coalescing_recorder);
+    }
+    // If this push will run through the task factory, record the response so
+    // that we can serve it from the cache next time.
+    if (push_response_cache_ != NULL && !from_cache) {
+      PushResponseCache::Recorder* recorder =
+          push_response_cache_->NewRecorder(request_headers);
+      if (recorder != NULL) {
+        task_wrapper->stream()->set_response_recorder(recorder);
+      }
+    }
+    // Remember which page this push is for, so we can tell the outcome
+    // tracker what becomes of it.
+    if (push_outcome_tracker_ != NULL) {
+      const StreamTaskWrapper* associated_task =
+          stream_map_.GetStreamTask(associated_stream_id);
+      DCHECK(associated_task != NULL);
+      task_wrapper->set_request_host(associated_task->request_host());
+      task_wrapper->set_request_path(path_header);
+      task_wrapper->set_associated_request_path(
+          associated_task->request_path());
+    }
     net::SpdySynStreamIR* frame = new net::SpdySynStreamIR(stream_id);
     frame->set_associated_to_stream_id(associated_stream_id);
     frame->set_priority(priority);
@@ -297,13 +702,22 @@ SpdyServerPushInterface::PushStatus SpdySession::StartServerPush(
     task_wrapper->stream()->SendOutputSynStream(
         initial_response_headers, false);
 
-    VLOG(2) << "Starting server push; opening stream " << stream_id;
+    VLOG(2) << "Starting server push; opening stream " << stream_id
+            << (from_cache ? " (from cache)" : "");
   }
   if (task_wrapper == NULL) {
     LOG(DFATAL) << "Can't happen: task_wrapper is NULL";
     return SpdyServerPushInterface::PUSH_INTERNAL_ERROR;
   }
-  executor_->AddTask(task_wrapper, priority);
+  // Even a cached response runs on a worker thread, like any other push:
+  // sending it may have to wait for the client to open up the push stream's
+  // (or the session's) flow control window, and we mustn't hold up the
+  // calling stream while it does.  A parked task will be queued once the
+  // response it's waiting for is done.
+  if (!parked) {
+    executor_->AddTask(task_wrapper, priority);
+  }
+  Scoreboard::AddIfEnabled(scoreboard_session_, Scoreboard::PUSHES_STARTED, 1);
   return SpdyServerPushInterface::PUSH_STARTED;
 }
 
@@ -332,27 +746,54 @@ void SpdySession::OnStreamFrameData(
     }
   }
 
-  // Look up the stream to post the data to.  We need to lock when reading the
-  // stream map, because one of the stream threads could call
-  // RemoveStreamTask() at any time.
-  {
-    base::AutoLock autolock(stream_map_lock_);
-    SpdyStream* stream = stream_map_.GetStream(stream_id);
-    if (stream != NULL) {
-      VLOG(4) << "[stream " << stream_id << "] Received DATA (length="
-              << length << ")";
-      // Copy the data into an _uncompressed_ SPDY data frame and post it to
-      // the stream's input queue.
-      // Note that we must still be holding stream_map_lock_ when we call this
-      // method -- otherwise the stream may be deleted out from under us by the
-      // StreamTaskWrapper destructor.  That's okay -- PostInputFrame is a
-      // quick operation and won't block (for any appreciable length of time).
-      net::SpdyDataIR* frame =
-          new net::SpdyDataIR(stream_id, base::StringPiece(data, length));
-      frame->set_fin(fin);
-      stream->PostInputFrame(frame);
-      return;
+  // The client is uploading, so input window tuning may need to know the
+  // round trip time.
+  MaybeSendRoundTripProbe();
+
+  // Rather than posting each DATA frame to its stream as it arrives, we
+  // coalesce consecutive DATA for a stream within each read into a single
+  // frame, which is posted once the read is done (see Run).  A client that
+  // uploads in many small frames thus costs the stream thread (and the queue
+  // between us) one frame per read, rather than one per DATA frame.
+  PendingInputData* pending = NULL;
+  for (size_t i = 0; i < pending_input_data_.size(); ++i) {
+    if (pending_input_data_[i].stream_id == stream_id) {
+      pending = &pending_input_data_[i];
+      break;
+    }
+  }
+  if (pending == NULL) {
+    // Check that the stream exists before holding any data for it.  We need
+    // to lock when reading the stream map, because one of the stream threads
+    // could call RemoveStreamTask() at any time.  If the stream goes away
+    // before we post its data, PostPendingInputDataAt will take care of it.
+    bool stream_exists;
+    {
+      ProfiledAutoLock autolock(stream_map_lock_);
+      stream_exists = stream_map_.GetStream(stream_id) != NULL;
     }
+    if (stream_exists) {
+      pending_input_data_.push_back(PendingInputData());
+      pending = &pending_input_data_.back();
+      pending->stream_id = stream_id;
+      pending->fin = false;
+    }
+  }
+
+  if (pending != NULL) {
+    VLOG(4) << "[stream " << stream_id << "] Received DATA (length="
+            << length << ")";
+    Scoreboard::AddIfEnabled(scoreboard_session_,
+                             Scoreboard::BYTES_RECEIVED, length);
+    pending->data.append(data, length);
+    pending->fin = pending->fin || fin;
+    // Don't hold back the end of the stream, nor more data than a stream's
+    // input window would normally allow.
+    if (fin || pending->data.size() >=
+        static_cast<size_t>(net::kSpdyStreamInitialWindowSize)) {
+      PostPendingInputData(stream_id);
+    }
+    return;
   }
 
   // If we reach this point, it means that the client has sent us DATA for a
@@ -418,11 +859,12 @@ void SpdySession::OnSynStream(
   }
 
   StreamTaskWrapper* task_wrapper = NULL;
+  bool parked = false;  // true if the task is waiting on a coalesced request
   {
     // Lock the stream map before we start checking its size or adding a new
     // stream to it.  We need to lock when touching the stream map, because one
     // of the stream threads could call RemoveStreamTask() at any time.
-    base::AutoLock autolock(stream_map_lock_);
+    ProfiledAutoLock autolock(stream_map_lock_);
 
 #if 0
     // TODO(mdsteele): re-enable this code block when
@@ -448,13 +890,67 @@ void SpdySession::OnSynStream(
       return;
     }
 
+    // If we have a small, fresh response to this request in the micro-cache,
+    // send it right away; there's no need to create a stream task at all.
+    if (micro_cache_ != NULL && fin &&
+        spdy_version_ >= spdy::SPDY_VERSION_3 &&
+        SendMicroCachedResponse(stream_id, priority, headers)) {
+      last_client_stream_id_ = std::max(last_client_stream_id_, stream_id);
+      return;
+    }
+
+    // If an identical GET is already in flight (on this session or another),
+    // wait for its response rather than running another request through the
+    // task factory; otherwise, if this request's response might be shared,
+    // record it for any duplicates that arrive in the meantime.  Requests
+    // with a body are never coalesced, and we only know how to read the
+    // request URL in SPDY/3 and up.
+    RequestCoalescer::Follower* follower = NULL;
+    RequestCoalescer::Recorder* coalescing_recorder = NULL;
+    if (request_coalescer_ != NULL && fin &&
+        spdy_version_ >= spdy::SPDY_VERSION_3) {
+      follower = request_coalescer_->Join(headers, &coalescing_recorder);
+    }
+
     // Initiate a new stream.
     last_client_stream_id_ = std::max(last_client_stream_id_, stream_id);
     task_wrapper = new StreamTaskWrapper(
         this, stream_id, associated_stream_id,
         0, // server_push_depth = 0
-        priority);
+        priority,
+        NULL,  // cached_response = NULL
+        follower);
     stream_map_.AddStreamTask(task_wrapper);
+    parked = (follower != NULL && ParkCoalescedTask(task_wrapper, follower));
+    if (coalescing_recorder != NULL) {
+      task_wrapper->stream()->set_coalescing_recorder(coalescing_recorder);
+    }
+    // Record the response, so that we can answer this request from the
+    // micro-cache next time (if the response turns out to be cacheable).
+    if (micro_cache_ != NULL && fin &&
+        spdy_version_ >= spdy::SPDY_VERSION_3) {
+      PushResponseCache::Recorder* recorder =
+          micro_cache_->NewRecorder(headers);
+      if (recorder != NULL) {
+        task_wrapper->stream()->set_response_recorder(recorder);
+      }
+    }
+    push_pacer_.OnDocumentStreamOpened(stream_id);
+    // If we're tracking push outcomes, we'll need this stream's host and path
+    // to identify any pushes associated with it.
+    if (push_outcome_tracker_ != NULL &&
+        spdy_version_ >= spdy::SPDY_VERSION_3) {
+      const net::SpdyHeaderBlock::const_iterator host_iter =
+          headers.find(spdy::kSpdy3Host);
+      const net::SpdyHeaderBlock::const_iterator path_iter =
+          headers.find(spdy::kSpdy3Path);
+      if (host_iter != headers.end()) {
+        task_wrapper->set_request_host(host_iter->second);
+      }
+      if (path_iter != headers.end()) {
+        task_wrapper->set_request_path(path_iter->second);
+      }
+    }
     net::SpdySynStreamIR* frame = new net::SpdySynStreamIR(stream_id);
     frame->set_associated_to_stream_id(associated_stream_id);
     frame->set_priority(priority);
@@ -470,9 +966,12 @@ void SpdySession::OnSynStream(
   // task immediately (and we don't want to be holding the lock when that
   // happens).  Note that it's safe for us to pass task_wrapper here without
   // holding the lock, because the task won't get deleted before it's been
-  // added to the executor.
+  // added to the executor.  A parked task will be queued (by another thread)
+  // once the response it's waiting for is done.
   VLOG(2) << "Received SYN_STREAM; opening stream " << stream_id;
-  executor_->AddTask(task_wrapper, priority);
+  if (!parked) {
+    executor_->AddTask(task_wrapper, priority);
+  }
 }
 
 void SpdySession::OnSynReply(net::SpdyStreamId stream_id,
@@ -483,12 +982,19 @@ void SpdySession::OnSynReply(net::SpdyStreamId stream_id,
 
 void SpdySession::OnRstStream(net::SpdyStreamId stream_id,
                               net::SpdyRstStreamStatus status) {
+  PostPendingInputData(stream_id);
+  push_pacer_.OnStreamReset(stream_id);
   switch (status) {
     // These are totally benign reasons to abort a stream, so just abort the
     // stream without a fuss.
     case net::RST_STREAM_REFUSED_STREAM:
     case net::RST_STREAM_CANCEL:
       VLOG(2) << "Client cancelled/refused stream " << stream_id;
+      if (stream_id % 2u == 0u) {
+        Scoreboard::AddIfEnabled(scoreboard_session_,
+                                 Scoreboard::PUSHES_CANCELLED, 1);
+      }
+      RecordPushCancelled(stream_id);
       AbortStreamSilently(stream_id);
       break;
     // If there was an error, abort the stream, but log a warning first.
@@ -545,9 +1051,17 @@ void SpdySession::OnSetting(net::SpdySettingsIds id,
 void SpdySession::OnPing(uint32 unique_id) {
   VLOG(4) << "Received PING frame (id=" << unique_id << ")";
   // The SPDY spec requires the server to ignore even-numbered PING frames that
-  // it did not initiate (SPDY draft 3 section 2.6.5), and right now, we never
-  // initiate pings.
+  // it did not initiate (SPDY draft 3 section 2.6.5).  The only pings we
+  // initiate are to measure the round trip time for input window tuning.
   if (unique_id % 2 == 0) {
+    if (probe_ping_outstanding_ && unique_id == last_probe_ping_id_) {
+      probe_ping_outstanding_ = false;
+      const base::TimeDelta rtt =
+          base::TimeTicks::Now() - last_probe_ping_time_;
+      VLOG(3) << "Measured round trip time of " << rtt.InMilliseconds()
+              << "ms";
+      shared_window_.set_round_trip_time(rtt);
+    }
     return;
   }
 
@@ -556,6 +1070,23 @@ void SpdySession::OnPing(uint32 unique_id) {
   SendFrame(new net::SpdyPingIR(unique_id));
 }
 
+void SpdySession::MaybeSendRoundTripProbe() {
+  if (!round_trip_probes_enabled_ || probe_ping_outstanding_) {
+    return;
+  }
+  const base::TimeTicks now = base::TimeTicks::Now();
+  if (!last_probe_ping_time_.is_null() &&
+      now - last_probe_ping_time_ <
+      base::TimeDelta::FromSeconds(kRoundTripProbeIntervalSeconds)) {
+    return;
+  }
+  // Our PING IDs must be even (SPDY draft 3 section 2.6.5).
+  last_probe_ping_id_ += 2;
+  probe_ping_outstanding_ = true;
+  last_probe_ping_time_ = now;
+  SendFrame(new net::SpdyPingIR(last_probe_ping_id_));
+}
+
 void SpdySession::OnGoAway(net::SpdyStreamId last_accepted_stream_id,
                            net::SpdyGoAwayStatus status) {
   VLOG(4) << "Received GOAWAY frame (status="
@@ -565,7 +1096,7 @@ void SpdySession::OnGoAway(net::SpdyStreamId last_accepted_stream_id,
   // Take note that we have received a GOAWAY frame; we should not start any
   // new server push streams on this session.
   {
-    base::AutoLock autolock(stream_map_lock_);
+    ProfiledAutoLock autolock(stream_map_lock_);
     received_goaway_ = true;
   }
 
@@ -593,13 +1124,16 @@ void SpdySession::OnGoAway(net::SpdyStreamId last_accepted_stream_id,
 void SpdySession::OnHeaders(net::SpdyStreamId stream_id,
                             bool fin,
                             const net::SpdyHeaderBlock& headers) {
+  // Any DATA we're holding for this stream must reach it first.
+  PostPendingInputData(stream_id);
+
   // Look up the stream to post the data to.  We need to lock when reading the
   // stream map, because one of the stream threads could call
   // RemoveStreamTask() at any time.
   {
     // TODO(mdsteele): This is pretty similar to the code in OnStreamFrameData.
     //   Maybe we can factor it out?
-    base::AutoLock autolock(stream_map_lock_);
+    ProfiledAutoLock autolock(stream_map_lock_);
     SpdyStream* stream = stream_map_.GetStream(stream_id);
     if (stream != NULL) {
       VLOG(4) << "[stream " << stream_id << "] Received HEADERS frame";
@@ -653,7 +1187,7 @@ void SpdySession::OnWindowUpdate(net::SpdyStreamId stream_id,
     return;
   }
 
-  base::AutoLock autolock(stream_map_lock_);
+  ProfiledAutoLock autolock(stream_map_lock_);
   SpdyStream* stream = stream_map_.GetStream(stream_id);
   if (stream == NULL) {
     // We must ignore WINDOW_UPDATE frames for closed streams (SPDY draft 3
@@ -695,13 +1229,20 @@ void SpdySession::SetInitialWindowSize(uint32 new_init_window_size) {
   initial_window_size_ = new_init_window_size;
   // We also have to adjust the window size of all currently active streams by
   // the delta (SPDY draft 3 section 2.6.8).
-  base::AutoLock autolock(stream_map_lock_);
+  ProfiledAutoLock autolock(stream_map_lock_);
   stream_map_.AdjustAllOutputWindowSizes(delta);
 }
 
 // Compress (if necessary), send, and then delete the given frame object.
 void SpdySession::SendFrame(const net::SpdyFrameIR* frame_ptr) {
   scoped_ptr<const net::SpdyFrameIR> frame(frame_ptr);
+  // Frames with a header block go through the framer's zlib compressor, which
+  // is most of the cost of sending them, so we time those.
+  HeaderBlockVisitor visitor;
+  frame->Visit(&visitor);
+  const base::TimeTicks start_time = (visitor.block() == NULL ?
+                                      base::TimeTicks() :
+                                      base::TimeTicks::Now());
   scoped_ptr<const net::SpdySerializedFrame> serialized_frame(
       framer_.SerializeFrame(*frame));
   if (serialized_frame == NULL) {
@@ -709,10 +1250,39 @@ void SpdySession::SendFrame(const net::SpdyFrameIR* frame_ptr) {
     StopSession();
     return;
   }
+  if (visitor.block() != NULL) {
+    RecordHeaderCompression(*visitor.block(), serialized_frame->size(),
+                            base::TimeTicks::Now() - start_time);
+  }
   SendFrameRaw(*serialized_frame);
+  push_pacer_.OnFrameWritten(*frame);
+}
+
+void SpdySession::SendOrDeferFrame(net::SpdyFrameIR* frame) {
+  if (push_pacer_.OfferFrame(frame, base::TimeTicks::Now())) {
+    SendFrame(frame);
+    // Sending the frame may have let some held-back push frames go.
+    SendReadyPushFrames();
+  }
+}
+
+bool SpdySession::SendReadyPushFrames() {
+  if (!push_pacer_.HasDeferredFrames()) {
+    return false;
+  }
+  bool sent = false;
+  const base::TimeTicks now = base::TimeTicks::Now();
+  net::SpdyFrameIR* frame = NULL;
+  while (!session_stopped_ &&
+         (frame = push_pacer_.PopReadyFrame(now)) != NULL) {
+    SendFrame(frame);
+    sent = true;
+  }
+  return sent;
 }
 
 void SpdySession::SendFrameRaw(const net::SpdySerializedFrame& frame) {
+  MOD_SPDY_TRACE_EVENT1("session", "SendFrameRaw", "bytes", frame.size());
   const SpdySessionIO::WriteStatus status = session_io_->SendFrameRaw(frame);
   if (status == SpdySessionIO::WRITE_CONNECTION_CLOSED) {
     // If the connection was closed and we can't write anything to the client
@@ -720,9 +1290,28 @@ void SpdySession::SendFrameRaw(const net::SpdySerializedFrame& frame) {
     StopSession();
   } else {
     DCHECK_EQ(SpdySessionIO::WRITE_SUCCESS, status);
+    Scoreboard::AddIfEnabled(scoreboard_session_, Scoreboard::BYTES_SENT,
+                             frame.size());
   }
 }
 
+void SpdySession::RecordHeaderCompression(
+    const net::SpdyNameValueBlock& block, size_t serialized_size,
+    base::TimeDelta elapsed) {
+  const size_t raw_size = HeaderBlockBytes(block);
+  ++header_blocks_sent_;
+  header_bytes_raw_ += raw_size;
+  header_bytes_sent_ += serialized_size;
+  header_compression_time_ += elapsed;
+  Scoreboard::AddIfEnabled(scoreboard_session_, Scoreboard::HEADER_BYTES_RAW,
+                           raw_size);
+  Scoreboard::AddIfEnabled(scoreboard_session_, Scoreboard::HEADER_BYTES_SENT,
+                           serialized_size);
+  Scoreboard::AddIfEnabled(scoreboard_session_,
+                           Scoreboard::HEADER_COMPRESSION_MICROS,
+                           elapsed.InMicroseconds());
+}
+
 void SpdySession::SendGoAwayFrame(net::SpdyGoAwayStatus status) {
   if (!already_sent_goaway_) {
     already_sent_goaway_ = true;
@@ -745,11 +1334,13 @@ void SpdySession::SendSettingsFrame() {
 
 void SpdySession::StopSession() {
   session_stopped_ = true;
+  // Any DATA we were still holding is moot now.
+  pending_input_data_.clear();
   // Abort all remaining streams.  We need to lock when reading the stream
   // map, because one of the stream threads could call RemoveStreamTask() at
   // any time.
   {
-    base::AutoLock autolock(stream_map_lock_);
+    ProfiledAutoLock autolock(stream_map_lock_);
     stream_map_.AbortAllSilently();
   }
   shared_window_.Abort();
@@ -759,13 +1350,125 @@ void SpdySession::StopSession() {
   // that we must release the lock before calling this, because each stream
   // will remove itself from the stream map as it shuts down.
   executor_->Stop();
+  // Tasks still waiting on coalesced requests were never given to the
+  // executor, so we have to cancel those ourselves.
+  CancelParkedTasks();
+}
+
+bool SpdySession::SendMicroCachedResponse(
+    net::SpdyStreamId stream_id, net::SpdyPriority priority,
+    const net::SpdyHeaderBlock& request_headers) {
+  DCHECK(micro_cache_ != NULL);
+  DCHECK_GE(spdy_version_, spdy::SPDY_VERSION_3);
+  if (!MayUseMicroCache(request_headers)) {
+    return false;
+  }
+  PushResponseCache::Response response;
+  if (!micro_cache_->Lookup(request_headers, base::TimeTicks::Now(),
+                            &response)) {
+    return false;
+  }
+  if (PushResponseCache::IsNotModified(request_headers, response.headers)) {
+    MakeNotModifiedResponse(&response);
+  }
+
+  // We're on the connection thread, which mustn't block waiting for a
+  // WINDOW_UPDATE (since it's the thread that would have to process it), so
+  // the whole body must fit in the new stream's flow control window, and
+  // (for SPDY/3.1) in what's left of the session window right now.  If it
+  // doesn't, we just let the request go through Apache as usual.
+  const std::string& body = response.body;
+  if (body.size() > static_cast<size_t>(std::max(initial_window_size_, 0)) ||
+      (spdy_version_ >= spdy::SPDY_VERSION_3_1 && !body.empty() &&
+       !shared_window_.TryRequestOutputQuota(body.size()))) {
+    return false;
+  }
+
+  const int queue_priority = static_cast<int>(priority);
+  net::SpdySynReplyIR* reply = new net::SpdySynReplyIR(stream_id);
+  reply->set_fin(body.empty());
+  reply->GetMutableNameValueBlock()->insert(response.headers.begin(),
+                                            response.headers.end());
+  output_queue_.Insert(queue_priority, reply);
+  size_t offset = 0;
+  while (offset < body.size()) {
+    const size_t length =
+        std::min(kCachedPushDataFrameBytes, body.size() - offset);
+    net::SpdyDataIR* data = new net::SpdyDataIR(
+        stream_id, base::StringPiece(body.data() + offset, length));
+    offset += length;
+    data->set_fin(offset == body.size());
+    output_queue_.Insert(queue_priority, data);
+  }
+  Scoreboard::AddIfEnabled(scoreboard_session_, Scoreboard::STREAMS_TOTAL, 1);
+  VLOG(2) << "Received SYN_STREAM; answered stream " << stream_id
+          << " from the micro-cache";
+  return true;
+}
+
+void SpdySession::PostPendingInputData(net::SpdyStreamId stream_id) {
+  for (size_t i = 0; i < pending_input_data_.size(); ++i) {
+    if (pending_input_data_[i].stream_id == stream_id) {
+      PostPendingInputDataAt(i);
+      return;
+    }
+  }
+}
+
+void SpdySession::PostAllPendingInputData() {
+  while (!pending_input_data_.empty()) {
+    PostPendingInputDataAt(pending_input_data_.size() - 1);
+  }
+}
+
+void SpdySession::PostPendingInputDataAt(size_t index) {
+  DCHECK_LT(index, pending_input_data_.size());
+  const net::SpdyStreamId stream_id = pending_input_data_[index].stream_id;
+  bool posted = false;
+  {
+    ProfiledAutoLock autolock(stream_map_lock_);
+    SpdyStream* stream = stream_map_.GetStream(stream_id);
+    if (stream != NULL) {
+      // Move the data into an _uncompressed_ SPDY data frame and post it to
+      // the stream's input queue.  This is the only copy of the data we make
+      // after taking it from the framer, however many DATA frames it came in.
+      // Note that we must still be holding stream_map_lock_ when we call this
+      // method -- otherwise the stream may be deleted out from under us by
+      // the StreamTaskWrapper destructor.  That's okay -- PostInputFrame is a
+      // quick operation and won't block (for any appreciable length of time).
+      PendingInputData& pending = pending_input_data_[index];
+      net::SpdyDataIR* frame =
+          new OwnedPayloadDataIR(stream_id, &pending.data);
+      frame->set_fin(pending.fin);
+      stream->PostInputFrame(frame);
+      posted = true;
+    }
+  }
+
+  // The stream may have closed (e.g. the stream thread gave up on it) while
+  // we were holding its data.  In that case, treat the data the same way
+  // OnStreamFrameData treats DATA for a nonexistant stream.
+  PendingInputData& entry = pending_input_data_[index];
+  const bool had_data = !entry.data.empty();  // only matters if not posted
+  PendingInputData& last = pending_input_data_.back();
+  if (&entry != &last) {
+    entry.stream_id = last.stream_id;
+    entry.data.swap(last.data);
+    entry.fin = last.fin;
+  }
+  pending_input_data_.pop_back();
+  if (!posted && had_data) {
+    LOG(WARNING) << "Stream " << stream_id << " closed before its DATA "
+                 << "could be delivered";
+    SendRstStreamFrame(stream_id, net::RST_STREAM_INVALID_STREAM);
+  }
 }
 
 // Abort the stream without sending anything to the client.
 void SpdySession::AbortStreamSilently(net::SpdyStreamId stream_id) {
   // We need to lock when reading the stream map, because one of the stream
   // threads could call RemoveStreamTask() at any time.
-  base::AutoLock autolock(stream_map_lock_);
+  ProfiledAutoLock autolock(stream_map_lock_);
   SpdyStream* stream = stream_map_.GetStream(stream_id);
   if (stream != NULL) {
     stream->AbortSilently();
@@ -787,16 +1490,149 @@ void SpdySession::AbortStream(net::SpdyStreamId stream_id,
 void SpdySession::RemoveStreamTask(StreamTaskWrapper* task_wrapper) {
   // We need to lock when touching the stream map, in case the main connection
   // thread is currently in the middle of reading the stream map.
-  base::AutoLock autolock(stream_map_lock_);
-  VLOG(2) << "Closing stream " << task_wrapper->stream()->stream_id();
+  ProfiledAutoLock autolock(stream_map_lock_);
+  SpdyStream* stream = task_wrapper->stream();
+  VLOG(2) << "Closing stream " << stream->stream_id();
+  // A server push that wasn't aborted has been sent in full.  Report that to
+  // the outcome tracker, but remember the push for a little while in case the
+  // client cancels it anyway (having not yet seen the end of it).
+  if (push_outcome_tracker_ != NULL && stream->is_server_push() &&
+      !stream->is_aborted() &&
+      !task_wrapper->associated_request_path().empty()) {
+    FinishedPush& push = finished_pushes_[stream->stream_id()];
+    push.host = task_wrapper->request_host();
+    push.master_path = task_wrapper->associated_request_path();
+    push.pushed_path = task_wrapper->request_path();
+    push.bytes_sent = stream->output_data_bytes();
+    push_outcome_tracker_->RecordCompleted(
+        push.host, push.master_path, push.pushed_path, push.bytes_sent,
+        base::TimeTicks::Now());
+    // Push stream IDs are increasing, so the first entry is the oldest.
+    if (finished_pushes_.size() > kMaxFinishedPushesRemembered) {
+      finished_pushes_.erase(finished_pushes_.begin());
+    }
+  }
+  window_updates_.DropStream(stream->stream_id());
   stream_map_.RemoveStreamTask(task_wrapper);
 }
 
+bool SpdySession::ParkCoalescedTask(StreamTaskWrapper* task_wrapper,
+                                    RequestCoalescer::Follower* follower) {
+  stream_map_lock_.AssertAcquired();
+  const net::SpdyStreamId stream_id = task_wrapper->stream()->stream_id();
+  CoalescedTaskStarter* starter = new CoalescedTaskStarter(this, stream_id);
+  if (!follower->NotifyWhenDone(starter)) {
+    delete starter;
+    return false;
+  }
+  // The starter can't get at parked_tasks_ until we release the lock.
+  ++num_task_starters_;
+  parked_tasks_[stream_id] = task_wrapper;
+  VLOG(3) << "Parking stream " << stream_id
+          << " until the request it was coalesced with is done";
+  return true;
+}
+
+void SpdySession::StartParkedTask(net::SpdyStreamId stream_id) {
+  StreamTaskWrapper* task_wrapper = NULL;
+  net::SpdyPriority priority = 0;
+  {
+    ProfiledAutoLock autolock(stream_map_lock_);
+    const std::map<net::SpdyStreamId, StreamTaskWrapper*>::iterator iter =
+        parked_tasks_.find(stream_id);
+    if (iter != parked_tasks_.end()) {
+      task_wrapper = iter->second;
+      priority = task_wrapper->stream()->priority();
+      parked_tasks_.erase(iter);
+    }
+  }
+  // As in OnSynStream, we mustn't hold the lock while adding the task.  If
+  // the session is stopping, the executor will simply cancel the task.
+  if (task_wrapper != NULL) {
+    executor_->AddTask(task_wrapper, priority);
+  }
+  OnTaskStarterDone();
+}
+
+void SpdySession::OnTaskStarterDone() {
+  ProfiledAutoLock autolock(stream_map_lock_);
+  DCHECK_GT(num_task_starters_, 0);
+  if (--num_task_starters_ == 0) {
+    task_starters_condvar_.Broadcast();
+  }
+}
+
+void SpdySession::CancelParkedTasks() {
+  std::vector<StreamTaskWrapper*> task_wrappers;
+  {
+    ProfiledAutoLock autolock(stream_map_lock_);
+    for (std::map<net::SpdyStreamId, StreamTaskWrapper*>::const_iterator
+             iter = parked_tasks_.begin();
+         iter != parked_tasks_.end(); ++iter) {
+      task_wrappers.push_back(iter->second);
+    }
+    parked_tasks_.clear();
+  }
+  // Cancelling each task deletes its follower, which cancels its
+  // CoalescedTaskStarter (unless that is already being run).  Each task
+  // removes itself from the stream map, so we mustn't hold the lock here.
+  for (std::vector<StreamTaskWrapper*>::const_iterator iter =
+           task_wrappers.begin(); iter != task_wrappers.end(); ++iter) {
+    (*iter)->CallCancel();
+  }
+  // A starter that was already being run may still be using this session.
+  ProfiledAutoLock autolock(stream_map_lock_);
+  while (num_task_starters_ > 0) {
+    task_starters_condvar_.Wait();
+  }
+}
+
+void SpdySession::RecordPushCancelled(net::SpdyStreamId stream_id) {
+  // Only server pushes (which have even stream IDs) are of interest here.
+  if (push_outcome_tracker_ == NULL || stream_id % 2u != 0u) {
+    return;
+  }
+  ProfiledAutoLock autolock(stream_map_lock_);
+  const StreamTaskWrapper* task_wrapper = stream_map_.GetStreamTask(stream_id);
+  if (task_wrapper != NULL) {
+    if (!task_wrapper->associated_request_path().empty()) {
+      push_outcome_tracker_->RecordCancelled(
+          task_wrapper->request_host(),
+          task_wrapper->associated_request_path(),
+          task_wrapper->request_path(),
+          task_wrapper->stream()->output_data_bytes(),
+          false,  // was_completed
+          base::TimeTicks::Now());
+    }
+    return;
+  }
+  const FinishedPushMap::iterator iter = finished_pushes_.find(stream_id);
+  if (iter != finished_pushes_.end()) {
+    push_outcome_tracker_->RecordCancelled(
+        iter->second.host, iter->second.master_path, iter->second.pushed_path,
+        iter->second.bytes_sent,
+        true,  // was_completed
+        base::TimeTicks::Now());
+    finished_pushes_.erase(iter);
+  }
+}
+
 bool SpdySession::StreamMapIsEmpty() {
-  base::AutoLock autolock(stream_map_lock_);
+  ProfiledAutoLock autolock(stream_map_lock_);
   return stream_map_.IsEmpty();
 }
 
+void SpdySession::UpdateScoreboardQueueDepth(size_t depth) {
+  if (depth != reported_queue_depth_) {
+    // The process counter sums over all sessions, so report the change rather
+    // than setting it outright.
+    Scoreboard::AddIfEnabled(
+        scoreboard_session_, Scoreboard::OUTPUT_QUEUE_DEPTH,
+        static_cast<int64>(depth) - static_cast<int64>(reported_queue_depth_));
+    reported_queue_depth_ = depth;
+  }
+}
+
 // This constructor is always called by the main connection thread, so we're
 // safe to call spdy_session_->task_factory_->NewStreamTask().  However,
 // the other methods of this class (Run(), Cancel(), and the destructor) are
@@ -806,17 +1642,39 @@ SpdySession::StreamTaskWrapper::StreamTaskWrapper(
     net::SpdyStreamId stream_id,
     net::SpdyStreamId associated_stream_id,
     int32 server_push_depth,
-    net::SpdyPriority priority)
+    net::SpdyPriority priority,
+    PushResponseCache::Response* cached_response,
+    RequestCoalescer::Follower* follower)
     : spdy_session_(spdy_session),
       stream_(spdy_session->spdy_version(), stream_id, associated_stream_id,
               server_push_depth, priority, spdy_session_->initial_window_size_,
               &spdy_session_->output_queue_, &spdy_session_->shared_window_,
               spdy_session_),
-      subtask_(spdy_session_->task_factory_->NewStreamTask(&stream_)) {
+      subtask_(cached_response != NULL ?
+               new CachedPushTask(&stream_, cached_response) :
+               follower != NULL ?
+               new CoalescedRequestTask(&stream_, follower,
+                                        spdy_session_->task_factory_) :
+               spdy_session_->task_factory_->NewStreamTask(&stream_)) {
+  DCHECK(cached_response == NULL || follower == NULL);
   CHECK(subtask_);
+  stream_.set_scoreboard_session(spdy_session_->scoreboard_session_);
+  stream_.set_window_update_aggregator(&spdy_session_->window_updates_);
+  if (spdy_session_->max_stream_input_window_size_ > 0 &&
+      !stream_.is_server_push()) {
+    stream_.EnableInputWindowTuning(
+        spdy_session_->max_stream_input_window_size_,
+        ReceiveWindowBudget::Instance());
+  }
+  Scoreboard::AddIfEnabled(spdy_session_->scoreboard_session_,
+                           Scoreboard::STREAMS_ACTIVE, 1);
+  Scoreboard::AddIfEnabled(spdy_session_->scoreboard_session_,
+                           Scoreboard::STREAMS_TOTAL, 1);
 }
 
 SpdySession::StreamTaskWrapper::~StreamTaskWrapper() {
+  Scoreboard::AddIfEnabled(spdy_session_->scoreboard_session_,
+                           Scoreboard::STREAMS_ACTIVE, -1);
   // Remove this object from the SpdySession's stream map.
   spdy_session_->RemoveStreamTask(this);
 }
@@ -885,18 +1743,26 @@ void SpdySession::SpdyStreamMap::RemoveStreamTask(
 
 SpdyStream* SpdySession::SpdyStreamMap::GetStream(
     net::SpdyStreamId stream_id) {
-  TaskMap::const_iterator iter = tasks_.find(stream_id);
-  if (iter == tasks_.end()) {
+  StreamTaskWrapper* task_wrapper = GetStreamTask(stream_id);
+  if (task_wrapper == NULL) {
     return NULL;
   }
-  StreamTaskWrapper* task_wrapper = iter->second;
-  DCHECK(task_wrapper);
   SpdyStream* stream = task_wrapper->stream();
   DCHECK(stream);
   DCHECK_EQ(stream_id, stream->stream_id());
   return stream;
 }
 
+SpdySession::StreamTaskWrapper* SpdySession::SpdyStreamMap::GetStreamTask(
+    net::SpdyStreamId stream_id) {
+  TaskMap::const_iterator iter = tasks_.find(stream_id);
+  if (iter == tasks_.end()) {
+    return NULL;
+  }
+  DCHECK(iter->second);
+  return iter->second;
+}
+
 void SpdySession::SpdyStreamMap::AdjustAllOutputWindowSizes(int32 delta) {
   for (TaskMap::const_iterator iter = tasks_.begin();
        iter != tasks_.end(); ++iter) {
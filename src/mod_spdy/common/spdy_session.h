@@ -16,15 +16,22 @@
 #define MOD_SPDY_COMMON_SPDY_SESSION_H_
 
 #include <map>
+#include <string>
+#include <vector>
 
 #include "base/basictypes.h"
-#include "base/synchronization/lock.h"
+#include "base/time/time.h"
 #include "mod_spdy/common/executor.h"
+#include "mod_spdy/common/profiled_lock.h"
 #include "mod_spdy/common/protocol_util.h"
+#include "mod_spdy/common/push_response_cache.h"
+#include "mod_spdy/common/request_coalescer.h"
+#include "mod_spdy/common/server_push_pacer.h"
 #include "mod_spdy/common/shared_flow_control_window.h"
 #include "mod_spdy/common/spdy_frame_priority_queue.h"
 #include "mod_spdy/common/spdy_server_push_interface.h"
 #include "mod_spdy/common/spdy_stream.h"
+#include "mod_spdy/common/window_update_aggregator.h"
 #include "net/instaweb/util/public/function.h"
 #include "net/spdy/buffered_spdy_framer.h"
 #include "net/spdy/spdy_protocol.h"
@@ -32,6 +39,7 @@
 namespace mod_spdy {
 
 class Executor;
+class ServerPushOutcomeTracker;
 class SpdySessionIO;
 class SpdyServerConfig;
 class SpdyStreamTaskFactory;
@@ -60,6 +68,51 @@ class SpdySession : public net::BufferedSpdyFramerVisitorInterface,
   int32 current_shared_input_window_size() const;
   int32 current_shared_output_window_size() const;
 
+  // Use the given cache (which may be shared with other sessions) to serve
+  // repeated server pushes without running them through the executor.  The
+  // session does _not_ take ownership of the cache.  This is optional, and if
+  // used, must be called before Run().
+  void set_push_response_cache(PushResponseCache* cache) {
+    push_response_cache_ = cache;
+  }
+
+  // Answer client GET requests from the given cache (which may be shared
+  // with other sessions on the same virtual host) when it holds a fresh,
+  // small response, straight from the connection thread and without running
+  // a stream task at all; and record cacheable responses to other GETs into
+  // it.  The session does _not_ take ownership of the cache.  This is
+  // optional, and if used, must be called before Run().  It has no effect on
+  // SPDY/2 sessions.
+  void set_micro_cache(PushResponseCache* cache) { micro_cache_ = cache; }
+
+  // Use the given coalescer (which may be shared with other sessions) to
+  // collapse identical GET requests -- from the client or for server pushes
+  // -- that are in flight at the same time into a single request through the
+  // stream task factory.  The session does _not_ take ownership of the
+  // coalescer.  This is optional, and if used, must be called before Run().
+  void set_request_coalescer(RequestCoalescer* coalescer) {
+    request_coalescer_ = coalescer;
+  }
+
+  // Report the outcome of each server push -- completed, or cancelled by the
+  // client -- to the given tracker (which may be shared with other sessions).
+  // The session does _not_ take ownership of the tracker.  This is optional,
+  // and if used, must be called before Run().
+  void set_push_outcome_tracker(ServerPushOutcomeTracker* tracker) {
+    push_outcome_tracker_ = tracker;
+  }
+
+  // How many bytes of DATA payload has this session sent on server pushes,
+  // and on the client's own streams?  Since these are updated by the
+  // connection thread as it sends frames, they should be called only from
+  // that thread, or after Run() has returned.
+  uint64 push_data_bytes_sent() const {
+    return push_pacer_.push_data_bytes_written();
+  }
+  uint64 document_data_bytes_sent() const {
+    return push_pacer_.document_data_bytes_written();
+  }
+
   // Process the session; don't return until the session is finished.
   void Run();
 
@@ -114,16 +167,39 @@ class SpdySession : public net::BufferedSpdyFramerVisitorInterface,
   class StreamTaskWrapper : public net_instaweb::Function {
    public:
     // This constructor, called by the main connection thread, will call
-    // task_factory_->NewStreamTask() to produce the wrapped task.
+    // task_factory_->NewStreamTask() to produce the wrapped task.  If
+    // cached_response is non-NULL, the wrapped task will instead simply send
+    // that response to the client; if follower is non-NULL, it will send a
+    // copy of the response to the request this one was coalesced with, and
+    // so must not be run until that response is done (see
+    // ParkCoalescedTask).  This takes ownership of cached_response and
+    // follower.
     StreamTaskWrapper(SpdySession* spdy_session,
                       net::SpdyStreamId stream_id,
                       net::SpdyStreamId associated_stream_id,
                       int32 server_push_depth,
-                      net::SpdyPriority priority);
+                      net::SpdyPriority priority,
+                      PushResponseCache::Response* cached_response,
+                      RequestCoalescer::Follower* follower);
     virtual ~StreamTaskWrapper();
 
     SpdyStream* stream() { return &stream_; }
 
+    // The request host and path of this stream and, for server pushes, the
+    // path of the stream it is associated with (a push's host is that of its
+    // associated stream).  These are only recorded if the session has a
+    // ServerPushOutcomeTracker, and are protected by the stream_map_lock_.
+    const std::string& request_host() const { return request_host_; }
+    void set_request_host(const std::string& host) { request_host_ = host; }
+    const std::string& request_path() const { return request_path_; }
+    void set_request_path(const std::string& path) { request_path_ = path; }
+    const std::string& associated_request_path() const {
+      return associated_request_path_;
+    }
+    void set_associated_request_path(const std::string& path) {
+      associated_request_path_ = path;
+    }
+
    protected:
     // net_instaweb::Function methods (our implementations of these simply
     // run/cancel the wrapped subtask):
@@ -134,6 +210,9 @@ class SpdySession : public net::BufferedSpdyFramerVisitorInterface,
     SpdySession* const spdy_session_;
     SpdyStream stream_;
     net_instaweb::Function* const subtask_;
+    std::string request_host_;
+    std::string request_path_;
+    std::string associated_request_path_;
 
     DISALLOW_COPY_AND_ASSIGN(StreamTaskWrapper);
   };
@@ -157,6 +236,8 @@ class SpdySession : public net::BufferedSpdyFramerVisitorInterface,
     bool IsStreamActive(net::SpdyStreamId stream_id);
     // Get the specified stream object, or NULL if the stream is inactive.
     SpdyStream* GetStream(net::SpdyStreamId stream_id);
+    // Get the specified stream task, or NULL if the stream is inactive.
+    StreamTaskWrapper* GetStreamTask(net::SpdyStreamId stream_id);
     // Add a new stream.  Requires that the stream ID is currently inactive.
     void AddStreamTask(StreamTaskWrapper* task);
     // Remove a stream task.  Requires that the stream is currently active.
@@ -175,6 +256,27 @@ class SpdySession : public net::BufferedSpdyFramerVisitorInterface,
     DISALLOW_COPY_AND_ASSIGN(SpdyStreamMap);
   };
 
+  // Queues the task of a stream that was coalesced with another request, once
+  // that request's response is done; see ParkCoalescedTask.
+  class CoalescedTaskStarter;
+
+  // A server push that has finished, as remembered for RecordPushCancelled.
+  struct FinishedPush {
+    std::string host;
+    std::string master_path;
+    std::string pushed_path;
+    uint64 bytes_sent;
+  };
+  typedef std::map<net::SpdyStreamId, FinishedPush> FinishedPushMap;
+
+  // DATA received for a stream during the current read that has not yet been
+  // posted to the stream; see OnStreamFrameData.
+  struct PendingInputData {
+    net::SpdyStreamId stream_id;
+    std::string data;
+    bool fin;
+  };
+
   // Validate and set the per-stream initial flow-control window size to the
   // new value.  Must be using SPDY v3 or later to call this method.
   void SetInitialWindowSize(uint32 new_init_window_size);
@@ -183,9 +285,22 @@ class SpdySession : public net::BufferedSpdyFramerVisitorInterface,
   // Stop the session if the connection turns out to be closed.  This method
   // takes ownership of the passed frame and will delete it.
   void SendFrame(const net::SpdyFrameIR* frame);
+  // Send a frame taken from the output queue, unless the push pacer wants to
+  // hold it back for now, and then send whatever held-back frames the pacer
+  // is now ready to release.  Takes ownership of the passed frame.
+  void SendOrDeferFrame(net::SpdyFrameIR* frame);
+  // Send any frames that the push pacer is ready to release.  Returns true if
+  // any frames were sent.
+  bool SendReadyPushFrames();
   // Send the frame as-is (without taking ownership).  Stop the session if the
   // connection turns out to be closed.
   void SendFrameRaw(const net::SpdySerializedFrame& frame);
+  // Add a header block that SendFrame has just compressed, into a frame of
+  // the given size, taking the given time, to this session's totals (and to
+  // the Scoreboard).
+  void RecordHeaderCompression(const net::SpdyNameValueBlock& block,
+                               size_t serialized_size,
+                               base::TimeDelta elapsed);
 
   // Immediately send a GOAWAY frame to the client with the given status,
   // unless we've already sent one.  This also prevents us from creating any
@@ -217,9 +332,57 @@ class SpdySession : public net::BufferedSpdyFramerVisitorInterface,
   // StreamTaskWrapper destructor, which is called by the executor).
   void RemoveStreamTask(StreamTaskWrapper* stream_data);
 
+  // If the given stream is (or recently was) a server push, report to the
+  // push outcome tracker that the client cancelled it.
+  void RecordPushCancelled(net::SpdyStreamId stream_id);
+
+  // Arrange for the given task, which was just added to the stream map and
+  // whose stream was coalesced with another request, to be queued once that
+  // request's response is done, and return true.  If the response is already
+  // done, return false; the caller should queue the task right away instead.
+  // Caller must be holding stream_map_lock_.
+  bool ParkCoalescedTask(StreamTaskWrapper* task_wrapper,
+                         RequestCoalescer::Follower* follower);
+  // Queue the parked task for the given stream, if it is still parked.  This
+  // is called by a CoalescedTaskStarter, on the thread that finished the
+  // response the stream was waiting for.
+  void StartParkedTask(net::SpdyStreamId stream_id);
+  // Called when a CoalescedTaskStarter has been run or cancelled.
+  void OnTaskStarterDone();
+  // Cancel all tasks that are still parked, and block until no
+  // CoalescedTaskStarter is left that might touch this session.  The executor
+  // must already have been stopped.
+  void CancelParkedTasks();
+
   // Grab the stream_map_lock_ and check if stream_map_ is empty.
   bool StreamMapIsEmpty();
 
+  // Report the change in the output queue depth since the last call to the
+  // Scoreboard.
+  void UpdateScoreboardQueueDepth(size_t depth);
+
+  // If input windows are being tuned, and we have no recent measurement of
+  // the round trip time, send a PING to measure it; OnPing() records the
+  // result in the shared window when the client echoes it.
+  void MaybeSendRoundTripProbe();
+
+  // If the micro-cache holds a fresh response to this client request, and
+  // that response can be sent without waiting for flow control, send it on
+  // the given stream right away and return true; otherwise, return false.
+  bool SendMicroCachedResponse(net::SpdyStreamId stream_id,
+                               net::SpdyPriority priority,
+                               const net::SpdyHeaderBlock& request_headers);
+
+  // Post the DATA held back for the given stream (if any) to the stream's
+  // input queue as a single frame.  This must be done before passing along
+  // any other frame for that stream, to keep the stream's input in order.
+  void PostPendingInputData(net::SpdyStreamId stream_id);
+  // Post the DATA held back for all streams, as above.
+  void PostAllPendingInputData();
+  // Post (or, if the stream has since gone away, discard) the given entry of
+  // pending_input_data_, and remove it.
+  void PostPendingInputDataAt(size_t index);
+
   // These fields are accessed only by the main connection thread, so they need
   // not be protected by a lock:
   const spdy::SpdyVersion spdy_version_;
@@ -233,6 +396,32 @@ class SpdySession : public net::BufferedSpdyFramerVisitorInterface,
   net::SpdyStreamId last_client_stream_id_;
   int32 initial_window_size_;  // per-stream initial flow-control window size
   uint32 max_concurrent_pushes_;  // max number of active server pushes at once
+  PushResponseCache* push_response_cache_;  // may be NULL; thread-safe
+  PushResponseCache* micro_cache_;  // may be NULL; thread-safe
+  RequestCoalescer* request_coalescer_;  // may be NULL; thread-safe
+  ServerPushOutcomeTracker* push_outcome_tracker_;  // may be NULL; thread-safe
+  // Our Scoreboard session slot (or Scoreboard::kNoSession).  This is set
+  // before any stream tasks are created, so they may read it too.
+  int scoreboard_session_;
+  size_t reported_queue_depth_;  // last output queue depth sent to Scoreboard
+  ServerPushPacer push_pacer_;  // holds back pushes that would delay documents
+  // Size to which each stream's input window may grow, or zero if stream
+  // windows stay at their initial size.  This is set before any stream tasks
+  // are created, so they may read it too.
+  int32 max_stream_input_window_size_;
+  bool round_trip_probes_enabled_;  // true if tuning any input window
+  uint32 last_probe_ping_id_;  // ID of our last PING (even), or 0 if none
+  bool probe_ping_outstanding_;  // we're waiting for the client to echo it
+  base::TimeTicks last_probe_ping_time_;  // when we sent that PING
+  // Totals for the header blocks we've compressed and sent, for measuring the
+  // cost of header compression on this session.
+  int64 header_blocks_sent_;
+  int64 header_bytes_raw_;  // names and values, before compression
+  int64 header_bytes_sent_;  // serialized frames carrying the blocks
+  base::TimeDelta header_compression_time_;
+  // DATA from the current read, coalesced per stream.  This is rarely more
+  // than a few entries long, so we just search it linearly.
+  std::vector<PendingInputData> pending_input_data_;
 
   // The stream map must be protected by a lock, because each stream thread
   // will remove itself from the map (by calling RemoveStreamTask) when the
@@ -242,7 +431,7 @@ class SpdySession : public net::BufferedSpdyFramerVisitorInterface,
   // deleted by another thread while you're using it.  You should NOT be
   // holding the lock when you e.g. send a frame to the client, as that may
   // block for a long time.
-  base::Lock stream_map_lock_;
+  ProfiledLock stream_map_lock_;
   SpdyStreamMap stream_map_;
   // These fields are also protected by the stream_map_lock_; they are used for
   // controlling server pushes, which can be initiated by stream threads as
@@ -250,11 +439,24 @@ class SpdySession : public net::BufferedSpdyFramerVisitorInterface,
   // but right now we probably don't need that much locking granularity.
   net::SpdyStreamId last_server_push_stream_id_;
   bool received_goaway_;  // we've received a GOAWAY frame from the client
+  // Server pushes that have recently run to completion, so that if the
+  // client's RST_STREAM for one arrives after we've finished sending it, the
+  // push outcome tracker can still count it as cancelled.
+  FinishedPushMap finished_pushes_;
+  // Tasks of coalesced streams that are waiting for the request they were
+  // coalesced with, and so haven't been given to the executor yet; they
+  // remain in the stream map all the while.  We also count the
+  // CoalescedTaskStarters that haven't yet been run or cancelled, so that
+  // CancelParkedTasks can wait for them.
+  std::map<net::SpdyStreamId, StreamTaskWrapper*> parked_tasks_;
+  int num_task_starters_;
+  ProfiledConditionVariable task_starters_condvar_;
 
   // These objects are also shared between all stream threads, but these
   // classes are each thread-safe, and don't need additional synchronization.
   SpdyFramePriorityQueue output_queue_;
   SharedFlowControlWindow shared_window_;
+  WindowUpdateAggregator window_updates_;
 
   DISALLOW_COPY_AND_ASSIGN(SpdySession);
 };
@@ -20,7 +20,11 @@
 #include "base/basictypes.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/time/time.h"
 #include "mod_spdy/common/protocol_util.h"
+#include "mod_spdy/common/push_response_cache.h"
+#include "mod_spdy/common/request_coalescer.h"
+#include "mod_spdy/common/server_push_outcome_tracker.h"
 #include "mod_spdy/common/spdy_server_config.h"
 #include "mod_spdy/common/spdy_session_io.h"
 #include "mod_spdy/common/spdy_stream_task_factory.h"
@@ -81,6 +85,13 @@ void AddResponseHeaders(mod_spdy::spdy::SpdyVersion version,
   (*headers)[mod_spdy::http::kContentType] = "text/html";
 }
 
+void AddCacheableResponseHeaders(mod_spdy::spdy::SpdyVersion version,
+                                 net::SpdyNameValueBlock *headers) {
+  AddResponseHeaders(version, headers);
+  (*headers)[mod_spdy::http::kCacheControl] = "max-age=3600";
+  (*headers)[mod_spdy::http::kETag] = "\"v1\"";
+}
+
 void AddInitialServerPushHeaders(const std::string& path,
                                  net::SpdyNameValueBlock *headers) {
   (*headers)[mod_spdy::spdy::kSpdy3Host] = "www.example.com";
@@ -136,6 +147,17 @@ ACTION_P(SendResponseHeaders, task) {
   }
 }
 
+// gMock action to be used with MockStreamTask::Run.
+ACTION_P(SendCacheableResponseHeaders, task) {
+  net::SpdyHeaderBlock headers;
+  AddCacheableResponseHeaders(task->stream->spdy_version(), &headers);
+  if (task->stream->is_server_push()) {
+    task->stream->SendOutputHeaders(headers, false);
+  } else {
+    task->stream->SendOutputSynReply(headers, false);
+  }
+}
+
 // gMock action to be used with MockStreamTask::Run.
 ACTION_P3(SendDataFrame, task, data, fin) {
   task->stream->SendOutputDataFrame(data, fin);
@@ -151,6 +173,21 @@ ACTION_P(ConsumeInputUntilAborted, task) {
   }
 }
 
+// gMock action to be used with MockStreamTask::Run.  Expects the stream's
+// input to be exactly one DATA frame, with FLAG_FIN and the given payload.
+ACTION_P2(ReceiveOnlyInputData, task, payload) {
+  net::SpdyFrameIR* raw_frame = NULL;
+  EXPECT_TRUE(task->stream->GetInputFrame(false, &raw_frame));
+  scoped_ptr<net::SpdyFrameIR> frame(raw_frame);
+  if (frame.get() != NULL) {
+    EXPECT_THAT(*frame, IsDataFrame(task->stream->stream_id(), true,
+                                    payload));
+  }
+  raw_frame = NULL;
+  EXPECT_FALSE(task->stream->GetInputFrame(false, &raw_frame));
+  delete raw_frame;
+}
+
 // An executor that runs all tasks in the same thread, either immediately when
 // they are added or when it is told to run them.
 class InlineExecutor : public mod_spdy::Executor {
@@ -375,6 +412,17 @@ class SpdySessionTestBase :
     ReceiveFrameFromClient(*frame);
   }
 
+  // Join the last |count| chunks in the input queue into one, so that they
+  // will all be read at once.
+  void JoinLastInputChunks(size_t count) {
+    std::string joined;
+    for (; count > 0; --count) {
+      joined.insert(0, input_queue_.back());
+      input_queue_.pop_back();
+    }
+    input_queue_.push_back(joined);
+  }
+
   // Push a SETTINGS frame into the input queue.
   void ReceiveSettingsFrameFromClient(
       net::SpdySettingsIds setting, uint32 value) {
@@ -385,6 +433,14 @@ class SpdySessionTestBase :
     ReceiveFrameFromClient(*frame);
   }
 
+  // Push a RST_STREAM frame into the input queue.
+  void ReceiveRstStreamFromClient(
+      net::SpdyStreamId stream_id, net::SpdyRstStreamStatus status) {
+    scoped_ptr<net::SpdySerializedFrame> frame(
+        client_framer_.CreateRstStream(stream_id, status));
+    ReceiveFrameFromClient(*frame);
+  }
+
   // Push a WINDOW_UPDATE frame into the input queue.
   void ReceiveWindowUpdateFrameFromClient(
       net::SpdyStreamId stream_id, uint32 delta) {
@@ -529,6 +585,48 @@ TEST_P(SpdySessionTest, SingleStream) {
   EXPECT_TRUE(executor_.stopped());
 }
 
+// Test that DATA frames for a stream that arrive in a single read are handed
+// to the stream as one frame.
+TEST_P(SpdySessionTest, CoalesceInputDataFrames) {
+  MockStreamTask* task = new MockStreamTask;
+  executor_.set_run_on_add(false);
+  const net::SpdyStreamId stream_id = 1;
+  const net::SpdyPriority priority = 2;
+  ReceiveSynStreamFromClient(stream_id, priority, net::CONTROL_FLAG_NONE);
+  ReceiveDataFromClient(stream_id, "foo", net::DATA_FLAG_NONE);
+  ReceiveDataFromClient(stream_id, "bar", net::DATA_FLAG_NONE);
+  ReceiveDataFromClient(stream_id, "baz", net::DATA_FLAG_FIN);
+  JoinLastInputChunks(3);
+
+  testing::InSequence seq;
+  ExpectSendFrame(IsSettings(net::SETTINGS_MAX_CONCURRENT_STREAMS, 100));
+  EXPECT_CALL(session_io_, IsConnectionAborted());
+  EXPECT_CALL(session_io_, ProcessAvailableInput(Eq(true), NotNull()));
+  EXPECT_CALL(task_factory_, NewStreamTask(
+      AllOf(Property(&mod_spdy::SpdyStream::stream_id, Eq(stream_id)),
+            Property(&mod_spdy::SpdyStream::associated_stream_id, Eq(0u)),
+            Property(&mod_spdy::SpdyStream::priority, Eq(priority)))))
+      .WillOnce(ReturnMockTask(task));
+  EXPECT_CALL(session_io_, IsConnectionAborted());
+  EXPECT_CALL(session_io_, ProcessAvailableInput(Eq(false), NotNull()));
+  EXPECT_CALL(session_io_, IsConnectionAborted())
+      .WillOnce(DoAll(InvokeWithoutArgs(&executor_, &InlineExecutor::RunAll),
+                      Return(false)));
+  EXPECT_CALL(*task, Run()).WillOnce(DoAll(
+      ReceiveOnlyInputData(task, "foobarbaz"), SendResponseHeaders(task),
+      SendDataFrame(task, "quux", true)));
+  EXPECT_CALL(session_io_, ProcessAvailableInput(Eq(false), NotNull()));
+  ExpectSendSynReply(stream_id, false);
+  ExpectSendFrame(IsDataFrame(stream_id, true, "quux"));
+  EXPECT_CALL(session_io_, IsConnectionAborted());
+  EXPECT_CALL(session_io_, ProcessAvailableInput(Eq(true), NotNull()))
+      .WillOnce(Return(mod_spdy::SpdySessionIO::READ_CONNECTION_CLOSED));
+  ExpectSendGoAway(1, net::GOAWAY_OK);
+
+  session_.Run();
+  EXPECT_TRUE(executor_.stopped());
+}
+
 // Test that if SendFrameRaw fails, we immediately stop trying to send data and
 // shut down the session.
 TEST_P(SpdySessionTest, ShutDownSessionIfSendFrameRawFails) {
@@ -1063,6 +1161,286 @@ TEST_P(SpdySessionServerPushTest, TooManyConcurrentPushes) {
   EXPECT_TRUE(executor_.stopped());
 }
 
+// Test that once a pushed response has been stored in the push cache, pushing
+// the same resource again is served from the cache without creating a new
+// stream task.
+TEST_P(SpdySessionServerPushTest, ServerPushFromCache) {
+  mod_spdy::PushResponseCache cache(100000, 10000);
+  session_.set_push_response_cache(&cache);
+  MockStreamTask* task1 = new MockStreamTask;
+  MockStreamTask* task2 = new MockStreamTask;
+  executor_.set_run_on_add(true);
+  const net::SpdyStreamId stream_id = 3;
+  const net::SpdyPriority priority = 2;
+  const net::SpdyPriority push_priority = 3;
+  const std::string push_path = "/script.js";
+  ReceiveSynStreamFromClient(stream_id, priority, net::CONTROL_FLAG_FIN);
+
+  testing::InSequence seq;
+  ExpectSendFrame(IsSettings(net::SETTINGS_MAX_CONCURRENT_STREAMS, 100));
+  EXPECT_CALL(session_io_, IsConnectionAborted());
+  EXPECT_CALL(session_io_, ProcessAvailableInput(Eq(true), NotNull()));
+  EXPECT_CALL(task_factory_, NewStreamTask(
+      Property(&mod_spdy::SpdyStream::stream_id, Eq(stream_id))))
+      .WillOnce(ReturnMockTask(task1));
+  EXPECT_CALL(*task1, Run()).WillOnce(DoAll(
+      SendResponseHeaders(task1),
+      StartServerPush(task1, push_priority, push_path,
+                      mod_spdy::SpdyServerPushInterface::PUSH_STARTED),
+      StartServerPush(task1, push_priority, push_path,
+                      mod_spdy::SpdyServerPushInterface::PUSH_STARTED),
+      SendDataFrame(task1, "foobar", true)));
+  // Only the first push goes through the task factory.
+  EXPECT_CALL(task_factory_, NewStreamTask(
+      Property(&mod_spdy::SpdyStream::stream_id, Eq(2u))))
+      .WillOnce(ReturnMockTask(task2));
+  EXPECT_CALL(*task2, Run()).WillOnce(DoAll(
+      SendCacheableResponseHeaders(task2),
+      SendDataFrame(task2, "hello", false),
+      SendDataFrame(task2, "world", true)));
+  ExpectBeginServerPush(2u, stream_id, push_priority, push_path);
+  ExpectBeginServerPush(4u, stream_id, push_priority, push_path);
+  ExpectSendSynReply(stream_id, false);
+  ExpectSendFrame(IsDataFrame(stream_id, true, "foobar"));
+  net::SpdyNameValueBlock headers;
+  AddCacheableResponseHeaders(spdy_version_, &headers);
+  ExpectSendFrame(IsHeaders(2u, false, headers));
+  ExpectSendFrame(IsDataFrame(2u, false, "hello"));
+  ExpectSendFrame(IsDataFrame(2u, true, "world"));
+  // The second push is sent from the cache, with an Age header added.
+  headers[mod_spdy::http::kAge] = "0";
+  ExpectSendFrame(IsHeaders(4u, false, headers));
+  ExpectSendFrame(IsDataFrame(4u, true, "helloworld"));
+  // And, we're done.
+  EXPECT_CALL(session_io_, IsConnectionAborted());
+  EXPECT_CALL(session_io_, ProcessAvailableInput(Eq(true), NotNull()))
+      .WillOnce(Return(mod_spdy::SpdySessionIO::READ_CONNECTION_CLOSED));
+  ExpectSendGoAway(stream_id, net::GOAWAY_OK);
+
+  session_.Run();
+  EXPECT_TRUE(executor_.stopped());
+  EXPECT_EQ(1u, cache.num_entries());
+}
+
+// Test that when identical GETs are in flight at the same time, only the first
+// goes through the task factory, and the other is sent a copy of its response.
+TEST_P(SpdySessionServerPushTest, CoalesceIdenticalRequests) {
+  mod_spdy::RequestCoalescer coalescer(10000);
+  session_.set_request_coalescer(&coalescer);
+  MockStreamTask* task = new MockStreamTask;
+  executor_.set_run_on_add(false);
+  const net::SpdyPriority priority = 2;
+  ReceiveSynStreamFromClient(1u, priority, net::CONTROL_FLAG_FIN);
+  ReceiveSynStreamFromClient(3u, priority, net::CONTROL_FLAG_FIN);
+  JoinLastInputChunks(2);
+
+  testing::InSequence seq;
+  ExpectSendFrame(IsSettings(net::SETTINGS_MAX_CONCURRENT_STREAMS, 100));
+  EXPECT_CALL(session_io_, IsConnectionAborted());
+  EXPECT_CALL(session_io_, ProcessAvailableInput(Eq(true), NotNull()));
+  EXPECT_CALL(task_factory_, NewStreamTask(
+      Property(&mod_spdy::SpdyStream::stream_id, Eq(1u))))
+      .WillOnce(ReturnMockTask(task));
+  EXPECT_CALL(session_io_, IsConnectionAborted())
+      .WillOnce(DoAll(InvokeWithoutArgs(&executor_, &InlineExecutor::RunAll),
+                      Return(false)));
+  EXPECT_CALL(*task, Run()).WillOnce(DoAll(
+      SendCacheableResponseHeaders(task),
+      SendDataFrame(task, "foo", false),
+      SendDataFrame(task, "bar", true)));
+  EXPECT_CALL(session_io_, ProcessAvailableInput(Eq(false), NotNull()));
+  net::SpdyNameValueBlock headers;
+  AddCacheableResponseHeaders(spdy_version_, &headers);
+  ExpectSendFrame(IsSynReply(1u, false, headers));
+  ExpectSendFrame(IsDataFrame(1u, false, "foo"));
+  ExpectSendFrame(IsDataFrame(1u, true, "bar"));
+  // The duplicate request gets the same response, all at once.
+  ExpectSendFrame(IsSynReply(3u, false, headers));
+  ExpectSendFrame(IsDataFrame(3u, true, "foobar"));
+  // And, we're done.
+  EXPECT_CALL(session_io_, IsConnectionAborted());
+  EXPECT_CALL(session_io_, ProcessAvailableInput(Eq(true), NotNull()))
+      .WillOnce(Return(mod_spdy::SpdySessionIO::READ_CONNECTION_CLOSED));
+  ExpectSendGoAway(3u, net::GOAWAY_OK);
+
+  session_.Run();
+  EXPECT_TRUE(executor_.stopped());
+  EXPECT_EQ(0u, coalescer.num_leaders());
+}
+
+// Test that once a response has been stored in the micro-cache, the same
+// request is answered from the cache without creating a new stream task.
+TEST_P(SpdySessionServerPushTest, MicroCacheHit) {
+  mod_spdy::PushResponseCache cache(100000, 10000);
+  session_.set_micro_cache(&cache);
+  MockStreamTask* task = new MockStreamTask;
+  executor_.set_run_on_add(true);
+  const net::SpdyPriority priority = 2;
+  ReceiveSynStreamFromClient(1u, priority, net::CONTROL_FLAG_FIN);
+  ReceiveSynStreamFromClient(3u, priority, net::CONTROL_FLAG_FIN);
+
+  testing::InSequence seq;
+  ExpectSendFrame(IsSettings(net::SETTINGS_MAX_CONCURRENT_STREAMS, 100));
+  EXPECT_CALL(session_io_, IsConnectionAborted());
+  EXPECT_CALL(session_io_, ProcessAvailableInput(Eq(true), NotNull()));
+  // Only the first request goes through the task factory.
+  EXPECT_CALL(task_factory_, NewStreamTask(
+      Property(&mod_spdy::SpdyStream::stream_id, Eq(1u))))
+      .WillOnce(ReturnMockTask(task));
+  EXPECT_CALL(*task, Run()).WillOnce(DoAll(
+      SendCacheableResponseHeaders(task),
+      SendDataFrame(task, "hello", false),
+      SendDataFrame(task, "world", true)));
+  net::SpdyNameValueBlock headers;
+  AddCacheableResponseHeaders(spdy_version_, &headers);
+  ExpectSendFrame(IsSynReply(1u, false, headers));
+  ExpectSendFrame(IsDataFrame(1u, false, "hello"));
+  ExpectSendFrame(IsDataFrame(1u, true, "world"));
+  // The second request is answered from the cache, with an Age header added.
+  EXPECT_CALL(session_io_, IsConnectionAborted());
+  EXPECT_CALL(session_io_, ProcessAvailableInput(Eq(true), NotNull()));
+  headers[mod_spdy::http::kAge] = "0";
+  ExpectSendFrame(IsSynReply(3u, false, headers));
+  ExpectSendFrame(IsDataFrame(3u, true, "helloworld"));
+  // And, we're done.
+  EXPECT_CALL(session_io_, IsConnectionAborted());
+  EXPECT_CALL(session_io_, ProcessAvailableInput(Eq(true), NotNull()))
+      .WillOnce(Return(mod_spdy::SpdySessionIO::READ_CONNECTION_CLOSED));
+  ExpectSendGoAway(3u, net::GOAWAY_OK);
+
+  session_.Run();
+  EXPECT_TRUE(executor_.stopped());
+  EXPECT_EQ(1u, cache.num_entries());
+}
+
+// Test that the outcomes of server pushes are reported to the outcome tracker,
+// including a cancellation that arrives after the push has been sent in full.
+TEST_P(SpdySessionServerPushTest, ServerPushOutcomes) {
+  mod_spdy::ServerPushOutcomeTracker tracker;
+  session_.set_push_outcome_tracker(&tracker);
+  MockStreamTask* task1 = new MockStreamTask;
+  MockStreamTask* task2 = new MockStreamTask;
+  MockStreamTask* task3 = new MockStreamTask;
+  executor_.set_run_on_add(true);
+  const net::SpdyStreamId stream_id = 3;
+  const net::SpdyPriority priority = 2;
+  const net::SpdyPriority push_priority = 3;
+  ReceiveSynStreamFromClient(stream_id, priority, net::CONTROL_FLAG_FIN);
+  // By the time the client cancels the first push, we've already sent it.
+  ReceiveRstStreamFromClient(2u, net::RST_STREAM_CANCEL);
+
+  testing::InSequence seq;
+  ExpectSendFrame(IsSettings(net::SETTINGS_MAX_CONCURRENT_STREAMS, 100));
+  EXPECT_CALL(session_io_, IsConnectionAborted());
+  EXPECT_CALL(session_io_, ProcessAvailableInput(Eq(true), NotNull()));
+  EXPECT_CALL(task_factory_, NewStreamTask(
+      Property(&mod_spdy::SpdyStream::stream_id, Eq(stream_id))))
+      .WillOnce(ReturnMockTask(task1));
+  EXPECT_CALL(*task1, Run()).WillOnce(DoAll(
+      SendResponseHeaders(task1),
+      StartServerPush(task1, push_priority, "/a.js",
+                      mod_spdy::SpdyServerPushInterface::PUSH_STARTED),
+      StartServerPush(task1, push_priority, "/b.js",
+                      mod_spdy::SpdyServerPushInterface::PUSH_STARTED),
+      SendDataFrame(task1, "foobar", true)));
+  EXPECT_CALL(task_factory_, NewStreamTask(
+      Property(&mod_spdy::SpdyStream::stream_id, Eq(2u))))
+      .WillOnce(ReturnMockTask(task2));
+  EXPECT_CALL(*task2, Run()).WillOnce(DoAll(
+      SendResponseHeaders(task2), SendDataFrame(task2, "hello", true)));
+  EXPECT_CALL(task_factory_, NewStreamTask(
+      Property(&mod_spdy::SpdyStream::stream_id, Eq(4u))))
+      .WillOnce(ReturnMockTask(task3));
+  EXPECT_CALL(*task3, Run()).WillOnce(DoAll(
+      SendResponseHeaders(task3), SendDataFrame(task3, "world!", true)));
+  ExpectBeginServerPush(2u, stream_id, push_priority, "/a.js");
+  ExpectBeginServerPush(4u, stream_id, push_priority, "/b.js");
+  ExpectSendSynReply(stream_id, false);
+  ExpectSendFrame(IsDataFrame(stream_id, true, "foobar"));
+  ExpectSendHeaders(2u, false);
+  ExpectSendFrame(IsDataFrame(2u, true, "hello"));
+  ExpectSendHeaders(4u, false);
+  ExpectSendFrame(IsDataFrame(4u, true, "world!"));
+  // Next, we get the client's RST_STREAM.
+  EXPECT_CALL(session_io_, IsConnectionAborted());
+  EXPECT_CALL(session_io_, ProcessAvailableInput(Eq(true), NotNull()));
+  // And, we're done.
+  EXPECT_CALL(session_io_, IsConnectionAborted());
+  EXPECT_CALL(session_io_, ProcessAvailableInput(Eq(true), NotNull()))
+      .WillOnce(Return(mod_spdy::SpdySessionIO::READ_CONNECTION_CLOSED));
+  ExpectSendGoAway(stream_id, net::GOAWAY_OK);
+
+  session_.Run();
+  EXPECT_TRUE(executor_.stopped());
+
+  const base::TimeTicks now = base::TimeTicks::Now();
+  mod_spdy::ServerPushOutcomeTracker::Stats stats;
+  ASSERT_TRUE(tracker.GetStats("www.example.com", "/foo/index.html", "/a.js",
+                               now, &stats));
+  EXPECT_NEAR(0.0, stats.completed, 0.01);
+  EXPECT_NEAR(1.0, stats.cancelled, 0.01);
+  EXPECT_NEAR(5.0, stats.bytes_wasted, 0.01);
+  ASSERT_TRUE(tracker.GetStats("www.example.com", "/foo/index.html", "/b.js",
+                               now, &stats));
+  EXPECT_NEAR(1.0, stats.completed, 0.01);
+  EXPECT_NEAR(0.0, stats.cancelled, 0.01);
+  EXPECT_NEAR(6.0, stats.bytes_completed, 0.01);
+}
+
+// Test that a push's data is held back until its associated stream has sent
+// its headers and the start of its body, even if the push has the higher
+// priority.
+TEST_P(SpdySessionServerPushTest, PushWaitsForDocument) {
+  MockStreamTask* task1 = new MockStreamTask;
+  MockStreamTask* task2 = new MockStreamTask;
+  executor_.set_run_on_add(true);
+  const net::SpdyStreamId stream_id = 3;
+  const net::SpdyPriority priority = 2;
+  const net::SpdyPriority push_priority = 0;
+  const std::string push_path = "/style.css";
+  ReceiveSynStreamFromClient(stream_id, priority, net::CONTROL_FLAG_FIN);
+
+  testing::InSequence seq;
+  ExpectSendFrame(IsSettings(net::SETTINGS_MAX_CONCURRENT_STREAMS, 100));
+  EXPECT_CALL(session_io_, IsConnectionAborted());
+  EXPECT_CALL(session_io_, ProcessAvailableInput(Eq(true), NotNull()));
+  EXPECT_CALL(task_factory_, NewStreamTask(
+      Property(&mod_spdy::SpdyStream::stream_id, Eq(stream_id))))
+      .WillOnce(ReturnMockTask(task1));
+  EXPECT_CALL(*task1, Run()).WillOnce(DoAll(
+      StartServerPush(task1, push_priority, push_path,
+                      mod_spdy::SpdyServerPushInterface::PUSH_STARTED),
+      SendResponseHeaders(task1),
+      SendDataFrame(task1, "foobar", false),
+      SendDataFrame(task1, "quux", true)));
+  EXPECT_CALL(task_factory_, NewStreamTask(
+      Property(&mod_spdy::SpdyStream::stream_id, Eq(2u))))
+      .WillOnce(ReturnMockTask(task2));
+  EXPECT_CALL(*task2, Run()).WillOnce(DoAll(
+      SendResponseHeaders(task2),
+      SendDataFrame(task2, "hello", false),
+      SendDataFrame(task2, "world", true)));
+  // The push's headers can go right away, but its data must wait for the
+  // first of the document's data.
+  ExpectBeginServerPush(2u, stream_id, push_priority, push_path);
+  ExpectSendHeaders(2u, false);
+  ExpectSendSynReply(stream_id, false);
+  ExpectSendFrame(IsDataFrame(stream_id, false, "foobar"));
+  ExpectSendFrame(IsDataFrame(2u, false, "hello"));
+  ExpectSendFrame(IsDataFrame(2u, true, "world"));
+  ExpectSendFrame(IsDataFrame(stream_id, true, "quux"));
+  // And, we're done.
+  EXPECT_CALL(session_io_, IsConnectionAborted());
+  EXPECT_CALL(session_io_, ProcessAvailableInput(Eq(true), NotNull()))
+      .WillOnce(Return(mod_spdy::SpdySessionIO::READ_CONNECTION_CLOSED));
+  ExpectSendGoAway(stream_id, net::GOAWAY_OK);
+
+  session_.Run();
+  EXPECT_TRUE(executor_.stopped());
+  EXPECT_EQ(10u, session_.document_data_bytes_sent());
+  EXPECT_EQ(10u, session_.push_data_bytes_sent());
+}
+
 // Only run server push tests for SPDY v3 and up.
 INSTANTIATE_TEST_CASE_P(Spdy3, SpdySessionServerPushTest, testing::Values(
     mod_spdy::spdy::SPDY_VERSION_3, mod_spdy::spdy::SPDY_VERSION_3_1));
@@ -17,21 +17,31 @@
 
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
-#include "base/synchronization/condition_variable.h"
-#include "base/synchronization/lock.h"
 #include "mod_spdy/common/protocol_util.h"
+#include "mod_spdy/common/push_response_cache.h"
+#include "mod_spdy/common/receive_window_tuner.h"
+#include "mod_spdy/common/request_coalescer.h"
+#include "mod_spdy/common/scoreboard.h"
 #include "mod_spdy/common/shared_flow_control_window.h"
 #include "mod_spdy/common/spdy_frame_priority_queue.h"
 #include "mod_spdy/common/spdy_frame_queue.h"
+#include "mod_spdy/common/trace_log.h"
+#include "mod_spdy/common/window_update_aggregator.h"
 #include "net/spdy/spdy_protocol.h"
 
 namespace {
 
-// The smallest WINDOW_UPDATE delta we're willing to send.  If the client sends
-// us less than this much data, we wait for more data before sending a
-// WINDOW_UPDATE frame (so that we don't end up sending lots of little ones).
-const size_t kMinWindowUpdateSize =
-    static_cast<size_t>(net::kSpdyStreamInitialWindowSize) / 8;
+// The smallest WINDOW_UPDATE delta we're willing to send, as a fraction of the
+// input window size.  If the client sends us less than this much data, we wait
+// for more data before sending a WINDOW_UPDATE frame (so that we don't end up
+// sending lots of little ones).
+const int32 kMinWindowUpdateDivisor = 8;
+
+// If the client has less than 1/kUrgentWindowUpdateDivisor of the input
+// window left when we decide to send a WINDOW_UPDATE, it may soon have to stop
+// sending until the update arrives, so we don't hold the update back to be
+// merged with others.
+const int32 kUrgentWindowUpdateDivisor = 4;
 
 class DataLengthVisitor : public net::SpdyFrameVisitor {
  public:
@@ -90,13 +100,17 @@ SpdyStream::SpdyStream(spdy::SpdyVersion spdy_version,
       output_queue_(output_queue),
       shared_window_(shared_window),
       pusher_(pusher),
+      scoreboard_session_(Scoreboard::kNoSession),
+      window_update_aggregator_(NULL),
+      lock_("SpdyStream::lock_"),
       condvar_(&lock_),
       aborted_(false),
       output_window_size_(initial_output_window_size),
       // TODO(mdsteele): Make our initial input window size configurable (we
       //   would send the chosen value to the client with a SETTINGS frame).
       input_window_size_(net::kSpdyStreamInitialWindowSize),
-      input_bytes_consumed_(0) {
+      input_bytes_consumed_(0),
+      output_data_bytes_(0) {
   DCHECK_NE(spdy::SPDY_VERSION_NONE, spdy_version);
   DCHECK(output_queue_);
   DCHECK(shared_window_ || spdy_version < spdy::SPDY_VERSION_3_1);
@@ -116,32 +130,37 @@ bool SpdyStream::is_server_push() const {
 }
 
 bool SpdyStream::is_aborted() const {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   return aborted_;
 }
 
 void SpdyStream::AbortSilently() {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   InternalAbortSilently();
 }
 
 void SpdyStream::AbortWithRstStream(net::SpdyRstStreamStatus status) {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   InternalAbortWithRstStream(status);
 }
 
 int32 SpdyStream::current_input_window_size() const {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   DCHECK_GE(spdy_version(), spdy::SPDY_VERSION_3);
   return input_window_size_;
 }
 
 int32 SpdyStream::current_output_window_size() const {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   DCHECK_GE(spdy_version(), spdy::SPDY_VERSION_3);
   return output_window_size_;
 }
 
+uint64 SpdyStream::output_data_bytes() const {
+  ProfiledAutoLock autolock(lock_);
+  return output_data_bytes_;
+}
+
 void SpdyStream::OnInputDataConsumed(size_t size) {
   // Sanity check: there is no input data to absorb for a server push stream,
   // so we should only be getting called for client-initiated streams.
@@ -158,7 +177,7 @@ void SpdyStream::OnInputDataConsumed(size_t size) {
     return;
   }
 
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
 
   // Don't bother with any of this if the stream has been aborted.
   if (aborted_) {
@@ -173,19 +192,23 @@ void SpdyStream::OnInputDataConsumed(size_t size) {
     const int32 shared_window_update =
         shared_window_->OnInputDataConsumed(size);
     if (shared_window_update > 0) {
-      output_queue_->Insert(
-          SpdyFramePriorityQueue::kTopPriority,
-          new net::SpdyWindowUpdateIR(0, shared_window_update));
+      // The shared window has already been grown by the update, so subtract
+      // it back out to see how much the client had left.
+      SendWindowUpdate(0, shared_window_update,
+                       shared_window_->current_input_window_size() -
+                       shared_window_update <
+                       shared_window_->current_input_window_target() /
+                       kUrgentWindowUpdateDivisor);
     }
   }
 
   // Make sure the current input window size is sane.  Although there are
   // provisions in the SPDY spec that allow the window size to be temporarily
-  // negative, or to go above its default initial size, with our current
-  // implementation that should never happen.  Once we make the initial input
-  // window size configurable, we may need to adjust or remove these checks.
+  // negative, with our current implementation that should never happen, and
+  // the window should never be bigger than we meant it to be.
+  const int32 window_target = InputWindowTarget();
   DCHECK_GE(input_window_size_, 0);
-  DCHECK_LE(input_window_size_, net::kSpdyStreamInitialWindowSize);
+  DCHECK_LE(input_window_size_, window_target);
 
   // Add the newly consumed data to the total.  Assuming our caller is behaving
   // well (even if the client isn't) -- that is, they are only consuming as
@@ -197,8 +220,7 @@ void SpdyStream::OnInputDataConsumed(size_t size) {
   input_bytes_consumed_ += size;
   DCHECK_GE(input_bytes_consumed_, size);
   DCHECK_LE(input_bytes_consumed_,
-            static_cast<size_t>(net::kSpdyStreamInitialWindowSize -
-                                input_window_size_));
+            static_cast<size_t>(window_target - input_window_size_));
 
   // We don't want to send lots of little WINDOW_UPDATE frames (as that would
   // waste bandwidth), so only bother sending one once it would have a
@@ -206,7 +228,8 @@ void SpdyStream::OnInputDataConsumed(size_t size) {
   // TODO(mdsteele): Consider also tracking whether we have received a FLAG_FIN
   //   on this stream; once we've gotten FLAG_FIN, there will be no more data,
   //   so we don't need to send any more WINDOW_UPDATE frames.
-  if (input_bytes_consumed_ < kMinWindowUpdateSize) {
+  if (input_bytes_consumed_ <
+      static_cast<size_t>(window_target / kMinWindowUpdateDivisor)) {
     return;
   }
 
@@ -221,16 +244,24 @@ void SpdyStream::OnInputDataConsumed(size_t size) {
   DCHECK_LE(input_bytes_consumed_,
             static_cast<size_t>(net::kSpdyMaximumWindowSize));
 
-  // Send a WINDOW_UPDATE frame to the client and update our window size.
-  SendOutputFrame(new net::SpdyWindowUpdateIR(
-      stream_id_, input_bytes_consumed_));
-  input_window_size_ += input_bytes_consumed_;
-  DCHECK_LE(input_window_size_, net::kSpdyStreamInitialWindowSize);
+  // Send a WINDOW_UPDATE frame to the client and update our window size.  If
+  // we're tuning the window, the update may be bigger or smaller than what
+  // we've consumed, so as to grow or shrink the window.
+  const int32 consumed = static_cast<int32>(input_bytes_consumed_);
+  const int32 update = (input_window_tuner_ == NULL ? consumed :
+                        input_window_tuner_->ComputeWindowUpdate(
+                            consumed, shared_window_->round_trip_time(),
+                            base::TimeTicks::Now()));
+  SendWindowUpdate(stream_id_, update,
+                   input_window_size_ <
+                   window_target / kUrgentWindowUpdateDivisor);
+  input_window_size_ += update;
+  DCHECK_LE(input_window_size_, InputWindowTarget());
   input_bytes_consumed_ = 0;
 }
 
 void SpdyStream::AdjustOutputWindowSize(int32 delta) {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
 
   // Flow control only exists for SPDY v3 and up.
   DCHECK_GE(spdy_version(), spdy::SPDY_VERSION_3);
@@ -263,7 +294,7 @@ void SpdyStream::AdjustOutputWindowSize(int32 delta) {
 }
 
 void SpdyStream::PostInputFrame(net::SpdyFrameIR* frame_ptr) {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
 
   // Take ownership of the frame, so it will get deleted if we return early.
   scoped_ptr<net::SpdyFrameIR> frame(frame_ptr);
@@ -307,7 +338,7 @@ bool SpdyStream::GetInputFrame(bool block, net::SpdyFrameIR** frame) {
 void SpdyStream::SendOutputSynStream(const net::SpdyHeaderBlock& headers,
                                      bool flag_fin) {
   DCHECK(is_server_push());
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   if (aborted_) {
     return;
   }
@@ -324,7 +355,14 @@ void SpdyStream::SendOutputSynStream(const net::SpdyHeaderBlock& headers,
 void SpdyStream::SendOutputSynReply(const net::SpdyHeaderBlock& headers,
                                     bool flag_fin) {
   DCHECK(!is_server_push());
-  base::AutoLock autolock(lock_);
+  if (response_recorder_.get() != NULL) {
+    response_recorder_->OnHeaders(headers, flag_fin);
+  }
+  if (coalescing_recorder_.get() != NULL) {
+    coalescing_recorder_->OnHeaders(headers, flag_fin);
+  }
+
+  ProfiledAutoLock autolock(lock_);
   if (aborted_) {
     return;
   }
@@ -337,7 +375,14 @@ void SpdyStream::SendOutputSynReply(const net::SpdyHeaderBlock& headers,
 
 void SpdyStream::SendOutputHeaders(const net::SpdyHeaderBlock& headers,
                                    bool flag_fin) {
-  base::AutoLock autolock(lock_);
+  if (response_recorder_.get() != NULL) {
+    response_recorder_->OnHeaders(headers, flag_fin);
+  }
+  if (coalescing_recorder_.get() != NULL) {
+    coalescing_recorder_->OnHeaders(headers, flag_fin);
+  }
+
+  ProfiledAutoLock autolock(lock_);
   if (aborted_) {
     return;
   }
@@ -349,7 +394,16 @@ void SpdyStream::SendOutputHeaders(const net::SpdyHeaderBlock& headers,
 }
 
 void SpdyStream::SendOutputDataFrame(base::StringPiece data, bool flag_fin) {
-  base::AutoLock autolock(lock_);
+  MOD_SPDY_TRACE_EVENT1("stream", "SendOutputDataFrame", "stream_id",
+                        stream_id_);
+  if (response_recorder_.get() != NULL) {
+    response_recorder_->OnData(data, flag_fin);
+  }
+  if (coalescing_recorder_.get() != NULL) {
+    coalescing_recorder_->OnData(data, flag_fin);
+  }
+
+  ProfiledAutoLock autolock(lock_);
   if (aborted_) {
     return;
   }
@@ -363,6 +417,7 @@ void SpdyStream::SendOutputDataFrame(base::StringPiece data, bool flag_fin) {
       scoped_ptr<net::SpdyDataIR> frame(new net::SpdyDataIR(stream_id_, data));
       frame->set_fin(flag_fin);
       SendOutputFrame(frame.release());
+      output_data_bytes_ += data.size();
     }
     return;
   }
@@ -372,8 +427,14 @@ void SpdyStream::SendOutputDataFrame(base::StringPiece data, bool flag_fin) {
     // until the client increases it (or we abort).  Note that the window size
     // can be negative if the client decreased the maximum window size (with a
     // SETTINGS frame) after we already sent data (SPDY draft 3 section 2.6.8).
-    while (!aborted_ && output_window_size_ <= 0) {
-      condvar_.Wait();
+    if (output_window_size_ <= 0) {
+      MOD_SPDY_TRACE_EVENT1("stream", "WaitForStreamWindow", "stream_id",
+                            stream_id_);
+      Scoreboard::AddIfEnabled(scoreboard_session_,
+                               Scoreboard::STREAM_WINDOW_STALLS, 1);
+      while (!aborted_ && output_window_size_ <= 0) {
+        condvar_.Wait();
+      }
     }
     if (aborted_) {
       return;
@@ -393,8 +454,10 @@ void SpdyStream::SendOutputDataFrame(base::StringPiece data, bool flag_fin) {
     // first.
     int32 length_acquired;
     if (spdy_version() >= spdy::SPDY_VERSION_3_1) {
-      base::AutoUnlock autounlock(lock_);
+      ProfiledAutoUnlock autounlock(lock_);
       DCHECK(shared_window_);
+      MOD_SPDY_TRACE_EVENT1("stream", "RequestSessionWindow", "bytes",
+                            length_desired);
       length_acquired = shared_window_->RequestOutputQuota(length_desired);
     } else {
       // For SPDY versions that don't have a session window, just act like we
@@ -418,6 +481,7 @@ void SpdyStream::SendOutputDataFrame(base::StringPiece data, bool flag_fin) {
         new net::SpdyDataIR(stream_id_, data.substr(0, length_acquired)));
     frame->set_fin(flag_fin && length_acquired == full_length);
     SendOutputFrame(frame.release());
+    output_data_bytes_ += length_acquired;
     data = data.substr(length_acquired);
   }
 }
@@ -430,12 +494,50 @@ SpdyServerPushInterface::PushStatus SpdyStream::StartServerPush(
                                   request_headers);
 }
 
+void SpdyStream::set_response_recorder(
+    PushResponseCache::Recorder* recorder) {
+  response_recorder_.reset(recorder);
+}
+
+void SpdyStream::set_coalescing_recorder(RequestCoalescer::Recorder* recorder) {
+  coalescing_recorder_.reset(recorder);
+}
+
+void SpdyStream::EnableInputWindowTuning(int32 max_window_size,
+                                         ReceiveWindowBudget* budget) {
+  ProfiledAutoLock autolock(lock_);
+  DCHECK(shared_window_);
+  DCHECK(input_window_tuner_ == NULL);
+  input_window_tuner_.reset(new ReceiveWindowTuner(
+      net::kSpdyStreamInitialWindowSize, max_window_size, budget));
+}
+
 void SpdyStream::SendOutputFrame(net::SpdyFrameIR* frame) {
   lock_.AssertAcquired();
   DCHECK(!aborted_);
   output_queue_->Insert(static_cast<int>(priority_), frame);
 }
 
+void SpdyStream::SendWindowUpdate(net::SpdyStreamId stream_id, int32 delta,
+                                  bool urgent) {
+  lock_.AssertAcquired();
+  DCHECK(stream_id == 0u || stream_id == stream_id_);
+  if (window_update_aggregator_ != NULL) {
+    window_update_aggregator_->AddUpdate(stream_id, delta, urgent);
+  } else if (stream_id == 0u) {
+    output_queue_->Insert(SpdyFramePriorityQueue::kTopPriority,
+                          new net::SpdyWindowUpdateIR(0, delta));
+  } else {
+    SendOutputFrame(new net::SpdyWindowUpdateIR(stream_id, delta));
+  }
+}
+
+int32 SpdyStream::InputWindowTarget() const {
+  lock_.AssertAcquired();
+  return (input_window_tuner_ == NULL ? net::kSpdyStreamInitialWindowSize :
+          input_window_tuner_->window_size());
+}
+
 void SpdyStream::InternalAbortSilently() {
   lock_.AssertAcquired();
   input_queue_.Abort();
@@ -16,18 +16,23 @@
 #define MOD_SPDY_COMMON_SPDY_STREAM_H_
 
 #include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/strings/string_piece.h"
-#include "base/synchronization/condition_variable.h"
-#include "base/synchronization/lock.h"
 #include "net/spdy/spdy_protocol.h"
+#include "mod_spdy/common/profiled_lock.h"
 #include "mod_spdy/common/protocol_util.h"
+#include "mod_spdy/common/push_response_cache.h"
+#include "mod_spdy/common/request_coalescer.h"
 #include "mod_spdy/common/spdy_frame_queue.h"
 #include "mod_spdy/common/spdy_server_push_interface.h"
 
 namespace mod_spdy {
 
+class ReceiveWindowBudget;
+class ReceiveWindowTuner;
 class SharedFlowControlWindow;
 class SpdyFramePriorityQueue;
+class WindowUpdateAggregator;
 
 // Represents one stream of a SPDY connection.  This class is used to
 // coordinate and pass SPDY frames between the SPDY-to-HTTP filter, the
@@ -89,6 +94,10 @@ class SpdyStream {
   int32 current_input_window_size() const;
   int32 current_output_window_size() const;
 
+  // How many bytes of DATA frame payload has this stream queued for sending
+  // to the client so far?
+  uint64 output_data_bytes() const;
+
   // This should be called by the stream thread for each chunk of input data
   // that it consumes.  The SpdyStream object will take care of sending
   // WINDOW_UPDATE frames as appropriate (automatically bunching up smaller,
@@ -143,6 +152,41 @@ class SpdyStream {
       net::SpdyPriority priority,
       const net::SpdyHeaderBlock& request_headers);
 
+  // Attach a recorder that will be given the response headers and data sent
+  // on this stream, so that a cacheable response can be stored in a
+  // PushResponseCache (the push cache or the micro-cache) once it is
+  // complete.  This takes ownership of the recorder, and must be called
+  // before the stream thread starts running.
+  void set_response_recorder(PushResponseCache::Recorder* recorder);
+
+  // Attach a recorder that will be given the response headers and data sent
+  // on this stream, so that identical requests coalesced with this one can be
+  // sent the same response.  This takes ownership of the recorder, and must
+  // be called before the stream thread starts running.
+  void set_coalescing_recorder(RequestCoalescer::Recorder* recorder);
+
+  // Set the Scoreboard session slot to which this stream's counts should be
+  // added.  This must be called before the stream thread starts running.
+  void set_scoreboard_session(int session) { scoreboard_session_ = session; }
+
+  // Send this stream's WINDOW_UPDATE frames (and those for the shared
+  // window) through the given aggregator, so that they can be merged with
+  // others before being sent, rather than straight to the output queue.  This
+  // does not take ownership of the aggregator, and must be called before the
+  // stream thread starts running.
+  void set_window_update_aggregator(WindowUpdateAggregator* aggregator) {
+    window_update_aggregator_ = aggregator;
+  }
+
+  // Allow this stream's input window to grow beyond its initial size, up to
+  // max_window_size, when the client uploads faster than the initial window
+  // allows (see ReceiveWindowTuner).  Growth is reserved from the given
+  // budget, which must outlive this stream; the round trip time comes from
+  // the shared window.  This must be called before the stream thread starts
+  // running.
+  void EnableInputWindowTuning(int32 max_window_size,
+                               ReceiveWindowBudget* budget);
+
  private:
   // Send a SPDY frame to the client.  This is to be called from the stream
   // thread.  This method takes ownership of the frame object.  Must be holding
@@ -157,6 +201,17 @@ class SpdyStream {
   // stream.  Must be holding lock_ to call this method.
   void InternalAbortWithRstStream(net::SpdyRstStreamStatus status);
 
+  // Send (or pass to the aggregator, if any) a WINDOW_UPDATE for the given
+  // stream, which is either this one or stream 0 (for the shared window).
+  // If urgent, the client's window is nearly used up, so the update should
+  // not be held back.  Must be holding lock_ to call this method.
+  void SendWindowUpdate(net::SpdyStreamId stream_id, int32 delta, bool urgent);
+
+  // Return the size the input window should have once the client has been
+  // told about all the data we've consumed.  Must be holding lock_ to call
+  // this method.
+  int32 InputWindowTarget() const;
+
   // These fields are all either constant or thread-safe, and do not require
   // additional synchronization.
   const spdy::SpdyVersion spdy_version_;
@@ -169,15 +224,24 @@ class SpdyStream {
   SharedFlowControlWindow* const shared_window_;
   SpdyServerPushInterface* const pusher_;
 
+  // These fields are only ever used by the stream thread (once they are set),
+  // so they do not require synchronization.
+  scoped_ptr<PushResponseCache::Recorder> response_recorder_;
+  scoped_ptr<RequestCoalescer::Recorder> coalescing_recorder_;
+  int scoreboard_session_;
+  WindowUpdateAggregator* window_update_aggregator_;  // may be NULL
+
   // The lock protects the fields below.  The above fields do not require
   // additional synchronization.
-  mutable base::Lock lock_;
-  base::ConditionVariable condvar_;
+  mutable ProfiledLock lock_;
+  ProfiledConditionVariable condvar_;
   bool aborted_;
   int32 output_window_size_;
   int32 input_window_size_;
   size_t input_bytes_consumed_;  // consumed since we last sent a WINDOW_UPDATE
   size_t input_bytes_unconsumed_;  // received but not yet consumed
+  scoped_ptr<ReceiveWindowTuner> input_window_tuner_;  // NULL if not tuning
+  uint64 output_data_bytes_;  // DATA payload bytes queued for the client
 
   DISALLOW_COPY_AND_ASSIGN(SpdyStream);
 };
@@ -26,6 +26,7 @@
 #include "mod_spdy/common/testing/async_task_runner.h"
 #include "mod_spdy/common/testing/notification.h"
 #include "mod_spdy/common/testing/spdy_frame_matchers.h"
+#include "mod_spdy/common/window_update_aggregator.h"
 #include "net/spdy/spdy_protocol.h"
 #include "testing/gmock/include/gmock/gmock.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -548,6 +549,49 @@ TEST(SpdyStreamTest, InputFlowControlInSpdy31) {
   EXPECT_EQ(65446, stream.current_input_window_size());
 }
 
+// Test that with a WindowUpdateAggregator, WINDOW_UPDATE frames are held back
+// until the aggregator is flushed, unless the client's window is running low.
+TEST(SpdyStreamTest, InputFlowControlWithAggregator) {
+  mod_spdy::SpdyFramePriorityQueue output_queue;
+  mod_spdy::SharedFlowControlWindow shared_window(
+      net::kSpdyStreamInitialWindowSize,
+      net::kSpdyStreamInitialWindowSize);
+  mod_spdy::WindowUpdateAggregator aggregator(&output_queue);
+  MockSpdyServerPushInterface pusher;
+  mod_spdy::SpdyStream stream(
+      mod_spdy::spdy::SPDY_VERSION_3_1, kStreamId, kAssocStreamId,
+      kInitServerPushDepth, kPriority, net::kSpdyStreamInitialWindowSize,
+      &output_queue, &shared_window, &pusher);
+  stream.set_window_update_aggregator(&aggregator);
+
+  // Receive and consume enough data to be worth a WINDOW_UPDATE.  The client
+  // still has plenty of window left, so the updates wait in the aggregator.
+  const std::string data1(9000, 'x');
+  EXPECT_TRUE(shared_window.OnReceiveInputData(data1.size()));
+  stream.PostInputFrame(new net::SpdyDataIR(kStreamId, data1));
+  stream.OnInputDataConsumed(9000);
+  EXPECT_TRUE(output_queue.IsEmpty());
+  EXPECT_TRUE(aggregator.HasPendingUpdates());
+  EXPECT_EQ(65536, stream.current_input_window_size());
+
+  EXPECT_EQ(2u, aggregator.Flush());
+  ExpectSessionWindowUpdate(&output_queue, 9000);
+  ExpectWindowUpdate(&output_queue, 9000);
+  EXPECT_TRUE(output_queue.IsEmpty());
+
+  // Now let the client use up most of its window before we consume anything.
+  // The updates should then go out right away.
+  const std::string data2(50000, 'x');
+  EXPECT_TRUE(shared_window.OnReceiveInputData(data2.size()));
+  stream.PostInputFrame(new net::SpdyDataIR(kStreamId, data2));
+  EXPECT_EQ(15536, stream.current_input_window_size());
+  stream.OnInputDataConsumed(50000);
+  EXPECT_FALSE(aggregator.HasPendingUpdates());
+  ExpectSessionWindowUpdate(&output_queue, 50000);
+  ExpectWindowUpdate(&output_queue, 50000);
+  EXPECT_TRUE(output_queue.IsEmpty());
+}
+
 TEST(SpdyStreamTest, InputFlowControlError) {
   mod_spdy::SpdyFramePriorityQueue output_queue;
   MockSpdyServerPushInterface pusher;
@@ -19,6 +19,7 @@
 #include "base/strings/string_piece.h"
 #include "mod_spdy/common/http_request_visitor_interface.h"
 #include "mod_spdy/common/protocol_util.h"
+#include "mod_spdy/common/spdy_version_traits.h"
 #include "net/spdy/spdy_frame_builder.h"
 #include "net/spdy/spdy_framer.h"
 #include "net/spdy/spdy_protocol.h"
@@ -30,20 +31,17 @@ namespace {
 // Generate an HTTP request line from the given SPDY header block by calling
 // the OnStatusLine() method of the given visitor, and return true.  If there's
 // an error, this will return false without calling any methods on the visitor.
-bool GenerateRequestLine(spdy::SpdyVersion spdy_version,
-                         const net::SpdyHeaderBlock& block,
+template <class Traits>
+bool GenerateRequestLine(const net::SpdyHeaderBlock& block,
                          HttpRequestVisitorInterface* visitor) {
-  const bool spdy2 = spdy_version < spdy::SPDY_VERSION_3;
-  net::SpdyHeaderBlock::const_iterator method = block.find(
-      spdy2 ? spdy::kSpdy2Method : spdy::kSpdy3Method);
-  net::SpdyHeaderBlock::const_iterator scheme = block.find(
-      spdy2 ? spdy::kSpdy2Scheme : spdy::kSpdy3Scheme);
-  net::SpdyHeaderBlock::const_iterator host = block.find(
-      spdy2 ? http::kHost : spdy::kSpdy3Host);
-  net::SpdyHeaderBlock::const_iterator path = block.find(
-      spdy2 ? spdy::kSpdy2Url : spdy::kSpdy3Path);
-  net::SpdyHeaderBlock::const_iterator version = block.find(
-      spdy2 ? spdy::kSpdy2Version : spdy::kSpdy3Version);
+  net::SpdyHeaderBlock::const_iterator method =
+      block.find(Traits::MethodHeader());
+  net::SpdyHeaderBlock::const_iterator scheme =
+      block.find(Traits::SchemeHeader());
+  net::SpdyHeaderBlock::const_iterator host = block.find(Traits::HostHeader());
+  net::SpdyHeaderBlock::const_iterator path = block.find(Traits::PathHeader());
+  net::SpdyHeaderBlock::const_iterator version =
+      block.find(Traits::VersionHeader());
 
   if (method == block.end() ||
       scheme == block.end() ||
@@ -91,6 +89,17 @@ SpdyToHttpConverter::SpdyToHttpConverter(spdy::SpdyVersion spdy_version,
       seen_accept_encoding_(false) {
   DCHECK_NE(spdy::SPDY_VERSION_NONE, spdy_version);
   CHECK(visitor);
+  // Pick the versions of the per-header code for our SPDY version now, so
+  // that we needn't check the version again for each header.
+  if (spdy_version < spdy::SPDY_VERSION_3) {
+    generate_request_line_ = &GenerateRequestLine<Spdy2Traits>;
+    generate_leading_headers_ =
+        &SpdyToHttpConverter::GenerateLeadingHeadersFor<Spdy2Traits>;
+  } else {
+    generate_request_line_ = &GenerateRequestLine<Spdy3Traits>;
+    generate_leading_headers_ =
+        &SpdyToHttpConverter::GenerateLeadingHeadersFor<Spdy3Traits>;
+  }
 }
 
 SpdyToHttpConverter::~SpdyToHttpConverter() {}
@@ -119,12 +128,12 @@ SpdyToHttpConverter::Status SpdyToHttpConverter::ConvertSynStreamFrame(
 
   const net::SpdyHeaderBlock& block = frame.name_value_block();
 
-  if (!GenerateRequestLine(spdy_version(), block, visitor_)) {
+  if (!generate_request_line_(block, visitor_)) {
     return BAD_REQUEST;
   }
 
   // Translate the headers to HTTP.
-  GenerateLeadingHeaders(block);
+  (this->*generate_leading_headers_)(block);
 
   // If this is the last (i.e. only) frame on this stream, finish off the HTTP
   // request.
@@ -158,7 +167,7 @@ SpdyToHttpConverter::Status SpdyToHttpConverter::ConvertHeadersFrame(
     DCHECK(state_ == RECEIVED_SYN_STREAM);
     DCHECK(trailing_headers_.empty());
     // Translate the headers to HTTP.
-    GenerateLeadingHeaders(frame.name_value_block());
+    (this->*generate_leading_headers_)(frame.name_value_block());
   }
 
   // If this is the last frame on this stream, finish off the HTTP request.
@@ -217,7 +226,8 @@ SpdyToHttpConverter::Status SpdyToHttpConverter::ConvertDataFrame(
 
 // Convert the given SPDY header block (e.g. from a SYN_STREAM or HEADERS
 // frame) into HTTP headers by calling OnLeadingHeader on the given visitor.
-void SpdyToHttpConverter::GenerateLeadingHeaders(
+template <class Traits>
+void SpdyToHttpConverter::GenerateLeadingHeadersFor(
     const net::SpdyHeaderBlock& block) {
   for (net::SpdyHeaderBlock::const_iterator it = block.begin();
        it != block.end(); ++it) {
@@ -225,16 +235,8 @@ void SpdyToHttpConverter::GenerateLeadingHeaders(
     const base::StringPiece value = it->second;
 
     // Skip SPDY-specific (i.e. non-HTTP) headers.
-    if (spdy_version() < spdy::SPDY_VERSION_3) {
-      if (key == spdy::kSpdy2Method || key == spdy::kSpdy2Scheme ||
-          key == spdy::kSpdy2Url || key == spdy::kSpdy2Version) {
-        continue;
-      }
-    } else {
-      if (key == spdy::kSpdy3Method || key == spdy::kSpdy3Scheme ||
-          key == spdy::kSpdy3Path || key == spdy::kSpdy3Version) {
-        continue;
-      }
+    if (Traits::IsSpdyOnlyRequestHeader(key)) {
+      continue;
     }
 
     // Skip headers that are ignored by SPDY.
@@ -258,8 +260,9 @@ void SpdyToHttpConverter::GenerateLeadingHeaders(
     }
 
     // For SPDY v3 and later, we need to convert the SPDY ":host" header to an
-    // HTTP "host" header.
-    if (spdy_version() >= spdy::SPDY_VERSION_3 && key == spdy::kSpdy3Host) {
+    // HTTP "host" header.  (For SPDY v2, the host header is already the HTTP
+    // one, so this is a no-op.)
+    if (key == Traits::HostHeader()) {
       key = http::kHost;
     }
 
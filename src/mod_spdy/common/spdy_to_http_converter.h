@@ -54,7 +54,10 @@ class SpdyToHttpConverter {
 
 private:
   // Called to generate leading headers from a SYN_STREAM or HEADERS frame.
-  void GenerateLeadingHeaders(const net::SpdyHeaderBlock& block);
+  // This is instantiated for each SPDY version's traits (see
+  // spdy_version_traits.h), and the constructor picks which one to use.
+  template <class Traits>
+  void GenerateLeadingHeadersFor(const net::SpdyHeaderBlock& block);
   // Called when there are no more leading headers, because we've received
   // either data or a FLAG_FIN.  This adds any last-minute needed headers
   // before closing the leading headers section.
@@ -71,6 +74,10 @@ private:
   };
 
   const spdy::SpdyVersion spdy_version_;
+  bool (*generate_request_line_)(const net::SpdyHeaderBlock& block,
+                                 HttpRequestVisitorInterface* visitor);
+  void (SpdyToHttpConverter::*generate_leading_headers_)(
+      const net::SpdyHeaderBlock& block);
   HttpRequestVisitorInterface* const visitor_;
   net::SpdyHeaderBlock trailing_headers_;
   State state_;
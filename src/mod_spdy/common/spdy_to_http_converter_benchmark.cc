@@ -0,0 +1,117 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/spdy_to_http_converter.h"
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_piece.h"
+#include "mod_spdy/common/http_request_visitor_interface.h"
+#include "mod_spdy/common/protocol_util.h"
+#include "mod_spdy/common/testing/benchmark.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace {
+
+const net::SpdyStreamId kStreamId = 1;
+const size_t kDataFrameSize = 4096;
+const int kNumDataFrames = 4;
+
+class NullRequestVisitor : public mod_spdy::HttpRequestVisitorInterface {
+ public:
+  NullRequestVisitor() {}
+  virtual ~NullRequestVisitor() {}
+  virtual void OnRequestLine(const base::StringPiece& method,
+                             const base::StringPiece& path,
+                             const base::StringPiece& version) {}
+  virtual void OnLeadingHeader(const base::StringPiece& key,
+                               const base::StringPiece& value) {}
+  virtual void OnLeadingHeadersComplete() {}
+  virtual void OnRawData(const base::StringPiece& data) {}
+  virtual void OnDataChunk(const base::StringPiece& data) {}
+  virtual void OnDataChunksComplete() {}
+  virtual void OnTrailingHeader(const base::StringPiece& key,
+                                const base::StringPiece& value) {}
+  virtual void OnTrailingHeadersComplete() {}
+  virtual void OnComplete() {}
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(NullRequestVisitor);
+};
+
+// A SYN_STREAM like those a browser sends for a page view.
+net::SpdySynStreamIR* NewSynStream(const std::string& method, bool fin) {
+  net::SpdySynStreamIR* frame = new net::SpdySynStreamIR(kStreamId);
+  frame->set_priority(1);
+  frame->set_fin(fin);
+  net::SpdyHeaderBlock* headers = frame->GetMutableNameValueBlock();
+  (*headers)[mod_spdy::spdy::kSpdy3Method] = method;
+  (*headers)[mod_spdy::spdy::kSpdy3Scheme] = "https";
+  (*headers)[mod_spdy::spdy::kSpdy3Host] = "www.example.com";
+  (*headers)[mod_spdy::spdy::kSpdy3Path] = "/products/index.html?page=2";
+  (*headers)[mod_spdy::spdy::kSpdy3Version] = "HTTP/1.1";
+  (*headers)["accept"] =
+      "text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8";
+  (*headers)["accept-encoding"] = "gzip,deflate,sdch";
+  (*headers)["accept-language"] = "en-US,en;q=0.8";
+  (*headers)["cookie"] =
+      "session=8f14e45fceea167a5a36dedd4bea2543; prefs=compact";
+  (*headers)["referer"] = "https://www.example.com/products/index.html";
+  (*headers)["user-agent"] =
+      "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like "
+      "Gecko) Chrome/35.0.1916.153 Safari/537.36";
+  return frame;
+}
+
+MOD_SPDY_BENCHMARK(BM_SpdyToHttpConverter_Get) {
+  state->PauseTiming();
+  NullRequestVisitor visitor;
+  scoped_ptr<net::SpdySynStreamIR> syn_stream(NewSynStream("GET", true));
+  state->ResumeTiming();
+  for (int64 i = 0; i < state->iterations(); ++i) {
+    mod_spdy::SpdyToHttpConverter converter(mod_spdy::spdy::SPDY_VERSION_3_1,
+                                            &visitor);
+    converter.ConvertSynStreamFrame(*syn_stream);
+  }
+  state->SetItemsProcessed(state->iterations());
+}
+
+// A POST whose body arrives in several DATA frames.
+MOD_SPDY_BENCHMARK(BM_SpdyToHttpConverter_Post) {
+  state->PauseTiming();
+  NullRequestVisitor visitor;
+  scoped_ptr<net::SpdySynStreamIR> syn_stream(NewSynStream("POST", false));
+  const std::string payload(kDataFrameSize, 'x');
+  scoped_ptr<net::SpdyDataIR> data(new net::SpdyDataIR(kStreamId, payload));
+  scoped_ptr<net::SpdyDataIR> last_data(
+      new net::SpdyDataIR(kStreamId, payload));
+  last_data->set_fin(true);
+  state->ResumeTiming();
+  for (int64 i = 0; i < state->iterations(); ++i) {
+    mod_spdy::SpdyToHttpConverter converter(mod_spdy::spdy::SPDY_VERSION_3_1,
+                                            &visitor);
+    converter.ConvertSynStreamFrame(*syn_stream);
+    for (int j = 1; j < kNumDataFrames; ++j) {
+      converter.ConvertDataFrame(*data);
+    }
+    converter.ConvertDataFrame(*last_data);
+  }
+  state->SetBytesProcessed(state->iterations() * kNumDataFrames *
+                           kDataFrameSize);
+  state->SetItemsProcessed(state->iterations());
+}
+
+}  // namespace
@@ -0,0 +1,70 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MOD_SPDY_COMMON_SPDY_VERSION_TRAITS_H_
+#define MOD_SPDY_COMMON_SPDY_VERSION_TRAITS_H_
+
+#include "base/strings/string_piece.h"
+
+namespace mod_spdy {
+
+// Compile-time descriptions of each SPDY version.  Code on the per-header
+// paths that would otherwise test the SpdyVersion for every header is written
+// as a template on one of these types instead, and the object that runs it
+// picks the instantiation with a single switch on the SpdyVersion when it is
+// constructed.  The compiler can then drop the branches for the other
+// versions, and since the header names are literals here (rather than the
+// extern constants in protocol_util.h), comparisons against them don't need a
+// strlen() each time.
+//
+// The header names must match those in protocol_util.h; the unit test checks
+// that they do.
+
+struct Spdy2Traits {
+  static const char* MethodHeader() { return "method"; }
+  static const char* SchemeHeader() { return "scheme"; }
+  static const char* HostHeader() { return "host"; }
+  static const char* PathHeader() { return "url"; }
+  static const char* StatusHeader() { return "status"; }
+  static const char* VersionHeader() { return "version"; }
+
+  // Return true if the header is one that only has meaning to SPDY, and has
+  // no counterpart among the HTTP request headers.
+  static bool IsSpdyOnlyRequestHeader(const base::StringPiece& key) {
+    return (key == MethodHeader() || key == SchemeHeader() ||
+            key == PathHeader() || key == VersionHeader());
+  }
+};
+
+// SPDY/3.1 changes only flow control, so it uses these too.
+struct Spdy3Traits {
+  static const char* MethodHeader() { return ":method"; }
+  static const char* SchemeHeader() { return ":scheme"; }
+  static const char* HostHeader() { return ":host"; }
+  static const char* PathHeader() { return ":path"; }
+  static const char* StatusHeader() { return ":status"; }
+  static const char* VersionHeader() { return ":version"; }
+
+  static bool IsSpdyOnlyRequestHeader(const base::StringPiece& key) {
+    // All of the SPDY/3 magic headers start with a colon, which no HTTP
+    // header does, so most headers are rejected by the first comparison.
+    return (!key.empty() && key[0] == ':' &&
+            (key == MethodHeader() || key == SchemeHeader() ||
+             key == PathHeader() || key == VersionHeader()));
+  }
+};
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_SPDY_VERSION_TRAITS_H_
@@ -0,0 +1,61 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/spdy_version_traits.h"
+
+#include "base/strings/string_piece.h"
+#include "mod_spdy/common/protocol_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+using mod_spdy::Spdy2Traits;
+using mod_spdy::Spdy3Traits;
+
+// The traits spell out the header names as literals; make sure they agree
+// with the constants everything else uses.
+TEST(SpdyVersionTraitsTest, HeaderNamesMatchProtocolUtil) {
+  EXPECT_STREQ(mod_spdy::spdy::kSpdy2Method, Spdy2Traits::MethodHeader());
+  EXPECT_STREQ(mod_spdy::spdy::kSpdy2Scheme, Spdy2Traits::SchemeHeader());
+  EXPECT_STREQ(mod_spdy::http::kHost, Spdy2Traits::HostHeader());
+  EXPECT_STREQ(mod_spdy::spdy::kSpdy2Url, Spdy2Traits::PathHeader());
+  EXPECT_STREQ(mod_spdy::spdy::kSpdy2Status, Spdy2Traits::StatusHeader());
+  EXPECT_STREQ(mod_spdy::spdy::kSpdy2Version, Spdy2Traits::VersionHeader());
+
+  EXPECT_STREQ(mod_spdy::spdy::kSpdy3Method, Spdy3Traits::MethodHeader());
+  EXPECT_STREQ(mod_spdy::spdy::kSpdy3Scheme, Spdy3Traits::SchemeHeader());
+  EXPECT_STREQ(mod_spdy::spdy::kSpdy3Host, Spdy3Traits::HostHeader());
+  EXPECT_STREQ(mod_spdy::spdy::kSpdy3Path, Spdy3Traits::PathHeader());
+  EXPECT_STREQ(mod_spdy::spdy::kSpdy3Status, Spdy3Traits::StatusHeader());
+  EXPECT_STREQ(mod_spdy::spdy::kSpdy3Version, Spdy3Traits::VersionHeader());
+}
+
+TEST(SpdyVersionTraitsTest, IsSpdyOnlyRequestHeader) {
+  EXPECT_TRUE(Spdy2Traits::IsSpdyOnlyRequestHeader("method"));
+  EXPECT_TRUE(Spdy2Traits::IsSpdyOnlyRequestHeader("url"));
+  EXPECT_FALSE(Spdy2Traits::IsSpdyOnlyRequestHeader("host"));
+  EXPECT_FALSE(Spdy2Traits::IsSpdyOnlyRequestHeader(":method"));
+  EXPECT_FALSE(Spdy2Traits::IsSpdyOnlyRequestHeader(""));
+
+  EXPECT_TRUE(Spdy3Traits::IsSpdyOnlyRequestHeader(":method"));
+  EXPECT_TRUE(Spdy3Traits::IsSpdyOnlyRequestHeader(":scheme"));
+  EXPECT_TRUE(Spdy3Traits::IsSpdyOnlyRequestHeader(":path"));
+  EXPECT_TRUE(Spdy3Traits::IsSpdyOnlyRequestHeader(":version"));
+  EXPECT_FALSE(Spdy3Traits::IsSpdyOnlyRequestHeader(":host"));
+  EXPECT_FALSE(Spdy3Traits::IsSpdyOnlyRequestHeader("method"));
+  EXPECT_FALSE(Spdy3Traits::IsSpdyOnlyRequestHeader(":methods"));
+  EXPECT_FALSE(Spdy3Traits::IsSpdyOnlyRequestHeader(""));
+}
+
+}  // namespace
@@ -0,0 +1,236 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/testing/benchmark.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/logging.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "mod_spdy/common/testing/tool_util.h"
+
+namespace {
+
+// Never run a benchmark for more iterations than this, even if it's too fast
+// to reach the minimum time (e.g. because it's been optimized away).
+const int64 kMaxIterations = 1000000000;
+
+struct Registration {
+  const char* name;
+  mod_spdy::testing::BenchmarkFunction function;
+};
+
+// Allocated on first use, since the registerers run during static
+// initialization, in no particular order.
+std::vector<Registration>* GetRegistry() {
+  static std::vector<Registration>* registry = new std::vector<Registration>;
+  return registry;
+}
+
+// Registration order depends on link order, so sort by name to keep reports
+// from different builds lined up.
+bool CompareRegistrationsByName(const Registration& a, const Registration& b) {
+  return std::string(a.name) < std::string(b.name);
+}
+
+struct Result {
+  std::string name;
+  int64 iterations;
+  // One entry per repetition, each sorted ascending.
+  std::vector<double> ns_per_iteration;
+  std::vector<double> bytes_per_second;
+  std::vector<double> items_per_second;
+};
+
+void RunOnce(mod_spdy::testing::BenchmarkFunction function,
+             mod_spdy::testing::BenchmarkState* state) {
+  state->StartRun();
+  function(state);
+  state->FinishRun();
+}
+
+// Find a number of iterations that takes at least min_time to run.
+int64 CalibrateIterations(mod_spdy::testing::BenchmarkFunction function,
+                          base::TimeDelta min_time) {
+  int64 iterations = 1;
+  while (true) {
+    mod_spdy::testing::BenchmarkState state(iterations);
+    RunOnce(function, &state);
+    if (state.elapsed() >= min_time || iterations >= kMaxIterations) {
+      return iterations;
+    }
+    // Aim somewhat past the minimum, so that we usually get there on the next
+    // try, but don't grow by more than 10x at once, in case the first few
+    // iterations were unrepresentatively fast.
+    const double elapsed_us =
+        std::max<int64>(1, state.elapsed().InMicroseconds());
+    const int64 target = static_cast<int64>(
+        iterations * 1.4 * min_time.InMicroseconds() / elapsed_us);
+    iterations = std::min(kMaxIterations,
+                          std::max(iterations + 1,
+                                   std::min(target, iterations * 10)));
+  }
+}
+
+double Median(const std::vector<double>& sorted) {
+  DCHECK(!sorted.empty());
+  const size_t middle = sorted.size() / 2;
+  return (sorted.size() % 2 == 1 ? sorted[middle] :
+          (sorted[middle - 1] + sorted[middle]) / 2.0);
+}
+
+Result RunBenchmark(const Registration& registration,
+                    const mod_spdy::testing::BenchmarkOptions& options) {
+  Result result;
+  result.name = registration.name;
+  result.iterations =
+      CalibrateIterations(registration.function, options.min_time);
+  for (int i = 0; i < options.repetitions; ++i) {
+    mod_spdy::testing::BenchmarkState state(result.iterations);
+    RunOnce(registration.function, &state);
+    result.ns_per_iteration.push_back(
+        state.elapsed().InMicroseconds() * 1000.0 / result.iterations);
+    result.bytes_per_second.push_back(
+        mod_spdy::testing::PerSecond(state.bytes_processed(),
+                                     state.elapsed()));
+    result.items_per_second.push_back(
+        mod_spdy::testing::PerSecond(state.items_processed(),
+                                     state.elapsed()));
+  }
+  std::sort(result.ns_per_iteration.begin(), result.ns_per_iteration.end());
+  std::sort(result.bytes_per_second.begin(), result.bytes_per_second.end());
+  std::sort(result.items_per_second.begin(), result.items_per_second.end());
+  return result;
+}
+
+void AppendJson(const std::vector<Result>& results,
+                const mod_spdy::testing::BenchmarkOptions& options,
+                std::string* out) {
+  mod_spdy::testing::AppendJsonReportContext(out);
+  base::StringAppendF(
+      out,
+      "    \"min_time_ms\": %lld,\n"
+      "    \"repetitions\": %d\n"
+      "  },\n  \"benchmarks\": [",
+      static_cast<long long>(options.min_time.InMilliseconds()),
+      options.repetitions);
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& result = results[i];
+    base::StringAppendF(
+        out,
+        "%s\n    {\"name\": \"%s\", \"iterations\": %lld, "
+        "\"ns_per_iteration\": %.2f, \"ns_per_iteration_min\": %.2f, "
+        "\"ns_per_iteration_max\": %.2f, \"bytes_per_second\": %.0f, "
+        "\"items_per_second\": %.0f}",
+        (i == 0 ? "" : ","), result.name.c_str(),
+        static_cast<long long>(result.iterations),
+        Median(result.ns_per_iteration), result.ns_per_iteration.front(),
+        result.ns_per_iteration.back(), Median(result.bytes_per_second),
+        Median(result.items_per_second));
+  }
+  out->append("\n  ]\n}\n");
+}
+
+void AppendTable(const std::vector<Result>& results, std::string* out) {
+  base::StringAppendF(out, "%-48s %12s %14s %12s %14s\n", "Benchmark",
+                      "Iterations", "ns/iteration", "MB/s", "items/s");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& result = results[i];
+    base::StringAppendF(
+        out, "%-48s %12lld %14.1f %12.1f %14.0f\n", result.name.c_str(),
+        static_cast<long long>(result.iterations),
+        Median(result.ns_per_iteration),
+        Median(result.bytes_per_second) / (1024.0 * 1024.0),
+        Median(result.items_per_second));
+  }
+}
+
+}  // namespace
+
+namespace mod_spdy {
+
+namespace testing {
+
+BenchmarkState::BenchmarkState(int64 iterations)
+    : iterations_(iterations),
+      running_(false),
+      bytes_processed_(0),
+      items_processed_(0) {}
+
+BenchmarkState::~BenchmarkState() {}
+
+void BenchmarkState::PauseTiming() {
+  DCHECK(running_);
+  elapsed_ += base::TimeTicks::Now() - start_;
+  running_ = false;
+}
+
+void BenchmarkState::ResumeTiming() {
+  DCHECK(!running_);
+  start_ = base::TimeTicks::Now();
+  running_ = true;
+}
+
+void BenchmarkState::StartRun() {
+  elapsed_ = base::TimeDelta();
+  ResumeTiming();
+}
+
+void BenchmarkState::FinishRun() {
+  PauseTiming();
+}
+
+BenchmarkRegisterer::BenchmarkRegisterer(const char* name,
+                                         BenchmarkFunction function) {
+  Registration registration;
+  registration.name = name;
+  registration.function = function;
+  GetRegistry()->push_back(registration);
+}
+
+BenchmarkOptions::BenchmarkOptions()
+    : min_time(base::TimeDelta::FromMilliseconds(500)),
+      repetitions(5),
+      json(true) {}
+
+std::string RunBenchmarks(const BenchmarkOptions& options) {
+  DCHECK_GT(options.repetitions, 0);
+  std::vector<Registration> registry(*GetRegistry());
+  std::sort(registry.begin(), registry.end(), CompareRegistrationsByName);
+  std::vector<Result> results;
+  for (size_t i = 0; i < registry.size(); ++i) {
+    const std::string name(registry[i].name);
+    if (!options.filter.empty() &&
+        name.find(options.filter) == std::string::npos) {
+      continue;
+    }
+    VLOG(1) << "Running " << name;
+    results.push_back(RunBenchmark(registry[i], options));
+  }
+
+  std::string out;
+  if (options.json) {
+    AppendJson(results, options, &out);
+  } else {
+    AppendTable(results, &out);
+  }
+  return out;
+}
+
+}  // namespace testing
+
+}  // namespace mod_spdy
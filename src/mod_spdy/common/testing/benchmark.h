@@ -0,0 +1,115 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MOD_SPDY_COMMON_TESTING_BENCHMARK_H_
+#define MOD_SPDY_COMMON_TESTING_BENCHMARK_H_
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/time/time.h"
+
+namespace mod_spdy {
+
+namespace testing {
+
+// Passed to a benchmark function, which should perform the operation being
+// measured iterations() times.  The function may exclude its setup from the
+// timing with PauseTiming()/ResumeTiming(), and should report how much work
+// it did with SetBytesProcessed() and/or SetItemsProcessed(), so that
+// throughput can be reported as well as time per iteration.
+class BenchmarkState {
+ public:
+  explicit BenchmarkState(int64 iterations);
+  ~BenchmarkState();
+
+  int64 iterations() const { return iterations_; }
+
+  void PauseTiming();
+  void ResumeTiming();
+
+  void SetBytesProcessed(int64 bytes) { bytes_processed_ = bytes; }
+  void SetItemsProcessed(int64 items) { items_processed_ = items; }
+
+  // These are used by the benchmark runner.
+  void StartRun();
+  void FinishRun();
+  base::TimeDelta elapsed() const { return elapsed_; }
+  int64 bytes_processed() const { return bytes_processed_; }
+  int64 items_processed() const { return items_processed_; }
+
+ private:
+  const int64 iterations_;
+  bool running_;
+  base::TimeTicks start_;
+  base::TimeDelta elapsed_;
+  int64 bytes_processed_;
+  int64 items_processed_;
+
+  DISALLOW_COPY_AND_ASSIGN(BenchmarkState);
+};
+
+typedef void (*BenchmarkFunction)(BenchmarkState* state);
+
+// Adds a benchmark to the global list at static initialization time.  Use
+// the MOD_SPDY_BENCHMARK macro rather than using this class directly.
+class BenchmarkRegisterer {
+ public:
+  BenchmarkRegisterer(const char* name, BenchmarkFunction function);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(BenchmarkRegisterer);
+};
+
+// Define and register a benchmark, e.g.:
+//
+//   MOD_SPDY_BENCHMARK(BM_FrobnicateWidget) {
+//     Widget widget;
+//     for (int64 i = 0; i < state->iterations(); ++i) {
+//       widget.Frobnicate();
+//     }
+//     state->SetItemsProcessed(state->iterations());
+//   }
+#define MOD_SPDY_BENCHMARK(name)                                           \
+  void name(::mod_spdy::testing::BenchmarkState* state);                   \
+  ::mod_spdy::testing::BenchmarkRegisterer name##_registerer(#name, &name); \
+  void name(::mod_spdy::testing::BenchmarkState* state)
+
+struct BenchmarkOptions {
+  BenchmarkOptions();
+
+  // Run only benchmarks whose names contain this string (if non-empty).
+  std::string filter;
+  // Each benchmark is run for enough iterations to take at least this long,
+  // so that timer resolution and warm-up don't dominate the results.
+  base::TimeDelta min_time;
+  // How many times to run each benchmark at that number of iterations; the
+  // median, fastest, and slowest runs are reported.
+  int repetitions;
+  // If true, report the results as JSON; otherwise, as a human-readable
+  // table.
+  bool json;
+};
+
+// Run the registered benchmarks selected by the options, and return the
+// report.  The JSON report is a single object with a "context" object
+// (identifying the build) and a "benchmarks" array, with one object per
+// benchmark; times are in nanoseconds and throughputs are per second.
+std::string RunBenchmarks(const BenchmarkOptions& options);
+
+}  // namespace testing
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_TESTING_BENCHMARK_H_
@@ -0,0 +1,65 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs the benchmarks linked into the binary, and writes the report to
+// stdout.  Usage:
+//
+//   spdy_common_benchmarks [--filter=<substring>] [--min_time_ms=<ms>]
+//                          [--repetitions=<n>] [--format=json|text]
+
+#include <stdio.h>
+
+#include <string>
+
+#include "base/at_exit.h"
+#include "base/time/time.h"
+#include "mod_spdy/common/testing/benchmark.h"
+#include "mod_spdy/common/testing/tool_util.h"
+
+namespace {
+
+using mod_spdy::testing::GetFlagValue;
+using mod_spdy::testing::GetIntFlag;
+
+int Usage(const char* program) {
+  fprintf(stderr, "Usage: %s [--filter=<substring>] [--min_time_ms=<ms>] "
+          "[--repetitions=<n>] [--format=json|text]\n", program);
+  return 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit_manager;
+  mod_spdy::testing::BenchmarkOptions options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    std::string value;
+    int number = 0;
+    if (GetFlagValue(arg, "--filter", &value)) {
+      options.filter = value;
+    } else if (GetIntFlag(arg, "--min_time_ms", 1, &number)) {
+      options.min_time = base::TimeDelta::FromMilliseconds(number);
+    } else if (GetIntFlag(arg, "--repetitions", 1, &options.repetitions)) {
+      continue;
+    } else if (GetFlagValue(arg, "--format", &value) &&
+               (value == "json" || value == "text")) {
+      options.json = (value == "json");
+    } else {
+      return Usage(argv[0]);
+    }
+  }
+  fputs(mod_spdy::testing::RunBenchmarks(options).c_str(), stdout);
+  return 0;
+}
@@ -0,0 +1,566 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/testing/spdy_load_client.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/threading/platform_thread.h"
+#include "mod_spdy/common/protocol_util.h"
+#include "net/spdy/buffered_spdy_framer.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace {
+
+const size_t kReadBufferSize = 16384;
+
+// How long to wait for input before checking whether it's time to stop.
+const int kPollIntervalMillis = 100;
+
+// How long to wait before reconnecting after a connection fails, so that we
+// don't spin if the server is down.
+const int kReconnectDelayMillis = 100;
+
+// Stop opening streams on a connection well before stream IDs run out.
+const net::SpdyStreamId kMaxStreamId = 0x7fff0000;
+
+void AddRequestHeaders(mod_spdy::spdy::SpdyVersion version,
+                       const std::string& host, const std::string& path,
+                       net::SpdyHeaderBlock* headers) {
+  const bool spdy2 = version < mod_spdy::spdy::SPDY_VERSION_3;
+  (*headers)[spdy2 ? mod_spdy::http::kHost :
+             mod_spdy::spdy::kSpdy3Host] = host;
+  (*headers)[spdy2 ? mod_spdy::spdy::kSpdy2Method :
+             mod_spdy::spdy::kSpdy3Method] = "GET";
+  (*headers)[spdy2 ? mod_spdy::spdy::kSpdy2Scheme :
+             mod_spdy::spdy::kSpdy3Scheme] = "http";
+  (*headers)[spdy2 ? mod_spdy::spdy::kSpdy2Url :
+             mod_spdy::spdy::kSpdy3Path] = path;
+  (*headers)[spdy2 ? mod_spdy::spdy::kSpdy2Version :
+             mod_spdy::spdy::kSpdy3Version] = "HTTP/1.1";
+  (*headers)["user-agent"] = "spdy_loadgen";
+}
+
+}  // namespace
+
+namespace mod_spdy {
+
+namespace testing {
+
+LoadClientOptions::LoadClientOptions()
+    : host("127.0.0.1"),
+      port(80),
+      spdy_version(spdy::SPDY_VERSION_3_1),
+      concurrent_streams(8),
+      requests_per_connection(0),
+      initial_window_size(net::kSpdyStreamInitialWindowSize),
+      accept_push(true),
+      drain_timeout(base::TimeDelta::FromSeconds(5)) {}
+
+LoadClientStats::LoadClientStats()
+    : connections_opened(0),
+      connection_errors(0),
+      requests_sent(0),
+      requests_completed(0),
+      requests_failed(0),
+      pushes_received(0),
+      pushes_completed(0),
+      data_bytes_received(0),
+      push_data_bytes_received(0) {}
+
+LoadClientStats::~LoadClientStats() {}
+
+void LoadClientStats::Merge(const LoadClientStats& other) {
+  connections_opened += other.connections_opened;
+  connection_errors += other.connection_errors;
+  requests_sent += other.requests_sent;
+  requests_completed += other.requests_completed;
+  requests_failed += other.requests_failed;
+  pushes_received += other.pushes_received;
+  pushes_completed += other.pushes_completed;
+  data_bytes_received += other.data_bytes_received;
+  push_data_bytes_received += other.push_data_bytes_received;
+  time_to_first_byte.Merge(other.time_to_first_byte);
+  for (std::map<net::SpdyPriority, LatencyHistogram>::const_iterator iter =
+           other.latency_by_priority.begin();
+       iter != other.latency_by_priority.end(); ++iter) {
+    latency_by_priority[iter->first].Merge(iter->second);
+  }
+}
+
+SpdyLoadClient::StreamState::StreamState()
+    : priority(0), pushed(false), got_reply(false), unacked_bytes(0) {}
+
+SpdyLoadClient::SpdyLoadClient(const LoadClientOptions* options,
+                               const std::vector<LoadRequest>* request_mix,
+                               uint32 seed)
+    : options_(options),
+      request_mix_(request_mix),
+      total_weight_(0),
+      // The xorshift state must never be zero.
+      random_state_(seed == 0 ? 1 : seed),
+      socket_(-1),
+      connection_error_(false),
+      going_away_(false),
+      max_concurrent_streams_(0),
+      connection_requests_(0),
+      next_stream_id_(1),
+      num_client_streams_(0),
+      unacked_session_bytes_(0) {
+  DCHECK(!request_mix_->empty());
+  for (size_t i = 0; i < request_mix_->size(); ++i) {
+    DCHECK_GT((*request_mix_)[i].weight, 0);
+    total_weight_ += (*request_mix_)[i].weight;
+  }
+}
+
+SpdyLoadClient::~SpdyLoadClient() {
+  Disconnect();
+}
+
+void SpdyLoadClient::Run(base::TimeTicks end_time) {
+  while (base::TimeTicks::Now() < end_time) {
+    if (!RunConnection(end_time)) {
+      ++stats_.connection_errors;
+      base::PlatformThread::Sleep(
+          base::TimeDelta::FromMilliseconds(kReconnectDelayMillis));
+    }
+  }
+}
+
+bool SpdyLoadClient::RunConnection(base::TimeTicks end_time) {
+  if (!Connect()) {
+    return false;
+  }
+  ++stats_.connections_opened;
+
+  framer_.reset(new net::BufferedSpdyFramer(
+      SpdyVersionToFramerVersion(options_->spdy_version), true));
+  framer_->set_visitor(this);
+  connection_error_ = false;
+  going_away_ = false;
+  max_concurrent_streams_ = options_->concurrent_streams;
+  connection_requests_ = 0;
+  next_stream_id_ = 1;
+  num_client_streams_ = 0;
+  streams_.clear();
+  unacked_session_bytes_ = 0;
+  output_.clear();
+
+  if (options_->spdy_version >= spdy::SPDY_VERSION_3 &&
+      options_->initial_window_size != net::kSpdyStreamInitialWindowSize) {
+    net::SettingsMap settings;
+    settings[net::SETTINGS_INITIAL_WINDOW_SIZE] = std::make_pair(
+        net::SETTINGS_FLAG_NONE,
+        static_cast<uint32>(options_->initial_window_size));
+    QueueFrame(framer_->CreateSettings(settings));
+  }
+
+  bool success = true;
+  base::TimeTicks drain_deadline;
+  while (true) {
+    const base::TimeTicks now = base::TimeTicks::Now();
+    if (now >= end_time) {
+      going_away_ = true;
+    }
+    if (!going_away_) {
+      IssueRequests();
+    }
+    if (!FlushOutput()) {
+      success = false;
+      break;
+    }
+    if (going_away_) {
+      if (streams_.empty()) {
+        break;
+      }
+      if (drain_deadline.is_null()) {
+        drain_deadline = now + options_->drain_timeout;
+      } else if (now >= drain_deadline) {
+        LOG(WARNING) << streams_.size()
+                     << " streams still open after the drain timeout";
+        break;
+      }
+    }
+    if (!ReadInput(base::TimeDelta::FromMilliseconds(kPollIntervalMillis))) {
+      // It's fine for the server to hang up once we have nothing in flight
+      // (e.g. after a GOAWAY).
+      success = going_away_ && streams_.empty();
+      break;
+    }
+    if (connection_error_) {
+      success = false;
+      break;
+    }
+  }
+
+  FailAllStreams();
+  Disconnect();
+  framer_.reset();
+  return success;
+}
+
+bool SpdyLoadClient::Connect() {
+  DCHECK_LT(socket_, 0);
+  struct addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* addresses = NULL;
+  const int error = getaddrinfo(options_->host.c_str(),
+                                base::IntToString(options_->port).c_str(),
+                                &hints, &addresses);
+  if (error != 0) {
+    LOG(ERROR) << "Could not resolve " << options_->host << ": "
+               << gai_strerror(error);
+    return false;
+  }
+  for (struct addrinfo* address = addresses; address != NULL;
+       address = address->ai_next) {
+    const int fd = socket(address->ai_family, address->ai_socktype,
+                          address->ai_protocol);
+    if (fd < 0) {
+      continue;
+    }
+    if (HANDLE_EINTR(connect(fd, address->ai_addr, address->ai_addrlen)) ==
+        0) {
+      socket_ = fd;
+      break;
+    }
+    close(fd);
+  }
+  freeaddrinfo(addresses);
+  if (socket_ < 0) {
+    PLOG(ERROR) << "Could not connect to " << options_->host << ":"
+                << options_->port;
+    return false;
+  }
+  // Requests are small and latency-sensitive; don't let Nagle hold them up.
+  const int one = 1;
+  setsockopt(socket_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return true;
+}
+
+void SpdyLoadClient::Disconnect() {
+  if (socket_ >= 0) {
+    close(socket_);
+    socket_ = -1;
+  }
+}
+
+bool SpdyLoadClient::ReadInput(base::TimeDelta timeout) {
+  struct pollfd poll_fd;
+  poll_fd.fd = socket_;
+  poll_fd.events = POLLIN;
+  poll_fd.revents = 0;
+  const int result = HANDLE_EINTR(
+      poll(&poll_fd, 1, static_cast<int>(timeout.InMilliseconds())));
+  if (result < 0) {
+    PLOG(ERROR) << "poll failed";
+    return false;
+  }
+  if (result == 0) {
+    return true;
+  }
+
+  char buffer[kReadBufferSize];
+  const ssize_t size = HANDLE_EINTR(read(socket_, buffer, sizeof(buffer)));
+  if (size < 0) {
+    PLOG(ERROR) << "read failed";
+    return false;
+  }
+  if (size == 0) {
+    return false;
+  }
+  framer_->ProcessInput(buffer, size);
+  if (framer_->HasError()) {
+    connection_error_ = true;
+  }
+  return true;
+}
+
+bool SpdyLoadClient::FlushOutput() {
+  size_t offset = 0;
+  while (offset < output_.size()) {
+    const ssize_t size = HANDLE_EINTR(send(
+        socket_, output_.data() + offset, output_.size() - offset,
+        MSG_NOSIGNAL));
+    if (size < 0) {
+      PLOG(ERROR) << "send failed";
+      return false;
+    }
+    offset += size;
+  }
+  output_.clear();
+  return true;
+}
+
+void SpdyLoadClient::IssueRequests() {
+  const std::string& host =
+      (options_->host_header.empty() ? options_->host :
+       options_->host_header);
+  while (num_client_streams_ < max_concurrent_streams_) {
+    if ((options_->requests_per_connection > 0 &&
+         connection_requests_ >= options_->requests_per_connection) ||
+        next_stream_id_ >= kMaxStreamId) {
+      going_away_ = true;
+      return;
+    }
+    const LoadRequest& request = ChooseRequest();
+    const net::SpdyPriority priority =
+        std::min(request.priority, framer_->GetLowestPriority());
+    net::SpdyHeaderBlock headers;
+    AddRequestHeaders(options_->spdy_version, host, request.path, &headers);
+    const net::SpdyStreamId stream_id = next_stream_id_;
+    next_stream_id_ += 2;
+    QueueFrame(framer_->CreateSynStream(
+        stream_id, 0, priority, 0, net::CONTROL_FLAG_FIN,
+        true,  // true = use compression
+        &headers));
+    StreamState* stream = &streams_[stream_id];
+    stream->start_time = base::TimeTicks::Now();
+    stream->priority = priority;
+    ++num_client_streams_;
+    ++connection_requests_;
+    ++stats_.requests_sent;
+  }
+}
+
+const LoadRequest& SpdyLoadClient::ChooseRequest() {
+  // A xorshift generator is plenty random enough for picking requests, and
+  // unlike rand() it needs no locking across client threads.
+  random_state_ ^= random_state_ << 13;
+  random_state_ ^= random_state_ >> 17;
+  random_state_ ^= random_state_ << 5;
+  int choice = static_cast<int>(
+      random_state_ % static_cast<uint32>(total_weight_));
+  for (size_t i = 0; i + 1 < request_mix_->size(); ++i) {
+    choice -= (*request_mix_)[i].weight;
+    if (choice < 0) {
+      return (*request_mix_)[i];
+    }
+  }
+  return request_mix_->back();
+}
+
+void SpdyLoadClient::QueueFrame(net::SpdySerializedFrame* frame) {
+  scoped_ptr<net::SpdySerializedFrame> owned_frame(frame);
+  output_.append(owned_frame->data(), owned_frame->size());
+}
+
+void SpdyLoadClient::FinishStream(net::SpdyStreamId stream_id,
+                                  bool success) {
+  StreamMap::iterator iter = streams_.find(stream_id);
+  if (iter == streams_.end()) {
+    return;
+  }
+  const StreamState& stream = iter->second;
+  if (stream.pushed) {
+    if (success) {
+      ++stats_.pushes_completed;
+    }
+  } else {
+    --num_client_streams_;
+    if (success) {
+      ++stats_.requests_completed;
+      stats_.latency_by_priority[stream.priority].Add(
+          base::TimeTicks::Now() - stream.start_time);
+    } else {
+      ++stats_.requests_failed;
+    }
+  }
+  streams_.erase(iter);
+}
+
+void SpdyLoadClient::FailAllStreams() {
+  for (StreamMap::const_iterator iter = streams_.begin();
+       iter != streams_.end(); ++iter) {
+    if (!iter->second.pushed) {
+      ++stats_.requests_failed;
+    }
+  }
+  streams_.clear();
+  num_client_streams_ = 0;
+}
+
+void SpdyLoadClient::OnError(net::SpdyFramer::SpdyError error_code) {
+  LOG(ERROR) << "Session error: "
+             << net::SpdyFramer::ErrorCodeToString(error_code);
+  connection_error_ = true;
+}
+
+void SpdyLoadClient::OnStreamError(net::SpdyStreamId stream_id,
+                                   const std::string& description) {
+  LOG(ERROR) << "Stream " << stream_id << " error: " << description;
+  QueueFrame(framer_->CreateRstStream(stream_id,
+                                      net::RST_STREAM_PROTOCOL_ERROR));
+  FinishStream(stream_id, false);
+}
+
+void SpdyLoadClient::OnSynStream(net::SpdyStreamId stream_id,
+                                 net::SpdyStreamId associated_stream_id,
+                                 net::SpdyPriority priority,
+                                 uint8 credential_slot,
+                                 bool fin,
+                                 bool unidirectional,
+                                 const net::SpdyHeaderBlock& headers) {
+  // The server may only open streams to push resources.
+  ++stats_.pushes_received;
+  if (!options_->accept_push ||
+      streams_.count(associated_stream_id) == 0) {
+    QueueFrame(framer_->CreateRstStream(stream_id, net::RST_STREAM_CANCEL));
+    return;
+  }
+  StreamState* stream = &streams_[stream_id];
+  stream->start_time = base::TimeTicks::Now();
+  stream->priority = priority;
+  stream->pushed = true;
+  stream->got_reply = true;
+  if (fin) {
+    FinishStream(stream_id, true);
+  }
+}
+
+void SpdyLoadClient::OnSynReply(net::SpdyStreamId stream_id,
+                                bool fin,
+                                const net::SpdyHeaderBlock& headers) {
+  StreamMap::iterator iter = streams_.find(stream_id);
+  if (iter == streams_.end()) {
+    return;
+  }
+  StreamState* stream = &iter->second;
+  if (!stream->got_reply) {
+    stream->got_reply = true;
+    stats_.time_to_first_byte.Add(
+        base::TimeTicks::Now() - stream->start_time);
+  }
+  if (fin) {
+    FinishStream(stream_id, true);
+  }
+}
+
+void SpdyLoadClient::OnHeaders(net::SpdyStreamId stream_id,
+                               bool fin,
+                               const net::SpdyHeaderBlock& headers) {
+  if (fin) {
+    FinishStream(stream_id, true);
+  }
+}
+
+void SpdyLoadClient::OnStreamFrameData(net::SpdyStreamId stream_id,
+                                       const char* data, size_t length,
+                                       bool fin) {
+  StreamMap::iterator iter = streams_.find(stream_id);
+  const bool known_stream = (iter != streams_.end());
+  stats_.data_bytes_received += length;
+  if (known_stream && iter->second.pushed) {
+    stats_.push_data_bytes_received += length;
+  }
+
+  // Return the window as a browser would, once half of it has been used.
+  // Data for streams we've already reset still counts against the session
+  // window.
+  if (length > 0 && options_->spdy_version >= spdy::SPDY_VERSION_3) {
+    const int32 delta = static_cast<int32>(length);
+    if (known_stream) {
+      StreamState* stream = &iter->second;
+      stream->unacked_bytes += delta;
+      if (stream->unacked_bytes >= options_->initial_window_size / 2) {
+        QueueFrame(framer_->CreateWindowUpdate(stream_id,
+                                               stream->unacked_bytes));
+        stream->unacked_bytes = 0;
+      }
+    }
+    if (options_->spdy_version >= spdy::SPDY_VERSION_3_1) {
+      unacked_session_bytes_ += delta;
+      if (unacked_session_bytes_ >= net::kSpdyStreamInitialWindowSize / 2) {
+        QueueFrame(framer_->CreateWindowUpdate(0, unacked_session_bytes_));
+        unacked_session_bytes_ = 0;
+      }
+    }
+  }
+
+  if (fin) {
+    FinishStream(stream_id, true);
+  }
+}
+
+void SpdyLoadClient::OnSettings(bool clear_persisted) {}
+
+void SpdyLoadClient::OnSetting(net::SpdySettingsIds id, uint8 flags,
+                               uint32 value) {
+  if (id == net::SETTINGS_MAX_CONCURRENT_STREAMS) {
+    max_concurrent_streams_ = static_cast<int>(std::min<uint32>(
+        value, static_cast<uint32>(options_->concurrent_streams)));
+  }
+}
+
+void SpdyLoadClient::OnPing(uint32 unique_id) {
+  // Echo pings that the server started (those with even IDs); ours would have
+  // odd IDs, but we never send any.
+  if (unique_id % 2 == 0) {
+    QueueFrame(framer_->CreatePingFrame(unique_id));
+  }
+}
+
+void SpdyLoadClient::OnRstStream(net::SpdyStreamId stream_id,
+                                 net::SpdyRstStreamStatus status) {
+  VLOG(1) << "Server reset stream " << stream_id << " with status "
+          << status;
+  FinishStream(stream_id, false);
+}
+
+void SpdyLoadClient::OnGoAway(net::SpdyStreamId last_accepted_stream_id,
+                              net::SpdyGoAwayStatus status) {
+  going_away_ = true;
+  // Streams the server never accepted will never be answered.
+  std::vector<net::SpdyStreamId> unaccepted;
+  for (StreamMap::const_iterator iter =
+           streams_.upper_bound(last_accepted_stream_id);
+       iter != streams_.end(); ++iter) {
+    if (!iter->second.pushed) {
+      unaccepted.push_back(iter->first);
+    }
+  }
+  for (size_t i = 0; i < unaccepted.size(); ++i) {
+    FinishStream(unaccepted[i], false);
+  }
+}
+
+void SpdyLoadClient::OnWindowUpdate(net::SpdyStreamId stream_id,
+                                    uint32 delta_window_size) {
+  // We never send DATA, so we have no use for our send window.
+}
+
+void SpdyLoadClient::OnPushPromise(net::SpdyStreamId stream_id,
+                                   net::SpdyStreamId promised_stream_id) {
+  LOG(ERROR) << "Got a PUSH_PROMISE(" << stream_id << ", "
+             << promised_stream_id << ") frame from the server.";
+  connection_error_ = true;
+}
+
+}  // namespace testing
+
+}  // namespace mod_spdy
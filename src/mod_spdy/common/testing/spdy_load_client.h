@@ -0,0 +1,197 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MOD_SPDY_COMMON_TESTING_SPDY_LOAD_CLIENT_H_
+#define MOD_SPDY_COMMON_TESTING_SPDY_LOAD_CLIENT_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/time/time.h"
+#include "mod_spdy/common/latency_histogram.h"
+#include "mod_spdy/common/protocol_util.h"
+#include "net/spdy/buffered_spdy_framer.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace mod_spdy {
+
+namespace testing {
+
+// One kind of request in a load test's request mix.
+struct LoadRequest {
+  LoadRequest() : priority(0), weight(1) {}
+
+  std::string path;
+  net::SpdyPriority priority;
+  // Requests are chosen at random, in proportion to their weights.
+  int weight;
+};
+
+struct LoadClientOptions {
+  LoadClientOptions();
+
+  std::string host;  // address to connect to
+  int port;
+  std::string host_header;  // defaults to host if empty
+  spdy::SpdyVersion spdy_version;
+  // How many requests to keep in flight on each connection (the server's
+  // SETTINGS_MAX_CONCURRENT_STREAMS may lower this).
+  int concurrent_streams;
+  // Close each connection and open a new one after this many requests (zero
+  // to keep each connection open for the whole test).
+  int requests_per_connection;
+  // The receive window to advertise for each stream (SPDY v3 and up).
+  int32 initial_window_size;
+  // If false, reset server pushes as soon as they start.
+  bool accept_push;
+  // How long to wait, once the test is over, for requests in flight to
+  // finish; those that don't are counted as failed.
+  base::TimeDelta drain_timeout;
+};
+
+// Counters and histograms for a load test.  Durations are measured from
+// when a request's SYN_STREAM is written to the socket.
+struct LoadClientStats {
+  LoadClientStats();
+  ~LoadClientStats();
+
+  void Merge(const LoadClientStats& other);
+
+  int64 connections_opened;
+  int64 connection_errors;
+  int64 requests_sent;
+  int64 requests_completed;
+  int64 requests_failed;  // reset, or unfinished when a connection ended
+  int64 pushes_received;
+  int64 pushes_completed;
+  int64 data_bytes_received;
+  int64 push_data_bytes_received;
+  // Time until the SYN_REPLY arrived, for all completed requests.
+  LatencyHistogram time_to_first_byte;
+  // Time until the last frame arrived, keyed by request priority.
+  std::map<net::SpdyPriority, LatencyHistogram> latency_by_priority;
+};
+
+// A SPDY client that opens plain TCP connections (without SSL, for use with
+// SpdyDebugUseSpdyForNonSslConnections) and issues requests from a weighted
+// mix as fast as the server will answer them, keeping a fixed number in
+// flight per connection.  It returns flow control window as response data
+// arrives, and accepts or resets server pushes.  Each client object handles
+// one connection at a time, and is meant to be run on its own thread.
+class SpdyLoadClient : public net::BufferedSpdyFramerVisitorInterface {
+ public:
+  // The client does not take ownership of the arguments, which must outlive
+  // it.  The request mix must be non-empty.  The seed determines the
+  // sequence of requests chosen from the mix, so that runs are repeatable.
+  SpdyLoadClient(const LoadClientOptions* options,
+                 const std::vector<LoadRequest>* request_mix,
+                 uint32 seed);
+  virtual ~SpdyLoadClient();
+
+  // Issue requests, reconnecting as needed, until the given time; then wait
+  // for requests in flight to finish (up to the drain timeout) and return.
+  void Run(base::TimeTicks end_time);
+
+  const LoadClientStats& stats() const { return stats_; }
+
+  // BufferedSpdyFramerVisitorInterface methods:
+  virtual void OnError(net::SpdyFramer::SpdyError error_code);
+  virtual void OnStreamError(net::SpdyStreamId stream_id,
+                             const std::string& description);
+  virtual void OnSynStream(net::SpdyStreamId stream_id,
+                           net::SpdyStreamId associated_stream_id,
+                           net::SpdyPriority priority,
+                           uint8 credential_slot,
+                           bool fin,
+                           bool unidirectional,
+                           const net::SpdyHeaderBlock& headers);
+  virtual void OnSynReply(net::SpdyStreamId stream_id,
+                          bool fin,
+                          const net::SpdyHeaderBlock& headers);
+  virtual void OnHeaders(net::SpdyStreamId stream_id,
+                         bool fin,
+                         const net::SpdyHeaderBlock& headers);
+  virtual void OnStreamFrameData(net::SpdyStreamId stream_id,
+                                 const char* data, size_t length, bool fin);
+  virtual void OnSettings(bool clear_persisted);
+  virtual void OnSetting(net::SpdySettingsIds id, uint8 flags, uint32 value);
+  virtual void OnPing(uint32 unique_id);
+  virtual void OnRstStream(net::SpdyStreamId stream_id,
+                           net::SpdyRstStreamStatus status);
+  virtual void OnGoAway(net::SpdyStreamId last_accepted_stream_id,
+                        net::SpdyGoAwayStatus status);
+  virtual void OnWindowUpdate(net::SpdyStreamId stream_id,
+                              uint32 delta_window_size);
+  virtual void OnPushPromise(net::SpdyStreamId stream_id,
+                             net::SpdyStreamId promised_stream_id);
+
+ private:
+  struct StreamState {
+    StreamState();
+
+    base::TimeTicks start_time;
+    net::SpdyPriority priority;
+    bool pushed;
+    bool got_reply;
+    int32 unacked_bytes;
+  };
+  typedef std::map<net::SpdyStreamId, StreamState> StreamMap;
+
+  // Run a single connection until it's closed, it has made as many requests
+  // as it's allowed to, or the end time passes and its requests have
+  // drained.  Return false if the connection failed.
+  bool RunConnection(base::TimeTicks end_time);
+  bool Connect();
+  void Disconnect();
+  // Read whatever is available (waiting up to the given timeout) and feed it
+  // to the framer.  Return false if the connection was closed or broken.
+  bool ReadInput(base::TimeDelta timeout);
+  // Write out all queued frames.  Return false if the connection broke.
+  bool FlushOutput();
+
+  void IssueRequests();
+  const LoadRequest& ChooseRequest();
+  void QueueFrame(net::SpdySerializedFrame* frame);
+  void FinishStream(net::SpdyStreamId stream_id, bool success);
+  // Fail every stream still in flight.
+  void FailAllStreams();
+
+  const LoadClientOptions* const options_;
+  const std::vector<LoadRequest>* const request_mix_;
+  int total_weight_;
+  uint32 random_state_;
+  scoped_ptr<net::BufferedSpdyFramer> framer_;
+  int socket_;
+  bool connection_error_;
+  bool going_away_;  // the server sent GOAWAY, or we're done issuing
+  int max_concurrent_streams_;
+  int connection_requests_;
+  net::SpdyStreamId next_stream_id_;
+  int num_client_streams_;
+  StreamMap streams_;
+  int32 unacked_session_bytes_;
+  std::string output_;
+  LoadClientStats stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(SpdyLoadClient);
+};
+
+}  // namespace testing
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_TESTING_SPDY_LOAD_CLIENT_H_
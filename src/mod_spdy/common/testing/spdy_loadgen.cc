@@ -0,0 +1,350 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Generates SPDY load against a running server, over plain TCP (so the
+// server must have SpdyDebugUseSpdyForNonSslConnections enabled), and writes
+// a report of throughput, time to first byte, and per-priority latency
+// histograms to stdout.  Each connection runs on its own thread, keeping a
+// fixed number of requests in flight, drawn at random from a weighted mix.
+// Usage:
+//
+//   spdy_loadgen [--host=<address>] [--port=<n>] [--host_header=<host>]
+//                [--connections=<n>] [--concurrent_streams=<n>]
+//                [--duration_s=<n>] [--requests_per_connection=<n>]
+//                [--spdy_version=2|3|3.1] [--initial_window=<bytes>]
+//                [--push=accept|reject] [--format=json|text]
+//                [--request=<path>[,<priority>[,<weight>]] ...]
+//
+// For example, to keep 64 connections busy for a minute, each with up to 16
+// requests in flight for the front page and (three times as often) a
+// lower-priority image, use the flags:
+//
+//   --port=8080 --connections=64 --concurrent_streams=16 --duration_s=60
+//   --request=/,0,1 --request=/logo.png,3,3
+
+#include <stdio.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/basictypes.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/stl_util.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+#include "mod_spdy/common/latency_histogram.h"
+#include "mod_spdy/common/protocol_util.h"
+#include "mod_spdy/common/testing/spdy_load_client.h"
+#include "mod_spdy/common/testing/tool_util.h"
+
+namespace {
+
+using mod_spdy::testing::GetFlagValue;
+using mod_spdy::testing::GetIntFlag;
+using mod_spdy::testing::PerSecond;
+
+struct LoadGenOptions {
+  LoadGenOptions()
+      : connections(16),
+        duration(base::TimeDelta::FromSeconds(10)),
+        json(true) {}
+
+  mod_spdy::testing::LoadClientOptions client;
+  std::vector<mod_spdy::testing::LoadRequest> requests;
+  int connections;
+  base::TimeDelta duration;
+  bool json;
+};
+
+class ClientThread : public base::PlatformThread::Delegate {
+ public:
+  ClientThread(const LoadGenOptions& options, uint32 seed,
+               base::TimeTicks end_time)
+      : client_(&options.client, &options.requests, seed),
+        end_time_(end_time) {}
+  virtual ~ClientThread() {}
+
+  virtual void ThreadMain() {
+    client_.Run(end_time_);
+  }
+
+  const mod_spdy::testing::LoadClientStats& stats() const {
+    return client_.stats();
+  }
+
+ private:
+  mod_spdy::testing::SpdyLoadClient client_;
+  const base::TimeTicks end_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(ClientThread);
+};
+
+long long Micros(base::TimeDelta duration) {
+  return static_cast<long long>(duration.InMicroseconds());
+}
+
+void AppendJsonHistogram(const mod_spdy::LatencyHistogram& histogram,
+                         std::string* out) {
+  base::StringAppendF(
+      out, "{\"count\": %lld, \"mean\": %lld, \"p50\": %lld, \"p90\": %lld, "
+      "\"p99\": %lld, \"p99.9\": %lld, \"max\": %lld, \"buckets\": ",
+      static_cast<long long>(histogram.count()), Micros(histogram.mean()),
+      Micros(histogram.Percentile(50)), Micros(histogram.Percentile(90)),
+      Micros(histogram.Percentile(99)), Micros(histogram.Percentile(99.9)),
+      Micros(histogram.max()));
+  histogram.AppendJsonBuckets(out);
+  out->push_back('}');
+}
+
+void AppendTextHistogram(const char* label,
+                         const mod_spdy::LatencyHistogram& histogram,
+                         std::string* out) {
+  base::StringAppendF(
+      out, "%-16s %10lld %10lld %10lld %10lld %10lld %10lld\n", label,
+      static_cast<long long>(histogram.count()),
+      Micros(histogram.Percentile(50)), Micros(histogram.Percentile(90)),
+      Micros(histogram.Percentile(99)), Micros(histogram.Percentile(99.9)),
+      Micros(histogram.max()));
+}
+
+std::string FormatReport(const LoadGenOptions& options,
+                         base::TimeDelta elapsed,
+                         const mod_spdy::testing::LoadClientStats& stats) {
+  typedef std::map<net::SpdyPriority, mod_spdy::LatencyHistogram>
+      PriorityMap;
+  const mod_spdy::testing::LoadClientOptions& client = options.client;
+  std::string out;
+  if (options.json) {
+    mod_spdy::testing::AppendJsonReportContext(&out);
+    base::StringAppendF(
+        &out,
+        "    \"target\": \"%s:%d\",\n"
+        "    \"spdy_version\": \"%s\",\n"
+        "    \"connections\": %d,\n"
+        "    \"concurrent_streams\": %d,\n"
+        "    \"requests_per_connection\": %d,\n"
+        "    \"initial_window\": %d,\n"
+        "    \"accept_push\": %s,\n"
+        "    \"duration_ms\": %lld,\n"
+        "    \"requests\": [",
+        client.host.c_str(), client.port, mod_spdy::SpdyVersionNumberString(client.spdy_version),
+        options.connections, client.concurrent_streams,
+        client.requests_per_connection, client.initial_window_size,
+        (client.accept_push ? "true" : "false"),
+        static_cast<long long>(options.duration.InMilliseconds()));
+    for (size_t i = 0; i < options.requests.size(); ++i) {
+      const mod_spdy::testing::LoadRequest& request = options.requests[i];
+      base::StringAppendF(
+          &out, "%s{\"path\": \"%s\", \"priority\": %d, \"weight\": %d}",
+          (i == 0 ? "" : ", "), request.path.c_str(),
+          static_cast<int>(request.priority), request.weight);
+    }
+    base::StringAppendF(
+        &out,
+        "]\n  },\n  \"results\": {\n"
+        "    \"elapsed_ms\": %lld,\n"
+        "    \"connections_opened\": %lld,\n"
+        "    \"connection_errors\": %lld,\n"
+        "    \"requests_sent\": %lld,\n"
+        "    \"requests_completed\": %lld,\n"
+        "    \"requests_failed\": %lld,\n"
+        "    \"pushes_received\": %lld,\n"
+        "    \"pushes_completed\": %lld,\n"
+        "    \"requests_per_second\": %.0f,\n"
+        "    \"bytes_per_second\": %.0f,\n"
+        "    \"push_bytes_per_second\": %.0f,\n"
+        "    \"time_to_first_byte_us\": ",
+        static_cast<long long>(elapsed.InMilliseconds()),
+        static_cast<long long>(stats.connections_opened),
+        static_cast<long long>(stats.connection_errors),
+        static_cast<long long>(stats.requests_sent),
+        static_cast<long long>(stats.requests_completed),
+        static_cast<long long>(stats.requests_failed),
+        static_cast<long long>(stats.pushes_received),
+        static_cast<long long>(stats.pushes_completed),
+        PerSecond(stats.requests_completed, elapsed),
+        PerSecond(stats.data_bytes_received, elapsed),
+        PerSecond(stats.push_data_bytes_received, elapsed));
+    AppendJsonHistogram(stats.time_to_first_byte, &out);
+    out.append(",\n    \"latency_us_by_priority\": {");
+    for (PriorityMap::const_iterator iter = stats.latency_by_priority.begin();
+         iter != stats.latency_by_priority.end(); ++iter) {
+      base::StringAppendF(&out, "%s\n      \"%d\": ",
+                          (iter == stats.latency_by_priority.begin() ?
+                           "" : ","),
+                          static_cast<int>(iter->first));
+      AppendJsonHistogram(iter->second, &out);
+    }
+    out.append("\n    }\n  }\n}\n");
+  } else {
+    base::StringAppendF(
+        &out,
+        "SPDY/%s to %s:%d, %d connections x %d streams, %lld ms\n"
+        "Connections:  %lld opened, %lld errors\n"
+        "Requests:     %lld sent, %lld completed, %lld failed\n"
+        "Pushes:       %lld received, %lld completed\n"
+        "Throughput:   %.0f requests/s, %.1f MB/s (%.1f MB/s pushed)\n\n"
+        "%-16s %10s %10s %10s %10s %10s %10s\n",
+        mod_spdy::SpdyVersionNumberString(client.spdy_version),
+        client.host.c_str(), client.port, options.connections,
+        client.concurrent_streams,
+        static_cast<long long>(elapsed.InMilliseconds()),
+        static_cast<long long>(stats.connections_opened),
+        static_cast<long long>(stats.connection_errors),
+        static_cast<long long>(stats.requests_sent),
+        static_cast<long long>(stats.requests_completed),
+        static_cast<long long>(stats.requests_failed),
+        static_cast<long long>(stats.pushes_received),
+        static_cast<long long>(stats.pushes_completed),
+        PerSecond(stats.requests_completed, elapsed),
+        PerSecond(stats.data_bytes_received, elapsed) / (1024.0 * 1024.0),
+        PerSecond(stats.push_data_bytes_received, elapsed) /
+            (1024.0 * 1024.0),
+        "Latency (us)", "Count", "p50", "p90", "p99", "p99.9", "Max");
+    AppendTextHistogram("first byte", stats.time_to_first_byte, &out);
+    for (PriorityMap::const_iterator iter = stats.latency_by_priority.begin();
+         iter != stats.latency_by_priority.end(); ++iter) {
+      const std::string label =
+          base::StringPrintf("priority %d", static_cast<int>(iter->first));
+      AppendTextHistogram(label.c_str(), iter->second, &out);
+    }
+  }
+  return out;
+}
+
+// Parse "<path>[,<priority>[,<weight>]]".
+bool ParseRequest(const std::string& value,
+                  mod_spdy::testing::LoadRequest* request) {
+  std::vector<std::string> fields;
+  base::SplitString(value, ',', &fields);
+  if (fields.empty() || fields.size() > 3 || fields[0].empty() ||
+      fields[0][0] != '/') {
+    return false;
+  }
+  request->path = fields[0];
+  unsigned priority = 0;
+  if (fields.size() >= 2) {
+    if (!base::StringToUint(fields[1], &priority) || priority > 7) {
+      return false;
+    }
+  }
+  request->priority = static_cast<net::SpdyPriority>(priority);
+  int weight = 1;
+  if (fields.size() >= 3) {
+    if (!base::StringToInt(fields[2], &weight) || weight <= 0) {
+      return false;
+    }
+  }
+  request->weight = weight;
+  return true;
+}
+
+bool ParseFlag(const std::string& arg, LoadGenOptions* options) {
+  mod_spdy::testing::LoadClientOptions* client = &options->client;
+  std::string value;
+  int number = 0;
+  if (GetFlagValue(arg, "--host", &value) && !value.empty()) {
+    client->host = value;
+  } else if (GetFlagValue(arg, "--host_header", &value)) {
+    client->host_header = value;
+  } else if (GetIntFlag(arg, "--port", 1, &client->port) ||
+             GetIntFlag(arg, "--connections", 1, &options->connections) ||
+             GetIntFlag(arg, "--concurrent_streams", 1,
+                        &client->concurrent_streams) ||
+             GetIntFlag(arg, "--requests_per_connection", 0,
+                        &client->requests_per_connection)) {
+    // Nothing more to do.
+  } else if (GetIntFlag(arg, "--duration_s", 1, &number)) {
+    options->duration = base::TimeDelta::FromSeconds(number);
+  } else if (GetIntFlag(arg, "--initial_window", 1, &number)) {
+    client->initial_window_size = number;
+  } else if (GetFlagValue(arg, "--spdy_version", &value)) {
+    return mod_spdy::testing::ParseSpdyVersion(value, &client->spdy_version);
+  } else if (GetFlagValue(arg, "--push", &value) &&
+             (value == "accept" || value == "reject")) {
+    client->accept_push = (value == "accept");
+  } else if (GetFlagValue(arg, "--format", &value) &&
+             (value == "json" || value == "text")) {
+    options->json = (value == "json");
+  } else if (GetFlagValue(arg, "--request", &value)) {
+    mod_spdy::testing::LoadRequest request;
+    if (!ParseRequest(value, &request)) {
+      return false;
+    }
+    options->requests.push_back(request);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+int Usage(const char* program) {
+  fprintf(stderr, "Usage: %s [--host=<address>] [--port=<n>] "
+          "[--host_header=<host>] [--connections=<n>] "
+          "[--concurrent_streams=<n>] [--duration_s=<n>] "
+          "[--requests_per_connection=<n>] [--spdy_version=2|3|3.1] "
+          "[--initial_window=<bytes>] [--push=accept|reject] "
+          "[--format=json|text] "
+          "[--request=<path>[,<priority>[,<weight>]] ...]\n", program);
+  return 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit_manager;
+  LoadGenOptions options;
+  for (int i = 1; i < argc; ++i) {
+    if (!ParseFlag(argv[i], &options)) {
+      return Usage(argv[0]);
+    }
+  }
+  if (options.requests.empty()) {
+    mod_spdy::testing::LoadRequest request;
+    request.path = "/";
+    options.requests.push_back(request);
+  }
+
+  const base::TimeTicks start_time = base::TimeTicks::Now();
+  const base::TimeTicks end_time = start_time + options.duration;
+  std::vector<ClientThread*> clients;
+  std::vector<base::PlatformThreadHandle> handles;
+  for (int i = 0; i < options.connections; ++i) {
+    scoped_ptr<ClientThread> client(new ClientThread(options, i + 1,
+                                                     end_time));
+    base::PlatformThreadHandle handle;
+    if (!base::PlatformThread::Create(0, client.get(), &handle)) {
+      LOG(ERROR) << "Could not start client thread";
+      break;
+    }
+    clients.push_back(client.release());
+    handles.push_back(handle);
+  }
+  mod_spdy::testing::LoadClientStats stats;
+  for (size_t i = 0; i < clients.size(); ++i) {
+    base::PlatformThread::Join(handles[i]);
+    stats.Merge(clients[i]->stats());
+  }
+  const base::TimeDelta elapsed = base::TimeTicks::Now() - start_time;
+  STLDeleteElements(&clients);
+
+  fputs(FormatReport(options, elapsed, stats).c_str(), stdout);
+  return (stats.requests_completed > 0 ? 0 : 1);
+}
@@ -0,0 +1,336 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures end-to-end SpdySession throughput without Apache or a network:
+// runs a number of sessions concurrently, each on its own connection thread
+// and all sharing one ThreadPool for their streams (as under Apache), with a
+// SyntheticClientSessionIO replaying requests at full speed and a
+// SyntheticStreamTaskFactory answering them.  Writes a report of requests
+// and frames per second, CPU time per request, and request latency
+// percentiles to stdout.  Usage:
+//
+//   spdy_session_loadtest [--sessions=<n>] [--requests_per_session=<n>]
+//                         [--concurrent_streams=<n>] [--threads=<n>]
+//                         [--response_bytes=<n>[,<n>...]]
+//                         [--spdy_version=2|3|3.1] [--format=json|text]
+//
+// The CPU time includes the (small) cost of the synthetic client, as well as
+// that of the sessions and stream tasks.
+
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/basictypes.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/stl_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+#include "mod_spdy/common/executor.h"
+#include "mod_spdy/common/protocol_util.h"
+#include "mod_spdy/common/spdy_server_config.h"
+#include "mod_spdy/common/spdy_session.h"
+#include "mod_spdy/common/testing/synthetic_client_session_io.h"
+#include "mod_spdy/common/testing/synthetic_stream_task_factory.h"
+#include "mod_spdy/common/testing/tool_util.h"
+#include "mod_spdy/common/thread_pool.h"
+
+namespace {
+
+using mod_spdy::testing::GetFlagValue;
+using mod_spdy::testing::GetIntFlag;
+using mod_spdy::testing::PerSecond;
+
+struct LoadTestOptions {
+  LoadTestOptions()
+      : sessions(8),
+        requests_per_session(1000),
+        concurrent_streams(32),
+        threads(8),
+        spdy_version(mod_spdy::spdy::SPDY_VERSION_3_1),
+        json(true) {
+    response_bytes.push_back(1024);
+    response_bytes.push_back(16384);
+    response_bytes.push_back(131072);
+  }
+
+  int sessions;
+  int requests_per_session;
+  int concurrent_streams;
+  int threads;
+  std::vector<size_t> response_bytes;
+  mod_spdy::spdy::SpdyVersion spdy_version;
+  bool json;
+};
+
+// Runs one session on its own thread, standing in for an Apache connection.
+class SessionThread : public base::PlatformThread::Delegate {
+ public:
+  SessionThread(const LoadTestOptions& options,
+                const mod_spdy::SpdyServerConfig* config,
+                mod_spdy::SpdyStreamTaskFactory* task_factory,
+                mod_spdy::ThreadPool* thread_pool)
+      : session_io_(options.spdy_version, options.requests_per_session,
+                    options.concurrent_streams),
+        executor_(thread_pool->NewExecutor()),
+        session_(options.spdy_version, config, &session_io_, task_factory,
+                 executor_.get()) {}
+  virtual ~SessionThread() {}
+
+  virtual void ThreadMain() {
+    session_.Run();
+  }
+
+  const mod_spdy::testing::SyntheticClientSessionIO& session_io() const {
+    return session_io_;
+  }
+
+ private:
+  mod_spdy::testing::SyntheticClientSessionIO session_io_;
+  scoped_ptr<mod_spdy::Executor> executor_;
+  mod_spdy::SpdySession session_;
+
+  DISALLOW_COPY_AND_ASSIGN(SessionThread);
+};
+
+struct LoadTestResults {
+  LoadTestResults()
+      : completed_requests(0), failed_requests(0), frames(0), data_bytes(0) {}
+
+  base::TimeDelta elapsed;
+  base::TimeDelta cpu_time;
+  int64 completed_requests;
+  int64 failed_requests;
+  uint64 frames;
+  uint64 data_bytes;
+  // Sorted ascending.
+  std::vector<int64> latencies_us;
+};
+
+base::TimeDelta GetProcessCpuTime() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    PLOG(ERROR) << "getrusage failed";
+    return base::TimeDelta();
+  }
+  return (base::TimeDelta::FromSeconds(usage.ru_utime.tv_sec +
+                                       usage.ru_stime.tv_sec) +
+          base::TimeDelta::FromMicroseconds(usage.ru_utime.tv_usec +
+                                            usage.ru_stime.tv_usec));
+}
+
+bool RunLoadTest(const LoadTestOptions& options, LoadTestResults* results) {
+  mod_spdy::SpdyServerConfig config;
+  // The client starts a new request as soon as the last frame of a response
+  // is written, which may be before the session has retired the old stream,
+  // so leave some headroom to keep new streams from being refused.
+  config.set_max_streams_per_connection(2 * options.concurrent_streams);
+  mod_spdy::testing::SyntheticStreamTaskFactory task_factory(
+      options.response_bytes);
+  mod_spdy::ThreadPool thread_pool(options.threads, options.threads);
+  if (!thread_pool.Start()) {
+    LOG(ERROR) << "Could not start thread pool";
+    return false;
+  }
+
+  // Set up all the sessions before starting the clock, so that we measure
+  // only the sessions running.
+  std::vector<SessionThread*> sessions;
+  for (int i = 0; i < options.sessions; ++i) {
+    sessions.push_back(new SessionThread(options, &config, &task_factory,
+                                         &thread_pool));
+  }
+  std::vector<base::PlatformThreadHandle> handles(sessions.size());
+
+  const base::TimeDelta start_cpu_time = GetProcessCpuTime();
+  const base::TimeTicks start_time = base::TimeTicks::Now();
+  bool success = true;
+  size_t num_started = 0;
+  for (; num_started < sessions.size(); ++num_started) {
+    if (!base::PlatformThread::Create(0, sessions[num_started],
+                                      &handles[num_started])) {
+      LOG(ERROR) << "Could not start session thread";
+      success = false;
+      break;
+    }
+  }
+  for (size_t i = 0; i < num_started; ++i) {
+    base::PlatformThread::Join(handles[i]);
+  }
+  results->elapsed = base::TimeTicks::Now() - start_time;
+  results->cpu_time = GetProcessCpuTime() - start_cpu_time;
+
+  for (size_t i = 0; i < num_started; ++i) {
+    const mod_spdy::testing::SyntheticClientSessionIO& session_io =
+        sessions[i]->session_io();
+    results->completed_requests += session_io.num_completed_requests();
+    results->failed_requests += session_io.num_failed_requests();
+    results->frames += session_io.num_frames_received();
+    results->data_bytes += session_io.data_bytes_received();
+    results->latencies_us.insert(results->latencies_us.end(),
+                                 session_io.latencies_us().begin(),
+                                 session_io.latencies_us().end());
+  }
+  std::sort(results->latencies_us.begin(), results->latencies_us.end());
+  STLDeleteElements(&sessions);
+  return success;
+}
+
+// Return the given percentile (nearest-rank) of a sorted list.
+int64 Percentile(const std::vector<int64>& sorted, double percentile) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  const size_t rank = static_cast<size_t>(
+      percentile / 100.0 * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+std::string JoinSizes(const std::vector<size_t>& sizes) {
+  std::string out;
+  for (size_t i = 0; i < sizes.size(); ++i) {
+    base::StringAppendF(&out, "%s%llu", (i == 0 ? "" : ","),
+                        static_cast<unsigned long long>(sizes[i]));
+  }
+  return out;
+}
+
+std::string FormatReport(const LoadTestOptions& options,
+                         const LoadTestResults& results) {
+  const uint64 requests = results.completed_requests;
+  const double requests_per_second = PerSecond(requests, results.elapsed);
+  const double frames_per_second = PerSecond(results.frames, results.elapsed);
+  const double bytes_per_second =
+      PerSecond(results.data_bytes, results.elapsed);
+  const double cpu_us_per_request =
+      (requests == 0 ? 0.0 :
+       static_cast<double>(results.cpu_time.InMicroseconds()) / requests);
+  const std::vector<int64>& latencies = results.latencies_us;
+
+  std::string out;
+  if (options.json) {
+    mod_spdy::testing::AppendJsonReportContext(&out);
+    base::StringAppendF(
+        &out,
+        "    \"spdy_version\": \"%s\",\n"
+        "    \"sessions\": %d,\n"
+        "    \"requests_per_session\": %d,\n"
+        "    \"concurrent_streams\": %d,\n"
+        "    \"threads\": %d,\n"
+        "    \"response_bytes\": [%s]\n"
+        "  },\n  \"results\": {\n"
+        "    \"completed_requests\": %lld,\n"
+        "    \"failed_requests\": %lld,\n"
+        "    \"elapsed_ms\": %lld,\n"
+        "    \"requests_per_second\": %.0f,\n"
+        "    \"frames_per_second\": %.0f,\n"
+        "    \"bytes_per_second\": %.0f,\n"
+        "    \"cpu_us_per_request\": %.1f,\n"
+        "    \"latency_us\": {\"p50\": %lld, \"p90\": %lld, \"p99\": %lld, "
+        "\"p99.9\": %lld, \"max\": %lld}\n"
+        "  }\n}\n",
+        mod_spdy::SpdyVersionNumberString(options.spdy_version),
+        options.sessions, options.requests_per_session,
+        options.concurrent_streams, options.threads,
+        JoinSizes(options.response_bytes).c_str(),
+        static_cast<long long>(results.completed_requests),
+        static_cast<long long>(results.failed_requests),
+        static_cast<long long>(results.elapsed.InMilliseconds()),
+        requests_per_second, frames_per_second, bytes_per_second,
+        cpu_us_per_request,
+        static_cast<long long>(Percentile(latencies, 50)),
+        static_cast<long long>(Percentile(latencies, 90)),
+        static_cast<long long>(Percentile(latencies, 99)),
+        static_cast<long long>(Percentile(latencies, 99.9)),
+        static_cast<long long>(latencies.empty() ? 0 : latencies.back()));
+  } else {
+    base::StringAppendF(
+        &out,
+        "SPDY/%s, %d sessions x %d requests, %d concurrent streams, "
+        "%d threads, response bytes %s\n"
+        "Requests:     %lld completed, %lld failed, in %lld ms\n"
+        "Throughput:   %.0f requests/s, %.0f frames/s, %.1f MB/s\n"
+        "CPU:          %.1f us/request\n"
+        "Latency (us): p50 %lld, p90 %lld, p99 %lld, p99.9 %lld, max %lld\n",
+        mod_spdy::SpdyVersionNumberString(options.spdy_version),
+        options.sessions, options.requests_per_session,
+        options.concurrent_streams, options.threads,
+        JoinSizes(options.response_bytes).c_str(),
+        static_cast<long long>(results.completed_requests),
+        static_cast<long long>(results.failed_requests),
+        static_cast<long long>(results.elapsed.InMilliseconds()),
+        requests_per_second, frames_per_second,
+        bytes_per_second / (1024.0 * 1024.0), cpu_us_per_request,
+        static_cast<long long>(Percentile(latencies, 50)),
+        static_cast<long long>(Percentile(latencies, 90)),
+        static_cast<long long>(Percentile(latencies, 99)),
+        static_cast<long long>(Percentile(latencies, 99.9)),
+        static_cast<long long>(latencies.empty() ? 0 : latencies.back()));
+  }
+  return out;
+}
+
+int Usage(const char* program) {
+  fprintf(stderr, "Usage: %s [--sessions=<n>] [--requests_per_session=<n>] "
+          "[--concurrent_streams=<n>] [--threads=<n>] "
+          "[--response_bytes=<n>[,<n>...]] [--spdy_version=2|3|3.1] "
+          "[--format=json|text]\n", program);
+  return 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit_manager;
+  LoadTestOptions options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    std::string value;
+    if (GetIntFlag(arg, "--sessions", 1, &options.sessions) ||
+        GetIntFlag(arg, "--requests_per_session", 1,
+                   &options.requests_per_session) ||
+        GetIntFlag(arg, "--concurrent_streams", 1,
+                   &options.concurrent_streams) ||
+        GetIntFlag(arg, "--threads", 1, &options.threads)) {
+      continue;
+    } else if (GetFlagValue(arg, "--response_bytes", &value) &&
+               mod_spdy::testing::ParseSizeList(value,
+                                                &options.response_bytes)) {
+      continue;
+    } else if (GetFlagValue(arg, "--spdy_version", &value) &&
+               mod_spdy::testing::ParseSpdyVersion(value,
+                                                   &options.spdy_version)) {
+      continue;
+    } else if (GetFlagValue(arg, "--format", &value) &&
+               (value == "json" || value == "text")) {
+      options.json = (value == "json");
+    } else {
+      return Usage(argv[0]);
+    }
+  }
+
+  LoadTestResults results;
+  if (!RunLoadTest(options, &results)) {
+    return 1;
+  }
+  fputs(FormatReport(options, results).c_str(), stdout);
+  return (results.failed_requests == 0 ? 0 : 1);
+}
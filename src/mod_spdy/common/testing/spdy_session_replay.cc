@@ -0,0 +1,425 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Replays a session capture log (see session_capture.h) against a
+// SpdySession without Apache or a network: the client's bytes are fed to the
+// session exactly as they were originally read, either at the pace at which
+// they originally arrived (optionally sped up) or as fast as possible, and a
+// SyntheticStreamTaskFactory answers the requests.  Writes a report of what
+// the session sent back to stdout.  Usage:
+//
+//   spdy_session_replay --capture=<file> [--speed=<factor>]
+//                       [--response_bytes=<n>[,<n>...]] [--threads=<n>]
+//                       [--drain_ms=<ms>] [--trace=<file>]
+//                       [--format=json|text]
+//
+// A speed of 0 means to feed the input as fast as the session will take it.
+// With --trace, a trace of the session's scheduling (see trace_log.h) is
+// written to the given file, for viewing in chrome://tracing.
+// Note that the replayed input includes the client's original WINDOW_UPDATE
+// frames, which were sent in response to the original server's responses,
+// not the synthetic ones; with responses larger than the original ones, the
+// session may stall waiting for window, and with a fast speed, updates may
+// arrive before the data they refer to has been sent.  The report is meant
+// for reproducing a session's request pattern, not for exact comparisons
+// against the original server's output.
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/basictypes.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_piece.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+#include "mod_spdy/common/executor.h"
+#include "mod_spdy/common/protocol_util.h"
+#include "mod_spdy/common/session_capture.h"
+#include "mod_spdy/common/spdy_server_config.h"
+#include "mod_spdy/common/spdy_session.h"
+#include "mod_spdy/common/spdy_session_io.h"
+#include "mod_spdy/common/testing/synthetic_stream_task_factory.h"
+#include "mod_spdy/common/testing/tool_util.h"
+#include "mod_spdy/common/thread_pool.h"
+#include "mod_spdy/common/trace_log.h"
+#include "net/spdy/buffered_spdy_framer.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace {
+
+using mod_spdy::testing::GetFlagValue;
+using mod_spdy::testing::GetIntFlag;
+
+const size_t kFrameHeaderSize = 8;
+const uint8 kControlBit = 0x80;
+
+// Control frame type numbers, as they appear on the wire, for the report.
+const char* ControlFrameTypeName(int type) {
+  switch (type) {
+    case 1: return "SYN_STREAM";
+    case 2: return "SYN_REPLY";
+    case 3: return "RST_STREAM";
+    case 4: return "SETTINGS";
+    case 5: return "NOOP";
+    case 6: return "PING";
+    case 7: return "GOAWAY";
+    case 8: return "HEADERS";
+    case 9: return "WINDOW_UPDATE";
+    default: return "UNKNOWN";
+  }
+}
+
+struct ReplayOptions {
+  ReplayOptions()
+      : speed(1.0),
+        threads(4),
+        drain(base::TimeDelta::FromMilliseconds(500)),
+        json(true) {
+    response_bytes.push_back(1024);
+  }
+
+  std::string capture_path;
+  std::string trace_path;
+  double speed;
+  int threads;
+  base::TimeDelta drain;
+  std::vector<size_t> response_bytes;
+  bool json;
+};
+
+// Feeds the captured input to the session, and tallies up its output.
+class ReplaySessionIO : public mod_spdy::SpdySessionIO {
+ public:
+  ReplaySessionIO(mod_spdy::SessionCaptureReader* reader,
+                  const ReplayOptions& options)
+      : reader_(reader),
+        speed_(options.speed),
+        drain_(options.drain),
+        has_next_(false),
+        chunks_fed_(0),
+        input_bytes_fed_(0),
+        data_frames_(0),
+        data_bytes_(0) {
+    has_next_ = reader_->NextChunk(&next_offset_, &next_data_);
+    start_time_ = last_activity_ = base::TimeTicks::Now();
+  }
+  virtual ~ReplaySessionIO() {}
+
+  virtual bool IsConnectionAborted() { return false; }
+
+  virtual ReadStatus ProcessAvailableInput(bool block,
+                                           net::BufferedSpdyFramer* framer) {
+    while (true) {
+      const base::TimeTicks now = base::TimeTicks::Now();
+      if (!has_next_) {
+        // The log has ended; the client would now be waiting for the rest of
+        // its responses, so let the session drain before hanging up.
+        if (now - last_activity_ >= drain_) {
+          return READ_CONNECTION_CLOSED;
+        }
+        if (!block) {
+          return READ_NO_DATA;
+        }
+        base::PlatformThread::Sleep(
+            std::min(drain_ - (now - last_activity_),
+                     base::TimeDelta::FromMilliseconds(10)));
+        continue;
+      }
+
+      const base::TimeTicks due = DueTime();
+      if (due > now) {
+        if (!block) {
+          return READ_NO_DATA;
+        }
+        base::PlatformThread::Sleep(due - now);
+        continue;
+      }
+
+      ++chunks_fed_;
+      input_bytes_fed_ += next_data_.size();
+      last_activity_ = now;
+      const base::StringPiece data = next_data_;
+      has_next_ = reader_->NextChunk(&next_offset_, &next_data_);
+      // As in ApacheSpdySessionIO, the framer reports the details of any
+      // error to the session itself.
+      framer->ProcessInput(data.data(), data.size());
+      if (framer->HasError()) {
+        return READ_ERROR;
+      }
+      return READ_SUCCESS;
+    }
+  }
+
+  virtual WriteStatus SendFrameRaw(const net::SpdySerializedFrame& frame) {
+    last_activity_ = base::TimeTicks::Now();
+    DCHECK_GE(frame.size(), kFrameHeaderSize);
+    const uint8* data = reinterpret_cast<const uint8*>(frame.data());
+    if ((data[0] & kControlBit) == 0) {
+      ++data_frames_;
+      data_bytes_ += frame.size() - kFrameHeaderSize;
+    } else {
+      ++control_frames_[(static_cast<int>(data[2]) << 8) | data[3]];
+    }
+    return WRITE_SUCCESS;
+  }
+
+  base::TimeTicks start_time() const { return start_time_; }
+  int64 chunks_fed() const { return chunks_fed_; }
+  uint64 input_bytes_fed() const { return input_bytes_fed_; }
+  // Maps wire control frame type to number of frames sent.
+  const std::map<int, int64>& control_frames() const {
+    return control_frames_;
+  }
+  int64 data_frames() const { return data_frames_; }
+  uint64 data_bytes() const { return data_bytes_; }
+
+ private:
+  base::TimeTicks DueTime() const {
+    if (speed_ <= 0.0) {
+      return start_time_;
+    }
+    return start_time_ + base::TimeDelta::FromMicroseconds(
+        static_cast<int64>(next_offset_.InMicroseconds() / speed_));
+  }
+
+  mod_spdy::SessionCaptureReader* const reader_;
+  const double speed_;
+  const base::TimeDelta drain_;
+  base::TimeTicks start_time_;
+  base::TimeTicks last_activity_;
+  bool has_next_;
+  base::TimeDelta next_offset_;
+  base::StringPiece next_data_;
+  int64 chunks_fed_;
+  uint64 input_bytes_fed_;
+  std::map<int, int64> control_frames_;
+  int64 data_frames_;
+  uint64 data_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReplaySessionIO);
+};
+
+bool WriteFile(const std::string& path, const std::string& contents) {
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == NULL) {
+    PLOG(ERROR) << "Could not open " << path;
+    return false;
+  }
+  const bool success =
+      fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+  if (fclose(file) != 0 || !success) {
+    PLOG(ERROR) << "Could not write " << path;
+    return false;
+  }
+  return true;
+}
+
+bool ReadFile(const std::string& path, std::string* contents) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == NULL) {
+    PLOG(ERROR) << "Could not open " << path;
+    return false;
+  }
+  char buffer[65536];
+  size_t size = 0;
+  while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    contents->append(buffer, size);
+  }
+  const bool success = !ferror(file);
+  if (!success) {
+    PLOG(ERROR) << "Could not read " << path;
+  }
+  fclose(file);
+  return success;
+}
+
+std::string FormatReport(const ReplayOptions& options,
+                         const mod_spdy::SessionCaptureReader& reader,
+                         const ReplaySessionIO& session_io,
+                         base::TimeDelta elapsed,
+                         base::TimeDelta captured_duration) {
+  std::string frames;
+  for (std::map<int, int64>::const_iterator iter =
+           session_io.control_frames().begin();
+       iter != session_io.control_frames().end(); ++iter) {
+    if (options.json) {
+      base::StringAppendF(&frames, "%s\"%s\": %lld",
+                          (frames.empty() ? "" : ", "),
+                          ControlFrameTypeName(iter->first),
+                          static_cast<long long>(iter->second));
+    } else {
+      base::StringAppendF(&frames, " %s %lld,",
+                          ControlFrameTypeName(iter->first),
+                          static_cast<long long>(iter->second));
+    }
+  }
+
+  std::string out;
+  if (options.json) {
+    mod_spdy::testing::AppendJsonReportContext(&out);
+    base::StringAppendF(
+        &out,
+        "    \"capture\": \"%s\",\n"
+        "    \"spdy_version\": \"%s\",\n"
+        "    \"captured_at_ms\": %lld,\n"
+        "    \"truncated\": %s,\n"
+        "    \"speed\": %.2f,\n"
+        "    \"threads\": %d\n"
+        "  },\n  \"results\": {\n"
+        "    \"chunks\": %lld,\n"
+        "    \"input_bytes\": %llu,\n"
+        "    \"captured_duration_ms\": %lld,\n"
+        "    \"elapsed_ms\": %lld,\n"
+        "    \"control_frames\": {%s},\n"
+        "    \"data_frames\": %lld,\n"
+        "    \"data_bytes\": %llu\n"
+        "  }\n}\n",
+        options.capture_path.c_str(),
+        mod_spdy::SpdyVersionNumberString(reader.spdy_version()),
+        static_cast<long long>(reader.start_time().ToJavaTime()),
+        (reader.truncated() ? "true" : "false"), options.speed,
+        options.threads, static_cast<long long>(session_io.chunks_fed()),
+        static_cast<unsigned long long>(session_io.input_bytes_fed()),
+        static_cast<long long>(captured_duration.InMilliseconds()),
+        static_cast<long long>(elapsed.InMilliseconds()), frames.c_str(),
+        static_cast<long long>(session_io.data_frames()),
+        static_cast<unsigned long long>(session_io.data_bytes()));
+  } else {
+    base::StringAppendF(
+        &out,
+        "SPDY/%s capture %s%s, speed %.2f, %d threads\n"
+        "Input:        %lld chunks, %llu bytes, captured over %lld ms, "
+        "replayed in %lld ms\n"
+        "Output:      %s %lld DATA frames, %llu data bytes\n",
+        mod_spdy::SpdyVersionNumberString(reader.spdy_version()),
+        options.capture_path.c_str(),
+        (reader.truncated() ? " (truncated)" : ""), options.speed,
+        options.threads, static_cast<long long>(session_io.chunks_fed()),
+        static_cast<unsigned long long>(session_io.input_bytes_fed()),
+        static_cast<long long>(captured_duration.InMilliseconds()),
+        static_cast<long long>(elapsed.InMilliseconds()), frames.c_str(),
+        static_cast<long long>(session_io.data_frames()),
+        static_cast<unsigned long long>(session_io.data_bytes()));
+  }
+  return out;
+}
+
+// Return the offset of the last chunk in the log, i.e. how long the
+// client's side of the original session lasted.
+base::TimeDelta GetCapturedDuration(const std::string& log) {
+  mod_spdy::SessionCaptureReader reader;
+  base::TimeDelta last_offset;
+  if (reader.Init(log)) {
+    base::TimeDelta offset;
+    base::StringPiece data;
+    while (reader.NextChunk(&offset, &data)) {
+      last_offset = offset;
+    }
+  }
+  return last_offset;
+}
+
+int Usage(const char* program) {
+  fprintf(stderr, "Usage: %s --capture=<file> [--speed=<factor>] "
+          "[--response_bytes=<n>[,<n>...]] [--threads=<n>] "
+          "[--drain_ms=<ms>] [--trace=<file>] [--format=json|text]\n",
+          program);
+  return 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit_manager;
+  ReplayOptions options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    std::string value;
+    int number = 0;
+    if (GetFlagValue(arg, "--capture", &value) && !value.empty()) {
+      options.capture_path = value;
+    } else if (GetFlagValue(arg, "--trace", &value) && !value.empty()) {
+      options.trace_path = value;
+    } else if (GetFlagValue(arg, "--speed", &value) &&
+               base::StringToDouble(value, &options.speed) &&
+               options.speed >= 0.0) {
+      continue;
+    } else if (GetFlagValue(arg, "--response_bytes", &value) &&
+               mod_spdy::testing::ParseSizeList(value,
+                                                &options.response_bytes)) {
+      continue;
+    } else if (GetIntFlag(arg, "--threads", 1, &options.threads)) {
+      continue;
+    } else if (GetIntFlag(arg, "--drain_ms", 0, &number)) {
+      options.drain = base::TimeDelta::FromMilliseconds(number);
+    } else if (GetFlagValue(arg, "--format", &value) &&
+               (value == "json" || value == "text")) {
+      options.json = (value == "json");
+    } else {
+      return Usage(argv[0]);
+    }
+  }
+  if (options.capture_path.empty()) {
+    return Usage(argv[0]);
+  }
+
+  std::string log;
+  if (!ReadFile(options.capture_path, &log)) {
+    return 1;
+  }
+  mod_spdy::SessionCaptureReader reader;
+  if (!reader.Init(log)) {
+    LOG(ERROR) << options.capture_path << " is not a session capture log";
+    return 1;
+  }
+
+  if (!options.trace_path.empty()) {
+    mod_spdy::TraceLog::CreateInstance(
+        mod_spdy::TraceLog::kDefaultEventsPerThread);
+  }
+
+  mod_spdy::SpdyServerConfig config;
+  mod_spdy::testing::SyntheticStreamTaskFactory task_factory(
+      options.response_bytes);
+  mod_spdy::ThreadPool thread_pool(options.threads, options.threads);
+  if (!thread_pool.Start()) {
+    LOG(ERROR) << "Could not start thread pool";
+    return 1;
+  }
+  scoped_ptr<mod_spdy::Executor> executor(thread_pool.NewExecutor());
+  ReplaySessionIO session_io(&reader, options);
+  mod_spdy::SpdySession session(reader.spdy_version(), &config, &session_io,
+                                &task_factory, executor.get());
+  session.Run();
+  const base::TimeDelta elapsed =
+      base::TimeTicks::Now() - session_io.start_time();
+
+  if (mod_spdy::TraceLog::Instance() != NULL &&
+      !WriteFile(options.trace_path,
+                 mod_spdy::TraceLog::Instance()->GetTraceJson())) {
+    return 1;
+  }
+
+  fputs(FormatReport(options, reader, session_io, elapsed,
+                     GetCapturedDuration(log)).c_str(), stdout);
+  return 0;
+}
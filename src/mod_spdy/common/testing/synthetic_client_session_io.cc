@@ -0,0 +1,222 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/testing/synthetic_client_session_io.h"
+
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "mod_spdy/common/protocol_util.h"
+#include "net/spdy/buffered_spdy_framer.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace {
+
+// Wire format constants for the frame headers we inspect; these are the same
+// for SPDY/2 and SPDY/3.
+const size_t kFrameHeaderSize = 8;
+const uint8 kControlBit = 0x80;
+const uint16 kSynReplyType = 2;
+const uint16 kRstStreamType = 3;
+const uint16 kHeadersType = 8;
+const uint8 kFlagFin = 0x01;
+
+// Return flow control window to the server once this much of it has been
+// used, like Chrome does.
+const int32 kWindowUpdateThreshold = net::kSpdyStreamInitialWindowSize / 2;
+
+uint32 ReadUint32(const uint8* data) {
+  return ((static_cast<uint32>(data[0]) << 24) |
+          (static_cast<uint32>(data[1]) << 16) |
+          (static_cast<uint32>(data[2]) << 8) |
+          static_cast<uint32>(data[3]));
+}
+
+void AddRequestHeaders(mod_spdy::spdy::SpdyVersion version,
+                       net::SpdyNameValueBlock* headers) {
+  const bool spdy2 = version < mod_spdy::spdy::SPDY_VERSION_3;
+  (*headers)[spdy2 ? mod_spdy::http::kHost :
+             mod_spdy::spdy::kSpdy3Host] = "www.example.com";
+  (*headers)[spdy2 ? mod_spdy::spdy::kSpdy2Method :
+             mod_spdy::spdy::kSpdy3Method] = "GET";
+  (*headers)[spdy2 ? mod_spdy::spdy::kSpdy2Scheme :
+             mod_spdy::spdy::kSpdy3Scheme] = "https";
+  (*headers)[spdy2 ? mod_spdy::spdy::kSpdy2Url :
+             mod_spdy::spdy::kSpdy3Path] = "/index.html";
+  (*headers)[spdy2 ? mod_spdy::spdy::kSpdy2Version :
+             mod_spdy::spdy::kSpdy3Version] = "HTTP/1.1";
+}
+
+}  // namespace
+
+namespace mod_spdy {
+
+namespace testing {
+
+SyntheticClientSessionIO::SyntheticClientSessionIO(
+    spdy::SpdyVersion spdy_version,
+    int num_requests, int max_concurrent_requests)
+    : spdy_version_(spdy_version),
+      client_framer_(SpdyVersionToFramerVersion(spdy_version), true),
+      num_requests_(num_requests),
+      max_concurrent_requests_(max_concurrent_requests),
+      num_issued_requests_(0),
+      next_stream_id_(1),
+      unacked_session_bytes_(0),
+      num_completed_requests_(0),
+      num_failed_requests_(0),
+      num_frames_received_(0),
+      data_bytes_received_(0) {
+  DCHECK_GE(num_requests_, 0);
+  DCHECK_GT(max_concurrent_requests_, 0);
+  IssueRequests();
+}
+
+SyntheticClientSessionIO::~SyntheticClientSessionIO() {}
+
+bool SyntheticClientSessionIO::IsConnectionAborted() {
+  return false;
+}
+
+SpdySessionIO::ReadStatus SyntheticClientSessionIO::ProcessAvailableInput(
+    bool block, net::BufferedSpdyFramer* framer) {
+  if (pending_input_.empty()) {
+    // There's no real connection to wait on; everything we'll ever send is
+    // triggered by the server's own output.  So if we have nothing to send,
+    // either we're done, or we're waiting for the server, and either way
+    // blocking would be pointless.
+    return (num_completed_requests_ + num_failed_requests_ >= num_requests_ ?
+            READ_CONNECTION_CLOSED : READ_NO_DATA);
+  }
+
+  const base::TimeTicks now = base::TimeTicks::Now();
+  for (size_t i = 0; i < pending_streams_.size(); ++i) {
+    active_streams_[pending_streams_[i]] = now;
+  }
+  pending_streams_.clear();
+
+  // Swap the input out first, since feeding it to the framer may cause the
+  // session to write frames (and thus queue more input) before we return.
+  std::string input;
+  input.swap(pending_input_);
+  framer->ProcessInput(input.data(), input.size());
+  return framer->HasError() ? READ_ERROR : READ_SUCCESS;
+}
+
+SpdySessionIO::WriteStatus SyntheticClientSessionIO::SendFrameRaw(
+    const net::SpdySerializedFrame& frame) {
+  ++num_frames_received_;
+  DCHECK_GE(frame.size(), kFrameHeaderSize);
+  const uint8* data = reinterpret_cast<const uint8*>(frame.data());
+  const uint8 flags = data[4];
+
+  if ((data[0] & kControlBit) == 0) {
+    const net::SpdyStreamId stream_id = ReadUint32(data) & 0x7fffffff;
+    const size_t length = frame.size() - kFrameHeaderSize;
+    OnDataReceived(stream_id, length);
+    if (flags & kFlagFin) {
+      OnStreamFinished(stream_id, true);
+    }
+    return WRITE_SUCCESS;
+  }
+
+  const uint16 type = (static_cast<uint16>(data[2]) << 8) | data[3];
+  if (type == kSynReplyType || type == kHeadersType ||
+      type == kRstStreamType) {
+    DCHECK_GE(frame.size(), kFrameHeaderSize + 4);
+    const net::SpdyStreamId stream_id =
+        ReadUint32(data + kFrameHeaderSize) & 0x7fffffff;
+    if (type == kRstStreamType) {
+      OnStreamFinished(stream_id, false);
+    } else if (flags & kFlagFin) {
+      OnStreamFinished(stream_id, true);
+    }
+  }
+  return WRITE_SUCCESS;
+}
+
+void SyntheticClientSessionIO::IssueRequests() {
+  while (num_issued_requests_ < num_requests_ &&
+         static_cast<int>(active_streams_.size() + pending_streams_.size()) <
+         max_concurrent_requests_) {
+    net::SpdyNameValueBlock headers;
+    AddRequestHeaders(spdy_version_, &headers);
+    const net::SpdyStreamId stream_id = next_stream_id_;
+    next_stream_id_ += 2;
+    scoped_ptr<net::SpdySerializedFrame> frame(client_framer_.CreateSynStream(
+        stream_id, 0, client_framer_.GetHighestPriority(), 0,
+        net::CONTROL_FLAG_FIN,
+        true,  // true = use compression
+        &headers));
+    pending_input_.append(frame->data(), frame->size());
+    pending_streams_.push_back(stream_id);
+    ++num_issued_requests_;
+  }
+}
+
+void SyntheticClientSessionIO::AppendWindowUpdate(
+    net::SpdyStreamId stream_id, int32 delta) {
+  scoped_ptr<net::SpdySerializedFrame> frame(
+      client_framer_.CreateWindowUpdate(stream_id, delta));
+  pending_input_.append(frame->data(), frame->size());
+}
+
+void SyntheticClientSessionIO::OnDataReceived(net::SpdyStreamId stream_id,
+                                              size_t length) {
+  data_bytes_received_ += length;
+  // Flow control only exists for SPDY v3 and up.
+  if (spdy_version_ < spdy::SPDY_VERSION_3 || length == 0) {
+    return;
+  }
+  const int32 delta = static_cast<int32>(length);
+  // Only bother with a stream-level update if the stream is still open (it
+  // may have been reset).
+  if (active_streams_.count(stream_id) != 0) {
+    int32* unacked = &unacked_stream_bytes_[stream_id];
+    *unacked += delta;
+    if (*unacked >= kWindowUpdateThreshold) {
+      AppendWindowUpdate(stream_id, *unacked);
+      *unacked = 0;
+    }
+  }
+  if (spdy_version_ >= spdy::SPDY_VERSION_3_1) {
+    unacked_session_bytes_ += delta;
+    if (unacked_session_bytes_ >= kWindowUpdateThreshold) {
+      AppendWindowUpdate(0, unacked_session_bytes_);
+      unacked_session_bytes_ = 0;
+    }
+  }
+}
+
+void SyntheticClientSessionIO::OnStreamFinished(net::SpdyStreamId stream_id,
+                                                bool success) {
+  StreamMap::iterator iter = active_streams_.find(stream_id);
+  if (iter == active_streams_.end()) {
+    // e.g. a RST_STREAM for a stream that had already finished.
+    return;
+  }
+  if (success) {
+    ++num_completed_requests_;
+    latencies_us_.push_back(
+        (base::TimeTicks::Now() - iter->second).InMicroseconds());
+  } else {
+    ++num_failed_requests_;
+  }
+  active_streams_.erase(iter);
+  unacked_stream_bytes_.erase(stream_id);
+  IssueRequests();
+}
+
+}  // namespace testing
+
+}  // namespace mod_spdy
@@ -0,0 +1,117 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MOD_SPDY_COMMON_TESTING_SYNTHETIC_CLIENT_SESSION_IO_H_
+#define MOD_SPDY_COMMON_TESTING_SYNTHETIC_CLIENT_SESSION_IO_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/time/time.h"
+#include "mod_spdy/common/protocol_util.h"
+#include "mod_spdy/common/spdy_session_io.h"
+#include "net/spdy/buffered_spdy_framer.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace mod_spdy {
+
+namespace testing {
+
+// A SpdySessionIO that plays the part of a client, entirely in memory, so
+// that a SpdySession can be driven at full speed without Apache or a network.
+// It issues a fixed number of GET requests, keeping up to a given number of
+// them in flight at once, and returns flow control window to the session as
+// response data arrives (as a browser would).  Once every request has
+// finished, it reports the connection as closed, so that the session's Run()
+// method returns.
+//
+// Frames written by the session are not decompressed or fully parsed; only
+// their fixed-size headers are examined, so that the cost of the simulated
+// client stays small next to the cost of the session being measured.
+//
+// Like the session itself, this must only be used from the session's
+// connection thread.
+class SyntheticClientSessionIO : public SpdySessionIO {
+ public:
+  SyntheticClientSessionIO(spdy::SpdyVersion spdy_version,
+                           int num_requests, int max_concurrent_requests);
+  virtual ~SyntheticClientSessionIO();
+
+  // How many requests received a complete response, and how many were reset
+  // by the server instead?
+  int num_completed_requests() const { return num_completed_requests_; }
+  int num_failed_requests() const { return num_failed_requests_; }
+
+  // How many frames has the server written, and how many DATA payload bytes
+  // did they carry?
+  uint64 num_frames_received() const { return num_frames_received_; }
+  uint64 data_bytes_received() const { return data_bytes_received_; }
+
+  // The time from each completed request being fed to the session until the
+  // last frame of its response was written, in microseconds, in order of
+  // completion.
+  const std::vector<int64>& latencies_us() const { return latencies_us_; }
+
+  // SpdySessionIO methods:
+  virtual bool IsConnectionAborted();
+  virtual ReadStatus ProcessAvailableInput(bool block,
+                                           net::BufferedSpdyFramer* framer);
+  virtual WriteStatus SendFrameRaw(const net::SpdySerializedFrame& frame);
+
+ private:
+  typedef std::map<net::SpdyStreamId, base::TimeTicks> StreamMap;
+  typedef std::map<net::SpdyStreamId, int32> UnackedBytesMap;
+
+  // Queue up SYN_STREAM frames until the concurrency limit is reached or
+  // every request has been issued.
+  void IssueRequests();
+  // Queue up a WINDOW_UPDATE frame.
+  void AppendWindowUpdate(net::SpdyStreamId stream_id, int32 delta);
+  void OnDataReceived(net::SpdyStreamId stream_id, size_t length);
+  void OnStreamFinished(net::SpdyStreamId stream_id, bool success);
+
+  const spdy::SpdyVersion spdy_version_;
+  // Used only to serialize our own frames, with its own header compression
+  // context (just like a real client would have).
+  net::BufferedSpdyFramer client_framer_;
+  const int num_requests_;
+  const int max_concurrent_requests_;
+  int num_issued_requests_;
+  net::SpdyStreamId next_stream_id_;
+  // Serialized frames not yet fed to the session, and the streams whose
+  // SYN_STREAMs are among them.
+  std::string pending_input_;
+  std::vector<net::SpdyStreamId> pending_streams_;
+  // Streams fed to the session and not yet finished, with the time they were
+  // fed.
+  StreamMap active_streams_;
+  // DATA bytes received but not yet returned with a WINDOW_UPDATE.
+  UnackedBytesMap unacked_stream_bytes_;
+  int32 unacked_session_bytes_;
+  int num_completed_requests_;
+  int num_failed_requests_;
+  uint64 num_frames_received_;
+  uint64 data_bytes_received_;
+  std::vector<int64> latencies_us_;
+
+  DISALLOW_COPY_AND_ASSIGN(SyntheticClientSessionIO);
+};
+
+}  // namespace testing
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_TESTING_SYNTHETIC_CLIENT_SESSION_IO_H_
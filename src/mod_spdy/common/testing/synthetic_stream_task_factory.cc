@@ -0,0 +1,166 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/testing/synthetic_stream_task_factory.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_piece.h"
+#include "mod_spdy/common/protocol_util.h"
+#include "mod_spdy/common/spdy_stream.h"
+#include "net/instaweb/util/public/function.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace {
+
+// Send response bodies in DATA frames of this size, as HttpToSpdyConverter
+// would for a response that arrives all at once.
+const size_t kDataFrameSize = 4096;
+
+// Determines whether an input frame ends the client's side of its stream,
+// and how much request body data it carries.
+class FinVisitor : public net::SpdyFrameVisitor {
+ public:
+  FinVisitor() : fin_(false), data_length_(0) {}
+  virtual ~FinVisitor() {}
+
+  bool fin() const { return fin_; }
+  size_t data_length() const { return data_length_; }
+
+  virtual void VisitSynStream(const net::SpdySynStreamIR& frame) {
+    fin_ = frame.fin();
+  }
+  virtual void VisitSynReply(const net::SpdySynReplyIR& frame) {}
+  virtual void VisitRstStream(const net::SpdyRstStreamIR& frame) {}
+  virtual void VisitSettings(const net::SpdySettingsIR& frame) {}
+  virtual void VisitPing(const net::SpdyPingIR& frame) {}
+  virtual void VisitGoAway(const net::SpdyGoAwayIR& frame) {}
+  virtual void VisitHeaders(const net::SpdyHeadersIR& frame) {
+    fin_ = frame.fin();
+  }
+  virtual void VisitWindowUpdate(const net::SpdyWindowUpdateIR& frame) {}
+  virtual void VisitCredential(const net::SpdyCredentialIR& frame) {}
+  virtual void VisitBlocked(const net::SpdyBlockedIR& frame) {}
+  virtual void VisitPushPromise(const net::SpdyPushPromiseIR& frame) {}
+  virtual void VisitData(const net::SpdyDataIR& frame) {
+    fin_ = frame.fin();
+    data_length_ = frame.data().size();
+  }
+
+ private:
+  bool fin_;
+  size_t data_length_;
+
+  DISALLOW_COPY_AND_ASSIGN(FinVisitor);
+};
+
+class SyntheticStreamTask : public net_instaweb::Function {
+ public:
+  // The task does not take ownership of the arguments.
+  SyntheticStreamTask(mod_spdy::SpdyStream* stream, const std::string* body,
+                      size_t body_size);
+  virtual ~SyntheticStreamTask();
+
+ protected:
+  // net_instaweb::Function methods:
+  virtual void Run();
+  virtual void Cancel();
+
+ private:
+  mod_spdy::SpdyStream* const stream_;
+  const std::string* const body_;
+  const size_t body_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(SyntheticStreamTask);
+};
+
+SyntheticStreamTask::SyntheticStreamTask(mod_spdy::SpdyStream* stream,
+                                         const std::string* body,
+                                         size_t body_size)
+    : stream_(stream), body_(body), body_size_(body_size) {
+  DCHECK_LE(body_size_, body_->size());
+}
+
+SyntheticStreamTask::~SyntheticStreamTask() {}
+
+void SyntheticStreamTask::Run() {
+  // Consume (and discard) the whole request, including any body, so that the
+  // stream returns flow control window to the client as a real one would.
+  bool fin = false;
+  while (!fin) {
+    net::SpdyFrameIR* raw_frame = NULL;
+    if (!stream_->GetInputFrame(true, &raw_frame)) {
+      DCHECK(stream_->is_aborted());
+      return;
+    }
+    scoped_ptr<net::SpdyFrameIR> frame(raw_frame);
+    FinVisitor visitor;
+    frame->Visit(&visitor);
+    fin = visitor.fin();
+    if (visitor.data_length() > 0) {
+      stream_->OnInputDataConsumed(visitor.data_length());
+    }
+  }
+
+  const bool spdy2 = stream_->spdy_version() < mod_spdy::spdy::SPDY_VERSION_3;
+  net::SpdyHeaderBlock headers;
+  headers[spdy2 ? mod_spdy::spdy::kSpdy2Status :
+          mod_spdy::spdy::kSpdy3Status] = "200 OK";
+  headers[spdy2 ? mod_spdy::spdy::kSpdy2Version :
+          mod_spdy::spdy::kSpdy3Version] = "HTTP/1.1";
+  headers[mod_spdy::http::kContentType] = "text/plain";
+  headers[mod_spdy::http::kContentLength] = base::Uint64ToString(body_size_);
+  stream_->SendOutputSynReply(headers, body_size_ == 0);
+
+  size_t offset = 0;
+  while (offset < body_size_ && !stream_->is_aborted()) {
+    const size_t length = std::min(kDataFrameSize, body_size_ - offset);
+    offset += length;
+    stream_->SendOutputDataFrame(
+        base::StringPiece(body_->data(), length), offset == body_size_);
+  }
+}
+
+void SyntheticStreamTask::Cancel() {}
+
+}  // namespace
+
+namespace mod_spdy {
+
+namespace testing {
+
+SyntheticStreamTaskFactory::SyntheticStreamTaskFactory(
+    const std::vector<size_t>& sizes)
+    : response_sizes_(sizes) {
+  DCHECK(!response_sizes_.empty());
+  const size_t max_size =
+      *std::max_element(response_sizes_.begin(), response_sizes_.end());
+  body_.assign(max_size, 'x');
+}
+
+SyntheticStreamTaskFactory::~SyntheticStreamTaskFactory() {}
+
+net_instaweb::Function* SyntheticStreamTaskFactory::NewStreamTask(
+    SpdyStream* stream) {
+  // Client stream IDs are odd, so count them as 0, 1, 2, ...
+  const size_t index = (stream->stream_id() / 2) % response_sizes_.size();
+  return new SyntheticStreamTask(stream, &body_, response_sizes_[index]);
+}
+
+}  // namespace testing
+
+}  // namespace mod_spdy
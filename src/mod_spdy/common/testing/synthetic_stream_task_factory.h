@@ -0,0 +1,56 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MOD_SPDY_COMMON_TESTING_SYNTHETIC_STREAM_TASK_FACTORY_H_
+#define MOD_SPDY_COMMON_TESTING_SYNTHETIC_STREAM_TASK_FACTORY_H_
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "mod_spdy/common/spdy_stream_task_factory.h"
+
+namespace net_instaweb { class Function; }
+
+namespace mod_spdy {
+
+class SpdyStream;
+
+namespace testing {
+
+// A SpdyStreamTaskFactory whose tasks answer every request with a canned 200
+// response, without involving Apache, so that the cost of the session itself
+// can be measured.  Response body sizes are taken from the given list in turn
+// (by stream ID), to allow a mix of small and large responses.
+class SyntheticStreamTaskFactory : public SpdyStreamTaskFactory {
+ public:
+  explicit SyntheticStreamTaskFactory(const std::vector<size_t>& sizes);
+  virtual ~SyntheticStreamTaskFactory();
+
+  // SpdyStreamTaskFactory method:
+  virtual net_instaweb::Function* NewStreamTask(SpdyStream* stream);
+
+ private:
+  const std::vector<size_t> response_sizes_;
+  // Response bodies are prefixes of this string.
+  std::string body_;
+
+  DISALLOW_COPY_AND_ASSIGN(SyntheticStreamTaskFactory);
+};
+
+}  // namespace testing
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_TESTING_SYNTHETIC_STREAM_TASK_FACTORY_H_
@@ -0,0 +1,104 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/testing/tool_util.h"
+
+#include <algorithm>
+
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "mod_spdy/common/version.h"
+
+namespace mod_spdy {
+
+namespace testing {
+
+bool GetFlagValue(const std::string& arg, const char* flag,
+                  std::string* value) {
+  const std::string prefix = std::string(flag) + "=";
+  if (!StartsWithASCII(arg, prefix, true)) {
+    return false;
+  }
+  *value = arg.substr(prefix.size());
+  return true;
+}
+
+bool GetIntFlag(const std::string& arg, const char* flag, int min_value,
+                int* number) {
+  std::string value;
+  int parsed = 0;
+  if (!GetFlagValue(arg, flag, &value) ||
+      !base::StringToInt(value, &parsed) || parsed < min_value) {
+    return false;
+  }
+  *number = parsed;
+  return true;
+}
+
+bool ParseSizeList(const std::string& value, std::vector<size_t>* sizes) {
+  std::vector<std::string> pieces;
+  base::SplitString(value, ',', &pieces);
+  std::vector<size_t> parsed;
+  for (size_t i = 0; i < pieces.size(); ++i) {
+    unsigned size = 0;
+    if (!base::StringToUint(pieces[i], &size)) {
+      return false;
+    }
+    parsed.push_back(size);
+  }
+  if (parsed.empty()) {
+    return false;
+  }
+  sizes->swap(parsed);
+  return true;
+}
+
+bool ParseSpdyVersion(const std::string& value, spdy::SpdyVersion* version) {
+  if (value == "2") {
+    *version = spdy::SPDY_VERSION_2;
+  } else if (value == "3") {
+    *version = spdy::SPDY_VERSION_3;
+  } else if (value == "3.1") {
+    *version = spdy::SPDY_VERSION_3_1;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+double PerSecond(int64 count, base::TimeDelta elapsed) {
+  const int64 elapsed_us = std::max<int64>(1, elapsed.InMicroseconds());
+  return static_cast<double>(count) * 1e6 / elapsed_us;
+}
+
+void AppendJsonReportContext(std::string* out) {
+  base::StringAppendF(
+      out,
+      "{\n  \"context\": {\n"
+      "    \"version\": \"%s\",\n"
+      "    \"lastchange\": \"%s\",\n"
+#ifdef NDEBUG
+      "    \"build\": \"release\",\n",
+#else
+      "    \"build\": \"debug\",\n",
+#endif
+      MOD_SPDY_VERSION_STRING, LASTCHANGE_STRING);
+}
+
+}  // namespace testing
+
+}  // namespace mod_spdy
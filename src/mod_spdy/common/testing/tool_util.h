@@ -0,0 +1,61 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MOD_SPDY_COMMON_TESTING_TOOL_UTIL_H_
+#define MOD_SPDY_COMMON_TESTING_TOOL_UTIL_H_
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "mod_spdy/common/protocol_util.h"
+
+namespace base { class TimeDelta; }
+
+namespace mod_spdy {
+
+namespace testing {
+
+// Command-line flag parsing and report formatting shared by the benchmark,
+// load-testing, and monitoring tools.
+
+// If arg is "<flag>=<value>", set *value and return true.
+bool GetFlagValue(const std::string& arg, const char* flag,
+                  std::string* value);
+
+// If arg is "<flag>=<n>" for n >= min_value, set *number and return true.
+bool GetIntFlag(const std::string& arg, const char* flag, int min_value,
+                int* number);
+
+// Parse a comma-separated list of sizes, e.g. "1024,65536".  Returns false
+// (leaving *sizes alone) if the list is empty or malformed.
+bool ParseSizeList(const std::string& value, std::vector<size_t>* sizes);
+
+// Parse a SPDY version number as the tools accept it: "2", "3", or "3.1".
+bool ParseSpdyVersion(const std::string& value, spdy::SpdyVersion* version);
+
+// Return a count over the given time as a rate per second.
+double PerSecond(int64 count, base::TimeDelta elapsed);
+
+// Start a JSON report: append the opening of the report object and of its
+// "context" object, and the context fields that identify the build.  The
+// caller appends its own context fields (indented by four spaces, and
+// preceded by none) and the rest of the report.
+void AppendJsonReportContext(std::string* out);
+
+}  // namespace testing
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_TESTING_TOOL_UTIL_H_
@@ -19,12 +19,15 @@
 #include <vector>
 
 #include "base/basictypes.h"
+#include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
-#include "base/synchronization/condition_variable.h"
 #include "base/synchronization/lock.h"
 #include "base/threading/platform_thread.h"
 #include "base/time/time.h"
 #include "mod_spdy/common/executor.h"
+#include "mod_spdy/common/profiled_lock.h"
+#include "mod_spdy/common/scoreboard.h"
+#include "mod_spdy/common/trace_log.h"
 #include "net/instaweb/util/public/function.h"
 #include "net/spdy/spdy_protocol.h"
 
@@ -55,7 +58,7 @@ class ThreadPool::ThreadPoolExecutor : public Executor {
  private:
   friend class ThreadPool;
   ThreadPool* const master_;
-  base::ConditionVariable stopping_condvar_;
+  ProfiledConditionVariable stopping_condvar_;
   bool stopped_;  // protected by master_->lock_
 
   DISALLOW_COPY_AND_ASSIGN(ThreadPoolExecutor);
@@ -66,7 +69,7 @@ class ThreadPool::ThreadPoolExecutor : public Executor {
 void ThreadPool::ThreadPoolExecutor::AddTask(net_instaweb::Function* task,
                                              net::SpdyPriority priority) {
   {
-    base::AutoLock autolock(master_->lock_);
+    ProfiledAutoLock autolock(master_->lock_);
 
     // Clean up any zombie WorkerThreads in the ThreadPool that are waiting for
     // reaping.  If the OS process we're in accumulates too many unjoined
@@ -77,7 +80,7 @@ void ThreadPool::ThreadPoolExecutor::AddTask(net_instaweb::Function* task,
       zombies.swap(master_->zombies_);
       // Joining these threads should be basically instant, since they've
       // already terminated.  But to be safe, let's unlock while we join them.
-      base::AutoUnlock autounlock(master_->lock_);
+      ProfiledAutoUnlock autounlock(master_->lock_);
       ThreadPool::JoinThreads(zombies);
     }
 
@@ -92,6 +95,7 @@ void ThreadPool::ThreadPoolExecutor::AddTask(net_instaweb::Function* task,
       master_->task_queue_.insert(std::make_pair(priority, Task(task, this)));
       master_->worker_condvar_.Signal();
       master_->StartNewWorkerIfNeeded();
+      master_->UpdateScoreboard();
       return;
     }
   }
@@ -107,7 +111,7 @@ void ThreadPool::ThreadPoolExecutor::AddTask(net_instaweb::Function* task,
 void ThreadPool::ThreadPoolExecutor::Stop() {
   std::vector<net_instaweb::Function*> functions_to_cancel;
   {
-    base::AutoLock autolock(master_->lock_);
+    ProfiledAutoLock autolock(master_->lock_);
     if (stopped_) {
       return;
     }
@@ -125,6 +129,7 @@ void ThreadPool::ThreadPoolExecutor::Stop() {
         master_->task_queue_.erase(iter);
       }
     }
+    master_->UpdateScoreboard();
   }
 
   // Unlock while we cancel the functions, so we're not hogging the lock for
@@ -142,7 +147,7 @@ void ThreadPool::ThreadPoolExecutor::Stop() {
 
   // Block until all our active tasks are completed.
   {
-    base::AutoLock autolock(master_->lock_);
+    ProfiledAutoLock autolock(master_->lock_);
     while (master_->active_task_counts_.count(this) > 0) {
       stopping_condvar_.Wait();
     }
@@ -212,10 +217,13 @@ void ThreadPool::WorkerThread::Join() {
 // This is the code executed by the thread; when this method returns, the
 // thread will terminate.
 void ThreadPool::WorkerThread::ThreadMain() {
+  if (TraceLog::Instance() != NULL) {
+    TraceLog::Instance()->SetCurrentThreadName("ThreadPool worker");
+  }
   // We start by grabbing the master lock, but we release it below whenever we
   // are 1) waiting for a new task or 2) executing a task.  So in fact most of
   // the time we are not holding the lock.
-  base::AutoLock autolock(master_->lock_);
+  ProfiledAutoLock autolock(master_->lock_);
   while (true) {
     // Wait until there's a task available (or we're shutting down), but don't
     // stay idle for more than kMaxWorkerIdleSeconds seconds.
@@ -261,7 +269,8 @@ void ThreadPool::WorkerThread::ThreadMain() {
     // below code, so that we don't have to release and reacquire the lock at
     // the edge of the while-loop.
     {
-      base::AutoUnlock autounlock(master_->lock_);
+      ProfiledAutoUnlock autounlock(master_->lock_);
+      MOD_SPDY_TRACE_EVENT0("thread_pool", "RunTask");
       task.function->CallRun();
     }
     // Inform the master we have completed the task and are no longer busy.
@@ -274,6 +283,7 @@ ThreadPool::ThreadPool(int min_threads, int max_threads)
       max_threads_(max_threads),
       max_thread_idle_time_(
           base::TimeDelta::FromSeconds(kDefaultMaxWorkerIdleSeconds)),
+      lock_("ThreadPool::lock_"),
       worker_condvar_(&lock_),
       num_busy_workers_(0),
       shutting_down_(false) {
@@ -290,6 +300,7 @@ ThreadPool::ThreadPool(int min_threads, int max_threads,
     : min_threads_(min_threads),
       max_threads_(max_threads),
       max_thread_idle_time_(max_thread_idle_time),
+      lock_("ThreadPool::lock_"),
       worker_condvar_(&lock_),
       num_busy_workers_(0),
       shutting_down_(false) {
@@ -300,7 +311,7 @@ ThreadPool::ThreadPool(int min_threads, int max_threads,
 }
 
 ThreadPool::~ThreadPool() {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
 
   // If we're doing things right, all the Executors should have been
   // destroyed before the ThreadPool is destroyed, so there should be no
@@ -318,7 +329,7 @@ ThreadPool::~ThreadPool() {
   threads.insert(workers_.begin(), workers_.end());
   workers_.clear();
   {
-    base::AutoUnlock autounlock(lock_);
+    ProfiledAutoUnlock autounlock(lock_);
     JoinThreads(threads);
   }
 
@@ -332,7 +343,7 @@ ThreadPool::~ThreadPool() {
 }
 
 bool ThreadPool::Start() {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   DCHECK(task_queue_.empty());
   DCHECK(workers_.empty());
   // Start up min_threads_ workers; if any of the worker threads fail to start,
@@ -345,6 +356,7 @@ bool ThreadPool::Start() {
     workers_.insert(worker.release());
   }
   DCHECK_EQ(min_threads_, workers_.size());
+  UpdateScoreboard();
   return true;
 }
 
@@ -353,19 +365,19 @@ Executor* ThreadPool::NewExecutor() {
 }
 
 int ThreadPool::GetNumWorkersForTest() {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   return workers_.size();
 }
 
 int ThreadPool::GetNumIdleWorkersForTest() {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   DCHECK_GE(num_busy_workers_, 0u);
   DCHECK_LE(num_busy_workers_, workers_.size());
   return workers_.size() - num_busy_workers_;
 }
 
 int ThreadPool::GetNumZombiesForTest() {
-  base::AutoLock autolock(lock_);
+  ProfiledAutoLock autolock(lock_);
   return zombies_.size();
 }
 
@@ -434,6 +446,7 @@ bool ThreadPool::TryZombifyIdleThread(WorkerThread* thread) {
   DCHECK(!shutting_down_);
   DCHECK_EQ(0u, zombies_.count(thread));
   zombies_.insert(thread);
+  UpdateScoreboard();
   return true;
 }
 
@@ -458,6 +471,7 @@ ThreadPool::Task ThreadPool::GetNextTask() {
   // The worker that takes this task will be busy until it completes it.
   DCHECK_LT(num_busy_workers_, workers_.size());
   ++num_busy_workers_;
+  UpdateScoreboard();
 
   return task;
 }
@@ -485,6 +499,14 @@ void ThreadPool::OnTaskComplete(Task task) {
     active_task_counts_.erase(count_iter);
     task.owner->stopping_condvar_.Broadcast();
   }
+  UpdateScoreboard();
+}
+
+void ThreadPool::UpdateScoreboard() {
+  lock_.AssertAcquired();
+  Scoreboard::SetIfEnabled(Scoreboard::THREADS, workers_.size());
+  Scoreboard::SetIfEnabled(Scoreboard::THREADS_BUSY, num_busy_workers_);
+  Scoreboard::SetIfEnabled(Scoreboard::TASKS_QUEUED, task_queue_.size());
 }
 
 }  // namespace mod_spdy
@@ -19,9 +19,8 @@
 #include <set>
 
 #include "base/basictypes.h"
-#include "base/synchronization/condition_variable.h"
-#include "base/synchronization/lock.h"
 #include "base/time/time.h"
+#include "mod_spdy/common/profiled_lock.h"
 #include "net/spdy/spdy_protocol.h"  // for net::SpdyPriority
 
 namespace net_instaweb { class Function; }
@@ -105,6 +104,10 @@ class ThreadPool {
   Task GetNextTask();
   void OnTaskComplete(Task task);
 
+  // Report the current numbers of workers and queued tasks to the Scoreboard
+  // (if enabled).  Must be holding lock_ when calling this.
+  void UpdateScoreboard();
+
   // The min and max number of threads passed to the constructor.  Although the
   // constructor takes signed ints (for convenience), we store these unsigned
   // to avoid the need for static_casts when comparing against workers_.size().
@@ -114,10 +117,10 @@ class ThreadPool {
   // This single master lock protects all of the below fields, as well as any
   // mutable data and condition variables in the worker threads and executors.
   // Having just one lock makes everything much easier to understand.
-  base::Lock lock_;
+  ProfiledLock lock_;
   // Workers wait on this condvar when waiting for a new task.  We signal it
   // when a new task becomes available, or when we need to shut down.
-  base::ConditionVariable worker_condvar_;
+  ProfiledConditionVariable worker_condvar_;
   // The list of running worker threads.  We keep this around so that we can
   // join the threads on shutdown.
   std::set<WorkerThread*> workers_;
@@ -0,0 +1,118 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/thread_pool.h"
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/stl_util.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "mod_spdy/common/executor.h"
+#include "mod_spdy/common/testing/benchmark.h"
+#include "net/instaweb/util/public/function.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace {
+
+// Counts down as tasks complete, so that the benchmark can wait for all of
+// them to finish.
+class Countdown {
+ public:
+  explicit Countdown(int64 count) : condvar_(&lock_), count_(count) {}
+
+  void Decrement() {
+    base::AutoLock autolock(lock_);
+    if (--count_ == 0) {
+      condvar_.Signal();
+    }
+  }
+
+  void Wait() {
+    base::AutoLock autolock(lock_);
+    while (count_ > 0) {
+      condvar_.Wait();
+    }
+  }
+
+ private:
+  base::Lock lock_;
+  base::ConditionVariable condvar_;
+  int64 count_;
+
+  DISALLOW_COPY_AND_ASSIGN(Countdown);
+};
+
+// A trivial task, so that we measure the thread pool's own overhead.
+class CountdownTask : public net_instaweb::Function {
+ public:
+  explicit CountdownTask(Countdown* countdown) : countdown_(countdown) {}
+  virtual ~CountdownTask() {}
+
+ protected:
+  // net_instaweb::Function methods:
+  virtual void Run() { countdown_->Decrement(); }
+  virtual void Cancel() { countdown_->Decrement(); }
+
+ private:
+  Countdown* const countdown_;
+
+  DISALLOW_COPY_AND_ASSIGN(CountdownTask);
+};
+
+// Each iteration is one task posted to (and run by) a pool of the given
+// number of threads, across the given number of executors (i.e. sessions).
+void RunTasks(mod_spdy::testing::BenchmarkState* state, int num_threads,
+              int num_executors) {
+  state->PauseTiming();
+  scoped_ptr<mod_spdy::ThreadPool> thread_pool(
+      new mod_spdy::ThreadPool(num_threads, num_threads));
+  CHECK(thread_pool->Start());
+  std::vector<mod_spdy::Executor*> executors;
+  for (int i = 0; i < num_executors; ++i) {
+    executors.push_back(thread_pool->NewExecutor());
+  }
+  Countdown countdown(state->iterations());
+  state->ResumeTiming();
+
+  for (int64 i = 0; i < state->iterations(); ++i) {
+    executors[i % num_executors]->AddTask(
+        new CountdownTask(&countdown), static_cast<net::SpdyPriority>(i % 8));
+  }
+  countdown.Wait();
+
+  // Don't count the time taken to shut the threads down.
+  state->PauseTiming();
+  STLDeleteElements(&executors);
+  thread_pool.reset();
+  state->ResumeTiming();
+  state->SetItemsProcessed(state->iterations());
+}
+
+MOD_SPDY_BENCHMARK(BM_ThreadPool_1Thread) {
+  RunTasks(state, 1, 1);
+}
+
+MOD_SPDY_BENCHMARK(BM_ThreadPool_4Threads) {
+  RunTasks(state, 4, 1);
+}
+
+MOD_SPDY_BENCHMARK(BM_ThreadPool_4Threads8Executors) {
+  RunTasks(state, 4, 8);
+}
+
+}  // namespace
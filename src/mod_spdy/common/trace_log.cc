@@ -0,0 +1,225 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/trace_log.h"
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/logging.h"
+#include "base/process/process_handle.h"
+#include "base/stl_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+
+namespace mod_spdy {
+
+namespace {
+
+struct TraceEvent {
+  int64 timestamp_us;
+  const char* category;
+  const char* name;
+  const char* arg_name;  // NULL if the event has no argument
+  int64 arg_value;
+  char phase;
+};
+
+}  // namespace
+
+// The ring buffer of events for one thread.  The buffer's lock is only ever
+// contended while the log is being dumped.
+class TraceLog::ThreadBuffer {
+ public:
+  explicit ThreadBuffer(size_t capacity)
+      : events_(capacity), next_(0), wrapped_(false), thread_id_(0),
+        thread_name_(NULL) {}
+
+  // Give the buffer to a new thread, discarding the previous owner's events.
+  void Reset(base::PlatformThreadId thread_id) {
+    base::AutoLock autolock(lock_);
+    next_ = 0;
+    wrapped_ = false;
+    thread_id_ = thread_id;
+    thread_name_ = NULL;
+  }
+
+  void Clear() {
+    base::AutoLock autolock(lock_);
+    next_ = 0;
+    wrapped_ = false;
+  }
+
+  void Add(const TraceEvent& event) {
+    base::AutoLock autolock(lock_);
+    events_[next_] = event;
+    if (++next_ == events_.size()) {
+      next_ = 0;
+      wrapped_ = true;
+    }
+  }
+
+  void SetThreadName(const char* name) {
+    base::AutoLock autolock(lock_);
+    thread_name_ = name;
+  }
+
+  // Append the events, oldest first, as comma-separated JSON objects; set
+  // *first to false if anything was appended.
+  void AppendJson(base::ProcessId process_id, bool* first, std::string* out) {
+    base::AutoLock autolock(lock_);
+    if (!wrapped_ && next_ == 0) {
+      return;
+    }
+    if (thread_name_ != NULL) {
+      base::StringAppendF(
+          out, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+          "\"tid\":%d,\"args\":{\"name\":\"%s\"}}", (*first ? "" : ","),
+          static_cast<int>(process_id), static_cast<int>(thread_id_),
+          thread_name_);
+      *first = false;
+    }
+    const size_t count = wrapped_ ? events_.size() : next_;
+    const size_t start = wrapped_ ? next_ : 0;
+    for (size_t i = 0; i < count; ++i) {
+      const TraceEvent& event = events_[(start + i) % events_.size()];
+      base::StringAppendF(
+          out, "%s\n{\"cat\":\"%s\",\"name\":\"%s\",\"ph\":\"%c\","
+          "\"ts\":%lld,\"pid\":%d,\"tid\":%d", (*first ? "" : ","),
+          event.category, event.name, event.phase,
+          static_cast<long long>(event.timestamp_us),
+          static_cast<int>(process_id), static_cast<int>(thread_id_));
+      *first = false;
+      if (event.phase == 'i') {
+        // Instant events are scoped to their thread.
+        out->append(",\"s\":\"t\"");
+      }
+      if (event.arg_name != NULL) {
+        base::StringAppendF(out, ",\"args\":{\"%s\":%lld}", event.arg_name,
+                            static_cast<long long>(event.arg_value));
+      }
+      out->append("}");
+    }
+  }
+
+ private:
+  base::Lock lock_;
+  std::vector<TraceEvent> events_;
+  size_t next_;
+  bool wrapped_;
+  base::PlatformThreadId thread_id_;
+  const char* thread_name_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadBuffer);
+};
+
+const size_t TraceLog::kDefaultEventsPerThread = 4096;
+
+TraceLog* TraceLog::g_instance = NULL;
+
+void TraceLog::CreateInstance(size_t events_per_thread) {
+  DCHECK(g_instance == NULL);
+  g_instance = new TraceLog(events_per_thread);
+}
+
+void TraceLog::DestroyInstance() {
+  DCHECK(g_instance != NULL);
+  TraceLog* instance = g_instance;
+  g_instance = NULL;
+  delete instance;
+}
+
+TraceLog::TraceLog(size_t events_per_thread)
+    : events_per_thread_(events_per_thread),
+      thread_buffer_slot_(&TraceLog::OnThreadExit) {
+  DCHECK_GT(events_per_thread_, 0u);
+}
+
+TraceLog::~TraceLog() {
+  thread_buffer_slot_.Free();
+  STLDeleteElements(&buffers_);
+}
+
+void TraceLog::AddEvent(char phase, const char* category, const char* name,
+                        const char* arg_name, int64 arg_value) {
+  TraceEvent event;
+  event.timestamp_us = (base::TimeTicks::Now() - base::TimeTicks())
+      .InMicroseconds();
+  event.category = category;
+  event.name = name;
+  event.arg_name = arg_name;
+  event.arg_value = arg_value;
+  event.phase = phase;
+  GetCurrentThreadBuffer()->Add(event);
+}
+
+void TraceLog::SetCurrentThreadName(const char* name) {
+  GetCurrentThreadBuffer()->SetThreadName(name);
+}
+
+std::string TraceLog::GetTraceJson() {
+  const base::ProcessId process_id = base::GetCurrentProcId();
+  std::string out("{\"traceEvents\":[");
+  bool first = true;
+  {
+    base::AutoLock autolock(lock_);
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+      buffers_[i]->AppendJson(process_id, &first, &out);
+    }
+  }
+  out.append("\n],\"displayTimeUnit\":\"ms\"}\n");
+  return out;
+}
+
+void TraceLog::Clear() {
+  base::AutoLock autolock(lock_);
+  for (size_t i = 0; i < buffers_.size(); ++i) {
+    buffers_[i]->Clear();
+  }
+}
+
+TraceLog::ThreadBuffer* TraceLog::GetCurrentThreadBuffer() {
+  ThreadBuffer* buffer = static_cast<ThreadBuffer*>(thread_buffer_slot_.Get());
+  if (buffer != NULL) {
+    return buffer;
+  }
+  {
+    base::AutoLock autolock(lock_);
+    if (free_buffers_.empty()) {
+      buffer = new ThreadBuffer(events_per_thread_);
+      buffers_.push_back(buffer);
+    } else {
+      buffer = free_buffers_.back();
+      free_buffers_.pop_back();
+    }
+  }
+  buffer->Reset(base::PlatformThread::CurrentId());
+  thread_buffer_slot_.Set(buffer);
+  return buffer;
+}
+
+// static
+void TraceLog::OnThreadExit(void* buffer) {
+  TraceLog* instance = g_instance;
+  if (instance == NULL || buffer == NULL) {
+    return;
+  }
+  base::AutoLock autolock(instance->lock_);
+  instance->free_buffers_.push_back(static_cast<ThreadBuffer*>(buffer));
+}
+
+}  // namespace mod_spdy
@@ -0,0 +1,159 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MOD_SPDY_COMMON_TRACE_LOG_H_
+#define MOD_SPDY_COMMON_TRACE_LOG_H_
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/thread_local_storage.h"
+
+namespace mod_spdy {
+
+// A low-overhead, per-process record of what the connection and stream
+// threads have been doing recently, for diagnosing scheduling problems (e.g.
+// streams stalled on flow control windows, or workers starved by a busy
+// thread pool).  Each thread records events into its own fixed-size ring
+// buffer, so only the most recent events are kept; the whole log can be
+// dumped at any time in the Chrome trace event format, which can be loaded
+// into chrome://tracing to see the threads on a common timeline.
+//
+// Tracing is off unless CreateInstance() has been called; when it's off, each
+// trace point costs only a check of a global pointer.  Use the
+// MOD_SPDY_TRACE_* macros below rather than calling AddEvent() directly.
+// This class is thread-safe.
+class TraceLog {
+ public:
+  // The number of events kept per thread, unless otherwise specified.
+  static const size_t kDefaultEventsPerThread;
+
+  // Returns the one and only instance of the TraceLog, or NULL if tracing is
+  // disabled.
+  static TraceLog* Instance() { return g_instance; }
+
+  // Call this before threading starts to enable tracing.
+  static void CreateInstance(size_t events_per_thread);
+
+  // Disable tracing and delete the log.  This must not be called while any
+  // other thread might be recording events; it's mainly for tests.
+  static void DestroyInstance();
+
+  // Record an event on the calling thread.  The category, name, and arg_name
+  // must be string literals (or otherwise outlive the TraceLog), and must not
+  // need escaping for JSON.  arg_name may be NULL if the event has no
+  // argument.
+  void AddEvent(char phase, const char* category, const char* name,
+                const char* arg_name, int64 arg_value);
+
+  // Label the calling thread in the dumped trace.  The name must be a string
+  // literal.
+  void SetCurrentThreadName(const char* name);
+
+  // Return the recorded events, as a JSON object in the Chrome trace event
+  // format.
+  std::string GetTraceJson();
+
+  // Discard all recorded events.
+  void Clear();
+
+ private:
+  class ThreadBuffer;
+
+  explicit TraceLog(size_t events_per_thread);
+  ~TraceLog();
+
+  ThreadBuffer* GetCurrentThreadBuffer();
+  static void OnThreadExit(void* buffer);
+
+  static TraceLog* g_instance;
+
+  const size_t events_per_thread_;
+  base::ThreadLocalStorage::Slot thread_buffer_slot_;
+  base::Lock lock_;
+  // All buffers ever created, including those of threads that have exited.
+  // A thread that exits leaves its buffer on the free list, with its events
+  // intact, until a new thread takes it over.  This keeps memory use bounded
+  // by the peak number of threads, even as thread pool workers come and go.
+  std::vector<ThreadBuffer*> buffers_;
+  std::vector<ThreadBuffer*> free_buffers_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceLog);
+};
+
+// Records a begin event when constructed, and a matching end event when
+// destroyed, if tracing was enabled at construction.  Use the
+// MOD_SPDY_TRACE_EVENT* macros rather than using this class directly.
+class ScopedTraceEvent {
+ public:
+  ScopedTraceEvent(const char* category, const char* name,
+                   const char* arg_name, int64 arg_value)
+      : trace_log_(TraceLog::Instance()), category_(category), name_(name) {
+    if (trace_log_ != NULL) {
+      trace_log_->AddEvent('B', category_, name_, arg_name, arg_value);
+    }
+  }
+  ~ScopedTraceEvent() {
+    if (trace_log_ != NULL) {
+      trace_log_->AddEvent('E', category_, name_, NULL, 0);
+    }
+  }
+
+ private:
+  TraceLog* const trace_log_;
+  const char* const category_;
+  const char* const name_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedTraceEvent);
+};
+
+#define MOD_SPDY_TRACE_CONCAT_(a, b) a##b
+#define MOD_SPDY_TRACE_CONCAT(a, b) MOD_SPDY_TRACE_CONCAT_(a, b)
+
+// Trace the rest of the enclosing scope as a single slice, e.g.:
+//
+//   MOD_SPDY_TRACE_EVENT1("stream", "WaitForWindow", "stream_id", stream_id_);
+#define MOD_SPDY_TRACE_EVENT0(category, name)                          \
+  ::mod_spdy::ScopedTraceEvent MOD_SPDY_TRACE_CONCAT(trace_event_,     \
+                                                     __LINE__)(        \
+      category, name, NULL, 0)
+#define MOD_SPDY_TRACE_EVENT1(category, name, arg_name, arg_value)     \
+  ::mod_spdy::ScopedTraceEvent MOD_SPDY_TRACE_CONCAT(trace_event_,     \
+                                                     __LINE__)(        \
+      category, name, arg_name, arg_value)
+
+// Trace a point in time.
+#define MOD_SPDY_TRACE_INSTANT1(category, name, arg_name, arg_value)   \
+  do {                                                                 \
+    ::mod_spdy::TraceLog* trace_log = ::mod_spdy::TraceLog::Instance(); \
+    if (trace_log != NULL) {                                           \
+      trace_log->AddEvent('i', category, name, arg_name, arg_value);   \
+    }                                                                  \
+  } while (false)
+
+// Trace the current value of a counter (e.g. a queue length), which is
+// plotted as a graph.
+#define MOD_SPDY_TRACE_COUNTER1(category, name, value)                 \
+  do {                                                                 \
+    ::mod_spdy::TraceLog* trace_log = ::mod_spdy::TraceLog::Instance(); \
+    if (trace_log != NULL) {                                           \
+      trace_log->AddEvent('C', category, name, "value", value);        \
+    }                                                                  \
+  } while (false)
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_TRACE_LOG_H_
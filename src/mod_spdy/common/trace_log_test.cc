@@ -0,0 +1,143 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mod_spdy/common/trace_log.h"
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/threading/platform_thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// Count the non-overlapping occurrences of needle in haystack.
+int CountOccurrences(const std::string& haystack, const std::string& needle) {
+  int count = 0;
+  for (size_t pos = haystack.find(needle); pos != std::string::npos;
+       pos = haystack.find(needle, pos + needle.size())) {
+    ++count;
+  }
+  return count;
+}
+
+class RecordingThread : public base::PlatformThread::Delegate {
+ public:
+  explicit RecordingThread(const char* name) : name_(name) {}
+  virtual ~RecordingThread() {}
+
+  virtual void ThreadMain() {
+    mod_spdy::TraceLog::Instance()->SetCurrentThreadName(name_);
+    MOD_SPDY_TRACE_EVENT0("test", "ThreadWork");
+  }
+
+  void RunAndJoin() {
+    base::PlatformThreadHandle handle;
+    ASSERT_TRUE(base::PlatformThread::Create(0, this, &handle));
+    base::PlatformThread::Join(handle);
+  }
+
+ private:
+  const char* const name_;
+
+  DISALLOW_COPY_AND_ASSIGN(RecordingThread);
+};
+
+class TraceLogTest : public testing::Test {
+ protected:
+  virtual void TearDown() {
+    if (mod_spdy::TraceLog::Instance() != NULL) {
+      mod_spdy::TraceLog::DestroyInstance();
+    }
+  }
+};
+
+TEST_F(TraceLogTest, DisabledByDefault) {
+  ASSERT_TRUE(mod_spdy::TraceLog::Instance() == NULL);
+  // These should be no-ops.
+  MOD_SPDY_TRACE_EVENT0("test", "Scoped");
+  MOD_SPDY_TRACE_INSTANT1("test", "Instant", "arg", 1);
+  MOD_SPDY_TRACE_COUNTER1("test", "Counter", 2);
+}
+
+TEST_F(TraceLogTest, RecordsEvents) {
+  mod_spdy::TraceLog::CreateInstance(16);
+  {
+    MOD_SPDY_TRACE_EVENT1("test", "Scoped", "stream_id", 3);
+    MOD_SPDY_TRACE_INSTANT1("test", "Instant", "priority", 2);
+    MOD_SPDY_TRACE_COUNTER1("test", "Counter", 7);
+  }
+  const std::string json = mod_spdy::TraceLog::Instance()->GetTraceJson();
+  EXPECT_EQ(0u, json.find("{\"traceEvents\":["));
+  EXPECT_NE(std::string::npos, json.find(
+      "\"cat\":\"test\",\"name\":\"Scoped\",\"ph\":\"B\""));
+  EXPECT_NE(std::string::npos, json.find("\"args\":{\"stream_id\":3}"));
+  EXPECT_NE(std::string::npos, json.find(
+      "\"name\":\"Instant\",\"ph\":\"i\""));
+  EXPECT_NE(std::string::npos, json.find("\"s\":\"t\""));
+  EXPECT_NE(std::string::npos, json.find("\"args\":{\"value\":7}"));
+  EXPECT_NE(std::string::npos, json.find(
+      "\"name\":\"Scoped\",\"ph\":\"E\""));
+  // The end event should come after everything else.
+  EXPECT_LT(json.find("\"name\":\"Counter\""),
+            json.find("\"name\":\"Scoped\",\"ph\":\"E\""));
+}
+
+TEST_F(TraceLogTest, KeepsOnlyNewestEvents) {
+  mod_spdy::TraceLog::CreateInstance(4);
+  for (int i = 0; i < 10; ++i) {
+    MOD_SPDY_TRACE_INSTANT1("test", "Instant", "i", i);
+  }
+  const std::string json = mod_spdy::TraceLog::Instance()->GetTraceJson();
+  EXPECT_EQ(4, CountOccurrences(json, "\"name\":\"Instant\""));
+  EXPECT_EQ(std::string::npos, json.find("{\"i\":5}"));
+  EXPECT_LT(json.find("{\"i\":6}"), json.find("{\"i\":7}"));
+  EXPECT_LT(json.find("{\"i\":8}"), json.find("{\"i\":9}"));
+}
+
+TEST_F(TraceLogTest, Clear) {
+  mod_spdy::TraceLog::CreateInstance(4);
+  MOD_SPDY_TRACE_INSTANT1("test", "Before", "i", 1);
+  mod_spdy::TraceLog::Instance()->Clear();
+  MOD_SPDY_TRACE_INSTANT1("test", "After", "i", 2);
+  const std::string json = mod_spdy::TraceLog::Instance()->GetTraceJson();
+  EXPECT_EQ(std::string::npos, json.find("\"Before\""));
+  EXPECT_NE(std::string::npos, json.find("\"After\""));
+}
+
+// Each thread gets its own buffer, and a thread that has exited keeps its
+// events until a new thread takes over its buffer.
+TEST_F(TraceLogTest, ThreadBuffers) {
+  mod_spdy::TraceLog::CreateInstance(16);
+  MOD_SPDY_TRACE_INSTANT1("test", "MainThread", "i", 1);
+
+  RecordingThread first("first");
+  first.RunAndJoin();
+  std::string json = mod_spdy::TraceLog::Instance()->GetTraceJson();
+  EXPECT_NE(std::string::npos, json.find("\"MainThread\""));
+  EXPECT_NE(std::string::npos, json.find(
+      "\"name\":\"thread_name\",\"ph\":\"M\""));
+  EXPECT_NE(std::string::npos, json.find("{\"name\":\"first\"}"));
+  EXPECT_EQ(2, CountOccurrences(json, "\"name\":\"ThreadWork\""));
+
+  RecordingThread second("second");
+  second.RunAndJoin();
+  json = mod_spdy::TraceLog::Instance()->GetTraceJson();
+  EXPECT_NE(std::string::npos, json.find("\"MainThread\""));
+  EXPECT_EQ(std::string::npos, json.find("{\"name\":\"first\"}"));
+  EXPECT_NE(std::string::npos, json.find("{\"name\":\"second\"}"));
+  EXPECT_EQ(2, CountOccurrences(json, "\"name\":\"ThreadWork\""));
+}
+
+}  // namespace
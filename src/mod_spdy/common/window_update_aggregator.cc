@@ -0,0 +1,82 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mod_spdy/common/window_update_aggregator.h"
+
+#include <map>
+
+#include "base/logging.h"
+#include "mod_spdy/common/spdy_frame_priority_queue.h"
+#include "mod_spdy/common/trace_log.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace mod_spdy {
+
+WindowUpdateAggregator::WindowUpdateAggregator(
+    SpdyFramePriorityQueue* output_queue)
+    : output_queue_(output_queue),
+      lock_("WindowUpdateAggregator::lock_") {
+  DCHECK(output_queue_);
+}
+
+WindowUpdateAggregator::~WindowUpdateAggregator() {}
+
+void WindowUpdateAggregator::AddUpdate(net::SpdyStreamId stream_id,
+                                       int32 delta, bool urgent) {
+  DCHECK_GT(delta, 0);
+  ProfiledAutoLock autolock(lock_);
+  int32& pending = pending_[stream_id];
+  // The pending total can't exceed the window size, since nobody grants the
+  // client more window than it had used.
+  DCHECK_LE(static_cast<int64>(pending) + delta,
+            static_cast<int64>(net::kSpdyMaximumWindowSize));
+  pending += delta;
+  if (urgent) {
+    InternalFlush();
+  }
+}
+
+void WindowUpdateAggregator::DropStream(net::SpdyStreamId stream_id) {
+  DCHECK_NE(0u, stream_id);
+  ProfiledAutoLock autolock(lock_);
+  pending_.erase(stream_id);
+}
+
+bool WindowUpdateAggregator::HasPendingUpdates() const {
+  ProfiledAutoLock autolock(lock_);
+  return !pending_.empty();
+}
+
+size_t WindowUpdateAggregator::Flush() {
+  ProfiledAutoLock autolock(lock_);
+  return InternalFlush();
+}
+
+size_t WindowUpdateAggregator::InternalFlush() {
+  lock_.AssertAcquired();
+  const size_t count = pending_.size();
+  if (count == 0) {
+    return 0;
+  }
+  MOD_SPDY_TRACE_INSTANT1("session", "FlushWindowUpdates", "frames", count);
+  for (UpdateMap::const_iterator iter = pending_.begin();
+       iter != pending_.end(); ++iter) {
+    output_queue_->Insert(SpdyFramePriorityQueue::kTopPriority,
+                          new net::SpdyWindowUpdateIR(iter->first,
+                                                      iter->second));
+  }
+  pending_.clear();
+  return count;
+}
+
+}  // namespace mod_spdy
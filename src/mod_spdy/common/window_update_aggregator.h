@@ -0,0 +1,74 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MOD_SPDY_COMMON_WINDOW_UPDATE_AGGREGATOR_H_
+#define MOD_SPDY_COMMON_WINDOW_UPDATE_AGGREGATOR_H_
+
+#include <map>
+
+#include "base/basictypes.h"
+#include "mod_spdy/common/profiled_lock.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace mod_spdy {
+
+class SpdyFramePriorityQueue;
+
+// Collects the WINDOW_UPDATE frames that a session's stream threads want to
+// send (for their own streams, and for the session window as stream 0), and
+// merges the updates for each stream, so that a client uploading on many
+// streams at once isn't sent a stream of tiny control frames.  The connection
+// thread calls Flush() before each batch of output, which puts all the pending
+// updates into the output queue together.  An update that the client needs
+// soon -- because its window is nearly used up -- is marked urgent, which
+// flushes everything at once rather than waiting for the connection thread.
+// This class is thread-safe.
+class WindowUpdateAggregator {
+ public:
+  // The aggregator does not take ownership of the queue.
+  explicit WindowUpdateAggregator(SpdyFramePriorityQueue* output_queue);
+  ~WindowUpdateAggregator();
+
+  // Add to the pending WINDOW_UPDATE for the given stream (0 for the session
+  // window).  The delta must be positive.  If urgent is true, flush all
+  // pending updates right away.
+  void AddUpdate(net::SpdyStreamId stream_id, int32 delta, bool urgent);
+
+  // Discard any pending update for a stream that has closed; the client
+  // would just ignore it.
+  void DropStream(net::SpdyStreamId stream_id);
+
+  // Return true if there are updates waiting for Flush().
+  bool HasPendingUpdates() const;
+
+  // Insert a WINDOW_UPDATE frame into the output queue, at top priority, for
+  // each stream with a pending update (the session window first).  Returns
+  // the number of frames inserted.
+  size_t Flush();
+
+ private:
+  typedef std::map<net::SpdyStreamId, int32> UpdateMap;
+
+  // Same as Flush(), but requires lock_ to be held.
+  size_t InternalFlush();
+
+  SpdyFramePriorityQueue* const output_queue_;
+  mutable ProfiledLock lock_;
+  UpdateMap pending_;  // ordered by stream ID, so stream 0 comes first
+
+  DISALLOW_COPY_AND_ASSIGN(WindowUpdateAggregator);
+};
+
+}  // namespace mod_spdy
+
+#endif  // MOD_SPDY_COMMON_WINDOW_UPDATE_AGGREGATOR_H_
@@ -0,0 +1,79 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mod_spdy/common/window_update_aggregator.h"
+
+#include "base/memory/scoped_ptr.h"
+#include "mod_spdy/common/spdy_frame_priority_queue.h"
+#include "mod_spdy/common/testing/spdy_frame_matchers.h"
+#include "net/spdy/spdy_protocol.h"
+#include "testing/gmock/include/gmock/gmock.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+void ExpectWindowUpdate(mod_spdy::SpdyFramePriorityQueue* queue,
+                        net::SpdyStreamId stream_id, uint32 delta) {
+  net::SpdyFrameIR* raw_frame = NULL;
+  ASSERT_TRUE(queue->Pop(&raw_frame));
+  scoped_ptr<net::SpdyFrameIR> frame(raw_frame);
+  EXPECT_THAT(*frame, mod_spdy::testing::IsWindowUpdate(stream_id, delta));
+}
+
+TEST(WindowUpdateAggregatorTest, MergesUpdatesUntilFlush) {
+  mod_spdy::SpdyFramePriorityQueue queue;
+  mod_spdy::WindowUpdateAggregator aggregator(&queue);
+  EXPECT_FALSE(aggregator.HasPendingUpdates());
+  EXPECT_EQ(0u, aggregator.Flush());
+
+  aggregator.AddUpdate(3, 1000, false);
+  aggregator.AddUpdate(0, 4000, false);
+  aggregator.AddUpdate(5, 2000, false);
+  aggregator.AddUpdate(3, 500, false);
+  aggregator.AddUpdate(0, 3000, false);
+  EXPECT_TRUE(aggregator.HasPendingUpdates());
+  EXPECT_TRUE(queue.IsEmpty());
+
+  // One frame per stream, with the session window first.
+  EXPECT_EQ(3u, aggregator.Flush());
+  EXPECT_FALSE(aggregator.HasPendingUpdates());
+  ExpectWindowUpdate(&queue, 0, 7000);
+  ExpectWindowUpdate(&queue, 3, 1500);
+  ExpectWindowUpdate(&queue, 5, 2000);
+  EXPECT_TRUE(queue.IsEmpty());
+}
+
+TEST(WindowUpdateAggregatorTest, UrgentUpdateFlushesEverything) {
+  mod_spdy::SpdyFramePriorityQueue queue;
+  mod_spdy::WindowUpdateAggregator aggregator(&queue);
+  aggregator.AddUpdate(1, 1000, false);
+  aggregator.AddUpdate(0, 2000, true);
+  EXPECT_FALSE(aggregator.HasPendingUpdates());
+  ExpectWindowUpdate(&queue, 0, 2000);
+  ExpectWindowUpdate(&queue, 1, 1000);
+  EXPECT_TRUE(queue.IsEmpty());
+}
+
+TEST(WindowUpdateAggregatorTest, DropStream) {
+  mod_spdy::SpdyFramePriorityQueue queue;
+  mod_spdy::WindowUpdateAggregator aggregator(&queue);
+  aggregator.AddUpdate(1, 1000, false);
+  aggregator.AddUpdate(3, 1000, false);
+  aggregator.DropStream(1);
+  aggregator.DropStream(7);  // no pending update; no effect
+  EXPECT_EQ(1u, aggregator.Flush());
+  ExpectWindowUpdate(&queue, 3, 1000);
+  EXPECT_TRUE(queue.IsEmpty());
+}
+
+}  // namespace
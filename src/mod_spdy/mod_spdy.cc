@@ -17,9 +17,15 @@
 
 #include "mod_spdy/mod_spdy.h"
 
+#include <stdio.h>
+#include <unistd.h>  // for getpid
+
 #include <algorithm>  // for std::min
+#include <map>
+#include <string>
 
 #include "httpd.h"
+#include "ap_mpm.h"
 #include "http_connection.h"
 #include "http_config.h"
 #include "http_log.h"
@@ -27,6 +33,7 @@
 #include "http_request.h"
 #include "apr_optional.h"
 #include "apr_optional_hooks.h"
+#include "apr_strings.h"
 #include "apr_tables.h"
 
 #include "base/basictypes.h"
@@ -39,6 +46,7 @@
 #include "mod_spdy/apache/id_pool.h"
 #include "mod_spdy/apache/filters/server_push_discovery_filter.h"
 #include "mod_spdy/apache/filters/server_push_filter.h"
+#include "mod_spdy/apache/filters/subresource_push_filter.h"
 #include "mod_spdy/apache/log_message_handler.h"
 #include "mod_spdy/apache/master_connection_context.h"
 #include "mod_spdy/apache/pool_util.h"
@@ -46,14 +54,23 @@
 #include "mod_spdy/apache/slave_connection_api.h"
 #include "mod_spdy/apache/ssl_util.h"
 #include "mod_spdy/common/executor.h"
+#include "mod_spdy/common/profiled_lock.h"
 #include "mod_spdy/common/protocol_util.h"
+#include "mod_spdy/common/push_response_cache.h"
+#include "mod_spdy/common/receive_window_tuner.h"
+#include "mod_spdy/common/request_coalescer.h"
+#include "mod_spdy/common/scoreboard.h"
 #include "mod_spdy/common/server_push_discovery_learner.h"
 #include "mod_spdy/common/server_push_discovery_session.h"
+#include "mod_spdy/common/server_push_outcome_tracker.h"
+#include "mod_spdy/common/session_capture.h"
 #include "mod_spdy/common/spdy_server_config.h"
 #include "mod_spdy/common/spdy_session.h"
 #include "mod_spdy/common/spdy_stream.h"
 #include "mod_spdy/common/thread_pool.h"
+#include "mod_spdy/common/trace_log.h"
 #include "mod_spdy/common/version.h"
+#include "net/spdy/spdy_protocol.h"
 
 extern "C" {
 
@@ -97,6 +114,21 @@ const char* const kPhpModuleNames[] = {
   "php6_module"
 };
 
+// The number of child process slots to make on the scoreboard, if the MPM
+// won't tell us its limit.
+const int kDefaultScoreboardProcesses = 256;
+
+// The number of session slots to make on the scoreboard; sessions beyond this
+// many are still counted in their process's totals.
+const int kScoreboardSessions = 4096;
+
+// The largest response (headers plus body) that identical concurrent requests
+// may share.
+const size_t kMaxCoalescedResponseBytes = 1024 * 1024;
+
+// The largest response (headers plus body) that a micro-cache will hold.
+const size_t kMaxMicroCachedResponseBytes = 16 * 1024;
+
 // These globals store the filter handles for our output filters.  Normally,
 // global variables would be very dangerous in a concurrent environment like
 // Apache, but this one is okay because it is assigned just once, at
@@ -104,6 +136,7 @@ const char* const kPhpModuleNames[] = {
 // and are read-only thereafter.
 ap_filter_rec_t* gServerPushFilterHandle = NULL;
 ap_filter_rec_t* gServerPushDiscoveryFilterHandle = NULL;
+ap_filter_rec_t* gSubresourcePushFilterHandle = NULL;
 
 // A process-global thread pool for processing SPDY streams concurrently.  This
 // is initialized once in *each child process* by our child-init hook.  Note
@@ -119,6 +152,28 @@ mod_spdy::ServerPushDiscoveryLearner* gServerPushDiscoveryLearner = NULL;
 mod_spdy::ServerPushDiscoverySessionPool*
 gServerPushDiscoverySessionPool = NULL;
 
+// A process-global cache of server push responses, shared by all SPDY sessions
+// in this child process.  This is NULL unless SpdyServerPushCacheSize is set.
+mod_spdy::PushResponseCache* gPushResponseCache = NULL;
+
+// A process-global registry of requests in flight, shared by all SPDY sessions
+// in this child process, so that identical concurrent GETs can share one
+// response.  Sessions only use it if SpdyCoalesceRequests is on.
+mod_spdy::RequestCoalescer* gRequestCoalescer = NULL;
+
+// Process-global micro-caches of small responses, one for each server config
+// that sets SpdyMicroCacheSize.  The map is created at child init and not
+// modified after that, so sessions may read it without locking.
+typedef std::map<const mod_spdy::SpdyServerConfig*,
+                 mod_spdy::PushResponseCache*> MicroCacheMap;
+MicroCacheMap* gMicroCaches = NULL;
+
+// A process-global record of which server pushes clients accept and which they
+// cancel, used to stop making pushes that are just thrown away.  This is NULL
+// unless SpdyServerPushOutcomeTracking is on for some server, and is only used
+// by the sessions and requests of servers for which it is on.
+mod_spdy::ServerPushOutcomeTracker* gServerPushOutcomeTracker = NULL;
+
 // Optional function provided by mod_spdy.  Return zero if the connection is
 // not using SPDY, otherwise return the SPDY version number in use.  Note that
 // unlike our private functions, we use Apache C naming conventions for this
@@ -152,6 +207,13 @@ apr_status_t ServerPushFilterFunc(ap_filter_t* filter,
   return server_push_filter->Write(filter, input_brigade);
 }
 
+apr_status_t SubresourcePushFilterFunc(ap_filter_t* filter,
+                                       apr_bucket_brigade* input_brigade) {
+  mod_spdy::SubresourcePushFilter* subresource_push_filter =
+      static_cast<mod_spdy::SubresourcePushFilter*>(filter->ctx);
+  return subresource_push_filter->Write(filter, input_brigade);
+}
+
 apr_status_t ServerPushDiscoveryFilterFunc(ap_filter_t* filter,
                                            apr_bucket_brigade* input_brigade) {
   // Don't auto-generate more pushes for pushed content.
@@ -228,9 +290,49 @@ int PostConfig(apr_pool_t* pconf, apr_pool_t* plog, apr_pool_t* ptemp,
     }
   }
 
+  // Create the scoreboard here in the parent, so that every child inherits
+  // the mapping.  On a restart, keep the one we already have: children of the
+  // previous generation may still be using it.
+  const std::string& scoreboard_file =
+      mod_spdy::GetServerConfig(server_list)->scoreboard_file();
+  if (any_enabled && !scoreboard_file.empty() &&
+      mod_spdy::Scoreboard::Instance() == NULL) {
+    int num_processes = 0;
+    if (ap_mpm_query(AP_MPMQ_HARD_LIMIT_DAEMONS, &num_processes) !=
+        APR_SUCCESS || num_processes <= 0) {
+      num_processes = kDefaultScoreboardProcesses;
+    }
+    std::string error;
+    if (!mod_spdy::Scoreboard::CreateInstance(
+            scoreboard_file, num_processes, kScoreboardSessions, &error)) {
+      LOG(ERROR) << "Could not create SPDY scoreboard: " << error;
+    }
+  }
+
   return OK;
 }
 
+// Pool cleanup that releases a child process's scoreboard slot as it exits.
+apr_status_t DetachFromScoreboard(void*) {
+  mod_spdy::Scoreboard* scoreboard = mod_spdy::Scoreboard::Instance();
+  if (scoreboard != NULL) {
+    scoreboard->DetachProcess();
+  }
+  return APR_SUCCESS;
+}
+
+// Pool cleanup that logs the lock contention counts of a child process as it
+// exits.  It's registered before the thread pool, so that it runs after the
+// pool's threads have stopped (and their locks have reported their counts).
+apr_status_t LogLockProfile(void*) {
+  mod_spdy::LockProfiler* profiler = mod_spdy::LockProfiler::Instance();
+  if (profiler != NULL) {
+    LOG(INFO) << "mod_spdy lock contention for process "
+              << getpid() << ":\n" << profiler->GetReport();
+  }
+  return APR_SUCCESS;
+}
+
 // Called exactly once for each child process, before that process starts
 // spawning worker threads.
 void ChildInit(apr_pool_t* pool, server_rec* server_list) {
@@ -238,9 +340,11 @@ void ChildInit(apr_pool_t* pool, server_rec* server_list) {
 
   // Check whether mod_spdy is enabled for any server_rec in the list, and
   // determine the most verbose log level of any server in the list.
-  // Also determines if server push discovery is enabled for any server.
+  // Also determines if server push discovery and push outcome tracking are
+  // enabled for any server.
   bool spdy_enabled = false;
   bool server_push_discovery_enabled = false;
+  bool server_push_outcome_tracking = false;
   int max_apache_log_level = APLOG_EMERG;  // the least verbose log level
   COMPILE_ASSERT(APLOG_INFO > APLOG_ERR, bigger_number_means_more_verbose);
   for (server_rec* server = server_list; server != NULL;
@@ -248,6 +352,8 @@ void ChildInit(apr_pool_t* pool, server_rec* server_list) {
     spdy_enabled |= mod_spdy::GetServerConfig(server)->spdy_enabled();
     server_push_discovery_enabled |=
         mod_spdy::GetServerConfig(server)->server_push_discovery_enabled();
+    server_push_outcome_tracking |=
+        mod_spdy::GetServerConfig(server)->server_push_outcome_tracking();
     if (server->loglevel > max_apache_log_level) {
       max_apache_log_level = server->loglevel;
     }
@@ -270,6 +376,49 @@ void ChildInit(apr_pool_t* pool, server_rec* server_list) {
     return;
   }
 
+  // Hand logging off to a background thread, if so configured.  This
+  // registers a cleanup on the pool that writes out any remaining messages,
+  // and since cleanups run in reverse order, it runs after the thread pool
+  // created below has shut down.
+  if (top_level_config->async_logging_enabled()) {
+    mod_spdy::StartAsyncLogging(pool);
+  }
+
+  // Start tracing, if so configured, before any of our threads exist.  The
+  // trace log lives as long as the process does, since threads may record
+  // events right up until they exit.
+  if (top_level_config->tracing_enabled()) {
+    mod_spdy::TraceLog::CreateInstance(
+        mod_spdy::TraceLog::kDefaultEventsPerThread);
+  }
+
+  // Likewise for lock profiling: locks only record their counts while the
+  // profiler exists, so create it before our threads start.  The counts are
+  // logged when the child exits, in case nobody fetched them before then.
+  if (top_level_config->lock_profiling_enabled()) {
+    mod_spdy::LockProfiler::CreateInstance();
+    apr_pool_cleanup_register(pool, NULL, LogLockProfile,
+                              apr_pool_cleanup_null);
+  }
+
+  // Claim this process's slot on the scoreboard, if there is one.  The
+  // cleanup releasing it runs after the thread pool has shut down.
+  mod_spdy::Scoreboard* scoreboard = mod_spdy::Scoreboard::Instance();
+  if (scoreboard != NULL) {
+    if (scoreboard->AttachProcess()) {
+      apr_pool_cleanup_register(pool, NULL, DetachFromScoreboard,
+                                apr_pool_cleanup_null);
+    } else {
+      LOG(WARNING) << "SPDY scoreboard is full; process " << getpid()
+                   << " will not be counted.";
+    }
+  }
+
+  // Set aside memory for letting upload flow control windows grow (see
+  // ReceiveWindowTuner).  Only sessions whose config allows it will use it.
+  mod_spdy::ReceiveWindowBudget::CreateInstance(
+      static_cast<int64>(top_level_config->receive_window_memory_kb()) * 1024);
+
   // Create the per-process thread pool.
   const int max_threads = top_level_config->max_threads_per_process();
   const int min_threads =
@@ -284,6 +433,11 @@ void ChildInit(apr_pool_t* pool, server_rec* server_list) {
                 << "mod_spdy will not function.";
   }
 
+  if (server_push_outcome_tracking) {
+    gServerPushOutcomeTracker = new mod_spdy::ServerPushOutcomeTracker;
+    mod_spdy::PoolRegisterDelete(pool, gServerPushOutcomeTracker);
+  }
+
   if (server_push_discovery_enabled) {
     gServerPushDiscoveryLearner = new mod_spdy::ServerPushDiscoveryLearner;
     mod_spdy::PoolRegisterDelete(pool, gServerPushDiscoveryLearner);
@@ -291,6 +445,46 @@ void ChildInit(apr_pool_t* pool, server_rec* server_list) {
         new mod_spdy::ServerPushDiscoverySessionPool;
     mod_spdy::PoolRegisterDelete(pool, gServerPushDiscoverySessionPool);
   }
+
+  // Create the per-process server push response cache, if enabled.  We keep
+  // individual entries within a single default flow control window, so that
+  // a cached push can usually be sent without waiting for a WINDOW_UPDATE.
+  const size_t push_cache_bytes =
+      static_cast<size_t>(top_level_config->server_push_cache_size_kb()) * 1024;
+  if (push_cache_bytes > 0) {
+    gPushResponseCache = new mod_spdy::PushResponseCache(
+        push_cache_bytes,
+        std::min(push_cache_bytes / 8,
+                 static_cast<size_t>(net::kSpdyStreamInitialWindowSize)));
+    mod_spdy::PoolRegisterDelete(pool, gPushResponseCache);
+  }
+
+  // Coalesced responses are buffered in full until the leader's is complete,
+  // so we limit how large they may be.
+  gRequestCoalescer =
+      new mod_spdy::RequestCoalescer(kMaxCoalescedResponseBytes);
+  mod_spdy::PoolRegisterDelete(pool, gRequestCoalescer);
+
+  // Create a micro-cache for each server that wants one.  Hits are sent from
+  // the connection thread, which mustn't block on flow control, so entries are
+  // kept small enough to fit in a default stream window with room to spare.
+  gMicroCaches = new MicroCacheMap;
+  mod_spdy::PoolRegisterDelete(pool, gMicroCaches);
+  for (server_rec* server = server_list; server != NULL;
+       server = server->next) {
+    const mod_spdy::SpdyServerConfig* config =
+        mod_spdy::GetServerConfig(server);
+    const size_t micro_cache_bytes =
+        static_cast<size_t>(config->micro_cache_size_kb()) * 1024;
+    if (micro_cache_bytes > 0 && gMicroCaches->count(config) == 0) {
+      mod_spdy::PushResponseCache* micro_cache =
+          new mod_spdy::PushResponseCache(
+              micro_cache_bytes,
+              std::min(micro_cache_bytes / 8, kMaxMicroCachedResponseBytes));
+      mod_spdy::PoolRegisterDelete(pool, micro_cache);
+      (*gMicroCaches)[config] = micro_cache;
+    }
+  }
 }
 
 // A pre-connection hook, to be run _before_ mod_ssl's pre-connection hook.
@@ -401,6 +595,35 @@ int PreConnection(conn_rec* connection, void* csd) {
   }
 }
 
+// If session capture is configured and this connection is sampled, open a
+// capture log for it; otherwise return NULL.
+mod_spdy::SessionCaptureWriter* MaybeStartSessionCapture(
+    conn_rec* connection, const mod_spdy::SpdyServerConfig* config,
+    mod_spdy::spdy::SpdyVersion spdy_version) {
+  if (config->session_capture_directory().empty() ||
+      config->session_capture_percent() <= 0) {
+    return NULL;
+  }
+  // Connection IDs are sequential within a child process, so scramble them
+  // (with Knuth's multiplicative hash) before sampling.
+  const uint32 hash = static_cast<uint32>(connection->id) * 2654435761u;
+  if (static_cast<int>(hash % 100) >= config->session_capture_percent()) {
+    return NULL;
+  }
+  const char* path = apr_psprintf(
+      connection->pool, "%s/spdy-%" APR_PID_T_FMT "-%ld.cap",
+      config->session_capture_directory().c_str(), getpid(), connection->id);
+  FILE* file = fopen(path, "wb");
+  if (file == NULL) {
+    PLOG(WARNING) << "Could not open session capture log " << path;
+    return NULL;
+  }
+  LOG(INFO) << "Capturing SPDY session input to " << path;
+  return new mod_spdy::SessionCaptureWriter(
+      file, spdy_version,
+      static_cast<size_t>(config->session_capture_max_kb()) * 1024);
+}
+
 // Called to see if we want to take care of processing this connection -- if
 // so, we do so and return OK, otherwise we return DECLINED.  For slave
 // connections, we want to return DECLINED.  For "real" connections, we need to
@@ -509,11 +732,26 @@ int ProcessConnection(conn_rec* connection) {
   // we've been configured to use SPDY regardless of what the client says), so
   // process this as a SPDY master connection.
   mod_spdy::ApacheSpdySessionIO session_io(connection);
+  scoped_ptr<mod_spdy::SessionCaptureWriter> capture(
+      MaybeStartSessionCapture(connection, config, spdy_version));
+  session_io.set_capture(capture.get());
   mod_spdy::ApacheSpdyStreamTaskFactory task_factory(connection);
   scoped_ptr<mod_spdy::Executor> executor(
       gPerProcessThreadPool->NewExecutor());
   mod_spdy::SpdySession spdy_session(
       spdy_version, config, &session_io, &task_factory, executor.get());
+  spdy_session.set_push_response_cache(gPushResponseCache);
+  if (config->server_push_outcome_tracking()) {
+    spdy_session.set_push_outcome_tracker(gServerPushOutcomeTracker);
+  }
+  if (config->coalesce_requests()) {
+    spdy_session.set_request_coalescer(gRequestCoalescer);
+  }
+  const MicroCacheMap::const_iterator micro_cache =
+      gMicroCaches->find(config);
+  if (micro_cache != gMicroCaches->end()) {
+    spdy_session.set_micro_cache(micro_cache->second);
+  }
   // This call will block until the session has closed down.
   spdy_session.Run();
 
@@ -716,16 +954,105 @@ void InsertRequestFilters(request_rec* request) {
   // connection being managed entirely on mod_spdy, and not being done on
   // behalf of someone else using the slave connection API.
   if (slave_context->slave_stream() != NULL) {
+    // Our slave connections only ever carry one request, and SPDY DATA frames
+    // delimit the response body by themselves, so there's no point in having
+    // Apache chunk the body only for HttpToSpdyFilter to de-chunk it again.
+    // Telling Apache that the connection will close after this request makes
+    // it send the body unchunked instead (along with a "Connection: close"
+    // header, which HttpToSpdyFilter drops), ending at the EOS bucket.  Apache
+    // resets this for each request it reads, so we set it here rather than
+    // when the connection is created.
+    connection->keepalive = AP_CONN_CLOSE;
+
+    const mod_spdy::SpdyServerConfig* request_config =
+        mod_spdy::GetServerConfig(request);
+    const char* const scheme = slave_context->is_using_ssl() ? "https" : "http";
     mod_spdy::ServerPushFilter* server_push_filter =
         new mod_spdy::ServerPushFilter(slave_context->slave_stream(), request,
-                                       mod_spdy::GetServerConfig(request));
+                                       request_config, scheme);
+    if (request_config->server_push_outcome_tracking()) {
+      server_push_filter->set_outcome_tracker(gServerPushOutcomeTracker);
+    }
     PoolRegisterDelete(request->pool, server_push_filter);
     ap_add_output_filter_handle(
         gServerPushFilterHandle,  // filter handle
         server_push_filter,       // context (any void* we want)
         request,                  // request object
         connection);              // connection object
+
+    // If so configured, also push the subresources that the response body
+    // references, as we see them go by.
+    if (request_config->server_push_scan_html()) {
+      mod_spdy::SubresourcePushFilter* subresource_push_filter =
+          new mod_spdy::SubresourcePushFilter(server_push_filter, request,
+                                              scheme);
+      PoolRegisterDelete(request->pool, subresource_push_filter);
+      ap_add_output_filter_handle(
+          gSubresourcePushFilterHandle,  // filter handle
+          subresource_push_filter,       // context (any void* we want)
+          request,                       // request object
+          connection);                   // connection object
+    }
+  }
+}
+
+// Serves the recorded trace of this child process (if SpdyDebugTracing is on)
+// for URLs configured with "SetHandler spdy-trace".  If the query string is
+// "clear", the recorded events are discarded after being returned.
+int TraceHandler(request_rec* request) {
+  if (request->handler == NULL ||
+      strcmp(request->handler, "spdy-trace") != 0) {
+    return DECLINED;
   }
+  mod_spdy::TraceLog* trace_log = mod_spdy::TraceLog::Instance();
+  if (trace_log == NULL) {
+    return HTTP_NOT_FOUND;
+  }
+  request->allowed |= (AP_METHOD_BIT << M_GET);
+  if (request->method_number != M_GET) {
+    return HTTP_METHOD_NOT_ALLOWED;
+  }
+
+  const std::string json = trace_log->GetTraceJson();
+  if (request->args != NULL && strcmp(request->args, "clear") == 0) {
+    trace_log->Clear();
+  }
+  ap_set_content_type(request, "application/json");
+  apr_table_setn(request->headers_out, "Cache-Control", "no-store");
+  if (!request->header_only) {
+    ap_rwrite(json.data(), json.size(), request);
+  }
+  return OK;
+}
+
+// Serves the lock contention counts of this child process (if
+// SpdyDebugLockProfiling is on) for URLs configured with
+// "SetHandler spdy-lock-profile".  If the query string is "clear", the counts
+// are reset after being returned.
+int LockProfileHandler(request_rec* request) {
+  if (request->handler == NULL ||
+      strcmp(request->handler, "spdy-lock-profile") != 0) {
+    return DECLINED;
+  }
+  mod_spdy::LockProfiler* profiler = mod_spdy::LockProfiler::Instance();
+  if (profiler == NULL) {
+    return HTTP_NOT_FOUND;
+  }
+  request->allowed |= (AP_METHOD_BIT << M_GET);
+  if (request->method_number != M_GET) {
+    return HTTP_METHOD_NOT_ALLOWED;
+  }
+
+  const std::string report = profiler->GetReport();
+  if (request->args != NULL && strcmp(request->args, "clear") == 0) {
+    profiler->Clear();
+  }
+  ap_set_content_type(request, "text/plain");
+  apr_table_setn(request->headers_out, "Cache-Control", "no-store");
+  if (!request->header_only) {
+    ap_rwrite(report.data(), report.size(), request);
+  }
+  return OK;
 }
 
 apr_status_t InvokeIdPoolDestroyInstance(void*) {
@@ -809,6 +1136,11 @@ void RegisterHooks(apr_pool_t* pool) {
   // insert-filter hook.
   ap_hook_insert_filter(InsertRequestFilters, NULL, NULL, APR_HOOK_MIDDLE);
 
+  // Register a handler to serve the trace log (see SpdyDebugTracing).
+  ap_hook_handler(TraceHandler, NULL, NULL, APR_HOOK_MIDDLE);
+  // And one to serve the lock contention counts (see SpdyDebugLockProfiling).
+  ap_hook_handler(LockProfileHandler, NULL, NULL, APR_HOOK_MIDDLE);
+
   // Register a hook with mod_ssl to be called when deciding what protocols to
   // advertise during Next Protocol Negotiatiation (NPN); we'll use this
   // opportunity to advertise that we support SPDY.  This hook is declared in
@@ -869,6 +1201,16 @@ void RegisterHooks(apr_pool_t* pool) {
       // Should always be before the SPDY_SERVER_PUSH filter.
       AP_FTYPE_CONTENT_SET);
 
+  // Create the filter that scans HTML responses for subresources to push.
+  gSubresourcePushFilterHandle = ap_register_output_filter(
+      "SPDY_SUBRESOURCE_PUSH",    // name
+      SubresourcePushFilterFunc,  // filter function
+      NULL,                       // init function (n/a in our case)
+      // We use CONTENT_SET-1 so that we see the body after content generators
+      // like mod_include have run, but before mod_deflate (at CONTENT_SET)
+      // compresses it.
+      static_cast<ap_filter_type>(AP_FTYPE_CONTENT_SET - 1));
+
   // Register our optional functions, so that other modules can retrieve and
   // use them.  See TAMB 10.1.2.
   APR_REGISTER_OPTIONAL_FN(spdy_get_version);
@@ -36,15 +36,29 @@
         '<(DEPTH)/net/net.gyp:spdy',
       ],
       'sources': [
+        'common/async_log_queue.cc',
         'common/executor.cc',
+        'common/html_subresource_scanner.cc',
+        'common/http_header_names.cc',
+        'common/http_line_scanner.cc',
         'common/http_request_visitor_interface.cc',
         'common/http_response_parser.cc',
         'common/http_response_visitor_interface.cc',
         'common/http_string_builder.cc',
         'common/http_to_spdy_converter.cc',
+        'common/latency_histogram.cc',
+        'common/profiled_lock.cc',
         'common/protocol_util.cc',
+        'common/push_response_cache.cc',
+        'common/receive_window_tuner.cc',
+        'common/request_coalescer.cc',
+        'common/scoreboard.cc',
         'common/server_push_discovery_learner.cc',
         'common/server_push_discovery_session.cc',
+        'common/server_push_manifest.cc',
+        'common/server_push_outcome_tracker.cc',
+        'common/server_push_pacer.cc',
+        'common/session_capture.cc',
         'common/shared_flow_control_window.cc',
         'common/spdy_frame_priority_queue.cc',
         'common/spdy_frame_queue.cc',
@@ -56,6 +70,8 @@
         'common/spdy_stream_task_factory.cc',
         'common/spdy_to_http_converter.cc',
         'common/thread_pool.cc',
+        'common/trace_log.cc',
+        'common/window_update_aggregator.cc',
       ],
     },
     {
@@ -85,6 +101,7 @@
         'apache/filters/server_push_filter.cc',
         'apache/filters/server_push_discovery_filter.cc',
         'apache/filters/spdy_to_http_filter.cc',
+        'apache/filters/subresource_push_filter.cc',
         'apache/id_pool.cc',
         'apache/log_message_handler.cc',
         'apache/master_connection_context.cc',
@@ -122,6 +139,20 @@
         }
       }]],
     },
+    {
+      'target_name': 'spdy_top',
+      'type': 'executable',
+      'dependencies': [
+        'spdy_common',
+        'spdy_tool_util',
+      ],
+      'include_dirs': [
+        '<(DEPTH)',
+      ],
+      'sources': [
+        'tools/spdy_top.cc',
+      ],
+    },
     {
       'target_name': 'spdy_common_testing',
       'type': '<(library)',
@@ -145,6 +176,24 @@
         'common/testing/spdy_frame_matchers.cc',
       ],
     },
+    {
+      'target_name': 'spdy_tool_util',
+      'type': '<(library)',
+      'dependencies': [
+        'spdy_common',
+        '<(DEPTH)/base/base.gyp:base',
+        '<(DEPTH)/build/build_util.gyp:mod_spdy_version_header',
+      ],
+      'include_dirs': [
+        '<(DEPTH)',
+      ],
+      'export_dependent_settings': [
+        'spdy_common',
+      ],
+      'sources': [
+        'common/testing/tool_util.cc',
+      ],
+    },
     {
       'target_name': 'spdy_common_test',
       'type': 'executable',
@@ -159,18 +208,104 @@
         '<(DEPTH)',
       ],
       'sources': [
+        'common/async_log_queue_test.cc',
+        'common/html_subresource_scanner_test.cc',
+        'common/http_header_names_test.cc',
+        'common/http_line_scanner_test.cc',
         'common/http_response_parser_test.cc',
         'common/http_to_spdy_converter_test.cc',
+        'common/latency_histogram_test.cc',
+        'common/profiled_lock_test.cc',
         'common/protocol_util_test.cc',
+        'common/push_response_cache_test.cc',
+        'common/receive_window_tuner_test.cc',
+        'common/request_coalescer_test.cc',
+        'common/scoreboard_test.cc',
         'common/server_push_discovery_learner_test.cc',
         'common/server_push_discovery_session_test.cc',
+        'common/server_push_manifest_test.cc',
+        'common/server_push_outcome_tracker_test.cc',
+        'common/server_push_pacer_test.cc',
+        'common/session_capture_test.cc',
         'common/shared_flow_control_window_test.cc',
         'common/spdy_frame_priority_queue_test.cc',
         'common/spdy_frame_queue_test.cc',
         'common/spdy_session_test.cc',
         'common/spdy_stream_test.cc',
         'common/spdy_to_http_converter_test.cc',
+        'common/spdy_version_traits_test.cc',
         'common/thread_pool_test.cc',
+        'common/trace_log_test.cc',
+        'common/window_update_aggregator_test.cc',
+      ],
+    },
+    {
+      'target_name': 'spdy_common_benchmarks',
+      'type': 'executable',
+      'dependencies': [
+        'spdy_common',
+        'spdy_tool_util',
+      ],
+      'include_dirs': [
+        '<(DEPTH)',
+      ],
+      'sources': [
+        'common/http_response_parser_benchmark.cc',
+        'common/http_to_spdy_converter_benchmark.cc',
+        'common/server_push_discovery_learner_benchmark.cc',
+        'common/shared_flow_control_window_benchmark.cc',
+        'common/spdy_frame_priority_queue_benchmark.cc',
+        'common/spdy_frame_queue_benchmark.cc',
+        'common/spdy_to_http_converter_benchmark.cc',
+        'common/testing/benchmark.cc',
+        'common/testing/run_all_benchmarks.cc',
+        'common/thread_pool_benchmark.cc',
+      ],
+    },
+    {
+      'target_name': 'spdy_session_loadtest',
+      'type': 'executable',
+      'dependencies': [
+        'spdy_common',
+        'spdy_tool_util',
+      ],
+      'include_dirs': [
+        '<(DEPTH)',
+      ],
+      'sources': [
+        'common/testing/spdy_session_loadtest.cc',
+        'common/testing/synthetic_client_session_io.cc',
+        'common/testing/synthetic_stream_task_factory.cc',
+      ],
+    },
+    {
+      'target_name': 'spdy_loadgen',
+      'type': 'executable',
+      'dependencies': [
+        'spdy_common',
+        'spdy_tool_util',
+      ],
+      'include_dirs': [
+        '<(DEPTH)',
+      ],
+      'sources': [
+        'common/testing/spdy_load_client.cc',
+        'common/testing/spdy_loadgen.cc',
+      ],
+    },
+    {
+      'target_name': 'spdy_session_replay',
+      'type': 'executable',
+      'dependencies': [
+        'spdy_common',
+        'spdy_tool_util',
+      ],
+      'include_dirs': [
+        '<(DEPTH)',
+      ],
+      'sources': [
+        'common/testing/spdy_session_replay.cc',
+        'common/testing/synthetic_stream_task_factory.cc',
       ],
     },
     {
@@ -193,6 +328,7 @@
         'apache/filters/server_push_discovery_filter_test.cc',
         'apache/filters/server_push_filter_test.cc',
         'apache/filters/spdy_to_http_filter_test.cc',
+        'apache/filters/subresource_push_filter_test.cc',
         'apache/id_pool_test.cc',
         'apache/pool_util_test.cc',
         'apache/sockaddr_util_test.cc',
@@ -0,0 +1,288 @@
+// Copyright 2014 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// Shows what mod_spdy is doing across a whole server, by reading the
+// scoreboard file (see scoreboard.h) that the server keeps when the
+// SpdyScoreboardFile directive is set.  Every interval, prints the totals for
+// the server, a line per child process, and the busiest sessions, with rates
+// computed since the previous interval.  Usage:
+//
+//   spdy_top --scoreboard=<file> [--interval_ms=<ms>] [--iterations=<n>]
+//            [--sessions=<n>]
+//
+// With --iterations=0 (the default), runs until interrupted.  The screen is
+// cleared between reports only if stdout is a terminal, so the output can
+// also be logged.
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+#include "mod_spdy/common/scoreboard.h"
+#include "mod_spdy/common/testing/tool_util.h"
+
+namespace {
+
+using mod_spdy::Scoreboard;
+using mod_spdy::testing::GetFlagValue;
+using mod_spdy::testing::GetIntFlag;
+
+typedef std::map<int, Scoreboard::Slot> SlotMap;
+
+struct TopOptions {
+  TopOptions()
+      : interval(base::TimeDelta::FromMilliseconds(2000)),
+        iterations(0),
+        sessions(10) {}
+
+  std::string scoreboard_path;
+  base::TimeDelta interval;
+  int iterations;
+  int sessions;
+};
+
+// The change in a counter since the previous report, per second.  A slot
+// that is new (or has been reclaimed since) is measured from zero.
+double Rate(const Scoreboard::Slot& slot, const SlotMap& previous,
+            Scoreboard::Counter counter, double seconds) {
+  int64 before = 0;
+  const SlotMap::const_iterator iter = previous.find(slot.index);
+  if (iter != previous.end() &&
+      iter->second.generation == slot.generation) {
+    before = iter->second.counters[counter];
+  }
+  return seconds > 0.0 ?
+      static_cast<double>(slot.counters[counter] - before) / seconds : 0.0;
+}
+
+double Stalls(const Scoreboard::Slot& slot, const SlotMap& previous,
+              double seconds) {
+  return Rate(slot, previous, Scoreboard::STREAM_WINDOW_STALLS, seconds) +
+      Rate(slot, previous, Scoreboard::SESSION_WINDOW_STALLS, seconds);
+}
+
+// For sorting sessions by how fast they're sending.
+struct SessionRate {
+  double bytes_sent_per_second;
+  const Scoreboard::Slot* slot;
+
+  bool operator<(const SessionRate& other) const {
+    return bytes_sent_per_second > other.bytes_sent_per_second;
+  }
+};
+
+std::string FormatReport(const std::vector<Scoreboard::Slot>& processes,
+                         const std::vector<Scoreboard::Slot>& sessions,
+                         const SlotMap& previous_processes,
+                         const SlotMap& previous_sessions,
+                         double seconds, int max_sessions) {
+  std::string out;
+  const time_t now = time(NULL);
+  char timestamp[32];
+  strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S",
+           localtime(&now));
+
+  // Server-wide totals.
+  int64 totals[Scoreboard::NUM_COUNTERS] = {0};
+  double streams_per_second = 0.0;
+  double in_per_second = 0.0;
+  double out_per_second = 0.0;
+  double stalls_per_second = 0.0;
+  double header_micros_per_second = 0.0;
+  for (size_t i = 0; i < processes.size(); ++i) {
+    const Scoreboard::Slot& slot = processes[i];
+    for (int j = 0; j < Scoreboard::NUM_COUNTERS; ++j) {
+      totals[j] += slot.counters[j];
+    }
+    streams_per_second += Rate(slot, previous_processes,
+                               Scoreboard::STREAMS_TOTAL, seconds);
+    in_per_second += Rate(slot, previous_processes,
+                          Scoreboard::BYTES_RECEIVED, seconds);
+    out_per_second += Rate(slot, previous_processes,
+                           Scoreboard::BYTES_SENT, seconds);
+    stalls_per_second += Stalls(slot, previous_processes, seconds);
+    header_micros_per_second +=
+        Rate(slot, previous_processes, Scoreboard::HEADER_COMPRESSION_MICROS,
+             seconds);
+  }
+  const int64 pushes = totals[Scoreboard::PUSHES_STARTED];
+  const int64 header_bytes_raw = totals[Scoreboard::HEADER_BYTES_RAW];
+  base::StringAppendF(
+      &out,
+      "spdy_top - %s\n"
+      "processes: %d  sessions: %lld  streams: %lld (%.1f/s)  "
+      "in: %.1f KB/s  out: %.1f KB/s\n"
+      "threads: %lld busy / %lld  tasks queued: %lld  frames queued: %lld  "
+      "window stalls: %.1f/s\n"
+      "pushes: %lld, %.1f%% cancelled  "
+      "header compression: %.1f ms/s, %.1f%% of raw size\n\n",
+      timestamp, static_cast<int>(processes.size()),
+      static_cast<long long>(totals[Scoreboard::SESSIONS_ACTIVE]),
+      static_cast<long long>(totals[Scoreboard::STREAMS_ACTIVE]),
+      streams_per_second, in_per_second / 1024.0, out_per_second / 1024.0,
+      static_cast<long long>(totals[Scoreboard::THREADS_BUSY]),
+      static_cast<long long>(totals[Scoreboard::THREADS]),
+      static_cast<long long>(totals[Scoreboard::TASKS_QUEUED]),
+      static_cast<long long>(totals[Scoreboard::OUTPUT_QUEUE_DEPTH]),
+      stalls_per_second, static_cast<long long>(pushes),
+      pushes > 0 ? 100.0 * totals[Scoreboard::PUSHES_CANCELLED] / pushes :
+      0.0,
+      header_micros_per_second / 1000.0,
+      header_bytes_raw > 0 ?
+      100.0 * totals[Scoreboard::HEADER_BYTES_SENT] / header_bytes_raw : 0.0);
+
+  // One line per child process.
+  base::StringAppendF(&out, "%7s %6s %6s %8s %10s %10s %6s %5s %5s %6s %7s\n",
+                      "PID", "SESS", "STRM", "STRM/s", "IN KB/s", "OUT KB/s",
+                      "QUEUE", "THR", "BUSY", "TASKQ", "STALL/s");
+  for (size_t i = 0; i < processes.size(); ++i) {
+    const Scoreboard::Slot& slot = processes[i];
+    base::StringAppendF(
+        &out, "%7d %6lld %6lld %8.1f %10.1f %10.1f %6lld %5lld %5lld %6lld "
+        "%7.1f\n",
+        slot.pid,
+        static_cast<long long>(slot.counters[Scoreboard::SESSIONS_ACTIVE]),
+        static_cast<long long>(slot.counters[Scoreboard::STREAMS_ACTIVE]),
+        Rate(slot, previous_processes, Scoreboard::STREAMS_TOTAL, seconds),
+        Rate(slot, previous_processes, Scoreboard::BYTES_RECEIVED,
+             seconds) / 1024.0,
+        Rate(slot, previous_processes, Scoreboard::BYTES_SENT,
+             seconds) / 1024.0,
+        static_cast<long long>(slot.counters[Scoreboard::OUTPUT_QUEUE_DEPTH]),
+        static_cast<long long>(slot.counters[Scoreboard::THREADS]),
+        static_cast<long long>(slot.counters[Scoreboard::THREADS_BUSY]),
+        static_cast<long long>(slot.counters[Scoreboard::TASKS_QUEUED]),
+        Stalls(slot, previous_processes, seconds));
+  }
+
+  // The sessions sending the most, most recently.
+  if (max_sessions > 0 && !sessions.empty()) {
+    std::vector<SessionRate> rates;
+    for (size_t i = 0; i < sessions.size(); ++i) {
+      SessionRate rate;
+      rate.bytes_sent_per_second = Rate(sessions[i], previous_sessions,
+                                        Scoreboard::BYTES_SENT, seconds);
+      rate.slot = &sessions[i];
+      rates.push_back(rate);
+    }
+    std::stable_sort(rates.begin(), rates.end());
+    if (rates.size() > static_cast<size_t>(max_sessions)) {
+      rates.resize(max_sessions);
+    }
+    base::StringAppendF(&out, "\n%6s %7s %6s %6s %8s %10s %6s %6s %7s\n",
+                        "SLOT", "PID", "AGE", "STRM", "TOTAL", "OUT KB/s",
+                        "QUEUE", "PUSHES", "STALL/s");
+    for (size_t i = 0; i < rates.size(); ++i) {
+      const Scoreboard::Slot& slot = *rates[i].slot;
+      base::StringAppendF(
+          &out, "%6d %7d %5llds %6lld %8lld %10.1f %6lld %6lld %7.1f\n",
+          slot.index, slot.pid,
+          static_cast<long long>(std::max<int64>(0, now - slot.start_time)),
+          static_cast<long long>(slot.counters[Scoreboard::STREAMS_ACTIVE]),
+          static_cast<long long>(slot.counters[Scoreboard::STREAMS_TOTAL]),
+          rates[i].bytes_sent_per_second / 1024.0,
+          static_cast<long long>(slot.counters[Scoreboard::OUTPUT_QUEUE_DEPTH]),
+          static_cast<long long>(slot.counters[Scoreboard::PUSHES_STARTED]),
+          Stalls(slot, previous_sessions, seconds));
+    }
+  }
+  return out;
+}
+
+void IndexSlots(const std::vector<Scoreboard::Slot>& slots, SlotMap* map) {
+  map->clear();
+  for (size_t i = 0; i < slots.size(); ++i) {
+    (*map)[slots[i].index] = slots[i];
+  }
+}
+
+int Usage(const char* program) {
+  fprintf(stderr, "Usage: %s --scoreboard=<file> [--interval_ms=<ms>] "
+          "[--iterations=<n>] [--sessions=<n>]\n", program);
+  return 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit_manager;
+  TopOptions options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    std::string value;
+    int number = 0;
+    if (GetFlagValue(arg, "--scoreboard", &value) && !value.empty()) {
+      options.scoreboard_path = value;
+    } else if (GetIntFlag(arg, "--interval_ms", 1, &number)) {
+      options.interval = base::TimeDelta::FromMilliseconds(number);
+    } else if (GetIntFlag(arg, "--iterations", 0, &options.iterations) ||
+               GetIntFlag(arg, "--sessions", 0, &options.sessions)) {
+      continue;
+    } else {
+      return Usage(argv[0]);
+    }
+  }
+  if (options.scoreboard_path.empty()) {
+    return Usage(argv[0]);
+  }
+
+  std::string error;
+  scoped_ptr<Scoreboard> scoreboard(
+      Scoreboard::Open(options.scoreboard_path, &error));
+  if (scoreboard == NULL) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+
+  const bool clear_screen = isatty(fileno(stdout));
+  std::vector<Scoreboard::Slot> processes;
+  std::vector<Scoreboard::Slot> sessions;
+  SlotMap previous_processes;
+  SlotMap previous_sessions;
+  base::TimeTicks previous_time;
+  for (int i = 0; options.iterations == 0 || i < options.iterations; ++i) {
+    if (i > 0) {
+      base::PlatformThread::Sleep(options.interval);
+    }
+    const base::TimeTicks now = base::TimeTicks::Now();
+    scoreboard->GetProcessSlots(&processes);
+    scoreboard->GetSessionSlots(&sessions);
+    // The first report has nothing to compare against, so shows no rates.
+    const double seconds = (i == 0 ? 0.0 : (now - previous_time).InSecondsF());
+    const std::string report =
+        FormatReport(processes, sessions, previous_processes,
+                     previous_sessions, seconds, options.sessions);
+    if (clear_screen) {
+      fputs("\033[H\033[2J", stdout);
+    } else if (i > 0) {
+      fputs("\n", stdout);
+    }
+    fputs(report.c_str(), stdout);
+    fflush(stdout);
+    IndexSlots(processes, &previous_processes);
+    IndexSlots(sessions, &previous_sessions);
+    previous_time = now;
+  }
+  return 0;
+}
@@ -14,10 +14,17 @@
 # See the License for the specific language governing permissions and
 # limitations under the License.
 
-# A simple script for load-testing mod_spdy (or any other SPDY server).  For
-# example, to hit the server with 150 simultaneous SPDY clients, each fetching
-# the URLs https://example.com/ and https://example.com/image.jpg, you would
-# run:
+# A simple script for load-testing mod_spdy (or any other SPDY server).
+#
+# For SPDY load tests, prefer the spdy_loadgen tool (built from
+# mod_spdy/common/testing/spdy_loadgen.cc), which multiplexes weighted request
+# mixes over many connections and reports time to first byte and latency
+# histograms by priority; this script is still useful for comparing against
+# plain HTTPS or HTTP clients.
+#
+# For example, to hit the server with 150 simultaneous SPDY clients, each
+# fetching the URLs https://example.com/ and https://example.com/image.jpg, you
+# would run:
 #
 #  $ ./loadtest.py spdy 150 https://example.com/ https://example.com/image.jpg
 #